@@ -0,0 +1,544 @@
+#include "devices/ahci.h"
+#include <debug.h>
+#include <inttypes.h>
+#include <list.h>
+#include <round.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "devices/block.h"
+#include "devices/partition.h"
+#include "devices/pci.h"
+#include "devices/timer.h"
+#include "threads/highmem.h"
+#include "threads/init.h"
+#include "threads/interrupt.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/vaddr.h"
+
+/* A driver for SATA disks behind an AHCI host bus adapter, such
+   as the ICH9 controller of QEMU's q35 machine or the one that
+   "-device ahci" adds (see "pintos --ahci").  See [AHCI] for the
+   adapter and [ATA-8] for the commands.
+
+   The adapter's registers are memory mapped, at the address in
+   the PCI function's sixth base address register.  Each port
+   with a disk behind it has a command list of up to 32 command
+   slots in memory.  A slot holds a command header, which points
+   to a command table: the command, as the frame the adapter
+   sends the disk, and a scatter list of the buffers to transfer.
+   Setting a slot's bit in the port's command issue register hands
+   the command to the adapter, which clears the bit once the
+   command is done.
+
+   A disk that supports native command queuing takes reads and
+   writes as READ and WRITE FPDMA QUEUED, tagged with their slot
+   numbers, and may have as many outstanding as it has queue
+   depth.  It reorders and overlaps them as it sees fit, and says
+   which are done by clearing their bits in the port's SATA active
+   register.  Other disks get READ and WRITE DMA EXT, which the
+   adapter still queues in all the slots but issues one at a
+   time.
+
+   A disk with a write cache has it turned on.  A flush request
+   is sent as FLUSH CACHE EXT, which is not a queued command: it
+   waits until the disk has no other command outstanding and then
+   goes alone, and the requests queued behind it wait for it.
+
+   Transfers are asynchronous, in the manner of virtio-blk.c:
+   ahci_submit() hands a request to a free slot, or queues it,
+   and returns, and the interrupt handler completes the requests
+   whose slots are done and fills the slots again.  The slots and
+   queues are protected by disabling interrupts. */
+
+/* Generic host control registers, as byte offsets. */
+#define HBA_CAP 0x00 /* Host capabilities. */
+#define HBA_GHC 0x04 /* Global host control. */
+#define HBA_IS 0x08  /* Interrupt status, one bit per port. */
+#define HBA_PI 0x0c  /* Ports implemented, one bit per port. */
+
+/* HBA_CAP bits. */
+#define CAP_NCS(CAP) ((((CAP) >> 8) & 0x1f) + 1) /* Command slots per port. */
+#define CAP_SNCQ (1u << 30)                      /* Supports native command queuing. */
+
+/* HBA_GHC bits. */
+#define GHC_IE (1u << 1)  /* Interrupt enable. */
+#define GHC_AE (1u << 31) /* AHCI enable. */
+
+/* Port registers, as byte offsets from the port's registers,
+   which start at PORT_BASE + PORT_SIZE * port. */
+#define PORT_BASE 0x100
+#define PORT_SIZE 0x80
+#define PORT_CLB 0x00  /* Command list base address. */
+#define PORT_CLBU 0x04 /* Command list base address, upper 32 bits. */
+#define PORT_FB 0x08   /* FIS base address. */
+#define PORT_FBU 0x0c  /* FIS base address, upper 32 bits. */
+#define PORT_IS 0x10   /* Interrupt status. */
+#define PORT_IE 0x14   /* Interrupt enable. */
+#define PORT_CMD 0x18  /* Command and status. */
+#define PORT_TFD 0x20  /* Task file data. */
+#define PORT_SIG 0x24  /* Signature of the attached device. */
+#define PORT_SSTS 0x28 /* SATA status. */
+#define PORT_SERR 0x30 /* SATA error. */
+#define PORT_SACT 0x34 /* SATA active: queued commands not yet done. */
+#define PORT_CI 0x38   /* Command issue: commands not yet done. */
+
+/* PORT_CMD bits. */
+#define CMD_ST (1u << 0)  /* Start processing the command list. */
+#define CMD_SUD (1u << 1) /* Spin up device. */
+#define CMD_POD (1u << 2) /* Power on device. */
+#define CMD_FRE (1u << 4) /* FIS receive enable. */
+#define CMD_FR (1u << 14) /* FIS receive running. */
+#define CMD_CR (1u << 15) /* Command list running. */
+
+/* PORT_IS and PORT_IE bits. */
+#define IS_DHRS (1u << 0)    /* Device to host register FIS received. */
+#define IS_SDBS (1u << 3)    /* Set device bits FIS received. */
+#define IS_ERRORS 0x7d800010 /* Errors, task file error among them. */
+
+/* Other port register values. */
+#define SSTS_DET_PRESENT 3 /* PORT_SSTS bits 0...3: device there, link up. */
+#define SIG_ATA 0x00000101 /* PORT_SIG of a SATA disk. */
+#define TFD_BUSY 0x88      /* PORT_TFD BSY and DRQ bits. */
+
+/* A command header, one per slot in a port's command list. */
+struct cmd_header {
+  uint16_t flags; /* FIS length in dwords, and CMDH_*. */
+  uint16_t prdtl; /* Entries in the scatter list. */
+  uint32_t prdbc; /* Bytes transferred, written by the adapter. */
+  uint32_t ctba;  /* Command table's physical address. */
+  uint32_t ctbau; /* Upper 32 bits of it. */
+  uint32_t reserved[4];
+};
+#define CMDH_WRITE (1 << 6) /* Data goes to the disk. */
+
+/* An entry in a command table's scatter list. */
+struct prd {
+  uint32_t dba;  /* Buffer's physical address. */
+  uint32_t dbau; /* Upper 32 bits of it. */
+  uint32_t reserved;
+  uint32_t dbc; /* Bytes in the buffer, less 1, up to PRD_MAX. */
+};
+#define PRD_MAX (4 * 1024 * 1024)
+
+/* A command table.  The scatter list of a request is its
+   buffer, which is physically contiguous, cut at PRD_MAX bytes,
+   so PRD_CNT entries cover the largest request. */
+#define PRD_CNT 8
+struct cmd_table {
+  uint8_t cfis[64]; /* Command frame. */
+  uint8_t acmd[16]; /* ATAPI command, not used. */
+  uint8_t reserved[48];
+  struct prd prdt[PRD_CNT]; /* Scatter list. */
+};
+
+/* A register frame from host to device, which carries an ATA
+   command. */
+struct fis_h2d {
+  uint8_t type;       /* FIS_TYPE_H2D. */
+  uint8_t flags;      /* FIS_COMMAND for a command. */
+  uint8_t command;    /* ATA command. */
+  uint8_t feature;    /* Features, low byte. */
+  uint8_t lba[3];     /* LBA, bits 0...23. */
+  uint8_t device;     /* Device register. */
+  uint8_t lba_hi[3];  /* LBA, bits 24...47. */
+  uint8_t feature_hi; /* Features, high byte. */
+  uint16_t count;     /* Sector count. */
+  uint8_t icc;        /* Isochronous command completion. */
+  uint8_t control;    /* Device control. */
+  uint32_t reserved;
+};
+#define FIS_TYPE_H2D 0x27
+#define FIS_COMMAND 0x80
+
+/* ATA commands. */
+#define ATA_READ_DMA_EXT 0x25
+#define ATA_WRITE_DMA_EXT 0x35
+#define ATA_READ_FPDMA 0x60
+#define ATA_WRITE_FPDMA 0x61
+#define ATA_IDENTIFY 0xec
+#define ATA_FLUSH_CACHE_EXT 0xea
+#define ATA_SET_FEATURES 0xef
+#define FEAT_WRITE_CACHE_ON 0x02 /* SET FEATURES: enable the write cache. */
+#define DEV_LBA 0x40 /* Device register bit for LBA addressing. */
+
+/* Largest request, limited by the 16-bit sector count. */
+#define REQUEST_MAX 65535
+
+/* Memory the adapter reads and writes for a port, in pages: the
+   command list, then the received FIS area, each with room to
+   spare for its alignment, then one command table per slot. */
+#define CMD_LIST_OFS 0
+#define FIS_OFS 1024
+#define TABLE_OFS 2048
+#define PORT_PAGES DIV_ROUND_UP(TABLE_OFS + 32 * sizeof(struct cmd_table), PGSIZE)
+
+/* A port with a disk. */
+struct ahci_port {
+  char name[8];                    /* Name, e.g. "sda". */
+  volatile uint32_t* regs;         /* Port registers. */
+  int port_no;                     /* Port number. */
+  struct cmd_header* headers;      /* Command list. */
+  struct cmd_table* tables;        /* Command tables. */
+  bool ncq;                        /* Use native command queuing? */
+  bool write_cache;                /* Is the disk's write cache on? */
+  bool flushing;                   /* Is a flush in the adapter's hands? */
+  size_t slot_cnt;                 /* Slots used. */
+  uint32_t issued;                 /* Slots in the adapter's hands. */
+  struct block_request* slots[32]; /* Request in each slot. */
+  struct list waiting;             /* Requests waiting for a slot. */
+};
+
+/* Most ports we drive. */
+#define PORT_MAX 8
+static struct ahci_port* ports[PORT_MAX];
+static size_t port_cnt;
+
+static volatile uint32_t* hba; /* Generic host control registers. */
+
+static struct block_operations ahci_operations;
+
+static bool init_port(struct ahci_port*, uint32_t cap, block_sector_t* size);
+static bool stop_port(struct ahci_port*);
+static bool poll_slot0(struct ahci_port*);
+static void fill_slot(struct ahci_port*, size_t slot, uint8_t command, block_sector_t,
+                      size_t cnt, void* buffer, bool write);
+static void start_waiting(struct ahci_port*);
+static void interrupt_handler(struct intr_frame*);
+
+/* Returns the register at byte offset REG of REGS. */
+static uint32_t reg_read(volatile uint32_t* regs, size_t reg) { return regs[reg / 4]; }
+
+/* Sets the register at byte offset REG of REGS to VALUE. */
+static void reg_write(volatile uint32_t* regs, size_t reg, uint32_t value) {
+  regs[reg / 4] = value;
+}
+
+/* Waits up to MS milliseconds for the bits in MASK of the
+   register at byte offset REG of REGS to read as VALUE.  Returns
+   false if they do not. */
+static bool reg_wait(volatile uint32_t* regs, size_t reg, uint32_t mask, uint32_t value,
+                     int ms) {
+  for (; ms > 0; ms--) {
+    if ((reg_read(regs, reg) & mask) == value)
+      return true;
+    timer_msleep(1);
+  }
+  return (reg_read(regs, reg) & mask) == value;
+}
+
+/* Finds an AHCI adapter on the PCI bus, sets up the disks on its
+   ports, and registers them with the block device layer. */
+void ahci_init(void) {
+  struct pci_addr a;
+  uint32_t cap, pi, class_reg;
+  uint8_t irq;
+  int i;
+
+  if (!pci_find_class(0x01, 0x06, &a))
+    return;
+  class_reg = pci_read_config(&a, PCI_CLASS);
+  if (((class_reg >> 8) & 0xff) != 0x01)
+    return;
+  pci_write_config(&a, PCI_COMMAND,
+                   pci_read_config(&a, PCI_COMMAND) | PCI_CMD_MEMORY | PCI_CMD_MASTER);
+  irq = (pci_read_config(&a, PCI_IRQ) & 0xff) + 0x20;
+  if (irq < 0x20 || irq > 0x2f) {
+    printf("ahci: unusable interrupt line\n");
+    return;
+  }
+  hba = init_map_device(pci_read_config(&a, PCI_BAR0 + 5 * 4) & ~0xfu,
+                        PORT_BASE + 32 * PORT_SIZE);
+
+  reg_write(hba, HBA_GHC, reg_read(hba, HBA_GHC) | GHC_AE);
+  cap = reg_read(hba, HBA_CAP);
+  pi = reg_read(hba, HBA_PI);
+  for (i = 0; i < 32 && port_cnt < PORT_MAX; i++) {
+    volatile uint32_t* regs = hba + (PORT_BASE + PORT_SIZE * i) / 4;
+    struct ahci_port* p;
+    block_sector_t size;
+    struct block* block;
+    char extra_info[32];
+
+    if (!(pi & (1u << i)) || (reg_read(regs, PORT_SSTS) & 0xf) != SSTS_DET_PRESENT ||
+        reg_read(regs, PORT_SIG) != SIG_ATA)
+      continue;
+
+    p = calloc(1, sizeof *p);
+    if (p == NULL)
+      PANIC("ahci: out of memory");
+    snprintf(p->name, sizeof p->name, "sd%c", 'a' + (int)port_cnt);
+    p->regs = regs;
+    p->port_no = i;
+    if (!init_port(p, cap, &size)) {
+      free(p);
+      continue;
+    }
+    ports[port_cnt++] = p;
+
+    snprintf(extra_info, sizeof extra_info, "ahci%s%s", p->ncq ? " ncq" : "",
+             p->write_cache ? ", write cache" : "");
+    block = block_register(p->name, BLOCK_RAW, extra_info, size, &ahci_operations, p);
+    partition_scan(block);
+  }
+  if (port_cnt == 0)
+    return;
+
+  /* The ports are ready; let them interrupt. */
+  intr_register_ext(irq, interrupt_handler, "ahci");
+  reg_write(hba, HBA_IS, reg_read(hba, HBA_IS));
+  reg_write(hba, HBA_GHC, reg_read(hba, HBA_GHC) | GHC_IE);
+}
+
+/* Starts port P, identifies its disk, and stores the disk's size
+   in *SIZE.  CAP is the adapter's capabilities.  Returns false,
+   leaving the port stopped, if the disk is unusable. */
+static bool init_port(struct ahci_port* p, uint32_t cap, block_sector_t* size) {
+  static uint16_t id[256];
+  uint8_t* mem;
+  uint64_t sectors;
+  size_t depth;
+
+  if (!stop_port(p)) {
+    printf("%s: port %d does not stop\n", p->name, p->port_no);
+    return false;
+  }
+
+  mem = palloc_get_multiple(PAL_ASSERT | PAL_ZERO, PORT_PAGES);
+  p->headers = (struct cmd_header*)(mem + CMD_LIST_OFS);
+  p->tables = (struct cmd_table*)(mem + TABLE_OFS);
+  reg_write(p->regs, PORT_CLB, vtop(p->headers));
+  reg_write(p->regs, PORT_CLBU, 0);
+  reg_write(p->regs, PORT_FB, vtop(mem + FIS_OFS));
+  reg_write(p->regs, PORT_FBU, 0);
+  reg_write(p->regs, PORT_SERR, 0xffffffff);
+  reg_write(p->regs, PORT_IS, 0xffffffff);
+  reg_write(p->regs, PORT_IE, 0);
+  reg_write(p->regs, PORT_CMD, reg_read(p->regs, PORT_CMD) | CMD_SUD | CMD_POD | CMD_FRE);
+  if (!reg_wait(p->regs, PORT_TFD, TFD_BUSY, 0, 1000)) {
+    printf("%s: disk stays busy\n", p->name);
+    goto fail;
+  }
+  reg_write(p->regs, PORT_CMD, reg_read(p->regs, PORT_CMD) | CMD_ST);
+
+  /* Identify the disk with slot 0, polling for completion. */
+  fill_slot(p, 0, ATA_IDENTIFY, 0, 1, id, false);
+  if (!poll_slot0(p)) {
+    printf("%s: IDENTIFY DEVICE failed\n", p->name);
+    goto fail;
+  }
+
+  /* Word 83 bit 10 says whether there are 48-bit LBAs, in words
+     100...103, or only 28-bit ones, in words 60 and 61. */
+  if (id[83] & (1 << 10))
+    sectors = id[100] | (uint32_t)id[101] << 16 | (uint64_t)id[102] << 32;
+  else
+    sectors = id[60] | (uint32_t)id[61] << 16;
+  *size = sectors < UINT32_MAX ? sectors : UINT32_MAX;
+
+  /* Word 76 bit 8 says whether the disk queues commands, and word
+     75 how many. */
+  p->slot_cnt = CAP_NCS(cap);
+  p->ncq = (cap & CAP_SNCQ) && (id[76] & (1 << 8));
+  if (p->ncq) {
+    depth = (id[75] & 0x1f) + 1;
+    if (depth < p->slot_cnt)
+      p->slot_cnt = depth;
+  }
+  /* Word 82 bit 5 says whether the disk has a write cache. */
+  if (id[82] & (1 << 5)) {
+    fill_slot(p, 0, ATA_SET_FEATURES, 0, 0, NULL, false);
+    ((struct fis_h2d*)p->tables[0].cfis)->feature = FEAT_WRITE_CACHE_ON;
+    p->write_cache = poll_slot0(p);
+  }
+
+  p->issued = 0;
+  list_init(&p->waiting);
+  reg_write(p->regs, PORT_IE, IS_DHRS | IS_SDBS | IS_ERRORS);
+  return true;
+
+fail:
+  stop_port(p);
+  palloc_free_multiple(mem, PORT_PAGES);
+  return false;
+}
+
+/* Issues the command in port P's slot 0 and waits up to a second
+   for it to finish.  Returns true if it succeeded.  For use
+   before the port's interrupts are on. */
+static bool poll_slot0(struct ahci_port* p) {
+  bool ok;
+
+  reg_write(p->regs, PORT_CI, 1);
+  ok = reg_wait(p->regs, PORT_CI, 1, 0, 1000) && !(reg_read(p->regs, PORT_IS) & IS_ERRORS);
+  reg_write(p->regs, PORT_IS, 0xffffffff);
+  return ok;
+}
+
+/* Stops port P's command list and FIS receive engines.  Returns
+   false if they do not stop. */
+static bool stop_port(struct ahci_port* p) {
+  reg_write(p->regs, PORT_CMD, reg_read(p->regs, PORT_CMD) & ~CMD_ST);
+  if (!reg_wait(p->regs, PORT_CMD, CMD_CR, 0, 500))
+    return false;
+  reg_write(p->regs, PORT_CMD, reg_read(p->regs, PORT_CMD) & ~CMD_FRE);
+  return reg_wait(p->regs, PORT_CMD, CMD_FR, 0, 500);
+}
+
+/* Queues request R for port P_ and returns at once.  The
+   interrupt handler completes it. */
+static void ahci_submit(void* p_, struct block_request* r) {
+  struct ahci_port* p = p_;
+  enum intr_level old_level;
+
+  ASSERT(r->cnt <= REQUEST_MAX);
+
+  /* Without a write cache, completed writes are durable already. */
+  if (r->cnt == 0 && !p->write_cache) {
+    r->complete(r);
+    return;
+  }
+
+  old_level = intr_disable();
+  list_push_back(&p->waiting, &r->elem);
+  start_waiting(p);
+  intr_set_level(old_level);
+}
+
+static struct block_operations ahci_operations = {NULL, NULL, NULL, NULL, ahci_submit};
+
+/* Fills slot SLOT of port P with COMMAND, to transfer the CNT
+   sectors at SECTOR between the disk and BUFFER. */
+static void fill_slot(struct ahci_port* p, size_t slot, uint8_t command, block_sector_t sector,
+                      size_t cnt, void* buffer, bool write) {
+  struct cmd_header* h = &p->headers[slot];
+  struct cmd_table* t = &p->tables[slot];
+  struct fis_h2d* fis = (struct fis_h2d*)t->cfis;
+  size_t bytes = cnt * BLOCK_SECTOR_SIZE;
+  uint8_t* buf = buffer;
+  size_t i;
+
+  memset(fis, 0, sizeof *fis);
+  fis->type = FIS_TYPE_H2D;
+  fis->flags = FIS_COMMAND;
+  fis->command = command;
+  fis->device = command != ATA_IDENTIFY ? DEV_LBA : 0;
+  fis->lba[0] = sector;
+  fis->lba[1] = sector >> 8;
+  fis->lba[2] = sector >> 16;
+  fis->lba_hi[0] = sector >> 24;
+  if (command == ATA_READ_FPDMA || command == ATA_WRITE_FPDMA) {
+    /* The count goes in the features, and the tag in the
+       count. */
+    fis->feature = cnt;
+    fis->feature_hi = cnt >> 8;
+    fis->count = slot << 3;
+  } else if (command != ATA_IDENTIFY)
+    fis->count = cnt;
+
+  /* Kernel virtual memory is mapped linearly onto physical
+     memory, so the buffer is physically contiguous too, unless
+     it lies within one page that kmap() mapped. */
+  for (i = 0; bytes > 0; i++) {
+    size_t chunk = bytes < PRD_MAX ? bytes : PRD_MAX;
+
+    ASSERT(i < PRD_CNT);
+    t->prdt[i].dba = kmap_vtop(buf);
+    t->prdt[i].dbau = 0;
+    t->prdt[i].dbc = chunk - 1;
+    buf += chunk;
+    bytes -= chunk;
+  }
+
+  h->flags = sizeof *fis / 4 | (write ? CMDH_WRITE : 0);
+  h->prdtl = i;
+  h->prdbc = 0;
+  h->ctba = vtop(t);
+  h->ctbau = 0;
+}
+
+/* Hands port P as many waiting requests as it has free slots
+   for, in order, up to the next flush, which it hands over alone
+   once the others are done.  Interrupts must be off. */
+static void start_waiting(struct ahci_port* p) {
+  uint32_t started = 0;
+  size_t i;
+
+  if (p->flushing)
+    return;
+  for (i = 0; i < p->slot_cnt && !list_empty(&p->waiting); i++) {
+    struct block_request* r;
+    uint8_t command;
+
+    if (p->issued & (1u << i))
+      continue;
+    r = list_entry(list_front(&p->waiting), struct block_request, elem);
+    if (r->cnt == 0 && (p->issued != 0 || started != 0))
+      break;
+    list_pop_front(&p->waiting);
+    p->slots[i] = r;
+    if (r->cnt == 0) {
+      p->flushing = true;
+      command = ATA_FLUSH_CACHE_EXT;
+    } else if (p->ncq)
+      command = r->write ? ATA_WRITE_FPDMA : ATA_READ_FPDMA;
+    else
+      command = r->write ? ATA_WRITE_DMA_EXT : ATA_READ_DMA_EXT;
+    fill_slot(p, i, command, r->sector, r->cnt, r->buffer, r->write && r->cnt > 0);
+    started |= 1u << i;
+    if (p->flushing)
+      break;
+  }
+  if (started == 0)
+    return;
+
+  /* The adapter reads the slots once it sees their bits, so they
+     must be written first.  x86 does not reorder stores, so
+     stopping the compiler from doing so is enough. */
+  barrier();
+  p->issued |= started;
+  if (p->ncq && !p->flushing)
+    reg_write(p->regs, PORT_SACT, started);
+  reg_write(p->regs, PORT_CI, started);
+}
+
+/* Acknowledges port P's interrupt, completes the requests whose
+   slots are done, and hands it the waiting requests that now
+   fit. */
+static void service(struct ahci_port* p) {
+  uint32_t is = reg_read(p->regs, PORT_IS);
+  uint32_t done;
+  size_t i;
+
+  reg_write(p->regs, PORT_IS, is);
+  if (is & IS_ERRORS)
+    PANIC("%s: command failed, status=%#" PRIx32 ", task file=%#" PRIx32, p->name, is,
+          reg_read(p->regs, PORT_TFD));
+
+  done = p->issued & ~(reg_read(p->regs, PORT_SACT) | reg_read(p->regs, PORT_CI));
+  p->issued &= ~done;
+  if (done != 0)
+    p->flushing = false; /* A flush goes alone, so it is DONE. */
+  for (i = 0; i < p->slot_cnt; i++)
+    if (done & (1u << i)) {
+      struct block_request* r = p->slots[i];
+
+      /* R may be freed as soon as it is completed. */
+      p->slots[i] = NULL;
+      r->complete(r);
+    }
+  start_waiting(p);
+}
+
+/* AHCI interrupt handler.  The adapter's interrupt status says
+   which ports to look at, and is cleared after theirs. */
+static void interrupt_handler(struct intr_frame* f UNUSED) {
+  uint32_t is = reg_read(hba, HBA_IS);
+  size_t i;
+
+  for (i = 0; i < port_cnt; i++)
+    if (is & (1u << ports[i]->port_no))
+      service(ports[i]);
+  reg_write(hba, HBA_IS, is);
+}
@@ -3,7 +3,12 @@
 #include <string.h>
 #include <stdio.h>
 #include "devices/ide.h"
+#include "devices/timer.h"
+#include "threads/interrupt.h"
 #include "threads/malloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/tracepoint.h"
 
 /* A block device. */
 struct block {
@@ -16,10 +21,13 @@ struct block {
   const struct block_operations* ops; /* Driver operations. */
   void* aux;                          /* Extra data owned by driver. */
 
-  unsigned long long read_cnt;  /* Number of sectors read. */
-  unsigned long long write_cnt; /* Number of sectors written. */
+  struct blkstat stats; /* I/O statistics. */
 };
 
+/* A request gains a priority level for every this many
+   nanoseconds it waits, so that none starves. */
+#define AGE_NS (4 * 1000 * 1000)
+
 /* List of all block devices. */
 static struct list all_blocks = LIST_INITIALIZER(all_blocks);
 
@@ -90,14 +98,34 @@ static void check_sector(struct block* block, block_sector_t sector) {
   }
 }
 
+/* Completion function for transfer(). */
+static void wake(struct block_request* r) { sema_up(r->aux); }
+
+/* Submits a request to transfer the CNT sectors starting at
+   SECTOR between BLOCK and BUFFER, and waits for it to
+   complete. */
+static void transfer(struct block* block, block_sector_t sector, size_t cnt, void* buffer,
+                     bool write) {
+  struct block_request r;
+  struct semaphore done;
+
+  sema_init(&done, 0);
+  r.sector = sector;
+  r.cnt = cnt;
+  r.buffer = buffer;
+  r.write = write;
+  r.complete = wake;
+  r.aux = &done;
+  block_submit(block, &r);
+  sema_down(&done);
+}
+
 /* Reads sector SECTOR from BLOCK into BUFFER, which must
    have room for BLOCK_SECTOR_SIZE bytes.
    Internally synchronizes accesses to block devices, so external
    per-block device locking is unneeded. */
 void block_read(struct block* block, block_sector_t sector, void* buffer) {
-  check_sector(block, sector);
-  block->ops->read(block->aux, sector, buffer);
-  block->read_cnt++;
+  block_read_multiple(block, sector, 1, buffer);
 }
 
 /* Write sector SECTOR to BLOCK from BUFFER, which must contain
@@ -106,10 +134,173 @@ void block_read(struct block* block, block_sector_t sector, void* buffer) {
    Internally synchronizes accesses to block devices, so external
    per-block device locking is unneeded. */
 void block_write(struct block* block, block_sector_t sector, const void* buffer) {
-  check_sector(block, sector);
-  ASSERT(block->type != BLOCK_FOREIGN);
-  block->ops->write(block->aux, sector, buffer);
-  block->write_cnt++;
+  block_write_multiple(block, sector, 1, buffer);
+}
+
+/* Reads the CNT sectors starting at SECTOR from BLOCK into
+   BUFFER, which must have room for CNT * BLOCK_SECTOR_SIZE
+   bytes, in a single request if the driver supports it.
+   Internally synchronizes accesses to block devices, so external
+   per-block device locking is unneeded. */
+void block_read_multiple(struct block* block, block_sector_t sector, size_t cnt, void* buffer) {
+  if (cnt > 0) {
+    TRACEPOINT(TP_BLOCK_READ, TP_BEGIN, sector, cnt);
+    transfer(block, sector, cnt, buffer, false);
+    TRACEPOINT(TP_BLOCK_READ, TP_END, sector, cnt);
+  }
+}
+
+/* Writes the CNT sectors starting at SECTOR to BLOCK from
+   BUFFER, which must contain CNT * BLOCK_SECTOR_SIZE bytes, in a
+   single request if the driver supports it.  Returns after the
+   block device has acknowledged receiving the data.
+   Internally synchronizes accesses to block devices, so external
+   per-block device locking is unneeded. */
+void block_write_multiple(struct block* block, block_sector_t sector, size_t cnt,
+                          const void* buffer) {
+  if (cnt > 0) {
+    TRACEPOINT(TP_BLOCK_WRITE, TP_BEGIN, sector, cnt);
+    transfer(block, sector, cnt, (void*)buffer, true);
+    TRACEPOINT(TP_BLOCK_WRITE, TP_END, sector, cnt);
+  }
+}
+
+/* Waits until every write to BLOCK that has completed is
+   durable, flushing the device's write cache if it has one.  A
+   barrier: writes that must reach the disk before a later one
+   are written, then flushed, before the later one is issued. */
+void block_flush(struct block* block) { transfer(block, 0, 0, NULL, true); }
+
+/* Counts a request as submitted to BLOCK.  Interrupts must be
+   off. */
+static void account_submit(struct block* block) {
+  struct blkstat* s = &block->stats;
+
+  s->in_flight++;
+  if (s->in_flight > s->max_in_flight)
+    s->max_in_flight = s->in_flight;
+  s->depth_sum += s->in_flight;
+}
+
+/* Counts a request of CNT sectors in direction WRITE as
+   completed by BLOCK after NS nanoseconds, or a flush if CNT is
+   0.  Interrupts must be off. */
+static void account_complete(struct block* block, bool write, size_t cnt, int64_t ns) {
+  struct blkstat* s = &block->stats;
+  int64_t us = ns / 1000;
+  int bucket = 0;
+
+  if (cnt == 0) {
+    s->in_flight--;
+    s->flushes++;
+    s->flush_ns += ns;
+    return;
+  }
+  while (us >= 2 && bucket < BLKSTAT_HIST_CNT - 1) {
+    us >>= 1;
+    bucket++;
+  }
+  s->in_flight--;
+  s->requests[write]++;
+  s->bytes[write] += (long long)cnt * BLOCK_SECTOR_SIZE;
+  s->latency_ns[write] += ns;
+  s->latency_hist[write][bucket]++;
+}
+
+/* Completion function that block_submit() puts in place of the
+   submitter's: counts R as completed and then completes it as
+   the submitter asked.  Runs in whatever context the driver
+   completes requests in, possibly an interrupt handler. */
+static void finish(struct block_request* r) {
+  int64_t ns = timer_ns() - r->submit_ns;
+  enum intr_level old_level = intr_disable();
+
+  account_complete(r->block, r->write, r->cnt, ns);
+  if (r->lower != NULL)
+    account_complete(r->lower, r->write, r->cnt, ns);
+  intr_set_level(old_level);
+
+  r->complete = r->caller_complete;
+  r->complete(r);
+}
+
+/* Returns the priority that a driver should serve request R
+   with at NOW_NS, as given by timer_ns(): that of the thread
+   that submitted it, or, if that thread is waiting for R and its
+   priority has changed since, such as by a donation from a
+   thread that waits for a lock it holds, its priority now.  R
+   gains one level more for every AGE_NS it has waited, up to
+   PRI_MAX, so that a low-priority request is served eventually
+   even while higher-priority ones keep coming.  Interrupts must
+   be off. */
+int block_request_priority(const struct block_request* r, int64_t now_ns) {
+  int priority = r->priority;
+  int64_t age;
+
+  ASSERT(intr_get_level() == INTR_OFF);
+
+  if (r->waiter != NULL && r->waiter->priority > priority)
+    priority = r->waiter->priority;
+  age = (now_ns - r->submit_ns) / AGE_NS;
+  return age < PRI_MAX - priority ? priority + age : PRI_MAX;
+}
+
+/* Submits request R to BLOCK and returns without waiting for it.
+   R->complete is called when it is done.  If BLOCK's driver does
+   not queue requests, the transfer is done, and R completed,
+   before returning.
+
+   A driver that stacks on another device, as a partition does
+   on its disk, may pass R on with block_submit().  R then counts
+   for both devices. */
+void block_submit(struct block* block, struct block_request* r) {
+  enum intr_level old_level;
+
+  if (r->cnt > 0) {
+    check_sector(block, r->sector);
+    check_sector(block, r->sector + r->cnt - 1);
+    ASSERT(!r->write || block->type != BLOCK_FOREIGN);
+  }
+
+  old_level = intr_disable();
+  if (r->complete == finish) {
+    ASSERT(r->lower == NULL);
+    r->lower = block;
+  } else {
+    r->block = block;
+    r->lower = NULL;
+    r->submit_ns = timer_ns();
+    r->caller_complete = r->complete;
+    r->complete = finish;
+    r->priority = intr_context() ? PRI_DEFAULT : thread_get_priority();
+    r->waiter = r->caller_complete == wake ? thread_current() : NULL;
+  }
+  account_submit(block);
+  intr_set_level(old_level);
+
+  if (block->ops->submit != NULL)
+    block->ops->submit(block->aux, r);
+  else if (r->cnt == 0)
+    r->complete(r);
+  else if (r->write && block->ops->write_multiple != NULL) {
+    block->ops->write_multiple(block->aux, r->sector, r->cnt, r->buffer);
+    r->complete(r);
+  } else if (!r->write && block->ops->read_multiple != NULL) {
+    block->ops->read_multiple(block->aux, r->sector, r->cnt, r->buffer);
+    r->complete(r);
+  } else {
+    size_t i;
+
+    for (i = 0; i < r->cnt; i++) {
+      uint8_t* p = (uint8_t*)r->buffer + i * BLOCK_SECTOR_SIZE;
+
+      if (r->write)
+        block->ops->write(block->aux, r->sector + i, p);
+      else
+        block->ops->read(block->aux, r->sector + i, p);
+    }
+    r->complete(r);
+  }
 }
 
 /* Returns the number of sectors in BLOCK. */
@@ -121,16 +312,57 @@ const char* block_name(struct block* block) { return block->name; }
 /* Returns BLOCK's type. */
 enum block_type block_type(struct block* block) { return block->type; }
 
+/* Copies BLOCK's I/O statistics into *STATS. */
+void block_get_stats(struct block* block, struct blkstat* stats) {
+  enum intr_level old_level = intr_disable();
+  *stats = block->stats;
+  intr_set_level(old_level);
+}
+
+/* Prints the latency histogram HIST of the requests in direction
+   DIR, one line per bucket that is not empty. */
+static void print_histogram(const char* dir, const unsigned hist[BLKSTAT_HIST_CNT]) {
+  int i;
+
+  for (i = 0; i < BLKSTAT_HIST_CNT; i++)
+    if (hist[i] > 0) {
+      if (i == 0)
+        printf("  %s latency under 2 us: %u\n", dir, hist[i]);
+      else if (i == BLKSTAT_HIST_CNT - 1)
+        printf("  %s latency %lu us or more: %u\n", dir, 1ul << i, hist[i]);
+      else
+        printf("  %s latency %lu-%lu us: %u\n", dir, 1ul << i, 1ul << (i + 1), hist[i]);
+    }
+}
+
 /* Prints statistics for each block device used for a Pintos role. */
 void block_print_stats(void) {
-  int i;
+  static const char* dirs[2] = {"read", "write"};
+  int i, d;
 
   for (i = 0; i < BLOCK_ROLE_CNT; i++) {
     struct block* block = block_by_role[i];
-    if (block != NULL) {
-      printf("%s (%s): %llu reads, %llu writes\n", block->name, block_type_name(block->type),
-             block->read_cnt, block->write_cnt);
-    }
+    struct blkstat s;
+    long long requests;
+
+    if (block == NULL)
+      continue;
+    block_get_stats(block, &s);
+    requests = s.requests[BLKSTAT_READ] + s.requests[BLKSTAT_WRITE] + s.flushes + s.in_flight;
+    printf("%s (%s): %lld reads, %lld writes\n", block->name, block_type_name(block->type),
+           s.bytes[BLKSTAT_READ] / BLOCK_SECTOR_SIZE, s.bytes[BLKSTAT_WRITE] / BLOCK_SECTOR_SIZE);
+    printf("  %u in flight, queue depth %lld.%02lld on average, %u at most\n", s.in_flight,
+           requests > 0 ? s.depth_sum / requests : 0,
+           requests > 0 ? s.depth_sum * 100 / requests % 100 : 0, s.max_in_flight);
+    for (d = BLKSTAT_READ; d <= BLKSTAT_WRITE; d++)
+      if (s.requests[d] > 0) {
+        printf("  %ss: %lld requests, %lld bytes, %lld us average latency\n", dirs[d],
+               s.requests[d], s.bytes[d], s.latency_ns[d] / s.requests[d] / 1000);
+        print_histogram(dirs[d], s.latency_hist[d]);
+      }
+    if (s.flushes > 0)
+      printf("  flushes: %lld requests, %lld us average latency\n", s.flushes,
+             s.flush_ns / s.flushes / 1000);
   }
 }
 
@@ -151,8 +383,8 @@ struct block* block_register(const char* name, enum block_type type, const char*
   block->size = size;
   block->ops = ops;
   block->aux = aux;
-  block->read_cnt = 0;
-  block->write_cnt = 0;
+  memset(&block->stats, 0, sizeof block->stats);
+  strlcpy(block->stats.name, name, sizeof block->stats.name);
 
   printf("%s: %'" PRDSNu " sectors (", block->name, block->size);
   print_human_readable_size((uint64_t)block->size * BLOCK_SECTOR_SIZE);
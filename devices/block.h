@@ -1,8 +1,11 @@
 #ifndef DEVICES_BLOCK_H
 #define DEVICES_BLOCK_H
 
+#include <stdbool.h>
 #include <stddef.h>
 #include <inttypes.h>
+#include <blkstat.h>
+#include <list.h>
 
 /* Size of a block device sector in bytes.
    All IDE disks use this sector size, as do most USB and SCSI
@@ -21,8 +24,10 @@ typedef uint32_t block_sector_t;
 /* Higher-level interface for file systems, etc. */
 
 struct block;
+struct thread;
 
-/* Type of a block device. */
+/* Type of a block device.  The roles are in the same order as
+   in lib/blkstat.h. */
 enum block_type {
   /* Block device types that play a role in Pintos. */
   BLOCK_KERNEL,  /* Pintos OS kernel. */
@@ -52,17 +57,73 @@ struct block* block_next(struct block*);
 block_sector_t block_size(struct block*);
 void block_read(struct block*, block_sector_t, void*);
 void block_write(struct block*, block_sector_t, const void*);
+void block_read_multiple(struct block*, block_sector_t, size_t cnt, void*);
+void block_write_multiple(struct block*, block_sector_t, size_t cnt, const void*);
+void block_flush(struct block*);
 const char* block_name(struct block*);
 enum block_type block_type(struct block*);
 
+/* An asynchronous request to transfer CNT consecutive sectors,
+   starting at SECTOR, between a block device and BUFFER.  The
+   submitter fills in everything but the members owned by the
+   driver, and COMPLETE is called, possibly in an interrupt
+   handler, once the transfer is done.  Drivers may change
+   SECTOR.
+
+   A request with CNT 0 is a flush: it completes once every write
+   that completed before it was submitted is durable, even if the
+   device caches writes.  Its other members but COMPLETE and AUX
+   are ignored. */
+struct block_request {
+  block_sector_t sector;                   /* First sector. */
+  size_t cnt;                              /* Number of sectors. */
+  void* buffer;                            /* CNT * BLOCK_SECTOR_SIZE bytes. */
+  bool write;                              /* Write rather than read? */
+  void (*complete)(struct block_request*); /* Called when done. */
+  void* aux;                               /* For COMPLETE. */
+
+  /* Owned by the driver. */
+  struct list_elem elem;      /* Element in a queue. */
+  struct block_request* next; /* Next request served by the same command. */
+
+  /* Owned by the block layer, for statistics. */
+  struct block* block;                            /* Device submitted to. */
+  struct block* lower;                            /* Device BLOCK passed it to, or null. */
+  int64_t submit_ns;                              /* timer_ns() at submission. */
+  void (*caller_complete)(struct block_request*); /* COMPLETE as submitted. */
+
+  /* Owned by the block layer, for scheduling (see
+     block_request_priority()). */
+  int priority;          /* Submitter's priority at submission. */
+  struct thread* waiter; /* Thread waiting for R in block_read() etc., or null. */
+};
+
+void block_submit(struct block*, struct block_request*);
+int block_request_priority(const struct block_request*, int64_t now_ns);
+
 /* Statistics. */
+void block_get_stats(struct block*, struct blkstat*);
 void block_print_stats(void);
 
 /* Lower-level interface to block device drivers. */
 
+/* READ_MULTIPLE and WRITE_MULTIPLE transfer CNT consecutive
+   sectors in one request.  A driver may leave them null, in
+   which case the block layer transfers one sector at a time.
+
+   A driver with SUBMIT queues requests and serves them
+   asynchronously.  It need not supply the other operations: the
+   block layer turns synchronous transfers into requests and
+   waits for them.  SUBMIT also receives flushes, which a driver
+   whose device has no write cache may complete at once.  For a
+   driver without SUBMIT, writes are durable when they complete,
+   and the block layer completes flushes itself. */
 struct block_operations {
   void (*read)(void* aux, block_sector_t, void* buffer);
   void (*write)(void* aux, block_sector_t, const void* buffer);
+  void (*read_multiple)(void* aux, block_sector_t, size_t cnt, void* buffer);
+  void (*write_multiple)(void* aux, block_sector_t, size_t cnt, const void* buffer);
+  void (*submit)(void* aux, struct block_request*);
 };
 
 struct block* block_register(const char* name, enum block_type, const char* extra_info,
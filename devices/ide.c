@@ -5,17 +5,69 @@
 #include <stdio.h>
 #include "devices/block.h"
 #include "devices/partition.h"
+#include "devices/pci.h"
 #include "devices/timer.h"
+#include "threads/highmem.h"
 #include "threads/io.h"
 #include "threads/interrupt.h"
+#include "threads/palloc.h"
 #include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
 
 /* The code in this file is an interface to an ATA (IDE)
-   controller.  It attempts to comply to [ATA-3]. */
+   controller.  It attempts to comply to [ATA-3].
+
+   Transfers are asynchronous.  ide_submit() queues a request on
+   its disk and returns, and the interrupt handler finishes it
+   and starts the next request when one is done.  The interrupt
+   handler only puts finished requests on its channel's done
+   list, and the submitters' completion functions are called by
+   deferred work at the end of the interrupt, in interrupt
+   context but with interrupts on between one and the next.
+
+   If the PCI IDE controller can master the bus, as the PIIX
+   that Bochs and QEMU emulate can, and the disk supports DMA, a
+   command moves all of its sectors by DMA with one interrupt at
+   the end, described to the controller by a table of physical
+   regions.  Otherwise, or with -no-dma, the interrupt handler
+   moves each sector in PIO mode, one interrupt and 256 string
+   I/O instructions each, as the disk is ready for it.  A request that
+   continues one already queued, in the same direction, is merged
+   with it, so both go to the disk as a single command.  Each
+   disk's queue is served in C-LOOK order: the next request is
+   the one with the lowest sector at or after the end of the
+   last one served, or the lowest sector of all if there is none
+   ahead, so the heads sweep across the disk in one direction.
+   Only the requests whose priority, as block_request_priority()
+   reckons it, is within PRI_BAND of the highest in the queue
+   take part in the sweep, so a batch job's requests wait while
+   an interactive thread's are queued, but requests of about the
+   same priority are still served in one sweep.  Waiting raises
+   a request's priority, so none waits forever.  When both disks
+   on a channel have requests waiting, the channel alternates
+   between them.
+
+   Sectors are addressed with 28-bit LBAs where those reach, and
+   with the 48-bit LBAs of the EXT commands beyond, on disks that
+   support them.  A block_sector_t holds 32 bits, so a disk is
+   used up to 2 TB.
+
+   A disk whose write cache the IDENTIFY data says is supported
+   has the cache turned on, so that a write completes once the
+   disk has the data rather than once it is on the platter.  A
+   flush request, one with no sectors, then issues FLUSH CACHE,
+   which completes once every write the disk has completed is
+   durable.  A flush is served ahead of the transfers queued with
+   it and is never merged with them.
+
+   The queues and the state of each channel are protected by
+   disabling interrupts. */
 
 /* ATA command block port addresses. */
 #define reg_data(CHANNEL) ((CHANNEL)->reg_base + 0)   /* Data. */
 #define reg_error(CHANNEL) ((CHANNEL)->reg_base + 1)  /* Error. */
+#define reg_feature(CHANNEL) reg_error(CHANNEL)       /* Features (w/o). */
 #define reg_nsect(CHANNEL) ((CHANNEL)->reg_base + 2)  /* Sector Count. */
 #define reg_lbal(CHANNEL) ((CHANNEL)->reg_base + 3)   /* LBA 0:7. */
 #define reg_lbam(CHANNEL) ((CHANNEL)->reg_base + 4)   /* LBA 15:8. */
@@ -34,6 +86,27 @@
 #define STA_BSY 0x80  /* Busy. */
 #define STA_DRDY 0x40 /* Device Ready. */
 #define STA_DRQ 0x08  /* Data Request. */
+#define STA_ERR 0x01  /* Error. */
+
+/* Bus master IDE port addresses. */
+#define reg_bm_command(CHANNEL) ((CHANNEL)->bm_base + 0) /* Bus master command. */
+#define reg_bm_status(CHANNEL) ((CHANNEL)->bm_base + 2)  /* Bus master status. */
+#define reg_bm_prdt(CHANNEL) ((CHANNEL)->bm_base + 4)    /* PRD table address. */
+
+/* Bus master command register bits. */
+#define BM_START 0x01 /* Start transfer. */
+#define BM_READ 0x08  /* Transfer from disk to memory. */
+
+/* Bus master status register bits. */
+#define BM_ERROR 0x02 /* Transfer failed.  Write 1 to clear. */
+#define BM_IRQ 0x04   /* Disk raised its interrupt.  Write 1 to clear. */
+
+/* PCI class code of IDE controllers, and bit of the
+   programming interface that says they can master the bus. */
+#define PCI_CLASS_STORAGE 0x01 /* Mass storage controller. */
+#define PCI_SUBCLASS_IDE 0x01  /* IDE controller. */
+#define PROG_IF_NATIVE 0x05    /* Either channel in PCI native mode. */
+#define PROG_IF_BM 0x80        /* Bus mastering supported. */
 
 /* Control Register bits. */
 #define CTL_SRST 0x04 /* Software Reset. */
@@ -47,15 +120,57 @@
    Many more are defined but this is the small subset that we
    use. */
 #define CMD_IDENTIFY_DEVICE 0xec    /* IDENTIFY DEVICE. */
-#define CMD_READ_SECTOR_RETRY 0x20  /* READ SECTOR with retries. */
-#define CMD_WRITE_SECTOR_RETRY 0x30 /* WRITE SECTOR with retries. */
+#define CMD_READ_SECTOR_RETRY 0x20  /* READ SECTOR(S) with retries. */
+#define CMD_WRITE_SECTOR_RETRY 0x30 /* WRITE SECTOR(S) with retries. */
+#define CMD_READ_DMA 0xc8           /* READ DMA. */
+#define CMD_WRITE_DMA 0xca          /* WRITE DMA. */
+#define CMD_READ_SECTOR_EXT 0x24    /* READ SECTOR(S) EXT. */
+#define CMD_WRITE_SECTOR_EXT 0x34   /* WRITE SECTOR(S) EXT. */
+#define CMD_READ_DMA_EXT 0x25       /* READ DMA EXT. */
+#define CMD_WRITE_DMA_EXT 0x35      /* WRITE DMA EXT. */
+#define CMD_FLUSH_CACHE 0xe7        /* FLUSH CACHE. */
+#define CMD_FLUSH_CACHE_EXT 0xea    /* FLUSH CACHE EXT. */
+#define CMD_SET_FEATURES 0xef       /* SET FEATURES. */
+
+/* SET FEATURES subcommands, written to the features register. */
+#define FEAT_WRITE_CACHE_ON 0x02 /* Enable the volatile write cache. */
+
+/* Sectors that 28-bit LBAs reach. */
+#define LBA28_SECTORS (1UL << 28)
+
+/* Most sectors one READ or WRITE SECTOR(S) command transfers.
+   A sector count register of 0 means this many.  The EXT
+   commands could move more, but we stay within the 28-bit
+   limit for both. */
+#define MAX_SECTORS_PER_CMD 256
+
+/* Requests within this many priority levels of the highest in a
+   disk's queue are served together, in C-LOOK order. */
+#define PRI_BAND 4
+
+/* A physical region descriptor, one entry in the table that
+   tells the bus master where a DMA transfer goes.  A region
+   may not cross a 64 kB boundary. */
+struct prd {
+  uint32_t addr;  /* Physical address, even. */
+  uint16_t size;  /* Bytes, even; 0 means 64 kB. */
+  uint16_t flags; /* PRD_EOT in the table's last entry. */
+};
+#define PRD_EOT 0x8000                        /* End of table. */
+#define PRD_CNT (PGSIZE / sizeof(struct prd)) /* Entries in a table. */
 
 /* An ATA device. */
 struct ata_disk {
   char name[8];            /* Name, e.g. "hda". */
   struct channel* channel; /* Channel that disk is attached to. */
   int dev_no;              /* Device 0 or 1 for master or slave. */
+  bool present;            /* Does the channel seem to have this device? */
   bool is_ata;             /* Is device an ATA disk? */
+  bool dma;                /* Does the disk support DMA? */
+  bool lba48;              /* Does the disk support 48-bit LBAs? */
+  bool write_cache;        /* Is the disk's write cache on? */
+  struct list queue;       /* Requests waiting to be served. */
+  block_sector_t head;     /* Sector just past the last one served. */
 };
 
 /* An ATA channel (aka controller).
@@ -64,12 +179,25 @@ struct channel {
   char name[8];      /* Name, e.g. "ide0". */
   uint16_t reg_base; /* Base I/O port. */
   uint8_t irq;       /* Interrupt in use. */
+  uint16_t bm_base;  /* Bus master I/O port, or 0 if none. */
+  struct prd* prdt;  /* Physical region descriptor table. */
 
-  struct lock lock;                 /* Must acquire to access the controller. */
   bool expecting_interrupt;         /* True if an interrupt is expected, false if
                                    any interrupt would be spurious. */
   struct semaphore completion_wait; /* Up'd by interrupt handler. */
 
+  /* Request being served. */
+  struct ata_disk* disk;        /* Disk served last, or null. */
+  struct block_request* active; /* Requests in service, linked by NEXT, or null. */
+  size_t active_done;           /* Sectors of ACTIVE transferred. */
+  size_t cmd_left;              /* Sectors left in the command in progress. */
+  bool cmd_dma;                 /* Command in progress uses DMA? */
+
+  /* Requests finished, linked by NEXT, to be completed. */
+  struct block_request* done;       /* First, or null. */
+  struct block_request** done_tail; /* Link to append to. */
+  struct intr_work done_work;       /* Calls complete_done(). */
+
   struct ata_disk devices[2]; /* The devices on this channel. */
 };
 
@@ -77,26 +205,49 @@ struct channel {
 #define CHANNEL_CNT 2
 static struct channel channels[CHANNEL_CNT];
 
+/* -no-dma: Transfer by PIO only? */
+bool ide_no_dma;
+
+/* -big-disks: Use disks over 1 GB? */
+bool ide_big_disks;
+
 static struct block_operations ide_operations;
 
-static void reset_channel(struct channel*);
+static uint16_t find_bus_master(void);
+
+static void start_reset(struct channel*);
+static void finish_reset(struct channel*);
 static bool check_device_type(struct ata_disk*);
 static void identify_ata_device(struct ata_disk*);
-
-static void select_sector(struct ata_disk*, block_sector_t);
+static bool enable_write_cache(struct ata_disk*);
+
+static bool select_sector(struct ata_disk*, block_sector_t, size_t cnt);
+static void start_next(struct channel*);
+static void start_command(struct channel*);
+static void service(struct channel*);
+static void push_done(struct channel*, struct block_request*);
+static intr_work_func complete_done;
 static void issue_pio_command(struct channel*, uint8_t command);
 static void input_sector(struct channel*, void*);
 static void output_sector(struct channel*, const void*);
 
 static void wait_until_idle(const struct ata_disk*);
 static bool wait_while_busy(const struct ata_disk*);
+static bool wait_for_drq(const struct ata_disk*);
 static void select_device(const struct ata_disk*);
 static void select_device_wait(const struct ata_disk*);
 
 static void interrupt_handler(struct intr_frame*);
 
-/* Initialize the disk subsystem and detect disks. */
+/* Initialize the disk subsystem and detect disks.
+
+   Both channels are reset at once, so that the time their
+   devices take to come out of reset overlaps, and the reset is
+   waited for by polling the devices that answer rather than by
+   sleeping a fixed time.  A channel that nothing answers on is
+   not waited for at all. */
 void ide_init(void) {
+  uint16_t bm_base = find_bus_master();
   size_t chan_no;
 
   for (chan_no = 0; chan_no < CHANNEL_CNT; chan_no++) {
@@ -117,9 +268,19 @@ void ide_init(void) {
       default:
         NOT_REACHED();
     }
-    lock_init(&c->lock);
     c->expecting_interrupt = false;
     sema_init(&c->completion_wait, 0);
+    c->disk = NULL;
+    c->active = NULL;
+    c->done = NULL;
+    c->done_tail = &c->done;
+    intr_work_init(&c->done_work, complete_done, c);
+    c->bm_base = 0;
+    c->prdt = NULL;
+    if (bm_base != 0) {
+      c->bm_base = bm_base + chan_no * 8;
+      c->prdt = palloc_get_page(PAL_ASSERT);
+    }
 
     /* Initialize devices. */
     for (dev_no = 0; dev_no < 2; dev_no++) {
@@ -127,14 +288,33 @@ void ide_init(void) {
       snprintf(d->name, sizeof d->name, "hd%c", 'a' + chan_no * 2 + dev_no);
       d->channel = c;
       d->dev_no = dev_no;
+      d->present = false;
       d->is_ata = false;
+      d->dma = false;
+      d->lba48 = false;
+      list_init(&d->queue);
+      d->head = 0;
     }
 
     /* Register interrupt handler. */
     intr_register_ext(c->irq, interrupt_handler, c->name);
 
-    /* Reset hardware. */
-    reset_channel(c);
+    /* Start resetting hardware. */
+    start_reset(c);
+  }
+
+  /* ATA-3 has the host wait 2 ms after a reset before it looks
+     at BSY. */
+  timer_msleep(2);
+
+  for (chan_no = 0; chan_no < CHANNEL_CNT; chan_no++) {
+    struct channel* c = &channels[chan_no];
+    int dev_no;
+
+    /* Finish resetting hardware. */
+    finish_reset(c);
+    if (!c->devices[0].present && !c->devices[1].present)
+      continue;
 
     /* Distinguish ATA hard disks from other devices. */
     if (check_device_type(&c->devices[0]))
@@ -151,12 +331,36 @@ void ide_init(void) {
 
 static char* descramble_ata_string(char*, int size);
 
-/* Resets an ATA channel and waits for any devices present on it
-   to finish the reset. */
-static void reset_channel(struct channel* c) {
-  bool present[2];
+/* Looks for a PCI IDE controller that can master the bus and
+   drives the legacy channels at their legacy ports.  If there
+   is one, enables it as a bus master and returns the base of
+   its bus master ports; otherwise, returns 0. */
+static uint16_t find_bus_master(void) {
+  struct pci_addr a;
+  uint8_t prog_if;
+
+  if (!pci_find_class(PCI_CLASS_STORAGE, PCI_SUBCLASS_IDE, &a))
+    return 0;
+  prog_if = pci_read_config(&a, PCI_CLASS) >> 8;
+  if (!(prog_if & PROG_IF_BM) || (prog_if & PROG_IF_NATIVE))
+    return 0;
+
+  pci_write_config(&a, PCI_COMMAND,
+                   pci_read_config(&a, PCI_COMMAND) | PCI_CMD_IO | PCI_CMD_MASTER);
+  return pci_read_config(&a, PCI_BAR0 + 4 * 4) & 0xfffc;
+}
+
+/* Detects which devices seem present on channel C and, if
+   either does, starts resetting them.  finish_reset() waits for
+   them to finish. */
+static void start_reset(struct channel* c) {
   int dev_no;
 
+  /* With no device attached, nothing drives the bus and the
+     status register reads as all 1s. */
+  if (inb(reg_status(c)) == 0xff)
+    return;
+
   /* The ATA reset sequence depends on which devices are present,
      so we start by detecting device presence. */
   for (dev_no = 0; dev_no < 2; dev_no++) {
@@ -173,8 +377,10 @@ static void reset_channel(struct channel* c) {
     outb(reg_nsect(c), 0x55);
     outb(reg_lbal(c), 0xaa);
 
-    present[dev_no] = (inb(reg_nsect(c)) == 0x55 && inb(reg_lbal(c)) == 0xaa);
+    d->present = (inb(reg_nsect(c)) == 0x55 && inb(reg_lbal(c)) == 0xaa);
   }
+  if (!c->devices[0].present && !c->devices[1].present)
+    return;
 
   /* Issue soft reset sequence, which selects device 0 as a side effect.
      Also enable interrupts. */
@@ -183,17 +389,19 @@ static void reset_channel(struct channel* c) {
   outb(reg_ctl(c), CTL_SRST);
   timer_usleep(10);
   outb(reg_ctl(c), 0);
+}
 
-  timer_msleep(150);
-
+/* Waits for any devices present on channel C to finish the reset
+   that start_reset() began. */
+static void finish_reset(struct channel* c) {
   /* Wait for device 0 to clear BSY. */
-  if (present[0]) {
+  if (c->devices[0].present) {
     select_device(&c->devices[0]);
     wait_while_busy(&c->devices[0]);
   }
 
   /* Wait for device 1 to clear BSY. */
-  if (present[1]) {
+  if (c->devices[1].present) {
     int i;
 
     select_device(&c->devices[1]);
@@ -257,22 +465,33 @@ static void identify_ata_device(struct ata_disk* d) {
   }
   input_sector(c, id);
 
-  /* Calculate capacity.
-     Read model name and serial number. */
+  /* Calculate capacity, from the 48-bit sector count if the disk
+     supports 48-bit LBAs, but no more than a block_sector_t can
+     count.  Read model name and serial number. */
   capacity = *(uint32_t*)&id[60 * 2];
+  d->dma = c->bm_base != 0 && (*(uint16_t*)&id[49 * 2] & 0x100);
+  d->lba48 = (*(uint16_t*)&id[83 * 2] & 0x400) != 0;
+  if (d->lba48) {
+    uint64_t capacity48 = *(uint64_t*)&id[100 * 2];
+    capacity = capacity48 < UINT32_MAX ? capacity48 : UINT32_MAX;
+  }
+  if (*(uint16_t*)&id[82 * 2] & 0x20)
+    d->write_cache = enable_write_cache(d);
   model = descramble_ata_string(&id[10 * 2], 20);
   serial = descramble_ata_string(&id[27 * 2], 40);
-  snprintf(extra_info, sizeof extra_info, "model \"%s\", serial \"%s\"", model, serial);
+  snprintf(extra_info, sizeof extra_info, "model \"%s\", serial \"%s\"%s%s%s", model,
+           serial, d->lba48 ? ", LBA48" : "", d->dma ? ", DMA" : "",
+           d->write_cache ? ", write cache" : "");
 
   /* Disable access to IDE disks over 1 GB, which are likely
-     physical IDE disks rather than virtual ones.  If we don't
-     allow access to those, we're less likely to scribble on
-     someone's important data.  You can disable this check by
-     hand if you really want to do so. */
-  if (capacity >= 1024 * 1024 * 1024 / BLOCK_SECTOR_SIZE) {
+     physical IDE disks rather than virtual ones, unless
+     -big-disks says otherwise.  If we don't allow access to
+     those, we're less likely to scribble on someone's important
+     data. */
+  if (capacity >= 1024 * 1024 * 1024 / BLOCK_SECTOR_SIZE && !ide_big_disks) {
     printf("%s: ignoring ", d->name);
-    print_human_readable_size(capacity * 512);
-    printf("disk for safety\n");
+    print_human_readable_size((uint64_t)capacity * BLOCK_SECTOR_SIZE);
+    printf("disk for safety (use -big-disks to allow)\n");
     d->is_ata = false;
     return;
   }
@@ -282,6 +501,19 @@ static void identify_ata_device(struct ata_disk* d) {
   partition_scan(block);
 }
 
+/* Turns on disk D's write cache with SET FEATURES.  Returns
+   true if successful. */
+static bool enable_write_cache(struct ata_disk* d) {
+  struct channel* c = d->channel;
+
+  select_device_wait(d);
+  outb(reg_feature(c), FEAT_WRITE_CACHE_ON);
+  issue_pio_command(c, CMD_SET_FEATURES);
+  sema_down(&c->completion_wait);
+  wait_while_busy(d);
+  return !(inb(reg_alt_status(c)) & STA_ERR);
+}
+
 /* Translates STRING, which consists of SIZE bytes in a funky
    format, into a null-terminated string in-place.  Drops
    trailing whitespace and null bytes.  Returns STRING.  */
@@ -306,57 +538,381 @@ static char* descramble_ata_string(char* string, int size) {
   return string;
 }
 
-/* Reads sector SEC_NO from disk D into BUFFER, which must have
-   room for BLOCK_SECTOR_SIZE bytes.
-   Internally synchronizes accesses to disks, so external
-   per-disk locking is unneeded. */
-static void ide_read(void* d_, block_sector_t sec_no, void* buffer) {
-  struct ata_disk* d = d_;
-  struct channel* c = d->channel;
-  lock_acquire(&c->lock);
-  select_sector(d, sec_no);
-  issue_pio_command(c, CMD_READ_SECTOR_RETRY);
-  sema_down(&c->completion_wait);
-  if (!wait_while_busy(d))
-    PANIC("%s: disk read failed, sector=%" PRDSNu, d->name, sec_no);
-  input_sector(c, buffer);
-  lock_release(&c->lock);
+/* Request queueing. */
+
+/* Returns the number of sectors in the chain of requests that
+   starts at R. */
+static size_t chain_cnt(const struct block_request* r) {
+  size_t cnt = 0;
+
+  for (; r != NULL; r = r->next)
+    cnt += r->cnt;
+  return cnt;
 }
 
-/* Write sector SEC_NO to disk D from BUFFER, which must contain
-   BLOCK_SECTOR_SIZE bytes.  Returns after the disk has
-   acknowledged receiving the data.
-   Internally synchronizes accesses to disks, so external
-   per-disk locking is unneeded. */
-static void ide_write(void* d_, block_sector_t sec_no, const void* buffer) {
+/* Returns the highest priority of a request in the chain that
+   starts with R, at NOW_NS. */
+static int chain_priority(const struct block_request* r, int64_t now_ns) {
+  int priority = PRI_MIN;
+
+  for (; r != NULL; r = r->next) {
+    int p = block_request_priority(r, now_ns);
+    if (p > priority)
+      priority = p;
+  }
+  return priority;
+}
+
+/* Tries to merge R into a request waiting in D's queue that it
+   directly follows or precedes in the same direction.  Returns
+   true if successful.  Flushes are not merged.  Interrupts must
+   be off. */
+static bool merge(struct ata_disk* d, struct block_request* r) {
+  struct list_elem* e;
+
+  for (e = list_begin(&d->queue); e != list_end(&d->queue); e = list_next(e)) {
+    struct block_request* q = list_entry(e, struct block_request, elem);
+    size_t cnt = chain_cnt(q);
+
+    if (q->write != r->write || q->cnt == 0 || cnt + r->cnt > MAX_SECTORS_PER_CMD)
+      continue;
+    if (q->sector + cnt == r->sector) {
+      struct block_request* last = q;
+
+      while (last->next != NULL)
+        last = last->next;
+      last->next = r;
+      return true;
+    }
+    if (r->sector + r->cnt == q->sector) {
+      r->next = q;
+      list_insert(&q->elem, &r->elem);
+      list_remove(&q->elem);
+      return true;
+    }
+  }
+  return false;
+}
+
+/* Queues request R for disk D_ and returns at once.  The
+   interrupt handler completes it. */
+static void ide_submit(void* d_, struct block_request* r) {
   struct ata_disk* d = d_;
   struct channel* c = d->channel;
-  lock_acquire(&c->lock);
-  select_sector(d, sec_no);
-  issue_pio_command(c, CMD_WRITE_SECTOR_RETRY);
-  if (!wait_while_busy(d))
-    PANIC("%s: disk write failed, sector=%" PRDSNu, d->name, sec_no);
-  output_sector(c, buffer);
-  sema_down(&c->completion_wait);
-  lock_release(&c->lock);
+  enum intr_level old_level;
+
+  ASSERT(d->lba48 || r->sector + r->cnt <= LBA28_SECTORS);
+
+  /* Without a write cache, completed writes are durable already. */
+  if (r->cnt == 0 && !d->write_cache) {
+    r->complete(r);
+    return;
+  }
+
+  r->next = NULL;
+  old_level = intr_disable();
+  if (r->cnt == 0 || !merge(d, r))
+    list_push_back(&d->queue, &r->elem);
+  if (c->active == NULL)
+    start_next(c);
+  intr_set_level(old_level);
 }
 
-static struct block_operations ide_operations = {ide_read, ide_write};
+static struct block_operations ide_operations = {NULL, NULL, NULL, NULL, ide_submit};
+
+/* Removes and returns the next request for D to serve: a flush
+   if one is waiting, otherwise the next in C-LOOK order of those
+   within PRI_BAND of the highest priority.  D's queue must not
+   be empty. */
+static struct block_request* pick_request(struct ata_disk* d) {
+  struct block_request* ahead = NULL;
+  struct block_request* lowest = NULL;
+  int64_t now = timer_ns();
+  int top = PRI_MIN;
+  struct list_elem* e;
+
+  for (e = list_begin(&d->queue); e != list_end(&d->queue); e = list_next(e)) {
+    struct block_request* r = list_entry(e, struct block_request, elem);
+    int priority = chain_priority(r, now);
+
+    if (priority > top)
+      top = priority;
+  }
+
+  for (e = list_begin(&d->queue); e != list_end(&d->queue); e = list_next(e)) {
+    struct block_request* r = list_entry(e, struct block_request, elem);
+
+    if (r->cnt == 0) {
+      ahead = r;
+      break;
+    }
+    if (chain_priority(r, now) < top - PRI_BAND)
+      continue;
+    if (r->sector >= d->head && (ahead == NULL || r->sector < ahead->sector))
+      ahead = r;
+    if (lowest == NULL || r->sector < lowest->sector)
+      lowest = r;
+  }
+  if (ahead == NULL)
+    ahead = lowest;
+  list_remove(&ahead->elem);
+  return ahead;
+}
+
+/* Starts serving the next request on channel C, if any, taking
+   the disk not served last first.  C must be idle and interrupts
+   must be off. */
+static void start_next(struct channel* c) {
+  int first = c->disk == &c->devices[0] ? 1 : 0;
+  int i;
+
+  ASSERT(c->active == NULL);
+  for (i = 0; i < 2; i++) {
+    struct ata_disk* d = &c->devices[(first + i) % 2];
+
+    if (!list_empty(&d->queue)) {
+      c->disk = d;
+      c->active = pick_request(d);
+      c->active_done = 0;
+      start_command(c);
+      return;
+    }
+  }
+}
+
+/* Returns the buffer for the next sector of channel C's active
+   request. */
+static uint8_t* active_buffer(const struct channel* c) {
+  return (uint8_t*)c->active->buffer + c->active_done * BLOCK_SECTOR_SIZE;
+}
+
+/* Fills in channel C's physical region descriptor table for the
+   next CNT sectors of its active chain of requests.  Returns
+   false if they do not fit in the table or a buffer is not
+   suitably aligned for DMA. */
+static bool build_prdt(struct channel* c, size_t cnt) {
+  struct block_request* r = c->active;
+  size_t done = c->active_done;
+  size_t i = 0;
+
+  while (cnt > 0) {
+    size_t n = r->cnt - done < cnt ? r->cnt - done : cnt;
+    const uint8_t* buffer = (const uint8_t*)r->buffer + done * BLOCK_SECTOR_SIZE;
+    size_t size = n * BLOCK_SECTOR_SIZE;
+
+    /* Kernel virtual memory is mapped linearly onto physical
+       memory, so the buffer is physically contiguous too, unless
+       it lies within one page that kmap() mapped. */
+    if ((uintptr_t)buffer % 2 != 0)
+      return false;
+    while (size > 0) {
+      uintptr_t paddr = kmap_vtop(buffer);
+      size_t chunk = 0x10000 - (paddr & 0xffff); /* Up to the next 64 kB boundary. */
+
+      if (chunk > size)
+        chunk = size;
+      if (i == PRD_CNT)
+        return false;
+      c->prdt[i].addr = paddr;
+      c->prdt[i].size = chunk & 0xffff;
+      c->prdt[i].flags = 0;
+      i++;
+      buffer += chunk;
+      size -= chunk;
+    }
+
+    cnt -= n;
+    r = r->next;
+    done = 0;
+  }
+  c->prdt[i - 1].flags = PRD_EOT;
+  return true;
+}
+
+/* Issues the command for as much of channel C's active chain of
+   requests, from where it stands, as one command can transfer.
+   For a PIO write, also hands the disk the first sector.  For a
+   flush, issues FLUSH CACHE. */
+static void start_command(struct channel* c) {
+  struct ata_disk* d = c->disk;
+  struct block_request* r = c->active;
+  block_sector_t sector = r->sector + c->active_done;
+  size_t cnt = chain_cnt(r) - c->active_done;
+  bool ext;
+
+  if (r->cnt == 0) {
+    c->cmd_left = 0;
+    c->cmd_dma = false;
+    select_device_wait(d);
+    outb(reg_command(c), d->lba48 ? CMD_FLUSH_CACHE_EXT : CMD_FLUSH_CACHE);
+    return;
+  }
+  c->cmd_left = cnt < MAX_SECTORS_PER_CMD ? cnt : MAX_SECTORS_PER_CMD;
+  c->cmd_dma = d->dma && !ide_no_dma && build_prdt(c, c->cmd_left);
+  ext = select_sector(d, sector, c->cmd_left);
+  if (c->cmd_dma) {
+    outl(reg_bm_prdt(c), vtop(c->prdt));
+    outb(reg_bm_command(c), r->write ? 0 : BM_READ);
+    outb(reg_bm_status(c), inb(reg_bm_status(c)) | BM_ERROR | BM_IRQ);
+    if (ext)
+      outb(reg_command(c), r->write ? CMD_WRITE_DMA_EXT : CMD_READ_DMA_EXT);
+    else
+      outb(reg_command(c), r->write ? CMD_WRITE_DMA : CMD_READ_DMA);
+    outb(reg_bm_command(c), (r->write ? 0 : BM_READ) | BM_START);
+    return;
+  }
+  if (ext)
+    outb(reg_command(c), r->write ? CMD_WRITE_SECTOR_EXT : CMD_READ_SECTOR_EXT);
+  else
+    outb(reg_command(c), r->write ? CMD_WRITE_SECTOR_RETRY : CMD_READ_SECTOR_RETRY);
+  if (r->write) {
+    if (!wait_for_drq(d))
+      PANIC("%s: disk write failed, sector=%" PRDSNu, d->name, sector);
+    output_sector(c, active_buffer(c));
+  }
+}
+
+/* Marks the next CNT sectors of channel C's active command
+   transferred, completing each request in the chain that they
+   finish. */
+static void advance(struct channel* c, size_t cnt) {
+  struct ata_disk* d = c->disk;
+
+  ASSERT(cnt <= c->cmd_left);
+  c->cmd_left -= cnt;
+  while (cnt > 0) {
+    struct block_request* r = c->active;
+    size_t n = r->cnt - c->active_done < cnt ? r->cnt - c->active_done : cnt;
+
+    c->active_done += n;
+    cnt -= n;
+
+    if (c->active_done == r->cnt) {
+      d->head = r->sector + r->cnt;
+      c->active = r->next;
+      c->active_done = 0;
+      push_done(c, r);
+    }
+  }
+}
+
+/* Appends R, which channel C has finished, to C's done list. */
+static void push_done(struct channel* c, struct block_request* r) {
+  r->next = NULL;
+  *c->done_tail = r;
+  c->done_tail = &r->next;
+  intr_defer(&c->done_work);
+}
+
+/* Completes the requests on channel C_'s done list, in the order
+   they finished.  Deferred by advance(). */
+static void complete_done(void* c_) {
+  struct channel* c = c_;
+
+  for (;;) {
+    enum intr_level old_level = intr_disable();
+    struct block_request* r = c->done;
+
+    if (r == NULL) {
+      intr_set_level(old_level);
+      break;
+    }
+    c->done = r->next;
+    if (c->done == NULL)
+      c->done_tail = &c->done;
+
+    /* R may be freed as soon as it is completed. */
+    r->complete(r);
+    intr_set_level(old_level);
+  }
+}
+
+/* Handles the interrupt that channel C's disk raises when it has
+   finished a DMA command or a flush, or has read a sector for a
+   PIO command or finished writing one: moves the sector in the
+   PIO case, completes the requests that are done, and continues
+   with the rest of the command or the next one. */
+static void service(struct channel* c) {
+  struct ata_disk* d = c->disk;
+  struct block_request* r = c->active;
+  uint8_t status;
+
+  if (r->cnt == 0) {
+    status = inb(reg_status(c)); /* Also acknowledges the interrupt. */
+    if (status & STA_ERR)
+      PANIC("%s: cache flush failed", d->name);
+    c->active = NULL;
+    push_done(c, r);
+  } else if (c->cmd_dma) {
+    uint8_t bm_status = inb(reg_bm_status(c));
+
+    if (!(bm_status & BM_IRQ))
+      return; /* Not our disk's interrupt. */
+    outb(reg_bm_command(c), 0);
+    status = inb(reg_status(c)); /* Also acknowledges the interrupt. */
+    outb(reg_bm_status(c), BM_ERROR | BM_IRQ);
+    if ((status & STA_ERR) || (bm_status & BM_ERROR))
+      PANIC("%s: DMA %s failed, sector=%" PRDSNu, d->name, r->write ? "write" : "read",
+            r->sector + c->active_done);
+    advance(c, c->cmd_left);
+  } else {
+    status = inb(reg_status(c)); /* Also acknowledges the interrupt. */
+    if ((status & STA_ERR) || (!r->write && !(status & STA_DRQ)))
+      PANIC("%s: disk %s failed, sector=%" PRDSNu, d->name, r->write ? "write" : "read",
+            r->sector + c->active_done);
+    if (!r->write)
+      input_sector(c, active_buffer(c));
+    advance(c, 1);
+  }
+
+  if (c->cmd_left > 0) {
+    if (c->active->write) {
+      if (!wait_for_drq(d))
+        PANIC("%s: disk write failed, sector=%" PRDSNu, d->name,
+              c->active->sector + c->active_done);
+      output_sector(c, active_buffer(c));
+    }
+  } else if (c->active != NULL)
+    start_command(c);
+  else
+    start_next(c);
+}
 
 /* Selects device D, waiting for it to become ready, and then
-   writes SEC_NO to the disk's sector selection registers.  (We
-   use LBA mode.) */
-static void select_sector(struct ata_disk* d, block_sector_t sec_no) {
+   writes SEC_NO and the count CNT of sectors to transfer, at
+   most MAX_SECTORS_PER_CMD, to the disk's sector selection
+   registers.  (We use LBA mode.)  Returns true if the sectors
+   lie beyond the reach of 28-bit LBAs, so that they were
+   written for one of the EXT commands, which must follow. */
+static bool select_sector(struct ata_disk* d, block_sector_t sec_no, size_t cnt) {
   struct channel* c = d->channel;
 
-  ASSERT(sec_no < (1UL << 28));
+  ASSERT(cnt > 0 && cnt <= MAX_SECTORS_PER_CMD);
 
   select_device_wait(d);
-  outb(reg_nsect(c), 1);
+  if ((uint64_t)sec_no + cnt > LBA28_SECTORS) {
+    /* Each register is a two-byte FIFO: the high-order bytes go
+       in first, then the low-order bytes.  LBA bits 47:32 are
+       always 0 for a block_sector_t. */
+    ASSERT(d->lba48);
+    outb(reg_nsect(c), cnt >> 8);
+    outb(reg_lbal(c), sec_no >> 24);
+    outb(reg_lbam(c), 0);
+    outb(reg_lbah(c), 0);
+    outb(reg_nsect(c), cnt);
+    outb(reg_lbal(c), sec_no);
+    outb(reg_lbam(c), sec_no >> 8);
+    outb(reg_lbah(c), sec_no >> 16);
+    outb(reg_device(c), DEV_MBS | DEV_LBA | (d->dev_no == 1 ? DEV_DEV : 0));
+    return true;
+  }
+
+  outb(reg_nsect(c), cnt % MAX_SECTORS_PER_CMD);
   outb(reg_lbal(c), sec_no);
   outb(reg_lbam(c), sec_no >> 8);
   outb(reg_lbah(c), (sec_no >> 16));
   outb(reg_device(c), DEV_MBS | DEV_LBA | (d->dev_no == 1 ? DEV_DEV : 0) | (sec_no >> 24));
+  return false;
 }
 
 /* Writes COMMAND to channel C and prepares for receiving a
@@ -382,9 +938,10 @@ static void output_sector(struct channel* c, const void* sector) {
   outsw(reg_data(c), sector, BLOCK_SECTOR_SIZE / 2);
 }
 
-/* Low-level ATA primitives. */
+/* Low-level ATA primitives.  Those that wait busy-wait, so that
+   the interrupt handler can use them. */
 
-/* Wait up to 10 seconds for the controller to become idle, that
+/* Wait up to 10 ms for the controller to become idle, that
    is, for the BSY and DRQ bits to clear in the status register.
 
    As a side effect, reading the status register clears any
@@ -395,7 +952,7 @@ static void wait_until_idle(const struct ata_disk* d) {
   for (i = 0; i < 1000; i++) {
     if ((inb(reg_status(d->channel)) & (STA_BSY | STA_DRQ)) == 0)
       return;
-    timer_usleep(10);
+    timer_udelay(10);
   }
 
   printf("%s: idle timeout\n", d->name);
@@ -424,6 +981,22 @@ static bool wait_while_busy(const struct ata_disk* d) {
   return false;
 }
 
+/* Wait up to 10 ms for disk D to clear BSY, and then return the
+   status of the DRQ bit.  Does not sleep. */
+static bool wait_for_drq(const struct ata_disk* d) {
+  struct channel* c = d->channel;
+  int i;
+
+  for (i = 0; i < 1000; i++) {
+    uint8_t status = inb(reg_alt_status(c));
+
+    if (!(status & STA_BSY))
+      return (status & STA_DRQ) != 0;
+    timer_udelay(10);
+  }
+  return false;
+}
+
 /* Program D's channel so that D is now the selected disk. */
 static void select_device(const struct ata_disk* d) {
   struct channel* c = d->channel;
@@ -432,7 +1005,7 @@ static void select_device(const struct ata_disk* d) {
     dev |= DEV_DEV;
   outb(reg_device(c), dev);
   inb(reg_alt_status(c));
-  timer_nsleep(400);
+  timer_ndelay(400);
 }
 
 /* Select disk D in its channel, as select_device(), but wait for
@@ -449,7 +1022,9 @@ static void interrupt_handler(struct intr_frame* f) {
 
   for (c = channels; c < channels + CHANNEL_CNT; c++)
     if (f->vec_no == c->irq) {
-      if (c->expecting_interrupt) {
+      if (c->active != NULL)
+        service(c);
+      else if (c->expecting_interrupt) {
         inb(reg_status(c));           /* Acknowledge interrupt. */
         sema_up(&c->completion_wait); /* Wake up waiter. */
       } else
@@ -1,6 +1,14 @@
 #ifndef DEVICES_IDE_H
 #define DEVICES_IDE_H
 
+#include <stdbool.h>
+
+/* -no-dma: Transfer by PIO only? */
+extern bool ide_no_dma;
+
+/* -big-disks: Use disks over 1 GB? */
+extern bool ide_big_disks;
+
 void ide_init(void);
 
 #endif /* devices/ide.h */
@@ -2,12 +2,20 @@
 #include <debug.h>
 #include "devices/intq.h"
 #include "devices/serial.h"
+#include "threads/waitq.h"
 
 /* Stores keys from the keyboard and serial port. */
 static struct intq buffer;
 
+/* Threads polling for keys (see input_poll()).  The intq itself
+   wakes only the one thread blocked reading it. */
+static struct waitq pollers;
+
 /* Initializes the input buffer. */
-void input_init(void) { intq_init(&buffer); }
+void input_init(void) {
+  intq_init(&buffer);
+  waitq_init(&pollers);
+}
 
 /* Adds a key to the input buffer.
    Interrupts must be off and the buffer must not be full. */
@@ -17,6 +25,7 @@ void input_putc(uint8_t key) {
 
   intq_putc(&buffer, key);
   serial_notify();
+  waitq_wake(&pollers);
 }
 
 /* Retrieves a key from the input buffer.
@@ -33,6 +42,73 @@ uint8_t input_getc(void) {
   return key;
 }
 
+/* Returns true if the input buffer holds a key.  If E is not
+   null, first puts it in the queue of waiters that a new key
+   wakes, on behalf of W. */
+bool input_poll(struct waitq_entry* e, struct waitq_waiter* w) {
+  enum intr_level old_level;
+  bool ready;
+
+  if (e != NULL)
+    waitq_add(&pollers, e, w);
+  old_level = intr_disable();
+  ready = !intq_empty(&buffer);
+  intr_set_level(old_level);
+  return ready;
+}
+
+/* Retrieves SIZE keys from the input buffer into KEYS, waiting
+   for keys to be pressed as necessary. */
+void input_getbuf(void* keys_, size_t size) {
+  uint8_t* keys = keys_;
+  enum intr_level old_level;
+
+  old_level = intr_disable();
+  while (size > 0) {
+    /* Take what is buffered, or wait for one key.  The serial
+       port must hear that there is room again before we wait. */
+    size_t chunk = INTQ_BUFSIZE - intq_space(&buffer);
+    if (chunk == 0)
+      chunk = 1;
+    else if (chunk > size)
+      chunk = size;
+
+    intq_getbuf(&buffer, keys, chunk);
+    serial_notify();
+    keys += chunk;
+    size -= chunk;
+  }
+  intr_set_level(old_level);
+}
+
+/* Retrieves up to SIZE keys from the input buffer into KEYS and
+   returns the number retrieved.  If BLOCK is true and the buffer
+   is empty, first waits for a key to be pressed; otherwise never
+   waits, so that a caller can return a short read as soon as
+   some input is there. */
+size_t input_read(void* keys_, size_t size, bool block) {
+  uint8_t* keys = keys_;
+  enum intr_level old_level;
+  size_t cnt = 0;
+  size_t avail;
+
+  if (size == 0)
+    return 0;
+
+  old_level = intr_disable();
+  if (block && intq_empty(&buffer))
+    keys[cnt++] = intq_getc(&buffer);
+  avail = INTQ_BUFSIZE - intq_space(&buffer);
+  if (avail > size - cnt)
+    avail = size - cnt;
+  intq_getbuf(&buffer, keys + cnt, avail);
+  cnt += avail;
+  serial_notify();
+  intr_set_level(old_level);
+
+  return cnt;
+}
+
 /* Returns true if the input buffer is full,
    false otherwise.
    Interrupts must be off. */
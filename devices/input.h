@@ -2,11 +2,18 @@
 #define DEVICES_INPUT_H
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
+struct waitq_entry;
+struct waitq_waiter;
+
 void input_init(void);
 void input_putc(uint8_t);
 uint8_t input_getc(void);
+void input_getbuf(void*, size_t);
+size_t input_read(void*, size_t, bool block);
 bool input_full(void);
+bool input_poll(struct waitq_entry*, struct waitq_waiter*);
 
 #endif /* devices/input.h */
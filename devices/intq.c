@@ -1,8 +1,14 @@
 #include "devices/intq.h"
 #include <debug.h>
+#include <string.h>
 #include "threads/thread.h"
 
-static int next(int pos);
+/* INTQ_BUFSIZE must be a power of 2. */
+#if INTQ_BUFSIZE & (INTQ_BUFSIZE - 1)
+#error INTQ_BUFSIZE must be a power of 2
+#endif
+
+static size_t intq_count(const struct intq*);
 static void wait(struct intq* q, struct thread** waiter);
 static void signal(struct intq* q, struct thread** waiter);
 
@@ -22,7 +28,14 @@ bool intq_empty(const struct intq* q) {
 /* Returns true if Q is full, false otherwise. */
 bool intq_full(const struct intq* q) {
   ASSERT(intr_get_level() == INTR_OFF);
-  return next(q->head) == q->tail;
+  return intq_count(q) == INTQ_BUFSIZE;
+}
+
+/* Returns the number of bytes that can be added to Q without
+   waiting. */
+size_t intq_space(const struct intq* q) {
+  ASSERT(intr_get_level() == INTR_OFF);
+  return INTQ_BUFSIZE - intq_count(q);
 }
 
 /* Removes a byte from Q and returns it.
@@ -31,39 +44,93 @@ bool intq_full(const struct intq* q) {
 uint8_t intq_getc(struct intq* q) {
   uint8_t byte;
 
-  ASSERT(intr_get_level() == INTR_OFF);
-  while (intq_empty(q)) {
-    ASSERT(!intr_context());
-    lock_acquire(&q->lock);
-    wait(q, &q->not_empty);
-    lock_release(&q->lock);
-  }
-
-  byte = q->buf[q->tail];
-  q->tail = next(q->tail);
-  signal(q, &q->not_full);
+  intq_getbuf(q, &byte, 1);
   return byte;
 }
 
 /* Adds BYTE to the end of Q.
    If Q is full, sleeps until a byte is removed.
    When called from an interrupt handler, Q must not be full. */
-void intq_putc(struct intq* q, uint8_t byte) {
+void intq_putc(struct intq* q, uint8_t byte) { intq_putbuf(q, &byte, 1); }
+
+/* Removes SIZE bytes from Q into BUFFER.
+   Sleeps whenever Q is empty until more bytes are added.
+   When called from an interrupt handler, Q must hold at least
+   SIZE bytes. */
+void intq_getbuf(struct intq* q, void* buffer_, size_t size) {
+  uint8_t* buffer = buffer_;
+
   ASSERT(intr_get_level() == INTR_OFF);
-  while (intq_full(q)) {
-    ASSERT(!intr_context());
-    lock_acquire(&q->lock);
-    wait(q, &q->not_full);
-    lock_release(&q->lock);
+  while (size > 0) {
+    size_t ofs, chunk;
+    bool was_full;
+
+    while (intq_empty(q)) {
+      ASSERT(!intr_context());
+      lock_acquire(&q->lock);
+      wait(q, &q->not_empty);
+      lock_release(&q->lock);
+    }
+
+    /* Copy as much as is queued, up to the end of the buffer. */
+    ofs = q->tail % INTQ_BUFSIZE;
+    chunk = intq_count(q);
+    if (chunk > size)
+      chunk = size;
+    if (chunk > INTQ_BUFSIZE - ofs)
+      chunk = INTQ_BUFSIZE - ofs;
+    memcpy(buffer, q->buf + ofs, chunk);
+
+    was_full = intq_full(q);
+    q->tail += chunk;
+    if (was_full)
+      signal(q, &q->not_full);
+
+    buffer += chunk;
+    size -= chunk;
   }
+}
+
+/* Adds the SIZE bytes in BUFFER to the end of Q.
+   Sleeps whenever Q is full until bytes are removed.
+   When called from an interrupt handler, Q must have room for
+   SIZE bytes. */
+void intq_putbuf(struct intq* q, const void* buffer_, size_t size) {
+  const uint8_t* buffer = buffer_;
+
+  ASSERT(intr_get_level() == INTR_OFF);
+  while (size > 0) {
+    size_t ofs, chunk;
+    bool was_empty;
+
+    while (intq_full(q)) {
+      ASSERT(!intr_context());
+      lock_acquire(&q->lock);
+      wait(q, &q->not_full);
+      lock_release(&q->lock);
+    }
+
+    /* Copy as much as fits, up to the end of the buffer. */
+    ofs = q->head % INTQ_BUFSIZE;
+    chunk = intq_space(q);
+    if (chunk > size)
+      chunk = size;
+    if (chunk > INTQ_BUFSIZE - ofs)
+      chunk = INTQ_BUFSIZE - ofs;
+    memcpy(q->buf + ofs, buffer, chunk);
 
-  q->buf[q->head] = byte;
-  q->head = next(q->head);
-  signal(q, &q->not_empty);
+    was_empty = intq_empty(q);
+    q->head += chunk;
+    if (was_empty)
+      signal(q, &q->not_empty);
+
+    buffer += chunk;
+    size -= chunk;
+  }
 }
 
-/* Returns the position after POS within an intq. */
-static int next(int pos) { return (pos + 1) % INTQ_BUFSIZE; }
+/* Returns the number of bytes in Q. */
+static size_t intq_count(const struct intq* q) { return q->head - q->tail; }
 
 /* WAITER must be the address of Q's not_empty or not_full
    member.  Waits until the given condition is true. */
@@ -77,9 +144,11 @@ static void wait(struct intq* q UNUSED, struct thread** waiter) {
 }
 
 /* WAITER must be the address of Q's not_empty or not_full
-   member, and the associated condition must be true.  If a
-   thread is waiting for the condition, wakes it up and resets
-   the waiting thread. */
+   member, and the associated condition must have just become
+   true.  A thread only waits while the condition is false, so
+   this is the only time it needs waking: if a thread is waiting
+   for the condition, wakes it up and resets the waiting
+   thread. */
 static void signal(struct intq* q UNUSED, struct thread** waiter) {
   ASSERT(intr_get_level() == INTR_OFF);
   ASSERT((waiter == &q->not_empty && !intq_empty(q)) || (waiter == &q->not_full && !intq_full(q)));
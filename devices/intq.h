@@ -1,6 +1,7 @@
 #ifndef DEVICES_INTQ_H
 #define DEVICES_INTQ_H
 
+#include <stddef.h>
 #include "threads/interrupt.h"
 #include "threads/synch.h"
 
@@ -17,10 +18,18 @@
    protect kernel threads from one another, not from interrupt
    handlers. */
 
-/* Queue buffer size, in bytes. */
-#define INTQ_BUFSIZE 64
+/* Queue buffer size, in bytes.  Must be a power of 2.  May be
+   overridden at build time with -DINTQ_BUFSIZE=N. */
+#ifndef INTQ_BUFSIZE
+#define INTQ_BUFSIZE 1024
+#endif
 
-/* A circular queue of bytes. */
+/* A circular queue of bytes.
+
+   HEAD and TAIL count the bytes ever added and removed, so the
+   queue holds HEAD - TAIL bytes and a position is found by
+   masking with INTQ_BUFSIZE - 1.  Only the producer advances
+   HEAD and only the consumer advances TAIL. */
 struct intq {
   /* Waiting threads. */
   struct lock lock;         /* Only one thread may wait at once. */
@@ -29,14 +38,17 @@ struct intq {
 
   /* Queue. */
   uint8_t buf[INTQ_BUFSIZE]; /* Buffer. */
-  int head;                  /* New data is written here. */
-  int tail;                  /* Old data is read here. */
+  unsigned head;             /* Bytes added. */
+  unsigned tail;             /* Bytes removed. */
 };
 
 void intq_init(struct intq*);
 bool intq_empty(const struct intq*);
 bool intq_full(const struct intq*);
+size_t intq_space(const struct intq*);
 uint8_t intq_getc(struct intq*);
 void intq_putc(struct intq*, uint8_t);
+void intq_getbuf(struct intq*, void*, size_t);
+void intq_putbuf(struct intq*, const void*, size_t);
 
 #endif /* devices/intq.h */
@@ -12,24 +12,48 @@ struct partition {
   block_sector_t start; /* First sector within device. */
 };
 
+/* State of one partition_scan(). */
+struct scan {
+  struct block* block; /* Device being scanned. */
+  void* buffer;        /* Sector buffer, reused for each table. */
+  int part_nr;         /* Partitions found so far. */
+  int table_cnt;       /* Partition tables read so far. */
+};
+
+/* Most partition tables read from one device.  A chain of
+   extended partition tables that loops back on itself is cut
+   off here. */
+#define MAX_TABLES 64
+
 static struct block_operations partition_operations;
 
-static void read_partition_table(struct block*, block_sector_t sector,
-                                 block_sector_t primary_extended_sector, int* part_nr);
+static void read_partition_table(struct scan*, block_sector_t sector,
+                                 block_sector_t primary_extended_sector);
 static void found_partition(struct block*, uint8_t type, block_sector_t start, block_sector_t size,
                             int part_nr);
 static const char* partition_type_name(uint8_t);
 
-/* Scans BLOCK for partitions of interest to Pintos. */
+/* Scans BLOCK for partitions of interest to Pintos.  Each
+   partition table is read once, into a buffer that the whole
+   scan shares. */
 void partition_scan(struct block* block) {
-  int part_nr = 0;
-  read_partition_table(block, 0, 0, &part_nr);
-  if (part_nr == 0)
+  struct scan scan;
+
+  scan.block = block;
+  scan.buffer = malloc(BLOCK_SECTOR_SIZE);
+  if (scan.buffer == NULL)
+    PANIC("Failed to allocate memory for partition table.");
+  scan.part_nr = 0;
+  scan.table_cnt = 0;
+  read_partition_table(&scan, 0, 0);
+  free(scan.buffer);
+  if (scan.part_nr == 0)
     printf("%s: Device contains no partitions\n", block_name(block));
 }
 
-/* Reads the partition table in the given SECTOR of BLOCK and
-   scans it for partitions of interest to Pintos.
+/* Reads the partition table in the given SECTOR of the device
+   that SCAN scans and scans it for partitions of interest to
+   Pintos.
 
    If SECTOR is 0, so that this is the top-level partition table
    on BLOCK, then PRIMARY_EXTENDED_SECTOR is not meaningful;
@@ -38,11 +62,11 @@ void partition_scan(struct block* block) {
    SECTOR, for use in finding logical partitions (see the large
    comment below).
 
-   PART_NR points to the number of non-empty primary or logical
-   partitions already encountered on BLOCK.  It is incremented as
-   partitions are found. */
-static void read_partition_table(struct block* block, block_sector_t sector,
-                                 block_sector_t primary_extended_sector, int* part_nr) {
+   SCAN's part_nr is the number of non-empty primary or logical
+   partitions already encountered on the device.  It is
+   incremented as partitions are found. */
+static void read_partition_table(struct scan* scan, block_sector_t sector,
+                                 block_sector_t primary_extended_sector) {
   /* Format of a partition table entry.  See [Partitions]. */
   struct partition_table_entry {
     uint8_t bootable;     /* 0x00=not bootable, 0x80=bootable. */
@@ -60,7 +84,9 @@ static void read_partition_table(struct block* block, block_sector_t sector,
     uint16_t signature;                         /* Should be 0xaa55. */
   } PACKED;
 
-  struct partition_table* pt;
+  struct block* block = scan->block;
+  struct partition_table* pt = scan->buffer;
+  struct partition_table_entry partitions[4];
   size_t i;
 
   /* Check SECTOR validity. */
@@ -70,12 +96,15 @@ static void read_partition_table(struct block* block, block_sector_t sector,
     return;
   }
 
+  if (scan->table_cnt++ >= MAX_TABLES) {
+    printf("%s: Too many partition tables, ignoring sector %" PRDSNu "\n", block_name(block),
+           sector);
+    return;
+  }
+
   /* Read sector. */
   ASSERT(sizeof *pt == BLOCK_SECTOR_SIZE);
-  pt = malloc(sizeof *pt);
-  if (pt == NULL)
-    PANIC("Failed to allocate memory for partition table.");
-  block_read(block, 0, pt);
+  block_read(block, sector, pt);
 
   /* Check signature. */
   if (pt->signature != 0xaa55) {
@@ -84,13 +113,14 @@ static void read_partition_table(struct block* block, block_sector_t sector,
     else
       printf("%s: Invalid extended partition table in sector %" PRDSNu "\n", block_name(block),
              sector);
-    free(pt);
     return;
   }
 
-  /* Parse partitions. */
-  for (i = 0; i < sizeof pt->partitions / sizeof *pt->partitions; i++) {
-    struct partition_table_entry* e = &pt->partitions[i];
+  /* Parse partitions.  They are copied out of the buffer first,
+     since reading an extended partition table reuses it. */
+  memcpy(partitions, pt->partitions, sizeof partitions);
+  for (i = 0; i < sizeof partitions / sizeof *partitions; i++) {
+    struct partition_table_entry* e = &partitions[i];
 
     if (e->size == 0 || e->type == 0) {
       /* Ignore empty partition. */
@@ -110,18 +140,15 @@ static void read_partition_table(struct block* block, block_sector_t sector,
              is nested, the offset is relative to the start of
              the extended partition that the MBR points to. */
       if (sector == 0)
-        read_partition_table(block, e->offset, e->offset, part_nr);
+        read_partition_table(scan, e->offset, e->offset);
       else
-        read_partition_table(block, e->offset + primary_extended_sector, primary_extended_sector,
-                             part_nr);
+        read_partition_table(scan, e->offset + primary_extended_sector, primary_extended_sector);
     } else {
-      ++*part_nr;
+      ++scan->part_nr;
 
-      found_partition(block, e->type, e->offset + sector, e->size, *part_nr);
+      found_partition(block, e->type, e->offset + sector, e->size, scan->part_nr);
     }
   }
-
-  free(pt);
 }
 
 /* We have found a primary or logical partition of the given TYPE
@@ -286,4 +313,30 @@ static void partition_write(void* p_, block_sector_t sector, const void* buffer)
   block_write(p->block, p->start + sector, buffer);
 }
 
-static struct block_operations partition_operations = {partition_read, partition_write};
+/* Reads the CNT sectors starting at SECTOR from partition P into
+   BUFFER, which must have room for CNT * BLOCK_SECTOR_SIZE
+   bytes. */
+static void partition_read_multiple(void* p_, block_sector_t sector, size_t cnt, void* buffer) {
+  struct partition* p = p_;
+  block_read_multiple(p->block, p->start + sector, cnt, buffer);
+}
+
+/* Writes the CNT sectors starting at SECTOR to partition P from
+   BUFFER, which must contain CNT * BLOCK_SECTOR_SIZE bytes. */
+static void partition_write_multiple(void* p_, block_sector_t sector, size_t cnt,
+                                     const void* buffer) {
+  struct partition* p = p_;
+  block_write_multiple(p->block, p->start + sector, cnt, buffer);
+}
+
+/* Passes request R on to the disk that holds partition P. */
+static void partition_submit(void* p_, struct block_request* r) {
+  struct partition* p = p_;
+
+  r->sector += p->start;
+  block_submit(p->block, r);
+}
+
+static struct block_operations partition_operations = {partition_read, partition_write,
+                                                       partition_read_multiple,
+                                                       partition_write_multiple, partition_submit};
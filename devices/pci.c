@@ -0,0 +1,113 @@
+#include "devices/pci.h"
+#include <debug.h>
+#include "threads/io.h"
+#include "threads/interrupt.h"
+
+/* PCI configuration space access through configuration mechanism
+   #1, which every PC since the early Pentium supports: the
+   address of a 32-bit configuration register is written to
+   CONFIG_ADDRESS and the register is then read or written
+   through CONFIG_DATA.  The two accesses must not be separated
+   by another pair, so interrupts are off in between. */
+
+/* I/O ports. */
+#define CONFIG_ADDRESS 0xcf8 /* Selects a configuration register. */
+#define CONFIG_DATA 0xcfc    /* Reads or writes the selected register. */
+
+/* CONFIG_ADDRESS bits. */
+#define ADDRESS_ENABLE 0x80000000 /* Access configuration space. */
+
+/* Header type bits. */
+#define HEADER_MULTI 0x80 /* Device has functions other than 0. */
+
+/* Selects configuration register REG of function A. */
+static void select_config(const struct pci_addr* a, uint8_t reg) {
+  ASSERT(a->slot < 32 && a->func < 8);
+  ASSERT(reg % 4 == 0);
+
+  outl(CONFIG_ADDRESS,
+       ADDRESS_ENABLE | (a->bus << 16) | (a->slot << 11) | (a->func << 8) | reg);
+}
+
+/* Returns configuration register REG, a multiple of 4, of
+   function A. */
+uint32_t pci_read_config(const struct pci_addr* a, uint8_t reg) {
+  enum intr_level old_level = intr_disable();
+  uint32_t value;
+
+  select_config(a, reg);
+  value = inl(CONFIG_DATA);
+  intr_set_level(old_level);
+  return value;
+}
+
+/* Sets configuration register REG, a multiple of 4, of function
+   A to VALUE. */
+void pci_write_config(const struct pci_addr* a, uint8_t reg, uint32_t value) {
+  enum intr_level old_level = intr_disable();
+
+  select_config(a, reg);
+  outl(CONFIG_DATA, value);
+  intr_set_level(old_level);
+}
+
+/* Returns true if the function whose ID and class registers are
+   ID and CLASS_REG is the kind sought, as described by KEY. */
+typedef bool match_func(uint32_t id, uint32_t class_reg, uint32_t key);
+
+/* Searches every bus for functions that MATCH says are the kind
+   described by KEY, and stores the location of the one after
+   the first SKIP of them in *A.  Returns false if there are not
+   that many. */
+static bool find(match_func* match, uint32_t key, int skip, struct pci_addr* a) {
+  int bus, slot, func;
+
+  for (bus = 0; bus < 256; bus++)
+    for (slot = 0; slot < 32; slot++)
+      for (func = 0; func < 8; func++) {
+        uint32_t id;
+
+        a->bus = bus;
+        a->slot = slot;
+        a->func = func;
+        id = pci_read_config(a, PCI_ID);
+        if ((id & 0xffff) == 0xffff) {
+          /* No such function.  Without function 0 there are no
+             others. */
+          if (func == 0)
+            break;
+          continue;
+        }
+
+        if (match(id, pci_read_config(a, PCI_CLASS), key) && skip-- == 0)
+          return true;
+
+        if (func == 0 && !((pci_read_config(a, PCI_HEADER) >> 16) & HEADER_MULTI))
+          break;
+      }
+  return false;
+}
+
+/* Matches functions whose class and subclass codes are the top
+   two bytes of KEY. */
+static bool match_class(uint32_t id UNUSED, uint32_t class_reg, uint32_t key) {
+  return (class_reg >> 16) == (key >> 16);
+}
+
+/* Matches functions whose ID register is KEY. */
+static bool match_id(uint32_t id, uint32_t class_reg UNUSED, uint32_t key) { return id == key; }
+
+/* Searches every bus for the first function with the given
+   CLASS and SUBCLASS codes.  If one is found, stores its
+   location in *A and returns true; otherwise, returns false. */
+bool pci_find_class(uint8_t class, uint8_t subclass, struct pci_addr* a) {
+  return find(match_class, ((uint32_t)class << 24) | ((uint32_t)subclass << 16), 0, a);
+}
+
+/* Searches every bus for functions with the given VENDOR and
+   DEVICE IDs.  If there are more than SKIP of them, stores the
+   location of the one after the first SKIP in *A and returns
+   true; otherwise, returns false. */
+bool pci_find_id(uint16_t vendor, uint16_t device, int skip, struct pci_addr* a) {
+  return find(match_id, ((uint32_t)device << 16) | vendor, skip, a);
+}
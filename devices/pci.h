@@ -0,0 +1,32 @@
+#ifndef DEVICES_PCI_H
+#define DEVICES_PCI_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Location of a PCI function. */
+struct pci_addr {
+  uint8_t bus;  /* Bus number, 0...255. */
+  uint8_t slot; /* Device number on the bus, 0...31. */
+  uint8_t func; /* Function number in the device, 0...7. */
+};
+
+/* Configuration space registers, as byte offsets. */
+#define PCI_ID 0x00      /* Vendor ID in bits 0...15, device ID above. */
+#define PCI_COMMAND 0x04 /* Command register in bits 0...15. */
+#define PCI_CLASS 0x08   /* Class, subclass, prog-if, revision. */
+#define PCI_HEADER 0x0c  /* Header type in bits 16...23. */
+#define PCI_BAR0 0x10    /* First of six base address registers. */
+#define PCI_IRQ 0x3c     /* Interrupt line in bits 0...7. */
+
+/* Command register bits. */
+#define PCI_CMD_IO 0x1     /* Respond to I/O space accesses. */
+#define PCI_CMD_MEMORY 0x2 /* Respond to memory space accesses. */
+#define PCI_CMD_MASTER 0x4 /* May act as a bus master. */
+
+uint32_t pci_read_config(const struct pci_addr*, uint8_t reg);
+void pci_write_config(const struct pci_addr*, uint8_t reg, uint32_t value);
+bool pci_find_class(uint8_t class, uint8_t subclass, struct pci_addr*);
+bool pci_find_id(uint16_t vendor, uint16_t device, int skip, struct pci_addr*);
+
+#endif /* devices/pci.h */
@@ -11,9 +11,6 @@
 #define PIT_PORT_CONTROL 0x43                        /* Control port. */
 #define PIT_PORT_COUNTER(CHANNEL) (0x40 + (CHANNEL)) /* Counter port. */
 
-/* PIT cycles per second. */
-#define PIT_HZ 1193180
-
 /* Configure the given CHANNEL in the PIT.  In a PC, the PIT's
    three output channels are hooked up like this:
 
@@ -75,3 +72,39 @@ void pit_configure_channel(int channel, int mode, int frequency) {
   outb(PIT_PORT_COUNTER(channel), count >> 8);
   intr_set_level(old_level);
 }
+
+/* Configures CHANNEL to count down COUNT PIT cycles once, in
+   mode 0: the channel's output is 0 until the count reaches 0,
+   then stays 1.  On channel 0 that raises a single interrupt.
+   COUNT must be at least 1. */
+void pit_configure_oneshot(int channel, uint16_t count) {
+  enum intr_level old_level;
+
+  ASSERT(channel == 0 || channel == 2);
+  ASSERT(count > 0);
+
+  old_level = intr_disable();
+  outb(PIT_PORT_CONTROL, (channel << 6) | 0x30);
+  outb(PIT_PORT_COUNTER(channel), count);
+  outb(PIT_PORT_COUNTER(channel), count >> 8);
+  intr_set_level(old_level);
+}
+
+/* Returns the current count of CHANNEL and stores the state of
+   its output in *OUTPUT, using the 8254 read-back command. */
+uint16_t pit_read_channel(int channel, bool* output) {
+  uint8_t status, lo, hi;
+  enum intr_level old_level;
+
+  ASSERT(channel == 0 || channel == 2);
+
+  old_level = intr_disable();
+  outb(PIT_PORT_CONTROL, 0xc0 | (1 << (channel + 1))); /* Latch count and status. */
+  status = inb(PIT_PORT_COUNTER(channel));
+  lo = inb(PIT_PORT_COUNTER(channel));
+  hi = inb(PIT_PORT_COUNTER(channel));
+  intr_set_level(old_level);
+
+  *output = (status & 0x80) != 0;
+  return lo | (hi << 8);
+}
@@ -0,0 +1,93 @@
+#include "devices/ramdisk.h"
+#include <debug.h>
+#include <round.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "devices/block.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/vaddr.h"
+
+/* A block device kept in memory, for scratch space, swap or a
+   file system that need not outlive the kernel, and for
+   measuring the layers above a block device without the cost of
+   real I/O.
+
+   The RAM disk is registered as "ram0", of type BLOCK_RAW, so it
+   plays a role only when named, as in -filesys=ram0.  It starts
+   out zeroed.  Its sectors are kept in pages from the kernel
+   pool, which need not be contiguous.  Transfers are memcpy()s
+   done before the request returns; the block layer's callers
+   never transfer a sector in two directions at once, so no lock
+   is needed. */
+
+/* Sectors in a page. */
+#define SECTORS_PER_PAGE (PGSIZE / BLOCK_SECTOR_SIZE)
+
+/* -ramdisk: Size of the RAM disk in kB, or 0 for none. */
+size_t ramdisk_kb;
+
+static void** pages;    /* Pages that hold the sectors. */
+static size_t page_cnt; /* Number of pages. */
+
+static struct block_operations ramdisk_operations;
+
+/* Creates and registers the RAM disk, if -ramdisk asked for
+   one.  Its size is rounded up to a whole page. */
+void ramdisk_init(void) {
+  size_t i;
+
+  if (ramdisk_kb == 0)
+    return;
+  page_cnt = DIV_ROUND_UP(ramdisk_kb * 1024, PGSIZE);
+  pages = malloc(page_cnt * sizeof *pages);
+  if (pages == NULL)
+    PANIC("ram0: can't allocate page table for %zu kB RAM disk", ramdisk_kb);
+  for (i = 0; i < page_cnt; i++) {
+    pages[i] = palloc_get_page(PAL_ZERO);
+    if (pages[i] == NULL)
+      PANIC("ram0: out of memory after %zu of %zu pages", i, page_cnt);
+  }
+  block_register("ram0", BLOCK_RAW, "RAM disk", page_cnt * SECTORS_PER_PAGE,
+                 &ramdisk_operations, NULL);
+}
+
+/* Returns the memory that holds SECTOR. */
+static uint8_t* sector_addr(block_sector_t sector) {
+  return (uint8_t*)pages[sector / SECTORS_PER_PAGE] +
+         sector % SECTORS_PER_PAGE * BLOCK_SECTOR_SIZE;
+}
+
+/* Reads the CNT sectors starting at SECTOR into BUFFER. */
+static void ramdisk_read_multiple(void* aux UNUSED, block_sector_t sector, size_t cnt,
+                                  void* buffer) {
+  uint8_t* p = buffer;
+  size_t i;
+
+  for (i = 0; i < cnt; i++)
+    memcpy(p + i * BLOCK_SECTOR_SIZE, sector_addr(sector + i), BLOCK_SECTOR_SIZE);
+}
+
+/* Writes the CNT sectors starting at SECTOR from BUFFER. */
+static void ramdisk_write_multiple(void* aux UNUSED, block_sector_t sector, size_t cnt,
+                                   const void* buffer) {
+  const uint8_t* p = buffer;
+  size_t i;
+
+  for (i = 0; i < cnt; i++)
+    memcpy(sector_addr(sector + i), p + i * BLOCK_SECTOR_SIZE, BLOCK_SECTOR_SIZE);
+}
+
+/* Reads SECTOR into BUFFER. */
+static void ramdisk_read(void* aux, block_sector_t sector, void* buffer) {
+  ramdisk_read_multiple(aux, sector, 1, buffer);
+}
+
+/* Writes SECTOR from BUFFER. */
+static void ramdisk_write(void* aux, block_sector_t sector, const void* buffer) {
+  ramdisk_write_multiple(aux, sector, 1, buffer);
+}
+
+static struct block_operations ramdisk_operations = {
+    ramdisk_read, ramdisk_write, ramdisk_read_multiple, ramdisk_write_multiple, NULL};
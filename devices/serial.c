@@ -33,6 +33,17 @@
 #define MCR_REG (IO_BASE + 4) /* MODEM Control Register. */
 #define LSR_REG (IO_BASE + 5) /* Line Status Register (read-only). */
 
+/* FIFO Control Register bits. */
+#define FCR_ENABLE 0x01   /* Enable FIFOs. */
+#define FCR_CLEAR_RX 0x02 /* Discard bytes in the receive FIFO. */
+#define FCR_CLEAR_TX 0x04 /* Discard bytes in the transmit FIFO. */
+
+/* Bytes in each 16550A FIFO. */
+#define FIFO_SIZE 16
+
+/* Interrupt Identification Register bits. */
+#define IIR_FIFO 0xc0 /* Both set if the FIFOs are enabled. */
+
 /* Interrupt Enable Register bits. */
 #define IER_RECV 0x01 /* Interrupt when data received. */
 #define IER_XMIT 0x02 /* Interrupt when transmit finishes. */
@@ -51,6 +62,10 @@
 /* Transmission mode. */
 static enum { UNINIT, POLL, QUEUE } mode;
 
+/* Bytes the transmitter accepts once THR Empty is set: FIFO_SIZE
+   for a 16550A with its FIFO enabled, 1 for an older UART without. */
+static size_t tx_fifo_size;
+
 /* Data to be transmitted. */
 static struct intq txq;
 
@@ -66,9 +81,14 @@ static intr_handler_func serial_interrupt;
 static void init_poll(void) {
   ASSERT(mode == UNINIT);
   outb(IER_REG, 0);        /* Turn off all interrupts. */
-  outb(FCR_REG, 0);        /* Disable FIFO. */
   set_serial(9600);        /* 9.6 kbps, N-8-1. */
   outb(MCR_REG, MCR_OUT2); /* Required to enable interrupts. */
+
+  /* Enable the FIFOs, with the receive trigger level at 1 byte,
+     and find out whether this UART has them. */
+  outb(FCR_REG, FCR_ENABLE | FCR_CLEAR_RX | FCR_CLEAR_TX);
+  tx_fifo_size = (inb(IIR_REG) & IIR_FIFO) == IIR_FIFO ? FIFO_SIZE : 1;
+
   intq_init(&txq);
   mode = POLL;
 }
@@ -119,6 +139,40 @@ void serial_putc(uint8_t byte) {
   intr_set_level(old_level);
 }
 
+/* Sends the SIZE bytes in BUFFER to the serial port.  Like
+   calling serial_putc() for each byte, but queues them in bulk
+   and updates the interrupt enable register once per batch. */
+void serial_putbuf(const void* buffer_, size_t size) {
+  const uint8_t* buffer = buffer_;
+  enum intr_level old_level = intr_disable();
+
+  if (mode != QUEUE) {
+    if (mode == UNINIT)
+      init_poll();
+    while (size-- > 0)
+      putc_poll(*buffer++);
+  } else {
+    while (size > 0) {
+      size_t chunk = intq_space(&txq);
+
+      if (chunk == 0) {
+        /* Full.  Handle one byte the way serial_putc() does. */
+        if (old_level == INTR_OFF)
+          putc_poll(intq_getc(&txq));
+        chunk = 1;
+      } else if (chunk > size)
+        chunk = size;
+
+      intq_putbuf(&txq, buffer, chunk);
+      write_ier();
+      buffer += chunk;
+      size -= chunk;
+    }
+  }
+
+  intr_set_level(old_level);
+}
+
 /* Flushes anything in the serial buffer out the port in polling
    mode. */
 void serial_flush(void) {
@@ -196,10 +250,20 @@ static void serial_interrupt(struct intr_frame* f UNUSED) {
   while (!input_full() && (inb(LSR_REG) & LSR_DR) != 0)
     input_putc(inb(RBR_REG));
 
-  /* As long as we have a byte to transmit, and the hardware is
-     ready to accept a byte for transmission, transmit a byte. */
-  while (!intq_empty(&txq) && (inb(LSR_REG) & LSR_THRE) != 0)
-    outb(THR_REG, intq_getc(&txq));
+  /* If the transmitter is empty, fill it from the queue.  THR
+     Empty means the whole FIFO is empty, so one interrupt can
+     send TX_FIFO_SIZE bytes without checking in between. */
+  if (!intq_empty(&txq) && (inb(LSR_REG) & LSR_THRE) != 0) {
+    uint8_t buf[FIFO_SIZE];
+    size_t n = INTQ_BUFSIZE - intq_space(&txq);
+    size_t i;
+
+    if (n > tx_fifo_size)
+      n = tx_fifo_size;
+    intq_getbuf(&txq, buf, n);
+    for (i = 0; i < n; i++)
+      outb(THR_REG, buf[i]);
+  }
 
   /* Update interrupt enable register based on queue status. */
   write_ier();
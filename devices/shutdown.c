@@ -4,14 +4,41 @@
 #include "devices/kbd.h"
 #include "devices/serial.h"
 #include "devices/timer.h"
+#include "devices/vga.h"
+#include "threads/cpu.h"
+#include "threads/fpu.h"
+#include "threads/highmem.h"
+#include "threads/init.h"
+#include "threads/interrupt.h"
 #include "threads/io.h"
+#include "threads/lock-stats.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/profile.h"
+#include "threads/sched-trace.h"
+#include "threads/slab.h"
 #include "threads/thread.h"
+#include "threads/tracepoint.h"
+#include "threads/vmalloc.h"
+#include "threads/workqueue.h"
 #ifdef USERPROG
 #include "userprog/exception.h"
+#include "userprog/pagedir.h"
+#include "userprog/strace.h"
+#include "userprog/syscall.h"
 #endif
 #ifdef FILESYS
 #include "devices/block.h"
+#include "filesys/cache.h"
+#include "filesys/dcache.h"
+#include "filesys/journal.h"
 #include "filesys/filesys.h"
+#include "filesys/initramfs.h"
+#include "filesys/inode.h"
+#endif
+#ifdef VM
+#include "vm/frame.h"
+#include "vm/swap.h"
 #endif
 
 /* Keyboard control register port. */
@@ -48,6 +75,7 @@ void shutdown_configure(enum shutdown_type type) { how = type; }
 /* Reboots the machine via the keyboard controller. */
 void shutdown_reboot(void) {
   printf("Rebooting...\n");
+  console_flush();
 
   /* See [kbd] for details on how to program the keyboard
    * controller. */
@@ -84,6 +112,7 @@ void shutdown_power_off(void) {
   print_stats();
 
   printf("Powering off...\n");
+  console_flush();
   serial_flush();
 
   /* QEMU does not shutdown properly without this line */
@@ -107,14 +136,43 @@ void shutdown_power_off(void) {
 
 /* Print statistics about Pintos execution. */
 static void print_stats(void) {
+#ifdef USERPROG
+  strace_flush();
+#endif
+  init_print_boot_stats();
   timer_print_stats();
+  intr_print_stats();
   thread_print_stats();
+  fpu_print_stats();
+  workqueue_print_stats();
+  cpu_print_stats();
+  lock_print_stats();
+  palloc_print_stats();
+  malloc_print_stats();
+  vmalloc_print_stats();
+  highmem_print_stats();
+  kmem_print_stats();
 #ifdef FILESYS
   block_print_stats();
+  cache_print_stats();
+  dcache_print_stats();
+  inode_print_stats();
+  initramfs_print_stats();
+  journal_print_stats();
 #endif
   console_print_stats();
+  vga_print_stats();
   kbd_print_stats();
 #ifdef USERPROG
   exception_print_stats();
+  syscall_print_stats();
+  pagedir_print_stats();
+#endif
+#ifdef VM
+  frame_print_stats();
+  swap_print_stats();
 #endif
+  sched_trace_dump();
+  tracepoint_dump();
+  profile_dump();
 }
@@ -1,13 +1,18 @@
 #include "devices/timer.h"
 #include <debug.h>
+#include <div64.h>
 #include <inttypes.h>
 #include <round.h>
 #include <stdio.h>
+#include <pqueue.h>
 #include "devices/pit.h"
+#include "devices/vga.h"
 #include "threads/interrupt.h"
+#include "threads/kstat.h"
+#include "threads/profile.h"
 #include "threads/synch.h"
 #include "threads/thread.h"
-#include <list.h>
+#include "threads/vdso.h"
 
 /* See [8254] for hardware details of the 8254 timer chip. */
 
@@ -18,14 +23,74 @@
 #error TIMER_FREQ <= 1000 recommended
 #endif
 
-/* Number of timer ticks since OS booted. */
+/* Number of timer ticks since OS booted.  Only the timer
+   interrupt and timer_restart_ticks() change it, inside
+   ticks_seq, so that timer_ticks() can read it without turning
+   interrupts off. */
 static int64_t ticks;
+static struct seqlock ticks_seq;
 
 /* Number of loops per timer tick.
    Initialized by timer_calibrate(). */
 static unsigned loops_per_tick;
 
+/* Calibration results from an earlier boot on the same machine,
+   or 0 to measure them.  Controlled by kernel command-line
+   options "-loops" and "-tsc-khz", which utils/pintos passes
+   from its calibration cache. */
+unsigned timer_calib_loops;   /* Loops per timer tick. */
+unsigned timer_calib_tsc_khz; /* TSC cycles per millisecond. */
+
+/* If false (default), the timer interrupts TIMER_FREQ times per
+   second at all times.
+   If true, the periodic tick is stopped while the CPU is idle.
+   Controlled by kernel command-line option "-tickless". */
+bool timer_tickless;
+
+/* Tickless idle.  When the idle thread halts, timer_stop_ticks()
+   replaces the periodic interrupt by a one-shot one at the
+   earliest tick anything has to happen: the next wakeup from the
+   sleep queue or, under the MLFQS, the next load_avg update,
+   within the longest interval the 16-bit PIT counter can time.
+   The next external interrupt, whichever it is, calls
+   timer_restart_ticks(), which adds the ticks that went by to
+   `ticks' and restarts the periodic interrupt. */
+#define ONESHOT_MAX_TICKS (65535 * TIMER_FREQ / PIT_HZ)
+static int64_t oneshot_ticks;  /* Ticks of the running one-shot, or 0. */
+static uint16_t oneshot_count; /* PIT count of the running one-shot. */
+static int64_t skipped_ticks;  /* # of ticks without an interrupt. */
+
+/* Time stamp counter (TSC) clock.  The TSC counts CPU cycles;
+   timer_calibrate() measures how many go by in TSC_CALIBRATE_TICKS
+   timer ticks.  Until then, or if the CPU has no TSC, timer_ns()
+   is derived from the tick count. */
+#define TSC_CALIBRATE_TICKS 10
+static uint64_t tsc_hz;    /* TSC cycles per second, or 0. */
+static uint64_t tsc_start; /* TSC at calibration. */
+static int64_t tsc_ticks;  /* Ticks at calibration. */
+
+/* High-resolution timers.  A sleep shorter than one tick blocks
+   the thread on hr_sleep_queue, ordered by wakeup_ns, instead of
+   busy-waiting.  To wake it on time, hrtimer_program() makes the
+   next interrupt of PIT channel 0 a one-shot that fires at the
+   earliest deadline, if that comes before the next tick.  When it
+   fires, another one-shot covers what is left of the tick, whose
+   interrupt then restarts the periodic timer, so the tick rate is
+   not disturbed.  Needs the TSC clock to know the deadlines; without
+   it, short sleeps still busy-wait.  Accessed with interrupts off. */
+#define HRTIMER_MIN_NS 2000          /* Deadlines this close are due. */
+static struct pqueue hr_sleep_queue; /* Threads in sub-tick sleeps. */
+static bool hr_armed;                /* Next interrupt is a deadline? */
+static bool hr_tick_oneshot;         /* Next interrupt is a one-shot tick? */
+static uint32_t hr_tick_remaining;   /* PIT cycles from deadline to tick. */
+
 static intr_handler_func timer_interrupt;
+static void hrtimer_sleep(int64_t ns);
+static void hrtimer_program(void);
+static bool hrtimer_wakeup(void);
+static pqueue_less_func hr_less;
+static bool tsc_present(void);
+static uint64_t rdtsc(void);
 static bool too_many_loops(unsigned loops);
 static void busy_wait(int64_t loops);
 static void real_time_sleep(int64_t num, int32_t denom);
@@ -33,71 +98,108 @@ static void real_time_delay(int64_t num, int32_t denom);
 
 /* Custom defined prototypes and globals */
 
-/* List of all sleeping threads */
-static struct list sleeping_list;
-
-/* Comparator function for adding threads
-   to `sleeping_list`. Ensures addition in non-decreasing order */
-static bool sleep_compare(const struct list_elem* a, const struct list_elem* b, void* AUX UNUSED);
+/* Sleeping threads, in a priority queue ordered by wakeup_time,
+  linked through the threads' sleep_elem members, so that the
+  earliest sleeper is always at the front. Accessed with interrupts
+  off */
+static struct pqueue sleep_queue;
 
-/* The minimum time for any thread to wake up. When value is greater or equal
-  to ticks, unblock the wakeup thread and awaken some threads */
-int64_t min_wakeup_time;
+/* Orders threads in sleep_queue by wakeup_time */
+static pqueue_less_func sleep_less;
 
-/* The wakeup thread - Remains blocked except when it is unblocked in the `timer_interrupt` function */
-// struct thread *wakeup_thread;
+/* Statistics for the sleep heap */
+static int64_t wakeup_events;  /* Timer interrupts that woke any sleepers */
+static int64_t wakeups_merged; /* Sleepers woken by an interrupt after the first */
 
-/* The function that the wakeup_thread is assigned to. Goes into an infinite
-loop until the timer_interrupt unblocks it, to awake a sleeping thread */
-static void waker(void* arg UNUSED);
+/* The earliest wakeup_time of any sleeping thread, INT64_MAX if none */
+static int64_t min_wakeup_time(void);
 
-/* Iterate over the list of sleeping threads and wake up all those whose
-wakeup time is less than the min_wakeup_time. Then update the
-min_wakeup_time to the first thread whose wakeup_time is greater than ticks */
-void timer_wakeup(void);
+/* Unblock all the sleeping threads whose wakeup_time has come.
+  Deferred by timer_interrupt(), so that the interrupt itself stays
+  short however many threads wake up at once */
+static intr_work_func timer_wakeup;
+static struct intr_work wakeup_work;
 
 /* Sets up the timer to interrupt TIMER_FREQ times per second,
    and registers the corresponding interrupt. */
 void timer_init(void) {
   pit_configure_channel(0, 2, TIMER_FREQ);
+  seqlock_init(&ticks_seq);
   intr_register_ext(0x20, timer_interrupt, "8254 Timer");
-  list_init(&sleeping_list); /* Initialize the sleeping threads list */
-
-  /* Create a wakeup_thread, setting the priority to max (PRI_MAX)) and
-  assign it to the waker function */
-  thread_create("wakeup_thread", PRI_MAX, waker, NULL);
-  min_wakeup_time = INT64_MAX;
+  intr_work_init(&wakeup_work, timer_wakeup, NULL);
+  pqueue_init(&sleep_queue, sleep_less, NULL);
+  pqueue_init(&hr_sleep_queue, hr_less, NULL);
+
+  kstat_counter("timer.ticks", &ticks);
+  kstat_counter("timer.skipped_ticks", &skipped_ticks);
+  kstat_counter("timer.wakeups", &wakeup_events);
+  kstat_counter("timer.wakeups_merged", &wakeups_merged);
 }
 
-/* Calibrates loops_per_tick, used to implement brief delays. */
+/* Calibrates the clock that brief delays are timed by: the TSC
+   if the CPU has one, otherwise loops_per_tick.  Either takes
+   some timer ticks to measure, so a rate given on the command
+   line is taken as it is. */
 void timer_calibrate(void) {
-  unsigned high_bit, test_bit;
-
   ASSERT(intr_get_level() == INTR_ON);
-  printf("Calibrating timer...  ");
 
-  /* Approximate loops_per_tick as the largest power-of-two
-     still less than one timer tick. */
-  loops_per_tick = 1u << 10;
-  while (!too_many_loops(loops_per_tick << 1)) {
-    loops_per_tick <<= 1;
-    ASSERT(loops_per_tick != 0);
+  if (tsc_present()) {
+    /* Count TSC cycles over TSC_CALIBRATE_TICKS full ticks. */
+    if (timer_calib_tsc_khz != 0)
+      tsc_hz = (uint64_t)timer_calib_tsc_khz * 1000;
+    else {
+      int64_t start = ticks;
+      uint64_t cycles;
+
+      while (ticks == start)
+        barrier();
+      start = ticks;
+      cycles = rdtsc();
+      while (ticks - start < TSC_CALIBRATE_TICKS)
+        barrier();
+      cycles = rdtsc() - cycles;
+      tsc_hz = cycles * TIMER_FREQ / TSC_CALIBRATE_TICKS;
+    }
+
+    tsc_start = rdtsc();
+    tsc_ticks = timer_ticks();
+    vdso_set_clock(tsc_hz, tsc_start, tsc_ticks);
+    printf("TSC: %'" PRIu64 " cycles/s.\n", tsc_hz);
+    return;
   }
 
-  /* Refine the next 8 bits of loops_per_tick. */
-  high_bit = loops_per_tick;
-  for (test_bit = high_bit >> 1; test_bit != high_bit >> 10; test_bit >>= 1)
-    if (!too_many_loops(high_bit | test_bit))
-      loops_per_tick |= test_bit;
+  printf("Calibrating timer...  ");
+  if (timer_calib_loops != 0)
+    loops_per_tick = timer_calib_loops;
+  else {
+    unsigned high_bit, test_bit;
+
+    /* Approximate loops_per_tick as the largest power-of-two
+       still less than one timer tick. */
+    loops_per_tick = 1u << 10;
+    while (!too_many_loops(loops_per_tick << 1)) {
+      loops_per_tick <<= 1;
+      ASSERT(loops_per_tick != 0);
+    }
 
+    /* Refine the next 8 bits of loops_per_tick. */
+    high_bit = loops_per_tick;
+    for (test_bit = high_bit >> 1; test_bit != high_bit >> 10; test_bit >>= 1)
+      if (!too_many_loops(high_bit | test_bit))
+        loops_per_tick |= test_bit;
+  }
   printf("%'" PRIu64 " loops/s.\n", (uint64_t)loops_per_tick * TIMER_FREQ);
 }
 
 /* Returns the number of timer ticks since the OS booted. */
 int64_t timer_ticks(void) {
-  enum intr_level old_level = intr_disable();
-  int64_t t = ticks;
-  intr_set_level(old_level);
+  unsigned seq;
+  int64_t t;
+
+  do {
+    seq = seqlock_read_begin(&ticks_seq);
+    t = ticks;
+  } while (seqlock_read_retry(&ticks_seq, seq));
   return t;
 }
 
@@ -105,19 +207,114 @@ int64_t timer_ticks(void) {
    should be a value once returned by timer_ticks(). */
 int64_t timer_elapsed(int64_t then) { return timer_ticks() - then; }
 
-static bool sleep_compare(const struct list_elem* a, const struct list_elem* b, void* AUX UNUSED) {
-  struct thread* t1 = list_entry(a, struct thread, sleepelem);
-  struct thread* t2 = list_entry(b, struct thread, sleepelem);
+/* Returns the number of nanoseconds since the OS booted, from a
+   monotonic clock with a resolution of one CPU cycle once
+   timer_calibrate() has run, or of one timer tick before. */
+int64_t timer_ns(void) {
+  uint64_t cycles;
 
-  if (t1->wakeup_time < t2->wakeup_time)
-    return true;
+  if (tsc_hz == 0)
+    return timer_ticks() * (1000000000 / TIMER_FREQ);
 
-  return false;
+  cycles = rdtsc() - tsc_start;
+  return tsc_ticks * (1000000000 / TIMER_FREQ) + timer_cycles_ns(cycles);
+}
+
+/* Returns the time stamp counter, or 0 before timer_calibrate()
+   has run or if the CPU has no TSC. */
+uint64_t timer_cycles(void) { return tsc_hz != 0 ? rdtsc() : 0; }
+
+/* Converts CYCLES of the time stamp counter to nanoseconds.
+   Returns 0 if the TSC clock is not running. */
+int64_t timer_cycles_ns(uint64_t cycles) {
+  if (tsc_hz == 0)
+    return 0;
+
+  /* Split into seconds and a remainder so that the
+     multiplication can't overflow.  A TSC of up to 4 GHz divides
+     without calling into lib/arithmetic.c. */
+  if (tsc_hz <= UINT32_MAX) {
+    uint32_t rem;
+    uint64_t secs = div_u64_rem(cycles, tsc_hz, &rem);
+
+    return secs * 1000000000 + div_u64((uint64_t)rem * 1000000000, tsc_hz);
+  }
+  return cycles / tsc_hz * 1000000000 + cycles % tsc_hz * 1000000000 / tsc_hz;
+}
+
+/* Called by the idle thread with interrupts off just before it
+   halts.  Stops the periodic tick if tickless idle is enabled and
+   nothing needs to happen before the tick after next. */
+void timer_stop_ticks(void) {
+  int64_t n;
+
+  ASSERT(intr_get_level() == INTR_OFF);
+
+  if (!timer_tickless || oneshot_ticks != 0 || hr_armed || hr_tick_oneshot)
+    return;
+
+  /* The tick at which the MLFQS updates load_avg must be
+     delivered as a real interrupt, so that thread_tick() sees
+     it. */
+  n = min_wakeup_time() - ticks;
+  if (n > ONESHOT_MAX_TICKS)
+    n = ONESHOT_MAX_TICKS;
+  if (thread_mlfqs && n > TIMER_FREQ - mod_u64(ticks, TIMER_FREQ))
+    n = TIMER_FREQ - mod_u64(ticks, TIMER_FREQ);
+  if (n <= 1)
+    return;
+
+  oneshot_ticks = n;
+  oneshot_count = n * PIT_HZ / TIMER_FREQ;
+  pit_configure_oneshot(0, oneshot_count);
+}
+
+/* Called on every external interrupt.  If the periodic tick is
+   stopped, accounts for the ticks that elapsed since then and
+   restarts it. */
+void timer_restart_ticks(void) {
+  int64_t elapsed;
+  uint16_t count;
+  bool expired;
+
+  ASSERT(intr_get_level() == INTR_OFF);
+
+  if (oneshot_ticks == 0)
+    return;
+
+  /* If the one-shot expired, its interrupt is either the one
+     being handled or pending, and timer_interrupt() counts its
+     last tick.  Otherwise count the whole ticks that went by;
+     the fraction of a tick is lost when the periodic timer
+     restarts. */
+  count = pit_read_channel(0, &expired);
+  if (expired)
+    elapsed = oneshot_ticks - 1;
+  else
+    elapsed = (uint32_t)(oneshot_count - count) * TIMER_FREQ / PIT_HZ;
+  seqlock_write_begin(&ticks_seq);
+  ticks += elapsed;
+  seqlock_write_end(&ticks_seq);
+  vdso_set_ticks(ticks);
+  skipped_ticks += elapsed;
+
+  oneshot_ticks = 0;
+  pit_configure_channel(0, 2, TIMER_FREQ);
 }
 
 /* Sleeps for approximately TICKS timer ticks.  Interrupts must
    be turned on. */
-void timer_sleep(int64_t ticks) {
+void timer_sleep(int64_t ticks) { timer_sleep_slack(ticks, 0); }
+
+/* Sleeps for at least TICKS and at most TICKS + SLACK timer
+   ticks.  Interrupts must be turned on.
+
+   The slack lets sleepers with nearby deadlines share a single
+   wakeup: the deadline is moved to the earliest pending one if
+   that is within the slack, or else rounded up to a multiple of
+   the largest power of 2 that fits in the slack, so that other
+   sleepers with slack tend to pick the same tick. */
+void timer_sleep_slack(int64_t ticks, int64_t slack) {
   if (ticks <= 0)
     return;
 
@@ -128,16 +325,56 @@ void timer_sleep(int64_t ticks) {
 
   enum intr_level old_level = intr_disable();
 
-  curr->wakeup_time = wakeup_time;
-  min_wakeup_time = (wakeup_time < min_wakeup_time) ? wakeup_time : min_wakeup_time;
+  if (slack > 0) {
+    int64_t pending = min_wakeup_time();
+
+    if (pending >= wakeup_time && pending - wakeup_time <= slack)
+      wakeup_time = pending;
+    else {
+      int64_t granularity = 1;
 
-  list_insert_ordered(&sleeping_list, &curr->sleepelem, sleep_compare, NULL);
+      while (granularity * 2 <= slack)
+        granularity *= 2;
+      wakeup_time = ROUND_UP(wakeup_time, granularity);
+    }
+  }
+
+  curr->wakeup_time = wakeup_time;
+  pqueue_push(&sleep_queue, &curr->sleep_elem);
   thread_block();
 
   // setting the interrupt to old level
   intr_set_level(old_level);
 }
 
+/* Blocks the running thread until TICKS timer ticks have passed,
+   which must be positive, or until timer_wake() wakes it first.
+   Interrupts must be turned off. */
+void timer_block(int64_t ticks) {
+  struct thread* curr = thread_current();
+
+  ASSERT(intr_get_level() == INTR_OFF);
+  ASSERT(ticks > 0);
+
+  curr->wakeup_time = timer_ticks() + ticks;
+  pqueue_push(&sleep_queue, &curr->sleep_elem);
+  thread_block();
+}
+
+/* Unblocks T before its time in timer_block() is up.  T may
+   instead be blocked with plain thread_block(), in which case it
+   is just unblocked.  Interrupts must be turned off. */
+void timer_wake(struct thread* t) {
+  ASSERT(intr_get_level() == INTR_OFF);
+  ASSERT(t->status == THREAD_BLOCKED);
+
+  if (t->wakeup_time != 0) {
+    pqueue_remove(&sleep_queue, &t->sleep_elem);
+    t->wakeup_time = 0;
+  }
+  thread_unblock(t);
+}
+
 /* Sleeps for approximately MS milliseconds.  Interrupts must be
    turned on. */
 void timer_msleep(int64_t ms) { real_time_sleep(ms, 1000); }
@@ -178,50 +415,87 @@ void timer_udelay(int64_t us) { real_time_delay(us, 1000 * 1000); }
 void timer_ndelay(int64_t ns) { real_time_delay(ns, 1000 * 1000 * 1000); }
 
 /* Prints timer statistics. */
-void timer_print_stats(void) { printf("Timer: %" PRId64 " ticks\n", timer_ticks()); }
+void timer_print_stats(void) {
+  printf("Timer: %" PRId64 " ticks\n", timer_ticks());
+  if (timer_tickless)
+    printf("Timer: %" PRId64 " ticks skipped while idle\n", skipped_ticks);
+  printf("Timer: %" PRId64 " wakeup events, %" PRId64 " merged wakeups\n", wakeup_events,
+         wakeups_merged);
+}
 
 /* Timer interrupt handler. */
-static void timer_interrupt(struct intr_frame* args UNUSED) {
+static void timer_interrupt(struct intr_frame* args) {
+  if (hr_armed) {
+    /* A deadline, not a tick. */
+    hr_armed = false;
+    hr_tick_oneshot = true;
+    pit_configure_oneshot(0, hr_tick_remaining > 0xffff ? 0xffff : hr_tick_remaining);
+    if (hrtimer_wakeup())
+      hrtimer_program();
+    return;
+  }
+  if (hr_tick_oneshot) {
+    hr_tick_oneshot = false;
+    pit_configure_channel(0, 2, TIMER_FREQ);
+  }
+
+  seqlock_write_begin(&ticks_seq);
   ticks++;
+  seqlock_write_end(&ticks_seq);
+  vdso_set_ticks(ticks);
+  if (profile_enabled)
+    profile_sample(args);
 
-  if (ticks >= min_wakeup_time && wakeup_thread->status == THREAD_BLOCKED) {
-    thread_unblock(wakeup_thread);
-  }
+  if (hrtimer_wakeup())
+    hrtimer_program();
+
+  if (ticks >= min_wakeup_time())
+    intr_defer(&wakeup_work);
 
+  vga_flush();
   thread_tick();
 }
 
-void waker(void* arg UNUSED) {
-  wakeup_thread = thread_current();
+static void timer_wakeup(void* aux UNUSED) {
+  int woken = 0;
 
   for (;;) {
     enum intr_level old_level = intr_disable();
+    struct thread* t = NULL;
 
-    thread_block();
+    if (!pqueue_empty(&sleep_queue))
+      t = pqueue_entry(pqueue_front(&sleep_queue), struct thread, sleep_elem);
+    if (t == NULL || t->wakeup_time > ticks) {
+      intr_set_level(old_level);
+      break;
+    }
 
-    intr_set_level(old_level);
+    if (woken++ == 0)
+      wakeup_events++;
+    else
+      wakeups_merged++;
+
+    pqueue_pop_front(&sleep_queue);
+    t->wakeup_time = 0;
+    thread_unblock(t);
 
-    timer_wakeup();
+    /* Preempt the running thread in favour of a more important one */
+    if (thread_preempts(t))
+      intr_yield_on_return();
+    intr_set_level(old_level);
   }
 }
 
-void timer_wakeup(void) {
-  struct list_elem* iter;
-  for (iter = list_begin(&sleeping_list); iter != list_end(&sleeping_list);
-       iter = list_next(iter)) {
-    struct thread* curr = list_entry(iter, struct thread, sleepelem);
-    if (curr->wakeup_time <= min_wakeup_time) {
-      curr->wakeup_time = 0;
-      thread_unblock(curr); /* Wake up the thread */
-      list_remove(iter);    /* Remove the thread from sleeping list */
-    } else {
-      min_wakeup_time = curr->wakeup_time;
-      break;
-    }
-  }
+static int64_t min_wakeup_time(void) {
+  if (pqueue_empty(&sleep_queue))
+    return INT64_MAX;
+  return pqueue_entry(pqueue_front(&sleep_queue), struct thread, sleep_elem)->wakeup_time;
+}
 
-  if (list_empty(&sleeping_list))
-    min_wakeup_time = INT64_MAX;
+static bool sleep_less(const struct pqueue_elem* a, const struct pqueue_elem* b,
+                       void* aux UNUSED) {
+  return pqueue_entry(a, struct thread, sleep_elem)->wakeup_time <
+         pqueue_entry(b, struct thread, sleep_elem)->wakeup_time;
 }
 
 /* Returns true if LOOPS iterations waits for more than one timer
@@ -261,7 +535,7 @@ static void real_time_sleep(int64_t num, int32_t denom) {
      ---------------------- = NUM * TIMER_FREQ / DENOM ticks.
      1 s / TIMER_FREQ ticks
   */
-  int64_t ticks = num * TIMER_FREQ / denom;
+  int64_t ticks = div_s64(num * TIMER_FREQ, denom);
 
   ASSERT(intr_get_level() == INTR_ON);
   if (ticks > 0) {
@@ -269,17 +543,126 @@ static void real_time_sleep(int64_t num, int32_t denom) {
 	   timer_sleep() because it will yield the CPU to other
 	   processes. */
     timer_sleep(ticks);
+  } else if (tsc_hz != 0) {
+    /* Otherwise, block on a high-resolution timer. */
+    hrtimer_sleep(div_s64(num * 1000000000, denom));
   } else {
-    /* Otherwise, use a busy-wait loop for more accurate
+    /* Without the TSC, use a busy-wait loop for more accurate
 	   sub-tick timing. */
     real_time_delay(num, denom);
   }
 }
 
+/* Blocks the current thread for NS nanoseconds, less than a tick. */
+static void hrtimer_sleep(int64_t ns) {
+  struct thread* cur = thread_current();
+  enum intr_level old_level;
+
+  ASSERT(!intr_context());
+
+  if (ns < HRTIMER_MIN_NS) {
+    real_time_delay(ns, 1000 * 1000 * 1000);
+    return;
+  }
+
+  old_level = intr_disable();
+  cur->wakeup_ns = timer_ns() + ns;
+  pqueue_push(&hr_sleep_queue, &cur->sleep_elem);
+  hrtimer_program();
+  thread_block();
+  intr_set_level(old_level);
+}
+
+/* Makes the next interrupt of channel 0 fire at the earliest
+   deadline on hr_sleep_queue, if that comes before the next tick
+   and before any deadline already programmed. */
+static void hrtimer_program(void) {
+  struct thread* t;
+  uint32_t count, to_tick;
+  int64_t delta;
+  bool output;
+
+  ASSERT(intr_get_level() == INTR_OFF);
+
+  if (pqueue_empty(&hr_sleep_queue))
+    return;
+  t = pqueue_entry(pqueue_front(&hr_sleep_queue), struct thread, sleep_elem);
+
+  /* Leave tickless mode: we need to know where the next tick is. */
+  timer_restart_ticks();
+
+  /* The PIT count is the number of cycles until the next
+     interrupt, which is a tick unless a deadline is armed. */
+  count = pit_read_channel(0, &output);
+  to_tick = count + (hr_armed ? hr_tick_remaining : 0);
+  delta = div_s64((t->wakeup_ns - timer_ns()) * PIT_HZ, 1000000000);
+  if (delta < 1)
+    delta = 1;
+  if (delta >= to_tick || (hr_armed && delta >= count))
+    return;
+
+  hr_armed = true;
+  hr_tick_remaining = to_tick - delta;
+  pit_configure_oneshot(0, delta);
+}
+
+/* Unblocks the threads on hr_sleep_queue whose deadline has come.
+   Returns true if any threads are left. */
+static bool hrtimer_wakeup(void) {
+  int64_t now = timer_ns();
+
+  while (!pqueue_empty(&hr_sleep_queue)) {
+    struct thread* t = pqueue_entry(pqueue_front(&hr_sleep_queue), struct thread, sleep_elem);
+
+    if (t->wakeup_ns > now + HRTIMER_MIN_NS)
+      return true;
+    pqueue_pop_front(&hr_sleep_queue);
+    thread_unblock(t);
+    if (thread_preempts(t))
+      intr_yield_on_return();
+  }
+  return false;
+}
+
+/* Orders threads on hr_sleep_queue by deadline. */
+static bool hr_less(const struct pqueue_elem* a, const struct pqueue_elem* b, void* aux UNUSED) {
+  return pqueue_entry(a, struct thread, sleep_elem)->wakeup_ns <
+         pqueue_entry(b, struct thread, sleep_elem)->wakeup_ns;
+}
+
 /* Busy-wait for approximately NUM/DENOM seconds. */
 static void real_time_delay(int64_t num, int32_t denom) {
+  ASSERT(denom % 1000 == 0);
+
+  if (tsc_hz != 0) {
+    /* Spin on the TSC.  NUM * (TSC_HZ / 1000) doesn't overflow
+       for delays up to many days. */
+    uint64_t start = rdtsc();
+    uint64_t cycles = num * (tsc_hz / 1000) / (denom / 1000);
+
+    while (rdtsc() - start < cycles)
+      barrier();
+    return;
+  }
+
   /* Scale the numerator and denominator down by 1000 to avoid
      the possibility of overflow. */
-  ASSERT(denom % 1000 == 0);
   busy_wait(loops_per_tick * num / 1000 * TIMER_FREQ / (denom / 1000));
+}
+
+/* Returns true if the CPU has a time stamp counter, according to
+   the CPUID instruction.  See [IA32-v2a] "CPUID". */
+static bool tsc_present(void) {
+  uint32_t eax = 1, ebx, ecx, edx;
+
+  asm volatile("cpuid" : "+a"(eax), "=b"(ebx), "=c"(ecx), "=d"(edx));
+  return (edx & (1 << 4)) != 0;
+}
+
+/* Returns the time stamp counter.  See [IA32-v2b] "RDTSC". */
+static uint64_t rdtsc(void) {
+  uint64_t tsc;
+
+  asm volatile("rdtsc" : "=A"(tsc));
+  return tsc;
 }
\ No newline at end of file
@@ -10,15 +10,23 @@
 
 void timer_init(void);
 void timer_calibrate(void);
+extern unsigned timer_calib_loops;
+extern unsigned timer_calib_tsc_khz;
 
 int64_t timer_ticks(void);
 int64_t timer_elapsed(int64_t);
+int64_t timer_ns(void);
+uint64_t timer_cycles(void);
+int64_t timer_cycles_ns(uint64_t);
 
 /* Sleep and yield the CPU to other threads. */
 void timer_sleep(int64_t ticks);
+void timer_sleep_slack(int64_t ticks, int64_t slack);
 void timer_msleep(int64_t milliseconds);
 void timer_usleep(int64_t microseconds);
 void timer_nsleep(int64_t nanoseconds);
+void timer_block(int64_t ticks);
+void timer_wake(struct thread*);
 
 /* Busy waits. */
 void timer_mdelay(int64_t milliseconds);
@@ -27,6 +35,9 @@ void timer_ndelay(int64_t nanoseconds);
 
 void timer_print_stats(void);
 
-struct thread* wakeup_thread;
+/* Tickless idle. */
+extern bool timer_tickless;
+void timer_stop_ticks(void);
+void timer_restart_ticks(void);
 
 #endif /* devices/timer.h */
@@ -1,6 +1,7 @@
 #include "devices/vga.h"
 #include <round.h>
 #include <stdint.h>
+#include <stdio.h>
 #include <stddef.h>
 #include <string.h>
 #include "devices/speaker.h"
@@ -26,6 +27,26 @@ static size_t cx, cy;
    The attribute at (x,y) is fb[y][x][1]. */
 static uint8_t (*fb)[COL_CNT][2];
 
+/* Shadow framebuffer.
+
+   Text-mode memory is uncached device memory, so vga_putc()
+   writes to SHADOW, in ordinary RAM, instead, and vga_flush()
+   copies the rows that changed to FB and moves the hardware
+   cursor, which the timer interrupt does once per tick and the
+   console does when it runs out of output.  The rows of SHADOW
+   form a ring: screen row Y is SHADOW[(TOP + Y) % ROW_CNT], so
+   scrolling advances TOP and clears one row instead of moving
+   the screen, and any number of lines scrolled between flushes
+   cost one copy of the screen at the next one. */
+static uint8_t shadow[ROW_CNT][COL_CNT][2];
+static size_t top;     /* Row of SHADOW at the top of the screen. */
+static uint32_t dirty; /* Bit Y set if screen row Y has changed. */
+static bool moved;     /* Has the cursor moved? */
+
+/* Number of times vga_flush() wrote to the screen. */
+static long long flush_cnt;
+
+static uint8_t (*row(size_t y))[2];
 static void clear_row(size_t y);
 static void cls(void);
 static void newline(void);
@@ -38,6 +59,7 @@ static void init(void) {
   static bool inited;
   if (!inited) {
     fb = ptov(0xb8000);
+    memcpy(shadow, fb, sizeof shadow);
     find_cursor(&cx, &cy);
     inited = true;
   }
@@ -83,19 +105,43 @@ void vga_putc(int c) {
       break;
 
     default:
-      fb[cy][cx][0] = c;
-      fb[cy][cx][1] = GRAY_ON_BLACK;
+      row(cy)[cx][0] = c;
+      row(cy)[cx][1] = GRAY_ON_BLACK;
+      dirty |= 1u << cy;
       if (++cx >= COL_CNT)
         newline();
       break;
   }
+  moved = true;
 
-  /* Update cursor position. */
-  move_cursor();
+  intr_set_level(old_level);
+}
+
+/* Copies the rows of the shadow framebuffer that have changed
+   since the last call to the screen and moves the hardware
+   cursor.  Cheap if nothing has changed. */
+void vga_flush(void) {
+  enum intr_level old_level = intr_disable();
+
+  if (dirty != 0 || moved) {
+    size_t y;
+
+    for (y = 0; y < ROW_CNT; y++)
+      if (dirty & (1u << y))
+        memcpy(fb[y], row(y), sizeof fb[y]);
+    if (moved)
+      move_cursor();
+    dirty = 0;
+    moved = false;
+    flush_cnt++;
+  }
 
   intr_set_level(old_level);
 }
 
+/* Prints VGA statistics. */
+void vga_print_stats(void) { printf("VGA: %lld screen updates\n", flush_cnt); }
+
 /* Clears the screen and moves the cursor to the upper left. */
 static void cls(void) {
   size_t y;
@@ -104,29 +150,35 @@ static void cls(void) {
     clear_row(y);
 
   cx = cy = 0;
-  move_cursor();
 }
 
-/* Clears row Y to spaces. */
+/* Returns screen row Y of the shadow framebuffer. */
+static uint8_t (*row(size_t y))[2] { return shadow[(top + y) % ROW_CNT]; }
+
+/* Clears screen row Y to spaces. */
 static void clear_row(size_t y) {
+  uint8_t(*r)[2] = row(y);
   size_t x;
 
   for (x = 0; x < COL_CNT; x++) {
-    fb[y][x][0] = ' ';
-    fb[y][x][1] = GRAY_ON_BLACK;
+    r[x][0] = ' ';
+    r[x][1] = GRAY_ON_BLACK;
   }
+  dirty |= 1u << y;
 }
 
 /* Advances the cursor to the first column in the next line on
    the screen.  If the cursor is already on the last line on the
-   screen, scrolls the screen upward one line. */
+   screen, scrolls the screen upward one line, which changes
+   every row. */
 static void newline(void) {
   cx = 0;
   cy++;
   if (cy >= ROW_CNT) {
     cy = ROW_CNT - 1;
-    memmove(&fb[0], &fb[1], sizeof fb[0] * (ROW_CNT - 1));
+    top = (top + 1) % ROW_CNT;
     clear_row(ROW_CNT - 1);
+    dirty = (1u << ROW_CNT) - 1;
   }
 }
 
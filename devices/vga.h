@@ -2,5 +2,7 @@
 #define DEVICES_VGA_H
 
 void vga_putc(int);
+void vga_flush(void);
+void vga_print_stats(void);
 
 #endif /* devices/vga.h */
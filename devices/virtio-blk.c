@@ -0,0 +1,364 @@
+#include "devices/virtio-blk.h"
+#include <debug.h>
+#include <list.h>
+#include <round.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "devices/block.h"
+#include "devices/partition.h"
+#include "devices/pci.h"
+#include "threads/highmem.h"
+#include "threads/interrupt.h"
+#include "threads/io.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+
+/* A driver for virtio block devices, the paravirtual disks that
+   QEMU provides with -drive if=virtio (see "pintos --virtio").
+   It speaks the legacy interface of [VIRTIO] through the
+   device's I/O ports, which transitional devices, QEMU's
+   default, still offer.
+
+   Each disk has a single virtqueue: a table of descriptors
+   naming buffers in physical memory, a ring in which the driver
+   makes chains of descriptors available to the device, and a
+   ring in which the device hands them back once it has used
+   them.  A request is a chain of three descriptors: a header
+   saying which way to transfer and from what sector, the data,
+   and a status byte that the device fills in.  So a block
+   request of any number of sectors is one virtio request, and
+   up to SLOT_CNT of them are in the device's hands at once.
+   Requests beyond that wait in a queue.
+
+   The only optional feature we take is VIRTIO_BLK_F_FLUSH, which
+   a device with a write cache offers.  A flush request is then a
+   chain of just the header and the status byte.  A device that
+   does not offer it writes through, so a flush completes at
+   once.
+
+   Transfers are asynchronous: virtio_submit() hands a request
+   to the device, or queues it, and returns, and the interrupt
+   handler completes it and hands the device the next queued
+   request.  The rings and queues are protected by disabling
+   interrupts. */
+
+/* PCI IDs of a transitional virtio block device. */
+#define VIRTIO_VENDOR 0x1af4
+#define VIRTIO_BLK_DEVICE 0x1001
+
+/* Legacy virtio I/O port offsets. */
+#define VIRTIO_HOST_FEATURES 0x00  /* Device features (r/o, 32 bits). */
+#define VIRTIO_GUEST_FEATURES 0x04 /* Driver features (32 bits). */
+#define VIRTIO_QUEUE_PFN 0x08      /* Queue page frame number (32 bits). */
+#define VIRTIO_QUEUE_SIZE 0x0c     /* Queue size (r/o, 16 bits). */
+#define VIRTIO_QUEUE_SELECT 0x0e   /* Queue selector (16 bits). */
+#define VIRTIO_QUEUE_NOTIFY 0x10   /* Queue notifier (16 bits). */
+#define VIRTIO_STATUS 0x12         /* Device status (8 bits). */
+#define VIRTIO_ISR 0x13            /* Interrupt status (r/o, 8 bits). */
+#define VIRTIO_BLK_CAPACITY 0x14   /* Capacity in sectors (r/o, 64 bits). */
+
+/* Feature bits. */
+#define VIRTIO_BLK_F_FLUSH (1u << 9) /* Device has a write cache to flush. */
+
+/* Device status bits. */
+#define STATUS_ACKNOWLEDGE 0x01 /* Guest has noticed the device. */
+#define STATUS_DRIVER 0x02      /* Guest knows how to drive it. */
+#define STATUS_DRIVER_OK 0x04   /* Driver is ready. */
+#define STATUS_FAILED 0x80      /* Driver gave up on the device. */
+
+/* Interrupt status bits.  Reading the register clears them. */
+#define ISR_QUEUE 0x01 /* A virtqueue has used buffers. */
+
+/* Legacy virtqueues are laid out in pages of this size. */
+#define VRING_ALIGN 4096
+
+/* A descriptor: one buffer in physical memory. */
+struct vring_desc {
+  uint64_t addr;  /* Physical address. */
+  uint32_t len;   /* Length in bytes. */
+  uint16_t flags; /* VRING_DESC_F_*. */
+  uint16_t next;  /* Next descriptor in the chain, with VRING_DESC_F_NEXT. */
+};
+#define VRING_DESC_F_NEXT 1  /* Chain continues with NEXT. */
+#define VRING_DESC_F_WRITE 2 /* Device writes the buffer, rather than reads. */
+
+/* The ring of chains the driver makes available to the device. */
+struct vring_avail {
+  uint16_t flags;  /* Not used. */
+  uint16_t idx;    /* Where the driver puts the next entry, mod queue size. */
+  uint16_t ring[]; /* Head descriptor of each chain. */
+};
+
+/* An entry in the used ring: a chain the device is done with. */
+struct vring_used_elem {
+  uint32_t id;  /* Head descriptor of the chain. */
+  uint32_t len; /* Bytes the device wrote. */
+};
+
+/* The ring of chains the device has used. */
+struct vring_used {
+  uint16_t flags;                /* Not used. */
+  uint16_t idx;                  /* Where the device puts the next entry. */
+  struct vring_used_elem ring[]; /* Chains used. */
+};
+
+/* Header of a virtio block request. */
+struct virtio_blk_hdr {
+  uint32_t type;     /* VIRTIO_BLK_T_*. */
+  uint32_t reserved; /* Zero. */
+  uint64_t sector;   /* First sector. */
+};
+#define VIRTIO_BLK_T_IN 0    /* Read. */
+#define VIRTIO_BLK_T_OUT 1   /* Write. */
+#define VIRTIO_BLK_T_FLUSH 4 /* Flush the write cache. */
+#define VIRTIO_BLK_S_OK 0    /* Status of a request that succeeded. */
+
+/* Most requests in the device's hands at once, each taking
+   three descriptors. */
+#define SLOT_CNT 32
+
+/* A request in the device's hands.  Slot I's chain is
+   descriptors 3 * I through 3 * I + 2. */
+struct slot {
+  struct virtio_blk_hdr hdr; /* Header, read by the device. */
+  uint8_t status;            /* Status, written by the device. */
+  struct block_request* r;   /* Request, or null if the slot is free. */
+};
+
+/* A virtio block device. */
+struct vblk_disk {
+  char name[8];                /* Name, e.g. "vda". */
+  uint16_t io_base;            /* Base I/O port. */
+  uint8_t irq;                 /* Interrupt vector. */
+  uint16_t qsize;              /* Entries in the virtqueue. */
+  struct vring_desc* desc;     /* Descriptor table. */
+  struct vring_avail* avail;   /* Available ring. */
+  struct vring_used* used;     /* Used ring. */
+  uint16_t used_idx;           /* Used ring entries consumed so far. */
+  bool flush;                  /* Does the device take flushes? */
+  size_t slot_cnt;             /* Slots that fit the queue, up to SLOT_CNT. */
+  struct slot slots[SLOT_CNT]; /* Requests in the device's hands. */
+  struct list waiting;         /* Requests waiting for a slot. */
+};
+
+/* Most virtio disks we drive. */
+#define DISK_MAX 4
+static struct vblk_disk* disks[DISK_MAX];
+static size_t disk_cnt;
+
+static struct block_operations virtio_operations;
+
+static bool init_disk(struct vblk_disk*, const struct pci_addr*);
+static void start_waiting(struct vblk_disk*);
+static void interrupt_handler(struct intr_frame*);
+
+/* Finds the virtio block devices on the PCI bus, sets them up,
+   and registers them with the block device layer. */
+void virtio_blk_init(void) {
+  struct pci_addr a;
+
+  while (disk_cnt < DISK_MAX && pci_find_id(VIRTIO_VENDOR, VIRTIO_BLK_DEVICE, disk_cnt, &a)) {
+    struct vblk_disk* d = calloc(1, sizeof *d);
+    uint64_t capacity;
+    block_sector_t size;
+    struct block* block;
+    size_t i;
+
+    if (d == NULL)
+      PANIC("virtio: out of memory");
+    snprintf(d->name, sizeof d->name, "vd%c", 'a' + (int)disk_cnt);
+    disks[disk_cnt++] = d;
+    if (!init_disk(d, &a))
+      continue;
+
+    /* Share the interrupt handler with other disks on the same
+       line. */
+    for (i = 0; i + 1 < disk_cnt; i++)
+      if (disks[i]->desc != NULL && disks[i]->irq == d->irq)
+        break;
+    if (i + 1 == disk_cnt)
+      intr_register_ext(d->irq, interrupt_handler, "virtio-blk");
+
+    capacity = inl(d->io_base + VIRTIO_BLK_CAPACITY) |
+               (uint64_t)inl(d->io_base + VIRTIO_BLK_CAPACITY + 4) << 32;
+    size = capacity < UINT32_MAX ? capacity : UINT32_MAX;
+    block = block_register(d->name, BLOCK_RAW, "virtio", size, &virtio_operations, d);
+    partition_scan(block);
+  }
+}
+
+/* Resets the device at A for disk D, and sets up its
+   virtqueue.  Returns false, leaving the device marked failed,
+   if the device is unusable. */
+static bool init_disk(struct vblk_disk* d, const struct pci_addr* a) {
+  size_t ring_size, page_cnt;
+  uint8_t* queue;
+  size_t i;
+
+  pci_write_config(a, PCI_COMMAND,
+                   pci_read_config(a, PCI_COMMAND) | PCI_CMD_IO | PCI_CMD_MASTER);
+  d->io_base = pci_read_config(a, PCI_BAR0) & 0xfffc;
+  d->irq = (pci_read_config(a, PCI_IRQ) & 0xff) + 0x20;
+
+  /* Reset, then announce ourselves and take the flush feature,
+     if offered, but none of the others. */
+  outb(d->io_base + VIRTIO_STATUS, 0);
+  outb(d->io_base + VIRTIO_STATUS, STATUS_ACKNOWLEDGE);
+  outb(d->io_base + VIRTIO_STATUS, STATUS_ACKNOWLEDGE | STATUS_DRIVER);
+  d->flush = (inl(d->io_base + VIRTIO_HOST_FEATURES) & VIRTIO_BLK_F_FLUSH) != 0;
+  outl(d->io_base + VIRTIO_GUEST_FEATURES, d->flush ? VIRTIO_BLK_F_FLUSH : 0);
+
+  /* The queue size is the device's to choose.  The descriptors
+     and available ring come first, and the used ring starts on
+     the next page. */
+  outw(d->io_base + VIRTIO_QUEUE_SELECT, 0);
+  d->qsize = inw(d->io_base + VIRTIO_QUEUE_SIZE);
+  if (d->qsize < 3 || d->irq < 0x20 || d->irq > 0x2f) {
+    printf("%s: unusable virtqueue or interrupt line\n", d->name);
+    outb(d->io_base + VIRTIO_STATUS, STATUS_FAILED);
+    return false;
+  }
+  ring_size = ROUND_UP(d->qsize * sizeof(struct vring_desc) + sizeof(struct vring_avail) +
+                           (d->qsize + 1) * sizeof(uint16_t),
+                       VRING_ALIGN);
+  page_cnt = DIV_ROUND_UP(ring_size + sizeof(struct vring_used) +
+                              d->qsize * sizeof(struct vring_used_elem) + sizeof(uint16_t),
+                          PGSIZE);
+  queue = palloc_get_multiple(PAL_ASSERT | PAL_ZERO, page_cnt);
+  d->desc = (struct vring_desc*)queue;
+  d->avail = (struct vring_avail*)(queue + d->qsize * sizeof(struct vring_desc));
+  d->used = (struct vring_used*)(queue + ring_size);
+  d->used_idx = 0;
+  d->slot_cnt = d->qsize / 3 < SLOT_CNT ? d->qsize / 3 : SLOT_CNT;
+  for (i = 0; i < d->slot_cnt; i++)
+    d->slots[i].r = NULL;
+  list_init(&d->waiting);
+  outl(d->io_base + VIRTIO_QUEUE_PFN, vtop(queue) / VRING_ALIGN);
+
+  outb(d->io_base + VIRTIO_STATUS, STATUS_ACKNOWLEDGE | STATUS_DRIVER | STATUS_DRIVER_OK);
+  return true;
+}
+
+/* Queues request R for disk D_ and returns at once.  The
+   interrupt handler completes it. */
+static void virtio_submit(void* d_, struct block_request* r) {
+  struct vblk_disk* d = d_;
+  enum intr_level old_level;
+
+  /* Without a write cache, completed writes are durable already. */
+  if (r->cnt == 0 && !d->flush) {
+    r->complete(r);
+    return;
+  }
+
+  old_level = intr_disable();
+  list_push_back(&d->waiting, &r->elem);
+  start_waiting(d);
+  intr_set_level(old_level);
+}
+
+static struct block_operations virtio_operations = {NULL, NULL, NULL, NULL, virtio_submit};
+
+/* Sets descriptor IDX of disk D to name the SIZE bytes at
+   VADDR, with FLAGS, and to continue with descriptor NEXT if
+   FLAGS says so.  VADDR may be in a page that kmap() mapped, if
+   the SIZE bytes stay within it. */
+static void set_desc(struct vblk_disk* d, size_t idx, const void* vaddr, size_t size,
+                     uint16_t flags, size_t next) {
+  struct vring_desc* desc = &d->desc[idx];
+
+  desc->addr = kmap_vtop(vaddr);
+  desc->len = size;
+  desc->flags = flags;
+  desc->next = next;
+}
+
+/* Hands disk D as many waiting requests as it has free slots
+   for, and lets it know if there are any.  Interrupts must be
+   off. */
+static void start_waiting(struct vblk_disk* d) {
+  bool started = false;
+  size_t i;
+
+  for (i = 0; i < d->slot_cnt && !list_empty(&d->waiting); i++) {
+    struct slot* s = &d->slots[i];
+    struct block_request* r;
+    size_t head = 3 * i;
+
+    if (s->r != NULL)
+      continue;
+    r = s->r = list_entry(list_pop_front(&d->waiting), struct block_request, elem);
+    if (r->cnt == 0)
+      s->hdr.type = VIRTIO_BLK_T_FLUSH;
+    else
+      s->hdr.type = r->write ? VIRTIO_BLK_T_OUT : VIRTIO_BLK_T_IN;
+    s->hdr.reserved = 0;
+    s->hdr.sector = r->cnt == 0 ? 0 : r->sector;
+    s->status = 0xff;
+
+    /* Kernel virtual memory is mapped linearly onto physical
+       memory, so the buffer is physically contiguous too.  A
+       flush skips the data descriptor. */
+    if (r->cnt == 0)
+      set_desc(d, head, &s->hdr, sizeof s->hdr, VRING_DESC_F_NEXT, head + 2);
+    else {
+      set_desc(d, head, &s->hdr, sizeof s->hdr, VRING_DESC_F_NEXT, head + 1);
+      set_desc(d, head + 1, r->buffer, r->cnt * BLOCK_SECTOR_SIZE,
+               VRING_DESC_F_NEXT | (r->write ? 0 : VRING_DESC_F_WRITE), head + 2);
+    }
+    set_desc(d, head + 2, &s->status, sizeof s->status, VRING_DESC_F_WRITE, 0);
+
+    /* The device may look at the entry as soon as it sees the
+       index move, so the entry must be written first.  x86 does
+       not reorder stores, so stopping the compiler from doing so
+       is enough. */
+    d->avail->ring[d->avail->idx % d->qsize] = head;
+    barrier();
+    d->avail->idx++;
+    started = true;
+  }
+  if (started) {
+    barrier();
+    outw(d->io_base + VIRTIO_QUEUE_NOTIFY, 0);
+  }
+}
+
+/* Completes the requests that disk D has finished with, and
+   hands it the waiting requests that now fit. */
+static void service(struct vblk_disk* d) {
+  while (d->used_idx != d->used->idx) {
+    struct vring_used_elem* e;
+    struct slot* s;
+    struct block_request* r;
+
+    barrier();
+    e = &d->used->ring[d->used_idx % d->qsize];
+    s = &d->slots[e->id / 3];
+    r = s->r;
+    if (s->status != VIRTIO_BLK_S_OK)
+      PANIC("%s: %s failed, sector=%" PRDSNu, d->name,
+            r->cnt == 0 ? "flush" : r->write ? "write" : "read", r->sector);
+    s->r = NULL;
+    d->used_idx++;
+
+    /* R may be freed as soon as it is completed. */
+    r->complete(r);
+  }
+  start_waiting(d);
+}
+
+/* Virtio interrupt handler, shared by the disks on one line.
+   Reading each disk's interrupt status acknowledges it. */
+static void interrupt_handler(struct intr_frame* f) {
+  size_t i;
+
+  for (i = 0; i < disk_cnt; i++) {
+    struct vblk_disk* d = disks[i];
+
+    if (d->irq == f->vec_no && d->desc != NULL &&
+        (inb(d->io_base + VIRTIO_ISR) & ISR_QUEUE))
+      service(d);
+  }
+}
@@ -0,0 +1,46 @@
+/* bench-exec.c
+
+   Measures starting a process and waiting for it to exit, with
+   exec() of a program from the file system and with fork().  The
+   child is this same program, run with an argument that makes it
+   exit at once. */
+
+#include <stdio.h>
+#include <string.h>
+#include <syscall.h>
+#include "bench.h"
+
+/* Children per round. */
+#define CHILD_CNT 50
+
+int main(int argc, char* argv[]) {
+  long long start;
+  int i;
+
+  if (argc > 1 && !strcmp(argv[1], "child"))
+    return EXIT_SUCCESS;
+
+  start = bench_ns();
+  for (i = 0; i < CHILD_CNT; i++) {
+    pid_t pid = exec("bench-exec child");
+    if (pid == PID_ERROR || wait(pid) != EXIT_SUCCESS) {
+      printf("bench-exec: exec failed\n");
+      return EXIT_FAILURE;
+    }
+  }
+  bench_latency("exec-wait", bench_ns() - start, CHILD_CNT);
+
+  start = bench_ns();
+  for (i = 0; i < CHILD_CNT; i++) {
+    pid_t pid = fork();
+    if (pid == 0)
+      exit(EXIT_SUCCESS);
+    if (pid == PID_ERROR || wait(pid) != EXIT_SUCCESS) {
+      printf("bench-exec: fork failed\n");
+      return EXIT_FAILURE;
+    }
+  }
+  bench_latency("fork-wait", bench_ns() - start, CHILD_CNT);
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,78 @@
+/* bench-io.c
+
+   Measures file read and write throughput, sequentially and at
+   random block-aligned offsets, at several block sizes.  Each
+   pass moves as many bytes as the file holds. */
+
+#include <random.h>
+#include <stdio.h>
+#include <string.h>
+#include <syscall.h>
+#include "bench.h"
+
+/* Size of the test file, in bytes. */
+#define FILE_SIZE (256 * 1024)
+
+/* Largest block size. */
+#define MAX_BLOCK 16384
+
+static const char file_name[] = "bench.dat";
+static const int block_sizes[] = {512, 4096, MAX_BLOCK};
+static char buf[MAX_BLOCK];
+
+static void bench_pass(int fd, int block_size, bool writing, bool random);
+
+int main(void) {
+  size_t i;
+  int fd;
+
+  if (!create(file_name, FILE_SIZE)) {
+    printf("%s: create failed\n", file_name);
+    return EXIT_FAILURE;
+  }
+  fd = open(file_name);
+  if (fd < 0) {
+    printf("%s: open failed\n", file_name);
+    return EXIT_FAILURE;
+  }
+  memset(buf, 0x5a, sizeof buf);
+  random_init(0);
+
+  for (i = 0; i < sizeof block_sizes / sizeof *block_sizes; i++) {
+    bench_pass(fd, block_sizes[i], true, false);
+    bench_pass(fd, block_sizes[i], false, false);
+    bench_pass(fd, block_sizes[i], true, true);
+    bench_pass(fd, block_sizes[i], false, true);
+  }
+
+  close(fd);
+  remove(file_name);
+  return EXIT_SUCCESS;
+}
+
+/* Writes, if WRITING, or else reads the whole file in blocks of
+   BLOCK_SIZE bytes, in order or, if RANDOM, at random offsets,
+   and reports the throughput. */
+static void bench_pass(int fd, int block_size, bool writing, bool random) {
+  int block_cnt = FILE_SIZE / block_size;
+  char operation[64];
+  long long start;
+  int i;
+
+  snprintf(operation, sizeof operation, "%s-%s-%d", random ? "random" : "seq",
+           writing ? "write" : "read", block_size);
+  start = bench_ns();
+  seek(fd, 0);
+  for (i = 0; i < block_cnt; i++) {
+    int n;
+
+    if (random)
+      seek(fd, random_ulong() % block_cnt * block_size);
+    n = writing ? write(fd, buf, block_size) : read(fd, buf, block_size);
+    if (n != block_size) {
+      printf("%s: %s failed\n", file_name, writing ? "write" : "read");
+      exit(EXIT_FAILURE);
+    }
+  }
+  bench_throughput(operation, bench_ns() - start, FILE_SIZE);
+}
@@ -0,0 +1,69 @@
+/* bench-matmult.c
+
+   Times matmult's matrix multiplication and, if the CPU has
+   performance counters, counts its cache references and misses.
+   The three matrices are contiguous in virtual memory, so how
+   well they share the cache depends on which physical pages back
+   them.  Compare a kernel run with -colors=N, which matches each
+   page's physical color to its virtual one, against one without.
+   Needs project 3. */
+
+#include <stdio.h>
+#include <syscall.h>
+#include "bench.h"
+
+/* Matrix dimension.  Each matrix takes DIM * DIM * 4 bytes. */
+#define DIM 128
+
+/* Multiplications to time. */
+#define PASS_CNT 4
+
+static int A[DIM][DIM];
+static int B[DIM][DIM];
+static int C[DIM][DIM];
+
+static void multiply(void);
+
+int main(void) {
+  unsigned events[PMU_COUNTER_CNT] = {PMU_CACHE_REFS, PMU_CACHE_MISSES};
+  uint64_t counts[PMU_COUNTER_CNT];
+  bool counting;
+  long long start;
+  int i, j;
+
+  /* Initialize the matrices, which also faults in their pages. */
+  for (i = 0; i < DIM; i++)
+    for (j = 0; j < DIM; j++) {
+      A[i][j] = i;
+      B[i][j] = j;
+      C[i][j] = 0;
+    }
+
+  counting = pmu_setup(events, PMU_USER);
+  start = bench_ns();
+  for (i = 0; i < PASS_CNT; i++)
+    multiply();
+  bench_latency("matmult", bench_ns() - start, PASS_CNT);
+
+  if (counting) {
+    pmu_read(counts);
+    bench_report("matmult-cache-refs", counts[0] / PASS_CNT, "refs/op");
+    bench_report("matmult-cache-misses", counts[1] / PASS_CNT, "misses/op");
+    bench_report("matmult-miss-rate", counts[0] > 0 ? counts[1] * 10000 / counts[0] : 0,
+                 "misses/10000refs");
+  } else
+    printf("bench-matmult: no performance counters, cache misses not counted\n");
+
+  return C[DIM - 1][DIM - 1] == PASS_CNT * (DIM - 1) * (DIM - 1) * DIM ? EXIT_SUCCESS
+                                                                      : EXIT_FAILURE;
+}
+
+/* Adds A times B to C, as matmult does. */
+static void multiply(void) {
+  int i, j, k;
+
+  for (i = 0; i < DIM; i++)
+    for (j = 0; j < DIM; j++)
+      for (k = 0; k < DIM; k++)
+        C[i][j] += A[i][k] * B[k][j];
+}
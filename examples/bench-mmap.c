@@ -0,0 +1,77 @@
+/* bench-mmap.c
+
+   Compares two ways of reading a file into memory and looking at
+   every byte: read() into a buffer, which copies the data out of
+   the file system, and mmap(), which pages it in on first touch.
+   Needs project 3. */
+
+#include <stdio.h>
+#include <string.h>
+#include <syscall.h>
+#include "bench.h"
+
+/* Size of the test file, in bytes. */
+#define FILE_SIZE (256 * 1024)
+
+/* Passes over the file. */
+#define PASS_CNT 4
+
+static const char file_name[] = "bench.dat";
+static char buf[FILE_SIZE];
+static unsigned sum_bytes(const char*, size_t);
+
+int main(void) {
+  char* map_addr = (char*)0x10000000;
+  unsigned read_sum = 0, map_sum = 0;
+  long long start;
+  int fd, i;
+
+  if (!create(file_name, FILE_SIZE) || (fd = open(file_name)) < 0) {
+    printf("%s: create failed\n", file_name);
+    return EXIT_FAILURE;
+  }
+  for (i = 0; i < FILE_SIZE; i++)
+    buf[i] = i * 7;
+  write(fd, buf, FILE_SIZE);
+
+  start = bench_ns();
+  for (i = 0; i < PASS_CNT; i++) {
+    seek(fd, 0);
+    if (read(fd, buf, FILE_SIZE) != FILE_SIZE) {
+      printf("%s: read failed\n", file_name);
+      return EXIT_FAILURE;
+    }
+    read_sum += sum_bytes(buf, FILE_SIZE);
+  }
+  bench_throughput("read-copy", bench_ns() - start, (long long)PASS_CNT * FILE_SIZE);
+
+  start = bench_ns();
+  for (i = 0; i < PASS_CNT; i++) {
+    mapid_t map = mmap(fd, map_addr);
+    if (map == MAP_FAILED) {
+      printf("%s: mmap failed\n", file_name);
+      return EXIT_FAILURE;
+    }
+    map_sum += sum_bytes(map_addr, FILE_SIZE);
+    munmap(map);
+  }
+  bench_throughput("mmap-touch", bench_ns() - start, (long long)PASS_CNT * FILE_SIZE);
+
+  if (read_sum != map_sum) {
+    printf("%s: mapped data differs from data read\n", file_name);
+    return EXIT_FAILURE;
+  }
+  close(fd);
+  remove(file_name);
+  return EXIT_SUCCESS;
+}
+
+/* Returns the sum of the SIZE bytes in BUF. */
+static unsigned sum_bytes(const char* buf, size_t size) {
+  unsigned sum = 0;
+  size_t i;
+
+  for (i = 0; i < size; i++)
+    sum += (unsigned char)buf[i];
+  return sum;
+}
@@ -0,0 +1,59 @@
+/* bench-syscall.c
+
+   Measures the round trip of a system call that does no work,
+   through the int $0x30 trap gate and, if the kernel allows it,
+   through sysenter, and for comparison the cost of reading the
+   clock and the process id from the kernel's shared page. */
+
+#include <stdio.h>
+#include <syscall.h>
+#include "bench.h"
+
+/* System calls per round. */
+#define CALL_CNT 100000
+
+/* Where bench_vdso() stores what it reads. */
+static volatile long long sink;
+
+static void bench_calls(const char* operation);
+static void bench_vdso(void);
+
+int main(void) {
+  bool sysenter = syscall_sysenter;
+
+  syscall_sysenter = false;
+  bench_calls("syscall-int");
+  if (sysenter) {
+    syscall_sysenter = true;
+    bench_calls("syscall-sysenter");
+  }
+  bench_vdso();
+  return EXIT_SUCCESS;
+}
+
+/* Reports the cost of a null system call as OPERATION. */
+static void bench_calls(const char* operation) {
+  long long start = bench_ns();
+  int i;
+
+  for (i = 0; i < CALL_CNT; i++)
+    sysenter_available();
+  bench_latency(operation, bench_ns() - start, CALL_CNT);
+}
+
+/* Reports the cost of clock_ns() and getpid(), which read the
+   shared page instead of making a system call. */
+static void bench_vdso(void) {
+  long long start;
+  int i;
+
+  start = bench_ns();
+  for (i = 0; i < CALL_CNT; i++)
+    sink = clock_ns();
+  bench_latency("vdso-clock-ns", bench_ns() - start, CALL_CNT);
+
+  start = bench_ns();
+  for (i = 0; i < CALL_CNT; i++)
+    sink = getpid();
+  bench_latency("vdso-getpid", bench_ns() - start, CALL_CNT);
+}
@@ -0,0 +1,25 @@
+/* bench.c
+
+   Timing and reporting helpers shared by the bench-* programs. */
+
+#include "bench.h"
+#include <stdio.h>
+#include <syscall.h>
+
+/* Returns the current time in nanoseconds. */
+long long bench_ns(void) { return clock_ns(); }
+
+/* Prints a result line for OPERATION. */
+void bench_report(const char* operation, long long value, const char* unit) {
+  printf("bench: %s %lld %s\n", operation, value, unit);
+}
+
+/* Reports that OP_CNT of OPERATION took NS nanoseconds in all. */
+void bench_latency(const char* operation, long long ns, int op_cnt) {
+  bench_report(operation, ns / op_cnt, "ns/op");
+}
+
+/* Reports that OPERATION moved BYTES bytes in NS nanoseconds. */
+void bench_throughput(const char* operation, long long ns, long long bytes) {
+  bench_report(operation, ns > 0 ? bytes * 1000000 / ns : 0, "kB/s");
+}
@@ -0,0 +1,19 @@
+#ifndef EXAMPLES_BENCH_H
+#define EXAMPLES_BENCH_H
+
+/* User-space benchmarks.
+
+   Each bench-* program prints its results with bench_report(),
+   one line per measurement, of the form
+
+      bench: OPERATION VALUE UNIT
+
+   where UNIT is "ns/op" for latencies and "kB/s" for throughput.
+   utils/pintos-bench runs the programs and collects these lines. */
+
+long long bench_ns(void);
+void bench_report(const char* operation, long long value, const char* unit);
+void bench_latency(const char* operation, long long ns, int op_cnt);
+void bench_throughput(const char* operation, long long ns, long long bytes);
+
+#endif /* examples/bench.h */
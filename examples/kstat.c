@@ -0,0 +1,54 @@
+/* kstat.c
+
+   Prints the kernel's statistics: every one, or those whose names
+   start with one of the prefixes given on the command line, as
+   in "kstat vm. cache.". */
+
+#include <kstat.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <syscall.h>
+
+/* Most statistics printed. */
+#define STAT_MAX 256
+
+static struct kstat stats[STAT_MAX];
+
+static bool selected(const char* name, int argc, char* argv[]);
+
+int main(int argc, char* argv[]) {
+  int cnt = kstat(stats, STAT_MAX);
+  int i;
+
+  if (cnt < 0) {
+    printf("kstat: snapshot failed\n");
+    return EXIT_FAILURE;
+  }
+  if (cnt > STAT_MAX) {
+    printf("kstat: showing %d of %d statistics\n", STAT_MAX, cnt);
+    cnt = STAT_MAX;
+  }
+  for (i = 0; i < cnt; i++)
+    if (selected(stats[i].name, argc, argv))
+      printf("%-32s %12lld%s\n", stats[i].name, stats[i].value,
+             stats[i].type == KSTAT_GAUGE ? " (gauge)" : "");
+  return EXIT_SUCCESS;
+}
+
+/* Returns true if NAME starts with one of the prefixes in
+   ARGV[1] through ARGV[ARGC - 1], or if there are none. */
+static bool selected(const char* name, int argc, char* argv[]) {
+  size_t name_len = strlen(name);
+  int i;
+
+  if (argc < 2)
+    return true;
+  for (i = 1; i < argc; i++) {
+    size_t len = strlen(argv[i]);
+
+    if (len <= name_len && !memcmp(name, argv[i], len))
+      return true;
+  }
+  return false;
+}
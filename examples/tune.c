@@ -0,0 +1,37 @@
+/* tune.c
+
+   Prints or changes kernel tunables: "tune NAME..." prints each
+   one named, and "tune NAME=VALUE..." sets it.  The kernel's -h
+   option lists the tunables. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syscall.h>
+
+int main(int argc, char* argv[]) {
+  int status = EXIT_SUCCESS;
+  int i;
+
+  for (i = 1; i < argc; i++) {
+    char* name = argv[i];
+    char* eq = strchr(name, '=');
+    unsigned value;
+
+    if (eq != NULL) {
+      *eq = '\0';
+      if (!settunable(name, atoi(eq + 1))) {
+        printf("tune: cannot set %s to %s\n", name, eq + 1);
+        status = EXIT_FAILURE;
+        continue;
+      }
+    }
+    if (gettunable(name, &value))
+      printf("%s = %u\n", name, value);
+    else {
+      printf("tune: no tunable named %s\n", name);
+      status = EXIT_FAILURE;
+    }
+  }
+  return status;
+}
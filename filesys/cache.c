@@ -0,0 +1,702 @@
+#include "filesys/cache.h"
+#include <debug.h>
+#include <round.h>
+#include <stdio.h>
+#include <string.h>
+#include "devices/timer.h"
+#include "filesys/filesys.h"
+#include "filesys/journal.h"
+#include "threads/interrupt.h"
+#include "threads/kstat.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/waitq.h"
+#include "threads/workqueue.h"
+
+/* Buffer cache.
+
+   Every sector of the file system device that is read or written
+   goes through a cache of CACHE_SIZE sectors, so repeatedly
+   reading a small file or a directory costs no disk I/O, and a
+   partial sector is updated in place instead of being read into
+   a bounce buffer and written straight back.  Writes only mark
+   the cached sector dirty; it goes to disk when it is evicted,
+   when the flusher next runs or when cache_flush() runs at
+   shutdown.
+
+   The flusher is a kernel thread that wakes every
+   cache_flush_interval ticks and writes out every dirty sector,
+   in order of sector number and in runs of adjacent sectors, so
+   the disk sees one sweep instead of one seek per write and
+   writers never wait for the disk themselves.  Each run is
+   copied to a bounce buffer and written with one multi-sector
+   request.  Many small writes
+   to a sector between two flushes cost a single disk write.
+
+   A process that writes a large file could still fill the cache
+   with dirty sectors, so that every other process's misses wait
+   for their write-back.  Each process therefore counts the data
+   sectors it dirtied since the last flush.  Once more than
+   cache_dirty_limit sectors are dirty, inode_write_at() calls
+   cache_throttle(), which wakes the flusher early and makes a
+   process that dirtied at least a quarter of the limit since the
+   last flush wait for the flush, for at most THROTTLE_TICKS at a
+   time.  A heavy writer then dirties about as much per flush as
+   the flusher writes, while processes that write little are not
+   held up at all.
+
+   Entries are replaced with the clock algorithm.  The victim is
+   written back, if dirty, while it still caches its old sector,
+   so a thread that wants the old sector meanwhile waits for the
+   write and then rereads it instead of reading stale data from
+   the disk.
+
+   Sectors written with cache_write_meta() hold metadata, which
+   is only ever written to disk as part of a transaction of the
+   metadata journal (see journal.c).  Each flush commits every
+   dirty metadata sector as one transaction before writing the
+   rest, and the clock passes over dirty metadata while it can.
+   Only if every other entry is in use is a dirty metadata sector
+   written in place to free its entry, which is counted as an
+   unjournaled write.
+
+   Sequential reads are read ahead.  inode_read_at() passes the
+   sectors that follow a sequential read to cache_read_ahead(),
+   which queues those not cached yet for the workqueue to read
+   in the background, so the reader finds them cached instead of
+   waiting for the disk sector by sector.  read_ahead() reads
+   each run of adjacent sectors in the queue with one request.  It
+   never waits for a busy entry: a sector that is cached already
+   or finds no free entry right away is simply not read ahead.
+   Sectors read ahead are
+   filled without their accessed bit set, so ones that turn out
+   not to be wanted are the first to be replaced.  The queue is
+   short, and sectors that do not fit are simply not read ahead.
+
+   Direct I/O (see inode_read_direct()) moves runs of whole
+   sectors between the disk and its caller's buffer without
+   taking cache entries, so streaming through a large file does
+   not push out everything else.  It stays coherent with the
+   cache: cache_read_direct() copies over what it read any
+   sectors the cache holds, which are at least as new as the
+   disk, and cache_write_direct() drops the cached copies of the
+   sectors it writes, both before the write, so that a stale
+   dirty copy is never written over it, and after, in case a
+   reader cached the old contents meanwhile.
+
+   cache_lock protects the sector number of every entry, the
+   clock hand and the read-ahead queue, and is never held while
+   waiting for an entry's lock.  Each entry's own lock is held while its data is read,
+   written or transferred, which makes every sector access
+   atomic. */
+
+/* Number of sectors cached. */
+#define CACHE_SIZE 64
+
+/* Longest wait of a throttled writer, in timer ticks. */
+#define THROTTLE_TICKS (TIMER_FREQ / 10)
+
+/* A cached sector. */
+struct cache_entry {
+  block_sector_t sector;           /* Sector cached, or CACHE_FREE. */
+  bool dirty;                      /* Changed since read from disk? */
+  bool accessed;                   /* Used since the clock last passed? */
+  bool meta;                       /* Metadata, written through the journal? */
+  struct lock lock;                /* Held while DATA is in use. */
+  uint8_t data[BLOCK_SECTOR_SIZE]; /* Contents of the sector. */
+};
+
+/* `sector' of an entry that caches nothing. */
+#define CACHE_FREE ((block_sector_t)-1)
+
+static struct cache_entry cache[CACHE_SIZE];
+static struct lock cache_lock; /* Protects sectors of entries, hand and queue. */
+static size_t hand;            /* Next entry the clock looks at. */
+
+/* Read-ahead queue.  HEAD and TAIL count the sectors ever queued
+   and taken. */
+#define READ_AHEAD_QUEUE 32
+static block_sector_t ra_queue[READ_AHEAD_QUEUE];
+static unsigned ra_head;         /* Sectors queued. */
+static unsigned ra_tail;         /* Sectors taken by read_ahead(). */
+static struct work ra_work;      /* Runs read_ahead(). */
+
+/* Statistics. */
+static long long hit_cnt;         /* Accesses served from the cache. */
+static long long miss_cnt;        /* Accesses that filled an entry. */
+static long long writeback_cnt;   /* Dirty sectors written to disk. */
+static long long read_ahead_cnt;  /* Sectors filled by read_ahead(). */
+static long long flush_run_cnt;   /* Runs of adjacent sectors flushed. */
+static long long unjournaled_cnt; /* Dirty metadata evicted in place. */
+static long long direct_cnt;      /* Sectors moved by direct I/O. */
+static long long throttle_cnt;    /* Waits of throttled writers. */
+
+/* Write-behind. */
+#define FLUSH_RUN_MAX 8                                     /* Most sectors written as one run. */
+static struct lock flush_lock;                              /* Held by whoever is flushing. */
+static uint8_t flush_buf[FLUSH_RUN_MAX * BLOCK_SECTOR_SIZE]; /* Run being written. */
+
+/* Read-ahead bounce buffer, used only by read_ahead(), which
+   never runs twice at once. */
+static uint8_t ra_buf[FLUSH_RUN_MAX * BLOCK_SECTOR_SIZE];
+
+/* -flush: Ticks between writes of dirty sectors, or 0. */
+unsigned cache_flush_interval = TIMER_FREQ;
+
+/* Dirty sectors above which heavy writers are throttled. */
+unsigned cache_dirty_limit = CACHE_SIZE / 2;
+
+/* Write-back throttling.  DIRTY_CNT changes with interrupts
+   off, under the lock of the entry that changes. */
+static volatile unsigned dirty_cnt; /* Dirty entries. */
+static unsigned flush_gen;          /* Flushes done, for each process's count. */
+static struct waitq flush_wanted;   /* Woken to start a flush early. */
+static struct waitq flush_done;     /* Woken at the end of each flush. */
+
+static struct cache_entry* cache_get(block_sector_t, bool load, bool ahead);
+static struct cache_entry* cache_find(block_sector_t);
+static struct cache_entry* cache_lock_cached(block_sector_t);
+static void invalidate(block_sector_t, size_t cnt);
+static void write_at(block_sector_t, const void* buffer, int ofs, int size, bool meta);
+static void flush_dirty(void);
+static void set_dirty(struct cache_entry*, bool dirty);
+static thread_func read_ahead;
+static thread_func flusher;
+
+/* Initializes the buffer cache. */
+void cache_init(void) {
+  size_t i;
+
+  lock_init(&cache_lock);
+  for (i = 0; i < CACHE_SIZE; i++) {
+    cache[i].sector = CACHE_FREE;
+    lock_init(&cache[i].lock);
+  }
+  work_init(&ra_work, read_ahead, NULL);
+  lock_init(&flush_lock);
+  waitq_init(&flush_wanted);
+  waitq_init(&flush_done);
+  kstat_counter("cache.hits", &hit_cnt);
+  kstat_counter("cache.misses", &miss_cnt);
+  kstat_counter("cache.writebacks", &writeback_cnt);
+  kstat_counter("cache.read_ahead", &read_ahead_cnt);
+  kstat_counter("cache.direct", &direct_cnt);
+  kstat_counter("cache.throttles", &throttle_cnt);
+  if (cache_flush_interval > 0 && thread_create("flusher", PRI_DEFAULT, flusher, NULL) == TID_ERROR)
+    PANIC("cache: flusher creation failed");
+}
+
+/* Reads SECTOR into BUFFER, which must have room for
+   BLOCK_SECTOR_SIZE bytes. */
+void cache_read(block_sector_t sector, void* buffer) {
+  cache_read_at(sector, buffer, 0, BLOCK_SECTOR_SIZE);
+}
+
+/* Reads SIZE bytes starting at byte OFS of SECTOR into BUFFER. */
+void cache_read_at(block_sector_t sector, void* buffer, int ofs, int size) {
+  struct cache_entry* e;
+
+  ASSERT(ofs >= 0 && size >= 0 && ofs + size <= BLOCK_SECTOR_SIZE);
+
+  e = cache_get(sector, true, false);
+  memcpy(buffer, e->data + ofs, size);
+  lock_release(&e->lock);
+}
+
+/* Writes BLOCK_SECTOR_SIZE bytes from BUFFER to SECTOR. */
+void cache_write(block_sector_t sector, const void* buffer) {
+  cache_write_at(sector, buffer, 0, BLOCK_SECTOR_SIZE);
+}
+
+/* Writes SIZE bytes from BUFFER to SECTOR, starting at byte OFS.
+   A whole sector is not read from disk first. */
+void cache_write_at(block_sector_t sector, const void* buffer, int ofs, int size) {
+  write_at(sector, buffer, ofs, size, false);
+}
+
+/* Writes BLOCK_SECTOR_SIZE bytes of metadata from BUFFER to
+   SECTOR.  The caller must be in a journal operation. */
+void cache_write_meta(block_sector_t sector, const void* buffer) {
+  write_at(sector, buffer, 0, BLOCK_SECTOR_SIZE, true);
+}
+
+/* Writes SIZE bytes of metadata from BUFFER to SECTOR, starting
+   at byte OFS.  The caller must be in a journal operation. */
+void cache_write_meta_at(block_sector_t sector, const void* buffer, int ofs, int size) {
+  write_at(sector, buffer, ofs, size, true);
+}
+
+/* Writes SIZE bytes from BUFFER to SECTOR, starting at byte OFS,
+   and marks the sector as metadata if META is true.  A sector
+   stays metadata until its entry is replaced. */
+static void write_at(block_sector_t sector, const void* buffer, int ofs, int size, bool meta) {
+  struct cache_entry* e;
+
+  ASSERT(ofs >= 0 && size >= 0 && ofs + size <= BLOCK_SECTOR_SIZE);
+
+  e = cache_get(sector, size < BLOCK_SECTOR_SIZE, false);
+  memcpy(e->data + ofs, buffer, size);
+  if (!e->dirty && !meta && !e->meta) {
+    struct thread* t = thread_current()->process;
+
+    if (t->dirty_gen != flush_gen) {
+      t->dirty_gen = flush_gen;
+      t->dirtied = 0;
+    }
+    t->dirtied++;
+  }
+  set_dirty(e, true);
+  e->meta |= meta;
+  lock_release(&e->lock);
+}
+
+/* Called by inode_write_at() after a write, without locks that
+   the flusher may need.  While more than cache_dirty_limit
+   sectors are dirty, wakes the flusher, and waits for it to
+   finish a flush if the running process dirtied at least a
+   quarter of the limit since the last one.  Never waits inside a
+   journal operation, which a flush would wait for in turn. */
+void cache_throttle(void) {
+  struct thread* t = thread_current()->process;
+  struct waitq_waiter w;
+  struct waitq_entry e;
+
+  if (cache_flush_interval == 0 || dirty_cnt <= cache_dirty_limit
+      || thread_current()->journal_depth > 0)
+    return;
+  waitq_wake(&flush_wanted);
+  if (t->dirty_gen != flush_gen || t->dirtied < DIV_ROUND_UP(cache_dirty_limit, 4))
+    return;
+
+  throttle_cnt++;
+  waitq_waiter_init(&w);
+  e.queued = false;
+  waitq_add(&flush_done, &e, &w);
+  if (t->dirty_gen == flush_gen)
+    waitq_wait(&w, THROTTLE_TICKS);
+  waitq_remove(&e);
+}
+
+/* Queues SECTOR to be read into the cache in the background,
+   unless it is cached already or the queue is full. */
+void cache_read_ahead(block_sector_t sector) {
+  lock_acquire(&cache_lock);
+  if (cache_find(sector) == NULL && ra_head - ra_tail < READ_AHEAD_QUEUE) {
+    ra_queue[ra_head++ % READ_AHEAD_QUEUE] = sector;
+    work_queue(&ra_work, WORK_NORMAL);
+  }
+  lock_release(&cache_lock);
+}
+
+/* Marks SECTOR, if it is cached, as unused since the clock last
+   passed, so that it is replaced before any entry in use.  A
+   dirty sector is still written back first. */
+void cache_drop(block_sector_t sector) {
+  struct cache_entry* e = cache_lock_cached(sector);
+
+  if (e != NULL) {
+    e->accessed = false;
+    lock_release(&e->lock);
+  }
+}
+
+/* Reads the CNT sectors starting at SECTOR into BUFFER with one
+   request, bypassing the cache, except that the sectors the cache
+   holds are copied from it. */
+void cache_read_direct(block_sector_t sector, size_t cnt, void* buffer) {
+  uint8_t* dst = buffer;
+  size_t i;
+
+  block_read_multiple(fs_device, sector, cnt, buffer);
+  for (i = 0; i < cnt; i++) {
+    struct cache_entry* e = cache_lock_cached(sector + i);
+
+    if (e != NULL) {
+      memcpy(dst + i * BLOCK_SECTOR_SIZE, e->data, BLOCK_SECTOR_SIZE);
+      lock_release(&e->lock);
+    }
+  }
+  direct_cnt += cnt;
+}
+
+/* Writes the CNT sectors starting at SECTOR from BUFFER with one
+   request, bypassing the cache, and drops their cached copies.
+   The caller must keep other writers away from the sectors. */
+void cache_write_direct(block_sector_t sector, size_t cnt, const void* buffer) {
+  invalidate(sector, cnt);
+  block_write_multiple(fs_device, sector, cnt, buffer);
+  invalidate(sector, cnt);
+  direct_cnt += cnt;
+}
+
+/* Writes every dirty sector to disk. */
+void cache_flush(void) { flush_dirty(); }
+
+/* Prints buffer cache statistics. */
+void cache_print_stats(void) {
+  printf("Cache: %lld hits, %lld misses, %lld write-backs in %lld runs, %lld read ahead, "
+         "%lld unjournaled, %lld direct\n",
+         hit_cnt, miss_cnt, writeback_cnt, flush_run_cnt, read_ahead_cnt, unjournaled_cnt,
+         direct_cnt);
+}
+
+/* Writes out the dirty sectors every cache_flush_interval
+   ticks, or sooner when cache_throttle() asks. */
+static void flusher(void* aux UNUSED) {
+  struct waitq_waiter w;
+  struct waitq_entry e;
+
+  waitq_waiter_init(&w);
+  e.queued = false;
+  waitq_add(&flush_wanted, &e, &w);
+  for (;;) {
+    waitq_wait(&w, cache_flush_interval);
+    flush_dirty();
+  }
+}
+
+/* Writes the N sectors of RUN, at most FLUSH_RUN_MAX, whose
+   locks are held and which cache adjacent sectors in ascending
+   order, to disk with one request and marks them clean.
+   flush_lock must be held. */
+static void write_run(struct cache_entry** run, size_t n) {
+  size_t i;
+
+  ASSERT(n <= FLUSH_RUN_MAX);
+  for (i = 0; i < n; i++) {
+    memcpy(flush_buf + i * BLOCK_SECTOR_SIZE, run[i]->data, BLOCK_SECTOR_SIZE);
+    set_dirty(run[i], false);
+  }
+  block_write_multiple(fs_device, run[0]->sector, n, flush_buf);
+  writeback_cnt += n;
+  flush_run_cnt++;
+}
+
+/* Writes RUN as write_run() does and releases its entries. */
+static void flush_run(struct cache_entry** run, size_t n) {
+  size_t i;
+
+  write_run(run, n);
+  for (i = 0; i < n; i++)
+    lock_release(&run[i]->lock);
+}
+
+/* Stores the dirty entries that hold metadata, if META is true,
+   or other data, if it is false, into DIRTY and their sectors
+   into SECTORS, sorted by sector, and returns how many there
+   are. */
+static size_t snapshot_dirty(struct cache_entry* dirty[CACHE_SIZE],
+                             block_sector_t sectors[CACHE_SIZE], bool meta) {
+  size_t cnt = 0;
+  size_t i, j;
+
+  /* Sort with an insertion sort, which is fast for 64
+     entries. */
+  lock_acquire(&cache_lock);
+  for (i = 0; i < CACHE_SIZE; i++)
+    if (cache[i].sector != CACHE_FREE && cache[i].dirty && cache[i].meta == meta) {
+      for (j = cnt++; j > 0 && sectors[j - 1] > cache[i].sector; j--) {
+        dirty[j] = dirty[j - 1];
+        sectors[j] = sectors[j - 1];
+      }
+      dirty[j] = &cache[i];
+      sectors[j] = cache[i].sector;
+    }
+  lock_release(&cache_lock);
+  return cnt;
+}
+
+/* Commits every dirty metadata sector as one journal
+   transaction and then writes them home, in ascending order.
+   flush_lock must be held. */
+static void commit_meta(void) {
+  struct cache_entry* dirty[CACHE_SIZE];
+  block_sector_t sectors[CACHE_SIZE];
+  void* datas[CACHE_SIZE];
+  size_t cnt, n, i;
+
+  /* With no operation in progress the metadata is consistent.
+     Hold every entry in the transaction until it is home. */
+  journal_lock();
+  cnt = snapshot_dirty(dirty, sectors, true);
+  for (i = n = 0; i < cnt; i++) {
+    struct cache_entry* e = dirty[i];
+
+    lock_acquire(&e->lock);
+    if (e->sector == sectors[i] && e->dirty && e->meta) {
+      dirty[n] = e;
+      sectors[n] = e->sector;
+      datas[n++] = e->data;
+    } else
+      lock_release(&e->lock);
+  }
+
+  journal_commit(sectors, datas, n);
+  for (i = 0; i < n;) {
+    size_t run = 1;
+
+    while (i + run < n && run < FLUSH_RUN_MAX && sectors[i + run] == sectors[i] + run)
+      run++;
+    write_run(dirty + i, run);
+    i += run;
+  }
+  for (i = 0; i < n; i++)
+    lock_release(&dirty[i]->lock);
+  journal_checkpoint();
+  journal_unlock();
+}
+
+/* Writes every dirty sector to disk: first the metadata, through
+   the journal, and then the rest, in ascending order of sector
+   number and in runs of adjacent sectors.  Sectors dirtied
+   meanwhile may or may not be written. */
+static void flush_dirty(void) {
+  struct cache_entry* dirty[CACHE_SIZE];
+  block_sector_t sectors[CACHE_SIZE];
+  size_t cnt;
+  size_t i;
+
+  lock_acquire(&flush_lock);
+  commit_meta();
+  cnt = snapshot_dirty(dirty, sectors, false);
+
+  /* Lock each run of adjacent sectors, in ascending order, and
+     write it.  An entry that was written back or replaced since
+     the snapshot ends the run. */
+  i = 0;
+  while (i < cnt) {
+    struct cache_entry* run[FLUSH_RUN_MAX];
+    size_t n = 0;
+
+    while (i < cnt && n < FLUSH_RUN_MAX && (n == 0 || sectors[i] == run[0]->sector + n)) {
+      struct cache_entry* e = dirty[i];
+
+      lock_acquire(&e->lock);
+      if (e->sector == sectors[i++] && e->dirty && !e->meta)
+        run[n++] = e;
+      else {
+        lock_release(&e->lock);
+        if (n > 0)
+          break;
+      }
+    }
+    if (n > 0)
+      flush_run(run, n);
+  }
+
+  flush_gen++;
+  lock_release(&flush_lock);
+  waitq_wake(&flush_done);
+}
+
+/* Sets E's dirty bit to DIRTY, keeping dirty_cnt in step.  E's
+   lock must be held. */
+static void set_dirty(struct cache_entry* e, bool dirty) {
+  enum intr_level old_level;
+
+  if (e->dirty == dirty)
+    return;
+  old_level = intr_disable();
+  dirty_cnt += dirty ? 1 : -1;
+  intr_set_level(old_level);
+  e->dirty = dirty;
+}
+
+/* Reads the sectors in the read-ahead queue into the cache. */
+static void read_ahead(void* aux UNUSED) {
+  for (;;) {
+    block_sector_t sectors[FLUSH_RUN_MAX];
+    struct cache_entry* run[FLUSH_RUN_MAX];
+    size_t cnt = 0, n = 0, i;
+
+    /* Take the next sector and the adjacent ones queued after
+       it, or return if the queue is empty. */
+    lock_acquire(&cache_lock);
+    if (ra_tail == ra_head) {
+      lock_release(&cache_lock);
+      return;
+    }
+    sectors[cnt++] = ra_queue[ra_tail++ % READ_AHEAD_QUEUE];
+    while (cnt < FLUSH_RUN_MAX && ra_tail != ra_head &&
+           ra_queue[ra_tail % READ_AHEAD_QUEUE] == sectors[0] + cnt)
+      sectors[cnt++] = ra_queue[ra_tail++ % READ_AHEAD_QUEUE];
+    lock_release(&cache_lock);
+
+    /* Claim entries for them, and read each run of claimed
+       entries with one request. */
+    for (i = 0; i <= cnt; i++) {
+      struct cache_entry* e = i < cnt ? cache_get(sectors[i], false, true) : NULL;
+
+      if (e != NULL)
+        run[n++] = e;
+      else if (n > 0) {
+        size_t j;
+
+        block_read_multiple(fs_device, run[0]->sector, n, ra_buf);
+        for (j = 0; j < n; j++) {
+          memcpy(run[j]->data, ra_buf + j * BLOCK_SECTOR_SIZE, BLOCK_SECTOR_SIZE);
+          lock_release(&run[j]->lock);
+        }
+        n = 0;
+      }
+    }
+  }
+}
+
+/* Returns the entry that caches SECTOR, or a null pointer.
+   cache_lock must be held. */
+static struct cache_entry* cache_find(block_sector_t sector) {
+  size_t i;
+
+  for (i = 0; i < CACHE_SIZE; i++)
+    if (cache[i].sector == sector)
+      return &cache[i];
+  return NULL;
+}
+
+/* Returns the entry that caches SECTOR with its lock held, or a
+   null pointer if SECTOR is not cached.  Never fills an entry. */
+static struct cache_entry* cache_lock_cached(block_sector_t sector) {
+  for (;;) {
+    struct cache_entry* e;
+
+    lock_acquire(&cache_lock);
+    e = cache_find(sector);
+    lock_release(&cache_lock);
+    if (e == NULL)
+      return NULL;
+    lock_acquire(&e->lock);
+    if (e->sector == sector)
+      return e;
+    lock_release(&e->lock);
+  }
+}
+
+/* Drops the cached copies of the CNT sectors starting at SECTOR,
+   without writing them back even if they are dirty. */
+static void invalidate(block_sector_t sector, size_t cnt) {
+  size_t i;
+
+  for (i = 0; i < cnt; i++) {
+    struct cache_entry* e = cache_lock_cached(sector + i);
+
+    if (e != NULL) {
+      lock_acquire(&cache_lock);
+      e->sector = CACHE_FREE;
+      lock_release(&cache_lock);
+      set_dirty(e, false);
+      e->meta = false;
+      e->accessed = false;
+      lock_release(&e->lock);
+    }
+  }
+}
+
+/* Picks an entry to replace with the clock algorithm and returns
+   it with its lock held.  Entries in use are passed over, and so
+   are entries with dirty metadata for the first two sweeps.
+   Returns a null pointer if every entry stayed in use for three
+   sweeps of the clock.  cache_lock must be held. */
+static struct cache_entry* cache_evict(void) {
+  size_t i;
+
+  /* Two sweeps are enough to find any other entry: the first
+     clears every accessed bit it passes. */
+  for (i = 0; i < 3 * CACHE_SIZE; i++) {
+    struct cache_entry* e = &cache[hand];
+
+    hand = (hand + 1) % CACHE_SIZE;
+    if (!lock_try_acquire(&e->lock))
+      continue;
+    if (e->dirty && e->meta && i < 2 * CACHE_SIZE) {
+      lock_release(&e->lock);
+      continue;
+    }
+    if (e->sector == CACHE_FREE || !e->accessed)
+      return e;
+    e->accessed = false;
+    lock_release(&e->lock);
+  }
+  return NULL;
+}
+
+/* Returns the entry for SECTOR, with its lock held, filling an
+   entry for it if it is not cached.  A newly filled entry is
+   read from disk if LOAD is true; otherwise its contents are
+   left as they are, for a caller that overwrites all of them.
+
+   AHEAD is true for reading ahead, which does not count as a use
+   of the sector and never waits for a busy entry.  Then only a
+   newly filled entry is returned, and a null pointer if SECTOR
+   is cached already or no entry is free. */
+static struct cache_entry* cache_get(block_sector_t sector, bool load, bool ahead) {
+  struct cache_entry* e;
+
+  for (;;) {
+    lock_acquire(&cache_lock);
+    e = cache_find(sector);
+    if (e != NULL) {
+      /* The entry may be replaced while we wait for it. */
+      lock_release(&cache_lock);
+      if (ahead)
+        return NULL;
+      lock_acquire(&e->lock);
+      if (e->sector == sector) {
+        if (!ahead) {
+          e->accessed = true;
+          hit_cnt++;
+        }
+        return e;
+      }
+      lock_release(&e->lock);
+      continue;
+    }
+
+    e = cache_evict();
+    if (e == NULL) {
+      /* Wait for one of the entries, donating our priority to
+         its user. */
+      struct cache_entry* busy = &cache[hand];
+
+      lock_release(&cache_lock);
+      if (ahead)
+        return NULL;
+      lock_acquire(&busy->lock);
+      lock_release(&busy->lock);
+      continue;
+    }
+    lock_release(&cache_lock);
+    if (e->dirty) {
+      /* Committing a transaction here could wait for operations
+         that wait for locks our caller holds. */
+      block_write(fs_device, e->sector, e->data);
+      set_dirty(e, false);
+      writeback_cnt++;
+      if (e->meta)
+        unjournaled_cnt++;
+    }
+
+    /* Someone else may have started caching SECTOR while we
+       wrote.  Leave E caching its old sector, which is clean. */
+    lock_acquire(&cache_lock);
+    if (cache_find(sector) != NULL) {
+      lock_release(&cache_lock);
+      lock_release(&e->lock);
+      if (ahead)
+        return NULL;
+      continue;
+    }
+    e->sector = sector;
+    e->meta = false;
+    lock_release(&cache_lock);
+
+    if (load)
+      block_read(fs_device, sector, e->data);
+    e->accessed = !ahead;
+    if (ahead)
+      read_ahead_cnt++;
+    else
+      miss_cnt++;
+    return e;
+  }
+}
@@ -0,0 +1,30 @@
+#ifndef FILESYS_CACHE_H
+#define FILESYS_CACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "devices/block.h"
+
+/* -flush: Ticks between writes of dirty sectors, or 0 to
+   write them only when they are evicted and at shutdown. */
+extern unsigned cache_flush_interval;
+
+/* Dirty sectors above which heavy writers are throttled. */
+extern unsigned cache_dirty_limit;
+
+void cache_init(void);
+void cache_read(block_sector_t, void* buffer);
+void cache_read_at(block_sector_t, void* buffer, int ofs, int size);
+void cache_write(block_sector_t, const void* buffer);
+void cache_write_at(block_sector_t, const void* buffer, int ofs, int size);
+void cache_write_meta(block_sector_t, const void* buffer);
+void cache_write_meta_at(block_sector_t, const void* buffer, int ofs, int size);
+void cache_read_ahead(block_sector_t);
+void cache_drop(block_sector_t);
+void cache_read_direct(block_sector_t, size_t cnt, void* buffer);
+void cache_write_direct(block_sector_t, size_t cnt, const void* buffer);
+void cache_flush(void);
+void cache_throttle(void);
+void cache_print_stats(void);
+
+#endif /* filesys/cache.h */
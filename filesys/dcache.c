@@ -0,0 +1,113 @@
+#include "filesys/dcache.h"
+#include <hash.h>
+#include <stdio.h>
+#include <string.h>
+#include "filesys/directory.h"
+#include "threads/synch.h"
+
+/* Directory entry cache.
+
+   Maps a directory's inode sector and a name in it to the inode
+   sector of the file by that name, so that opening a file whose
+   name was looked up recently reads no directory data.  A name
+   that is known to be missing is cached too, with sector 0.
+   Sector 0 holds the free map's header, so none of the files in a
+   directory ever has it.
+
+   The cache is direct mapped: each (directory, name) pair hashes
+   to a single slot, and a new entry replaces whatever is there.
+
+   directory.c keeps the cache up to date.  dir_add() and
+   dir_remove() update the entry for the name they change while
+   they hold the directory's lock for writing, and dir_create()
+   purges the entries of a directory whose sector is being reused,
+   so a cached entry is never stale.  Names longer than NAME_MAX
+   are never cached, because they cannot be told apart from their
+   truncations. */
+
+/* Number of slots. */
+#define DCACHE_SIZE 128
+
+/* A cached directory entry. */
+struct dentry {
+  block_sector_t dir;      /* Directory's inode sector, or 0 if free. */
+  block_sector_t sector;   /* File's inode sector, or 0 if missing. */
+  char name[NAME_MAX + 1]; /* Null terminated file name. */
+};
+
+static struct dentry dentries[DCACHE_SIZE]; /* Cached entries. */
+static struct lock dcache_lock;             /* Protects dentries. */
+
+/* Statistics. */
+static long long hit_cnt;      /* Lookups of a file that is there. */
+static long long negative_cnt; /* Lookups of a name known missing. */
+static long long miss_cnt;     /* Lookups not in the cache. */
+
+/* Initializes the directory entry cache. */
+void dcache_init(void) { lock_init(&dcache_lock); }
+
+/* Returns the slot for NAME in the directory at sector DIR. */
+static struct dentry* dcache_slot(block_sector_t dir, const char* name) {
+  return &dentries[(hash_string(name) ^ hash_int(dir)) % DCACHE_SIZE];
+}
+
+/* Looks up NAME in the directory whose inode is at sector DIR.
+   If the cache knows the answer, sets *SECTOR to the inode sector
+   of the file by that name, or to 0 if there is none, and returns
+   true.  Otherwise returns false. */
+bool dcache_lookup(block_sector_t dir, const char* name, block_sector_t* sector) {
+  struct dentry* d;
+  bool found = false;
+
+  if (strlen(name) > NAME_MAX)
+    return false;
+
+  d = dcache_slot(dir, name);
+  lock_acquire(&dcache_lock);
+  if (d->dir == dir && !strcmp(d->name, name)) {
+    *sector = d->sector;
+    found = true;
+    if (d->sector != 0)
+      hit_cnt++;
+    else
+      negative_cnt++;
+  } else
+    miss_cnt++;
+  lock_release(&dcache_lock);
+  return found;
+}
+
+/* Records that NAME in the directory whose inode is at sector DIR
+   names the file whose inode is at SECTOR, or that there is no
+   such file if SECTOR is 0. */
+void dcache_set(block_sector_t dir, const char* name, block_sector_t sector) {
+  struct dentry* d;
+
+  if (strlen(name) > NAME_MAX)
+    return;
+
+  d = dcache_slot(dir, name);
+  lock_acquire(&dcache_lock);
+  d->dir = dir;
+  d->sector = sector;
+  strlcpy(d->name, name, sizeof d->name);
+  lock_release(&dcache_lock);
+}
+
+/* Forgets every name cached for the directory whose inode is at
+   sector DIR. */
+void dcache_purge(block_sector_t dir) {
+  size_t i;
+
+  lock_acquire(&dcache_lock);
+  for (i = 0; i < DCACHE_SIZE; i++)
+    if (dentries[i].dir == dir)
+      dentries[i].dir = 0;
+  lock_release(&dcache_lock);
+}
+
+/* Prints directory entry cache statistics. */
+void dcache_print_stats(void) {
+  printf("Dcache: %lld hits, %lld negative hits, %lld misses\n", hit_cnt, negative_cnt,
+         miss_cnt);
+}
@@ -0,0 +1,14 @@
+#ifndef FILESYS_DCACHE_H
+#define FILESYS_DCACHE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "devices/block.h"
+
+void dcache_init(void);
+bool dcache_lookup(block_sector_t dir, const char* name, block_sector_t* sector);
+void dcache_set(block_sector_t dir, const char* name, block_sector_t sector);
+void dcache_purge(block_sector_t dir);
+void dcache_print_stats(void);
+
+#endif /* filesys/dcache.h */
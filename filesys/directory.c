@@ -1,10 +1,38 @@
 #include "filesys/directory.h"
+#include <dirent.h>
+#include <hash.h>
+#include <round.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <string.h>
-#include <list.h>
+#include "filesys/dcache.h"
 #include "filesys/filesys.h"
 #include "filesys/inode.h"
 #include "threads/malloc.h"
+#include "threads/slab.h"
+
+/* Directory layout.
+
+   A directory is a hash table of buckets, each one sector long,
+   that grows by linear hashing.  With N buckets, where 2**L <= N
+   < 2**(L+1), a name whose hash is H belongs in bucket H mod
+   2**(L+1) if that is less than N, and otherwise in bucket H mod
+   2**L.  A lookup thus reads a single sector however large the
+   directory is.
+
+   When dir_add() finds the bucket for a name full, it adds
+   bucket N, moving into it the entries of bucket N - 2**L that
+   now belong there, and tries again.  The number of buckets is
+   the directory's length divided by the sector size, so the
+   table needs no header.  Buckets that have never been written
+   are holes, so a new directory costs no disk space however many
+   buckets it starts with.
+
+   dir_readdir() returns entries in bucket order, and so does
+   dir_readdir_many(), which reads a whole bucket at a time.  A split only
+   moves entries to the new bucket at the end, so a directory read
+   in progress sees every entry that stays in the directory, but
+   may see one again if a concurrent dir_add() moved it. */
 
 /* A directory. */
 struct dir {
@@ -19,23 +47,56 @@ struct dir_entry {
   bool in_use;                 /* In use or free? */
 };
 
+/* Entries in a bucket. */
+#define BUCKET_ENTRIES (BLOCK_SECTOR_SIZE / sizeof(struct dir_entry))
+
+/* A bucket of directory entries.  Exactly BLOCK_SECTOR_SIZE bytes
+   long. */
+struct dir_bucket {
+  struct dir_entry entries[BUCKET_ENTRIES];
+  uint8_t unused[BLOCK_SECTOR_SIZE - BUCKET_ENTRIES * sizeof(struct dir_entry)];
+};
+
+/* Cache of open directories. */
+static struct kmem_cache* dir_cache;
+
+/* Initializes the directory module. */
+void dir_init(void) {
+  dir_cache = kmem_cache_create("dir", sizeof(struct dir), __alignof__(struct dir), NULL);
+}
+
 /* Creates a directory with space for ENTRY_CNT entries in the
-   given SECTOR.  Returns true if successful, false on failure. */
-bool dir_create(block_sector_t sector, size_t entry_cnt) {
-  return inode_create(sector, entry_cnt * sizeof(struct dir_entry));
+   given SECTOR, whose parent is the directory at sector PARENT.
+   The directory grows beyond that as needed.  Besides the
+   entries added later, it holds "." and "..", naming itself and
+   its parent.
+   Returns true if successful, false on failure. */
+bool dir_create(block_sector_t sector, size_t entry_cnt, block_sector_t parent) {
+  size_t bucket_cnt = DIV_ROUND_UP(entry_cnt + 2, BUCKET_ENTRIES);
+  struct dir* dir;
+  bool success;
+
+  ASSERT(sizeof(struct dir_bucket) == BLOCK_SECTOR_SIZE);
+  dcache_purge(sector);
+  if (!inode_create(sector, bucket_cnt * BLOCK_SECTOR_SIZE, true))
+    return false;
+  dir = dir_open(inode_open(sector));
+  success = dir != NULL && dir_add(dir, ".", sector) && dir_add(dir, "..", parent);
+  dir_close(dir);
+  return success;
 }
 
 /* Opens and returns the directory for the given INODE, of which
    it takes ownership.  Returns a null pointer on failure. */
 struct dir* dir_open(struct inode* inode) {
-  struct dir* dir = calloc(1, sizeof *dir);
+  struct dir* dir = kmem_cache_alloc(dir_cache);
   if (inode != NULL && dir != NULL) {
     dir->inode = inode;
     dir->pos = 0;
     return dir;
   } else {
     inode_close(inode);
-    free(dir);
+    kmem_cache_free(dir_cache, dir);
     return NULL;
   }
 }
@@ -56,7 +117,7 @@ struct dir* dir_reopen(struct dir* dir) {
 void dir_close(struct dir* dir) {
   if (dir != NULL) {
     inode_close(dir->inode);
-    free(dir);
+    kmem_cache_free(dir_cache, dir);
   }
 }
 
@@ -65,24 +126,105 @@ struct inode* dir_get_inode(struct dir* dir) {
   return dir->inode;
 }
 
+/* Sets the position in DIR from which dir_readdir() reads next
+   to POS, which an earlier dir_tell() returned. */
+void dir_seek(struct dir* dir, off_t pos) {
+  dir->pos = pos;
+}
+
+/* Returns the position in DIR from which dir_readdir() reads
+   next. */
+off_t dir_tell(const struct dir* dir) {
+  return dir->pos;
+}
+
+/* Returns the number of buckets in DIR. */
+static size_t bucket_cnt(const struct dir* dir) {
+  return inode_length(dir->inode) / BLOCK_SECTOR_SIZE;
+}
+
+/* Returns the largest power of 2 not greater than N, which must
+   be positive. */
+static size_t level_size(size_t n) {
+  size_t low = 1;
+
+  while (low * 2 <= n)
+    low *= 2;
+  return low;
+}
+
+/* Returns the bucket that a name whose hash is HASH belongs in,
+   in a directory with BUCKET_CNT buckets. */
+static size_t hash_to_bucket(unsigned hash, size_t bucket_cnt) {
+  size_t low = level_size(bucket_cnt);
+  size_t bucket = hash % (low * 2);
+
+  return bucket < bucket_cnt ? bucket : hash % low;
+}
+
+/* Reads bucket IDX of DIR into *B.  Returns true if successful. */
+static bool read_bucket(const struct dir* dir, size_t idx, struct dir_bucket* b) {
+  return inode_read_at(dir->inode, b, sizeof *b, idx * sizeof *b) == sizeof *b;
+}
+
+/* Writes *B to bucket IDX of DIR.  Returns true if successful. */
+static bool write_bucket(struct dir* dir, size_t idx, const struct dir_bucket* b) {
+  return inode_write_at(dir->inode, b, sizeof *b, idx * sizeof *b) == sizeof *b;
+}
+
+/* Adds a bucket to DIR and moves into it the entries of the
+   bucket that it splits, as described at the top of the file.
+   Returns false if DIR cannot grow. */
+static bool split_bucket(struct dir* dir) {
+  size_t n = bucket_cnt(dir);
+  size_t old_idx = n - level_size(n);
+  struct dir_bucket* b;
+  size_t i, j;
+  bool success = false;
+
+  b = calloc(2, sizeof *b);
+  if (b == NULL)
+    return false;
+  if (read_bucket(dir, old_idx, &b[0])) {
+    for (i = j = 0; i < BUCKET_ENTRIES; i++) {
+      struct dir_entry* e = &b[0].entries[i];
+      if (e->in_use && hash_to_bucket(hash_string(e->name), n + 1) == n) {
+        b[1].entries[j++] = *e;
+        e->in_use = false;
+      }
+    }
+
+    /* Write the new bucket first, so that a failure leaves the
+       directory as it was. */
+    success = write_bucket(dir, n, &b[1]) && write_bucket(dir, old_idx, &b[0]);
+  }
+  free(b);
+  return success;
+}
+
 /* Searches DIR for a file with the given NAME.
    If successful, returns true, sets *EP to the directory entry
    if EP is non-null, and sets *OFSP to the byte offset of the
    directory entry if OFSP is non-null.
    otherwise, returns false and ignores EP and OFSP. */
 static bool lookup(const struct dir* dir, const char* name, struct dir_entry* ep, off_t* ofsp) {
-  struct dir_entry e;
-  size_t ofs;
+  struct dir_bucket b;
+  size_t idx, i;
 
   ASSERT(dir != NULL);
   ASSERT(name != NULL);
 
-  for (ofs = 0; inode_read_at(dir->inode, &e, sizeof e, ofs) == sizeof e; ofs += sizeof e)
-    if (e.in_use && !strcmp(name, e.name)) {
+  if (bucket_cnt(dir) == 0)
+    return false;
+  idx = hash_to_bucket(hash_string(name), bucket_cnt(dir));
+  if (!read_bucket(dir, idx, &b))
+    return false;
+  for (i = 0; i < BUCKET_ENTRIES; i++)
+    if (b.entries[i].in_use && !strcmp(name, b.entries[i].name)) {
       if (ep != NULL)
-        *ep = e;
+        *ep = b.entries[i];
       if (ofsp != NULL)
-        *ofsp = ofs;
+        *ofsp = idx * sizeof b + i * sizeof *b.entries;
       return true;
     }
   return false;
@@ -91,17 +233,24 @@ static bool lookup(const struct dir* dir, const char* name, struct dir_entry* ep
 /* Searches DIR for a file with the given NAME
    and returns true if one exists, false otherwise.
    On success, sets *INODE to an inode for the file, otherwise to
-   a null pointer.  The caller must close *INODE. */
+   a null pointer.  The caller must close *INODE.
+   Consults the directory entry cache first, and caches what the
+   directory says. */
 bool dir_lookup(const struct dir* dir, const char* name, struct inode** inode) {
+  block_sector_t dir_sector, sector;
   struct dir_entry e;
 
   ASSERT(dir != NULL);
   ASSERT(name != NULL);
 
-  if (lookup(dir, name, &e, NULL))
-    *inode = inode_open(e.inode_sector);
-  else
-    *inode = NULL;
+  dir_sector = inode_get_inumber(dir->inode);
+  inode_read_lock(dir->inode);
+  if (!dcache_lookup(dir_sector, name, &sector)) {
+    sector = lookup(dir, name, &e, NULL) ? e.inode_sector : 0;
+    dcache_set(dir_sector, name, sector);
+  }
+  *inode = sector != 0 ? inode_open(sector) : NULL;
+  inode_read_unlock(dir->inode);
 
   return *inode != NULL;
 }
@@ -114,7 +263,9 @@ bool dir_lookup(const struct dir* dir, const char* name, struct inode** inode) {
    error occurs. */
 bool dir_add(struct dir* dir, const char* name, block_sector_t inode_sector) {
   struct dir_entry e;
-  off_t ofs;
+  struct dir_bucket* b;
+  unsigned hash;
+  size_t idx, i;
   bool success = false;
 
   ASSERT(dir != NULL);
@@ -124,34 +275,84 @@ bool dir_add(struct dir* dir, const char* name, block_sector_t inode_sector) {
   if (*name == '\0' || strlen(name) > NAME_MAX)
     return false;
 
+  /* A removed directory takes no new entries. */
+  if (inode_is_removed(dir->inode))
+    return false;
+
+  b = malloc(sizeof *b);
+  if (b == NULL)
+    return false;
+
+  inode_write_lock(dir->inode);
+
   /* Check that NAME is not in use. */
   if (lookup(dir, name, NULL, NULL))
     goto done;
 
-  /* Set OFS to offset of free slot.
-     If there are no free slots, then it will be set to the
-     current end-of-file.
-     
-     inode_read_at() will only return a short read at end of file.
-     Otherwise, we'd need to verify that we didn't get a short
-     read due to something intermittent such as low memory. */
-  for (ofs = 0; inode_read_at(dir->inode, &e, sizeof e, ofs) == sizeof e; ofs += sizeof e)
-    if (!e.in_use)
+  /* Find a free slot in NAME's bucket, splitting buckets until
+     there is one. */
+  hash = hash_string(name);
+  for (;;) {
+    idx = hash_to_bucket(hash, bucket_cnt(dir));
+    if (!read_bucket(dir, idx, b))
+      goto done;
+    for (i = 0; i < BUCKET_ENTRIES; i++)
+      if (!b->entries[i].in_use)
+        break;
+    if (i < BUCKET_ENTRIES)
       break;
+    if (!split_bucket(dir))
+      goto done;
+  }
 
   /* Write slot. */
   e.in_use = true;
   strlcpy(e.name, name, sizeof e.name);
   e.inode_sector = inode_sector;
-  success = inode_write_at(dir->inode, &e, sizeof e, ofs) == sizeof e;
+  success = inode_write_at(dir->inode, &e, sizeof e, idx * sizeof *b + i * sizeof e) == sizeof e;
+  if (success)
+    dcache_set(inode_get_inumber(dir->inode), name, inode_sector);
 
 done:
+  inode_write_unlock(dir->inode);
+  free(b);
   return success;
 }
 
+/* Returns true if the directory INODE has no entries but "."
+   and "..". */
+static bool is_empty(struct inode* inode) {
+  struct dir dir = {inode, 0};
+  struct dir_bucket* b;
+  size_t idx, i;
+  bool empty = true;
+
+  b = malloc(sizeof *b);
+  if (b == NULL)
+    return false;
+  inode_read_lock(inode);
+  for (idx = 0; empty && idx < bucket_cnt(&dir); idx++) {
+    if (!read_bucket(&dir, idx, b)) {
+      empty = false;
+      break;
+    }
+    for (i = 0; i < BUCKET_ENTRIES; i++)
+      if (b->entries[i].in_use && strcmp(b->entries[i].name, ".") &&
+          strcmp(b->entries[i].name, "..")) {
+        empty = false;
+        break;
+      }
+  }
+  inode_read_unlock(inode);
+  free(b);
+  return empty;
+}
+
 /* Removes any entry for NAME in DIR.
-   Returns true if successful, false on failure,
-   which occurs only if there is no file with the given NAME. */
+   Returns true if successful, false on failure, which occurs if
+   there is no file with the given NAME, if NAME is "." or "..",
+   or if it names a directory that is not empty or that is open
+   elsewhere, including as a process's current directory. */
 bool dir_remove(struct dir* dir, const char* name) {
   struct dir_entry e;
   struct inode* inode = NULL;
@@ -161,8 +362,10 @@ bool dir_remove(struct dir* dir, const char* name) {
   ASSERT(dir != NULL);
   ASSERT(name != NULL);
 
+  inode_write_lock(dir->inode);
+
   /* Find directory entry. */
-  if (!lookup(dir, name, &e, &ofs))
+  if (!strcmp(name, ".") || !strcmp(name, "..") || !lookup(dir, name, &e, &ofs))
     goto done;
 
   /* Open inode. */
@@ -170,6 +373,12 @@ bool dir_remove(struct dir* dir, const char* name) {
   if (inode == NULL)
     goto done;
 
+  /* Only our own opener may have a directory open.  Opening it
+     anew needs DIR's lock, which we hold, or another open
+     reference to it, so it stays unused while we remove it. */
+  if (inode_is_dir(inode) && (inode_open_cnt(inode) > 1 || !is_empty(inode)))
+    goto done;
+
   /* Erase directory entry. */
   e.in_use = false;
   if (inode_write_at(dir->inode, &e, sizeof e, ofs) != sizeof e)
@@ -177,25 +386,68 @@ bool dir_remove(struct dir* dir, const char* name) {
 
   /* Remove inode. */
   inode_remove(inode);
+  dcache_set(inode_get_inumber(dir->inode), name, 0);
   success = true;
 
 done:
+  inode_write_unlock(dir->inode);
   inode_close(inode);
   return success;
 }
 
-/* Reads the next directory entry in DIR and stores the name in
-   NAME.  Returns true if successful, false if the directory
-   contains no more entries. */
+/* Reads the next directory entry in DIR, other than "." and
+   "..", and stores the name in NAME.  Returns true if successful,
+   false if the directory contains no more entries. */
 bool dir_readdir(struct dir* dir, char name[NAME_MAX + 1]) {
   struct dir_entry e;
+  bool found = false;
 
-  while (inode_read_at(dir->inode, &e, sizeof e, dir->pos) == sizeof e) {
-    dir->pos += sizeof e;
-    if (e.in_use) {
+  /* DIR->pos counts entries, skipping the end of each bucket. */
+  inode_read_lock(dir->inode);
+  while (inode_read_at(dir->inode, &e, sizeof e,
+                       dir->pos / BUCKET_ENTRIES * BLOCK_SECTOR_SIZE +
+                           dir->pos % BUCKET_ENTRIES * sizeof e) == sizeof e) {
+    dir->pos++;
+    if (e.in_use && strcmp(e.name, ".") && strcmp(e.name, "..")) {
       strlcpy(name, e.name, NAME_MAX + 1);
-      return true;
+      found = true;
+      break;
     }
   }
-  return false;
+  inode_read_unlock(dir->inode);
+
+  return found;
+}
+
+/* Reads up to CNT of the next entries in DIR, other than "." and
+   "..", into ENTRIES, with their inode numbers and types, and
+   returns the number read, which is less than CNT only at the end
+   of the directory.  Reads the directory a bucket at a time.
+   Returns 0 if memory runs out. */
+size_t dir_readdir_many(struct dir* dir, struct dirent* entries, size_t cnt) {
+  struct dir_bucket* b = malloc(sizeof *b);
+  size_t n = 0;
+
+  if (b == NULL)
+    return 0;
+
+  inode_read_lock(dir->inode);
+  while (n < cnt && inode_read_at(dir->inode, b, sizeof *b,
+                                  dir->pos / BUCKET_ENTRIES * BLOCK_SECTOR_SIZE) == sizeof *b) {
+    do {
+      const struct dir_entry* e = &b->entries[dir->pos++ % BUCKET_ENTRIES];
+
+      if (e->in_use && strcmp(e->name, ".") && strcmp(e->name, "..")) {
+        struct dirent* d = &entries[n++];
+
+        d->d_ino = e->inode_sector;
+        d->d_type = inode_sector_is_dir(e->inode_sector) ? DT_DIR : DT_REG;
+        strlcpy(d->d_name, e->name, sizeof d->d_name);
+      }
+    } while (dir->pos % BUCKET_ENTRIES != 0 && n < cnt);
+  }
+  inode_read_unlock(dir->inode);
+  free(b);
+
+  return n;
 }
@@ -1,28 +1,48 @@
 #include "filesys/file.h"
 #include <debug.h>
 #include "filesys/inode.h"
-#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/slab.h"
+#include "threads/vaddr.h"
 
-/* An open file. */
+/* An open file.
+
+   A file belongs to a single descriptor table, whose process has
+   one thread, and fork() gives the child copies rather than
+   sharing them (see userprog/fd.c), so POS is never updated by
+   two threads at once and file_seek() and file_tell() take no
+   lock. */
 struct file {
   struct inode* inode; /* File's inode. */
   off_t pos;           /* Current position. */
   bool deny_write;     /* Has file_deny_write() been called? */
+  bool direct;         /* Bypass the buffer cache where possible? */
+  bool append;         /* Write only at the end of the file? */
 };
 
+/* Cache of open files. */
+static struct kmem_cache* file_cache;
+
+/* Initializes the file module. */
+void file_init(void) {
+  file_cache = kmem_cache_create("file", sizeof(struct file), __alignof__(struct file), NULL);
+}
+
 /* Opens a file for the given INODE, of which it takes ownership,
    and returns the new file.  Returns a null pointer if an
    allocation fails or if INODE is null. */
 struct file* file_open(struct inode* inode) {
-  struct file* file = calloc(1, sizeof *file);
+  struct file* file = kmem_cache_alloc(file_cache);
   if (inode != NULL && file != NULL) {
     file->inode = inode;
     file->pos = 0;
     file->deny_write = false;
+    file->direct = false;
+    file->append = false;
     return file;
   } else {
     inode_close(inode);
-    free(file);
+    kmem_cache_free(file_cache, file);
     return NULL;
   }
 }
@@ -38,7 +58,7 @@ void file_close(struct file* file) {
   if (file != NULL) {
     file_allow_write(file);
     inode_close(file->inode);
-    free(file);
+    kmem_cache_free(file_cache, file);
   }
 }
 
@@ -73,10 +93,23 @@ off_t file_read_at(struct file* file, void* buffer, off_t size, off_t file_ofs)
    which may be less than SIZE if end of file is reached.
    (Normally we'd grow the file in that case, but file growth is
    not yet implemented.)
-   Advances FILE's position by the number of bytes read. */
+   Advances FILE's position by the number of bytes read.
+   In append mode, writes at the end of the file instead, in one
+   step with respect to other writers, and moves FILE's position
+   to the end of what it wrote. */
 off_t file_write(struct file* file, const void* buffer, off_t size) {
-  off_t bytes_written = inode_write_at(file->inode, buffer, size, file->pos);
-  file->pos += bytes_written;
+  off_t bytes_written;
+
+  if (file->append) {
+    off_t end;
+
+    bytes_written = inode_append(file->inode, buffer, size, &end);
+    if (bytes_written > 0)
+      file->pos = end;
+  } else {
+    bytes_written = inode_write_at(file->inode, buffer, size, file->pos);
+    file->pos += bytes_written;
+  }
   return bytes_written;
 }
 
@@ -91,6 +124,65 @@ off_t file_write_at(struct file* file, const void* buffer, off_t size, off_t fil
   return inode_write_at(file->inode, buffer, size, file_ofs);
 }
 
+/* Copies up to SIZE bytes from SRC, starting at its current
+   position, into DST at its current position, through one page of
+   kernel memory and the buffer cache, and advances both positions.
+   Returns the number of bytes copied, which is less than SIZE if
+   SRC ends or a write falls short, or -1 if no memory is free. */
+off_t file_copy(struct file* dst, struct file* src, off_t size) {
+  uint8_t* buffer = palloc_get_page(0);
+  off_t bytes_copied = 0;
+
+  if (buffer == NULL)
+    return -1;
+  while (size > 0) {
+    off_t chunk_size = size < PGSIZE ? size : PGSIZE;
+    off_t bytes_read = inode_read_at(src->inode, buffer, chunk_size, src->pos);
+    off_t bytes_written;
+
+    if (bytes_read == 0)
+      break;
+    bytes_written = inode_write_at(dst->inode, buffer, bytes_read, dst->pos);
+    src->pos += bytes_written;
+    dst->pos += bytes_written;
+    bytes_copied += bytes_written;
+    size -= bytes_written;
+    if (bytes_written != bytes_read)
+      break;
+  }
+  palloc_free_page(buffer);
+  return bytes_copied;
+}
+
+/* Allocates the sectors for FILE's first LENGTH bytes up front,
+   extending FILE to LENGTH bytes if it is shorter.  Returns false
+   if the disk fills up.  See inode_fallocate(). */
+bool file_allocate(struct file* file, off_t length) {
+  return inode_fallocate(file->inode, length);
+}
+
+/* Applies ADVICE to FILE's LENGTH bytes at OFFSET.  See
+   inode_advise(). */
+void file_advise(struct file* file, off_t offset, off_t length, int advice) {
+  inode_advise(file->inode, offset, length, advice);
+}
+
+/* Sets whether the system calls that read and write FILE move
+   whole sectors between the disk and user memory directly,
+   instead of through the buffer cache (see
+   inode_read_direct()). */
+void file_set_direct(struct file* file, bool direct) { file->direct = direct; }
+
+/* Returns true if FILE is open for direct I/O. */
+bool file_is_direct(struct file* file) { return file->direct; }
+
+/* Sets whether file_write() writes FILE at its end rather than
+   at its position. */
+void file_set_append(struct file* file, bool append) { file->append = append; }
+
+/* Returns true if FILE is in append mode. */
+bool file_is_append(struct file* file) { return file->append; }
+
 /* Prevents write operations on FILE's underlying inode
    until file_allow_write() is called or FILE is closed. */
 void file_deny_write(struct file* file) {
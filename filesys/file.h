@@ -1,10 +1,13 @@
 #ifndef FILESYS_FILE_H
 #define FILESYS_FILE_H
 
+#include <stdbool.h>
 #include "filesys/off_t.h"
 
 struct inode;
 
+void file_init(void);
+
 /* Opening and closing files. */
 struct file* file_open(struct inode*);
 struct file* file_reopen(struct file*);
@@ -16,6 +19,15 @@ off_t file_read(struct file*, void*, off_t);
 off_t file_read_at(struct file*, void*, off_t size, off_t start);
 off_t file_write(struct file*, const void*, off_t);
 off_t file_write_at(struct file*, const void*, off_t size, off_t start);
+off_t file_copy(struct file* dst, struct file* src, off_t size);
+bool file_allocate(struct file*, off_t length);
+void file_advise(struct file*, off_t offset, off_t length, int advice);
+
+/* Direct I/O and append mode. */
+void file_set_direct(struct file*, bool);
+bool file_is_direct(struct file*);
+void file_set_append(struct file*, bool);
+bool file_is_append(struct file*);
 
 /* Preventing writes. */
 void file_deny_write(struct file*);
@@ -2,15 +2,20 @@
 #include <debug.h>
 #include <stdio.h>
 #include <string.h>
+#include "filesys/cache.h"
+#include "filesys/dcache.h"
 #include "filesys/file.h"
 #include "filesys/free-map.h"
 #include "filesys/inode.h"
 #include "filesys/directory.h"
+#include "filesys/journal.h"
+#include "threads/thread.h"
 
 /* Partition that contains the file system. */
 struct block* fs_device;
 
 static void do_format(void);
+static bool resolve(const char* path, struct dir**, char name[NAME_MAX + 1]);
 
 /* Initializes the file system module.
    If FORMAT is true, reformats the file system. */
@@ -19,7 +24,12 @@ void filesys_init(bool format) {
   if (fs_device == NULL)
     PANIC("No file system device found, can't initialize file system.");
 
+  cache_init();
+  journal_init(format);
   inode_init();
+  file_init();
+  dir_init();
+  dcache_init();
   free_map_init();
 
   if (format)
@@ -29,59 +39,205 @@ void filesys_init(bool format) {
 }
 
 /* Shuts down the file system module, writing any unwritten data
-   to disk. */
-void filesys_done(void) { free_map_close(); }
+   to disk and out of the disk's write cache. */
+void filesys_done(void) {
+  cache_flush();
+  block_flush(fs_device);
+}
 
-/* Creates a file named NAME with the given INITIAL_SIZE.
-   Returns true if successful, false otherwise.
-   Fails if a file named NAME already exists,
-   or if internal memory allocation fails. */
-bool filesys_create(const char* name, off_t initial_size) {
-  block_sector_t inode_sector = 0;
-  struct dir* dir = dir_open_root();
-  bool success = (dir != NULL && free_map_allocate(1, &inode_sector) &&
-                  inode_create(inode_sector, initial_size) && dir_add(dir, name, inode_sector));
-  if (!success && inode_sector != 0)
-    free_map_release(inode_sector, 1);
+/* Creates a file, or a directory if IS_DIR is true, at PATH.
+   A file starts out INITIAL_SIZE bytes long. */
+static bool create(const char* path, off_t initial_size, bool is_dir) {
+  block_sector_t inode_sector;
+  struct dir* dir;
+  char name[NAME_MAX + 1];
+  bool created, success = false;
+
+  if (!resolve(path, &dir, name))
+    return false;
+  journal_begin();
+  if (*name != '\0' &&
+      free_map_allocate(1, inode_get_inumber(dir_get_inode(dir)), &inode_sector)) {
+    if (is_dir)
+      created = dir_create(inode_sector, 0, inode_get_inumber(dir_get_inode(dir)));
+    else
+      created = inode_create(inode_sector, initial_size, false);
+    success = created && dir_add(dir, name, inode_sector);
+
+    /* A new directory already has data, which removing its inode
+       frees along with the inode's sector. */
+    if (!success) {
+      struct inode* inode = created ? inode_open(inode_sector) : NULL;
+      if (inode != NULL) {
+        inode_remove(inode);
+        inode_close(inode);
+      } else
+        free_map_release(inode_sector, 1);
+    }
+  }
   dir_close(dir);
+  journal_end();
 
   return success;
 }
 
-/* Opens the file with the given NAME.
+/* Creates a file at PATH with the given INITIAL_SIZE.
+   Returns true if successful, false otherwise.
+   Fails if a file named PATH already exists, if a directory in
+   PATH does not exist, or if internal memory allocation fails. */
+bool filesys_create(const char* path, off_t initial_size) {
+  return create(path, initial_size, false);
+}
+
+/* Creates an empty directory at PATH.
+   Returns true if successful, false otherwise.
+   Fails for the same reasons as filesys_create(). */
+bool filesys_mkdir(const char* path) { return create(path, 0, true); }
+
+/* Opens the file or directory at PATH.
    Returns the new file if successful or a null pointer
    otherwise.
-   Fails if no file named NAME exists,
+   Fails if nothing exists at PATH,
    or if an internal memory allocation fails. */
-struct file* filesys_open(const char* name) {
-  struct dir* dir = dir_open_root();
+struct file* filesys_open(const char* path) {
+  struct dir* dir;
   struct inode* inode = NULL;
+  char name[NAME_MAX + 1];
 
-  if (dir != NULL)
+  if (!resolve(path, &dir, name))
+    return NULL;
+  if (*name == '\0')
+    inode = inode_reopen(dir_get_inode(dir));
+  else
     dir_lookup(dir, name, &inode);
   dir_close(dir);
 
   return file_open(inode);
 }
 
-/* Deletes the file named NAME.
+/* Deletes the file or empty directory at PATH.
    Returns true if successful, false on failure.
-   Fails if no file named NAME exists,
-   or if an internal memory allocation fails. */
-bool filesys_remove(const char* name) {
-  struct dir* dir = dir_open_root();
-  bool success = dir != NULL && dir_remove(dir, name);
+   Fails if nothing exists at PATH, if PATH is a directory that is
+   not empty or is in use, or if an internal memory allocation
+   fails. */
+bool filesys_remove(const char* path) {
+  struct dir* dir;
+  char name[NAME_MAX + 1];
+  bool success;
+
+  if (!resolve(path, &dir, name))
+    return false;
+  journal_begin();
+  success = *name != '\0' && dir_remove(dir, name);
   dir_close(dir);
+  journal_end();
 
   return success;
 }
 
+/* Makes the directory at PATH the current thread's current
+   directory.  Returns true if successful, false if PATH is not a
+   directory. */
+bool filesys_chdir(const char* path) {
+  struct thread* t = thread_current()->process;
+  struct file* file = filesys_open(path);
+  struct dir* dir = NULL;
+
+  if (file != NULL && inode_is_dir(file_get_inode(file)))
+    dir = dir_open(inode_reopen(file_get_inode(file)));
+  file_close(file);
+  if (dir == NULL)
+    return false;
+
+  dir_close(t->cwd);
+  t->cwd = dir;
+  return true;
+}
+
+/* Stores into NAME the next file name part from *SRCP, and
+   advances *SRCP past it.  Returns 1 if successful, 0 at end of
+   string, -1 for a part longer than NAME_MAX. */
+static int get_next_part(char part[NAME_MAX + 1], const char** srcp) {
+  const char* src = *srcp;
+  char* dst = part;
+
+  /* Skip leading slashes.  If it's all slashes, we're done. */
+  while (*src == '/')
+    src++;
+  if (*src == '\0')
+    return 0;
+
+  /* Copy up to NAME_MAX characters from SRC to DST.  Add null
+     terminator. */
+  while (*src != '/' && *src != '\0') {
+    if (dst < part + NAME_MAX)
+      *dst++ = *src;
+    else
+      return -1;
+    src++;
+  }
+  *dst = '\0';
+
+  /* Advance source pointer. */
+  *srcp = src;
+  return 1;
+}
+
+/* Resolves PATH to the directory holding its last component,
+   which it opens and stores in *DIRP, and to that component,
+   which it copies into NAME.  A PATH that starts with `/' is
+   resolved from the root, and any other from the current
+   thread's current directory, so relative lookups never walk
+   down from the root.  A PATH made only of slashes yields the
+   root and an empty NAME.
+   Returns false if PATH is empty, has too long a component, or
+   passes through something that is not a directory. */
+static bool resolve(const char* path, struct dir** dirp, char name[NAME_MAX + 1]) {
+  struct dir* cwd = thread_current()->process->cwd;
+  struct dir* dir;
+  char part[NAME_MAX + 1];
+  int result;
+
+  if (*path == '\0')
+    return false;
+  dir = *path == '/' || cwd == NULL ? dir_open_root() : dir_reopen(cwd);
+  if (dir == NULL)
+    return false;
+
+  /* Each part but the last must be a directory. */
+  name[0] = '\0';
+  while ((result = get_next_part(part, &path)) > 0) {
+    if (name[0] != '\0') {
+      struct inode* inode;
+
+      if (!dir_lookup(dir, name, &inode) || !inode_is_dir(inode)) {
+        inode_close(inode);
+        dir_close(dir);
+        return false;
+      }
+      dir_close(dir);
+      dir = dir_open(inode);
+      if (dir == NULL)
+        return false;
+    }
+    strlcpy(name, part, NAME_MAX + 1);
+  }
+  if (result < 0) {
+    dir_close(dir);
+    return false;
+  }
+
+  *dirp = dir;
+  return true;
+}
+
 /* Formats the file system. */
 static void do_format(void) {
   printf("Formatting file system...");
+  journal_begin();
   free_map_create();
-  if (!dir_create(ROOT_DIR_SECTOR, 16))
+  if (!dir_create(ROOT_DIR_SECTOR, 16, ROOT_DIR_SECTOR))
     PANIC("root directory creation failed");
-  free_map_close();
+  journal_end();
   printf("done.\n");
 }
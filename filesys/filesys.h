@@ -5,7 +5,7 @@
 #include "filesys/off_t.h"
 
 /* Sectors of system file inodes. */
-#define FREE_MAP_SECTOR 0 /* Free map file inode sector. */
+#define FREE_MAP_SECTOR 0 /* Free map header sector. */
 #define ROOT_DIR_SECTOR 1 /* Root directory file inode sector. */
 
 /* Block device that contains the file system. */
@@ -13,8 +13,10 @@ struct block* fs_device;
 
 void filesys_init(bool format);
 void filesys_done(void);
-bool filesys_create(const char* name, off_t initial_size);
-struct file* filesys_open(const char* name);
-bool filesys_remove(const char* name);
+bool filesys_create(const char* path, off_t initial_size);
+bool filesys_mkdir(const char* path);
+struct file* filesys_open(const char* path);
+bool filesys_remove(const char* path);
+bool filesys_chdir(const char* path);
 
 #endif /* filesys/filesys.h */
@@ -1,68 +1,242 @@
 #include "filesys/free-map.h"
 #include <bitmap.h>
 #include <debug.h>
-#include "filesys/file.h"
+#include <limits.h>
+#include <round.h>
+#include <stdint.h>
+#include "filesys/cache.h"
 #include "filesys/filesys.h"
-#include "filesys/inode.h"
+#include "filesys/journal.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
 
-static struct file* free_map_file; /* Free map file. */
-static struct bitmap* free_map;    /* Free map, one bit per sector. */
+/* Allocation groups.
+
+   The device is divided into groups of GROUP_SECTORS sectors,
+   whose bits fill exactly one sector of the free map, and each
+   group's count of free sectors is kept in memory.  An
+   allocation starts at a hint, such as the sector of the inode
+   the new sector belongs to, and takes the first free run after
+   it in the hint's group, trying the groups that follow only if
+   that one is full, so that a file's sectors and its inode end up
+   close together.  Groups with too few free sectors are skipped
+   without looking at their bits.  A run never crosses from one
+   group into the next.
+
+   The free map is not a file, which could not grow large enough
+   for a big disk.  Its sectors, one per group, follow the journal
+   in a fixed region that is marked allocated in the map itself.
+   Only the bits of the group being worked on are in memory, in
+   CHUNK; the other groups' sectors are read through the buffer
+   cache when they are needed, and an allocation or release
+   writes back the one sector that holds the bits it changed, as
+   metadata.  The memory that stays is 2 bytes of count per
+   group, or 1 kB for each GB of disk.
+
+   A new file system has written only the groups that hold the
+   free map's own region.  The header in FREE_MAP_SECTOR records
+   how many groups have been written, and the ones after them are
+   all free, so they cost no I/O to format or to count at mount.
+   Allocation only moves into an unwritten group once the groups
+   before it are full, and writes the groups it skips, if any,
+   as empty on the way. */
+
+/* Sectors per allocation group. */
+#define GROUP_SECTORS (BLOCK_SECTOR_SIZE * CHAR_BIT)
+
+/* First sector of the free map region. */
+#define MAP_START (JOURNAL_SECTOR + JOURNAL_SECTORS)
+
+/* Identifies a free map header. */
+#define FREE_MAP_MAGIC 0x46524d50
+
+/* On-disk free map header.  Exactly BLOCK_SECTOR_SIZE bytes long. */
+struct free_map_header {
+  uint32_t magic;            /* FREE_MAP_MAGIC. */
+  block_sector_t sector_cnt; /* Sectors on the device. */
+  uint32_t init_cnt;         /* Groups written; the rest are free. */
+  uint8_t unused[BLOCK_SECTOR_SIZE - 12];
+};
+
+static struct free_map_header header; /* Header. */
+static struct bitmap* chunk;          /* Bits of group CHUNK_GROUP. */
+static size_t chunk_group;            /* Group in CHUNK, or SIZE_MAX if none. */
+static uint16_t* group_free;          /* Free sectors in each group. */
+static size_t group_cnt;              /* Number of groups. */
+static struct lock free_map_lock;     /* Protects the above and the region. */
+
+static void count_free(void);
 
 /* Initializes the free map. */
 void free_map_init(void) {
-  free_map = bitmap_create(block_size(fs_device));
-  if (free_map == NULL)
-    PANIC("bitmap creation failed--file system device is too large");
-  bitmap_mark(free_map, FREE_MAP_SECTOR);
-  bitmap_mark(free_map, ROOT_DIR_SECTOR);
+  block_sector_t sector_cnt = block_size(fs_device);
+
+  lock_init(&free_map_lock);
+  group_cnt = DIV_ROUND_UP(sector_cnt, GROUP_SECTORS);
+  if (MAP_START + group_cnt >= sector_cnt)
+    PANIC("file system device is too small");
+  group_free = calloc(group_cnt, sizeof *group_free);
+  if (group_free == NULL)
+    PANIC("free map group table allocation failed");
+  chunk = bitmap_create(GROUP_SECTORS);
+  if (chunk == NULL)
+    PANIC("free map chunk allocation failed");
+  chunk_group = SIZE_MAX;
+  header.sector_cnt = sector_cnt;
+}
+
+/* Returns the number of sectors in GROUP, which is
+   GROUP_SECTORS for every group but the last. */
+static size_t group_len(size_t group) {
+  size_t len = header.sector_cnt - group * GROUP_SECTORS;
+  return len < GROUP_SECTORS ? len : GROUP_SECTORS;
 }
 
-/* Allocates CNT consecutive sectors from the free map and stores
-   the first into *SECTORP.
+/* Makes CHUNK hold the bits of GROUP.  The bits past the end of
+   the device are set, so that they are never allocated. */
+static void load_chunk(size_t group) {
+  size_t len = group_len(group);
+
+  if (chunk_group == group)
+    return;
+  if (group < header.init_cnt)
+    cache_read(MAP_START + group, bitmap_bits(chunk));
+  else
+    bitmap_set_all(chunk, false);
+  if (len < GROUP_SECTORS)
+    bitmap_set_multiple(chunk, len, GROUP_SECTORS - len, true);
+  chunk_group = group;
+}
+
+/* Writes CHUNK back to its group's sector, first writing any
+   unwritten groups before it as empty and recording in the
+   header that they are written. */
+static void store_chunk(void) {
+  static char zeros[BLOCK_SECTOR_SIZE];
+
+  if (chunk_group >= header.init_cnt) {
+    for (; header.init_cnt < chunk_group; header.init_cnt++)
+      cache_write_meta(MAP_START + header.init_cnt, zeros);
+    header.init_cnt = chunk_group + 1;
+    cache_write_meta(FREE_MAP_SECTOR, &header);
+  }
+  cache_write_meta(MAP_START + chunk_group, bitmap_bits(chunk));
+}
+
+/* Returns the first sector of a run of CNT free sectors in group
+   GROUP that starts at or after sector START of the group, or
+   BITMAP_ERROR if there is none.  Leaves the group in CHUNK if
+   it had to look at its bits. */
+static size_t scan_group(size_t group, size_t start, size_t cnt) {
+  size_t idx;
+
+  if (group_free[group] < cnt)
+    return BITMAP_ERROR;
+  load_chunk(group);
+  idx = bitmap_scan(chunk, start, cnt, false);
+  return idx != BITMAP_ERROR ? group * GROUP_SECTORS + idx : BITMAP_ERROR;
+}
+
+/* Allocates CNT consecutive sectors from the free map, as close
+   after sector HINT as possible, and stores the first into
+   *SECTORP.  CNT may not exceed the sectors in one group.
    Returns true if successful, false if not enough consecutive
-   sectors were available or if the free_map file could not be
-   written. */
-bool free_map_allocate(size_t cnt, block_sector_t* sectorp) {
-  block_sector_t sector = bitmap_scan_and_flip(free_map, 0, cnt, false);
-  if (sector != BITMAP_ERROR && free_map_file != NULL && !bitmap_write(free_map, free_map_file)) {
-    bitmap_set_multiple(free_map, sector, cnt, false);
-    sector = BITMAP_ERROR;
+   sectors were available. */
+bool free_map_allocate(size_t cnt, block_sector_t hint, block_sector_t* sectorp) {
+  size_t first, i;
+  size_t sector = BITMAP_ERROR;
+
+  ASSERT(cnt > 0 && cnt <= GROUP_SECTORS);
+
+  lock_acquire(&free_map_lock);
+  if (hint >= header.sector_cnt)
+    hint = 0;
+  first = hint / GROUP_SECTORS;
+  for (i = 0; i < group_cnt && sector == BITMAP_ERROR; i++) {
+    size_t group = (first + i) % group_cnt;
+    sector = scan_group(group, i == 0 ? hint % GROUP_SECTORS : 0, cnt);
+  }
+
+  /* The part of the hint's group below the hint comes last. */
+  if (sector == BITMAP_ERROR)
+    sector = scan_group(first, 0, cnt);
+
+  if (sector != BITMAP_ERROR) {
+    bitmap_set_multiple(chunk, sector % GROUP_SECTORS, cnt, true);
+    group_free[chunk_group] -= cnt;
+    store_chunk();
   }
+  lock_release(&free_map_lock);
   if (sector != BITMAP_ERROR)
     *sectorp = sector;
   return sector != BITMAP_ERROR;
 }
 
+/* Sets the CNT sectors starting at SECTOR to ALLOCATED, or to
+   free, group by group, updating the groups' free counts and
+   writing their sectors. */
+static void mark(block_sector_t sector, size_t cnt, bool allocated) {
+  while (cnt > 0) {
+    size_t group = sector / GROUP_SECTORS;
+    size_t ofs = sector % GROUP_SECTORS;
+    size_t n = GROUP_SECTORS - ofs < cnt ? GROUP_SECTORS - ofs : cnt;
+
+    load_chunk(group);
+    ASSERT(bitmap_none(chunk, ofs, n) == allocated);
+    bitmap_set_multiple(chunk, ofs, n, allocated);
+    if (allocated)
+      group_free[group] -= n;
+    else
+      group_free[group] += n;
+    store_chunk();
+    sector += n;
+    cnt -= n;
+  }
+}
+
 /* Makes CNT sectors starting at SECTOR available for use. */
 void free_map_release(block_sector_t sector, size_t cnt) {
-  ASSERT(bitmap_all(free_map, sector, cnt));
-  bitmap_set_multiple(free_map, sector, cnt, false);
-  bitmap_write(free_map, free_map_file);
+  lock_acquire(&free_map_lock);
+  mark(sector, cnt, false);
+  lock_release(&free_map_lock);
 }
 
-/* Opens the free map file and reads it from disk. */
+/* Counts the free sectors in each group, reading the bits of
+   the groups that have been written. */
+static void count_free(void) {
+  size_t group;
+
+  for (group = 0; group < group_cnt; group++)
+    if (group < header.init_cnt) {
+      load_chunk(group);
+      group_free[group] = bitmap_count(chunk, 0, GROUP_SECTORS, false);
+    } else
+      group_free[group] = group_len(group);
+}
+
+/* Reads the free map header from disk and counts the free
+   sectors in each group. */
 void free_map_open(void) {
-  free_map_file = file_open(inode_open(FREE_MAP_SECTOR));
-  if (free_map_file == NULL)
-    PANIC("can't open free map");
-  if (!bitmap_read(free_map, free_map_file))
+  lock_acquire(&free_map_lock);
+  cache_read(FREE_MAP_SECTOR, &header);
+  if (header.magic != FREE_MAP_MAGIC)
     PANIC("can't read free map");
+  if (header.sector_cnt != block_size(fs_device))
+    PANIC("free map is for a device of %" PRDSNu " sectors", header.sector_cnt);
+  chunk_group = SIZE_MAX;
+  count_free();
+  lock_release(&free_map_lock);
 }
 
-/* Writes the free map to disk and closes the free map file. */
-void free_map_close(void) { file_close(free_map_file); }
-
-/* Creates a new free map file on disk and writes the free map to
-   it. */
+/* Creates a new free map on disk, in which the free map header,
+   the root directory's inode, the journal and the free map
+   region are allocated and all other sectors are free. */
 void free_map_create(void) {
-  /* Create inode. */
-  if (!inode_create(FREE_MAP_SECTOR, bitmap_file_size(free_map)))
-    PANIC("free map creation failed");
-
-  /* Write bitmap to file. */
-  free_map_file = file_open(inode_open(FREE_MAP_SECTOR));
-  if (free_map_file == NULL)
-    PANIC("can't open free map");
-  if (!bitmap_write(free_map, free_map_file))
-    PANIC("can't write free map");
+  lock_acquire(&free_map_lock);
+  header.magic = FREE_MAP_MAGIC;
+  header.init_cnt = 0;
+  chunk_group = SIZE_MAX;
+  count_free();
+  mark(0, MAP_START + group_cnt, true);
+  lock_release(&free_map_lock);
 }
@@ -9,9 +9,8 @@ void free_map_init(void);
 void free_map_read(void);
 void free_map_create(void);
 void free_map_open(void);
-void free_map_close(void);
 
-bool free_map_allocate(size_t, block_sector_t*);
+bool free_map_allocate(size_t, block_sector_t hint, block_sector_t*);
 void free_map_release(block_sector_t, size_t);
 
 #endif /* filesys/free-map.h */
@@ -1,14 +1,19 @@
 #include "filesys/fsutil.h"
 #include <debug.h>
+#include <round.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <ustar.h>
+#include "devices/ide.h"
+#include "devices/timer.h"
 #include "filesys/directory.h"
 #include "filesys/file.h"
 #include "filesys/filesys.h"
 #include "threads/malloc.h"
 #include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
 #include "threads/vaddr.h"
 
 /* List files in the root directory. */
@@ -60,8 +65,20 @@ void fsutil_rm(char** argv) {
     PANIC("%s: delete failed\n", file_name);
 }
 
+/* Pages in the buffer that fsutil_extract() copies file data
+   through, and the sectors they hold. */
+#define EXTRACT_PAGES 32
+#define EXTRACT_SECTORS (EXTRACT_PAGES * PGSIZE / BLOCK_SECTOR_SIZE)
+
 /* Extracts a ustar-format tar archive from the scratch block
-   device into the Pintos file system. */
+   device into the Pintos file system.
+
+   Each file's data is read from the scratch device up to
+   EXTRACT_SECTORS sectors per request and written to the file
+   with one file_write() per buffer, so that a typical test
+   program takes one read and one write.  The file is created at
+   its full size as a hole, so creating it writes no zeros, and
+   the first write allocates all of its sectors at once. */
 void fsutil_extract(char** argv UNUSED) {
   static block_sector_t sector = 0;
 
@@ -70,7 +87,7 @@ void fsutil_extract(char** argv UNUSED) {
 
   /* Allocate buffers. */
   header = malloc(BLOCK_SECTOR_SIZE);
-  data = malloc(BLOCK_SECTOR_SIZE);
+  data = palloc_get_multiple(0, EXTRACT_PAGES);
   if (header == NULL || data == NULL)
     PANIC("couldn't allocate buffers");
 
@@ -113,8 +130,15 @@ void fsutil_extract(char** argv UNUSED) {
 
       /* Do copy. */
       while (size > 0) {
-        int chunk_size = (size > BLOCK_SECTOR_SIZE ? BLOCK_SECTOR_SIZE : size);
-        block_read(src, sector++, data);
+        size_t sector_cnt = DIV_ROUND_UP(size, BLOCK_SECTOR_SIZE);
+        int chunk_size = size;
+
+        if (sector_cnt > EXTRACT_SECTORS) {
+          sector_cnt = EXTRACT_SECTORS;
+          chunk_size = EXTRACT_SECTORS * BLOCK_SECTOR_SIZE;
+        }
+        block_read_multiple(src, sector, sector_cnt, data);
+        sector += sector_cnt;
         if (file_write(dst, data, chunk_size) != chunk_size)
           PANIC("%s: write failed with %d bytes unwritten", file_name, size);
         size -= chunk_size;
@@ -134,13 +158,27 @@ void fsutil_extract(char** argv UNUSED) {
   block_write(src, 0, header);
   block_write(src, 1, header);
 
-  free(data);
+  palloc_free_multiple(data, EXTRACT_PAGES);
   free(header);
 }
 
+/* Pages in the buffer that fsutil_append() gathers archive
+   sectors in, and the sectors they hold. */
+#define APPEND_PAGES 32
+#define APPEND_SECTORS (APPEND_PAGES * PGSIZE / BLOCK_SECTOR_SIZE)
+
+static void append_write(struct block*, block_sector_t, const void*, size_t cnt,
+                         const char* file_name);
+
 /* Copies file FILE_NAME from the file system to the scratch
    device, in ustar format.
 
+   The header and the data sectors are gathered in a buffer of
+   APPEND_SECTORS sectors, which is written out with one request
+   each time it fills and once at the end, together with the
+   end-of-archive marker.  So a file of a few megabytes of logs
+   takes a few dozen writes instead of one per sector.
+
    The first call to this function will write starting at the
    beginning of the scratch device.  Later calls advance across
    the device.  This position is independent of that used for
@@ -150,7 +188,8 @@ void fsutil_append(char** argv) {
   static block_sector_t sector = 0;
 
   const char* file_name = argv[1];
-  void* buffer;
+  char* buffer;
+  size_t buf_cnt;
   struct file* src;
   struct block* dst;
   off_t size;
@@ -158,7 +197,7 @@ void fsutil_append(char** argv) {
   printf("Appending '%s' to ustar archive on scratch device...\n", file_name);
 
   /* Allocate buffer. */
-  buffer = malloc(BLOCK_SECTOR_SIZE);
+  buffer = palloc_get_multiple(0, APPEND_PAGES);
   if (buffer == NULL)
     PANIC("couldn't allocate buffer");
 
@@ -173,31 +212,137 @@ void fsutil_append(char** argv) {
   if (dst == NULL)
     PANIC("couldn't open scratch device");
 
-  /* Write ustar header to first sector. */
+  /* Put the ustar header in the first sector. */
   if (!ustar_make_header(file_name, USTAR_REGULAR, size, buffer))
     PANIC("%s: name too long for ustar format", file_name);
-  block_write(dst, sector++, buffer);
+  buf_cnt = 1;
 
-  /* Do copy. */
+  /* Read the data into the buffer after the header, padding the
+     last sector with zeros, and write out the buffer whenever it
+     fills. */
   while (size > 0) {
-    int chunk_size = size > BLOCK_SECTOR_SIZE ? BLOCK_SECTOR_SIZE : size;
-    if (sector >= block_size(dst))
-      PANIC("%s: out of space on scratch device", file_name);
-    if (file_read(src, buffer, chunk_size) != chunk_size)
+    char* p = buffer + buf_cnt * BLOCK_SECTOR_SIZE;
+    off_t room = (APPEND_SECTORS - buf_cnt) * BLOCK_SECTOR_SIZE;
+    int chunk_size = size > room ? room : size;
+
+    if (file_read(src, p, chunk_size) != chunk_size)
       PANIC("%s: read failed with %" PROTd " bytes unread", file_name, size);
-    memset(buffer + chunk_size, 0, BLOCK_SECTOR_SIZE - chunk_size);
-    block_write(dst, sector++, buffer);
+    memset(p + chunk_size, 0, ROUND_UP(chunk_size, BLOCK_SECTOR_SIZE) - chunk_size);
+    buf_cnt += DIV_ROUND_UP(chunk_size, BLOCK_SECTOR_SIZE);
     size -= chunk_size;
+    if (buf_cnt == APPEND_SECTORS) {
+      append_write(dst, sector, buffer, buf_cnt, file_name);
+      sector += buf_cnt;
+      buf_cnt = 0;
+    }
   }
 
-  /* Write ustar end-of-archive marker, which is two consecutive
-     sectors full of zeros.  Don't advance our position past
-     them, though, in case we have more files to append. */
-  memset(buffer, 0, BLOCK_SECTOR_SIZE);
-  block_write(dst, sector, buffer);
-  block_write(dst, sector, buffer + 1);
+  /* Add the ustar end-of-archive marker, which is two consecutive
+     sectors full of zeros, and write out the rest.  Don't advance
+     our position past the marker, though, in case we have more
+     files to append. */
+  if (buf_cnt + 2 > APPEND_SECTORS) {
+    append_write(dst, sector, buffer, buf_cnt, file_name);
+    sector += buf_cnt;
+    buf_cnt = 0;
+  }
+  memset(buffer + buf_cnt * BLOCK_SECTOR_SIZE, 0, 2 * BLOCK_SECTOR_SIZE);
+  append_write(dst, sector, buffer, buf_cnt + 2, file_name);
+  sector += buf_cnt;
 
   /* Finish up. */
   file_close(src);
-  free(buffer);
+  palloc_free_multiple(buffer, APPEND_PAGES);
+}
+
+/* Writes the CNT sectors in BUFFER to scratch device DST,
+   starting at SECTOR, in one request, for fsutil_append() to
+   append FILE_NAME. */
+static void append_write(struct block* dst, block_sector_t sector, const void* buffer,
+                         size_t cnt, const char* file_name) {
+  if (sector + cnt > block_size(dst))
+    PANIC("%s: out of space on scratch device", file_name);
+  block_write_multiple(dst, sector, cnt, buffer);
+}
+
+/* Block device benchmark. */
+
+#define BENCH_RUN 128          /* Sectors read per request. */
+#define BENCH_MAX (16 * 1024)  /* Most sectors read per pass. */
+#define BENCH_CALIBRATE_MS 100 /* Time to measure the idle spin rate. */
+
+static volatile bool bench_spinning; /* Keep spinning? */
+static volatile int64_t bench_spins; /* Iterations spun. */
+static struct semaphore bench_done;  /* Up'd when the spinner exits. */
+
+/* Counts iterations for as long as BENCH_SPINNING is set.  Run at
+   PRI_MIN, it gets just the CPU time nothing else wants. */
+static void bench_spinner(void* aux UNUSED) {
+  while (bench_spinning)
+    bench_spins++;
+  sema_up(&bench_done);
+}
+
+/* Reads CNT sectors of BLOCK sequentially into BUFFER, which has
+   room for BENCH_RUN of them, and prints the throughput and the
+   share of the CPU the reads took from the spinner, which spins
+   SPIN_RATE times per ms when it has the CPU to itself. */
+static void bench_pass(struct block* block, block_sector_t cnt, void* buffer, const char* mode,
+                       int64_t spin_rate) {
+  block_sector_t sector;
+  int64_t start, ms, spins, cpu;
+
+  spins = bench_spins;
+  start = timer_ns();
+  for (sector = 0; sector < cnt; sector += BENCH_RUN) {
+    size_t n = cnt - sector < BENCH_RUN ? cnt - sector : BENCH_RUN;
+    block_read_multiple(block, sector, n, buffer);
+  }
+  ms = (timer_ns() - start) / 1000000;
+  spins = bench_spins - spins;
+  if (ms == 0)
+    ms = 1;
+
+  cpu = 100 - spins * 100 / (spin_rate * ms);
+  printf("%s: %s: %lld kB/s, %lld%% CPU\n", block_name(block), mode,
+         (long long)cnt * BLOCK_SECTOR_SIZE / ms * 1000 / 1024, (long long)(cpu < 0 ? 0 : cpu));
+}
+
+/* Reads block device ARGV[1], without writing it, first by DMA
+   and then by PIO, and reports the throughput of each and how
+   much of the CPU it kept busy.  The CPU share is measured by
+   what the reads leave to a thread spinning at the lowest
+   priority, so it is only meaningful if nothing else runs. */
+void fsutil_bench(char** argv) {
+  const char* name = argv[1];
+  struct block* block = block_get_by_name(name);
+  block_sector_t cnt;
+  bool no_dma = ide_no_dma;
+  int64_t spin_rate;
+  void* buffer;
+
+  if (block == NULL)
+    PANIC("%s: no such block device", name);
+  cnt = block_size(block) < BENCH_MAX ? block_size(block) : BENCH_MAX;
+  buffer = palloc_get_multiple(PAL_ASSERT, DIV_ROUND_UP(BENCH_RUN * BLOCK_SECTOR_SIZE, PGSIZE));
+
+  printf("Reading %" PRDSNu " sectors of '%s' by DMA and by PIO...\n", cnt, name);
+  bench_spinning = true;
+  bench_spins = 0;
+  sema_init(&bench_done, 0);
+  thread_create("bench-spin", PRI_MIN, bench_spinner, NULL);
+  timer_msleep(BENCH_CALIBRATE_MS);
+  spin_rate = bench_spins / BENCH_CALIBRATE_MS;
+  if (spin_rate == 0)
+    spin_rate = 1;
+
+  ide_no_dma = false;
+  bench_pass(block, cnt, buffer, "DMA", spin_rate);
+  ide_no_dma = true;
+  bench_pass(block, cnt, buffer, "PIO", spin_rate);
+  ide_no_dma = no_dma;
+
+  bench_spinning = false;
+  sema_down(&bench_done);
+  palloc_free_multiple(buffer, DIV_ROUND_UP(BENCH_RUN * BLOCK_SECTOR_SIZE, PGSIZE));
 }
@@ -6,5 +6,6 @@ void fsutil_cat(char** argv);
 void fsutil_rm(char** argv);
 void fsutil_extract(char** argv);
 void fsutil_append(char** argv);
+void fsutil_bench(char** argv);
 
 #endif /* filesys/fsutil.h */
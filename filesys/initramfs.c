@@ -0,0 +1,180 @@
+#include "filesys/initramfs.h"
+#include <debug.h>
+#include <hash.h>
+#include <round.h>
+#include <stdio.h>
+#include <string.h>
+#include <ustar.h>
+#include "devices/block.h"
+#include "filesys/file.h"
+#include "filesys/inode.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/vaddr.h"
+
+/* Initial RAM file system.
+
+   With -initramfs, initramfs_init() reads the whole ustar archive
+   on the scratch device, the one that `extract' would copy into
+   the file system, into kernel memory at boot.  Each regular file
+   in it becomes a read-only RAM inode over its bytes in the
+   archive (see inode_open_ram()), and process_execute() looks a
+   program up here before it tries the file system, so that
+   starting it reads nothing from disk.  The inodes stay open, so
+   every process running the same program shares one inode, and
+   with VM, its read-only pages.
+
+   Only exec sees these files.  open() and the other file system
+   calls still go to the file system, which need not hold the
+   programs at all. */
+
+bool initramfs_enabled;
+
+/* A file in the archive. */
+struct initramfs_file {
+  struct hash_elem elem; /* Element in `files'. */
+  const char* name;      /* Name, in the archive's header. */
+  struct inode* inode;   /* RAM inode over the file's data. */
+};
+
+/* Sectors read from the scratch device per request. */
+#define READ_SECTORS 256
+
+static struct hash files;     /* Files in the archive, by name. */
+static void* archive;         /* The archive, in memory. */
+static size_t archive_pages;  /* Pages that ARCHIVE takes. */
+static long long open_cnt;    /* Opens served from memory. */
+
+static hash_hash_func file_hash;
+static hash_less_func file_less;
+static block_sector_t archive_sectors(struct block*);
+static void add_files(void);
+
+/* Loads the scratch device's archive into memory, if -initramfs
+   was given.  Must be called after filesys_init(), which sets up
+   inodes. */
+void initramfs_init(void) {
+  struct block* src;
+  block_sector_t sector_cnt, sector;
+
+  if (!initramfs_enabled)
+    return;
+  if (!hash_init(&files, file_hash, file_less, NULL))
+    PANIC("initramfs: file table creation failed");
+
+  src = block_get_role(BLOCK_SCRATCH);
+  if (src == NULL) {
+    printf("initramfs: no scratch device\n");
+    return;
+  }
+
+  sector_cnt = archive_sectors(src);
+  archive_pages = DIV_ROUND_UP(sector_cnt * BLOCK_SECTOR_SIZE, PGSIZE);
+  archive = palloc_get_multiple(0, archive_pages);
+  if (archive == NULL) {
+    printf("initramfs: no memory for %zu pages\n", archive_pages);
+    return;
+  }
+  for (sector = 0; sector < sector_cnt; sector += READ_SECTORS) {
+    block_sector_t cnt = sector_cnt - sector < READ_SECTORS ? sector_cnt - sector : READ_SECTORS;
+    block_read_multiple(src, sector, cnt, (uint8_t*)archive + sector * BLOCK_SECTOR_SIZE);
+  }
+
+  add_files();
+  printf("initramfs: %zu files, %zu kB\n", hash_size(&files), archive_pages * PGSIZE / 1024);
+}
+
+/* Returns the number of sectors that the archive on SRC takes,
+   up to but not including its end-of-archive marker, reading
+   only its headers. */
+static block_sector_t archive_sectors(struct block* src) {
+  char* header = malloc(BLOCK_SECTOR_SIZE);
+  block_sector_t sector = 0;
+
+  if (header == NULL)
+    PANIC("initramfs: couldn't allocate header buffer");
+  for (;;) {
+    const char* file_name;
+    const char* error;
+    enum ustar_type type;
+    int size;
+
+    block_read(src, sector, header);
+    error = ustar_parse_header(header, &file_name, &type, &size);
+    if (error != NULL)
+      PANIC("initramfs: bad ustar header in sector %" PRDSNu " (%s)", sector, error);
+    if (type == USTAR_EOF)
+      break;
+    sector += 1 + DIV_ROUND_UP(size, BLOCK_SECTOR_SIZE);
+  }
+  free(header);
+  return sector;
+}
+
+/* Adds a RAM inode to `files' for each regular file in the
+   archive, which is in memory. */
+static void add_files(void) {
+  size_t ofs = 0;
+
+  while (ofs < archive_pages * PGSIZE) {
+    const char* header = (const char*)archive + ofs;
+    const char* file_name;
+    enum ustar_type type;
+    int size;
+
+    if (ustar_parse_header(header, &file_name, &type, &size) != NULL || type == USTAR_EOF)
+      break;
+    ofs += BLOCK_SECTOR_SIZE;
+    if (type == USTAR_REGULAR) {
+      struct initramfs_file* f = malloc(sizeof *f);
+
+      if (f == NULL)
+        PANIC("initramfs: couldn't allocate file table");
+      f->name = file_name;
+      f->inode = inode_open_ram((const char*)archive + ofs, size);
+      if (f->inode == NULL)
+        PANIC("initramfs: couldn't allocate inode");
+      if (hash_insert(&files, &f->elem) != NULL) {
+        inode_close(f->inode);
+        free(f);
+      }
+    }
+    ofs += ROUND_UP(size, BLOCK_SECTOR_SIZE);
+  }
+}
+
+/* Opens the file named NAME in the archive, read-only, and
+   returns it, or a null pointer if there is no such file or
+   -initramfs was not given. */
+struct file* initramfs_open(const char* name) {
+  struct initramfs_file key;
+  struct hash_elem* e;
+
+  if (archive == NULL)
+    return NULL;
+  key.name = name;
+  e = hash_find(&files, &key.elem);
+  if (e == NULL)
+    return NULL;
+  open_cnt++;
+  return file_open(inode_reopen(hash_entry(e, struct initramfs_file, elem)->inode));
+}
+
+/* Prints initramfs statistics. */
+void initramfs_print_stats(void) {
+  if (archive != NULL)
+    printf("Initramfs: %zu files, %lld opens\n", hash_size(&files), open_cnt);
+}
+
+/* Returns a hash of the name of the file that E is embedded in. */
+static unsigned file_hash(const struct hash_elem* e, void* aux UNUSED) {
+  return hash_string(hash_entry(e, struct initramfs_file, elem)->name);
+}
+
+/* Returns true if the name of file A sorts before that of file
+   B. */
+static bool file_less(const struct hash_elem* a, const struct hash_elem* b, void* aux UNUSED) {
+  return strcmp(hash_entry(a, struct initramfs_file, elem)->name,
+                hash_entry(b, struct initramfs_file, elem)->name)
+         < 0;
+}
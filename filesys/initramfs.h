@@ -0,0 +1,14 @@
+#ifndef FILESYS_INITRAMFS_H
+#define FILESYS_INITRAMFS_H
+
+#include <stdbool.h>
+
+/* -initramfs: Serve programs from the scratch device's archive,
+   loaded into memory at boot? */
+extern bool initramfs_enabled;
+
+void initramfs_init(void);
+struct file* initramfs_open(const char* name);
+void initramfs_print_stats(void);
+
+#endif /* filesys/initramfs.h */
@@ -1,63 +1,429 @@
 #include "filesys/inode.h"
-#include <list.h>
 #include <debug.h>
+#include <fcntl.h>
+#include <hash.h>
 #include <round.h>
+#include <stdio.h>
 #include <string.h>
+#include "filesys/cache.h"
 #include "filesys/filesys.h"
 #include "filesys/free-map.h"
+#include "filesys/journal.h"
+#include "threads/interrupt.h"
 #include "threads/malloc.h"
+#include "threads/slab.h"
+#include "threads/synch.h"
+#include "threads/tracepoint.h"
+#ifdef VM
+#include "threads/vaddr.h"
+#include "vm/frame.h"
+#endif
 
 /* Identifies an inode. */
 #define INODE_MAGIC 0x494e4f44
 
+/* Sector pointers in the inode and in an index sector. */
+#define DIRECT_CNT 123
+#define PTRS_PER_SECTOR (BLOCK_SECTOR_SIZE / sizeof(block_sector_t))
+
+/* Largest file, in sectors. */
+#define MAX_SECTORS (DIRECT_CNT + PTRS_PER_SECTOR + PTRS_PER_SECTOR * PTRS_PER_SECTOR)
+
+/* Marks a data sector pointer whose sector is allocated but not
+   yet written.  Disks have fewer than 2**31 sectors. */
+#define SECTOR_UNWRITTEN 0x80000000u
+
+/* Sector number of a RAM inode, which has no disk location. */
+#define RAM_SECTOR UINT32_MAX
+
+/* Largest file whose data fits in the inode instead of the
+   sector pointers. */
+#define INLINE_MAX ((DIRECT_CNT + 2) * sizeof(block_sector_t))
+
 /* On-disk inode.
-   Must be exactly BLOCK_SECTOR_SIZE bytes long. */
+   Must be exactly BLOCK_SECTOR_SIZE bytes long.
+
+   The first DIRECT_CNT data sectors are named in the inode
+   itself, the next PTRS_PER_SECTOR in the index sector INDIRECT,
+   and the rest, up to about 8 MB, through the index sectors named
+   by the index sector DOUBLY_INDIRECT.  Sector 0 holds the free
+   map's header, so it never holds data, and a pointer of 0 means
+   none.
+
+   Files may be sparse: a data sector is allocated when it is
+   first written, and until then it is a hole that reads back as
+   zeros, as does an index sector that has not been allocated.
+
+   inode_fallocate() allocates data sectors ahead of the writes
+   without zeroing them.  Their pointers carry SECTOR_UNWRITTEN
+   until they are first written, and they read back as zeros,
+   like holes, meanwhile.  The first write of such a sector
+   zeroes it and clears the mark, in the cache, just as if it
+   were being allocated, but needs nothing from the free map.
+
+   A file no longer than INLINE_MAX bytes keeps its data in the
+   inode itself, in place of the sector pointers, so reading it
+   takes no I/O beyond the inode and it needs no data sector.
+   Bytes past the end of inline data are always zero.  A write
+   that would take the file past INLINE_MAX bytes first moves the
+   data out to a data sector.  Directories are never inline. */
 struct inode_disk {
-  block_sector_t start; /* First data sector. */
-  off_t length;         /* File size in bytes. */
-  unsigned magic;       /* Magic number. */
-  uint32_t unused[125]; /* Not used. */
+  off_t length;                          /* File size in bytes. */
+  unsigned magic;                        /* Magic number. */
+  bool is_dir;                           /* Directory rather than file? */
+  bool is_inline;                        /* Data in INLINE_DATA? */
+  uint8_t unused[2];                     /* Not used. */
+  union {
+    struct {
+      block_sector_t direct[DIRECT_CNT]; /* First data sectors. */
+      block_sector_t indirect;           /* Index of the next data sectors. */
+      block_sector_t doubly_indirect;    /* Index of indexes of the rest. */
+    };
+    uint8_t inline_data[INLINE_MAX];     /* Data of an inline file. */
+  };
 };
 
 /* Returns the number of sectors to allocate for an inode SIZE
    bytes long. */
 static inline size_t bytes_to_sectors(off_t size) { return DIV_ROUND_UP(size, BLOCK_SECTOR_SIZE); }
 
-/* In-memory inode. */
+/* In-memory inode.
+
+   A directory's entries are protected by RWLOCK, and the data of
+   any inode by DATA_LOCK.  A directory operation holds RWLOCK
+   while it reads or writes the entries through DATA_LOCK, so
+   RWLOCK is always acquired first.
+
+   An inode whose OPEN_CNT is 0 is closed but kept for reuse; see
+   unused_inodes.
+
+   A RAM inode, made by inode_open_ram(), reads its data from RAM
+   in place of a disk, is read-only, and is not in open_inodes. */
 struct inode {
-  struct list_elem elem;  /* Element in inode list. */
-  block_sector_t sector;  /* Sector number of disk location. */
-  int open_cnt;           /* Number of openers. */
-  bool removed;           /* True if deleted, false otherwise. */
-  int deny_write_cnt;     /* 0: writes ok, >0: deny writes. */
-  struct inode_disk data; /* Inode content. */
+  struct hash_elem elem;   /* Element in open_inodes. */
+  struct list_elem lru;    /* Element in unused_inodes, if OPEN_CNT is 0. */
+  block_sector_t sector;   /* Sector number of disk location. */
+  int open_cnt;            /* Number of openers. */
+  bool removed;            /* True if deleted, false otherwise. */
+  int deny_write_cnt;      /* 0: writes ok, >0: deny writes. */
+  unsigned version;        /* Incremented by each write. */
+  struct rwlock rwlock;    /* Protects a directory's entries. */
+  struct rwlock data_lock; /* Orders reads and writes of the data. */
+  off_t read_end;          /* Offset just past the last read. */
+  off_t read_ahead_end;    /* Offset just past the last sector read ahead. */
+  int advice;              /* POSIX_FADV_NORMAL, _RANDOM or _SEQUENTIAL. */
+  block_sector_t prealloc; /* First sector reserved for appends. */
+  size_t prealloc_cnt;     /* Number of sectors reserved. */
+  size_t prealloc_idx;     /* Data sector index PREALLOC is for. */
+  const uint8_t* ram;      /* Data of a RAM inode, or null. */
+  struct inode_disk data;  /* Inode content. */
 };
 
+/* Preallocation for appends.
+
+   A write that fills a hole past the end of a file reserves a
+   run of consecutive sectors, enough for the rest of the write
+   and at least PREALLOC_MIN, and the appends that follow take
+   their sectors from the run in order.  A file written by many
+   small appends thus ends up contiguous, and the free map is
+   updated once per run instead of once per sector.  Whatever is
+   left of a run is released when the inode is last closed, so a
+   crash in the meantime leaks it. */
+#define PREALLOC_MIN 8  /* Fewest sectors reserved at once. */
+#define PREALLOC_MAX 64 /* Most sectors reserved at once. */
+
+/* -read-ahead: Sectors to read ahead of sequential reads.
+
+   A read that starts where the previous read of the inode ended
+   is taken to be sequential, and the INODE_READ_AHEAD sectors
+   after it, less those queued already, are handed to the buffer
+   cache to fetch in the background.  Any other read stops read
+   ahead until the reads are sequential again, so random access
+   costs no extra I/O.
+
+   fadvise() can override the guess for an inode.  POSIX_FADV_RANDOM
+   turns read-ahead off; POSIX_FADV_SEQUENTIAL takes every read as
+   sequential, reads SEQUENTIAL_FACTOR times as far ahead, and
+   lets the buffer cache give up each sector once it has been
+   read to its end. */
+size_t inode_read_ahead = 8;
+#define SEQUENTIAL_FACTOR 4
+
+/* Returns entry IDX of index sector TABLE, or 0 if TABLE is 0. */
+static block_sector_t index_entry(block_sector_t table, size_t idx) {
+  block_sector_t sector = 0;
+
+  if (table != 0)
+    cache_read_at(table, &sector, idx * sizeof sector, sizeof sector);
+  return sector;
+}
+
+/* Returns the sector that holds data sector IDX of the file
+   whose disk inode is DISK, or 0 if it has none. */
+static block_sector_t index_to_sector(const struct inode_disk* disk, size_t idx) {
+  if (idx < DIRECT_CNT)
+    return disk->direct[idx];
+  idx -= DIRECT_CNT;
+  if (idx < PTRS_PER_SECTOR)
+    return index_entry(disk->indirect, idx);
+  idx -= PTRS_PER_SECTOR;
+  return index_entry(index_entry(disk->doubly_indirect, idx / PTRS_PER_SECTOR),
+                     idx % PTRS_PER_SECTOR);
+}
+
 /* Returns the block device sector that contains byte offset POS
    within INODE.
-   Returns -1 if INODE does not contain data for a byte at offset
-   POS. */
+   Returns 0 if the byte is in a hole, or -1 if INODE does not
+   contain data for a byte at offset POS. */
 static block_sector_t byte_to_sector(const struct inode* inode, off_t pos) {
   ASSERT(inode != NULL);
-  if (pos < inode->data.length)
-    return inode->data.start + pos / BLOCK_SECTOR_SIZE;
-  else
+  if (pos < inode->data.length) {
+    block_sector_t sector = index_to_sector(&inode->data, pos / BLOCK_SECTOR_SIZE);
+    return sector & SECTOR_UNWRITTEN ? 0 : sector;
+  } else
     return -1;
 }
 
-/* List of open inodes, so that opening a single inode twice
-   returns the same `struct inode'. */
-static struct list open_inodes;
+/* Stores a zeroed sector into *SECTORP, unless *SECTORP names
+   one already: RESERVED if it is not 0, or else one allocated as
+   close after HINT as possible.  META is true if the sector will
+   hold metadata.  An unwritten sector in *SECTORP is zeroed and
+   loses its mark instead, and an unwritten RESERVED is stored
+   as it is, without being zeroed.  Returns false if the disk is
+   full. */
+static bool allocate_sector(block_sector_t* sectorp, block_sector_t hint, bool meta,
+                            block_sector_t reserved) {
+  static char zeros[BLOCK_SECTOR_SIZE];
+
+  if (*sectorp & SECTOR_UNWRITTEN)
+    *sectorp &= ~SECTOR_UNWRITTEN;
+  else if (*sectorp != 0)
+    return true;
+  else if (reserved & SECTOR_UNWRITTEN) {
+    *sectorp = reserved;
+    return true;
+  } else if (reserved != 0)
+    *sectorp = reserved;
+  else if (!free_map_allocate(1, hint, sectorp))
+    return false;
+  if (meta)
+    cache_write_meta(*sectorp, zeros);
+  else
+    cache_write(*sectorp, zeros);
+  return true;
+}
+
+/* Makes sure that index sector *TABLEP exists and that its entry
+   IDX names a sector, allocating them as needed near HINT.  META
+   is true if the entry's sector will hold metadata, and RESERVED,
+   if not 0, is the sector to use for it.
+   Returns false if the disk is full. */
+static bool allocate_entry(block_sector_t* tablep, size_t idx, block_sector_t hint, bool meta,
+                           block_sector_t reserved) {
+  block_sector_t sector;
+
+  if (!allocate_sector(tablep, hint, true, 0))
+    return false;
+  sector = index_entry(*tablep, idx);
+  if (sector != 0 && !(sector & SECTOR_UNWRITTEN))
+    return true;
+  if (!allocate_sector(&sector, hint, meta, reserved))
+    return false;
+  cache_write_meta_at(*tablep, &sector, idx * sizeof sector, sizeof sector);
+  return true;
+}
+
+/* Makes sure that data sector IDX of the file whose disk inode
+   is DISK exists, allocating it and the index sectors that lead
+   to it as needed near HINT.  META is true if the file holds
+   metadata, and RESERVED, if not 0, is the sector to use for the
+   data.  Returns false if the disk is full or IDX is beyond the
+   largest file. */
+static bool allocate_index(struct inode_disk* disk, size_t idx, block_sector_t hint, bool meta,
+                           block_sector_t reserved) {
+  block_sector_t table;
+
+  if (idx < DIRECT_CNT)
+    return allocate_sector(&disk->direct[idx], hint, meta, reserved);
+  idx -= DIRECT_CNT;
+  if (idx < PTRS_PER_SECTOR)
+    return allocate_entry(&disk->indirect, idx, hint, meta, reserved);
+  idx -= PTRS_PER_SECTOR;
+  if (idx >= PTRS_PER_SECTOR * PTRS_PER_SECTOR ||
+      !allocate_entry(&disk->doubly_indirect, idx / PTRS_PER_SECTOR, hint, true, 0))
+    return false;
+  table = index_entry(disk->doubly_indirect, idx / PTRS_PER_SECTOR);
+  return allocate_entry(&table, idx % PTRS_PER_SECTOR, hint, meta, reserved);
+}
+
+/* Returns true if INODE's data is metadata, which goes through
+   the journal: a directory's entries. */
+static bool is_meta(const struct inode* inode) { return inode->data.is_dir; }
+
+/* Releases the sectors INODE has reserved for appends. */
+static void release_prealloc(struct inode* inode) {
+  if (inode->prealloc_cnt > 0)
+    free_map_release(inode->prealloc, inode->prealloc_cnt);
+  inode->prealloc_cnt = 0;
+}
+
+/* Replaces INODE's reservation by a run of consecutive sectors
+   for data sectors IDX onward, as close after HINT as possible.
+   Tries for NEED sectors, or PREALLOC_MIN if that is more, and
+   settles for fewer if the disk has no run that long. */
+static void reserve(struct inode* inode, size_t idx, size_t need, block_sector_t hint) {
+  size_t cnt = need < PREALLOC_MIN ? PREALLOC_MIN : need < PREALLOC_MAX ? need : PREALLOC_MAX;
+
+  release_prealloc(inode);
+  for (; cnt > 0; cnt /= 2)
+    if (free_map_allocate(cnt, hint, &inode->prealloc)) {
+      inode->prealloc_cnt = cnt;
+      inode->prealloc_idx = idx;
+      return;
+    }
+}
+
+/* Allocates data sector IDX of INODE, which is a hole or
+   unwritten, and the
+   index sectors that lead to it.  The write filling it has NEED
+   sectors to go, counting this one.  An append takes the sector
+   from INODE's reservation, making a new one if needed; any
+   other hole is filled just after the previous sector of the
+   file if it has one, or else near the inode.  Returns false if
+   the disk is full. */
+static bool fill_hole(struct inode* inode, size_t idx, size_t need) {
+  block_sector_t hint = idx > 0 ? index_to_sector(&inode->data, idx - 1) & ~SECTOR_UNWRITTEN : 0;
+  block_sector_t reserved = 0;
+
+  if (hint == 0)
+    hint = inode->sector;
+  if (index_to_sector(&inode->data, idx) & SECTOR_UNWRITTEN)
+    return allocate_index(&inode->data, idx, hint, is_meta(inode), 0);
+  if ((off_t)idx * BLOCK_SECTOR_SIZE >= inode->data.length &&
+      (inode->prealloc_cnt == 0 || inode->prealloc_idx != idx))
+    reserve(inode, idx, need, hint);
+  if (inode->prealloc_cnt > 0 && inode->prealloc_idx == idx)
+    reserved = inode->prealloc;
+
+  if (!allocate_index(&inode->data, idx, hint, is_meta(inode), reserved))
+    return false;
+  if (reserved != 0) {
+    inode->prealloc++;
+    inode->prealloc_idx++;
+    inode->prealloc_cnt--;
+  }
+  return true;
+}
+
+/* Frees SECTOR and, if DEPTH is greater than 0, the sectors that
+   it indexes, to DEPTH levels.  Does nothing if SECTOR is 0. */
+static void release_sector(block_sector_t sector, int depth) {
+  size_t i;
+
+  sector &= ~SECTOR_UNWRITTEN;
+  if (sector == 0)
+    return;
+  if (depth > 0)
+    for (i = 0; i < PTRS_PER_SECTOR; i++)
+      release_sector(index_entry(sector, i), depth - 1);
+  free_map_release(sector, 1);
+}
+
+/* Frees every data and index sector of the file whose disk
+   inode is DISK.  Holes and inline data have nothing to free. */
+static void inode_release(const struct inode_disk* disk) {
+  size_t i;
+
+  if (disk->is_inline)
+    return;
+  for (i = 0; i < DIRECT_CNT; i++)
+    release_sector(disk->direct[i], 0);
+  release_sector(disk->indirect, 1);
+  release_sector(disk->doubly_indirect, 2);
+}
+
+/* Open inodes, hashed on their sectors, so that opening a single
+   inode twice returns the same `struct inode'.  Searched for every
+   open, so protected by a reader-writer lock: lookups only read
+   it. */
+static struct hash open_inodes;
+static struct rwlock open_inodes_lock;
+
+/* Cache of in-memory inodes. */
+static struct kmem_cache* inode_cache;
+
+/* Closed inodes kept for reuse.
+
+   Closing the last reference to an inode that is not removed
+   leaves it in open_inodes with OPEN_CNT 0 and puts it at the
+   front of unused_inodes, so that opening it again, as when the
+   shell runs the same program over and over, finds it there and
+   reads nothing from disk.  Past inode_cache_max such inodes, the
+   one closed longest ago is freed, and when memory for a new
+   inode runs out, inode_open() frees all of them.
+
+   A closed inode is no different from an open one except for its
+   count, so a cached inode can never be stale: its sector is
+   reused only after the inode is removed, and a removed inode is
+   freed as soon as it is closed.
+
+   A closed inode's count goes to 0 with open_inodes_lock held for
+   writing, and back to 1 with it held for reading, so
+   unused_lock, nested inside it, also protects the list against
+   concurrent openers. */
+size_t inode_cache_max = 32;
+static struct list unused_inodes; /* Closed inodes, most recent first. */
+static size_t unused_cnt;         /* Number of inodes in unused_inodes. */
+static struct lock unused_lock;   /* Protects unused_inodes. */
+
+/* Statistics. */
+static long long reuse_cnt;   /* Opens that found a closed inode. */
+static long long discard_cnt; /* Closed inodes freed. */
+
+static struct inode* inode_find(block_sector_t);
+static struct inode* inode_revive(struct inode*);
+static bool inode_shrink(void);
+static void inode_free(struct inode*);
+static hash_hash_func inode_hash;
+static hash_less_func inode_less;
+static void inode_ctor(void*);
+static void read_ahead(struct inode*, off_t start, off_t end);
+static off_t write_at(struct inode*, const void*, off_t size, off_t offset, bool append,
+                      off_t* end);
+#ifdef VM
+static off_t read_cached(struct inode*, uint8_t* buffer, off_t size, off_t offset);
+#endif
 
 /* Initializes the inode module. */
-void inode_init(void) { list_init(&open_inodes); }
+void inode_init(void) {
+  if (!hash_init(&open_inodes, inode_hash, inode_less, NULL))
+    PANIC("inode: open inode table creation failed");
+  rwlock_init(&open_inodes_lock);
+  list_init(&unused_inodes);
+  lock_init(&unused_lock);
+  inode_cache = kmem_cache_create("inode", sizeof(struct inode), __alignof__(struct inode),
+                                  inode_ctor);
+}
+
+/* Constructs in-memory inode INODE_.  Its locks are free again
+   whenever it is freed, so they need to be initialized only
+   once. */
+static void inode_ctor(void* inode_) {
+  struct inode* inode = inode_;
+
+  rwlock_init(&inode->rwlock);
+  rwlock_init(&inode->data_lock);
+}
 
-/* Initializes an inode with LENGTH bytes of data and
-   writes the new inode to sector SECTOR on the file system
-   device.
+/* Initializes an inode with LENGTH bytes of data, which is a
+   directory if IS_DIR is true, and writes the new inode to
+   sector SECTOR on the file system device.  The data is inline
+   or a hole, so no data sectors are allocated or written,
+   whatever LENGTH is.
    Returns true if successful.
-   Returns false if memory or disk allocation fails. */
-bool inode_create(block_sector_t sector, off_t length) {
+   Returns false if memory allocation fails or LENGTH is larger
+   than the largest file. */
+bool inode_create(block_sector_t sector, off_t length, bool is_dir) {
   struct inode_disk* disk_inode = NULL;
   bool success = false;
 
@@ -67,22 +433,17 @@ bool inode_create(block_sector_t sector, off_t length) {
      one sector in size, and you should fix that. */
   ASSERT(sizeof *disk_inode == BLOCK_SECTOR_SIZE);
 
+  if (bytes_to_sectors(length) > MAX_SECTORS)
+    return false;
+
   disk_inode = calloc(1, sizeof *disk_inode);
   if (disk_inode != NULL) {
-    size_t sectors = bytes_to_sectors(length);
     disk_inode->length = length;
     disk_inode->magic = INODE_MAGIC;
-    if (free_map_allocate(sectors, &disk_inode->start)) {
-      block_write(fs_device, sector, disk_inode);
-      if (sectors > 0) {
-        static char zeros[BLOCK_SECTOR_SIZE];
-        size_t i;
-
-        for (i = 0; i < sectors; i++)
-          block_write(fs_device, disk_inode->start + i, zeros);
-      }
-      success = true;
-    }
+    disk_inode->is_dir = is_dir;
+    disk_inode->is_inline = !is_dir && (size_t)length <= INLINE_MAX;
+    cache_write_meta(sector, disk_inode);
+    success = true;
     free(disk_inode);
   }
   return success;
@@ -92,64 +453,257 @@ bool inode_create(block_sector_t sector, off_t length) {
    and returns a `struct inode' that contains it.
    Returns a null pointer if memory allocation fails. */
 struct inode* inode_open(block_sector_t sector) {
-  struct list_elem* e;
   struct inode* inode;
+  struct inode* other;
 
   /* Check whether this inode is already open. */
-  for (e = list_begin(&open_inodes); e != list_end(&open_inodes); e = list_next(e)) {
-    inode = list_entry(e, struct inode, elem);
-    if (inode->sector == sector) {
-      inode_reopen(inode);
-      return inode;
-    }
-  }
+  rwlock_acquire_read(&open_inodes_lock);
+  inode = inode_revive(inode_find(sector));
+  rwlock_release_read(&open_inodes_lock);
+  if (inode != NULL)
+    return inode;
 
-  /* Allocate memory. */
-  inode = malloc(sizeof *inode);
+  /* Allocate memory, giving up the closed inodes if need be. */
+  inode = kmem_cache_alloc(inode_cache);
+  if (inode == NULL && inode_shrink())
+    inode = kmem_cache_alloc(inode_cache);
   if (inode == NULL)
     return NULL;
 
-  /* Initialize. */
-  list_push_front(&open_inodes, &inode->elem);
+  /* Initialize.  Read the disk inode before taking the list
+     lock for writing, so that other opens don't wait for the
+     disk. */
   inode->sector = sector;
   inode->open_cnt = 1;
   inode->deny_write_cnt = 0;
+  inode->version = 0;
   inode->removed = false;
-  block_read(fs_device, inode->sector, &inode->data);
+  inode->read_end = inode->read_ahead_end = 0;
+  inode->advice = POSIX_FADV_NORMAL;
+  inode->prealloc_cnt = 0;
+  inode->ram = NULL;
+  cache_read(inode->sector, &inode->data);
+
+  /* Someone else may have opened it in the meantime. */
+  rwlock_acquire_write(&open_inodes_lock);
+  other = inode_revive(inode_find(sector));
+  if (other == NULL)
+    hash_insert(&open_inodes, &inode->elem);
+  rwlock_release_write(&open_inodes_lock);
+
+  if (other != NULL) {
+    kmem_cache_free(inode_cache, inode);
+    return other;
+  }
+  return inode;
+}
+
+/* Returns a new read-only inode whose LENGTH bytes of data are
+   DATA, in memory, which must stay there until the inode is
+   closed.  Returns a null pointer if memory allocation fails. */
+struct inode* inode_open_ram(const void* data, off_t length) {
+  struct inode* inode = kmem_cache_alloc(inode_cache);
+
+  if (inode == NULL)
+    return NULL;
+  inode->sector = RAM_SECTOR;
+  inode->open_cnt = 1;
+  inode->deny_write_cnt = 0;
+  inode->version = 0;
+  inode->removed = false;
+  inode->read_end = inode->read_ahead_end = 0;
+  inode->advice = POSIX_FADV_NORMAL;
+  inode->prealloc_cnt = 0;
+  inode->ram = data;
+  memset(&inode->data, 0, sizeof inode->data);
+  inode->data.length = length;
+  inode->data.magic = INODE_MAGIC;
+  return inode;
+}
+
+/* Returns the open inode for SECTOR, or a null pointer if there
+   is none.  open_inodes_lock must be held. */
+static struct inode* inode_find(block_sector_t sector) {
+  struct inode key;
+  struct hash_elem* e;
+
+  key.sector = sector;
+  e = hash_find(&open_inodes, &key.elem);
+  return e != NULL ? hash_entry(e, struct inode, elem) : NULL;
+}
+
+/* Reopens INODE, which inode_open() found in open_inodes, taking
+   it off unused_inodes if it is closed, and returns it.  Returns
+   a null pointer if INODE is null.  open_inodes_lock must be
+   held. */
+static struct inode* inode_revive(struct inode* inode) {
+  if (inode == NULL)
+    return NULL;
+
+  lock_acquire(&unused_lock);
+  if (inode->open_cnt == 0) {
+    list_remove(&inode->lru);
+    unused_cnt--;
+    reuse_cnt++;
+
+    /* Advice and read-ahead state belong to the openers. */
+    inode->read_end = inode->read_ahead_end = 0;
+    inode->advice = POSIX_FADV_NORMAL;
+  }
+  inode_reopen(inode);
+  lock_release(&unused_lock);
   return inode;
 }
 
-/* Reopens and returns INODE. */
+/* Frees every closed inode.  Returns false if there were none. */
+static bool inode_shrink(void) {
+  struct list victims;
+
+  list_init(&victims);
+  rwlock_acquire_write(&open_inodes_lock);
+  lock_acquire(&unused_lock);
+  while (!list_empty(&unused_inodes)) {
+    struct inode* inode = list_entry(list_pop_front(&unused_inodes), struct inode, lru);
+
+    hash_delete(&open_inodes, &inode->elem);
+    list_push_back(&victims, &inode->lru);
+  }
+  unused_cnt = 0;
+  lock_release(&unused_lock);
+  rwlock_release_write(&open_inodes_lock);
+
+  if (list_empty(&victims))
+    return false;
+  while (!list_empty(&victims))
+    inode_free(list_entry(list_pop_front(&victims), struct inode, lru));
+  return true;
+}
+
+/* Frees INODE, which is closed and out of open_inodes, with its
+   reservation for appends and, if it is removed, its blocks. */
+static void inode_free(struct inode* inode) {
+  if (inode->removed || inode->prealloc_cnt > 0) {
+    journal_begin();
+    release_prealloc(inode);
+    if (inode->removed) {
+      free_map_release(inode->sector, 1);
+      inode_release(&inode->data);
+    }
+    journal_end();
+  }
+  if (!inode->removed)
+    discard_cnt++;
+  kmem_cache_free(inode_cache, inode);
+}
+
+/* Prints inode statistics. */
+void inode_print_stats(void) {
+  printf("Inodes: %zu closed inodes cached, %lld reused, %lld freed\n", unused_cnt, reuse_cnt,
+         discard_cnt);
+}
+
+/* Returns a hash of the sector of the inode that E is embedded
+   in. */
+static unsigned inode_hash(const struct hash_elem* e, void* aux UNUSED) {
+  return hash_int(hash_entry(e, struct inode, elem)->sector);
+}
+
+/* Returns true if the sector of inode A precedes that of inode
+   B. */
+static bool inode_less(const struct hash_elem* a, const struct hash_elem* b, void* aux UNUSED) {
+  return hash_entry(a, struct inode, elem)->sector < hash_entry(b, struct inode, elem)->sector;
+}
+
+/* Reopens and returns INODE.  Lookups in inode_open() reopen
+   inodes concurrently, so the count is updated atomically. */
 struct inode* inode_reopen(struct inode* inode) {
-  if (inode != NULL)
+  if (inode != NULL) {
+    enum intr_level old_level = intr_disable();
     inode->open_cnt++;
+    intr_set_level(old_level);
+  }
   return inode;
 }
 
 /* Returns INODE's inode number. */
 block_sector_t inode_get_inumber(const struct inode* inode) { return inode->sector; }
 
+/* Returns a number that changes whenever INODE's data is
+   written, for keeping information derived from the data while
+   INODE stays open. */
+unsigned inode_get_version(const struct inode* inode) { return inode->version; }
+
 /* Closes INODE and writes it to disk.
-   If this was the last reference to INODE, frees its memory.
-   If INODE was also a removed inode, frees its blocks. */
+   If this was the last reference to INODE, keeps it among the
+   closed inodes for reuse, or frees it if it was removed, along
+   with its blocks. */
 void inode_close(struct inode* inode) {
+  struct inode* victim = NULL;
+  enum intr_level old_level;
+  bool last;
+
   /* Ignore null pointer. */
   if (inode == NULL)
     return;
 
-  /* Release resources if this was the last opener. */
-  if (--inode->open_cnt == 0) {
-    /* Remove from inode list and release lock. */
-    list_remove(&inode->elem);
+  /* A RAM inode has nothing to write back or to keep. */
+  if (inode->ram != NULL) {
+    old_level = intr_disable();
+    last = --inode->open_cnt == 0;
+    intr_set_level(old_level);
+    if (last)
+      kmem_cache_free(inode_cache, inode);
+    return;
+  }
+
+  /* Dropping a reference that is not the last one touches only
+     the count, so it leaves open_inodes_lock alone and never
+     holds up other opens and closes. */
+  old_level = intr_disable();
+  if (inode->open_cnt > 1) {
+    inode->open_cnt--;
+    intr_set_level(old_level);
+    return;
+  }
+  intr_set_level(old_level);
 
-    /* Deallocate blocks if removed. */
-    if (inode->removed) {
-      free_map_release(inode->sector, 1);
-      free_map_release(inode->data.start, bytes_to_sectors(inode->data.length));
-    }
+  /* Give back the reservation for appends now, while INODE is
+     still ours, so that a closed inode does not hold on to free
+     sectors. */
+  if (inode->prealloc_cnt > 0) {
+    rwlock_acquire_write(&inode->data_lock);
+    journal_begin();
+    release_prealloc(inode);
+    journal_end();
+    rwlock_release_write(&inode->data_lock);
+  }
 
-    free(inode);
+  /* Holding open_inodes_lock for writing keeps inode_open() from
+     finding INODE in the meantime.  Someone may have reopened it
+     since the check above, so check again. */
+  rwlock_acquire_write(&open_inodes_lock);
+  old_level = intr_disable();
+  last = --inode->open_cnt == 0;
+  intr_set_level(old_level);
+  if (last && !inode->removed) {
+    /* Keep INODE, and free the inode closed longest ago if there
+       are too many. */
+    lock_acquire(&unused_lock);
+    list_push_front(&unused_inodes, &inode->lru);
+    if (++unused_cnt > inode_cache_max) {
+      victim = list_entry(list_pop_back(&unused_inodes), struct inode, lru);
+      unused_cnt--;
+      hash_delete(&open_inodes, &victim->elem);
+    }
+    lock_release(&unused_lock);
+  } else if (last) {
+    hash_delete(&open_inodes, &inode->elem);
+    victim = inode;
   }
+  rwlock_release_write(&open_inodes_lock);
+
+  if (victim != NULL)
+    inode_free(victim);
 }
 
 /* Marks INODE to be deleted when it is closed by the last caller who
@@ -161,12 +715,32 @@ void inode_remove(struct inode* inode) {
 
 /* Reads SIZE bytes from INODE into BUFFER, starting at position OFFSET.
    Returns the number of bytes actually read, which may be less
-   than SIZE if an error occurs or end of file is reached. */
+   than SIZE if an error occurs or end of file is reached.
+   Reads of the same inode run concurrently, but never overlap a
+   write, so they do not see a write half done.  With virtual
+   memory, pages that the page cache holds (see vm/frame.c) are
+   copied from there instead of the buffer cache. */
 off_t inode_read_at(struct inode* inode, void* buffer_, off_t size, off_t offset) {
   uint8_t* buffer = buffer_;
+  off_t start = offset;
   off_t bytes_read = 0;
-  uint8_t* bounce = NULL;
+#ifdef VM
+  off_t missed = -1; /* Page the page cache did not have. */
+#endif
+
+  TRACEPOINT(TP_INODE_READ, TP_BEGIN, inode->sector, offset);
+  rwlock_acquire_read(&inode->data_lock);
+  if (inode->data.is_inline || inode->ram != NULL) {
+    const uint8_t* data = inode->ram != NULL ? inode->ram : inode->data.inline_data;
 
+    if (offset < inode->data.length) {
+      bytes_read = size < inode->data.length - offset ? size : inode->data.length - offset;
+      memcpy(buffer, data + offset, bytes_read);
+    }
+    rwlock_release_read(&inode->data_lock);
+    TRACEPOINT(TP_INODE_READ, TP_END, inode->sector, bytes_read);
+    return bytes_read;
+  }
   while (size > 0) {
     /* Disk sector to read, starting byte offset within sector. */
     block_sector_t sector_idx = byte_to_sector(inode, offset);
@@ -182,106 +756,497 @@ off_t inode_read_at(struct inode* inode, void* buffer_, off_t size, off_t offset
     if (chunk_size <= 0)
       break;
 
-    if (sector_ofs == 0 && chunk_size == BLOCK_SECTOR_SIZE) {
-      /* Read full sector directly into caller's buffer. */
-      block_read(fs_device, sector_idx, buffer + bytes_read);
-    } else {
-      /* Read sector into bounce buffer, then partially copy
-             into caller's buffer. */
-      if (bounce == NULL) {
-        bounce = malloc(BLOCK_SECTOR_SIZE);
-        if (bounce == NULL)
-          break;
+#ifdef VM
+    if (ROUND_DOWN(offset, PGSIZE) != missed) {
+      off_t n = read_cached(inode, buffer + bytes_read, size, offset);
+      if (n > 0) {
+        size -= n;
+        offset += n;
+        bytes_read += n;
+        continue;
       }
-      block_read(fs_device, sector_idx, bounce);
-      memcpy(buffer + bytes_read, bounce + sector_ofs, chunk_size);
+      missed = ROUND_DOWN(offset, PGSIZE);
     }
+#endif
+
+    if (sector_idx != 0) {
+      cache_read_at(sector_idx, buffer + bytes_read, sector_ofs, chunk_size);
+      if (inode->advice == POSIX_FADV_SEQUENTIAL && chunk_size == sector_left)
+        cache_drop(sector_idx);
+    } else
+      memset(buffer + bytes_read, 0, chunk_size);
 
     /* Advance. */
     size -= chunk_size;
     offset += chunk_size;
     bytes_read += chunk_size;
   }
-  free(bounce);
+  if (bytes_read > 0)
+    read_ahead(inode, start, offset);
+  rwlock_release_read(&inode->data_lock);
+  TRACEPOINT(TP_INODE_READ, TP_END, inode->sector, bytes_read);
 
   return bytes_read;
 }
 
+#ifdef VM
+/* Copies up to SIZE bytes of INODE at OFFSET, as far as the end
+   of their page, into BUFFER from the page cache.  Returns the
+   number of bytes copied, which is 0 if the page cache does not
+   hold the page.  INODE's data_lock must be held. */
+static off_t read_cached(struct inode* inode, uint8_t* buffer, off_t size, off_t offset) {
+  off_t page_ofs = ROUND_DOWN(offset, PGSIZE);
+  off_t page_bytes = inode_length(inode) - page_ofs;
+  off_t n;
+
+  if (page_bytes > PGSIZE)
+    page_bytes = PGSIZE;
+  n = page_bytes - (offset - page_ofs);
+  if (n > size)
+    n = size;
+  if (n <= 0 || !frame_read_cached(inode, page_ofs, page_bytes, buffer, offset - page_ofs, n))
+    return 0;
+  return n;
+}
+#endif
+
+/* Reads ahead of a read of INODE's bytes START...END, if it
+   follows the previous read or INODE is advised sequential.  Concurrent readers may update the
+   positions at once, which at worst starts or stops read-ahead
+   early. */
+static void read_ahead(struct inode* inode, off_t start, off_t end) {
+  size_t window = inode_read_ahead;
+  off_t ofs, limit;
+
+  if (inode->advice == POSIX_FADV_RANDOM)
+    return;
+  if (start != inode->read_end) {
+    inode->read_ahead_end = 0;
+    inode->read_end = end;
+    if (inode->advice != POSIX_FADV_SEQUENTIAL)
+      return;
+  }
+  inode->read_end = end;
+  if (inode->advice == POSIX_FADV_SEQUENTIAL)
+    window *= SEQUENTIAL_FACTOR;
+
+  ofs = ROUND_UP(end, BLOCK_SECTOR_SIZE);
+  if (ofs < inode->read_ahead_end)
+    ofs = inode->read_ahead_end;
+  limit = ROUND_UP(end, BLOCK_SECTOR_SIZE) + (off_t)window * BLOCK_SECTOR_SIZE;
+  if (limit > inode_length(inode))
+    limit = inode_length(inode);
+  for (; ofs < limit; ofs += BLOCK_SECTOR_SIZE) {
+    block_sector_t sector = byte_to_sector(inode, ofs);
+    if (sector != 0)
+      cache_read_ahead(sector);
+  }
+  if (ofs > inode->read_ahead_end)
+    inode->read_ahead_end = ofs;
+}
+
+/* Applies ADVICE, one of the POSIX_FADV_* values in <fcntl.h>,
+   to INODE's LENGTH bytes starting at OFFSET, or to all its
+   bytes from OFFSET on if LENGTH is 0.  POSIX_FADV_WILLNEED
+   queues no more sectors than the read-ahead queue holds. */
+void inode_advise(struct inode* inode, off_t offset, off_t length, int advice) {
+  off_t ofs, end;
+
+  ASSERT(offset >= 0 && length >= 0);
+
+  if (advice == POSIX_FADV_NORMAL || advice == POSIX_FADV_RANDOM
+      || advice == POSIX_FADV_SEQUENTIAL) {
+    inode->advice = advice;
+    inode->read_ahead_end = 0;
+    return;
+  }
+
+  rwlock_acquire_read(&inode->data_lock);
+  end = inode_length(inode);
+  if (length != 0 && length < end - offset)
+    end = offset + length;
+  if (!inode->data.is_inline)
+    for (ofs = ROUND_DOWN(offset, BLOCK_SECTOR_SIZE); ofs < end; ofs += BLOCK_SECTOR_SIZE) {
+      block_sector_t sector = byte_to_sector(inode, ofs);
+
+      if (sector == 0)
+        continue;
+      if (advice == POSIX_FADV_WILLNEED)
+        cache_read_ahead(sector);
+      else if (advice == POSIX_FADV_DONTNEED)
+        cache_drop(sector);
+    }
+  rwlock_release_read(&inode->data_lock);
+}
+
+/* Moves the data of INODE, which is inline, out to a data
+   sector so that the file can grow past INLINE_MAX bytes.
+   Returns false if the disk is full. */
+static bool spill_inline(struct inode* inode) {
+  struct inode_disk* disk = &inode->data;
+  block_sector_t sector = 0;
+
+  journal_begin();
+  if (disk->length > 0) {
+    if (!allocate_sector(&sector, inode->sector, false, 0)) {
+      journal_end();
+      return false;
+    }
+    cache_write_at(sector, disk->inline_data, 0, disk->length);
+  }
+  memset(disk->inline_data, 0, sizeof disk->inline_data);
+  disk->direct[0] = sector;
+  disk->is_inline = false;
+  cache_write_meta(inode->sector, disk);
+  journal_end();
+  return true;
+}
+
 /* Writes SIZE bytes from BUFFER into INODE, starting at OFFSET.
    Returns the number of bytes actually written, which may be
-   less than SIZE if end of file is reached or an error occurs.
-   (Normally a write at end of file would extend the inode, but
-   growth is not yet implemented.) */
-off_t inode_write_at(struct inode* inode, const void* buffer_, off_t size, off_t offset) {
+   less than SIZE if the disk fills up or an error occurs.
+   A write past end of file extends the inode, and a gap between
+   the old end and OFFSET is left as a hole.
+   Writes of the same inode are serialized with each other and
+   with reads. */
+off_t inode_write_at(struct inode* inode, const void* buffer, off_t size, off_t offset) {
+  return write_at(inode, buffer, size, offset, false, NULL);
+}
+
+/* Writes SIZE bytes from BUFFER at the end of INODE, as
+   inode_write_at() would at the offset that is the end of file
+   once the write holds INODE's lock, so that the appends of
+   several writers never overwrite each other or interleave.  If
+   anything was written, stores the offset just past it in *END.
+   Returns the number of bytes actually written. */
+off_t inode_append(struct inode* inode, const void* buffer, off_t size, off_t* end) {
+  return write_at(inode, buffer, size, 0, true, end);
+}
+
+/* Does the work of inode_write_at() and, if APPEND is true, of
+   inode_append(), in which case OFFSET is ignored.  If END is
+   not null and writes to INODE are allowed, stores the offset
+   just past the bytes written in *END. */
+static off_t write_at(struct inode* inode, const void* buffer_, off_t size, off_t offset,
+                      bool append, off_t* end) {
   const uint8_t* buffer = buffer_;
   off_t bytes_written = 0;
-  uint8_t* bounce = NULL;
 
-  if (inode->deny_write_cnt)
+  TRACEPOINT(TP_INODE_WRITE, TP_BEGIN, inode->sector, offset);
+  rwlock_acquire_write(&inode->data_lock);
+  if (inode->deny_write_cnt || inode->ram != NULL) {
+    rwlock_release_write(&inode->data_lock);
+    TRACEPOINT(TP_INODE_WRITE, TP_END, inode->sector, 0);
     return 0;
+  }
+  if (append)
+    offset = inode->data.length;
+
+  if (inode->data.is_inline) {
+    if (offset <= (off_t)INLINE_MAX && size <= (off_t)INLINE_MAX - offset) {
+      memcpy(inode->data.inline_data + offset, buffer, size);
+      bytes_written = size;
+      offset += size;
+      size = 0;
+    } else if (!spill_inline(inode)) {
+      rwlock_release_write(&inode->data_lock);
+      TRACEPOINT(TP_INODE_WRITE, TP_END, inode->sector, 0);
+      return 0;
+    }
+  }
 
   while (size > 0) {
     /* Sector to write, starting byte offset within sector. */
-    block_sector_t sector_idx = byte_to_sector(inode, offset);
+    size_t idx = offset / BLOCK_SECTOR_SIZE;
+    block_sector_t sector_idx = index_to_sector(&inode->data, idx);
     int sector_ofs = offset % BLOCK_SECTOR_SIZE;
 
-    /* Bytes left in inode, bytes left in sector, lesser of the two. */
-    off_t inode_left = inode_length(inode) - offset;
-    int sector_left = BLOCK_SECTOR_SIZE - sector_ofs;
-    int min_left = inode_left < sector_left ? inode_left : sector_left;
-
     /* Number of bytes to actually write into this sector. */
-    int chunk_size = size < min_left ? size : min_left;
-    if (chunk_size <= 0)
-      break;
+    int sector_left = BLOCK_SECTOR_SIZE - sector_ofs;
+    int chunk_size = size < sector_left ? size : sector_left;
 
-    if (sector_ofs == 0 && chunk_size == BLOCK_SECTOR_SIZE) {
-      /* Write full sector directly to disk. */
-      block_write(fs_device, sector_idx, buffer + bytes_written);
-    } else {
-      /* We need a bounce buffer. */
-      if (bounce == NULL) {
-        bounce = malloc(BLOCK_SECTOR_SIZE);
-        if (bounce == NULL)
-          break;
-      }
+    /* Fill a hole, or zero an unwritten sector.  If the disk is
+       full, stop here.  The
+       allocation and the inode that records it are one journal
+       operation, which does not take in the copy from BUFFER:
+       that may fault, and the fault may have to wait for a
+       commit. */
+    if (sector_idx == 0 || (sector_idx & SECTOR_UNWRITTEN)) {
+      bool allocated;
 
-      /* If the sector contains data before or after the chunk
-             we're writing, then we need to read in the sector
-             first.  Otherwise we start with a sector of all zeros. */
-      if (sector_ofs > 0 || chunk_size < sector_left)
-        block_read(fs_device, sector_idx, bounce);
-      else
-        memset(bounce, 0, BLOCK_SECTOR_SIZE);
-      memcpy(bounce + sector_ofs, buffer + bytes_written, chunk_size);
-      block_write(fs_device, sector_idx, bounce);
+      journal_begin();
+      allocated = fill_hole(inode, idx, DIV_ROUND_UP(sector_ofs + size, BLOCK_SECTOR_SIZE));
+      if (allocated)
+        cache_write_meta(inode->sector, &inode->data);
+      journal_end();
+      if (!allocated)
+        break;
+      sector_idx = index_to_sector(&inode->data, idx);
     }
 
+    /* The cache reads the sector first unless the whole of it
+       is written. */
+    if (is_meta(inode))
+      cache_write_meta_at(sector_idx, buffer + bytes_written, sector_ofs, chunk_size);
+    else
+      cache_write_at(sector_idx, buffer + bytes_written, sector_ofs, chunk_size);
+
     /* Advance. */
     size -= chunk_size;
     offset += chunk_size;
     bytes_written += chunk_size;
   }
-  free(bounce);
+  if (bytes_written > 0 && (offset > inode->data.length || inode->data.is_inline)) {
+    if (offset > inode->data.length)
+      inode->data.length = offset;
+    journal_begin();
+    cache_write_meta(inode->sector, &inode->data);
+    journal_end();
+  }
+  if (bytes_written > 0)
+    inode->version++;
+  rwlock_release_write(&inode->data_lock);
+  TRACEPOINT(TP_INODE_WRITE, TP_END, inode->sector, bytes_written);
 
+  if (end != NULL)
+    *end = offset;
+  if (bytes_written > 0)
+    cache_throttle();
   return bytes_written;
 }
 
+/* Moves CNT data sectors of INODE, starting with sector IDX,
+   between the disk and BUFFER, writing them if WRITE is true and
+   reading them otherwise, with one request per run of sectors
+   that are adjacent on disk.  A hole or an unwritten sector reads
+   as zeros; there must be none to write.  INODE's data_lock must be held. */
+static void transfer_direct(struct inode* inode, void* buffer_, size_t idx, size_t cnt,
+                            bool write) {
+  uint8_t* buffer = buffer_;
+  size_t i = 0;
+
+  while (i < cnt) {
+    block_sector_t first = index_to_sector(&inode->data, idx + i);
+    size_t run = 1;
+
+    if (first == 0 || (first & SECTOR_UNWRITTEN)) {
+      ASSERT(!write);
+      memset(buffer + i * BLOCK_SECTOR_SIZE, 0, BLOCK_SECTOR_SIZE);
+      i++;
+      continue;
+    }
+    while (i + run < cnt && index_to_sector(&inode->data, idx + i + run) == first + run)
+      run++;
+    if (write)
+      cache_write_direct(first, run, buffer + i * BLOCK_SECTOR_SIZE);
+    else
+      cache_read_direct(first, run, buffer + i * BLOCK_SECTOR_SIZE);
+    i += run;
+  }
+}
+
+/* Reads SIZE bytes from INODE into BUFFER, starting at OFFSET,
+   like inode_read_at(), but straight from the disk in
+   multi-sector requests instead of through the buffer cache.
+   OFFSET and SIZE must be multiples of BLOCK_SECTOR_SIZE.  Past
+   end of file, BUFFER's last sector may be overwritten beyond
+   the bytes read.  Inline data and directories are read through
+   the cache as usual. */
+off_t inode_read_direct(struct inode* inode, void* buffer, off_t size, off_t offset) {
+  off_t bytes_read = 0;
+
+  ASSERT(offset % BLOCK_SECTOR_SIZE == 0 && size % BLOCK_SECTOR_SIZE == 0);
+
+  rwlock_acquire_read(&inode->data_lock);
+  if (inode->data.is_inline || is_meta(inode) || inode->ram != NULL) {
+    rwlock_release_read(&inode->data_lock);
+    return inode_read_at(inode, buffer, size, offset);
+  }
+  if (offset < inode->data.length) {
+    bytes_read = size < inode->data.length - offset ? size : inode->data.length - offset;
+    transfer_direct(inode, buffer, offset / BLOCK_SECTOR_SIZE, bytes_to_sectors(bytes_read),
+                    false);
+  }
+  rwlock_release_read(&inode->data_lock);
+  return bytes_read;
+}
+
+/* Writes SIZE bytes from BUFFER into INODE, starting at OFFSET,
+   like inode_write_at(), but straight to the disk in
+   multi-sector requests instead of through the buffer cache.
+   OFFSET and SIZE must be multiples of BLOCK_SECTOR_SIZE.
+   Directories are written through the cache as usual. */
+off_t inode_write_direct(struct inode* inode, const void* buffer, off_t size, off_t offset) {
+  size_t idx = offset / BLOCK_SECTOR_SIZE;
+  size_t cnt = size / BLOCK_SECTOR_SIZE;
+  off_t bytes_written;
+  size_t i;
+
+  ASSERT(offset % BLOCK_SECTOR_SIZE == 0 && size % BLOCK_SECTOR_SIZE == 0);
+
+  if (is_meta(inode))
+    return inode_write_at(inode, buffer, size, offset);
+
+  rwlock_acquire_write(&inode->data_lock);
+  if (inode->deny_write_cnt || (inode->data.is_inline && !spill_inline(inode))) {
+    rwlock_release_write(&inode->data_lock);
+    return 0;
+  }
+
+  /* Fill the holes and unwritten sectors first, so that the
+     sectors can be written in runs.  If the disk fills up, write
+     what has room. */
+  for (i = 0; i < cnt; i++) {
+    block_sector_t sector = index_to_sector(&inode->data, idx + i);
+
+    if (sector == 0 || (sector & SECTOR_UNWRITTEN)) {
+      bool allocated;
+
+      journal_begin();
+      allocated = fill_hole(inode, idx + i, cnt - i);
+      if (allocated)
+        cache_write_meta(inode->sector, &inode->data);
+      journal_end();
+      if (!allocated)
+        break;
+    }
+  }
+  cnt = i;
+  transfer_direct(inode, (void*)buffer, idx, cnt, true);
+
+  bytes_written = cnt * BLOCK_SECTOR_SIZE;
+  if (bytes_written > 0 && offset + bytes_written > inode->data.length) {
+    inode->data.length = offset + bytes_written;
+    journal_begin();
+    cache_write_meta(inode->sector, &inode->data);
+    journal_end();
+  }
+  if (bytes_written > 0)
+    inode->version++;
+  rwlock_release_write(&inode->data_lock);
+
+  return bytes_written;
+}
+
+/* Allocates, as unwritten sectors, the holes among the data
+   sectors that hold INODE's first LENGTH bytes, and extends
+   INODE to LENGTH bytes if it is shorter.  The holes get runs of
+   consecutive sectors from the free map, as long as it has, so
+   that later writes of those bytes allocate nothing and the file
+   stays contiguous.  Nothing is zeroed.  Returns false if the
+   disk fills up first, keeping what was allocated, or if LENGTH
+   is larger than the largest file. */
+bool inode_fallocate(struct inode* inode, off_t length) {
+  size_t cnt = bytes_to_sectors(length);
+  block_sector_t hint = inode->sector;
+  size_t need = 0, idx = 0, i;
+  bool success = true;
+
+  if (length < 0 || cnt > MAX_SECTORS)
+    return false;
+
+  rwlock_acquire_write(&inode->data_lock);
+  if (inode->deny_write_cnt
+      || (inode->data.is_inline && length > (off_t)INLINE_MAX && !spill_inline(inode))) {
+    rwlock_release_write(&inode->data_lock);
+    return false;
+  }
+
+  journal_begin();
+  if (!inode->data.is_inline) {
+    release_prealloc(inode);
+    for (i = 0; i < cnt; i++)
+      if (index_to_sector(&inode->data, i) == 0)
+        need++;
+  }
+  while (need > 0 && success) {
+    size_t run = need < PREALLOC_MAX ? need : PREALLOC_MAX;
+    block_sector_t start;
+
+    while (run > 0 && !free_map_allocate(run, hint, &start))
+      run /= 2;
+    if (run == 0) {
+      success = false;
+      break;
+    }
+
+    /* Hand the run out to the next holes in order. */
+    for (i = 0; i < run; i++) {
+      while (index_to_sector(&inode->data, idx) != 0)
+        idx++;
+      if (!allocate_index(&inode->data, idx, start + i, false, (start + i) | SECTOR_UNWRITTEN)) {
+        free_map_release(start + i, run - i);
+        success = false;
+        break;
+      }
+      idx++;
+    }
+    need -= i;
+    hint = start + run;
+  }
+  if (success && length > inode->data.length) {
+    inode->data.length = length;
+    inode->version++;
+  }
+  cache_write_meta(inode->sector, &inode->data);
+  journal_end();
+  rwlock_release_write(&inode->data_lock);
+
+  return success;
+}
+
 /* Disables writes to INODE.
-   May be called at most once per inode opener. */
+   May be called at most once per inode opener.
+   Waits for a write in progress to finish. */
 void inode_deny_write(struct inode* inode) {
+  rwlock_acquire_write(&inode->data_lock);
   inode->deny_write_cnt++;
   ASSERT(inode->deny_write_cnt <= inode->open_cnt);
+  rwlock_release_write(&inode->data_lock);
 }
 
 /* Re-enables writes to INODE.
    Must be called once by each inode opener who has called
    inode_deny_write() on the inode, before closing the inode. */
 void inode_allow_write(struct inode* inode) {
+  rwlock_acquire_write(&inode->data_lock);
   ASSERT(inode->deny_write_cnt > 0);
   ASSERT(inode->deny_write_cnt <= inode->open_cnt);
   inode->deny_write_cnt--;
+  rwlock_release_write(&inode->data_lock);
+}
+
+/* Returns true if INODE is a directory. */
+bool inode_is_dir(const struct inode* inode) { return inode->data.is_dir; }
+
+/* Returns true if the inode in SECTOR, open or not, is a
+   directory.  Reads only the cached copy of the disk inode. */
+bool inode_sector_is_dir(block_sector_t sector) {
+  bool is_dir;
+
+  cache_read_at(sector, &is_dir, offsetof(struct inode_disk, is_dir), sizeof is_dir);
+  return is_dir;
 }
 
+/* Returns true if INODE has been removed. */
+bool inode_is_removed(const struct inode* inode) { return inode->removed; }
+
+/* Returns the number of openers of INODE. */
+int inode_open_cnt(const struct inode* inode) { return inode->open_cnt; }
+
 /* Returns the length, in bytes, of INODE's data. */
 off_t inode_length(const struct inode* inode) { return inode->data.length; }
+
+/* Acquires INODE's lock for reading, for looking up entries in a
+   directory. */
+void inode_read_lock(struct inode* inode) { rwlock_acquire_read(&inode->rwlock); }
+
+/* Releases INODE's lock, held for reading. */
+void inode_read_unlock(struct inode* inode) { rwlock_release_read(&inode->rwlock); }
+
+/* Acquires INODE's lock for writing, for changing the entries of
+   a directory. */
+void inode_write_lock(struct inode* inode) { rwlock_acquire_write(&inode->rwlock); }
+
+/* Releases INODE's lock, held for writing. */
+void inode_write_unlock(struct inode* inode) { rwlock_release_write(&inode->rwlock); }
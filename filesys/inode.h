@@ -2,22 +2,45 @@
 #define FILESYS_INODE_H
 
 #include <stdbool.h>
+#include <stddef.h>
 #include "filesys/off_t.h"
 #include "devices/block.h"
 
 struct bitmap;
 
+/* -read-ahead: Sectors to read ahead of sequential reads. */
+extern size_t inode_read_ahead;
+
+/* -inode-cache: Closed inodes kept for reuse. */
+extern size_t inode_cache_max;
+
 void inode_init(void);
-bool inode_create(block_sector_t, off_t);
+void inode_print_stats(void);
+bool inode_create(block_sector_t, off_t, bool is_dir);
 struct inode* inode_open(block_sector_t);
+struct inode* inode_open_ram(const void*, off_t length);
 struct inode* inode_reopen(struct inode*);
 block_sector_t inode_get_inumber(const struct inode*);
+unsigned inode_get_version(const struct inode*);
 void inode_close(struct inode*);
 void inode_remove(struct inode*);
 off_t inode_read_at(struct inode*, void*, off_t size, off_t offset);
 off_t inode_write_at(struct inode*, const void*, off_t size, off_t offset);
+off_t inode_append(struct inode*, const void*, off_t size, off_t* end);
+off_t inode_read_direct(struct inode*, void*, off_t size, off_t offset);
+off_t inode_write_direct(struct inode*, const void*, off_t size, off_t offset);
+bool inode_fallocate(struct inode*, off_t length);
+void inode_advise(struct inode*, off_t offset, off_t length, int advice);
 void inode_deny_write(struct inode*);
 void inode_allow_write(struct inode*);
 off_t inode_length(const struct inode*);
+bool inode_is_dir(const struct inode*);
+bool inode_sector_is_dir(block_sector_t);
+bool inode_is_removed(const struct inode*);
+int inode_open_cnt(const struct inode*);
+void inode_read_lock(struct inode*);
+void inode_read_unlock(struct inode*);
+void inode_write_lock(struct inode*);
+void inode_write_unlock(struct inode*);
 
 #endif /* filesys/inode.h */
@@ -0,0 +1,177 @@
+#include "filesys/journal.h"
+#include <debug.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "filesys/filesys.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+/* Metadata journal.
+
+   Inode, index, directory and free map sectors are metadata.
+   The buffer cache never writes a dirty metadata sector in place
+   on its own.  Instead, whenever it writes back dirty sectors,
+   it first makes every dirty metadata sector part of one
+   transaction:
+
+     1. journal_lock() waits for the file system operations in
+        progress to finish, and holds off new ones, so the
+        metadata is consistent.
+
+     2. journal_commit() writes an image of each sector to the
+        journal region, in one sequential sweep, and then writes
+        the header, which lists the sectors' home locations.  A
+        header is a single sector, so it is either written or not:
+        that write commits the transaction.
+
+     3. The cache writes the sectors to their homes.
+
+     4. journal_checkpoint() clears the header, since the
+        transaction is no longer needed.
+
+   After a crash, journal_init() replays a committed transaction
+   by copying its images home, which completes whatever part of
+   step 3 was lost.  A crash before the commit leaves every home
+   sector as it was at the end of the previous transaction.
+   Either way the metadata on disk is as it was at some moment
+   when no operation was in progress, and no fsck is needed.
+
+   An operation is whatever runs between journal_begin() and
+   journal_end(): creating or removing a file, say, or a write to
+   a file's data, which may allocate sectors.  Operations may
+   nest, and only the outermost counts.  The journal does not
+   protect file data, which is written in place as before.
+
+   The disk may cache writes and put them on the platter in any
+   order, so each step that the next relies on is made durable
+   with block_flush() before the next starts: the images before
+   the header that commits them, the header before the homes are
+   overwritten, and the homes before the header is cleared. */
+
+/* Identifies a committed journal header. */
+#define JOURNAL_MAGIC 0x4a524e4c
+
+/* On-disk journal header.  Exactly BLOCK_SECTOR_SIZE bytes long. */
+struct journal_header {
+  uint32_t magic;                    /* JOURNAL_MAGIC if committed. */
+  uint32_t cnt;                      /* Number of sectors in the transaction. */
+  block_sector_t homes[JOURNAL_MAX]; /* Home of each image. */
+  uint8_t unused[BLOCK_SECTOR_SIZE - 8 - JOURNAL_MAX * sizeof(block_sector_t)];
+};
+
+/* Images moved at once between memory and the journal. */
+#define IMAGE_RUN 8
+
+static struct rwlock journal_rwlock;                     /* Operations hold it for reading. */
+static struct journal_header header;                     /* Header being written. */
+static uint8_t image_buf[IMAGE_RUN * BLOCK_SECTOR_SIZE]; /* Images in transit. */
+
+/* Statistics. */
+static long long commit_cnt; /* Transactions committed. */
+static long long image_cnt;  /* Sector images written. */
+static long long replay_cnt; /* Sectors replayed at startup. */
+
+static void write_header(size_t cnt);
+
+/* Initializes the journal.  If FORMAT is true, creates an empty
+   journal; otherwise replays the committed transaction, if any.
+   Must run before anything is read through the buffer cache. */
+void journal_init(bool format) {
+  ASSERT(sizeof header == BLOCK_SECTOR_SIZE);
+  rwlock_init(&journal_rwlock);
+
+  if (!format) {
+    block_read(fs_device, JOURNAL_SECTOR, &header);
+    if (header.magic == JOURNAL_MAGIC && header.cnt <= JOURNAL_MAX) {
+      size_t i, j;
+
+      for (i = 0; i < header.cnt; i += IMAGE_RUN) {
+        size_t n = header.cnt - i < IMAGE_RUN ? header.cnt - i : IMAGE_RUN;
+
+        block_read_multiple(fs_device, JOURNAL_SECTOR + 1 + i, n, image_buf);
+        for (j = 0; j < n; j++)
+          block_write(fs_device, header.homes[i + j], image_buf + j * BLOCK_SECTOR_SIZE);
+      }
+      replay_cnt += header.cnt;
+      if (header.cnt > 0)
+        printf("journal: replayed %u sectors\n", (unsigned)header.cnt);
+    }
+  }
+  write_header(0);
+}
+
+/* Starts a file system operation.  Waits while a transaction is
+   being committed. */
+void journal_begin(void) {
+  if (thread_current()->journal_depth++ == 0)
+    rwlock_acquire_read(&journal_rwlock);
+}
+
+/* Ends the operation started by the matching journal_begin(). */
+void journal_end(void) {
+  struct thread* t = thread_current();
+
+  ASSERT(t->journal_depth > 0);
+  if (--t->journal_depth == 0)
+    rwlock_release_read(&journal_rwlock);
+}
+
+/* Waits until no operation is in progress and keeps new ones
+   from starting, for committing a transaction.  The current
+   thread must not be in an operation. */
+void journal_lock(void) {
+  ASSERT(thread_current()->journal_depth == 0);
+  rwlock_acquire_write(&journal_rwlock);
+}
+
+/* Lets operations start again. */
+void journal_unlock(void) { rwlock_release_write(&journal_rwlock); }
+
+/* Commits a transaction of the CNT sectors whose numbers are in
+   SECTORS and whose new contents are in DATAS.  The caller must
+   hold the journal lock, and must write the sectors home and then
+   call journal_checkpoint() before committing another. */
+void journal_commit(const block_sector_t sectors[], void* const datas[], size_t cnt) {
+  size_t i, j;
+
+  ASSERT(cnt <= JOURNAL_MAX);
+  if (cnt == 0)
+    return;
+  for (i = 0; i < cnt; i += IMAGE_RUN) {
+    size_t n = cnt - i < IMAGE_RUN ? cnt - i : IMAGE_RUN;
+
+    for (j = 0; j < n; j++) {
+      memcpy(image_buf + j * BLOCK_SECTOR_SIZE, datas[i + j], BLOCK_SECTOR_SIZE);
+      header.homes[i + j] = sectors[i + j];
+    }
+    block_write_multiple(fs_device, JOURNAL_SECTOR + 1 + i, n, image_buf);
+  }
+  write_header(cnt);
+  block_flush(fs_device);
+  commit_cnt++;
+  image_cnt += cnt;
+}
+
+/* Marks the committed transaction, whose sectors are now home,
+   as done. */
+void journal_checkpoint(void) {
+  if (header.cnt > 0)
+    write_header(0);
+}
+
+/* Writes the header for a transaction of CNT sectors, whose
+   homes are in header.homes, once the writes before it are
+   durable. */
+static void write_header(size_t cnt) {
+  block_flush(fs_device);
+  header.magic = JOURNAL_MAGIC;
+  header.cnt = cnt;
+  block_write(fs_device, JOURNAL_SECTOR, &header);
+}
+
+/* Prints journal statistics. */
+void journal_print_stats(void) {
+  printf("Journal: %lld transactions of %lld sectors, %lld sectors replayed\n", commit_cnt,
+         image_cnt, replay_cnt);
+}
@@ -0,0 +1,23 @@
+#ifndef FILESYS_JOURNAL_H
+#define FILESYS_JOURNAL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "devices/block.h"
+
+/* Reserved journal region: a commit header followed by room for
+   the images of JOURNAL_MAX sectors. */
+#define JOURNAL_SECTOR 2                  /* First sector of the journal. */
+#define JOURNAL_MAX 64                    /* Most sectors in one transaction. */
+#define JOURNAL_SECTORS (1 + JOURNAL_MAX) /* Sectors in the journal. */
+
+void journal_init(bool format);
+void journal_begin(void);
+void journal_end(void);
+void journal_lock(void);
+void journal_unlock(void);
+void journal_commit(const block_sector_t sectors[], void* const datas[], size_t cnt);
+void journal_checkpoint(void);
+void journal_print_stats(void);
+
+#endif /* filesys/journal.h */
@@ -63,9 +63,19 @@ static int nlz(uint32_t x) {
 }
 
 /* Divides unsigned 64-bit N by unsigned 64-bit D and returns the
-   quotient. */
+   quotient.
+
+   Most divisions that reach here have a divisor that fits in 32
+   bits, and many a dividend that does too, so those cases come
+   first: a dividend and divisor of 32 bits take a single DIVL,
+   as does a dividend whose high word is less than the divisor,
+   since the quotient then fits in 32 bits. */
 static uint64_t udiv64(uint64_t n, uint64_t d) {
-  if ((d >> 32) == 0) {
+  if ((n >> 32) == 0 && (d >> 32) == 0)
+    return (uint32_t)n / (uint32_t)d;
+  else if ((d >> 32) == 0 && (n >> 32) < (uint32_t)d)
+    return divl(n, d);
+  else if ((d >> 32) == 0) {
     /* Proof of correctness:
 
          Let n, d, b, n1, and n0 be defined as in this function.
@@ -112,7 +122,11 @@ static uint64_t udiv64(uint64_t n, uint64_t d) {
 
 /* Divides unsigned 64-bit N by unsigned 64-bit D and returns the
    remainder. */
-static uint32_t umod64(uint64_t n, uint64_t d) { return n - d * udiv64(n, d); }
+static uint64_t umod64(uint64_t n, uint64_t d) {
+  if ((n >> 32) == 0 && (d >> 32) == 0)
+    return (uint32_t)n % (uint32_t)d;
+  return n - d * udiv64(n, d);
+}
 
 /* Divides signed 64-bit N by signed 64-bit D and returns the
    quotient. */
@@ -125,7 +139,7 @@ static int64_t sdiv64(int64_t n, int64_t d) {
 
 /* Divides signed 64-bit N by signed 64-bit D and returns the
    remainder. */
-static int32_t smod64(int64_t n, int64_t d) { return n - d * sdiv64(n, d); }
+static int64_t smod64(int64_t n, int64_t d) { return n - d * sdiv64(n, d); }
 
 /* These are the routines that GCC calls. */
 
@@ -0,0 +1,41 @@
+#ifndef __LIB_BLKSTAT_H
+#define __LIB_BLKSTAT_H
+
+/* Block devices whose I/O statistics the blkstat system call
+   reports, by the role they play.  Same order as the roles in
+   devices/block.h. */
+enum blkstat_role {
+  BLKSTAT_KERNEL,  /* Pintos OS kernel. */
+  BLKSTAT_FILESYS, /* File system. */
+  BLKSTAT_SCRATCH, /* Scratch. */
+  BLKSTAT_SWAP,    /* Swap. */
+  BLKSTAT_ROLE_CNT /* Number of roles. */
+};
+
+/* Indexes of the per-direction counters. */
+#define BLKSTAT_READ 0
+#define BLKSTAT_WRITE 1
+
+/* Buckets in a latency histogram.  Bucket I counts requests
+   that took from 2**I to 2**(I+1) microseconds, except that the
+   first also counts quicker ones and the last slower ones. */
+#define BLKSTAT_HIST_CNT 20
+
+/* I/O statistics of a block device.  A request's latency runs
+   from its submission to its completion, which for a disk is the
+   interrupt that ends its transfer.  A request to a partition
+   counts for the partition and for its disk. */
+struct blkstat {
+  char name[16];                                /* Device name, e.g. "hda1". */
+  long long requests[2];                        /* Requests completed. */
+  long long bytes[2];                           /* Bytes they transferred. */
+  long long latency_ns[2];                      /* Sum of their latencies. */
+  unsigned latency_hist[2][BLKSTAT_HIST_CNT];   /* Their latencies. */
+  unsigned in_flight;                           /* Requests submitted, not completed. */
+  unsigned max_in_flight;                       /* Deepest the queue has been. */
+  long long depth_sum;                          /* Sum over submissions of IN_FLIGHT. */
+  long long flushes;                            /* Write-cache flushes completed. */
+  long long flush_ns;                           /* Sum of their latencies. */
+};
+
+#endif /* lib/blkstat.h */
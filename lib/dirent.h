@@ -0,0 +1,15 @@
+#ifndef __LIB_DIRENT_H
+#define __LIB_DIRENT_H
+
+/* Types of directory entries. */
+#define DT_REG 1 /* Regular file. */
+#define DT_DIR 2 /* Directory. */
+
+/* A directory entry, as the getdents system call returns it. */
+struct dirent {
+  int d_ino;            /* Inode number, as the inumber system call reports it. */
+  unsigned char d_type; /* DT_REG or DT_DIR. */
+  char d_name[15];      /* Null-terminated name, at most 14 characters. */
+};
+
+#endif /* lib/dirent.h */
@@ -0,0 +1,50 @@
+#ifndef __LIB_DIV64_H
+#define __LIB_DIV64_H
+
+#include <stdint.h>
+
+/* Division of a 64-bit dividend by a 32-bit divisor.
+
+   GCC compiles any division with a 64-bit operand into a call to
+   __udivdi3() or one of its relatives in lib/arithmetic.c, even
+   when the divisor is a small constant.  These functions instead
+   divide the high word in 32 bits, which the compiler turns into
+   a multiply by the reciprocal when the divisor is a constant,
+   and then the remainder and the low word with a single DIVL
+   instruction.  Use them where a time or count in 64 bits is
+   divided by a 32-bit quantity on a hot path. */
+
+/* Divides N by D and returns the quotient, storing the
+   remainder in *REM. */
+static inline uint64_t div_u64_rem(uint64_t n, uint32_t d, uint32_t* rem) {
+  uint32_t n1 = n >> 32;
+  uint32_t q1 = n1 / d;
+  uint32_t q0;
+
+  /* The high word's remainder is less than D, so the quotient of
+     the rest fits in 32 bits and DIVL does not trap. */
+  asm("divl %4" : "=a"(q0), "=d"(*rem) : "0"((uint32_t)n), "1"(n1 - q1 * d), "rm"(d));
+  return (uint64_t)q1 << 32 | q0;
+}
+
+/* Returns N / D. */
+static inline uint64_t div_u64(uint64_t n, uint32_t d) {
+  uint32_t rem;
+  return div_u64_rem(n, d, &rem);
+}
+
+/* Returns N % D. */
+static inline uint32_t mod_u64(uint64_t n, uint32_t d) {
+  uint32_t rem;
+  div_u64_rem(n, d, &rem);
+  return rem;
+}
+
+/* Returns N / D, rounded toward zero as C's division does. */
+static inline int64_t div_s64(int64_t n, int32_t d) {
+  uint64_t q = div_u64(n >= 0 ? (uint64_t)n : -(uint64_t)n,
+                       d >= 0 ? (uint32_t)d : -(uint32_t)d);
+  return (n < 0) == (d < 0) ? (int64_t)q : -(int64_t)q;
+}
+
+#endif /* lib/div64.h */
@@ -0,0 +1,54 @@
+#ifndef __LIB_FCNTL_H
+#define __LIB_FCNTL_H
+
+/* Flags for the open_flags system call, which the fcntl system
+   call also reports with F_GETFL and changes with F_SETFL.
+
+   O_DIRECT: reads and writes whose file offset, size and user
+   buffer are all multiples of 512 bytes, the size of a disk
+   sector, go straight between user memory and the disk instead
+   of through the kernel's buffer cache, so that streaming a
+   large file through once does not push the rest out of it.
+   Other reads and writes of the file use the cache as usual, and
+   the two stay coherent. */
+#define O_DIRECT 0x1
+
+/* O_NONBLOCK: reads and writes of the descriptor never wait.  A
+   read of an empty pipe that still has a writer, or of the
+   console with no key typed, returns -1 at once, and a write to
+   a full pipe writes what fits, or returns -1 if nothing does.
+   Files are always ready.  Applies to one descriptor, so the
+   other end of a pipe may still block; poll() waits for a
+   non-blocking descriptor to become ready. */
+#define O_NONBLOCK 0x2
+
+/* O_APPEND: every write through the descriptor goes to the end
+   of the file, found and extended in one step under the file's
+   lock, and leaves the file position just past what it wrote, so
+   several processes may append to one log without seeking or
+   locking and never overwrite each other's records.  pwrite()
+   still writes at the offset it is given.  Files only. */
+#define O_APPEND 0x4
+
+/* Commands for the fcntl system call. */
+#define F_GETFL 1 /* Returns the descriptor's flags. */
+#define F_SETFL 2 /* Sets the descriptor's flags to the argument. */
+
+/* Advice for the fadvise system call, about how a file will be
+   read, with the meanings of the MADV_* values in <mman.h>.
+
+   POSIX_FADV_NORMAL, POSIX_FADV_RANDOM and POSIX_FADV_SEQUENTIAL
+   apply to the whole file, for every process that has it open,
+   until other advice is given or it is closed by all of them.
+   Random reads get no read-ahead; sequential reads get a larger
+   window, and the buffer cache gives up the sectors they have
+   read before any others.  POSIX_FADV_WILLNEED starts reading a
+   range into the buffer cache, and POSIX_FADV_DONTNEED lets it
+   give up the range first. */
+#define POSIX_FADV_NORMAL 0
+#define POSIX_FADV_RANDOM 1
+#define POSIX_FADV_SEQUENTIAL 2
+#define POSIX_FADV_WILLNEED 3
+#define POSIX_FADV_DONTNEED 4
+
+#endif /* lib/fcntl.h */
@@ -1,28 +1,90 @@
 #ifndef __LIB_FP_ARITHMETIC_H
 #define __LIB_FP_ARITHMETIC_H
 
-/*
-  Define constants for fixed point arithmetic,
-  using 31 bit numbers, as described in the documentation
-*/
-
-#define P 17       /* Integer Bits */
-#define Q 14       /* Decimal Bits */
-#define S 1        /* Sign Bit */
-#define F 1 << (Q) /* Floating point */
-
-#define FP(n) ((n) * (F))
-#define ROUND_ZERO(x) ((x) / (F))
-#define ROUND_CLOSEST(x) (((x) >= 0 ? ((x) + (F) / 2) / (F) : ((x) - (F) / 2) / (F)))
-#define ADD(x, y) ((x) + (y))
-#define SUB(x, y) ((x) - (y))
-
-#define INT_ADD(x, n) ((x) + (n) * (F))
-#define INT_SUB(n, x) ((n) * (F) - (x))
-#define INT_MULTIPLY(x, n) ((x) * (n))
-#define INT_DIVIDE(x, n) ((x) / (n))
-
-#define MULTIPLY(x, y) (((int64_t)(x)) * (y) / (F))
-#define DIVIDE(x, y) (((int64_t)(x)) * (F) / (y))
-
-#endif // __LIB_FP_ARITHMETIC_H
+#include <stdint.h>
+
+/* Fixed-point arithmetic for the MLFQS scheduler, in the 17.14
+   format that the documentation describes: 17 integer bits, 14
+   fraction bits and a sign bit in a 32-bit integer.
+
+   A fixed_t is a structure, so that the compiler rejects an
+   integer where a fixed-point number belongs and vice versa.
+
+   None of these functions divides a 64-bit number in C, which
+   i386 does by calling __divdi3() in lib/arithmetic.c.  Division
+   by F compiles to shifts.  The product of two fixed-point numbers is a
+   single 32x32->64 multiply followed by a shift.  The quotient of
+   two divides the 64-bit dividend by a 32-bit divisor with one
+   idivl instruction.  Division by an integer constant, such as
+   the 60 in the load average, is left for the compiler to turn
+   into a multiply by a precomputed reciprocal.
+
+   Results round toward zero, as C's division does, so they match
+   the plain arithmetic that the documentation gives. */
+
+#define FP_SHIFT 14            /* Fraction bits. */
+#define FP_ONE (1 << FP_SHIFT) /* 1.0, the F of the documentation. */
+
+/* A fixed-point number. */
+typedef struct {
+  int32_t raw; /* Value times FP_ONE. */
+} fixed_t;
+
+/* Returns the fixed-point number whose representation is RAW. */
+static inline fixed_t fp_raw(int32_t raw) {
+  fixed_t x = {raw};
+  return x;
+}
+
+/* Returns integer N as a fixed-point number. */
+static inline fixed_t fp_int(int n) { return fp_raw(n * FP_ONE); }
+
+/* Returns X rounded toward zero. */
+static inline int fp_trunc(fixed_t x) { return x.raw / FP_ONE; }
+
+/* Returns X rounded to the nearest integer, halves away from
+   zero. */
+static inline int fp_round(fixed_t x) {
+  return (x.raw >= 0 ? x.raw + FP_ONE / 2 : x.raw - FP_ONE / 2) / FP_ONE;
+}
+
+/* Returns X + Y. */
+static inline fixed_t fp_add(fixed_t x, fixed_t y) { return fp_raw(x.raw + y.raw); }
+
+/* Returns X - Y. */
+static inline fixed_t fp_sub(fixed_t x, fixed_t y) { return fp_raw(x.raw - y.raw); }
+
+/* Returns X + N. */
+static inline fixed_t fp_add_int(fixed_t x, int n) { return fp_raw(x.raw + n * FP_ONE); }
+
+/* Returns N - X. */
+static inline fixed_t fp_sub_from_int(int n, fixed_t x) { return fp_raw(n * FP_ONE - x.raw); }
+
+/* Returns X * N. */
+static inline fixed_t fp_mul_int(fixed_t x, int n) { return fp_raw(x.raw * n); }
+
+/* Returns X / N.  A 32-bit division, or a multiply when N is a
+   constant. */
+static inline fixed_t fp_div_int(fixed_t x, int n) { return fp_raw(x.raw / n); }
+
+/* Returns X * Y. */
+static inline fixed_t fp_mul(fixed_t x, fixed_t y) {
+  int64_t p = (int64_t)x.raw * y.raw;
+
+  /* An arithmetic shift rounds down; round toward zero instead. */
+  if (p < 0)
+    p += FP_ONE - 1;
+  return fp_raw(p >> FP_SHIFT);
+}
+
+/* Returns X / Y.  The quotient must be representable, or the
+   processor raises a divide error. */
+static inline fixed_t fp_div(fixed_t x, fixed_t y) {
+  int64_t n = (int64_t)x.raw << FP_SHIFT;
+  int32_t q, r;
+
+  asm("idivl %3" : "=a"(q), "=d"(r) : "A"(n), "rm"(y.raw) : "cc");
+  return fp_raw(q);
+}
+
+#endif /* lib/fp_arithmetic.h */
@@ -0,0 +1,53 @@
+#ifndef __LIB_IORING_H
+#define __LIB_IORING_H
+
+#include <stdint.h>
+
+/* A ring of file system calls shared by a process and the
+   kernel, so that many of them cost one trap.  The process
+   fills in submission entries at sq_tail and advances it, then
+   makes the ioring_enter system call.  The kernel runs the
+   entries from sq_head on, in order, advancing sq_head, and
+   posts a completion entry for each one at cq_tail.  The
+   process reads completions from cq_head on and advances
+   cq_head.  The indices run freely and wrap at 2**32; an entry's
+   slot is its index modulo IORING_ENTRIES. */
+
+/* Entries in each ring.  A power of 2. */
+#define IORING_ENTRIES 128
+
+/* Operations. */
+enum io_op {
+  IORING_OP_READ,  /* read(FD, BUF, LEN). */
+  IORING_OP_WRITE, /* write(FD, BUF, LEN). */
+  IORING_OP_SEEK,  /* seek(FD, LEN), returning 0. */
+  IORING_OP_OPEN,  /* open(BUF), returning the new fd. */
+  IORING_OP_CLOSE  /* close(FD), returning 0. */
+};
+
+/* A submission entry. */
+struct io_sqe {
+  uint32_t op;        /* An enum io_op. */
+  int fd;             /* File descriptor. */
+  void* buf;          /* Buffer or file name. */
+  uint32_t len;       /* Buffer size or file position. */
+  uint32_t user_data; /* Copied to the completion entry. */
+};
+
+/* A completion entry. */
+struct io_cqe {
+  uint32_t user_data; /* From the submission entry. */
+  int res;            /* What the system call would have returned. */
+};
+
+/* The shared page. */
+struct io_ring {
+  volatile uint32_t sq_head; /* Next submission the kernel runs. */
+  volatile uint32_t sq_tail; /* Next free submission slot. */
+  volatile uint32_t cq_head; /* Next completion the process reads. */
+  volatile uint32_t cq_tail; /* Next free completion slot. */
+  struct io_sqe sqes[IORING_ENTRIES];
+  struct io_cqe cqes[IORING_ENTRIES];
+};
+
+#endif /* lib/ioring.h */
@@ -0,0 +1,15 @@
+#ifndef __LIB_IOVEC_H
+#define __LIB_IOVEC_H
+
+#include <stddef.h>
+
+/* Most buffers a single readv or writev system call takes. */
+#define IOV_MAX 64
+
+/* A buffer for the readv and writev system calls. */
+struct iovec {
+  void* iov_base; /* Start of the buffer. */
+  size_t iov_len; /* Size of the buffer in bytes. */
+};
+
+#endif /* lib/iovec.h */
@@ -50,6 +50,30 @@ static inline elem_type last_mask(const struct bitmap* b) {
   return last_bits ? ((elem_type)1 << last_bits) - 1 : (elem_type)-1;
 }
 
+/* Returns the number of bits in the element that holds bit IDX
+   from IDX up to END or to the end of the element, whichever
+   comes first. */
+static inline size_t span_bits(size_t idx, size_t end) {
+  size_t left = ELEM_BITS - idx % ELEM_BITS;
+  return end - idx < left ? end - idx : left;
+}
+
+/* Returns an elem_type with the N bits starting at bit IDX of its
+   element set, where the N bits are all in that element. */
+static inline elem_type span_mask(size_t idx, size_t n) {
+  elem_type ones = n < ELEM_BITS ? ((elem_type)1 << n) - 1 : (elem_type)-1;
+  return ones << (idx % ELEM_BITS);
+}
+
+/* Returns the number of 1-bits in E.  GCC's __builtin_popcount()
+   needs libgcc, which the kernel does not link with. */
+static inline size_t popcount(elem_type e) {
+  e = e - ((e >> 1) & 0x55555555);
+  e = (e & 0x33333333) + ((e >> 2) & 0x33333333);
+  e = (e + (e >> 4)) & 0x0f0f0f0f;
+  return (e * 0x01010101) >> 24;
+}
+
 /* Creation and destruction. */
 
 /* Initializes B to be a bitmap of BIT_CNT bits
@@ -103,6 +127,13 @@ void bitmap_destroy(struct bitmap* b) {
 /* Returns the number of bits in B. */
 size_t bitmap_size(const struct bitmap* b) { return b->bit_cnt; }
 
+/* Returns the storage of B's bits, which is as many bytes as
+   bitmap_buf_size(), less the header, says.  Bit K of B is bit
+   K % CHAR_BIT of byte K / CHAR_BIT, since x86 is
+   little-endian, so the storage can be copied to and from disk
+   as is. */
+void* bitmap_bits(struct bitmap* b) { return b->bits; }
+
 /* Setting and testing single bits. */
 
 /* Atomically sets the bit numbered IDX in B to VALUE. */
@@ -166,46 +197,64 @@ void bitmap_set_all(struct bitmap* b, bool value) {
   bitmap_set_multiple(b, 0, bitmap_size(b), value);
 }
 
-/* Sets the CNT bits starting at START in B to VALUE. */
+/* Sets the CNT bits starting at START in B to VALUE, a whole
+   element at a time.  Each element is updated atomically, as by
+   bitmap_set(). */
 void bitmap_set_multiple(struct bitmap* b, size_t start, size_t cnt, bool value) {
-  size_t i;
+  size_t end = start + cnt;
+  size_t i, n;
 
   ASSERT(b != NULL);
   ASSERT(start <= b->bit_cnt);
   ASSERT(start + cnt <= b->bit_cnt);
 
-  for (i = 0; i < cnt; i++)
-    bitmap_set(b, start + i, value);
+  for (i = start; i < end; i += n) {
+    elem_type* e = &b->bits[elem_idx(i)];
+    elem_type mask;
+
+    n = span_bits(i, end);
+    mask = span_mask(i, n);
+    if (value)
+      asm("orl %1, %0" : "+m"(*e) : "r"(mask) : "cc");
+    else
+      asm("andl %1, %0" : "+m"(*e) : "r"(~mask) : "cc");
+  }
 }
 
 /* Returns the number of bits in B between START and START + CNT,
    exclusive, that are set to VALUE. */
 size_t bitmap_count(const struct bitmap* b, size_t start, size_t cnt, bool value) {
-  size_t i, value_cnt;
+  size_t end = start + cnt;
+  size_t i, n, value_cnt;
 
   ASSERT(b != NULL);
   ASSERT(start <= b->bit_cnt);
   ASSERT(start + cnt <= b->bit_cnt);
 
   value_cnt = 0;
-  for (i = 0; i < cnt; i++)
-    if (bitmap_test(b, start + i) == value)
-      value_cnt++;
-  return value_cnt;
+  for (i = start; i < end; i += n) {
+    n = span_bits(i, end);
+    value_cnt += popcount(b->bits[elem_idx(i)] & span_mask(i, n));
+  }
+  return value ? value_cnt : cnt - value_cnt;
 }
 
 /* Returns true if any bits in B between START and START + CNT,
    exclusive, are set to VALUE, and false otherwise. */
 bool bitmap_contains(const struct bitmap* b, size_t start, size_t cnt, bool value) {
-  size_t i;
+  elem_type flip = value ? 0 : (elem_type)-1; /* Turns VALUE bits into 1s. */
+  size_t end = start + cnt;
+  size_t i, n;
 
   ASSERT(b != NULL);
   ASSERT(start <= b->bit_cnt);
   ASSERT(start + cnt <= b->bit_cnt);
 
-  for (i = 0; i < cnt; i++)
-    if (bitmap_test(b, start + i) == value)
+  for (i = start; i < end; i += n) {
+    n = span_bits(i, end);
+    if ((b->bits[elem_idx(i)] ^ flip) & span_mask(i, n))
       return true;
+  }
   return false;
 }
 
@@ -232,17 +281,50 @@ bool bitmap_all(const struct bitmap* b, size_t start, size_t cnt) {
 /* Finds and returns the starting index of the first group of CNT
    consecutive bits in B at or after START that are all set to
    VALUE.
-   If there is no such group, returns BITMAP_ERROR. */
+   If there is no such group, returns BITMAP_ERROR.
+
+   Tracks the current run of VALUE bits in one pass over the
+   elements.  Within an element, finds the end of each run of
+   VALUE bits, and the start of the next, with a single bsf
+   instruction (__builtin_ctzl()), so an element that holds
+   nothing but VALUE bits, or none, takes one step. */
 size_t bitmap_scan(const struct bitmap* b, size_t start, size_t cnt, bool value) {
+  elem_type flip = value ? 0 : (elem_type)-1; /* Turns VALUE bits into 1s. */
+  size_t run_start = start;
+  size_t base;
+
   ASSERT(b != NULL);
   ASSERT(start <= b->bit_cnt);
 
-  if (cnt <= b->bit_cnt) {
-    size_t last = b->bit_cnt - cnt;
-    size_t i;
-    for (i = start; i <= last; i++)
-      if (!bitmap_contains(b, i, cnt, !value))
-        return i;
+  if (cnt == 0)
+    return start;
+  for (base = start - start % ELEM_BITS; base < b->bit_cnt; base += ELEM_BITS) {
+    elem_type e = b->bits[elem_idx(base)] ^ flip;
+    size_t pos = base < start ? start - base : 0;
+
+    /* Bits past the end of B never match. */
+    if (base + ELEM_BITS > b->bit_cnt)
+      e &= last_mask(b);
+
+    while (pos < ELEM_BITS) {
+      elem_type rest = e >> pos;
+
+      if (rest & 1) {
+        /* Extend the run to the first bit that is not VALUE,
+           which may be past the end of the element. */
+        pos += ~rest != 0 ? (size_t)__builtin_ctzl(~rest) : ELEM_BITS;
+        if (base + pos - run_start >= cnt)
+          return run_start;
+      } else if (rest != 0) {
+        /* Start a new run at the next VALUE bit. */
+        pos += __builtin_ctzl(rest);
+        run_start = base + pos;
+      } else {
+        /* No VALUE bits in the rest of the element. */
+        run_start = base + ELEM_BITS;
+        break;
+      }
+    }
   }
   return BITMAP_ERROR;
 }
@@ -285,6 +367,7 @@ bool bitmap_write(const struct bitmap* b, struct file* file) {
   off_t size = byte_cnt(b->bit_cnt);
   return file_write_at(file, b->bits, size, 0) == size;
 }
+
 #endif /* FILESYS */
 
 /* Debugging. */
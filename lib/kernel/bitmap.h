@@ -15,6 +15,7 @@ void bitmap_destroy(struct bitmap*);
 
 /* Bitmap size. */
 size_t bitmap_size(const struct bitmap*);
+void* bitmap_bits(struct bitmap*);
 
 /* Setting and testing single bits. */
 void bitmap_set(struct bitmap*, size_t idx, bool);
@@ -1,159 +1,359 @@
 #include <console.h>
+#include <list.h>
 #include <stdarg.h>
 #include <stdio.h>
+#include <string.h>
 #include "devices/serial.h"
 #include "devices/vga.h"
 #include "threads/init.h"
 #include "threads/interrupt.h"
+#include "threads/kstat.h"
+#include "threads/percpu.h"
 #include "threads/synch.h"
+#include "threads/thread.h"
 
-static void vprintf_helper(char, void*);
-static void putchar_have_lock(uint8_t c);
-
-/* The console lock.
-   Both the vga and serial layers do their own locking, so it's
-   safe to call them at any time.
-   But this lock is useful to prevent simultaneous printf() calls
-   from mixing their output, which looks confusing. */
-static struct lock console_lock;
-
-/* True in ordinary circumstances: we want to use the console
-   lock to avoid mixing output between threads, as explained
-   above.
-
-   False in early boot before the point that locks are functional
-   or the console lock has been initialized, or after a kernel
-   panics.  In the former case, taking the lock would cause an
-   assertion failure, which in turn would cause a panic, turning
-   it into the latter case.  In the latter case, if it is a buggy
-   lock_acquire() implementation that caused the panic, we'll
-   likely just recurse. */
-static bool use_console_lock;
-
-/* It's possible, if you add enough debug output to Pintos, to
-   try to recursively grab console_lock from a single thread.  As
-   a real example, I added a printf() call to palloc_free().
-   Here's a real backtrace that resulted:
-
-   lock_console()
-   vprintf()
-   printf()               - palloc() tries to grab the lock again
-   palloc_free()        
-   thread_schedule_tail() - another thread dying as we switch threads
-   schedule()
-   thread_yield()
-   intr_handler()         - timer interrupt
-   intr_set_level()
-   serial_putc()
-   putchar_have_lock()
-   putbuf()
-   sys_write()            - one process writing to the console
-   syscall_handler()
-   intr_handler()
-
-   This kind of thing is very difficult to debug, so we avoid the
-   problem by simulating a recursive lock with a depth
-   counter. */
-static int console_lock_depth;
+/* The console log.
+
+   printf(), puts(), putchar() and putbuf() do not write to the
+   vga display and serial port themselves.  Each call reserves
+   room for its whole output in LOG_BUF, a ring of bytes, with
+   interrupts off for just long enough to move LOG_HEAD, copies
+   or formats its output into the room with interrupts on, and
+   then commits it.  A kernel thread, the drainer, takes
+   committed bytes from the ring in chunks and writes each chunk
+   with one serial_putbuf() call.  So no caller waits for the
+   serial port, which takes about 100 microseconds per
+   character, or for another caller, yet each call's output
+   stays in one piece and calls come out in the order they
+   reserved their room.
+
+   Reserved bytes only become committed, all together, when the
+   last outstanding reservation is committed, so the drainer
+   never reads room that is still being filled.  A caller that
+   finds the ring full sleeps until the drainer makes room.
+
+   Output is written directly instead, as it was before there
+   was a ring, until console_start() starts the drainer, once a
+   kernel panic or shutdown has called console_flush(), and for
+   callers that cannot sleep when the ring is full: interrupt
+   handlers, code running with interrupts off, and the drainer
+   itself.  Such a caller first writes what is committed in the
+   ring, so that only the chunk the drainer is writing can come
+   out after its own output.
+
+   The vga display is brought up to date whenever the drainer
+   runs out of output and when the ring is flushed; see
+   devices/vga.c. */
+
+/* Size of the ring, in bytes.  Must be a power of 2. */
+#define LOG_SIZE 8192
+
+/* Most bytes the drainer writes at a time. */
+#define DRAIN_CHUNK 256
+
+/* Output that vprintf() formats on the stack.  Output that is
+   longer is formatted a second time, into the ring. */
+struct printf_buf {
+  char buf[128]; /* The first bytes of output. */
+  int cnt;       /* Bytes of output. */
+};
+
+/* Where vprintf() formats output into the ring. */
+struct printf_room {
+  unsigned pos; /* Next byte to write. */
+  unsigned end; /* End of the room reserved. */
+};
+
+/* The ring.  The counters count the bytes ever reserved,
+   committed and drained.  All of this is accessed with
+   interrupts off. */
+static char log_buf[LOG_SIZE];
+static unsigned log_head;      /* Bytes reserved. */
+static unsigned log_done;      /* Bytes committed. */
+static unsigned log_tail;      /* Bytes drained. */
+static unsigned log_writers;   /* Reservations not yet committed. */
+static bool log_active;        /* Is output going through the ring? */
+static struct list log_full;   /* Threads waiting for room. */
+static struct thread* drainer; /* The drainer, once started. */
+static bool drainer_idle;      /* Is the drainer waiting on drain_sema? */
+static struct semaphore drain_sema;
 
 /* Number of characters written to console. */
-static int64_t write_cnt;
+static struct percpu_counter write_cnt;
 
-/* Enable console locking. */
+static thread_func drain;
+static bool reserve(size_t, unsigned* pos);
+static void commit(void);
+static void put_log(unsigned pos, const char*, size_t);
+static void write_log(void);
+static void emit(const char*, size_t);
+static void emit_chunk(const char*, size_t, void*);
+static void vprintf_buf(const char*, size_t, void*);
+static void vprintf_room(const char*, size_t, void*);
+
+/* Initializes the console.  Output is written directly until
+   console_start() is called. */
 void console_init(void) {
-  lock_init(&console_lock);
-  use_console_lock = true;
+  list_init(&log_full);
+  sema_init(&drain_sema, 0);
+  kstat_percpu("console.chars", &write_cnt);
 }
 
-/* Notifies the console that a kernel panic is underway,
-   which warns it to avoid trying to take the console lock from
-   now on. */
-void console_panic(void) { use_console_lock = false; }
+/* Starts the drainer, after which output goes through the ring.
+   Called once the scheduler runs. */
+void console_start(void) {
+  tid_t tid = thread_create("console", PRI_MAX, drain, NULL);
+  if (tid == TID_ERROR)
+    printf("console: cannot start drainer thread\n");
+}
 
-/* Prints console statistics. */
-void console_print_stats(void) { printf("Console: %lld characters output\n", write_cnt); }
+/* Notifies the console that a kernel panic is underway, so that
+   the ring is written out and later output is written
+   directly. */
+void console_panic(void) { console_flush(); }
 
-/* Acquires the console lock. */
-static void acquire_console(void) {
-  if (!intr_context() && use_console_lock) {
-    if (lock_held_by_current_thread(&console_lock))
-      console_lock_depth++;
-    else
-      lock_acquire(&console_lock);
-  }
-}
+/* Writes out everything in the ring, and writes later output
+   directly.  If the caller can sleep, lets the drainer finish
+   first; otherwise writes the committed bytes itself. */
+void console_flush(void) {
+  enum intr_level old_level = intr_disable();
 
-/* Releases the console lock. */
-static void release_console(void) {
-  if (!intr_context() && use_console_lock) {
-    if (console_lock_depth > 0)
-      console_lock_depth--;
-    else
-      lock_release(&console_lock);
-  }
+  if (log_active && old_level == INTR_ON && !intr_context() && thread_current() != drainer)
+    while (log_tail != log_done || !drainer_idle) {
+      intr_set_level(INTR_ON);
+      thread_yield();
+      intr_disable();
+    }
+  log_active = false;
+  write_log();
+  vga_flush();
+  intr_set_level(old_level);
 }
 
-/* Returns true if the current thread has the console lock,
-   false otherwise. */
-static bool console_locked_by_current_thread(void) {
-  return (intr_context() || !use_console_lock || lock_held_by_current_thread(&console_lock));
+/* Prints console statistics. */
+void console_print_stats(void) {
+  printf("Console: %lld characters output\n", percpu_read(&write_cnt));
 }
 
 /* The standard vprintf() function,
    which is like printf() but uses a va_list.
    Writes its output to both vga display and serial port. */
 int vprintf(const char* format, va_list args) {
-  int char_cnt = 0;
+  struct printf_buf out;
+  va_list copy;
+  unsigned pos;
 
-  acquire_console();
-  __vprintf(format, args, vprintf_helper, &char_cnt);
-  release_console();
+  out.cnt = 0;
+  va_copy(copy, args);
+  __vprintf_chunked(format, copy, vprintf_buf, &out);
+  va_end(copy);
 
-  return char_cnt;
+  if (!reserve(out.cnt, &pos)) {
+    if ((size_t)out.cnt <= sizeof out.buf)
+      emit(out.buf, out.cnt);
+    else
+      __vprintf_chunked(format, args, emit_chunk, NULL);
+  } else if ((size_t)out.cnt <= sizeof out.buf) {
+    put_log(pos, out.buf, out.cnt);
+    commit();
+  } else {
+    /* If the arguments have changed since the first time, the
+       output is cut off, or padded with spaces, to fit. */
+    struct printf_room room = {pos, pos + out.cnt};
+
+    __vprintf_chunked(format, args, vprintf_room, &room);
+    while (room.pos != room.end)
+      vprintf_room(" ", 1, &room);
+    commit();
+  }
+  return out.cnt;
 }
 
 /* Writes string S to the console, followed by a new-line
    character. */
 int puts(const char* s) {
-  acquire_console();
-  while (*s != '\0')
-    putchar_have_lock(*s++);
-  putchar_have_lock('\n');
-  release_console();
+  size_t len = strlen(s);
+  unsigned pos;
 
+  if (reserve(len + 1, &pos)) {
+    put_log(pos, s, len);
+    put_log(pos + len, "\n", 1);
+    commit();
+  } else {
+    emit(s, len);
+    emit("\n", 1);
+  }
   return 0;
 }
 
-/* Writes the N characters in BUFFER to the console. */
+/* Writes the N characters in BUFFER to the console.  BUFFER may
+   be in user memory. */
 void putbuf(const char* buffer, size_t n) {
-  acquire_console();
-  while (n-- > 0)
-    putchar_have_lock(*buffer++);
-  release_console();
+  while (n > 0) {
+    size_t chunk = n < LOG_SIZE ? n : LOG_SIZE;
+    unsigned pos;
+
+    if (reserve(chunk, &pos)) {
+      put_log(pos, buffer, chunk);
+      commit();
+    } else
+      emit(buffer, chunk);
+    buffer += chunk;
+    n -= chunk;
+  }
 }
 
 /* Writes C to the vga display and serial port. */
 int putchar(int c) {
-  acquire_console();
-  putchar_have_lock(c);
-  release_console();
+  char ch = c;
 
+  putbuf(&ch, 1);
   return c;
 }
 
-/* Helper function for vprintf(). */
-static void vprintf_helper(char c, void* char_cnt_) {
-  int* char_cnt = char_cnt_;
-  (*char_cnt)++;
-  putchar_have_lock(c);
+/* Reserves room for N bytes of output in the ring and stores
+   its position in *POS, sleeping until there is room if the
+   caller can.  Otherwise, writes out what is committed in the
+   ring and returns false, and the caller must write its output
+   directly. */
+static bool reserve(size_t n, unsigned* pos) {
+  enum intr_level old_level = intr_disable();
+  bool can_sleep =
+      log_active && old_level == INTR_ON && !intr_context() && thread_current() != drainer;
+
+  while (can_sleep && log_active && n <= LOG_SIZE && LOG_SIZE - (log_head - log_tail) < n) {
+    list_push_back(&log_full, &thread_current()->elem);
+    thread_block();
+  }
+  if (!log_active || LOG_SIZE - (log_head - log_tail) < n) {
+    write_log();
+    intr_set_level(old_level);
+    return false;
+  }
+
+  *pos = log_head;
+  log_head += n;
+  log_writers++;
+  intr_set_level(old_level);
+  return true;
+}
+
+/* Ends a reservation, committing all reserved bytes if it was
+   the last one outstanding, and wakes the drainer if it is
+   waiting for them, or writes them out if the drainer has been
+   stopped meanwhile. */
+static void commit(void) {
+  enum intr_level old_level = intr_disable();
+
+  ASSERT(log_writers > 0);
+  if (--log_writers == 0) {
+    log_done = log_head;
+    if (!log_active)
+      write_log();
+    else if (drainer_idle && log_done != log_tail) {
+      drainer_idle = false;
+      sema_up(&drain_sema);
+    }
+  }
+  intr_set_level(old_level);
+}
+
+/* Copies the N bytes in BUFFER into the ring at POS, wrapping
+   around its end. */
+static void put_log(unsigned pos, const char* buffer, size_t n) {
+  size_t ofs = pos % LOG_SIZE;
+  size_t first = n < LOG_SIZE - ofs ? n : LOG_SIZE - ofs;
+
+  memcpy(log_buf + ofs, buffer, first);
+  memcpy(log_buf, buffer + first, n - first);
+}
+
+/* Writes out and removes the committed bytes in the ring. */
+static void write_log(void) {
+  ASSERT(intr_get_level() == INTR_OFF);
+
+  while (log_tail != log_done) {
+    size_t ofs = log_tail % LOG_SIZE;
+    size_t n = log_done - log_tail;
+
+    if (n > LOG_SIZE - ofs)
+      n = LOG_SIZE - ofs;
+    log_tail += n;
+    emit(log_buf + ofs, n);
+  }
+}
+
+/* The drainer.  Writes committed bytes from the ring to the
+   console as they arrive. */
+static void drain(void* aux UNUSED) {
+  enum intr_level old_level = intr_disable();
+
+  drainer = thread_current();
+  log_active = true;
+  intr_set_level(old_level);
+
+  for (;;) {
+    char chunk[DRAIN_CHUNK];
+    size_t ofs, n;
+
+    old_level = intr_disable();
+    while (log_done == log_tail) {
+      vga_flush();
+      drainer_idle = true;
+      sema_down(&drain_sema);
+    }
+    ofs = log_tail % LOG_SIZE;
+    n = log_done - log_tail;
+    if (n > DRAIN_CHUNK)
+      n = DRAIN_CHUNK;
+    if (n > LOG_SIZE - ofs)
+      n = LOG_SIZE - ofs;
+    memcpy(chunk, log_buf + ofs, n);
+    log_tail += n;
+    while (!list_empty(&log_full))
+      thread_unblock(list_entry(list_pop_front(&log_full), struct thread, elem));
+    intr_set_level(old_level);
+
+    emit(chunk, n);
+  }
+}
+
+/* Writes the N bytes in BUFFER to the vga display and serial
+   port. */
+static void emit(const char* buffer, size_t n) {
+  size_t i;
+
+  percpu_add(&write_cnt, n);
+  serial_putbuf(buffer, n);
+  for (i = 0; i < n; i++)
+    vga_putc(buffer[i]);
 }
 
-/* Writes C to the vga display and serial port.
-   The caller has already acquired the console lock if
-   appropriate. */
-static void putchar_have_lock(uint8_t c) {
-  ASSERT(console_locked_by_current_thread());
-  write_cnt++;
-  serial_putc(c);
-  vga_putc(c);
+/* Helper function for vprintf() that writes the N bytes in
+   CHUNK directly. */
+static void emit_chunk(const char* chunk, size_t n, void* aux UNUSED) { emit(chunk, n); }
+
+/* Helper function for vprintf() that counts the N bytes in CHUNK
+   and stores as many as there is room for in the printf_buf
+   AUX. */
+static void vprintf_buf(const char* chunk, size_t n, void* out_) {
+  struct printf_buf* out = out_;
+
+  if ((size_t)out->cnt < sizeof out->buf) {
+    size_t room = sizeof out->buf - out->cnt;
+    memcpy(out->buf + out->cnt, chunk, n < room ? n : room);
+  }
+  out->cnt += n;
+}
+
+/* Helper function for vprintf() that stores as many of the N
+   bytes in CHUNK as there is room for in the printf_room AUX. */
+static void vprintf_room(const char* chunk, size_t n, void* room_) {
+  struct printf_room* room = room_;
+  size_t space = room->end - room->pos;
+
+  if (n > space)
+    n = space;
+  put_log(room->pos, chunk, n);
+  room->pos += n;
 }
@@ -2,6 +2,8 @@
 #define __LIB_KERNEL_CONSOLE_H
 
 void console_init(void);
+void console_start(void);
+void console_flush(void);
 void console_panic(void);
 void console_print_stats(void);
 
@@ -7,22 +7,29 @@
 
 #include "hash.h"
 #include "../debug.h"
-#include "threads/malloc.h"
+#include "../round.h"
+#include "threads/vmalloc.h"
 
 #define list_elem_to_hash_elem(LIST_ELEM) list_entry(LIST_ELEM, struct hash_elem, list_elem)
 
-static struct list* find_bucket(struct hash*, struct hash_elem*);
+static struct list* find_bucket(struct list* buckets, size_t bucket_cnt, unsigned hash);
 static struct hash_elem* find_elem(struct hash*, struct list*, struct hash_elem*);
+static struct hash_elem* lookup(struct hash*, unsigned hash, struct hash_elem*);
 static void insert_elem(struct hash*, struct list*, struct hash_elem*);
 static void remove_elem(struct hash*, struct hash_elem*);
 static void rehash(struct hash*);
+static void move_buckets(struct hash*);
+static struct list* next_bucket(struct hash*, struct list*);
 
 /* Initializes hash table H to compute hash values using HASH and
    compare hash elements using LESS, given auxiliary data AUX. */
 bool hash_init(struct hash* h, hash_hash_func* hash, hash_less_func* less, void* aux) {
   h->elem_cnt = 0;
   h->bucket_cnt = 4;
-  h->buckets = malloc(sizeof *h->buckets * h->bucket_cnt);
+  h->buckets = kvmalloc(sizeof *h->buckets * h->bucket_cnt);
+  h->old_bucket_cnt = 0;
+  h->old_buckets = NULL;
+  h->old_pos = 0;
   h->hash = hash;
   h->less = less;
   h->aux = aux;
@@ -44,11 +51,9 @@ bool hash_init(struct hash* h, hash_hash_func* hash, hash_less_func* less, void*
    hash_replace(), or hash_delete(), yields undefined behavior,
    whether done in DESTRUCTOR or elsewhere. */
 void hash_clear(struct hash* h, hash_action_func* destructor) {
-  size_t i;
-
-  for (i = 0; i < h->bucket_cnt; i++) {
-    struct list* bucket = &h->buckets[i];
+  struct list* bucket;
 
+  for (bucket = next_bucket(h, NULL); bucket != NULL; bucket = next_bucket(h, bucket)) {
     if (destructor != NULL)
       while (!list_empty(bucket)) {
         struct list_elem* list_elem = list_pop_front(bucket);
@@ -59,6 +64,8 @@ void hash_clear(struct hash* h, hash_action_func* destructor) {
     list_init(bucket);
   }
 
+  kvfree(h->old_buckets);
+  h->old_buckets = NULL;
   h->elem_cnt = 0;
 }
 
@@ -75,7 +82,8 @@ void hash_clear(struct hash* h, hash_action_func* destructor) {
 void hash_destroy(struct hash* h, hash_action_func* destructor) {
   if (destructor != NULL)
     hash_clear(h, destructor);
-  free(h->buckets);
+  kvfree(h->old_buckets);
+  kvfree(h->buckets);
 }
 
 /* Inserts NEW into hash table H and returns a null pointer, if
@@ -83,11 +91,11 @@ void hash_destroy(struct hash* h, hash_action_func* destructor) {
    If an equal element is already in the table, returns it
    without inserting NEW. */
 struct hash_elem* hash_insert(struct hash* h, struct hash_elem* new) {
-  struct list* bucket = find_bucket(h, new);
-  struct hash_elem* old = find_elem(h, bucket, new);
+  unsigned hash = h->hash(new, h->aux);
+  struct hash_elem* old = lookup(h, hash, new);
 
   if (old == NULL)
-    insert_elem(h, bucket, new);
+    insert_elem(h, find_bucket(h->buckets, h->bucket_cnt, hash), new);
 
   rehash(h);
 
@@ -97,12 +105,12 @@ struct hash_elem* hash_insert(struct hash* h, struct hash_elem* new) {
 /* Inserts NEW into hash table H, replacing any equal element
    already in the table, which is returned. */
 struct hash_elem* hash_replace(struct hash* h, struct hash_elem* new) {
-  struct list* bucket = find_bucket(h, new);
-  struct hash_elem* old = find_elem(h, bucket, new);
+  unsigned hash = h->hash(new, h->aux);
+  struct hash_elem* old = lookup(h, hash, new);
 
   if (old != NULL)
     remove_elem(h, old);
-  insert_elem(h, bucket, new);
+  insert_elem(h, find_bucket(h->buckets, h->bucket_cnt, hash), new);
 
   rehash(h);
 
@@ -112,7 +120,7 @@ struct hash_elem* hash_replace(struct hash* h, struct hash_elem* new) {
 /* Finds and returns an element equal to E in hash table H, or a
    null pointer if no equal element exists in the table. */
 struct hash_elem* hash_find(struct hash* h, struct hash_elem* e) {
-  return find_elem(h, find_bucket(h, e), e);
+  return lookup(h, h->hash(e, h->aux), e);
 }
 
 /* Finds, removes, and returns an element equal to E in hash
@@ -123,7 +131,7 @@ struct hash_elem* hash_find(struct hash* h, struct hash_elem* e) {
    or own resources that are, then it is the caller's
    responsibility to deallocate them. */
 struct hash_elem* hash_delete(struct hash* h, struct hash_elem* e) {
-  struct hash_elem* found = find_elem(h, find_bucket(h, e), e);
+  struct hash_elem* found = lookup(h, h->hash(e, h->aux), e);
   if (found != NULL) {
     remove_elem(h, found);
     rehash(h);
@@ -138,12 +146,11 @@ struct hash_elem* hash_delete(struct hash* h, struct hash_elem* e) {
    hash_insert(), hash_replace(), or hash_delete(), yields
    undefined behavior, whether done from ACTION or elsewhere. */
 void hash_apply(struct hash* h, hash_action_func* action) {
-  size_t i;
+  struct list* bucket;
 
   ASSERT(action != NULL);
 
-  for (i = 0; i < h->bucket_cnt; i++) {
-    struct list* bucket = &h->buckets[i];
+  for (bucket = next_bucket(h, NULL); bucket != NULL; bucket = next_bucket(h, bucket)) {
     struct list_elem *elem, *next;
 
     for (elem = list_begin(bucket); elem != list_end(bucket); elem = next) {
@@ -175,7 +182,7 @@ void hash_first(struct hash_iterator* i, struct hash* h) {
   ASSERT(h != NULL);
 
   i->hash = h;
-  i->bucket = i->hash->buckets;
+  i->bucket = next_bucket(h, NULL);
   i->elem = list_elem_to_hash_elem(list_head(i->bucket));
 }
 
@@ -192,7 +199,8 @@ struct hash_elem* hash_next(struct hash_iterator* i) {
 
   i->elem = list_elem_to_hash_elem(list_next(&i->elem->list_elem));
   while (i->elem == list_elem_to_hash_elem(list_end(i->bucket))) {
-    if (++i->bucket >= i->hash->buckets + i->hash->bucket_cnt) {
+    i->bucket = next_bucket(i->hash, i->bucket);
+    if (i->bucket == NULL) {
       i->elem = NULL;
       break;
     }
@@ -215,46 +223,95 @@ size_t hash_size(struct hash* h) { return h->elem_cnt; }
 /* Returns true if H contains no elements, false otherwise. */
 bool hash_empty(struct hash* h) { return h->elem_cnt == 0; }
 
-/* Fowler-Noll-Vo hash constants, for 32-bit word sizes. */
-#define FNV_32_PRIME 16777619u
-#define FNV_32_BASIS 2166136261u
+/* The sample hash functions are MurmurHash3, 32-bit version,
+   which hashes 4 bytes per step where Fowler-Noll-Vo took one,
+   and its final mixing step, which is all that hash_int() and
+   hash_ptr() need. */
+#define MURMUR_SEED 0x9747b28cu
+#define MURMUR_C1 0xcc9e2d51u
+#define MURMUR_C2 0x1b873593u
+
+/* A 32-bit word that may be unaligned and may alias anything. */
+typedef uint32_t __attribute__((may_alias, aligned(1))) unaligned_word;
+
+/* Returns X rotated left by R bits. */
+static inline uint32_t rotl32(uint32_t x, int r) { return (x << r) | (x >> (32 - r)); }
+
+/* Returns K scrambled for mixing into a hash. */
+static inline uint32_t murmur_scramble(uint32_t k) {
+  return rotl32(k * MURMUR_C1, 15) * MURMUR_C2;
+}
+
+/* Returns HASH with the 4 bytes in K mixed in. */
+static inline uint32_t murmur_step(uint32_t hash, uint32_t k) {
+  return rotl32(hash ^ murmur_scramble(k), 13) * 5 + 0xe6546b64;
+}
+
+/* Returns HASH with every bit of it mixed into every other. */
+static inline uint32_t murmur_final(uint32_t hash) {
+  hash ^= hash >> 16;
+  hash *= 0x85ebca6b;
+  hash ^= hash >> 13;
+  hash *= 0xc2b2ae35;
+  hash ^= hash >> 16;
+  return hash;
+}
 
 /* Returns a hash of the SIZE bytes in BUF. */
 unsigned hash_bytes(const void* buf_, size_t size) {
-  /* Fowler-Noll-Vo 32-bit hash, for bytes. */
   const unsigned char* buf = buf_;
-  unsigned hash;
+  uint32_t hash = MURMUR_SEED;
+  uint32_t k = 0;
+  size_t i;
 
   ASSERT(buf != NULL);
 
-  hash = FNV_32_BASIS;
-  while (size-- > 0)
-    hash = (hash * FNV_32_PRIME) ^ *buf++;
+  for (i = 0; i + 4 <= size; i += 4)
+    hash = murmur_step(hash, *(const unaligned_word*)(buf + i));
+  for (; i < size; i++)
+    k |= (uint32_t)buf[i] << (8 * (i % 4));
+  if (size % 4 != 0)
+    hash ^= murmur_scramble(k);
 
-  return hash;
+  return murmur_final(hash ^ size);
 }
 
-/* Returns a hash of string S. */
+/* Returns a hash of string S, the same as hash_bytes() of its
+   characters, without a separate pass to find its length. */
 unsigned hash_string(const char* s_) {
   const unsigned char* s = (const unsigned char*)s_;
-  unsigned hash;
+  uint32_t hash = MURMUR_SEED;
+  uint32_t k = 0;
+  size_t len;
 
   ASSERT(s != NULL);
 
-  hash = FNV_32_BASIS;
-  while (*s != '\0')
-    hash = (hash * FNV_32_PRIME) ^ *s++;
+  for (len = 0; s[len] != '\0'; len++) {
+    k |= (uint32_t)s[len] << (8 * (len % 4));
+    if (len % 4 == 3) {
+      hash = murmur_step(hash, k);
+      k = 0;
+    }
+  }
+  if (len % 4 != 0)
+    hash ^= murmur_scramble(k);
 
-  return hash;
+  return murmur_final(hash ^ len);
 }
 
-/* Returns a hash of integer I. */
-unsigned hash_int(int i) { return hash_bytes(&i, sizeof i); }
+/* Returns a hash of integer I.  Distinct integers have distinct
+   hashes. */
+unsigned hash_int(int i) { return murmur_final(i); }
+
+/* Returns a hash of pointer P, such as a page address, whose low
+   bits may all be zero.  Distinct pointers have distinct
+   hashes. */
+unsigned hash_ptr(const void* p) { return murmur_final((uintptr_t)p); }
 
-/* Returns the bucket in H that E belongs in. */
-static struct list* find_bucket(struct hash* h, struct hash_elem* e) {
-  size_t bucket_idx = h->hash(e, h->aux) & (h->bucket_cnt - 1);
-  return &h->buckets[bucket_idx];
+/* Returns the bucket among the BUCKET_CNT BUCKETS that an
+   element with hash value HASH belongs in. */
+static struct list* find_bucket(struct list* buckets, size_t bucket_cnt, unsigned hash) {
+  return &buckets[hash & (bucket_cnt - 1)];
 }
 
 /* Searches BUCKET in H for a hash element equal to E.  Returns
@@ -270,48 +327,69 @@ static struct hash_elem* find_elem(struct hash* h, struct list* bucket, struct h
   return NULL;
 }
 
+/* Returns the element equal to E, whose hash value is HASH, in
+   H's new or old buckets, or a null pointer if there is none. */
+static struct hash_elem* lookup(struct hash* h, unsigned hash, struct hash_elem* e) {
+  struct hash_elem* found = find_elem(h, find_bucket(h->buckets, h->bucket_cnt, hash), e);
+
+  if (found == NULL && h->old_buckets != NULL)
+    found = find_elem(h, find_bucket(h->old_buckets, h->old_bucket_cnt, hash), e);
+  return found;
+}
+
 /* Returns X with its lowest-order bit set to 1 turned off. */
 static inline size_t turn_off_least_1bit(size_t x) { return x & (x - 1); }
 
 /* Returns true if X is a power of 2, otherwise false. */
 static inline size_t is_power_of_2(size_t x) { return x != 0 && turn_off_least_1bit(x) == 0; }
 
-/* Element per bucket ratios. */
-#define MIN_ELEMS_PER_BUCKET 1  /* Elems/bucket < 1: reduce # of buckets. */
-#define BEST_ELEMS_PER_BUCKET 2 /* Ideal elems/bucket. */
-#define MAX_ELEMS_PER_BUCKET 4  /* Elems/bucket > 4: increase # of buckets. */
+/* Ideal elements per bucket (see threads/tunable.c).  A table
+   with fewer than half as many, or more than twice as many, is
+   resized. */
+unsigned hash_elems_per_bucket = 2;
 
-/* Changes the number of buckets in hash table H to match the
-   ideal.  This function can fail because of an out-of-memory
+/* Old buckets emptied into the new ones per insertion or
+   deletion while the table is resized. */
+#define MOVE_STEP 2
+
+/* Continues resizing hash table H if it is being resized, or
+   starts resizing it if it has too many or too few elements per
+   bucket.  This function can fail because of an out-of-memory
    condition, but that'll just make hash accesses less efficient;
    we can still continue. */
 static void rehash(struct hash* h) {
-  size_t old_bucket_cnt, new_bucket_cnt;
-  struct list *new_buckets, *old_buckets;
+  size_t new_bucket_cnt;
+  size_t best;
+  struct list* new_buckets;
   size_t i;
 
   ASSERT(h != NULL);
 
-  /* Save old bucket info for later use. */
-  old_buckets = h->buckets;
-  old_bucket_cnt = h->bucket_cnt;
+  if (h->old_buckets != NULL) {
+    move_buckets(h);
+    return;
+  }
+  best = hash_elems_per_bucket;
+  if (h->elem_cnt <= h->bucket_cnt * best * 2
+      && (h->elem_cnt >= h->bucket_cnt * DIV_ROUND_UP(best, 2) || h->bucket_cnt == 4))
+    return;
 
   /* Calculate the number of buckets to use now.
-     We want one bucket for about every BEST_ELEMS_PER_BUCKET.
+     We want one bucket for about every BEST elements.
      We must have at least four buckets, and the number of
      buckets must be a power of 2. */
-  new_bucket_cnt = h->elem_cnt / BEST_ELEMS_PER_BUCKET;
+  new_bucket_cnt = h->elem_cnt / best;
   if (new_bucket_cnt < 4)
     new_bucket_cnt = 4;
   while (!is_power_of_2(new_bucket_cnt))
     new_bucket_cnt = turn_off_least_1bit(new_bucket_cnt);
 
   /* Don't do anything if the bucket count wouldn't change. */
-  if (new_bucket_cnt == old_bucket_cnt)
+  if (new_bucket_cnt == h->bucket_cnt)
     return;
 
   /* Allocate new buckets and initialize them as empty. */
-  new_buckets = malloc(sizeof *new_buckets * new_bucket_cnt);
+  new_buckets = kvmalloc(sizeof *new_buckets * new_bucket_cnt);
   if (new_buckets == NULL) {
     /* Allocation failed.  This means that use of the hash table will
          be less efficient.  However, it is still usable, so
@@ -321,25 +399,47 @@ static void rehash(struct hash* h) {
   for (i = 0; i < new_bucket_cnt; i++)
     list_init(&new_buckets[i]);
 
-  /* Install new bucket info. */
+  /* Install new bucket info, keeping the old buckets until
+     move_buckets() has emptied them. */
+  h->old_buckets = h->buckets;
+  h->old_bucket_cnt = h->bucket_cnt;
+  h->old_pos = 0;
   h->buckets = new_buckets;
   h->bucket_cnt = new_bucket_cnt;
+  move_buckets(h);
+}
 
-  /* Move each old element into the appropriate new bucket. */
-  for (i = 0; i < old_bucket_cnt; i++) {
-    struct list* old_bucket;
-    struct list_elem *elem, *next;
+/* Moves the elements of the next MOVE_STEP of H's old buckets
+   into the appropriate new buckets, and frees the old buckets
+   once they are all empty. */
+static void move_buckets(struct hash* h) {
+  size_t n;
 
-    old_bucket = &old_buckets[i];
-    for (elem = list_begin(old_bucket); elem != list_end(old_bucket); elem = next) {
-      struct list* new_bucket = find_bucket(h, list_elem_to_hash_elem(elem));
-      next = list_next(elem);
-      list_remove(elem);
-      list_push_front(new_bucket, elem);
+  for (n = 0; n < MOVE_STEP && h->old_buckets != NULL; n++) {
+    struct list* old_bucket = &h->old_buckets[h->old_pos++];
+
+    while (!list_empty(old_bucket)) {
+      struct list_elem* elem = list_pop_front(old_bucket);
+      unsigned hash = h->hash(list_elem_to_hash_elem(elem), h->aux);
+      list_push_front(find_bucket(h->buckets, h->bucket_cnt, hash), elem);
+    }
+    if (h->old_pos == h->old_bucket_cnt) {
+      kvfree(h->old_buckets);
+      h->old_buckets = NULL;
     }
   }
+}
 
-  free(old_buckets);
+/* Returns the bucket of H after BUCKET, going through the old
+   buckets, if any, and then the new ones, or the first bucket if
+   BUCKET is null.  Returns a null pointer after the last. */
+static struct list* next_bucket(struct hash* h, struct list* bucket) {
+  if (bucket == NULL)
+    return h->old_buckets != NULL ? h->old_buckets : h->buckets;
+  if (h->old_buckets != NULL && bucket >= h->old_buckets
+      && bucket < h->old_buckets + h->old_bucket_cnt)
+    return ++bucket < h->old_buckets + h->old_bucket_cnt ? bucket : h->buckets;
+  return ++bucket < h->buckets + h->bucket_cnt ? bucket : NULL;
 }
 
 /* Inserts E into BUCKET (in hash table H). */
@@ -51,14 +51,22 @@ typedef bool hash_less_func(const struct hash_elem* a, const struct hash_elem* b
    data AUX. */
 typedef void hash_action_func(struct hash_elem* e, void* aux);
 
-/* Hash table. */
+/* Hash table.
+
+   When the table is resized, its elements move from the old
+   bucket array to the new one a few buckets at a time, on each
+   later insertion or deletion, instead of all at once.  Until
+   they all have, an element may be in either array. */
 struct hash {
-  size_t elem_cnt;      /* Number of elements in table. */
-  size_t bucket_cnt;    /* Number of buckets, a power of 2. */
-  struct list* buckets; /* Array of `bucket_cnt' lists. */
-  hash_hash_func* hash; /* Hash function. */
-  hash_less_func* less; /* Comparison function. */
-  void* aux;            /* Auxiliary data for `hash' and `less'. */
+  size_t elem_cnt;          /* Number of elements in table. */
+  size_t bucket_cnt;        /* Number of buckets, a power of 2. */
+  struct list* buckets;     /* Array of `bucket_cnt' lists. */
+  size_t old_bucket_cnt;    /* Number of buckets in OLD_BUCKETS. */
+  struct list* old_buckets; /* Buckets being emptied, or null. */
+  size_t old_pos;           /* Next bucket in OLD_BUCKETS to empty. */
+  hash_hash_func* hash;     /* Hash function. */
+  hash_less_func* less;     /* Comparison function. */
+  void* aux;                /* Auxiliary data for `hash' and `less'. */
 };
 
 /* A hash table iterator. */
@@ -93,5 +101,9 @@ bool hash_empty(struct hash*);
 unsigned hash_bytes(const void*, size_t);
 unsigned hash_string(const char*);
 unsigned hash_int(int);
+unsigned hash_ptr(const void*);
+
+/* Ideal elements per bucket (see hash.c). */
+extern unsigned hash_elems_per_bucket;
 
 #endif /* lib/kernel/hash.h */
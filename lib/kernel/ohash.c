@@ -0,0 +1,337 @@
+/* Open-addressing hash table.
+
+   See ohash.h for basic information. */
+
+#include "ohash.h"
+#include "../debug.h"
+#include "threads/vmalloc.h"
+
+/* Smallest number of slots. */
+#define MIN_SLOTS 8
+
+/* Slots of the old table moved to the new one per insertion or
+   deletion while the table grows.  The old table is at most 3/4
+   full, so it is emptied long before the new one, twice as big,
+   gets 3/4 full in turn. */
+#define MOVE_STEP 8
+
+/* Stands in the old table for an element that has been moved to
+   the new one or deleted.  Unlike an empty slot, it does not end
+   a probe, so the elements after it can still be found. */
+static struct hash_elem moved;
+#define MOVED (&moved)
+
+static struct ohash_slot* alloc_slots(size_t cnt);
+static struct ohash_slot* probe(struct ohash*, struct ohash_slot*, size_t cnt, unsigned hash,
+                                struct hash_elem*);
+static struct ohash_slot* lookup(struct ohash*, unsigned hash, struct hash_elem*);
+static void put(struct ohash*, unsigned hash, struct hash_elem*);
+static void remove_slot(struct ohash*, struct ohash_slot*);
+static void make_room(struct ohash*);
+static void move_some(struct ohash*);
+static struct ohash_slot* slot_at(struct ohash*, size_t idx);
+
+/* Initializes hash table H to compute hash values using HASH and
+   compare hash elements using LESS, given auxiliary data AUX. */
+bool ohash_init(struct ohash* h, hash_hash_func* hash, hash_less_func* less, void* aux) {
+  h->elem_cnt = 0;
+  h->slot_cnt = MIN_SLOTS;
+  h->slots = alloc_slots(h->slot_cnt);
+  h->old_slot_cnt = 0;
+  h->old_slots = NULL;
+  h->old_pos = 0;
+  h->hash = hash;
+  h->less = less;
+  h->aux = aux;
+  return h->slots != NULL;
+}
+
+/* Removes all the elements from H.
+
+   If DESTRUCTOR is non-null, then it is called for each element
+   in the hash.  DESTRUCTOR may, if appropriate, deallocate the
+   memory used by the hash element.  However, modifying hash
+   table H while ohash_clear() is running, using any of the
+   functions ohash_clear(), ohash_destroy(), ohash_insert(),
+   ohash_replace(), or ohash_delete(), yields undefined behavior,
+   whether done in DESTRUCTOR or elsewhere. */
+void ohash_clear(struct ohash* h, hash_action_func* destructor) {
+  size_t i;
+
+  if (destructor != NULL)
+    ohash_apply(h, destructor);
+  for (i = 0; i < h->slot_cnt; i++)
+    h->slots[i].elem = NULL;
+  kvfree(h->old_slots);
+  h->old_slots = NULL;
+  h->elem_cnt = 0;
+}
+
+/* Destroys hash table H.
+
+   If DESTRUCTOR is non-null, then it is first called for each
+   element in the hash, as in ohash_clear(). */
+void ohash_destroy(struct ohash* h, hash_action_func* destructor) {
+  ohash_clear(h, destructor);
+  kvfree(h->slots);
+}
+
+/* Inserts NEW into hash table H and returns a null pointer, if
+   no equal element is already in the table.
+   If an equal element is already in the table, returns it
+   without inserting NEW. */
+struct hash_elem* ohash_insert(struct ohash* h, struct hash_elem* new) {
+  unsigned hash = h->hash(new, h->aux);
+  struct ohash_slot* old = lookup(h, hash, new);
+
+  if (old != NULL)
+    return old->elem;
+  make_room(h);
+  put(h, hash, new);
+  h->elem_cnt++;
+  return NULL;
+}
+
+/* Inserts NEW into hash table H, replacing any equal element
+   already in the table, which is returned. */
+struct hash_elem* ohash_replace(struct ohash* h, struct hash_elem* new) {
+  unsigned hash = h->hash(new, h->aux);
+  struct ohash_slot* old = lookup(h, hash, new);
+  struct hash_elem* old_elem;
+
+  if (old == NULL)
+    return ohash_insert(h, new);
+  old_elem = old->elem;
+  old->elem = new;
+  return old_elem;
+}
+
+/* Finds and returns an element equal to E in hash table H, or a
+   null pointer if no equal element exists in the table. */
+struct hash_elem* ohash_find(struct ohash* h, struct hash_elem* e) {
+  struct ohash_slot* s = lookup(h, h->hash(e, h->aux), e);
+  return s != NULL ? s->elem : NULL;
+}
+
+/* Finds, removes, and returns an element equal to E in hash
+   table H.  Returns a null pointer if no equal element existed
+   in the table.
+
+   If the elements of the hash table are dynamically allocated,
+   or own resources that are, then it is the caller's
+   responsibility to deallocate them. */
+struct hash_elem* ohash_delete(struct ohash* h, struct hash_elem* e) {
+  unsigned hash = h->hash(e, h->aux);
+  struct ohash_slot* s = probe(h, h->slots, h->slot_cnt, hash, e);
+  struct hash_elem* found = NULL;
+
+  if (s != NULL) {
+    found = s->elem;
+    remove_slot(h, s);
+  } else if (h->old_slots != NULL) {
+    s = probe(h, h->old_slots, h->old_slot_cnt, hash, e);
+    if (s != NULL) {
+      found = s->elem;
+      s->elem = MOVED;
+    }
+  }
+  if (found != NULL) {
+    h->elem_cnt--;
+    move_some(h);
+  }
+  return found;
+}
+
+/* Calls ACTION for each element in hash table H in arbitrary
+   order.
+   Modifying hash table H while ohash_apply() is running, using
+   any of the functions ohash_clear(), ohash_destroy(),
+   ohash_insert(), ohash_replace(), or ohash_delete(), yields
+   undefined behavior, whether done from ACTION or elsewhere. */
+void ohash_apply(struct ohash* h, hash_action_func* action) {
+  struct ohash_iterator i;
+
+  ASSERT(action != NULL);
+
+  ohash_first(&i, h);
+  while (ohash_next(&i))
+    action(ohash_cur(&i), h->aux);
+}
+
+/* Initializes I for iterating hash table H.
+
+   Iteration idiom:
+
+      struct ohash_iterator i;
+
+      ohash_first (&i, h);
+      while (ohash_next (&i))
+        {
+          struct foo *f = hash_entry (ohash_cur (&i), struct foo, elem);
+          ...do something with f...
+        }
+
+   Modifying hash table H during iteration, using any of the
+   functions ohash_clear(), ohash_destroy(), ohash_insert(),
+   ohash_replace(), or ohash_delete(), invalidates all
+   iterators. */
+void ohash_first(struct ohash_iterator* i, struct ohash* h) {
+  ASSERT(i != NULL);
+  ASSERT(h != NULL);
+
+  i->hash = h;
+  i->idx = 0;
+  i->elem = NULL;
+}
+
+/* Advances I to the next element in the hash table and returns
+   it.  Returns a null pointer if no elements are left.  Elements
+   are returned in arbitrary order. */
+struct hash_elem* ohash_next(struct ohash_iterator* i) {
+  struct ohash_slot* s;
+
+  ASSERT(i != NULL);
+
+  while ((s = slot_at(i->hash, i->idx)) != NULL) {
+    i->idx++;
+    if (s->elem != NULL && s->elem != MOVED)
+      return i->elem = s->elem;
+  }
+  return i->elem = NULL;
+}
+
+/* Returns the current element in the hash table iteration, or a
+   null pointer at the end of the table.  Undefined behavior
+   after calling ohash_first() but before ohash_next(). */
+struct hash_elem* ohash_cur(struct ohash_iterator* i) { return i->elem; }
+
+/* Returns the number of elements in H. */
+size_t ohash_size(struct ohash* h) { return h->elem_cnt; }
+
+/* Returns true if H contains no elements, false otherwise. */
+bool ohash_empty(struct ohash* h) { return h->elem_cnt == 0; }
+
+/* Returns an array of CNT empty slots, or a null pointer if
+   memory is short. */
+static struct ohash_slot* alloc_slots(size_t cnt) {
+  struct ohash_slot* slots = kvmalloc(sizeof *slots * cnt);
+  size_t i;
+
+  if (slots != NULL)
+    for (i = 0; i < cnt; i++)
+      slots[i].elem = NULL;
+  return slots;
+}
+
+/* Searches the CNT SLOTS, in H, for an element equal to E, whose
+   hash value is HASH.  Returns its slot if found or a null
+   pointer otherwise. */
+static struct ohash_slot* probe(struct ohash* h, struct ohash_slot* slots, size_t cnt,
+                                unsigned hash, struct hash_elem* e) {
+  size_t i;
+
+  for (i = hash & (cnt - 1); slots[i].elem != NULL; i = (i + 1) & (cnt - 1)) {
+    struct ohash_slot* s = &slots[i];
+    if (s->hash == hash && s->elem != MOVED && !h->less(s->elem, e, h->aux)
+        && !h->less(e, s->elem, h->aux))
+      return s;
+  }
+  return NULL;
+}
+
+/* Returns the slot of the element equal to E, whose hash value is
+   HASH, in either of H's tables, or a null pointer if there is
+   none. */
+static struct ohash_slot* lookup(struct ohash* h, unsigned hash, struct hash_elem* e) {
+  struct ohash_slot* s = probe(h, h->slots, h->slot_cnt, hash, e);
+
+  if (s == NULL && h->old_slots != NULL)
+    s = probe(h, h->old_slots, h->old_slot_cnt, hash, e);
+  return s;
+}
+
+/* Puts E, whose hash value is HASH, into the first empty slot at
+   or after its home slot in H's new table.  E must not be in H
+   already. */
+static void put(struct ohash* h, unsigned hash, struct hash_elem* e) {
+  size_t i;
+
+  for (i = hash & (h->slot_cnt - 1); h->slots[i].elem != NULL; i = (i + 1) & (h->slot_cnt - 1))
+    continue;
+  h->slots[i].hash = hash;
+  h->slots[i].elem = e;
+}
+
+/* Empties slot S of H's new table.  Each later element in the
+   same run of full slots that would no longer be found past the
+   hole is moved back into it, so that no tombstone is needed. */
+static void remove_slot(struct ohash* h, struct ohash_slot* s) {
+  size_t mask = h->slot_cnt - 1;
+  size_t hole = s - h->slots;
+  size_t i;
+
+  for (i = (hole + 1) & mask; h->slots[i].elem != NULL; i = (i + 1) & mask) {
+    size_t home = h->slots[i].hash & mask;
+
+    /* Move the element back unless its home slot lies after the
+       hole, cyclically, up to where it is now. */
+    if (((i - home) & mask) >= ((i - hole) & mask)) {
+      h->slots[hole] = h->slots[i];
+      hole = i;
+    }
+  }
+  h->slots[hole].elem = NULL;
+}
+
+/* Makes sure H's new table has room for one more element,
+   starting to grow it into one twice the size if it is 3/4
+   full.  If memory is too short to grow, the table just gets
+   fuller, until it cannot take another element. */
+static void make_room(struct ohash* h) {
+  move_some(h);
+  if (h->old_slots == NULL && (h->elem_cnt + 1) * 4 > h->slot_cnt * 3) {
+    struct ohash_slot* slots = alloc_slots(h->slot_cnt * 2);
+
+    if (slots != NULL) {
+      h->old_slots = h->slots;
+      h->old_slot_cnt = h->slot_cnt;
+      h->old_pos = 0;
+      h->slots = slots;
+      h->slot_cnt *= 2;
+      move_some(h);
+    } else if (h->elem_cnt + 1 >= h->slot_cnt)
+      PANIC("ohash: out of memory");
+  }
+}
+
+/* Moves the elements in the next MOVE_STEP slots of H's old
+   table, if it has one, to the new table, and frees the old
+   table once it is empty. */
+static void move_some(struct ohash* h) {
+  size_t n;
+
+  for (n = 0; h->old_slots != NULL && n < MOVE_STEP; n++) {
+    struct ohash_slot* s = &h->old_slots[h->old_pos++];
+
+    if (s->elem != NULL && s->elem != MOVED) {
+      put(h, s->hash, s->elem);
+      s->elem = MOVED;
+    }
+    if (h->old_pos == h->old_slot_cnt) {
+      kvfree(h->old_slots);
+      h->old_slots = NULL;
+    }
+  }
+}
+
+/* Returns slot IDX of H, counting the slots of the old table,
+   if any, before those of the new, or a null pointer if IDX is
+   past the last slot. */
+static struct ohash_slot* slot_at(struct ohash* h, size_t idx) {
+  if (h->old_slots != NULL) {
+    if (idx < h->old_slot_cnt)
+      return &h->old_slots[idx];
+    idx -= h->old_slot_cnt;
+  }
+  return idx < h->slot_cnt ? &h->slots[idx] : NULL;
+}
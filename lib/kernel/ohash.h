@@ -0,0 +1,79 @@
+#ifndef __LIB_KERNEL_OHASH_H
+#define __LIB_KERNEL_OHASH_H
+
+/* Open-addressing hash table.
+
+   A drop-in alternative to the chained hash table in hash.h,
+   with the same elements, hash functions and comparison
+   functions: each ohash_*() function does what the hash_*()
+   function of the same name does.  Code can switch from one to
+   the other by changing the type of the table and the prefix of
+   the calls.
+
+   Instead of an array of lists, the table is a single array of
+   slots, each holding an element's hash value and a pointer to
+   the element, searched by linear probing.  A lookup reads
+   consecutive slots and compares whole hash values before
+   calling the comparison function, so it usually touches one
+   cache line of the table and only the element it is looking
+   for, where a chained lookup follows a list pointer into every
+   element of its bucket.
+
+   When the table gets 3/4 full, a table twice the size is
+   allocated, and the elements move over a few slots at a time
+   on each later insertion or deletion, rather than all at once,
+   so no single call pays for moving the whole table.  The table
+   does not shrink. */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "hash.h"
+
+/* A slot in an open-addressing hash table. */
+struct ohash_slot {
+  unsigned hash;          /* Hash value of ELEM. */
+  struct hash_elem* elem; /* Element, or a null pointer if empty. */
+};
+
+/* Open-addressing hash table. */
+struct ohash {
+  size_t elem_cnt;              /* Number of elements in table. */
+  size_t slot_cnt;              /* Number of slots, a power of 2. */
+  struct ohash_slot* slots;     /* Array of `slot_cnt' slots. */
+  size_t old_slot_cnt;          /* Number of slots in OLD_SLOTS. */
+  struct ohash_slot* old_slots; /* Slots being moved out, or null. */
+  size_t old_pos;               /* Next slot in OLD_SLOTS to move. */
+  hash_hash_func* hash;         /* Hash function. */
+  hash_less_func* less;         /* Comparison function. */
+  void* aux;                    /* Auxiliary data for `hash' and `less'. */
+};
+
+/* An open-addressing hash table iterator. */
+struct ohash_iterator {
+  struct ohash* hash;     /* The hash table. */
+  size_t idx;             /* Next slot to look at, old table first. */
+  struct hash_elem* elem; /* Current hash element. */
+};
+
+/* Basic life cycle. */
+bool ohash_init(struct ohash*, hash_hash_func*, hash_less_func*, void* aux);
+void ohash_clear(struct ohash*, hash_action_func*);
+void ohash_destroy(struct ohash*, hash_action_func*);
+
+/* Search, insertion, deletion. */
+struct hash_elem* ohash_insert(struct ohash*, struct hash_elem*);
+struct hash_elem* ohash_replace(struct ohash*, struct hash_elem*);
+struct hash_elem* ohash_find(struct ohash*, struct hash_elem*);
+struct hash_elem* ohash_delete(struct ohash*, struct hash_elem*);
+
+/* Iteration. */
+void ohash_apply(struct ohash*, hash_action_func*);
+void ohash_first(struct ohash_iterator*, struct ohash*);
+struct hash_elem* ohash_next(struct ohash_iterator*);
+struct hash_elem* ohash_cur(struct ohash_iterator*);
+
+/* Information. */
+size_t ohash_size(struct ohash*);
+bool ohash_empty(struct ohash*);
+
+#endif /* lib/kernel/ohash.h */
@@ -0,0 +1,151 @@
+#include "pqueue.h"
+#include "../debug.h"
+
+/* A pairing heap is a tree in which no element is less than its
+   parent, so the root is the front.  Each element points to its
+   first child; the children of an element are a doubly linked
+   list through `next' and `prev', except that the first child's
+   `prev' points to the parent instead, so that any element can
+   be cut out of the tree in constant time.
+
+   Two trees are joined by making the root that is not less the
+   first child of the other.  Removing the root leaves its
+   children, which are joined in two passes: first in pairs from
+   left to right, then the pairs from right to left. */
+
+static struct pqueue_elem* join(struct pqueue*, struct pqueue_elem*, struct pqueue_elem*);
+static struct pqueue_elem* join_children(struct pqueue*, struct pqueue_elem*);
+static void cut(struct pqueue_elem*);
+
+/* Initializes Q as an empty priority queue ordered by LESS,
+   given auxiliary data AUX. */
+void pqueue_init(struct pqueue* q, pqueue_less_func* less, void* aux) {
+  ASSERT(q != NULL);
+  ASSERT(less != NULL);
+
+  q->root = NULL;
+  q->less = less;
+  q->aux = aux;
+}
+
+/* Returns true if Q is empty, false otherwise. */
+bool pqueue_empty(struct pqueue* q) { return q->root == NULL; }
+
+/* Returns the front element of Q, one that no other element is
+   less than.  Undefined behavior if Q is empty. */
+struct pqueue_elem* pqueue_front(struct pqueue* q) {
+  ASSERT(!pqueue_empty(q));
+  return q->root;
+}
+
+/* Inserts E into Q. */
+void pqueue_push(struct pqueue* q, struct pqueue_elem* e) {
+  ASSERT(e != NULL);
+
+  e->child = e->next = e->prev = NULL;
+  q->root = q->root != NULL ? join(q, q->root, e) : e;
+}
+
+/* Removes the front element of Q and returns it.  Undefined
+   behavior if Q is empty. */
+struct pqueue_elem* pqueue_pop_front(struct pqueue* q) {
+  struct pqueue_elem* front = pqueue_front(q);
+
+  q->root = join_children(q, front->child);
+  return front;
+}
+
+/* Removes E, which must be in Q, from Q. */
+void pqueue_remove(struct pqueue* q, struct pqueue_elem* e) {
+  struct pqueue_elem* rest;
+
+  ASSERT(e != NULL);
+
+  if (e == q->root) {
+    pqueue_pop_front(q);
+    return;
+  }
+  cut(e);
+  rest = join_children(q, e->child);
+  if (rest != NULL)
+    q->root = join(q, q->root, rest);
+}
+
+/* Restores the order of Q after the value of E, which is in Q,
+   has changed so that it is now less than before (or equal).  To
+   make it greater instead, pqueue_remove() and pqueue_push() E
+   again. */
+void pqueue_promote(struct pqueue* q, struct pqueue_elem* e) {
+  ASSERT(e != NULL);
+
+  if (e == q->root)
+    return;
+  cut(e);
+  q->root = join(q, q->root, e);
+}
+
+/* Joins the trees rooted at A and B and returns the root of the
+   result, whose `next' and `prev' are null. */
+static struct pqueue_elem* join(struct pqueue* q, struct pqueue_elem* a, struct pqueue_elem* b) {
+  if (q->less(b, a, q->aux)) {
+    struct pqueue_elem* tmp = a;
+    a = b;
+    b = tmp;
+  }
+
+  b->prev = a;
+  b->next = a->child;
+  if (a->child != NULL)
+    a->child->prev = b;
+  a->child = b;
+  a->next = a->prev = NULL;
+  return a;
+}
+
+/* Joins FIRST and the siblings after it into one tree and returns
+   its root, or a null pointer if FIRST is null.  Runs in constant
+   stack space, so that it is safe in interrupt handlers. */
+static struct pqueue_elem* join_children(struct pqueue* q, struct pqueue_elem* first) {
+  struct pqueue_elem* pairs = NULL;
+  struct pqueue_elem* root = NULL;
+
+  /* Join the children in pairs, stacking the results on PAIRS,
+     linked through `next'. */
+  while (first != NULL) {
+    struct pqueue_elem* a = first;
+    struct pqueue_elem* b = a->next;
+
+    if (b != NULL) {
+      first = b->next;
+      a = join(q, a, b);
+    } else
+      first = NULL;
+    a->next = pairs;
+    pairs = a;
+  }
+
+  /* Join the pairs, last to first. */
+  while (pairs != NULL) {
+    struct pqueue_elem* next = pairs->next;
+
+    if (root != NULL)
+      root = join(q, root, pairs);
+    else {
+      root = pairs;
+      root->next = root->prev = NULL;
+    }
+    pairs = next;
+  }
+  return root;
+}
+
+/* Cuts E, which is not the root, and its children out of the
+   tree that contains it. */
+static void cut(struct pqueue_elem* e) {
+  if (e->prev->child == e)
+    e->prev->child = e->next;
+  else
+    e->prev->next = e->next;
+  if (e->next != NULL)
+    e->next->prev = e->prev;
+}
@@ -0,0 +1,64 @@
+#ifndef __LIB_KERNEL_PQUEUE_H
+#define __LIB_KERNEL_PQUEUE_H
+
+/* Priority queue.
+
+   A pairing heap, which like our lists does not require use of
+   dynamically allocated memory: each structure that can be in a
+   priority queue embeds a struct pqueue_elem member, and the
+   pqueue_entry macro converts from a struct pqueue_elem back to
+   the structure that contains it.
+
+   The queue is ordered by a comparison function given to
+   pqueue_init().  The element at the "front" is one that no
+   other element is less than; so a comparison function that
+   puts higher priorities first makes a max-heap.
+
+   pqueue_push() and pqueue_promote() take constant time, and
+   pqueue_pop_front() and pqueue_remove() take O(log n) amortized
+   time, where keeping a list sorted with list_insert_ordered()
+   takes O(n) per insertion.  pqueue_front() takes constant
+   time.  Nothing here sleeps or allocates, so priority queues
+   can be used with interrupts off and in interrupt handlers. */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Priority queue element. */
+struct pqueue_elem {
+  struct pqueue_elem* child; /* First child. */
+  struct pqueue_elem* next;  /* Next sibling. */
+  struct pqueue_elem* prev;  /* Previous sibling, or parent if first child. */
+};
+
+/* Converts pointer to priority queue element PQUEUE_ELEM into a
+   pointer to the structure that PQUEUE_ELEM is embedded inside.
+   Supply the name of the outer structure STRUCT and the member
+   name MEMBER of the priority queue element. */
+#define pqueue_entry(PQUEUE_ELEM, STRUCT, MEMBER)                                                  \
+  ((STRUCT*)((uint8_t*)&(PQUEUE_ELEM)->next - offsetof(STRUCT, MEMBER.next)))
+
+/* Compares the value of two priority queue elements A and B,
+   given auxiliary data AUX.  Returns true if A belongs nearer
+   the front than B, or false if A is not less than B. */
+typedef bool pqueue_less_func(const struct pqueue_elem* a, const struct pqueue_elem* b,
+                              void* aux);
+
+/* Priority queue. */
+struct pqueue {
+  struct pqueue_elem* root; /* Front element, or null if empty. */
+  pqueue_less_func* less;   /* Comparison function. */
+  void* aux;                /* Auxiliary data for `less'. */
+};
+
+void pqueue_init(struct pqueue*, pqueue_less_func*, void* aux);
+bool pqueue_empty(struct pqueue*);
+struct pqueue_elem* pqueue_front(struct pqueue*);
+
+void pqueue_push(struct pqueue*, struct pqueue_elem*);
+struct pqueue_elem* pqueue_pop_front(struct pqueue*);
+void pqueue_remove(struct pqueue*, struct pqueue_elem*);
+void pqueue_promote(struct pqueue*, struct pqueue_elem*);
+
+#endif /* lib/kernel/pqueue.h */
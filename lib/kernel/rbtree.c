@@ -0,0 +1,382 @@
+/* Red-black tree.
+
+   See rbtree.h for basic information.
+
+   Every element is red or black, the root is black, a red
+   element has no red children, and every path from an element
+   down to a missing child passes the same number of black
+   elements.  So no path from the root is more than twice as long
+   as any other, and the tree's height is O(log n).  Insertion
+   and deletion restore these rules by recoloring and by at most
+   three rotations.  The algorithms follow Cormen, Leiserson,
+   Rivest and Stein, "Introduction to Algorithms", chapter 13,
+   with null pointers for the missing children. */
+
+#include "rbtree.h"
+#include "../debug.h"
+
+static bool is_red(const struct rb_elem*);
+static void replace_child(struct rb_tree*, struct rb_elem* parent, struct rb_elem* old,
+                          struct rb_elem* new);
+static void rotate_left(struct rb_tree*, struct rb_elem*);
+static void rotate_right(struct rb_tree*, struct rb_elem*);
+static void insert_fixup(struct rb_tree*, struct rb_elem*);
+static void erase_fixup(struct rb_tree*, struct rb_elem*, struct rb_elem* parent);
+
+/* Initializes T as an empty tree that orders elements using
+   LESS, given auxiliary data AUX. */
+void rb_init(struct rb_tree* t, rb_less_func* less, void* aux) {
+  ASSERT(t != NULL);
+  ASSERT(less != NULL);
+
+  t->root = NULL;
+  t->elem_cnt = 0;
+  t->less = less;
+  t->aux = aux;
+}
+
+/* Inserts NEW into tree T and returns a null pointer, if no
+   equal element is already in the tree.
+   If an equal element is already in the tree, returns it
+   without inserting NEW. */
+struct rb_elem* rb_insert(struct rb_tree* t, struct rb_elem* new) {
+  struct rb_elem* parent = NULL;
+  struct rb_elem** link = &t->root;
+
+  ASSERT(new != NULL);
+
+  while (*link != NULL) {
+    parent = *link;
+    if (t->less(new, parent, t->aux))
+      link = &parent->left;
+    else if (t->less(parent, new, t->aux))
+      link = &parent->right;
+    else
+      return parent;
+  }
+
+  new->parent = parent;
+  new->left = new->right = NULL;
+  new->red = true;
+  *link = new;
+  t->elem_cnt++;
+  insert_fixup(t, new);
+  return NULL;
+}
+
+/* Removes E, which must be in tree T, from T.
+
+   If the elements of the tree are dynamically allocated, or own
+   resources that are, then it is the caller's responsibility to
+   deallocate them. */
+void rb_erase(struct rb_tree* t, struct rb_elem* e) {
+  struct rb_elem* child;  /* Takes the place of what was removed. */
+  struct rb_elem* parent; /* Parent of CHILD, even if it is null. */
+  bool removed_red;       /* Color of the element taken out. */
+
+  ASSERT(e != NULL);
+
+  if (e->left == NULL || e->right == NULL) {
+    /* E has at most one child, which takes its place. */
+    child = e->left != NULL ? e->left : e->right;
+    parent = e->parent;
+    removed_red = e->red;
+    if (child != NULL)
+      child->parent = parent;
+    replace_child(t, parent, e, child);
+  } else {
+    /* E has two children.  Its successor, which has no left
+       child, takes its place and color, and the successor's
+       right child takes the successor's place. */
+    struct rb_elem* next = e->right;
+
+    while (next->left != NULL)
+      next = next->left;
+    removed_red = next->red;
+    child = next->right;
+    if (next->parent == e)
+      parent = next;
+    else {
+      parent = next->parent;
+      parent->left = child;
+      if (child != NULL)
+        child->parent = parent;
+      next->right = e->right;
+      next->right->parent = next;
+    }
+    next->left = e->left;
+    next->left->parent = next;
+    next->parent = e->parent;
+    next->red = e->red;
+    replace_child(t, e->parent, e, next);
+  }
+
+  t->elem_cnt--;
+  if (!removed_red)
+    erase_fixup(t, child, parent);
+}
+
+/* Finds and returns an element equal to E in tree T, or a null
+   pointer if no equal element exists in the tree. */
+struct rb_elem* rb_find(struct rb_tree* t, const struct rb_elem* e) {
+  struct rb_elem* i = t->root;
+
+  while (i != NULL) {
+    if (t->less(e, i, t->aux))
+      i = i->left;
+    else if (t->less(i, e, t->aux))
+      i = i->right;
+    else
+      return i;
+  }
+  return NULL;
+}
+
+/* Returns the first element in tree T that is not less than E,
+   or a null pointer if there is none. */
+struct rb_elem* rb_lower_bound(struct rb_tree* t, const struct rb_elem* e) {
+  struct rb_elem* i = t->root;
+  struct rb_elem* bound = NULL;
+
+  while (i != NULL)
+    if (t->less(i, e, t->aux))
+      i = i->right;
+    else {
+      bound = i;
+      i = i->left;
+    }
+  return bound;
+}
+
+/* Returns the first element in tree T that E is less than, or a
+   null pointer if there is none. */
+struct rb_elem* rb_upper_bound(struct rb_tree* t, const struct rb_elem* e) {
+  struct rb_elem* i = t->root;
+  struct rb_elem* bound = NULL;
+
+  while (i != NULL)
+    if (t->less(e, i, t->aux)) {
+      bound = i;
+      i = i->left;
+    } else
+      i = i->right;
+  return bound;
+}
+
+/* Returns the least element in tree T, or a null pointer if T is
+   empty. */
+struct rb_elem* rb_first(struct rb_tree* t) {
+  struct rb_elem* e = t->root;
+
+  if (e != NULL)
+    while (e->left != NULL)
+      e = e->left;
+  return e;
+}
+
+/* Returns the greatest element in tree T, or a null pointer if T
+   is empty. */
+struct rb_elem* rb_last(struct rb_tree* t) {
+  struct rb_elem* e = t->root;
+
+  if (e != NULL)
+    while (e->right != NULL)
+      e = e->right;
+  return e;
+}
+
+/* Returns the element after E in its tree, or a null pointer if
+   E is the greatest.
+
+   Inserting into or erasing from the tree other than E itself
+   leaves E a valid place to continue from; to erase the elements
+   of a tree as it is traversed, get the next element before
+   erasing the current one. */
+struct rb_elem* rb_next(struct rb_elem* e) {
+  ASSERT(e != NULL);
+
+  if (e->right != NULL) {
+    e = e->right;
+    while (e->left != NULL)
+      e = e->left;
+    return e;
+  }
+  while (e->parent != NULL && e == e->parent->right)
+    e = e->parent;
+  return e->parent;
+}
+
+/* Returns the element before E in its tree, or a null pointer if
+   E is the least. */
+struct rb_elem* rb_prev(struct rb_elem* e) {
+  ASSERT(e != NULL);
+
+  if (e->left != NULL) {
+    e = e->left;
+    while (e->right != NULL)
+      e = e->right;
+    return e;
+  }
+  while (e->parent != NULL && e == e->parent->left)
+    e = e->parent;
+  return e->parent;
+}
+
+/* Returns the number of elements in T. */
+size_t rb_size(struct rb_tree* t) { return t->elem_cnt; }
+
+/* Returns true if T contains no elements, false otherwise. */
+bool rb_empty(struct rb_tree* t) { return t->elem_cnt == 0; }
+
+/* Returns true if E is red.  Missing children are black. */
+static bool is_red(const struct rb_elem* e) { return e != NULL && e->red; }
+
+/* Makes NEW take the place of OLD as a child of PARENT, or as the
+   root of T if PARENT is null. */
+static void replace_child(struct rb_tree* t, struct rb_elem* parent, struct rb_elem* old,
+                          struct rb_elem* new) {
+  if (parent == NULL)
+    t->root = new;
+  else if (parent->left == old)
+    parent->left = new;
+  else
+    parent->right = new;
+}
+
+/* Rotates E's right child up into E's place, making E its left
+   child. */
+static void rotate_left(struct rb_tree* t, struct rb_elem* e) {
+  struct rb_elem* up = e->right;
+
+  e->right = up->left;
+  if (up->left != NULL)
+    up->left->parent = e;
+  up->parent = e->parent;
+  replace_child(t, e->parent, e, up);
+  up->left = e;
+  e->parent = up;
+}
+
+/* Rotates E's left child up into E's place, making E its right
+   child. */
+static void rotate_right(struct rb_tree* t, struct rb_elem* e) {
+  struct rb_elem* up = e->left;
+
+  e->left = up->right;
+  if (up->right != NULL)
+    up->right->parent = e;
+  up->parent = e->parent;
+  replace_child(t, e->parent, e, up);
+  up->right = e;
+  e->parent = up;
+}
+
+/* Restores the red-black rules after red element E has been
+   added to tree T. */
+static void insert_fixup(struct rb_tree* t, struct rb_elem* e) {
+  struct rb_elem* parent;
+
+  while (is_red(parent = e->parent)) {
+    /* PARENT is red, so it is not the root. */
+    struct rb_elem* grandparent = parent->parent;
+
+    if (parent == grandparent->left) {
+      struct rb_elem* uncle = grandparent->right;
+
+      if (is_red(uncle)) {
+        parent->red = uncle->red = false;
+        grandparent->red = true;
+        e = grandparent;
+        continue;
+      }
+      if (e == parent->right) {
+        rotate_left(t, parent);
+        parent = e;
+      }
+      parent->red = false;
+      grandparent->red = true;
+      rotate_right(t, grandparent);
+      break;
+    } else {
+      struct rb_elem* uncle = grandparent->left;
+
+      if (is_red(uncle)) {
+        parent->red = uncle->red = false;
+        grandparent->red = true;
+        e = grandparent;
+        continue;
+      }
+      if (e == parent->left) {
+        rotate_right(t, parent);
+        parent = e;
+      }
+      parent->red = false;
+      grandparent->red = true;
+      rotate_left(t, grandparent);
+      break;
+    }
+  }
+  t->root->red = false;
+}
+
+/* Restores the red-black rules in tree T after a black element
+   has been taken out from between PARENT and E, which may be
+   null, leaving the paths through E one black element short. */
+static void erase_fixup(struct rb_tree* t, struct rb_elem* e, struct rb_elem* parent) {
+  while (e != t->root && !is_red(e)) {
+    if (e == parent->left) {
+      struct rb_elem* sibling = parent->right;
+
+      if (sibling->red) {
+        sibling->red = false;
+        parent->red = true;
+        rotate_left(t, parent);
+        sibling = parent->right;
+      }
+      if (!is_red(sibling->left) && !is_red(sibling->right)) {
+        sibling->red = true;
+        e = parent;
+        parent = e->parent;
+        continue;
+      }
+      if (!is_red(sibling->right)) {
+        sibling->left->red = false;
+        sibling->red = true;
+        rotate_right(t, sibling);
+        sibling = parent->right;
+      }
+      sibling->red = parent->red;
+      parent->red = false;
+      sibling->right->red = false;
+      rotate_left(t, parent);
+    } else {
+      struct rb_elem* sibling = parent->left;
+
+      if (sibling->red) {
+        sibling->red = false;
+        parent->red = true;
+        rotate_right(t, parent);
+        sibling = parent->left;
+      }
+      if (!is_red(sibling->left) && !is_red(sibling->right)) {
+        sibling->red = true;
+        e = parent;
+        parent = e->parent;
+        continue;
+      }
+      if (!is_red(sibling->left)) {
+        sibling->right->red = false;
+        sibling->red = true;
+        rotate_left(t, sibling);
+        sibling = parent->left;
+      }
+      sibling->red = parent->red;
+      parent->red = false;
+      sibling->left->red = false;
+      rotate_right(t, parent);
+    }
+    e = t->root;
+  }
+  if (e != NULL)
+    e->red = false;
+}
@@ -0,0 +1,85 @@
+#ifndef __LIB_KERNEL_RBTREE_H
+#define __LIB_KERNEL_RBTREE_H
+
+/* Red-black tree.
+
+   A balanced binary search tree, for indexes that need ordered
+   lookups: the element at or after a key, the elements within a
+   range, or all of them in order.  Insertion, deletion and
+   lookup take O(log n) time, and stepping to the next or
+   previous element takes O(1) amortized time.
+
+   Like lists and hash tables, the tree does not use dynamic
+   allocation.  Each structure that can be in a tree embeds a
+   struct rb_elem member, all of the tree functions operate on
+   these `struct rb_elem's, and the rb_entry macro converts from
+   a struct rb_elem back to the structure that contains it.
+   Refer to lib/kernel/list.h for a detailed explanation.
+
+   For example, to find the region that contains address ADDR in
+   a tree of regions ordered by start address, look up the last
+   region that starts at or before ADDR:
+
+      struct region key;
+      struct rb_elem *e;
+
+      key.start = addr;
+      e = rb_upper_bound (&regions, &key.elem);
+      e = e != NULL ? rb_prev (e) : rb_last (&regions);
+      if (e != NULL && addr < rb_entry (e, struct region, elem)->end)
+        ...ADDR is in that region...
+*/
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Red-black tree element. */
+struct rb_elem {
+  struct rb_elem* parent; /* Parent, or null at the root. */
+  struct rb_elem* left;   /* Left child, or null. */
+  struct rb_elem* right;  /* Right child, or null. */
+  bool red;               /* Red or black? */
+};
+
+/* Converts pointer to tree element RB_ELEM into a pointer to the
+   structure that RB_ELEM is embedded inside.  Supply the name of
+   the outer structure STRUCT and the member name MEMBER of the
+   tree element. */
+#define rb_entry(RB_ELEM, STRUCT, MEMBER)                                                          \
+  ((STRUCT*)((uint8_t*)&(RB_ELEM)->parent - offsetof(STRUCT, MEMBER.parent)))
+
+/* Compares the value of two tree elements A and B, given
+   auxiliary data AUX.  Returns true if A is less than B, or
+   false if A is greater than or equal to B. */
+typedef bool rb_less_func(const struct rb_elem* a, const struct rb_elem* b, void* aux);
+
+/* Red-black tree. */
+struct rb_tree {
+  struct rb_elem* root; /* Root, or null if empty. */
+  size_t elem_cnt;      /* Number of elements in tree. */
+  rb_less_func* less;   /* Comparison function. */
+  void* aux;            /* Auxiliary data for `less'. */
+};
+
+/* Basic life cycle. */
+void rb_init(struct rb_tree*, rb_less_func*, void* aux);
+
+/* Search, insertion, deletion. */
+struct rb_elem* rb_insert(struct rb_tree*, struct rb_elem*);
+void rb_erase(struct rb_tree*, struct rb_elem*);
+struct rb_elem* rb_find(struct rb_tree*, const struct rb_elem*);
+struct rb_elem* rb_lower_bound(struct rb_tree*, const struct rb_elem*);
+struct rb_elem* rb_upper_bound(struct rb_tree*, const struct rb_elem*);
+
+/* Traversal. */
+struct rb_elem* rb_first(struct rb_tree*);
+struct rb_elem* rb_last(struct rb_tree*);
+struct rb_elem* rb_next(struct rb_elem*);
+struct rb_elem* rb_prev(struct rb_elem*);
+
+/* Information. */
+size_t rb_size(struct rb_tree*);
+bool rb_empty(struct rb_tree*);
+
+#endif /* lib/kernel/rbtree.h */
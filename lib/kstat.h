@@ -0,0 +1,21 @@
+#ifndef __LIB_KSTAT_H
+#define __LIB_KSTAT_H
+
+/* Longest name of a kernel statistic, not counting the null
+   terminator.  Names are dotted paths such as "vm.evictions". */
+#define KSTAT_NAME_MAX 31
+
+/* Kinds of statistic. */
+enum kstat_type {
+  KSTAT_COUNTER, /* Counts events; only ever goes up. */
+  KSTAT_GAUGE    /* Current level of something; goes up and down. */
+};
+
+/* A kernel statistic, as the kstat system call reports it. */
+struct kstat {
+  char name[KSTAT_NAME_MAX + 1]; /* Null-terminated name. */
+  int type;                      /* A KSTAT_* type. */
+  long long value;               /* Value when the snapshot was taken. */
+};
+
+#endif /* lib/kstat.h */
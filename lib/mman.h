@@ -0,0 +1,26 @@
+#ifndef __LIB_MMAN_H
+#define __LIB_MMAN_H
+
+/* Advice for the madvise system call, about how a process will
+   use a range of its pages.
+
+   MADV_NORMAL: no particular pattern.
+   MADV_RANDOM: in no order, so faults bring in only the page
+   faulted on, without the file-backed pages after it.
+   MADV_SEQUENTIAL: in order, once, so faults bring in as many
+   pages after it as they can, and the frame table reclaims the
+   pages without a second chance once they are used.
+   MADV_WILLNEED: soon, so the pages are brought in now, without
+   evicting anything for them.
+   MADV_DONTNEED: not soon, so the pages are paged out now and
+   their frames freed; they keep their contents.
+
+   The first three stay with each page, and forked children
+   inherit them; the last two act once. */
+#define MADV_NORMAL 0
+#define MADV_RANDOM 1
+#define MADV_SEQUENTIAL 2
+#define MADV_WILLNEED 3
+#define MADV_DONTNEED 4
+
+#endif /* lib/mman.h */
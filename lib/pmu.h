@@ -0,0 +1,31 @@
+#ifndef __LIB_PMU_H
+#define __LIB_PMU_H
+
+/* Hardware performance counters, as configured with the
+   pmu_setup system call.
+
+   An event is the event select and unit mask that the CPU's
+   IA32_PERFEVTSELx registers take, built with PMU_EVENT().  The
+   named events below are Intel's architectural events, which
+   every CPU with an architectural PMU counts the same way,
+   except PMU_DTLB_MISSES, which is model-specific: it is
+   DTLB_LOAD_MISSES.MISS_CAUSES_A_WALK from Nehalem onward.  Any
+   other model-specific event may be given with PMU_EVENT(). */
+#define PMU_EVENT(EVENT, UMASK) ((EVENT) | (UMASK) << 8)
+#define PMU_NONE 0                             /* Counter unused. */
+#define PMU_CYCLES PMU_EVENT(0x3c, 0x00)        /* Unhalted core cycles. */
+#define PMU_INSTRUCTIONS PMU_EVENT(0xc0, 0x00)  /* Instructions retired. */
+#define PMU_CACHE_REFS PMU_EVENT(0x2e, 0x4f)    /* Last-level cache references. */
+#define PMU_CACHE_MISSES PMU_EVENT(0x2e, 0x41)  /* Last-level cache misses. */
+#define PMU_BRANCHES PMU_EVENT(0xc4, 0x00)      /* Branches retired. */
+#define PMU_BRANCH_MISSES PMU_EVENT(0xc5, 0x00) /* Mispredicted branches retired. */
+#define PMU_DTLB_MISSES PMU_EVENT(0x08, 0x01)   /* Data TLB misses that walk. */
+
+/* Counters a thread may use at once. */
+#define PMU_COUNTER_CNT 4
+
+/* Privilege levels to count at, for pmu_setup's MODE. */
+#define PMU_USER 0x1   /* User code. */
+#define PMU_KERNEL 0x2 /* The kernel, while running the thread. */
+
+#endif /* lib/pmu.h */
@@ -0,0 +1,21 @@
+#ifndef __LIB_POLL_H
+#define __LIB_POLL_H
+
+/* Events for the poll system call.  POLLIN and POLLOUT are asked
+   for in `events'; the others are reported in `revents' whether
+   asked for or not. */
+#define POLLIN 0x1    /* Data to read, or end of file. */
+#define POLLOUT 0x4   /* Room to write without waiting. */
+#define POLLERR 0x8   /* Write end of a pipe with no reader left. */
+#define POLLHUP 0x10  /* Read end of a pipe with no writer left. */
+#define POLLNVAL 0x20 /* Descriptor not open. */
+
+/* A descriptor to poll, as the poll system call takes it.  A
+   negative FD is ignored and gets no events. */
+struct pollfd {
+  int fd;        /* Descriptor. */
+  short events;  /* Events of interest. */
+  short revents; /* Events that occurred. */
+};
+
+#endif /* lib/poll.h */
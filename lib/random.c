@@ -1,6 +1,7 @@
 #include "random.h"
 #include <stdbool.h>
 #include <stdint.h>
+#include <string.h>
 #include "debug.h"
 
 /* RC4-based pseudo-random number generator (PRNG).
@@ -71,3 +72,52 @@ unsigned long random_ulong(void) {
   random_bytes(&ul, sizeof ul);
   return ul;
 }
+
+/* Returns the next value of the splitmix64 sequence whose state
+   is *X, which spreads the bits of a seed over the whole
+   result. */
+static uint64_t splitmix64(uint64_t* x) {
+  uint64_t z = *x += 0x9e3779b97f4a7c15ULL;
+
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+  return z ^ (z >> 31);
+}
+
+/* Initializes P with the given SEED.  Different seeds, even
+   ones that differ in a single bit, give unrelated sequences. */
+void prng_init(struct prng* p, uint64_t seed) {
+  p->s[0] = splitmix64(&seed);
+  p->s[1] = splitmix64(&seed);
+
+  /* The all-zero state would only ever produce zeros. */
+  if (p->s[0] == 0 && p->s[1] == 0)
+    p->s[1] = 1;
+}
+
+/* Writes SIZE pseudo-random bytes from P into BUF, 8 at a
+   time. */
+void prng_bytes(struct prng* p, void* buf_, size_t size) {
+  uint8_t* buf = buf_;
+
+  for (; size >= sizeof(uint64_t); size -= sizeof(uint64_t)) {
+    uint64_t x = prng_next(p);
+
+    memcpy(buf, &x, sizeof x);
+    buf += sizeof x;
+  }
+  if (size > 0) {
+    uint64_t x = prng_next(p);
+    memcpy(buf, &x, size);
+  }
+}
+
+/* Returns a pseudo-random number from P in the range 0...N
+   (exclusive), which must be nonzero.  Scales the top 32 bits
+   of the next value with a multiply instead of dividing, so N
+   should be much less than 2**32 for the result to be close to
+   uniform. */
+unsigned long prng_range(struct prng* p, unsigned long n) {
+  ASSERT(n > 0);
+  return (prng_next(p) >> 32) * n >> 32;
+}
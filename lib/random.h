@@ -2,9 +2,35 @@
 #define __LIB_RANDOM_H
 
 #include <stddef.h>
+#include <stdint.h>
 
 void random_init(unsigned seed);
 void random_bytes(void*, size_t);
 unsigned long random_ulong(void);
 
+/* State of a fast pseudo-random number generator, xorshift128+.
+   Its output is not the same as random_bytes()'s, which the
+   tests' checkers reproduce, but it makes 8 bytes in a few
+   instructions where RC4 makes one.  Each user owns a state, so
+   that threads need not share one: in the kernel, each thread
+   has its own in struct thread. */
+struct prng {
+  uint64_t s[2];
+};
+
+void prng_init(struct prng*, uint64_t seed);
+void prng_bytes(struct prng*, void*, size_t);
+unsigned long prng_range(struct prng*, unsigned long n);
+
+/* Returns the next 64 pseudo-random bits from P. */
+static inline uint64_t prng_next(struct prng* p) {
+  uint64_t x = p->s[0];
+  uint64_t y = p->s[1];
+
+  p->s[0] = y;
+  x ^= x << 23;
+  p->s[1] = x ^ y ^ (x >> 17) ^ (y >> 26);
+  return p->s[1] + y;
+}
+
 #endif /* lib/random.h */
@@ -0,0 +1,18 @@
+#ifndef __LIB_RLIMIT_H
+#define __LIB_RLIMIT_H
+
+/* Resources whose use by a process is limited, for the
+   getrlimit and setrlimit system calls.  A new process starts
+   with its parent's limits.  Kernels built without VM do not
+   enforce RLIMIT_FRAMES. */
+enum rlimit_resource {
+  RLIMIT_FRAMES, /* Pages resident in memory at once. */
+  RLIMIT_NOFILE, /* One more than the highest file descriptor. */
+  RLIMIT_NPROC,  /* Children not yet waited for. */
+  RLIMIT_CNT     /* Number of resources. */
+};
+
+/* A limit that is no limit at all. */
+#define RLIM_INFINITY 0xffffffffu
+
+#endif /* lib/rlimit.h */
@@ -0,0 +1,22 @@
+#ifndef __LIB_RUSAGE_H
+#define __LIB_RUSAGE_H
+
+/* Resource usage of a process, as reported by the getrusage
+   system call.  Times are in timer ticks.  The paging counters
+   stay 0 in kernels built without VM. */
+struct rusage {
+  long long user_ticks;          /* Ticks spent running user code. */
+  long long kernel_ticks;        /* Ticks spent running in the kernel. */
+  long long lock_wait_ticks;     /* Ticks spent blocked acquiring locks. */
+  unsigned voluntary_switches;   /* Context switches by yielding or blocking. */
+  unsigned involuntary_switches; /* Context switches by preemption. */
+  long long minor_faults;        /* Page faults served without I/O. */
+  long long major_faults;        /* Page faults that read a file or swap. */
+  long long swap_ins;            /* Pages read back from swap. */
+  long long swap_outs;           /* Pages written to swap. */
+  unsigned rss_pages;            /* Pages resident in memory. */
+  unsigned peak_rss_pages;       /* Most pages resident at once. */
+  long long refaults;            /* Pages read back soon after their eviction. */
+};
+
+#endif /* lib/rusage.h */
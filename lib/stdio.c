@@ -1,5 +1,6 @@
 #include <stdio.h>
 #include <ctype.h>
+#include <div64.h>
 #include <inttypes.h>
 #include <round.h>
 #include <stdint.h>
@@ -12,7 +13,7 @@ struct vsnprintf_aux {
   int max_length; /* Max length of output string. */
 };
 
-static void vsnprintf_helper(char, void*);
+static void vsnprintf_helper(const char*, size_t, void*);
 
 /* Like vprintf(), except that output is stored into BUFFER,
    which must have space for BUF_SIZE characters.  Writes at most
@@ -29,7 +30,7 @@ int vsnprintf(char* buffer, size_t buf_size, const char* format, va_list args) {
   aux.max_length = buf_size > 0 ? buf_size - 1 : 0;
 
   /* Do most of the work. */
-  __vprintf(format, args, vsnprintf_helper, &aux);
+  __vprintf_chunked(format, args, vsnprintf_helper, &aux);
 
   /* Add null terminator. */
   if (buf_size > 0)
@@ -39,11 +40,17 @@ int vsnprintf(char* buffer, size_t buf_size, const char* format, va_list args) {
 }
 
 /* Helper function for vsnprintf(). */
-static void vsnprintf_helper(char ch, void* aux_) {
+static void vsnprintf_helper(const char* chunk, size_t n, void* aux_) {
   struct vsnprintf_aux* aux = aux_;
+  size_t room = aux->max_length > aux->length ? aux->max_length - aux->length : 0;
 
-  if (aux->length++ < aux->max_length)
-    *aux->p++ = ch;
+  if (n < room)
+    room = n;
+  if (room > 0) {
+    memcpy(aux->p, chunk, room);
+    aux->p += room;
+  }
+  aux->length += n;
 }
 
 /* Like printf(), except that output is stored into BUFFER,
@@ -115,38 +122,78 @@ struct printf_conversion {
 
 struct integer_base {
   int base;           /* Base. */
+  int shift;          /* Bits per digit, or 0 if BASE is not a power of 2. */
   const char* digits; /* Collection of digits. */
   int x;              /* `x' character to use, for base 16 only. */
   int group;          /* Number of digits to group with ' flag. */
 };
 
-static const struct integer_base base_d = {10, "0123456789", 0, 3};
-static const struct integer_base base_o = {8, "01234567", 0, 3};
-static const struct integer_base base_x = {16, "0123456789abcdef", 'x', 4};
-static const struct integer_base base_X = {16, "0123456789ABCDEF", 'X', 4};
+static const struct integer_base base_d = {10, 0, "0123456789", 0, 3};
+static const struct integer_base base_o = {8, 3, "01234567", 0, 3};
+static const struct integer_base base_x = {16, 4, "0123456789abcdef", 'x', 4};
+static const struct integer_base base_X = {16, 4, "0123456789ABCDEF", 'X', 4};
+
+/* Output function for __vprintf_chunked(). */
+typedef void chunk_output_func(const char*, size_t, void*);
 
 static const char* parse_conversion(const char* format, struct printf_conversion*, va_list*);
 static void format_integer(uintmax_t value, bool is_signed, bool negative,
                            const struct integer_base*, const struct printf_conversion*,
-                           void (*output)(char, void*), void* aux);
-static void output_dup(char ch, size_t cnt, void (*output)(char, void*), void* aux);
+                           chunk_output_func* output, void* aux);
+static char* format_decimal(uintmax_t value, char* cp);
+static char* format_decimal32(uint32_t value, char* cp, int min_digits);
+static void output_dup(char ch, size_t cnt, chunk_output_func* output, void* aux);
 static void format_string(const char* string, int length, struct printf_conversion*,
-                          void (*output)(char, void*), void* aux);
+                          chunk_output_func* output, void* aux);
+static void printf_chunked(chunk_output_func* output, void* aux, const char* format, ...);
+
+/* Auxiliary data for __vprintf()'s output_chars(). */
+struct char_output {
+  void (*output)(char, void*); /* Function to call per character. */
+  void* aux;                   /* Its auxiliary data. */
+};
+
+/* Passes each of the N characters in CHUNK to the character
+   output function in the char_output AUX. */
+static void output_chars(const char* chunk, size_t n, void* aux_) {
+  struct char_output* aux = aux_;
 
+  while (n-- > 0)
+    aux->output(*chunk++, aux->aux);
+}
+
+/* Formats FORMAT with ARGS, as vprintf() does, calling OUTPUT
+   with auxiliary data AUX for each character of output. */
 void __vprintf(const char* format, va_list args, void (*output)(char, void*), void* aux) {
+  struct char_output chars = {output, aux};
+
+  __vprintf_chunked(format, args, output_chars, &chars);
+}
+
+/* Formats FORMAT with ARGS, as vprintf() does, calling OUTPUT
+   with auxiliary data AUX for each piece of output: a run of
+   literal text, a padded conversion, and so on.  Costs one call
+   per piece instead of one per character. */
+void __vprintf_chunked(const char* format, va_list args,
+                       void (*output)(const char*, size_t, void*), void* aux) {
   for (; *format != '\0'; format++) {
     struct printf_conversion c;
 
     /* Literally copy non-conversions to output. */
     if (*format != '%') {
-      output(*format, aux);
+      const char* end = strchr(format, '%');
+
+      if (end == NULL)
+        end = format + strlen(format);
+      output(format, end - format, aux);
+      format = end - 1;
       continue;
     }
     format++;
 
     /* %% => %. */
     if (*format == '%') {
-      output('%', aux);
+      output("%", 1, aux);
       continue;
     }
 
@@ -289,11 +336,11 @@ void __vprintf(const char* format, va_list args, void (*output)(char, void*), vo
       case 'n':
         /* We don't support floating-point arithmetic,
              and %n can be part of a security hole. */
-        __printf("<<no %%%c in kernel>>", output, aux, *format);
+        printf_chunked(output, aux, "<<no %%%c in kernel>>", *format);
         break;
 
       default:
-        __printf("<<no %%%c conversion>>", output, aux, *format);
+        printf_chunked(output, aux, "<<no %%%c conversion>>", *format);
         break;
     }
   }
@@ -418,13 +465,16 @@ not_a_flag:
    are in C. */
 static void format_integer(uintmax_t value, bool is_signed, bool negative,
                            const struct integer_base* b, const struct printf_conversion* c,
-                           void (*output)(char, void*), void* aux) {
+                           chunk_output_func* output, void* aux) {
   char buf[64], *cp; /* Buffer and current position. */
+  char prefix[3];    /* Sign and `0x', as output. */
+  int prefix_len;    /* Length of PREFIX. */
   int x;             /* `x' character to use or 0 if none. */
   int sign;          /* Sign character or 0 if none. */
   int precision;     /* Rendered precision. */
   int pad_cnt;       /* # of pad characters to fill field width. */
-  int digit_cnt;     /* # of digits output so far. */
+  int digit_cnt;     /* # of digits in buffer. */
+  char *lo, *hi;
 
   /* Determine sign character, if any.
      An unsigned conversion will never have a sign character,
@@ -446,15 +496,28 @@ static void format_integer(uintmax_t value, bool is_signed, bool negative,
 
   /* Accumulate digits into buffer.
      This algorithm produces digits in reverse order, so later we
-     will output the buffer's content in reverse. */
+     will reverse the buffer's content.  Powers of 2 take shifts
+     instead of divisions, and decimal takes two digits per
+     division. */
   cp = buf;
-  digit_cnt = 0;
-  while (value > 0) {
-    if ((c->flags & GROUP) && digit_cnt > 0 && digit_cnt % b->group == 0)
-      *cp++ = ',';
-    *cp++ = b->digits[value % b->base];
-    value /= b->base;
-    digit_cnt++;
+  if (b->shift != 0)
+    for (; value > 0; value >>= b->shift)
+      *cp++ = b->digits[value & (b->base - 1)];
+  else
+    cp = format_decimal(value, cp);
+
+  /* Insert a comma between each group of digits, moving each
+     digit up by the number of commas below it. */
+  digit_cnt = cp - buf;
+  if ((c->flags & GROUP) && digit_cnt > b->group) {
+    int i;
+
+    for (i = digit_cnt - 1; i > 0; i--) {
+      buf[i + i / b->group] = buf[i];
+      if (i % b->group == 0)
+        buf[i + i / b->group - 1] = ',';
+    }
+    cp += (digit_cnt - 1) / b->group;
   }
 
   /* Append enough zeros to match precision.
@@ -468,48 +531,125 @@ static void format_integer(uintmax_t value, bool is_signed, bool negative,
   if ((c->flags & POUND) && b->base == 8 && (cp == buf || cp[-1] != '0'))
     *cp++ = '0';
 
+  /* Put the digits in order. */
+  for (lo = buf, hi = cp - 1; lo < hi; lo++, hi--) {
+    char t = *lo;
+    *lo = *hi;
+    *hi = t;
+  }
+
+  prefix_len = 0;
+  if (sign)
+    prefix[prefix_len++] = sign;
+  if (x) {
+    prefix[prefix_len++] = '0';
+    prefix[prefix_len++] = x;
+  }
+
   /* Calculate number of pad characters to fill field width. */
-  pad_cnt = c->width - (cp - buf) - (x ? 2 : 0) - (sign != 0);
+  pad_cnt = c->width - (cp - buf) - prefix_len;
   if (pad_cnt < 0)
     pad_cnt = 0;
 
   /* Do output. */
   if ((c->flags & (MINUS | ZERO)) == 0)
     output_dup(' ', pad_cnt, output, aux);
-  if (sign)
-    output(sign, aux);
-  if (x) {
-    output('0', aux);
-    output(x, aux);
-  }
+  if (prefix_len > 0)
+    output(prefix, prefix_len, aux);
   if (c->flags & ZERO)
     output_dup('0', pad_cnt, output, aux);
-  while (cp > buf)
-    output(*--cp, aux);
+  output(buf, cp - buf, aux);
   if (c->flags & MINUS)
     output_dup(' ', pad_cnt, output, aux);
 }
 
+/* The decimal digits of 0...99, two characters each. */
+static const char digit_pairs[] = "00010203040506070809"
+                                  "10111213141516171819"
+                                  "20212223242526272829"
+                                  "30313233343536373839"
+                                  "40414243444546474849"
+                                  "50515253545556575859"
+                                  "60616263646566676869"
+                                  "70717273747576777879"
+                                  "80818283848586878889"
+                                  "90919293949596979899";
+
+/* Stores the decimal digits of VALUE at CP, least significant
+   first, and returns the position after them.  Zero has no
+   digits.  Values that don't fit in 32 bits take a division by
+   10**8 per 8 digits, with div_u64_rem(), so that the rest can be
+   done with 32-bit arithmetic, which is much faster on 32-bit
+   x86. */
+static char* format_decimal(uintmax_t value, char* cp) {
+  while (value > UINT32_MAX) {
+    uint32_t low;
+
+    value = div_u64_rem(value, 100000000, &low);
+    cp = format_decimal32(low, cp, 8);
+  }
+  return format_decimal32(value, cp, 0);
+}
+
+/* Stores the decimal digits of VALUE at CP, least significant
+   first, padded with zeros to at least MIN_DIGITS, and returns
+   the position after them. */
+static char* format_decimal32(uint32_t value, char* cp, int min_digits) {
+  char* start = cp;
+
+  while (value >= 100) {
+    uint32_t high = value / 100;
+    const char* pair = digit_pairs + 2 * (value - high * 100);
+
+    *cp++ = pair[1];
+    *cp++ = pair[0];
+    value = high;
+  }
+  if (value >= 10) {
+    *cp++ = digit_pairs[2 * value + 1];
+    *cp++ = digit_pairs[2 * value];
+  } else if (value > 0)
+    *cp++ = '0' + value;
+  while (cp - start < min_digits)
+    *cp++ = '0';
+  return cp;
+}
+
 /* Writes CH to OUTPUT with auxiliary data AUX, CNT times. */
-static void output_dup(char ch, size_t cnt, void (*output)(char, void*), void* aux) {
-  while (cnt-- > 0)
-    output(ch, aux);
+static void output_dup(char ch, size_t cnt, chunk_output_func* output, void* aux) {
+  char chunk[32];
+
+  memset(chunk, ch, cnt < sizeof chunk ? cnt : sizeof chunk);
+  while (cnt > 0) {
+    size_t n = cnt < sizeof chunk ? cnt : sizeof chunk;
+
+    output(chunk, n, aux);
+    cnt -= n;
+  }
 }
 
 /* Formats the LENGTH characters starting at STRING according to
    the conversion specified in C.  Writes output to OUTPUT with
    auxiliary data AUX. */
 static void format_string(const char* string, int length, struct printf_conversion* c,
-                          void (*output)(char, void*), void* aux) {
-  int i;
+                          chunk_output_func* output, void* aux) {
   if (c->width > length && (c->flags & MINUS) == 0)
     output_dup(' ', c->width - length, output, aux);
-  for (i = 0; i < length; i++)
-    output(string[i], aux);
+  output(string, length, aux);
   if (c->width > length && (c->flags & MINUS) != 0)
     output_dup(' ', c->width - length, output, aux);
 }
 
+/* Wrapper for __vprintf_chunked() that converts varargs into a
+   va_list. */
+static void printf_chunked(chunk_output_func* output, void* aux, const char* format, ...) {
+  va_list args;
+
+  va_start(args, format);
+  __vprintf_chunked(format, args, output, aux);
+  va_end(args);
+}
+
 /* Wrapper for __vprintf() that converts varargs into a
    va_list. */
 void __printf(const char* format, void (*output)(char, void*), void* aux, ...) {
@@ -3,6 +3,7 @@
 #include <random.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include <stdint.h>
 
 /* Converts a string representation of a signed decimal integer
    in S into an `int', which is returned. */
@@ -47,24 +48,48 @@ static int compare_thunk(const void* a, const void* b, void* aux) {
    using COMPARE.  When COMPARE is passed a pair of elements A
    and B, respectively, it must return a strcmp()-type result,
    i.e. less than zero if A < B, zero if A == B, greater than
-   zero if A > B.  Runs in O(n lg n) time and O(1) space in
+   zero if A > B.  Runs in O(n lg n) time and O(lg n) space in
    CNT. */
 void qsort(void* array, size_t cnt, size_t size, int (*compare)(const void*, const void*)) {
   sort(array, cnt, size, compare_thunk, &compare);
 }
 
+/* Partitions of no more than this many elements are finished
+   with insertion sort, which is faster than quicksort on so few. */
+#define INSERTION_SORT_MAX 12
+
+/* A 32-bit word that may alias anything. */
+typedef uint32_t __attribute__((may_alias)) sort_word;
+
+/* Swaps the SIZE-byte elements at A and B, a word at a time if
+   both are word-aligned and SIZE is a multiple of the word
+   size. */
+static void swap_elems(unsigned char* a, unsigned char* b, size_t size) {
+  if (((uintptr_t)a | (uintptr_t)b | size) % sizeof(sort_word) == 0) {
+    sort_word* wa = (sort_word*)a;
+    sort_word* wb = (sort_word*)b;
+    size_t i;
+
+    for (i = 0; i < size / sizeof(sort_word); i++) {
+      sort_word t = wa[i];
+      wa[i] = wb[i];
+      wb[i] = t;
+    }
+  } else {
+    size_t i;
+
+    for (i = 0; i < size; i++) {
+      unsigned char t = a[i];
+      a[i] = b[i];
+      b[i] = t;
+    }
+  }
+}
+
 /* Swaps elements with 1-based indexes A_IDX and B_IDX in ARRAY
    with elements of SIZE bytes each. */
 static void do_swap(unsigned char* array, size_t a_idx, size_t b_idx, size_t size) {
-  unsigned char* a = array + (a_idx - 1) * size;
-  unsigned char* b = array + (b_idx - 1) * size;
-  size_t i;
-
-  for (i = 0; i < size; i++) {
-    unsigned char t = a[i];
-    a[i] = b[i];
-    b[i] = t;
-  }
+  swap_elems(array + (a_idx - 1) * size, array + (b_idx - 1) * size, size);
 }
 
 /* Compares elements with 1-based indexes A_IDX and B_IDX in
@@ -103,29 +128,125 @@ static void heapify(unsigned char* array, size_t i, size_t cnt, size_t size,
   }
 }
 
+/* Heap sorts ARRAY, as sort() does, in O(n lg n) time and O(1)
+   space in CNT. */
+static void heap_sort(unsigned char* array, size_t cnt, size_t size,
+                      int (*compare)(const void*, const void*, void* aux), void* aux) {
+  size_t i;
+
+  /* Build a heap. */
+  for (i = cnt / 2; i > 0; i--)
+    heapify(array, i, cnt, size, compare, aux);
+
+  /* Sort the heap. */
+  for (i = cnt; i > 1; i--) {
+    do_swap(array, 1, i, size);
+    heapify(array, 1, i - 1, size, compare, aux);
+  }
+}
+
+/* Insertion sorts ARRAY, as sort() does, in O(n**2) time. */
+static void insertion_sort(unsigned char* array, size_t cnt, size_t size,
+                           int (*compare)(const void*, const void*, void* aux), void* aux) {
+  unsigned char* end = array + cnt * size;
+  unsigned char* i;
+
+  for (i = array + size; i < end; i += size) {
+    unsigned char* j;
+
+    for (j = i; j > array && compare(j - size, j, aux) > 0; j -= size)
+      swap_elems(j - size, j, size);
+  }
+}
+
+/* Sorts ARRAY, as sort() does, by quicksort, falling back to
+   heap sort for partitions that are still large after DEPTH
+   levels of partitioning, so that bad pivots cannot make it take
+   O(n**2) time. */
+static void intro_sort(unsigned char* array, size_t cnt, size_t size,
+                       int (*compare)(const void*, const void*, void* aux), void* aux,
+                       int depth) {
+  while (cnt > INSERTION_SORT_MAX) {
+    unsigned char* mid = array + cnt / 2 * size;
+    unsigned char* last = array + (cnt - 1) * size;
+    unsigned char *i, *j;
+    size_t left_cnt, right_cnt;
+
+    if (depth-- == 0) {
+      heap_sort(array, cnt, size, compare, aux);
+      return;
+    }
+
+    /* Order the first, middle and last elements, then use their
+       median as the pivot, at the front.  The last element is
+       then no less than the pivot, which stops the upward scan
+       below, and the pivot itself stops the downward scan. */
+    if (compare(mid, array, aux) < 0)
+      swap_elems(mid, array, size);
+    if (compare(last, mid, aux) < 0) {
+      swap_elems(last, mid, size);
+      if (compare(mid, array, aux) < 0)
+        swap_elems(mid, array, size);
+    }
+    swap_elems(array, mid, size);
+
+    /* Partition around the pivot.  Both scans stop at elements
+       equal to the pivot, so many equal elements still split
+       evenly. */
+    i = array;
+    j = last;
+    for (;;) {
+      do
+        i += size;
+      while (compare(i, array, aux) < 0);
+      do
+        j -= size;
+      while (compare(j, array, aux) > 0);
+      if (i >= j)
+        break;
+      swap_elems(i, j, size);
+    }
+    swap_elems(array, j, size);
+
+    /* Sort the smaller side recursively and the larger one by
+       looping, so that the stack stays O(lg n) deep. */
+    left_cnt = (j - array) / size;
+    right_cnt = cnt - left_cnt - 1;
+    if (left_cnt < right_cnt) {
+      intro_sort(array, left_cnt, size, compare, aux, depth);
+      array = j + size;
+      cnt = right_cnt;
+    } else {
+      intro_sort(j + size, right_cnt, size, compare, aux, depth);
+      cnt = left_cnt;
+    }
+  }
+  insertion_sort(array, cnt, size, compare, aux);
+}
+
 /* Sorts ARRAY, which contains CNT elements of SIZE bytes each,
    using COMPARE to compare elements, passing AUX as auxiliary
    data.  When COMPARE is passed a pair of elements A and B,
    respectively, it must return a strcmp()-type result, i.e. less
    than zero if A < B, zero if A == B, greater than zero if A >
-   B.  Runs in O(n lg n) time and O(1) space in CNT. */
+   B.  Runs in O(n lg n) time and O(lg n) space in CNT.
+
+   The sort is an introsort: quicksort with median-of-three
+   pivots, insertion sort for small partitions, and heap sort if
+   partitioning goes more than 2 lg n levels deep.  It is not
+   stable. */
 void sort(void* array, size_t cnt, size_t size, int (*compare)(const void*, const void*, void* aux),
           void* aux) {
-  size_t i;
+  int depth = 0;
+  size_t n;
 
   ASSERT(array != NULL || cnt == 0);
   ASSERT(compare != NULL);
   ASSERT(size > 0);
 
-  /* Build a heap. */
-  for (i = cnt / 2; i > 0; i--)
-    heapify(array, i, cnt, size, compare, aux);
-
-  /* Sort the heap. */
-  for (i = cnt; i > 1; i--) {
-    do_swap(array, 1, i, size);
-    heapify(array, 1, i - 1, size, compare, aux);
-  }
+  for (n = cnt; n > 1; n /= 2)
+    depth += 2;
+  intro_sort(array, cnt, size, compare, aux, depth);
 }
 
 /* Searches ARRAY, which contains CNT elements of SIZE bytes
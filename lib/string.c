@@ -1,5 +1,21 @@
 #include <string.h>
 #include <debug.h>
+#include <stdint.h>
+
+/* memcpy(), memmove(), memset() and memcmp() move 4 bytes at a
+   time.  The first three use the string instructions: they copy
+   or store single bytes until DST is word-aligned, then whole
+   words with "rep movsl" or "rep stosl", then the bytes left
+   over.  Blocks shorter than WORD_MIN are handled a byte at a
+   time, which costs less than setting up a string instruction.
+
+   (SSE2 would move 16 bytes at a time, but the kernel does not
+   save the XMM registers when it switches threads, nor enable
+   SSE in CR4, so neither it nor user programs can use it.) */
+#define WORD_MIN 16
+
+/* A 32-bit word that may alias any other type. */
+typedef uint32_t __attribute__((may_alias)) word_t;
 
 /* Copies SIZE bytes from SRC to DST, which must not overlap.
    Returns DST. */
@@ -10,6 +26,14 @@ void* memcpy(void* dst_, const void* src_, size_t size) {
   ASSERT(dst != NULL || size == 0);
   ASSERT(src != NULL || size == 0);
 
+  if (size >= WORD_MIN) {
+    size_t head = -(uintptr_t)dst & 3;
+    size_t words = (size - head) / 4;
+
+    size = (size - head) % 4;
+    asm volatile("rep movsb" : "+D"(dst), "+S"(src), "+c"(head) : : "memory");
+    asm volatile("rep movsl" : "+D"(dst), "+S"(src), "+c"(words) : : "memory");
+  }
   while (size-- > 0)
     *dst++ = *src++;
 
@@ -25,17 +49,31 @@ void* memmove(void* dst_, const void* src_, size_t size) {
   ASSERT(dst != NULL || size == 0);
   ASSERT(src != NULL || size == 0);
 
-  if (dst < src) {
-    while (size-- > 0)
-      *dst++ = *src++;
-  } else {
-    dst += size;
-    src += size;
-    while (size-- > 0)
+  /* Copying upward only overwrites bytes of SRC already read
+     unless DST is above SRC. */
+  if (dst <= src || dst >= src + size)
+    return memcpy(dst_, src_, size);
+
+  /* Copy downward, from the end, aligning the end of DST. */
+  dst += size;
+  src += size;
+  if (size >= WORD_MIN) {
+    size_t tail = (uintptr_t)dst & 3;
+    size_t words = (size - tail) / 4;
+
+    size = (size - tail) % 4;
+    while (tail-- > 0)
       *--dst = *--src;
+    dst -= 4;
+    src -= 4;
+    asm volatile("std; rep movsl; cld" : "+D"(dst), "+S"(src), "+c"(words) : : "memory");
+    dst += 4;
+    src += 4;
   }
+  while (size-- > 0)
+    *--dst = *--src;
 
-  return dst;
+  return dst_;
 }
 
 /* Find the first differing byte in the two blocks of SIZE bytes
@@ -49,6 +87,11 @@ int memcmp(const void* a_, const void* b_, size_t size) {
   ASSERT(a != NULL || size == 0);
   ASSERT(b != NULL || size == 0);
 
+  /* Skip equal words, then find the differing byte. */
+  for (; size >= 4 && *(const word_t*)a == *(const word_t*)b; size -= 4) {
+    a += 4;
+    b += 4;
+  }
   for (; size-- > 0; a++, b++)
     if (*a != *b)
       return *a > *b ? +1 : -1;
@@ -247,6 +290,15 @@ void* memset(void* dst_, int value, size_t size) {
 
   ASSERT(dst != NULL || size == 0);
 
+  if (size >= WORD_MIN) {
+    size_t head = -(uintptr_t)dst & 3;
+    size_t words = (size - head) / 4;
+    uint32_t word = (unsigned char)value * 0x01010101u;
+
+    size = (size - head) % 4;
+    asm volatile("rep stosb" : "+D"(dst), "+c"(head) : "a"(word) : "memory");
+    asm volatile("rep stosl" : "+D"(dst), "+c"(words) : "a"(word) : "memory");
+  }
   while (size-- > 0)
     *dst++ = value;
 
@@ -27,7 +27,53 @@ enum {
   SYS_MKDIR,   /* Create a directory. */
   SYS_READDIR, /* Reads a directory entry. */
   SYS_ISDIR,   /* Tests if a fd represents a directory. */
-  SYS_INUMBER  /* Returns the inode number for a fd. */
+  SYS_INUMBER, /* Returns the inode number for a fd. */
+
+  /* Extensions. */
+  SYS_GETRUSAGE,       /* Reports this process's resource usage. */
+  SYS_CLOCK_NS,        /* Reads the monotonic nanosecond clock. */
+  SYS_FORK,            /* Duplicates this process. */
+  SYS_READV,           /* Reads from a file into several buffers. */
+  SYS_WRITEV,          /* Writes several buffers to a file. */
+  SYS_PREAD,           /* Reads from a file at a given offset. */
+  SYS_PWRITE,          /* Writes to a file at a given offset. */
+  SYS_SPAWN,           /* Starts another process without waiting for it to load. */
+  SYS_PIPE,            /* Creates a pipe. */
+  SYS_SHMGET,          /* Finds or creates a shared memory segment. */
+  SYS_SHMAT,           /* Attaches a shared memory segment. */
+  SYS_SHMDT,           /* Detaches a shared memory segment. */
+  SYS_SYSENTER,        /* Reports whether sysenter may be used. */
+  SYS_WAITANY,         /* Waits for whichever child exits first. */
+  SYS_IORING_SETUP,    /* Maps a batched system call ring. */
+  SYS_IORING_ENTER,    /* Runs the calls queued in the ring. */
+  SYS_SBRK,            /* Moves the end of the heap. */
+  SYS_GETRLIMIT,       /* Reports a resource limit. */
+  SYS_SETRLIMIT,       /* Lowers a resource limit. */
+  SYS_STRACE,          /* Turns system call tracing on or off. */
+  SYS_BLKSTAT,         /* Reports a block device's I/O statistics. */
+  SYS_PMU_SETUP,       /* Sets up the hardware performance counters. */
+  SYS_PMU_READ,        /* Reads the hardware performance counters. */
+  SYS_FUTEX_WAIT,      /* Waits on a word of user memory. */
+  SYS_FUTEX_WAKE,      /* Wakes processes waiting on a word. */
+  SYS_THREAD_CREATE,   /* Starts a thread in the process. */
+  SYS_THREAD_JOIN,     /* Waits for a thread to exit. */
+  SYS_THREAD_EXIT,     /* Ends the calling thread. */
+  SYS_SCHED_DEADLINE,  /* Puts the calling thread in the deadline class. */
+  SYS_SCHED_YIELD,     /* Yields, for the rest of the period in the deadline class. */
+  SYS_COPY_FILE_RANGE, /* Copies bytes between two files in the kernel. */
+  SYS_OPEN_FLAGS,      /* Opens a file, with flags. */
+  SYS_FALLOCATE,       /* Allocates a file's sectors ahead of its writes. */
+  SYS_GETDENTS,        /* Reads many directory entries at once. */
+  SYS_MADVISE,         /* Advises how a range of memory will be used. */
+  SYS_FADVISE,         /* Advises how a file will be read. */
+  SYS_SETAFFINITY,     /* Sets the CPUs the calling thread may run on. */
+  SYS_NICE,            /* Changes the calling thread's nice value. */
+  SYS_GETNICE,         /* Reports the calling thread's nice value. */
+  SYS_KSTAT,           /* Takes a snapshot of the kernel's statistics. */
+  SYS_POLL,            /* Waits for one of several descriptors to become ready. */
+  SYS_FCNTL,           /* Gets or sets a descriptor's flags. */
+  SYS_GETTUNABLE,      /* Reports a kernel tunable. */
+  SYS_SETTUNABLE       /* Changes a kernel tunable. */
 };
 
 #endif /* lib/syscall-nr.h */
@@ -5,7 +5,7 @@
 
 /* The standard vprintf() function,
    which is like printf() but uses a va_list. */
-int vprintf(const char* format, va_list args) { return vhprintf(STDOUT_FILENO, format, args); }
+int vprintf(const char* format, va_list args) { return vfprintf(stdout, format, args); }
 
 /* Like printf(), but writes output to the given HANDLE. */
 int hprintf(int handle, const char* format, ...) {
@@ -22,18 +22,14 @@ int hprintf(int handle, const char* format, ...) {
 /* Writes string S to the console, followed by a new-line
    character. */
 int puts(const char* s) {
-  write(STDOUT_FILENO, s, strlen(s));
+  fputs(s, stdout);
   putchar('\n');
 
   return 0;
 }
 
 /* Writes C to the console. */
-int putchar(int c) {
-  char c2 = c;
-  write(STDOUT_FILENO, &c2, 1);
-  return c;
-}
+int putchar(int c) { return fputc(c, stdout); }
 
 /* Auxiliary data for vhprintf_helper(). */
 struct vhprintf_aux {
@@ -43,30 +39,43 @@ struct vhprintf_aux {
   int handle;   /* Output file handle. */
 };
 
-static void add_char(char, void*);
+static void add_chunk(const char*, size_t, void*);
 static void flush(struct vhprintf_aux*);
 
 /* Formats the printf() format specification FORMAT with
    arguments given in ARGS and writes the output to the given
-   HANDLE. */
+   HANDLE.  Output to STDOUT_FILENO goes through the standard
+   output stream, so that it stays in order with printf(). */
 int vhprintf(int handle, const char* format, va_list args) {
   struct vhprintf_aux aux;
+
+  if (handle == STDOUT_FILENO)
+    return vfprintf(stdout, format, args);
   aux.p = aux.buf;
   aux.char_cnt = 0;
   aux.handle = handle;
-  __vprintf(format, args, add_char, &aux);
+  __vprintf_chunked(format, args, add_chunk, &aux);
   flush(&aux);
   return aux.char_cnt;
 }
 
-/* Adds C to the buffer in AUX, flushing it if the buffer fills
-   up. */
-static void add_char(char c, void* aux_) {
+/* Adds the N bytes in CHUNK to the buffer in AUX, flushing it
+   whenever it fills up. */
+static void add_chunk(const char* chunk, size_t n, void* aux_) {
   struct vhprintf_aux* aux = aux_;
-  *aux->p++ = c;
-  if (aux->p >= aux->buf + sizeof aux->buf)
-    flush(aux);
-  aux->char_cnt++;
+
+  aux->char_cnt += n;
+  while (n > 0) {
+    size_t room = aux->buf + sizeof aux->buf - aux->p;
+    size_t cnt = n < room ? n : room;
+
+    memcpy(aux->p, chunk, cnt);
+    aux->p += cnt;
+    chunk += cnt;
+    n -= cnt;
+    if (aux->p >= aux->buf + sizeof aux->buf)
+      flush(aux);
+  }
 }
 
 /* Flushes the buffer in AUX. */
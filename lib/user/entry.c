@@ -3,4 +3,7 @@
 int main(int, char* []);
 void _start(int argc, char* argv[]);
 
-void _start(int argc, char* argv[]) { exit(main(argc, argv)); }
+void _start(int argc, char* argv[]) {
+  syscall_sysenter = sysenter_available();
+  exit(main(argc, argv));
+}
@@ -0,0 +1,194 @@
+#include <malloc.h>
+#include <stdint.h>
+#include <string.h>
+#include <synch.h>
+#include <syscall.h>
+
+/* A simple, fast allocator for user programs.
+
+   Memory comes from the heap that the sbrk system call extends,
+   ARENA_GROW bytes at a time, so that most requests make no
+   system call.  The kernel only commits a heap page when it is
+   first touched, so grabbing more than is needed costs nothing
+   but address space.
+
+   Requests of up to MAX_SMALL bytes are rounded up to a power of
+   2 and served from a free list per size.  A list that is empty
+   takes a new block from the arena.  Larger requests are rounded
+   up to a multiple of LARGE_ALIGN and served first-fit from a
+   list of freed large blocks, or from the arena.  Blocks are
+   never split, merged or given back to the kernel.
+
+   Each block is preceded by a header that records its size, so
+   free() knows where the block goes.  A process may have several
+   threads, so the free lists and the arena are only touched with
+   a mutex held, which costs an atomic exchange when only one
+   thread allocates. */
+
+#define MIN_SMALL 16           /* Smallest block size. */
+#define MAX_SMALL 2048         /* Largest small block size. */
+#define SMALL_CLASS_CNT 8      /* Sizes MIN_SMALL...MAX_SMALL. */
+#define LARGE_ALIGN 4096       /* Large block sizes are multiples of this. */
+#define ARENA_GROW (64 * 1024) /* Smallest heap extension. */
+
+/* Block header.  Eight bytes, so that blocks stay 8-byte
+   aligned. */
+struct header {
+  size_t size;         /* Usable bytes in the block. */
+  struct header* next; /* Next block in a free list. */
+};
+
+static struct header* small_free[SMALL_CLASS_CNT]; /* Free small blocks, by size. */
+static struct header* large_free;                  /* Free large blocks. */
+static uint8_t* arena;                             /* Next unused heap byte. */
+static uint8_t* arena_end;                         /* End of the heap. */
+static struct mutex heap_lock;                     /* Protects all of the above. */
+
+static void* alloc(size_t size);
+
+/* Returns the size class for a request of SIZE <= MAX_SMALL
+   bytes. */
+static int small_class(size_t size) {
+  int class = 0;
+
+  while ((size_t)MIN_SMALL << class < size)
+    class++;
+  return class;
+}
+
+/* Returns SIZE bytes from the arena, or a null pointer if the
+   heap cannot grow. */
+static void* arena_alloc(size_t size) {
+  void* p;
+
+  if ((size_t)(arena_end - arena) < size) {
+    size_t grow = size > ARENA_GROW ? size : ARENA_GROW;
+    uint8_t* old = sbrk(grow);
+
+    if (old == (void*)-1)
+      return NULL;
+    if (old != arena_end) {
+      /* First call, or someone else moved the break. */
+      arena = old;
+    }
+    arena_end = old + grow;
+    if ((size_t)(arena_end - arena) < size)
+      return NULL;
+  }
+  p = arena;
+  arena += size;
+  return p;
+}
+
+/* Obtains and returns a new block of at least SIZE bytes.
+   Returns a null pointer if memory runs out or SIZE is 0. */
+void* malloc(size_t size) {
+  void* p;
+
+  if (size == 0)
+    return NULL;
+  mutex_lock(&heap_lock);
+  p = alloc(size);
+  mutex_unlock(&heap_lock);
+  return p;
+}
+
+/* Does the work of malloc() for SIZE > 0, with heap_lock held. */
+static void* alloc(size_t size) {
+  struct header* h;
+
+  if (size <= MAX_SMALL) {
+    int class = small_class(size);
+
+    h = small_free[class];
+    if (h != NULL)
+      small_free[class] = h->next;
+    else {
+      h = arena_alloc(sizeof *h + (MIN_SMALL << class));
+      if (h == NULL)
+        return NULL;
+      h->size = MIN_SMALL << class;
+    }
+  } else {
+    struct header** hp;
+
+    if (size > SIZE_MAX - LARGE_ALIGN)
+      return NULL;
+    size = (size + LARGE_ALIGN - 1) / LARGE_ALIGN * LARGE_ALIGN;
+    for (hp = &large_free; *hp != NULL; hp = &(*hp)->next)
+      if ((*hp)->size >= size)
+        break;
+    h = *hp;
+    if (h != NULL)
+      *hp = h->next;
+    else {
+      h = arena_alloc(sizeof *h + size);
+      if (h == NULL)
+        return NULL;
+      h->size = size;
+    }
+  }
+  return h + 1;
+}
+
+/* Allocates and returns A times B bytes initialized to zeroes.
+   Returns a null pointer if memory is not available. */
+void* calloc(size_t a, size_t b) {
+  size_t size = a * b;
+  void* p;
+
+  if (b != 0 && size / b != a)
+    return NULL;
+  p = malloc(size);
+  if (p != NULL)
+    memset(p, 0, size);
+  return p;
+}
+
+/* Attempts to resize OLD_BLOCK to NEW_SIZE bytes, possibly
+   moving it in the process.  If successful, returns the new
+   block; on failure, returns a null pointer.  A call with null
+   OLD_BLOCK is equivalent to malloc(NEW_SIZE).  A call with zero
+   NEW_SIZE is equivalent to free(OLD_BLOCK). */
+void* realloc(void* old_block, size_t new_size) {
+  struct header* h;
+  void* new_block;
+
+  if (new_size == 0) {
+    free(old_block);
+    return NULL;
+  }
+  if (old_block == NULL)
+    return malloc(new_size);
+
+  h = (struct header*)old_block - 1;
+  if (new_size <= h->size)
+    return old_block;
+  new_block = malloc(new_size);
+  if (new_block != NULL) {
+    memcpy(new_block, old_block, h->size);
+    free(old_block);
+  }
+  return new_block;
+}
+
+/* Frees block P, which must have been previously allocated with
+   malloc(), calloc(), or realloc(). */
+void free(void* p) {
+  struct header* h;
+
+  if (p == NULL)
+    return;
+  h = (struct header*)p - 1;
+  mutex_lock(&heap_lock);
+  if (h->size <= MAX_SMALL) {
+    int class = small_class(h->size);
+
+    h->next = small_free[class];
+    small_free[class] = h;
+  } else {
+    h->next = large_free;
+    large_free = h;
+  }
+  mutex_unlock(&heap_lock);
+}
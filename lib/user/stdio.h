@@ -1,6 +1,43 @@
 #ifndef __LIB_USER_STDIO_H
 #define __LIB_USER_STDIO_H
 
+/* Buffered stream.  See lib/user/stream.c. */
+typedef struct stream FILE;
+
+/* Standard streams. */
+extern FILE* stdin;
+extern FILE* stdout;
+
+/* Returned by stream functions at end of file or on error. */
+#define EOF (-1)
+
+/* Size of stream buffers. */
+#define BUFSIZ 512
+
+/* Stream buffering modes, for setvbuf(). */
+#define _IOFBF 0 /* Full buffering. */
+#define _IOLBF 1 /* Line buffering. */
+#define _IONBF 2 /* No buffering. */
+
+FILE* fdopen(int handle, const char* mode);
+int fclose(FILE*);
+int fflush(FILE*);
+int setvbuf(FILE*, char* buf, int mode, size_t size);
+
+size_t fwrite(const void*, size_t size, size_t cnt, FILE*);
+int fputc(int, FILE*);
+int fputs(const char*, FILE*);
+int fprintf(FILE*, const char*, ...) PRINTF_FORMAT(2, 3);
+int vfprintf(FILE*, const char*, va_list) PRINTF_FORMAT(2, 0);
+
+size_t fread(void*, size_t size, size_t cnt, FILE*);
+int fgetc(FILE*);
+char* fgets(char*, int size, FILE*);
+int getchar(void);
+int feof(FILE*);
+int ferror(FILE*);
+
+/* Nonstandard functions. */
 int hprintf(int, const char*, ...) PRINTF_FORMAT(2, 3);
 int vhprintf(int, const char*, va_list) PRINTF_FORMAT(2, 0);
 
@@ -0,0 +1,369 @@
+#include <stdio.h>
+#include <malloc.h>
+#include <string.h>
+#include <syscall.h>
+
+/* Buffered streams.
+
+   A stream gathers the bytes written to it in a buffer and hands
+   them to the kernel in one write() system call when the buffer
+   fills, or, for a line-buffered stream, when a new-line is
+   written.  Reading fills the buffer with one read() system call
+   and serves later reads from it.  So a program that prints a
+   line a few characters at a time, or reads a file a byte at a
+   time, makes one system call per line or per buffer instead of
+   one per call.
+
+   The standard output stream is line-buffered, so that each line
+   appears on the console as soon as it is complete.  Streams
+   opened with fdopen() are fully buffered.  Reading from the
+   standard input stream first flushes the standard output
+   stream, so that a prompt appears before the program waits for
+   the answer.  exit() and fork() flush all streams.
+
+   A stream is either for reading or for writing, never both. */
+struct stream {
+  int handle;          /* File handle. */
+  int buf_mode;        /* _IOFBF, _IOLBF or _IONBF. */
+  bool reading;        /* Opened for reading? */
+  bool error;          /* Has a system call failed? */
+  bool eof;            /* Has reading reached end of file? */
+  bool own_buf;        /* Did we malloc() BUF? */
+  char* buf;           /* Buffer. */
+  size_t size;         /* Size of BUF. */
+  char* pos;           /* Next byte to read or write. */
+  char* end;           /* End of bytes read into BUF. */
+  struct stream* next; /* Next open stream. */
+};
+
+static char stdin_buf[BUFSIZ];
+static char stdout_buf[BUFSIZ];
+
+static struct stream stdin_stream = {.handle = STDIN_FILENO,
+                                     .buf_mode = _IOFBF,
+                                     .reading = true,
+                                     .buf = stdin_buf,
+                                     .size = BUFSIZ,
+                                     .pos = stdin_buf,
+                                     .end = stdin_buf};
+static struct stream stdout_stream = {.handle = STDOUT_FILENO,
+                                      .buf_mode = _IOLBF,
+                                      .buf = stdout_buf,
+                                      .size = BUFSIZ,
+                                      .pos = stdout_buf,
+                                      .end = stdout_buf,
+                                      .next = &stdin_stream};
+
+FILE* stdin = &stdin_stream;
+FILE* stdout = &stdout_stream;
+
+/* All open streams, linked through `next'. */
+static struct stream* all_streams = &stdout_stream;
+
+static bool flush_buffer(FILE*);
+static bool fill_buffer(FILE*);
+static void add_chunk(const char*, size_t, void*);
+
+/* Opens a stream on file HANDLE, which must already be open,
+   for reading if MODE begins with `r', otherwise for writing.
+   Returns the new stream, or a null pointer if memory is not
+   available. */
+FILE* fdopen(int handle, const char* mode) {
+  FILE* s = malloc(sizeof *s);
+  char* buf = malloc(BUFSIZ);
+
+  if (s == NULL || buf == NULL) {
+    free(s);
+    free(buf);
+    return NULL;
+  }
+  s->handle = handle;
+  s->buf_mode = _IOFBF;
+  s->reading = mode[0] == 'r';
+  s->error = s->eof = false;
+  s->own_buf = true;
+  s->buf = s->pos = s->end = buf;
+  s->size = BUFSIZ;
+  s->next = all_streams;
+  all_streams = s;
+  return s;
+}
+
+/* Flushes stream S, closes its file handle, and frees it.
+   Returns 0 if successful, EOF if flushing failed. */
+int fclose(FILE* s) {
+  struct stream** p;
+  int retval = fflush(s);
+
+  for (p = &all_streams; *p != s; p = &(*p)->next)
+    continue;
+  *p = s->next;
+  close(s->handle);
+  if (s->own_buf)
+    free(s->buf);
+  if (s != stdin && s != stdout)
+    free(s);
+  return retval;
+}
+
+/* Sets the buffering of stream S, before it has been read or
+   written, to MODE, one of _IOFBF (full buffering), _IOLBF (line
+   buffering) or _IONBF (no buffering).  If BUF is nonnull, the
+   stream uses its SIZE bytes as its buffer from now on; the
+   caller must keep them valid until the stream is closed.
+   Returns 0. */
+int setvbuf(FILE* s, char* buf, int mode, size_t size) {
+  if (buf != NULL && size > 0) {
+    if (s->own_buf)
+      free(s->buf);
+    s->own_buf = false;
+    s->buf = s->pos = s->end = buf;
+    s->size = size;
+  }
+  s->buf_mode = mode;
+  return 0;
+}
+
+/* Writes out the bytes buffered in stream S, or in every open
+   stream if S is a null pointer.  Returns 0 if successful, EOF
+   if a write failed. */
+int fflush(FILE* s) {
+  if (s == NULL) {
+    int retval = 0;
+
+    for (s = all_streams; s != NULL; s = s->next)
+      if (fflush(s) == EOF)
+        retval = EOF;
+    return retval;
+  }
+  if (s->reading)
+    return 0;
+  return flush_buffer(s) ? 0 : EOF;
+}
+
+/* Writes CNT elements of SIZE bytes each from BUFFER to stream
+   S.  Returns the number of elements written, which is less than
+   CNT only if a write failed. */
+size_t fwrite(const void* buffer, size_t size, size_t cnt, FILE* s) {
+  const char* p = buffer;
+  size_t n = size * cnt;
+  size_t done = 0;
+
+  if (n == 0)
+    return 0;
+  ASSERT(!s->reading);
+
+  while (done < n) {
+    size_t room = s->buf + s->size - s->pos;
+
+    if (s->pos == s->buf && (n - done >= s->size || s->buf_mode == _IONBF)) {
+      /* The buffer is empty and the rest would fill it: write
+         the rest directly instead of copying it through. */
+      int retval = write(s->handle, p + done, n - done);
+
+      if (retval < 0 || (size_t)retval < n - done) {
+        s->error = true;
+        return retval < 0 ? done / size : (done + retval) / size;
+      }
+      return cnt;
+    }
+    if (room > n - done)
+      room = n - done;
+    memcpy(s->pos, p + done, room);
+    s->pos += room;
+    done += room;
+    if (s->pos == s->buf + s->size && !flush_buffer(s))
+      return 0;
+  }
+  if (s->buf_mode == _IOLBF && memchr(p, '\n', n) != NULL && !flush_buffer(s))
+    return 0;
+  return cnt;
+}
+
+/* Writes character C to stream S.  Returns C, or EOF if a write
+   failed. */
+int fputc(int c, FILE* s) {
+  if (s->pos < s->buf + s->size - 1 && s->buf_mode == _IOFBF) {
+    *s->pos++ = c;
+    return (unsigned char)c;
+  } else {
+    char c2 = c;
+    return fwrite(&c2, 1, 1, s) == 1 ? (unsigned char)c : EOF;
+  }
+}
+
+/* Writes string S to stream STREAM, without a new-line.  Returns
+   0 if successful, EOF if a write failed. */
+int fputs(const char* s, FILE* stream) {
+  size_t n = strlen(s);
+  return fwrite(s, 1, n, stream) == n ? 0 : EOF;
+}
+
+/* Like printf(), but writes output to stream S. */
+int fprintf(FILE* s, const char* format, ...) {
+  va_list args;
+  int retval;
+
+  va_start(args, format);
+  retval = vfprintf(s, format, args);
+  va_end(args);
+
+  return retval;
+}
+
+/* Auxiliary data for vfprintf()'s add_chunk(). */
+struct vfprintf_aux {
+  FILE* stream; /* Output stream. */
+  int char_cnt; /* Total characters written so far. */
+};
+
+/* Like vprintf(), but writes output to stream S. */
+int vfprintf(FILE* s, const char* format, va_list args) {
+  struct vfprintf_aux aux;
+
+  aux.stream = s;
+  aux.char_cnt = 0;
+  __vprintf_chunked(format, args, add_chunk, &aux);
+  return aux.char_cnt;
+}
+
+/* Writes the N bytes in CHUNK to the stream in AUX. */
+static void add_chunk(const char* chunk, size_t n, void* aux_) {
+  struct vfprintf_aux* aux = aux_;
+
+  aux->char_cnt += n;
+  fwrite(chunk, 1, n, aux->stream);
+}
+
+/* Reads up to CNT elements of SIZE bytes each from stream S into
+   BUFFER.  Returns the number of whole elements read, which is
+   less than CNT only at end of file or if a read failed. */
+size_t fread(void* buffer, size_t size, size_t cnt, FILE* s) {
+  char* p = buffer;
+  size_t n = size * cnt;
+  size_t done = 0;
+
+  if (n == 0)
+    return 0;
+  ASSERT(s->reading);
+
+  while (done < n) {
+    size_t avail = s->end - s->pos;
+
+    if (avail == 0) {
+      if (n - done >= s->size) {
+        /* At least a buffer's worth is left: read straight into
+           BUFFER instead of copying through the stream's. */
+        int retval;
+
+        if (s == stdin)
+          fflush(stdout);
+        retval = read(s->handle, p + done, n - done);
+        if (retval <= 0) {
+          s->error = retval < 0;
+          s->eof = retval == 0;
+          break;
+        }
+        done += retval;
+        continue;
+      }
+      if (!fill_buffer(s))
+        break;
+      avail = s->end - s->pos;
+    }
+    if (avail > n - done)
+      avail = n - done;
+    memcpy(p + done, s->pos, avail);
+    s->pos += avail;
+    done += avail;
+  }
+  return done / size;
+}
+
+/* Reads and returns one character from stream S, or EOF at end
+   of file or if a read failed. */
+int fgetc(FILE* s) {
+  ASSERT(s->reading);
+
+  if (s->pos == s->end && !fill_buffer(s))
+    return EOF;
+  return (unsigned char)*s->pos++;
+}
+
+/* Reads characters from stream S into BUFFER, up to and
+   including a new-line, up to SIZE - 1 characters, or to end of
+   file, whichever comes first, and null-terminates them.
+   Returns BUFFER, or a null pointer if no characters were read
+   before end of file or a read failure. */
+char* fgets(char* buffer, int size, FILE* s) {
+  char* p = buffer;
+
+  ASSERT(s->reading);
+  if (size <= 0)
+    return NULL;
+
+  while (p < buffer + size - 1) {
+    size_t n;
+    char* newline;
+
+    if (s->pos == s->end && !fill_buffer(s))
+      break;
+    n = s->end - s->pos;
+    if (n > (size_t)(buffer + size - 1 - p))
+      n = buffer + size - 1 - p;
+    newline = memchr(s->pos, '\n', n);
+    if (newline != NULL)
+      n = newline - s->pos + 1;
+    memcpy(p, s->pos, n);
+    s->pos += n;
+    p += n;
+    if (newline != NULL)
+      break;
+  }
+  if (p == buffer)
+    return NULL;
+  *p = '\0';
+  return buffer;
+}
+
+/* Reads and returns one character from the standard input
+   stream, or EOF at end of file or if a read failed. */
+int getchar(void) { return fgetc(stdin); }
+
+/* Returns true if reading stream S has reached end of file. */
+int feof(FILE* s) { return s->eof; }
+
+/* Returns true if a system call on stream S has failed. */
+int ferror(FILE* s) { return s->error; }
+
+/* Writes out the bytes in stream S's buffer and empties it.
+   Returns true if successful, false if the write failed. */
+static bool flush_buffer(FILE* s) {
+  size_t n = s->pos - s->buf;
+
+  s->pos = s->buf;
+  if (n > 0 && write(s->handle, s->buf, n) != (int)n) {
+    s->error = true;
+    return false;
+  }
+  return true;
+}
+
+/* Refills stream S's empty buffer with one read() system call.
+   Returns true if any bytes were read, false at end of file or
+   if the read failed. */
+static bool fill_buffer(FILE* s) {
+  int retval;
+
+  if (s == stdin)
+    fflush(stdout);
+  retval = read(s->handle, s->buf, s->buf_mode == _IONBF ? 1 : s->size);
+  if (retval <= 0) {
+    s->error = retval < 0;
+    s->eof = retval == 0;
+    return false;
+  }
+  s->pos = s->buf;
+  s->end = s->buf + retval;
+  return true;
+}
@@ -0,0 +1,104 @@
+#include <synch.h>
+#include <limits.h>
+#include <syscall.h>
+
+/* Mutexes and condition variables built on futexes.
+
+   A mutex is a word that atomic instructions move between 0
+   (unlocked), 1 (locked) and 2 (locked, and someone may be
+   waiting).  Locking an unlocked mutex and unlocking a mutex no
+   one waits for are a single atomic instruction each, with no
+   system call.  Only a process that finds the mutex locked
+   enters the kernel, to wait on the word with futex_wait(), and
+   only unlocking a mutex in state 2 enters it, to wake one
+   waiter.  See Drepper, "Futexes Are Tricky".
+
+   A condition variable's SEQ changes with every signal, so a
+   waiter that reads SEQ before releasing the mutex and then
+   waits for it to change cannot miss a signal sent in between:
+   futex_wait() returns at once if SEQ has moved on.  Signals
+   skip the system call when no one waits.  A woken waiter takes
+   the mutex in state 2, since others may still be waiting for
+   it. */
+
+/* Atomically stores NEW in *P and returns the old value. */
+static inline int atomic_xchg(volatile int* p, int new) {
+  asm volatile("xchgl %0, %1" : "+r"(new), "+m"(*p) : : "memory");
+  return new;
+}
+
+/* Atomically stores NEW in *P if it holds OLD.  Returns the value
+   *P held. */
+static inline int atomic_cmpxchg(volatile int* p, int old, int new) {
+  int prev;
+
+  asm volatile("lock cmpxchgl %2, %1" : "=a"(prev), "+m"(*p) : "r"(new), "0"(old) : "memory");
+  return prev;
+}
+
+/* Atomically adds N to *P. */
+static inline void atomic_add(volatile int* p, int n) {
+  asm volatile("lock addl %1, %0" : "+m"(*p) : "ir"(n) : "memory");
+}
+
+/* Initializes M as unlocked. */
+void mutex_init(struct mutex* m) { m->state = 0; }
+
+/* Acquires M, waiting in the kernel if it is locked. */
+void mutex_lock(struct mutex* m) {
+  int c = atomic_cmpxchg(&m->state, 0, 1);
+
+  if (c == 0)
+    return;
+  if (c != 2)
+    c = atomic_xchg(&m->state, 2);
+  while (c != 0) {
+    futex_wait((int*)&m->state, 2);
+    c = atomic_xchg(&m->state, 2);
+  }
+}
+
+/* Acquires M if it is unlocked.  Returns true if successful,
+   false if M was locked. */
+bool mutex_trylock(struct mutex* m) { return atomic_cmpxchg(&m->state, 0, 1) == 0; }
+
+/* Releases M, which the caller must hold, and wakes a waiter if
+   there may be one. */
+void mutex_unlock(struct mutex* m) {
+  if (atomic_xchg(&m->state, 0) == 2)
+    futex_wake((int*)&m->state, 1);
+}
+
+/* Initializes C. */
+void cond_init(struct condvar* c) { c->seq = c->waiters = 0; }
+
+/* Atomically releases M, which the caller must hold, and waits
+   for C to be signaled, then reacquires M.  As with any
+   condition variable, the caller should recheck its condition
+   after waking. */
+void cond_wait(struct condvar* c, struct mutex* m) {
+  int seq = c->seq;
+
+  atomic_add(&c->waiters, 1);
+  mutex_unlock(m);
+  futex_wait((int*)&c->seq, seq);
+  atomic_add(&c->waiters, -1);
+  while (atomic_xchg(&m->state, 2) != 0)
+    futex_wait((int*)&m->state, 2);
+}
+
+/* Wakes one process waiting on C, if any. */
+void cond_signal(struct condvar* c) {
+  if (c->waiters > 0) {
+    atomic_add(&c->seq, 1);
+    futex_wake((int*)&c->seq, 1);
+  }
+}
+
+/* Wakes every process waiting on C. */
+void cond_broadcast(struct condvar* c) {
+  if (c->waiters > 0) {
+    atomic_add(&c->seq, 1);
+    futex_wake((int*)&c->seq, INT_MAX);
+  }
+}
@@ -0,0 +1,29 @@
+#ifndef __LIB_USER_SYNCH_H
+#define __LIB_USER_SYNCH_H
+
+#include <stdbool.h>
+
+/* A mutual exclusion lock, for the threads of a process or for
+   processes that share it through shared memory.
+   Zero-initialized memory holds an unlocked mutex. */
+struct mutex {
+  volatile int state; /* 0: unlocked, 1: locked, 2: locked with waiters. */
+};
+
+/* A condition variable.  Zero-initialized memory holds one. */
+struct condvar {
+  volatile int seq;     /* Bumped by each signal or broadcast. */
+  volatile int waiters; /* Number of processes in cond_wait(). */
+};
+
+void mutex_init(struct mutex*);
+void mutex_lock(struct mutex*);
+bool mutex_trylock(struct mutex*);
+void mutex_unlock(struct mutex*);
+
+void cond_init(struct condvar*);
+void cond_wait(struct condvar*, struct mutex*);
+void cond_signal(struct condvar*);
+void cond_broadcast(struct condvar*);
+
+#endif /* lib/user/synch.h */
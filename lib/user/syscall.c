@@ -1,15 +1,29 @@
 #include <syscall.h>
+#include <stdio.h>
 #include "../syscall-nr.h"
 
+/* Make system calls with sysenter instead of int $0x30?  _start()
+   sets this if the kernel allows it. */
+bool syscall_sysenter;
+
+/* Traps into the kernel with the system call number and
+   arguments already pushed.  With syscall_sysenter set, uses
+   sysenter, which clobbers %ecx and %edx, and returns to label 1
+   with the same %esp. */
+#define SYSCALL_TRAP                                                                               \
+  "cmpb $0, %[fast]; je 2f; "                                                                      \
+  "movl %%esp, %%ecx; movl $1f, %%edx; sysenter; "                                                 \
+  "2: int $0x30; 1: "
+
 /* Invokes syscall NUMBER, passing no arguments, and returns the
    return value as an `int'. */
 #define syscall0(NUMBER)                                                                           \
   ({                                                                                               \
     int retval;                                                                                    \
-    asm volatile("pushl %[number]; int $0x30; addl $4, %%esp"                                      \
+    asm volatile("pushl %[number]; " SYSCALL_TRAP "addl $4, %%esp"                                 \
                  : "=a"(retval)                                                                    \
-                 : [number] "i"(NUMBER)                                                            \
-                 : "memory");                                                                      \
+                 : [number] "i"(NUMBER), [fast] "m"(syscall_sysenter)                              \
+                 : "ecx", "edx", "memory");                                                        \
     retval;                                                                                        \
   })
 
@@ -18,10 +32,10 @@
 #define syscall1(NUMBER, ARG0)                                                                     \
   ({                                                                                               \
     int retval;                                                                                    \
-    asm volatile("pushl %[arg0]; pushl %[number]; int $0x30; addl $8, %%esp"                       \
+    asm volatile("pushl %[arg0]; pushl %[number]; " SYSCALL_TRAP "addl $8, %%esp"                  \
                  : "=a"(retval)                                                                    \
-                 : [number] "i"(NUMBER), [arg0] "g"(ARG0)                                          \
-                 : "memory");                                                                      \
+                 : [number] "i"(NUMBER), [fast] "m"(syscall_sysenter), [arg0] "g"(ARG0)            \
+                 : "ecx", "edx", "memory");                                                        \
     retval;                                                                                        \
   })
 
@@ -31,10 +45,11 @@
   ({                                                                                               \
     int retval;                                                                                    \
     asm volatile("pushl %[arg1]; pushl %[arg0]; "                                                  \
-                 "pushl %[number]; int $0x30; addl $12, %%esp"                                     \
+                 "pushl %[number]; " SYSCALL_TRAP "addl $12, %%esp"                                \
                  : "=a"(retval)                                                                    \
-                 : [number] "i"(NUMBER), [arg0] "g"(ARG0), [arg1] "g"(ARG1)                        \
-                 : "memory");                                                                      \
+                 : [number] "i"(NUMBER), [fast] "m"(syscall_sysenter),                             \
+                   [arg0] "g"(ARG0), [arg1] "g"(ARG1)                                              \
+                 : "ecx", "edx", "memory");                                                        \
     retval;                                                                                        \
   })
 
@@ -44,10 +59,25 @@
   ({                                                                                               \
     int retval;                                                                                    \
     asm volatile("pushl %[arg2]; pushl %[arg1]; pushl %[arg0]; "                                   \
-                 "pushl %[number]; int $0x30; addl $16, %%esp"                                     \
+                 "pushl %[number]; " SYSCALL_TRAP "addl $16, %%esp"                                \
+                 : "=a"(retval)                                                                    \
+                 : [number] "i"(NUMBER), [fast] "m"(syscall_sysenter),                             \
+                   [arg0] "g"(ARG0), [arg1] "g"(ARG1), [arg2] "g"(ARG2)                            \
+                 : "ecx", "edx", "memory");                                                        \
+    retval;                                                                                        \
+  })
+
+/* Invokes syscall NUMBER, passing arguments ARG0, ARG1, ARG2,
+   and ARG3, and returns the return value as an `int'. */
+#define syscall4(NUMBER, ARG0, ARG1, ARG2, ARG3)                                                   \
+  ({                                                                                               \
+    int retval;                                                                                    \
+    asm volatile("pushl %[arg3]; pushl %[arg2]; pushl %[arg1]; pushl %[arg0]; "                    \
+                 "pushl %[number]; " SYSCALL_TRAP "addl $20, %%esp"                                \
                  : "=a"(retval)                                                                    \
-                 : [number] "i"(NUMBER), [arg0] "g"(ARG0), [arg1] "g"(ARG1), [arg2] "g"(ARG2)      \
-                 : "memory");                                                                      \
+                 : [number] "i"(NUMBER), [fast] "m"(syscall_sysenter),                             \
+                   [arg0] "g"(ARG0), [arg1] "g"(ARG1), [arg2] "g"(ARG2), [arg3] "g"(ARG3)          \
+                 : "ecx", "edx", "memory");                                                        \
     retval;                                                                                        \
   })
 
@@ -57,6 +87,7 @@ void halt(void) {
 }
 
 void exit(int status) {
+  fflush(NULL);
   syscall1(SYS_EXIT, status);
   NOT_REACHED();
 }
@@ -65,6 +96,8 @@ pid_t exec(const char* file) { return (pid_t)syscall1(SYS_EXEC, file); }
 
 int wait(pid_t pid) { return syscall1(SYS_WAIT, pid); }
 
+pid_t waitany(int* status, bool block) { return (pid_t)syscall2(SYS_WAITANY, status, block); }
+
 bool create(const char* file, unsigned initial_size) {
   return syscall2(SYS_CREATE, file, initial_size);
 }
@@ -100,3 +133,144 @@ bool readdir(int fd, char name[READDIR_MAX_LEN + 1]) { return syscall2(SYS_READD
 bool isdir(int fd) { return syscall1(SYS_ISDIR, fd); }
 
 int inumber(int fd) { return syscall1(SYS_INUMBER, fd); }
+
+int getrusage(struct rusage* usage) { return syscall1(SYS_GETRUSAGE, usage); }
+
+/* Flushes all streams first, so that the child does not inherit
+   and write out again the parent's buffered output. */
+pid_t fork(void) {
+  fflush(NULL);
+  return (pid_t)syscall0(SYS_FORK);
+}
+
+int readv(int fd, const struct iovec* iov, int iovcnt) {
+  return syscall3(SYS_READV, fd, iov, iovcnt);
+}
+
+int writev(int fd, const struct iovec* iov, int iovcnt) {
+  return syscall3(SYS_WRITEV, fd, iov, iovcnt);
+}
+
+int pread(int fd, void* buffer, unsigned size, unsigned offset) {
+  return syscall4(SYS_PREAD, fd, buffer, size, offset);
+}
+
+int pwrite(int fd, const void* buffer, unsigned size, unsigned offset) {
+  return syscall4(SYS_PWRITE, fd, buffer, size, offset);
+}
+
+pid_t spawn(const char* file) { return (pid_t)syscall1(SYS_SPAWN, file); }
+
+int pipe(int fds[2]) { return syscall1(SYS_PIPE, fds); }
+
+int shmget(int key, unsigned size) { return syscall2(SYS_SHMGET, key, size); }
+
+void* shmat(int id, void* addr) { return (void*)syscall2(SYS_SHMAT, id, addr); }
+
+int shmdt(const void* addr) { return syscall1(SYS_SHMDT, addr); }
+
+bool sysenter_available(void) { return syscall0(SYS_SYSENTER); }
+
+struct io_ring* ioring_setup(void* addr) {
+  return (struct io_ring*)syscall1(SYS_IORING_SETUP, addr);
+}
+
+int ioring_enter(void) { return syscall0(SYS_IORING_ENTER); }
+
+void* sbrk(intptr_t increment) { return (void*)syscall1(SYS_SBRK, increment); }
+
+int brk(void* addr) {
+  uint8_t* end = sbrk(0);
+
+  return sbrk((uint8_t*)addr - end) == (void*)-1 ? -1 : 0;
+}
+
+unsigned getrlimit(int resource) { return syscall1(SYS_GETRLIMIT, resource); }
+
+bool setrlimit(int resource, unsigned limit) { return syscall2(SYS_SETRLIMIT, resource, limit); }
+
+bool strace(bool on) { return syscall1(SYS_STRACE, on); }
+
+bool blkstat(int role, struct blkstat* stats) { return syscall2(SYS_BLKSTAT, role, stats); }
+
+bool pmu_setup(const unsigned events[PMU_COUNTER_CNT], int mode) {
+  return syscall2(SYS_PMU_SETUP, events, mode);
+}
+
+unsigned pmu_read(uint64_t counts[PMU_COUNTER_CNT]) { return syscall1(SYS_PMU_READ, counts); }
+
+bool futex_wait(int* addr, int val) { return syscall2(SYS_FUTEX_WAIT, addr, val); }
+
+int futex_wake(int* addr, int cnt) { return syscall2(SYS_FUTEX_WAKE, addr, cnt); }
+
+/* Runs FN(AUX) in a new thread and exits the thread with what FN
+   returns. */
+static void thread_start(int (*fn)(void*), void* aux) { thread_exit(fn(aux)); }
+
+/* Starts a thread of this process that runs FN(AUX) on the SIZE
+   bytes of STACK, which must stay allocated until thread_join()
+   says that the thread has exited.  The thread's first frame is
+   laid out as if thread_start() had been called. */
+tid_t thread_create(int (*fn)(void*), void* aux, void* stack, size_t size) {
+  void** sp = (void**)(((uintptr_t)stack + size) & ~(uintptr_t)15);
+
+  *--sp = aux;
+  *--sp = fn;
+  *--sp = NULL; /* Return address. */
+  return (tid_t)syscall2(SYS_THREAD_CREATE, thread_start, sp);
+}
+
+int thread_join(tid_t tid) { return syscall1(SYS_THREAD_JOIN, tid); }
+
+void thread_exit(int status) {
+  syscall1(SYS_THREAD_EXIT, status);
+  NOT_REACHED();
+}
+
+bool sched_deadline(unsigned runtime, unsigned deadline, unsigned period) {
+  return syscall3(SYS_SCHED_DEADLINE, runtime, deadline, period);
+}
+
+void sched_yield(void) { syscall0(SYS_SCHED_YIELD); }
+
+bool setaffinity(unsigned mask) { return syscall1(SYS_SETAFFINITY, mask); }
+
+int nice(int increment) { return syscall1(SYS_NICE, increment); }
+
+int getnice(void) { return syscall0(SYS_GETNICE); }
+
+int kstat(struct kstat* stats, int cnt) { return syscall2(SYS_KSTAT, stats, cnt); }
+
+int poll(struct pollfd* fds, int nfds, int timeout) {
+  return syscall3(SYS_POLL, fds, nfds, timeout);
+}
+
+int fcntl(int fd, int cmd, int arg) { return syscall3(SYS_FCNTL, fd, cmd, arg); }
+
+bool gettunable(const char* name, unsigned* value) {
+  return syscall2(SYS_GETTUNABLE, name, value);
+}
+
+bool settunable(const char* name, unsigned value) {
+  return syscall2(SYS_SETTUNABLE, name, value);
+}
+
+int copy_file_range(int fd_in, int fd_out, unsigned len) {
+  return syscall3(SYS_COPY_FILE_RANGE, fd_in, fd_out, len);
+}
+
+int open_flags(const char* file, int flags) { return syscall2(SYS_OPEN_FLAGS, file, flags); }
+
+bool fallocate(int fd, unsigned length) { return syscall2(SYS_FALLOCATE, fd, length); }
+
+int getdents(int fd, struct dirent* entries, unsigned cnt) {
+  return syscall3(SYS_GETDENTS, fd, entries, cnt);
+}
+
+bool madvise(void* addr, unsigned length, int advice) {
+  return syscall3(SYS_MADVISE, addr, length, advice);
+}
+
+bool fadvise(int fd, unsigned offset, unsigned length, int advice) {
+  return syscall4(SYS_FADVISE, fd, offset, length, advice);
+}
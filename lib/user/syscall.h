@@ -3,11 +3,28 @@
 
 #include <stdbool.h>
 #include <debug.h>
+#include <blkstat.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <ioring.h>
+#include <iovec.h>
+#include <kstat.h>
+#include <mman.h>
+#include <pmu.h>
+#include <poll.h>
+#include <rlimit.h>
+#include <rusage.h>
+#include <stddef.h>
+#include <stdint.h>
 
 /* Process identifier. */
 typedef int pid_t;
 #define PID_ERROR ((pid_t)-1)
 
+/* Thread identifier. */
+typedef int tid_t;
+#define TID_ERROR ((tid_t)-1)
+
 /* Map region identifier. */
 typedef int mapid_t;
 #define MAP_FAILED ((mapid_t)-1)
@@ -24,6 +41,7 @@ void halt(void) NO_RETURN;
 void exit(int status) NO_RETURN;
 pid_t exec(const char* file);
 int wait(pid_t);
+pid_t waitany(int* status, bool block);
 bool create(const char* file, unsigned initial_size);
 bool remove(const char* file);
 int open(const char* file);
@@ -45,4 +63,61 @@ bool readdir(int fd, char name[READDIR_MAX_LEN + 1]);
 bool isdir(int fd);
 int inumber(int fd);
 
+/* Extensions. */
+int getrusage(struct rusage*);
+pid_t fork(void);
+int readv(int fd, const struct iovec* iov, int iovcnt);
+int writev(int fd, const struct iovec* iov, int iovcnt);
+int pread(int fd, void* buffer, unsigned size, unsigned offset);
+int pwrite(int fd, const void* buffer, unsigned size, unsigned offset);
+pid_t spawn(const char* file);
+int pipe(int fds[2]);
+int shmget(int key, unsigned size);
+void* shmat(int id, void* addr);
+int shmdt(const void* addr);
+bool sysenter_available(void);
+struct io_ring* ioring_setup(void* addr);
+int ioring_enter(void);
+void* sbrk(intptr_t increment);
+int brk(void* addr);
+unsigned getrlimit(int resource);
+bool setrlimit(int resource, unsigned limit);
+bool strace(bool on);
+bool blkstat(int role, struct blkstat*);
+bool pmu_setup(const unsigned events[PMU_COUNTER_CNT], int mode);
+unsigned pmu_read(uint64_t counts[PMU_COUNTER_CNT]);
+bool futex_wait(int* addr, int val);
+int futex_wake(int* addr, int cnt);
+tid_t thread_create(int (*fn)(void*), void* aux, void* stack, size_t size);
+int thread_join(tid_t);
+void thread_exit(int status) NO_RETURN;
+bool sched_deadline(unsigned runtime, unsigned deadline, unsigned period);
+void sched_yield(void);
+bool setaffinity(unsigned mask);
+int nice(int increment);
+int getnice(void);
+int kstat(struct kstat* stats, int cnt);
+int poll(struct pollfd* fds, int nfds, int timeout);
+int fcntl(int fd, int cmd, int arg);
+bool gettunable(const char* name, unsigned* value);
+bool settunable(const char* name, unsigned value);
+int copy_file_range(int fd_in, int fd_out, unsigned len);
+int open_flags(const char* file, int flags);
+bool fallocate(int fd, unsigned length);
+int getdents(int fd, struct dirent* entries, unsigned cnt);
+bool madvise(void* addr, unsigned length, int advice);
+bool fadvise(int fd, unsigned offset, unsigned length, int advice);
+
+/* Read from the kernel's shared page (see lib/user/vdso.c),
+   without a system call. */
+long long clock_ns(void);
+long long clock_ticks(void);
+int load_avg(void);
+pid_t getpid(void);
+tid_t gettid(void);
+
+/* Make system calls with sysenter instead of int $0x30?  Set at
+   startup if sysenter_available() says so. */
+extern bool syscall_sysenter;
+
 #endif /* lib/user/syscall.h */
@@ -0,0 +1,82 @@
+#include <syscall.h>
+#include <vdso.h>
+
+/* Queries answered from the kernel's shared page, which the
+   kernel maps into every process at VDSO_ADDR (see lib/vdso.h).
+   Each is a few loads, with no system call.  Like the kernel's
+   sequence locks, the clock readers copy the fields they need
+   and copy them again if the kernel changed them meanwhile. */
+
+/* Optimization barrier. */
+#define barrier() asm volatile("" : : : "memory")
+
+static unsigned read_begin(void);
+static bool read_retry(unsigned seq);
+
+/* Returns the number of nanoseconds since the OS booted, as
+   the kernel's timer_ns() does: to a CPU cycle, once the kernel
+   has calibrated the TSC, and to a timer tick before. */
+long long clock_ns(void) {
+  int64_t ticks, tsc_ticks;
+  uint64_t tsc_hz, tsc_start, cycles;
+  int freq;
+  unsigned seq;
+
+  do {
+    seq = read_begin();
+    ticks = VDSO_ADDR->ticks;
+    freq = VDSO_ADDR->timer_freq;
+    tsc_hz = VDSO_ADDR->tsc_hz;
+    tsc_start = VDSO_ADDR->tsc_start;
+    tsc_ticks = VDSO_ADDR->tsc_ticks;
+  } while (read_retry(seq));
+
+  if (tsc_hz == 0)
+    return ticks * (1000000000 / freq);
+
+  asm volatile("rdtsc" : "=A"(cycles));
+  cycles -= tsc_start;
+  return tsc_ticks * (1000000000 / freq) + cycles / tsc_hz * 1000000000
+         + cycles % tsc_hz * 1000000000 / tsc_hz;
+}
+
+/* Returns the number of timer ticks since the OS booted. */
+long long clock_ticks(void) {
+  int64_t ticks;
+  unsigned seq;
+
+  do {
+    seq = read_begin();
+    ticks = VDSO_ADDR->ticks;
+  } while (read_retry(seq));
+  return ticks;
+}
+
+/* Returns 100 times the system load average. */
+int load_avg(void) { return VDSO_ADDR->load_avg; }
+
+/* Returns the running process's id. */
+pid_t getpid(void) { return VDSO_ADDR->pid; }
+
+/* Returns the running thread's id, which for a process's main
+   thread is the process id. */
+tid_t gettid(void) { return VDSO_ADDR->tid; }
+
+/* Starts a read of the clock fields, waiting for the kernel to
+   finish changing them, and returns the sequence number to pass
+   to read_retry(). */
+static unsigned read_begin(void) {
+  unsigned seq;
+
+  while ((seq = VDSO_ADDR->seq) % 2 != 0)
+    continue;
+  barrier();
+  return seq;
+}
+
+/* Returns true if the clock fields may have changed since
+   read_begin() returned SEQ. */
+static bool read_retry(unsigned seq) {
+  barrier();
+  return VDSO_ADDR->seq != seq;
+}
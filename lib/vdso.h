@@ -0,0 +1,29 @@
+#ifndef __LIB_VDSO_H
+#define __LIB_VDSO_H
+
+#include <stdint.h>
+
+/* The kernel's shared page, which the kernel maps read-only into
+   every process at VDSO_ADDR and keeps up to date, so that a
+   program can read the time and its ids without a system call.
+
+   The kernel bumps SEQ to an odd number before it changes the
+   clock fields and to an even number after, so a reader copies
+   them while SEQ is even and copies them again if SEQ changed
+   meanwhile.  TID and PID are set at each switch to a thread,
+   before it runs, so a thread always reads its own. */
+#define VDSO_ADDR ((const struct vdso_data*)0x08000000)
+
+struct vdso_data {
+  volatile unsigned seq; /* Odd while the kernel changes the clock. */
+  int64_t ticks;         /* Timer ticks since boot. */
+  int timer_freq;        /* Timer ticks per second. */
+  uint64_t tsc_hz;       /* TSC cycles per second, or 0 if the TSC clock is off. */
+  uint64_t tsc_start;    /* TSC when the TSC clock started. */
+  int64_t tsc_ticks;     /* Timer ticks when the TSC clock started. */
+  int load_avg;          /* System load average, times 100. */
+  int tid;               /* Running thread's id. */
+  int pid;               /* Running thread's process id. */
+};
+
+#endif /* lib/vdso.h */
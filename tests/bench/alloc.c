@@ -0,0 +1,47 @@
+/* Measures the page allocator and the block allocator: pairs of
+   palloc_get_page() and palloc_free_page(), and pairs of
+   malloc() and free() at a small and a medium block size. */
+
+#include "tests/bench/bench.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+
+/* Allocate/free pairs per round. */
+#define PALLOC_CNT 20000
+#define MALLOC_CNT 50000
+
+static void bench_malloc(const char* operation, size_t size);
+
+void test_bench_alloc(void) {
+  uint64_t start;
+  int i;
+
+  start = bench_cycles();
+  for (i = 0; i < PALLOC_CNT; i++) {
+    void* page = palloc_get_page(0);
+    if (page == NULL)
+      fail("palloc_get_page() failed");
+    palloc_free_page(page);
+  }
+  bench_report("palloc-page", bench_cycles() - start, PALLOC_CNT);
+
+  bench_malloc("malloc-32", 32);
+  bench_malloc("malloc-512", 512);
+
+  pass();
+}
+
+/* Reports the cost of malloc(SIZE) and free() as OPERATION. */
+static void bench_malloc(const char* operation, size_t size) {
+  uint64_t start;
+  int i;
+
+  start = bench_cycles();
+  for (i = 0; i < MALLOC_CNT; i++) {
+    void* p = malloc(size);
+    if (p == NULL)
+      fail("malloc(%zu) failed", size);
+    free(p);
+  }
+  bench_report(operation, bench_cycles() - start, MALLOC_CNT);
+}
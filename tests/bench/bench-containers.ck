@@ -0,0 +1,4 @@
+# -*- perl -*-
+use tests::tests;
+use tests::bench::bench;
+check_bench ('hash-insert', 'hash-find', 'hash-delete', 'list-push-pop', 'bitmap-claim-release');
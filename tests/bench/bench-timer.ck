@@ -0,0 +1,4 @@
+# -*- perl -*-
+use tests::tests;
+use tests::bench::bench;
+check_bench ('timer-sleep-wakeup', 'timer-nsleep-wakeup');
@@ -0,0 +1,18 @@
+#include "tests/bench/bench.h"
+#include "tests/threads/tests.h"
+#include "devices/timer.h"
+
+/* Returns the time stamp counter.  Fails the benchmark if the
+   CPU has none, or the timer has not calibrated it. */
+uint64_t bench_cycles(void) {
+  uint64_t cycles = timer_cycles();
+
+  if (cycles == 0)
+    fail("no time stamp counter");
+  return cycles;
+}
+
+/* Reports that OP_CNT of OPERATION took CYCLES cycles in all. */
+void bench_report(const char* operation, uint64_t cycles, unsigned op_cnt) {
+  msg("bench: %s %llu cycles/op", operation, cycles / op_cnt);
+}
@@ -0,0 +1,31 @@
+#ifndef TESTS_BENCH_BENCH_H
+#define TESTS_BENCH_BENCH_H
+
+#include <stdint.h>
+#include "tests/threads/tests.h"
+
+/* Kernel microbenchmarks.
+
+   Each benchmark times a loop of operations with the CPU's time
+   stamp counter and reports the average cost of one operation
+   with bench_report(), as a line of the form
+
+      (bench-NAME) bench: OPERATION CYCLES cycles/op
+
+   which "make bench" collects into the file `benchmarks', one
+   "OPERATION CYCLES" line per operation, for comparison across
+   builds.  The numbers depend on the host, so a benchmark only
+   fails if the code it measures misbehaves. */
+
+extern test_func test_bench_context_switch;
+extern test_func test_bench_lock;
+extern test_func test_bench_sema;
+extern test_func test_bench_timer;
+extern test_func test_bench_alloc;
+extern test_func test_bench_containers;
+extern test_func test_bench_thread_create;
+
+uint64_t bench_cycles(void);
+void bench_report(const char* operation, uint64_t cycles, unsigned op_cnt);
+
+#endif /* tests/bench/bench.h */
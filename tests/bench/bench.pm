@@ -0,0 +1,19 @@
+sub check_bench {
+    my (@operations) = @_;
+    our ($test);
+    my ($name) = $test =~ m%([^/]+)$%;
+
+    my (@output) = read_text_file ("$test.output");
+    common_checks ("run", @output);
+
+    @output = get_core_output ("run", @output);
+    foreach my $op (@operations) {
+	fail "missing result for $op"
+	  unless grep (/^\($name\) bench: \Q$op\E \d+ cycles\/op$/, @output);
+    }
+    fail "missing PASS in output"
+      unless grep ($_ eq "($name) PASS", @output);
+    pass;
+}
+
+1;
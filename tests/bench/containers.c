@@ -0,0 +1,132 @@
+/* Measures the kernel's container libraries: inserting into,
+   looking up in and deleting from a hash table; pushing onto and
+   popping off a list; and claiming and releasing bits in a
+   bitmap with bitmap_scan_and_flip(). */
+
+#include <bitmap.h>
+#include <debug.h>
+#include <hash.h>
+#include <list.h>
+#include "tests/bench/bench.h"
+
+/* Elements per round. */
+#define ELEM_CNT 1024
+
+/* Rounds over the elements. */
+#define ROUND_CNT 20
+
+struct item {
+  struct hash_elem hash_elem; /* Element in the hash table. */
+  struct list_elem list_elem; /* Element in the list. */
+  int key;                    /* Hash key. */
+};
+
+static struct item items[ELEM_CNT];
+
+static hash_hash_func item_hash;
+static hash_less_func item_less;
+static void bench_hash(void);
+static void bench_list(void);
+static void bench_bitmap(void);
+
+void test_bench_containers(void) {
+  int i;
+
+  for (i = 0; i < ELEM_CNT; i++)
+    items[i].key = i * 7919;
+
+  bench_hash();
+  bench_list();
+  bench_bitmap();
+
+  pass();
+}
+
+/* Reports the cost of hash_insert(), hash_find() and
+   hash_delete() on a table that grows to ELEM_CNT elements. */
+static void bench_hash(void) {
+  uint64_t insert = 0, find = 0, delete = 0;
+  struct hash h;
+  int round, i;
+
+  if (!hash_init(&h, item_hash, item_less, NULL))
+    fail("hash_init() failed");
+
+  for (round = 0; round < ROUND_CNT; round++) {
+    uint64_t start;
+
+    start = bench_cycles();
+    for (i = 0; i < ELEM_CNT; i++)
+      hash_insert(&h, &items[i].hash_elem);
+    insert += bench_cycles() - start;
+
+    start = bench_cycles();
+    for (i = 0; i < ELEM_CNT; i++)
+      if (hash_find(&h, &items[i].hash_elem) != &items[i].hash_elem)
+        fail("hash_find() did not find key %d", items[i].key);
+    find += bench_cycles() - start;
+
+    start = bench_cycles();
+    for (i = 0; i < ELEM_CNT; i++)
+      hash_delete(&h, &items[i].hash_elem);
+    delete += bench_cycles() - start;
+  }
+  if (!hash_empty(&h))
+    fail("hash table not empty after deleting everything");
+  hash_destroy(&h, NULL);
+
+  bench_report("hash-insert", insert, ROUND_CNT * ELEM_CNT);
+  bench_report("hash-find", find, ROUND_CNT * ELEM_CNT);
+  bench_report("hash-delete", delete, ROUND_CNT * ELEM_CNT);
+}
+
+/* Reports the cost of list_push_back() and list_pop_front(). */
+static void bench_list(void) {
+  struct list list;
+  uint64_t start;
+  int round, i;
+
+  list_init(&list);
+  start = bench_cycles();
+  for (round = 0; round < ROUND_CNT; round++) {
+    for (i = 0; i < ELEM_CNT; i++)
+      list_push_back(&list, &items[i].list_elem);
+    for (i = 0; i < ELEM_CNT; i++)
+      if (list_pop_front(&list) != &items[i].list_elem)
+        fail("list out of order");
+  }
+  bench_report("list-push-pop", bench_cycles() - start, ROUND_CNT * ELEM_CNT);
+}
+
+/* Reports the cost of claiming a free bit with
+   bitmap_scan_and_flip() in a bitmap that fills up, and of
+   releasing it with bitmap_reset(). */
+static void bench_bitmap(void) {
+  struct bitmap* b = bitmap_create(ELEM_CNT);
+  uint64_t start;
+  int round, i;
+
+  if (b == NULL)
+    fail("bitmap_create() failed");
+
+  start = bench_cycles();
+  for (round = 0; round < ROUND_CNT; round++) {
+    for (i = 0; i < ELEM_CNT; i++)
+      if (bitmap_scan_and_flip(b, 0, 1, false) != (size_t)i)
+        fail("bitmap_scan_and_flip() returned the wrong bit");
+    for (i = 0; i < ELEM_CNT; i++)
+      bitmap_reset(b, i);
+  }
+  bench_report("bitmap-claim-release", bench_cycles() - start, ROUND_CNT * ELEM_CNT);
+  bitmap_destroy(b);
+}
+
+/* Hashes item E's key. */
+static unsigned item_hash(const struct hash_elem* e, void* aux UNUSED) {
+  return hash_int(hash_entry(e, struct item, hash_elem)->key);
+}
+
+/* Returns true if item A's key is less than item B's. */
+static bool item_less(const struct hash_elem* a, const struct hash_elem* b, void* aux UNUSED) {
+  return hash_entry(a, struct item, hash_elem)->key < hash_entry(b, struct item, hash_elem)->key;
+}
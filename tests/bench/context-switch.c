@@ -0,0 +1,38 @@
+/* Measures a context switch: two threads of the same priority
+   take turns with thread_yield(), so that each yield switches
+   to the other thread. */
+
+#include "tests/bench/bench.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+/* Yields per thread. */
+#define YIELD_CNT 20000
+
+static thread_func yield_thread;
+
+void test_bench_context_switch(void) {
+  struct semaphore done;
+  uint64_t start;
+
+  sema_init(&done, 0);
+
+  /* The yielders do not run until we block, after which they
+     only switch to each other until both are done. */
+  start = bench_cycles();
+  thread_create("yielder 1", PRI_DEFAULT, yield_thread, &done);
+  thread_create("yielder 2", PRI_DEFAULT, yield_thread, &done);
+  sema_down(&done);
+  sema_down(&done);
+  bench_report("context-switch", bench_cycles() - start, 2 * YIELD_CNT);
+
+  pass();
+}
+
+static void yield_thread(void* done) {
+  int i;
+
+  for (i = 0; i < YIELD_CNT; i++)
+    thread_yield();
+  sema_up(done);
+}
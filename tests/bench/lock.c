@@ -0,0 +1,58 @@
+/* Measures lock_acquire() followed by lock_release() on a free
+   lock, and the same on a lock that a second thread holds half
+   the time, so that acquisitions block and hand off. */
+
+#include "tests/bench/bench.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+/* Acquisitions per round. */
+#define UNCONTENDED_CNT 100000
+#define CONTENDED_CNT 5000
+
+struct contended_info {
+  struct lock lock;      /* The lock being measured. */
+  struct semaphore done; /* Upped by each thread as it finishes. */
+};
+
+static thread_func contended_thread;
+
+void test_bench_lock(void) {
+  struct contended_info info;
+  struct lock lock;
+  uint64_t start;
+  int i;
+
+  lock_init(&lock);
+  start = bench_cycles();
+  for (i = 0; i < UNCONTENDED_CNT; i++) {
+    lock_acquire(&lock);
+    lock_release(&lock);
+  }
+  bench_report("lock-uncontended", bench_cycles() - start, UNCONTENDED_CNT);
+
+  lock_init(&info.lock);
+  sema_init(&info.done, 0);
+  start = bench_cycles();
+  thread_create("contender 1", PRI_DEFAULT, contended_thread, &info);
+  thread_create("contender 2", PRI_DEFAULT, contended_thread, &info);
+  sema_down(&info.done);
+  sema_down(&info.done);
+  bench_report("lock-contended", bench_cycles() - start, 2 * CONTENDED_CNT);
+
+  pass();
+}
+
+/* Takes turns on INFO's lock with the other contender, yielding
+   while holding it. */
+static void contended_thread(void* info_) {
+  struct contended_info* info = info_;
+  int i;
+
+  for (i = 0; i < CONTENDED_CNT; i++) {
+    lock_acquire(&info->lock);
+    thread_yield();
+    lock_release(&info->lock);
+  }
+  sema_up(&info->done);
+}
@@ -0,0 +1,52 @@
+/* Measures semaphore ping-pong: two threads hand control back
+   and forth through a pair of semaphores, each downing its own
+   and upping the other's, so that every round trip is two
+   sema_up() wakeups and two blocking sema_down() calls. */
+
+#include "tests/bench/bench.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+/* Round trips. */
+#define ROUND_CNT 10000
+
+struct pingpong_info {
+  struct semaphore ping; /* Upped to wake the ponger. */
+  struct semaphore pong; /* Upped to wake the pinger. */
+  struct semaphore done; /* Upped by the ponger as it finishes. */
+};
+
+static thread_func pong_thread;
+
+void test_bench_sema(void) {
+  struct pingpong_info info;
+  uint64_t start;
+  int i;
+
+  sema_init(&info.ping, 0);
+  sema_init(&info.pong, 0);
+  sema_init(&info.done, 0);
+  thread_create("ponger", PRI_DEFAULT, pong_thread, &info);
+
+  start = bench_cycles();
+  for (i = 0; i < ROUND_CNT; i++) {
+    sema_up(&info.ping);
+    sema_down(&info.pong);
+  }
+  bench_report("sema-round-trip", bench_cycles() - start, ROUND_CNT);
+  sema_down(&info.done);
+
+  pass();
+}
+
+/* Answers each ping in INFO with a pong. */
+static void pong_thread(void* info_) {
+  struct pingpong_info* info = info_;
+  int i;
+
+  for (i = 0; i < ROUND_CNT; i++) {
+    sema_down(&info->ping);
+    sema_up(&info->pong);
+  }
+  sema_up(&info->done);
+}
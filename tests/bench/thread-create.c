@@ -0,0 +1,54 @@
+/* Measures creating short-lived kernel threads and letting them
+   exit, in bursts of BURST_CNT workers: one thread_create() per
+   worker, then one thread_create_batch() per burst. */
+
+#include "tests/bench/bench.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+/* Workers per burst, and bursts per round. */
+#define BURST_CNT 16
+#define ROUND_CNT 200
+
+static thread_func worker_thread;
+
+void test_bench_thread_create(void) {
+  struct semaphore done;
+  void* aux[BURST_CNT];
+  tid_t tids[BURST_CNT];
+  uint64_t start;
+  int i, j;
+
+  sema_init(&done, 0);
+  for (i = 0; i < BURST_CNT; i++)
+    aux[i] = &done;
+
+  /* The workers have our priority, so they do not run until we
+     block. */
+  start = bench_cycles();
+  for (i = 0; i < ROUND_CNT; i++) {
+    for (j = 0; j < BURST_CNT; j++)
+      if (thread_create("worker", PRI_DEFAULT, worker_thread, &done) == TID_ERROR)
+        fail("thread_create() failed");
+    for (j = 0; j < BURST_CNT; j++)
+      sema_down(&done);
+  }
+  bench_report("thread-create", bench_cycles() - start, ROUND_CNT * BURST_CNT);
+
+  start = bench_cycles();
+  for (i = 0; i < ROUND_CNT; i++) {
+    if (thread_create_batch("worker", PRI_DEFAULT, worker_thread, aux, tids, BURST_CNT)
+        != BURST_CNT)
+      fail("thread_create_batch() failed");
+    for (j = 1; j < BURST_CNT; j++)
+      if (tids[j] != tids[0] + j)
+        fail("batch tids are not consecutive");
+    for (j = 0; j < BURST_CNT; j++)
+      sema_down(&done);
+  }
+  bench_report("thread-create-batch", bench_cycles() - start, ROUND_CNT * BURST_CNT);
+
+  pass();
+}
+
+static void worker_thread(void* done) { sema_up(done); }
@@ -0,0 +1,59 @@
+/* Measures how late sleeping threads wake up.
+
+   The tick round waits for a timer tick, so that it starts just
+   after one, and then calls timer_sleep(1), which should return
+   exactly one tick later.  The high-resolution round calls
+   timer_nsleep() for less than a tick.  Either way, the time
+   beyond what was asked for is the latency of the wakeup: the
+   timer interrupt, the deferred wakeup work and the switch back
+   to the sleeper. */
+
+#include "tests/bench/bench.h"
+#include "devices/timer.h"
+
+/* Sleeps per round. */
+#define SLEEP_CNT 50
+
+/* Length of a high-resolution sleep, in nanoseconds. */
+#define HR_SLEEP_NS 200000
+
+static uint64_t overshoot(uint64_t cycles, int64_t ns);
+
+void test_bench_timer(void) {
+  uint64_t late;
+  int i;
+
+  late = 0;
+  for (i = 0; i < SLEEP_CNT; i++) {
+    int64_t tick = timer_ticks();
+    uint64_t start;
+
+    while (timer_ticks() == tick)
+      continue;
+    start = bench_cycles();
+    timer_sleep(1);
+    late += overshoot(bench_cycles() - start, 1000000000 / TIMER_FREQ);
+  }
+  bench_report("timer-sleep-wakeup", late, SLEEP_CNT);
+
+  late = 0;
+  for (i = 0; i < SLEEP_CNT; i++) {
+    uint64_t start = bench_cycles();
+
+    timer_nsleep(HR_SLEEP_NS);
+    late += overshoot(bench_cycles() - start, HR_SLEEP_NS);
+  }
+  bench_report("timer-nsleep-wakeup", late, SLEEP_CNT);
+
+  pass();
+}
+
+/* Returns how many of CYCLES went beyond NS nanoseconds, or 0 if
+   none did. */
+static uint64_t overshoot(uint64_t cycles, int64_t ns) {
+  int64_t elapsed_ns = timer_cycles_ns(cycles);
+
+  if (elapsed_ns <= ns)
+    return 0;
+  return cycles - cycles * ns / elapsed_ns;
+}
@@ -0,0 +1,175 @@
+/* Test program for lib/kernel/rbtree.c.
+
+   Inserts and erases elements in random order, checking after
+   each step that the tree still follows the red-black rules and
+   holds exactly the expected elements in order, and checks the
+   lookup functions against the expected elements.
+
+   This is not a test we will run on your submitted projects.
+   It is here for completeness.
+*/
+
+#undef NDEBUG
+#include <debug.h>
+#include <random.h>
+#include <rbtree.h>
+#include <stdio.h>
+#include "threads/test.h"
+
+/* Maximum number of elements in a tree that we will test. */
+#define MAX_SIZE 64
+
+/* A tree element. */
+struct value {
+  struct rb_elem elem; /* Tree element. */
+  int value;           /* Item value. */
+  bool in_tree;        /* Is this value in the tree? */
+};
+
+static void shuffle(struct value*[], size_t);
+static bool value_less(const struct rb_elem*, const struct rb_elem*, void*);
+static int verify_subtree(struct rb_elem*, struct rb_elem* parent);
+static void verify_tree(struct rb_tree*, struct value[], int size);
+
+/* Test the red-black tree implementation. */
+void test(void) {
+  int size;
+
+  printf("testing various size trees:");
+  for (size = 0; size < MAX_SIZE; size++) {
+    int repeat;
+
+    printf(" %d", size);
+    for (repeat = 0; repeat < 10; repeat++) {
+      static struct value values[MAX_SIZE];
+      static struct value* order[MAX_SIZE];
+      struct rb_tree tree;
+      int i;
+
+      /* Put the even values 0...2*(SIZE-1) in VALUES, so that
+         the odd values fall between them, and put them in random
+         order in ORDER. */
+      for (i = 0; i < size; i++) {
+        values[i].value = i * 2;
+        values[i].in_tree = false;
+        order[i] = &values[i];
+      }
+      shuffle(order, size);
+
+      /* Insert them, and an equal duplicate of each, which must
+         be refused. */
+      rb_init(&tree, value_less, NULL);
+      for (i = 0; i < size; i++) {
+        struct value dup;
+
+        ASSERT(rb_insert(&tree, &order[i]->elem) == NULL);
+        order[i]->in_tree = true;
+        dup.value = order[i]->value;
+        ASSERT(rb_insert(&tree, &dup.elem) == &order[i]->elem);
+        verify_tree(&tree, values, size);
+      }
+
+      /* Look up each value and each value in between. */
+      for (i = -1; i < size * 2; i++) {
+        int next = i < 0 ? 0 : i / 2 + 1; /* Index of the first value above I. */
+        struct value key;
+        struct rb_elem *found, *lower, *upper;
+
+        key.value = i;
+        found = rb_find(&tree, &key.elem);
+        lower = rb_lower_bound(&tree, &key.elem);
+        upper = rb_upper_bound(&tree, &key.elem);
+        if (i >= 0 && i % 2 == 0) {
+          ASSERT(found != NULL && rb_entry(found, struct value, elem)->value == i);
+          ASSERT(lower == found);
+        } else {
+          ASSERT(found == NULL);
+          ASSERT(lower == upper);
+        }
+        ASSERT(next < size ? rb_entry(upper, struct value, elem)->value == next * 2
+                           : upper == NULL);
+      }
+
+      /* Erase them in a different random order. */
+      shuffle(order, size);
+      for (i = 0; i < size; i++) {
+        rb_erase(&tree, &order[i]->elem);
+        order[i]->in_tree = false;
+        verify_tree(&tree, values, size);
+      }
+      ASSERT(rb_empty(&tree));
+    }
+  }
+
+  printf(" done\n");
+  printf("rbtree: PASS\n");
+}
+
+/* Shuffles the CNT elements in ARRAY into random order. */
+static void shuffle(struct value** array, size_t cnt) {
+  size_t i;
+
+  for (i = 0; i < cnt; i++) {
+    size_t j = i + random_ulong() % (cnt - i);
+    struct value* t = array[j];
+    array[j] = array[i];
+    array[i] = t;
+  }
+}
+
+/* Returns true if value A is less than value B, false
+   otherwise. */
+static bool value_less(const struct rb_elem* a_, const struct rb_elem* b_, void* aux UNUSED) {
+  const struct value* a = rb_entry(a_, struct value, elem);
+  const struct value* b = rb_entry(b_, struct value, elem);
+
+  return a->value < b->value;
+}
+
+/* Verifies that the subtree rooted at E, whose parent is PARENT,
+   is linked correctly and follows the red-black rules, and
+   returns the number of black elements on each path from E down
+   to a missing child. */
+static int verify_subtree(struct rb_elem* e, struct rb_elem* parent) {
+  int left, right;
+
+  if (e == NULL)
+    return 1;
+  ASSERT(e->parent == parent);
+  ASSERT(!e->red || parent == NULL || !parent->red);
+  left = verify_subtree(e->left, e);
+  right = verify_subtree(e->right, e);
+  ASSERT(left == right);
+  return left + !e->red;
+}
+
+/* Verifies that TREE follows the red-black rules and holds the
+   values among the SIZE in VALUES that are marked as in it, in
+   increasing order both forward and backward. */
+static void verify_tree(struct rb_tree* tree, struct value values[], int size) {
+  struct rb_elem* e;
+  int i, cnt, prev;
+
+  ASSERT(tree->root == NULL || !tree->root->red);
+  verify_subtree(tree->root, NULL);
+
+  for (i = cnt = 0; i < size; i++)
+    cnt += values[i].in_tree;
+  ASSERT(rb_size(tree) == (size_t)cnt);
+
+  for (i = 0, prev = -1, e = rb_first(tree); e != NULL; i++, e = rb_next(e)) {
+    struct value* v = rb_entry(e, struct value, elem);
+    ASSERT(v->in_tree);
+    ASSERT(v->value > prev);
+    prev = v->value;
+  }
+  ASSERT(i == cnt);
+
+  for (i = 0, prev = 2 * MAX_SIZE, e = rb_last(tree); e != NULL; i++, e = rb_prev(e)) {
+    struct value* v = rb_entry(e, struct value, elem);
+    ASSERT(v->in_tree);
+    ASSERT(v->value < prev);
+    prev = v->value;
+  }
+  ASSERT(i == cnt);
+}
@@ -0,0 +1,88 @@
+/* Measures how late sub-tick sleeps wake up, and how much CPU
+   time they leave to other threads, for timer_usleep(), which
+   blocks on a high-resolution timer, and timer_udelay(), which
+   busy-waits.
+
+   For each sleep length the main thread sleeps SAMPLES times
+   while a lower-priority thread counts loop iterations, and then
+   reports the mean and spread of the wakeup latency and the
+   iterations the other thread got in.
+
+   The numbers depend on the host, so the test only fails if a
+   sleep returns early. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+/* Sleeps to measure per sleep length and method. */
+#define SAMPLES 50
+
+struct background {
+  volatile bool stop;        /* Set by the main thread to finish. */
+  volatile int64_t progress; /* Loop iterations so far. */
+  struct semaphore done;     /* Upped by the thread as it exits. */
+};
+
+static thread_func background_thread;
+static void measure(const char* name, void (*sleep)(int64_t), int64_t us, struct background*);
+
+void test_alarm_hrtimer(void) {
+  static const int64_t lengths[] = {10, 100, 1000};
+  struct background bg;
+  size_t i;
+
+  ASSERT(!thread_mlfqs);
+
+  bg.stop = false;
+  bg.progress = 0;
+  sema_init(&bg.done, 0);
+  thread_create("background", PRI_DEFAULT - 1, background_thread, &bg);
+
+  for (i = 0; i < sizeof lengths / sizeof *lengths; i++) {
+    measure("usleep", timer_usleep, lengths[i], &bg);
+    measure("udelay", timer_udelay, lengths[i], &bg);
+  }
+
+  bg.stop = true;
+  sema_down(&bg.done);
+  pass();
+}
+
+static void measure(const char* name, void (*sleep)(int64_t), int64_t us, struct background* bg) {
+  int64_t total = 0, min = INT64_MAX, max = 0;
+  int64_t progress = bg->progress;
+  int i;
+
+  for (i = 0; i < SAMPLES; i++) {
+    int64_t start = timer_ns();
+    int64_t late;
+
+    sleep(us);
+    late = timer_ns() - start - us * 1000;
+
+    /* Deadlines within 2 us count as due. */
+    if (late < -2000)
+      fail("%s(%lld) returned %lld ns early", name, us, -late);
+
+    total += late;
+    if (late < min)
+      min = late;
+    if (late > max)
+      max = late;
+  }
+
+  msg("%s(%lld): %lld ns late on average, jitter %lld ns, %lld background loops", name, us,
+      total / SAMPLES, max - min, bg->progress - progress);
+}
+
+static void background_thread(void* bg_) {
+  struct background* bg = bg_;
+
+  while (!bg->stop)
+    bg->progress++;
+  sema_up(&bg->done);
+}
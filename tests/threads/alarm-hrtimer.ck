@@ -0,0 +1,21 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+
+common_checks ("run", @output);
+
+@output = get_core_output ("run", @output);
+for my $how ('usleep', 'udelay') {
+    for my $us (10, 100, 1000) {
+	fail "missing result for $how($us)"
+	  unless grep (/^\(alarm-hrtimer\) $how\($us\): -?\d+ ns late on average, jitter \d+ ns, \d+ background loops$/, @output);
+    }
+}
+fail "missing PASS in output"
+  unless grep ($_ eq '(alarm-hrtimer) PASS', @output);
+
+pass;
@@ -0,0 +1,87 @@
+/* Checks 64-bit division, both GCC's calls into lib/arithmetic.c
+   and the functions of lib/div64.h, on random operands, and times
+   each kind of division that lib/arithmetic.c tells apart.  The
+   times depend on the host, so the test only fails if a result
+   is wrong. */
+
+#include <div64.h>
+#include <random.h>
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/synch.h"
+#include "devices/timer.h"
+
+/* Random operands checked. */
+#define CASE_CNT 100000
+
+/* Divisions timed for each kind. */
+#define DIV_CNT 100000
+
+/* Where timed quotients go, so that they are not optimized away. */
+static volatile uint64_t sink;
+
+static uint64_t random_u64(int bits);
+static void time_divisions(const char* name, uint64_t n, uint64_t d, bool inline_fn);
+
+void test_div_bench(void) {
+  int i;
+
+  random_init(0);
+  for (i = 0; i < CASE_CNT; i++) {
+    uint64_t n = random_u64(1 + random_ulong() % 64);
+    uint64_t d = random_u64(1 + random_ulong() % 64);
+    uint32_t d32 = d;
+    uint64_t q;
+    uint32_t r32;
+    int64_t sn = (int64_t)n >> (1 + random_ulong() % 63);
+    int32_t sd = (int32_t)d32;
+
+    if (d == 0)
+      d = 1;
+    if (d32 == 0)
+      d32 = sd = 1;
+
+    q = n / d;
+    if (q * d + n % d != n || n % d >= d)
+      fail("%llu / %llu: quotient %llu, remainder %llu", n, d, q, n % d);
+    q = div_u64_rem(n, d32, &r32);
+    if (q != n / d32 || r32 != n % d32)
+      fail("%llu / %u: div_u64_rem() gives %llu remainder %u", n, d32, q, r32);
+    if (div_s64(sn, sd) != sn / sd)
+      fail("%lld / %d: div_s64() gives %lld, expected %lld", sn, sd, div_s64(sn, sd), sn / sd);
+    if (sn / sd * sd + sn % sd != sn)
+      fail("%lld %% %d: remainder %lld", sn, sd, sn % sd);
+  }
+  msg("%d random cases agree", CASE_CNT);
+
+  time_divisions("32-bit dividend", 123456789, 100, false);
+  time_divisions("64-bit dividend", 123456789012345ULL, 100, false);
+  time_divisions("64-bit dividend, div_u64()", 123456789012345ULL, 100, true);
+  time_divisions("64-bit divisor", 123456789012345ULL, 12345678901ULL, false);
+  pass();
+}
+
+/* Returns a random number of at most BITS bits. */
+static uint64_t random_u64(int bits) {
+  uint64_t x = (uint64_t)random_ulong() << 32 | (uint32_t)random_ulong();
+  return bits >= 64 ? x : x & ((1ULL << bits) - 1);
+}
+
+/* Times DIV_CNT divisions of N by D, with div_u64() if INLINE_FN
+   is true and with C's division otherwise, and prints the time
+   per division under NAME. */
+static void time_divisions(const char* name, uint64_t n, uint64_t d, bool inline_fn) {
+  volatile uint64_t vn = n, vd = d;
+  int64_t start = timer_ns();
+  int64_t ns;
+  int i;
+
+  if (inline_fn)
+    for (i = 0; i < DIV_CNT; i++)
+      sink = div_u64(vn, vd);
+  else
+    for (i = 0; i < DIV_CNT; i++)
+      sink = vn / vd;
+  ns = (timer_ns() - start) * 100 / DIV_CNT;
+  msg("%s: %lld.%02lld ns per division", name, ns / 100, ns % 100);
+}
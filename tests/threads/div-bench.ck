@@ -0,0 +1,18 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+
+common_checks ("run", @output);
+
+@output = get_core_output ("run", @output);
+fail "missing result lines"
+  unless grep ($_ eq '(div-bench) 100000 random cases agree', @output)
+    && grep (/^\(div-bench\) [^:]+: \d+\.\d\d ns per division$/, @output) == 4;
+fail "missing PASS in output"
+  unless grep ($_ eq '(div-bench) PASS', @output);
+
+pass;
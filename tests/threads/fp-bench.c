@@ -0,0 +1,117 @@
+/* Checks the fixed-point functions of lib/fp_arithmetic.h against
+   the plain 64-bit arithmetic that they replace, on random
+   operands, and times the once a second recent_cpu update both
+   ways.  The times depend on the host, so the test only fails if
+   a result differs. */
+
+#include <fp_arithmetic.h>
+#include <random.h>
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/synch.h"
+#include "devices/timer.h"
+
+/* The arithmetic as the documentation gives it, with C's 64-bit
+   division, which i386 does by calling __divdi3(). */
+#define F (1 << FP_SHIFT)
+#define REF_MULTIPLY(X, Y) ((int32_t)((int64_t)(X) * (Y) / F))
+#define REF_DIVIDE(X, Y) ((int32_t)((int64_t)(X) * F / (Y)))
+#define REF_ROUND(X) ((X) >= 0 ? ((X) + F / 2) / F : ((X) - F / 2) / F)
+
+/* Random operands checked. */
+#define CASE_CNT 100000
+
+/* Threads and seconds in the timed recent_cpu updates. */
+#define THREAD_CNT 64
+#define ROUND_CNT 10000
+
+static int32_t random_raw(int32_t limit);
+static int64_t time_reference(int32_t recent_cpu[], int32_t load_avg);
+static int64_t time_inline(fixed_t recent_cpu[], fixed_t load_avg);
+
+void test_fp_bench(void) {
+  static int32_t ref_cpu[THREAD_CNT];
+  static fixed_t fp_cpu[THREAD_CNT];
+  int64_t ref_ns, fp_ns;
+  int i;
+
+  random_init(0);
+  for (i = 0; i < CASE_CNT; i++) {
+    int32_t x = random_raw(1 << 20);
+    int32_t y = random_raw(1 << 20);
+    int32_t d = random_raw(1 << 20);
+    int n = random_raw(100);
+
+    /* Keep quotients within 32 bits. */
+    if (d > -(1 << 12) && d < (1 << 12))
+      d = d < 0 ? d - (1 << 12) : d + (1 << 12);
+    if (n == 0)
+      n = 1;
+
+    if (fp_mul(fp_raw(x), fp_raw(y)).raw != REF_MULTIPLY(x, y))
+      fail("%d * %d: got %d, expected %d", x, y, fp_mul(fp_raw(x), fp_raw(y)).raw,
+           REF_MULTIPLY(x, y));
+    if (fp_div(fp_raw(x), fp_raw(d)).raw != REF_DIVIDE(x, d))
+      fail("%d / %d: got %d, expected %d", x, d, fp_div(fp_raw(x), fp_raw(d)).raw,
+           REF_DIVIDE(x, d));
+    if (fp_div_int(fp_raw(x), n).raw != x / n)
+      fail("%d / int %d: got %d, expected %d", x, n, fp_div_int(fp_raw(x), n).raw, x / n);
+    if (fp_trunc(fp_raw(x)) != x / F)
+      fail("trunc %d: got %d, expected %d", x, fp_trunc(fp_raw(x)), x / F);
+    if (fp_round(fp_raw(x)) != REF_ROUND(x))
+      fail("round %d: got %d, expected %d", x, fp_round(fp_raw(x)), REF_ROUND(x));
+  }
+  msg("%d random cases agree", CASE_CNT);
+
+  for (i = 0; i < THREAD_CNT; i++) {
+    ref_cpu[i] = random_raw(100 * F);
+    fp_cpu[i] = fp_raw(ref_cpu[i]);
+  }
+  ref_ns = time_reference(ref_cpu, 3 * F / 2);
+  fp_ns = time_inline(fp_cpu, fp_raw(3 * F / 2));
+  for (i = 0; i < THREAD_CNT; i++)
+    if (fp_cpu[i].raw != ref_cpu[i])
+      fail("thread %d: recent_cpu %d, expected %d", i, fp_cpu[i].raw, ref_cpu[i]);
+  msg("recent_cpu update of %d threads: 64-bit division %lld ns, inline %lld ns", THREAD_CNT,
+      ref_ns / ROUND_CNT, fp_ns / ROUND_CNT);
+  pass();
+}
+
+/* Returns a random representation between -LIMIT and LIMIT. */
+static int32_t random_raw(int32_t limit) {
+  return (int32_t)(random_ulong() % (2 * (unsigned long)limit + 1)) - limit;
+}
+
+/* Runs ROUND_CNT recent_cpu updates on RECENT_CPU, with the
+   given LOAD_AVG and a nice of 1, in the plain arithmetic.
+   Returns the time taken. */
+static int64_t time_reference(int32_t recent_cpu[], int32_t load_avg) {
+  int64_t start = timer_ns();
+  int r, i;
+
+  for (r = 0; r < ROUND_CNT; r++) {
+    int32_t coefficient = REF_DIVIDE(load_avg * 2, load_avg * 2 + F);
+
+    for (i = 0; i < THREAD_CNT; i++)
+      recent_cpu[i] = REF_MULTIPLY(coefficient, recent_cpu[i]) + F;
+    barrier();
+  }
+  return timer_ns() - start;
+}
+
+/* Runs the same updates as time_reference() with the functions
+   of lib/fp_arithmetic.h. */
+static int64_t time_inline(fixed_t recent_cpu[], fixed_t load_avg) {
+  int64_t start = timer_ns();
+  int r, i;
+
+  for (r = 0; r < ROUND_CNT; r++) {
+    fixed_t twice = fp_mul_int(load_avg, 2);
+    fixed_t coefficient = fp_div(twice, fp_add_int(twice, 1));
+
+    for (i = 0; i < THREAD_CNT; i++)
+      recent_cpu[i] = fp_add_int(fp_mul(coefficient, recent_cpu[i]), 1);
+    barrier();
+  }
+  return timer_ns() - start;
+}
@@ -0,0 +1,19 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+
+common_checks ("run", @output);
+
+@output = get_core_output ("run", @output);
+fail "missing result lines"
+  unless grep ($_ eq '(fp-bench) 100000 random cases agree', @output)
+    && grep (/^\(fp-bench\) recent_cpu update of 64 threads: 64-bit division \d+ ns, inline \d+ ns$/,
+	     @output);
+fail "missing PASS in output"
+  unless grep ($_ eq '(fp-bench) PASS', @output);
+
+pass;
@@ -0,0 +1,72 @@
+/* Measures the cost of lock_acquire() and lock_release().
+
+   The uncontended round takes and releases a free lock in a loop,
+   which stays on the fast path.  The contended round has two
+   threads take turns on the same lock, each yielding while it
+   holds the lock, so that every acquisition has to block.
+
+   The numbers depend on the host, so the test only fails if the
+   lock does not provide mutual exclusion. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+/* Acquisitions per round. */
+#define UNCONTENDED_ITERS 100000
+#define CONTENDED_ITERS 2000
+
+struct contended_info {
+  struct lock lock;      /* The lock being measured. */
+  int owners;            /* Threads inside the critical section. */
+  struct semaphore done; /* Upped by each thread as it finishes. */
+};
+
+static thread_func contended_thread;
+
+void test_lock_bench(void) {
+  struct contended_info info;
+  struct lock lock;
+  int64_t start;
+  int i;
+
+  ASSERT(!thread_mlfqs);
+
+  lock_init(&lock);
+  start = timer_ns();
+  for (i = 0; i < UNCONTENDED_ITERS; i++) {
+    lock_acquire(&lock);
+    lock_release(&lock);
+  }
+  msg("uncontended: %lld ns per acquire/release", (timer_ns() - start) / UNCONTENDED_ITERS);
+
+  lock_init(&info.lock);
+  info.owners = 0;
+  sema_init(&info.done, 0);
+  start = timer_ns();
+  thread_create("contender 1", PRI_DEFAULT, contended_thread, &info);
+  thread_create("contender 2", PRI_DEFAULT, contended_thread, &info);
+  sema_down(&info.done);
+  sema_down(&info.done);
+  msg("contended: %lld ns per acquire/release", (timer_ns() - start) / (2 * CONTENDED_ITERS));
+
+  pass();
+}
+
+static void contended_thread(void* info_) {
+  struct contended_info* info = info_;
+  int i;
+
+  for (i = 0; i < CONTENDED_ITERS; i++) {
+    lock_acquire(&info->lock);
+    if (info->owners++ != 0)
+      fail("two threads hold the lock");
+    thread_yield();
+    info->owners--;
+    lock_release(&info->lock);
+  }
+  sema_up(&info->done);
+}
@@ -0,0 +1,19 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+
+common_checks ("run", @output);
+
+@output = get_core_output ("run", @output);
+for my $round ('uncontended', 'contended') {
+    fail "missing result for $round round"
+      unless grep (/^\(lock-bench\) $round: \d+ ns per acquire\/release$/, @output);
+}
+fail "missing PASS in output"
+  unless grep ($_ eq '(lock-bench) PASS', @output);
+
+pass;
@@ -0,0 +1,65 @@
+/* Measures the throughput of malloc() and free().
+
+   The first round frees each block right after allocating it,
+   which the per-CPU magazines serve without taking a lock.  The
+   second round allocates a batch of blocks and then frees them
+   all, which makes the magazines refill from and drain to the
+   descriptors' free lists.
+
+   The numbers depend on the host, so the test only fails if
+   malloc() fails or hands out overlapping blocks. */
+
+#include <stdio.h>
+#include <string.h>
+#include "tests/threads/tests.h"
+#include "threads/malloc.h"
+#include "devices/timer.h"
+
+/* Allocations per round for each size. */
+#define PAIR_ITERS 20000
+#define BATCH_ITERS 200
+
+/* Blocks allocated at once in the batch round. */
+#define BATCH_SIZE 64
+
+static const size_t sizes[] = {16, 40, 100, 500};
+
+void test_malloc_bench(void) {
+  static void* blocks[BATCH_SIZE];
+  size_t s;
+
+  for (s = 0; s < sizeof sizes / sizeof *sizes; s++) {
+    size_t size = sizes[s];
+    int64_t start;
+    int i, j;
+
+    start = timer_ns();
+    for (i = 0; i < PAIR_ITERS; i++) {
+      void* p = malloc(size);
+      if (p == NULL)
+        fail("malloc(%zu) failed", size);
+      free(p);
+    }
+    msg("%zu bytes, pairs: %lld ns per malloc/free", size, (timer_ns() - start) / PAIR_ITERS);
+
+    start = timer_ns();
+    for (i = 0; i < BATCH_ITERS; i++) {
+      for (j = 0; j < BATCH_SIZE; j++) {
+        blocks[j] = malloc(size);
+        if (blocks[j] == NULL)
+          fail("malloc(%zu) failed", size);
+        memset(blocks[j], j, size);
+      }
+      for (j = 0; j < BATCH_SIZE; j++) {
+        const unsigned char* p = blocks[j];
+        if (p[0] != j || p[size - 1] != j)
+          fail("block %d of %zu bytes was overwritten", j, size);
+        free(blocks[j]);
+      }
+    }
+    msg("%zu bytes, batches: %lld ns per malloc/free", size,
+        (timer_ns() - start) / (BATCH_ITERS * BATCH_SIZE));
+  }
+
+  pass();
+}
@@ -0,0 +1,22 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+
+common_checks ("run", @output);
+
+@output = get_core_output ("run", @output);
+for my $size (16, 40, 100, 500) {
+    for my $round ('pairs', 'batches') {
+	fail "missing result for $size bytes, $round"
+	  unless grep (/^\(malloc-bench\) $size bytes, $round: \d+ ns per malloc\/free$/,
+		       @output);
+    }
+}
+fail "missing PASS in output"
+  unless grep ($_ eq '(malloc-bench) PASS', @output);
+
+pass;
@@ -0,0 +1,107 @@
+/* Measures the bandwidth of memcpy() and memset() on blocks from
+   8 bytes to 64 kB, copying or setting 4 MB in all at each size.
+   The destination is offset by one byte on every other call, so
+   both the aligned and the unaligned paths are timed.
+
+   Before timing, checks memcpy(), memmove() and memset() against
+   byte-by-byte references at every small size and alignment.
+   The numbers depend on the host, so the test only fails if the
+   functions give wrong results. */
+
+#include <stdio.h>
+#include <string.h>
+#include "tests/threads/tests.h"
+#include "threads/palloc.h"
+#include "threads/vaddr.h"
+#include "devices/timer.h"
+
+/* Largest block, in bytes. */
+#define MAX_SIZE (64 * 1024)
+
+/* Bytes moved at each size. */
+#define TOTAL (4 * 1024 * 1024)
+
+/* Pages in each buffer: a block plus room for the offset. */
+#define BUF_PAGES (MAX_SIZE / PGSIZE + 1)
+
+/* Block sizes timed. */
+static const size_t sizes[] = {8, 16, 64, 256, 1024, 4096, 16384, MAX_SIZE};
+
+static void check(unsigned char* src, unsigned char* dst);
+
+void test_memcpy_bench(void) {
+  unsigned char* src = palloc_get_multiple(0, BUF_PAGES);
+  unsigned char* dst = palloc_get_multiple(0, BUF_PAGES);
+  size_t s;
+
+  if (src == NULL || dst == NULL)
+    fail("out of memory");
+  check(src, dst);
+
+  for (s = 0; s < sizeof sizes / sizeof *sizes; s++) {
+    size_t size = sizes[s];
+    size_t cnt = TOTAL / size;
+    int64_t start, copy_ns, set_ns;
+    size_t i;
+
+    start = timer_ns();
+    for (i = 0; i < cnt; i++)
+      memcpy(dst + (i & 1), src, size);
+    copy_ns = timer_ns() - start;
+
+    start = timer_ns();
+    for (i = 0; i < cnt; i++)
+      memset(dst + (i & 1), i, size);
+    set_ns = timer_ns() - start;
+
+    msg("%zu bytes: memcpy %lld MB/s, memset %lld MB/s", size,
+        (long long)TOTAL * 1000 / (copy_ns + 1), (long long)TOTAL * 1000 / (set_ns + 1));
+  }
+
+  palloc_free_multiple(src, BUF_PAGES);
+  palloc_free_multiple(dst, BUF_PAGES);
+  pass();
+}
+
+/* Checks memcpy(), memmove() and memset() on blocks of up to 64
+   bytes at every alignment of source and destination, using
+   SRC and DST as scratch space. */
+static void check(unsigned char* src, unsigned char* dst) {
+  size_t size, so, dof, i;
+
+  for (i = 0; i < 256; i++)
+    src[i] = i * 7 + 1;
+  for (size = 0; size <= 64; size++)
+    for (so = 0; so < 4; so++)
+      for (dof = 0; dof < 4; dof++) {
+        memset(dst, 0, 256);
+        if (memcpy(dst + dof, src + so, size) != dst + dof)
+          fail("memcpy returned the wrong pointer");
+        for (i = 0; i < 256; i++)
+          if (dst[i] != (i >= dof && i < dof + size ? src[so + i - dof] : 0))
+            fail("memcpy of %zu bytes from +%zu to +%zu: wrong byte %zu", size, so, dof, i);
+
+        memset(dst + dof, 0x5a, size);
+        for (i = dof; i < dof + size; i++)
+          if (dst[i] != 0x5a)
+            fail("memset of %zu bytes at +%zu: wrong byte %zu", size, dof, i);
+
+        /* Overlapping moves, in both directions. */
+        memcpy(dst, src, 256);
+        if (memmove(dst + 64 + dof, dst + 64 + so, size) != dst + 64 + dof)
+          fail("memmove returned the wrong pointer");
+        for (i = 0; i < size; i++)
+          if (dst[64 + dof + i] != src[64 + so + i])
+            fail("memmove of %zu bytes from +%zu to +%zu: wrong byte %zu", size, so, dof, i);
+        memcpy(dst, src, 256);
+        memmove(dst + 64 + so, dst + 64 + dof + 8, size);
+        for (i = 0; i < size; i++)
+          if (dst[64 + so + i] != src[64 + dof + 8 + i])
+            fail("memmove of %zu bytes down by %zu: wrong byte %zu", size, dof + 8 - so, i);
+        memcpy(dst, src, 256);
+        memmove(dst + 64 + dof + 8, dst + 64 + so, size);
+        for (i = 0; i < size; i++)
+          if (dst[64 + dof + 8 + i] != src[64 + so + i])
+            fail("memmove of %zu bytes up by %zu: wrong byte %zu", size, dof + 8 - so, i);
+      }
+}
@@ -0,0 +1,18 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+
+common_checks ("run", @output);
+
+@output = get_core_output ("run", @output);
+fail "missing result lines"
+  unless grep (/^\(memcpy-bench\) \d+ bytes: memcpy \d+ MB\/s, memset \d+ MB\/s$/,
+	       @output) == 8;
+fail "missing PASS in output"
+  unless grep ($_ eq '(memcpy-bench) PASS', @output);
+
+pass;
@@ -0,0 +1,81 @@
+/* Measures the cost of a context switch under the MLFQS with
+   10, 100 and 500 ready threads.
+
+   Each round creates the given number of threads, all of which
+   do nothing but call thread_yield() and count how often they
+   got the CPU.  The main thread sleeps for a fixed number of
+   ticks while they run and then reports the number of switches
+   per second and the resulting average switch latency.  With an
+   O(1) run queue the latency should not depend on the number of
+   ready threads.
+
+   The numbers depend on the host, so the test only fails if the
+   threads could not be created or did not run at all. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+/* Ticks to measure for in each round. */
+#define MEASURE_TICKS (2 * TIMER_FREQ)
+
+struct switch_info {
+  volatile bool stop;        /* Set by the main thread to end the round. */
+  volatile int64_t switches; /* Total number of yields that returned. */
+  struct semaphore done;     /* Upped by each thread as it exits. */
+};
+
+static thread_func yield_thread;
+static void measure(int thread_cnt);
+
+void test_mlfqs_switch(void) {
+  ASSERT(thread_mlfqs);
+
+  measure(10);
+  measure(100);
+  measure(500);
+
+  pass();
+}
+
+static void measure(int thread_cnt) {
+  struct switch_info info;
+  int64_t start_ns, elapsed_ns, switches;
+  int i;
+
+  info.stop = false;
+  info.switches = 0;
+  sema_init(&info.done, 0);
+
+  for (i = 0; i < thread_cnt; i++)
+    if (thread_create("yield", PRI_DEFAULT, yield_thread, &info) == TID_ERROR)
+      fail("could not create thread %d of %d", i, thread_cnt);
+
+  start_ns = timer_ns();
+  timer_sleep(MEASURE_TICKS);
+  switches = info.switches;
+  elapsed_ns = timer_ns() - start_ns;
+  info.stop = true;
+
+  for (i = 0; i < thread_cnt; i++)
+    sema_down(&info.done);
+
+  if (switches == 0)
+    fail("%d threads never switched", thread_cnt);
+  msg("%d threads: %lld switches/s, %lld ns/switch", thread_cnt,
+      switches * 1000000000 / elapsed_ns, elapsed_ns / switches);
+}
+
+static void yield_thread(void* info_) {
+  struct switch_info* info = info_;
+
+  while (!info->stop) {
+    thread_yield();
+    info->switches++;
+  }
+  sema_up(&info->done);
+}
@@ -0,0 +1,19 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+
+common_checks ("run", @output);
+
+@output = get_core_output ("run", @output);
+for my $cnt (10, 100, 500) {
+    fail "missing result for $cnt threads"
+      unless grep (/^\(mlfqs-switch\) $cnt threads: \d+ switches\/s, \d+ ns\/switch$/, @output);
+}
+fail "missing PASS in output"
+  unless grep ($_ eq '(mlfqs-switch) PASS', @output);
+
+pass;
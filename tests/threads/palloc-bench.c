@@ -0,0 +1,99 @@
+/* Stresses the page allocator with a random mix of single- and
+   multi-page allocations and frees, and measures their cost.
+
+   Each allocation is tagged with its slot number, and the tags
+   are checked before the pages are freed, so overlapping
+   allocations are detected.  After everything is freed, the
+   test makes sure a large contiguous allocation still succeeds,
+   which fails if freed pages were not coalesced.
+
+   Run it with -palloc=bitmap and -palloc=buddy to compare the
+   backends.  The numbers depend on the host, so the test only
+   fails if the allocator misbehaves. */
+
+#include <random.h>
+#include <stdio.h>
+#include <string.h>
+#include "tests/threads/tests.h"
+#include "threads/palloc.h"
+#include "threads/vaddr.h"
+#include "devices/timer.h"
+
+/* Number of allocations that may be live at once. */
+#define SLOT_CNT 64
+
+/* Number of random operations. */
+#define OP_CNT 20000
+
+/* Largest multi-page allocation, in pages. */
+#define MAX_PAGES 16
+
+/* Size of the final contiguous allocation, in pages. */
+#define BIG_PAGES 64
+
+struct slot {
+  void* pages;     /* First page, or a null pointer. */
+  size_t page_cnt; /* Number of pages. */
+};
+
+static void check_slot(const struct slot*, int idx);
+
+void test_palloc_bench(void) {
+  static struct slot slots[SLOT_CNT];
+  int64_t start;
+  int allocs = 0, failures = 0;
+  int i;
+  void* big;
+
+  random_init(0);
+  start = timer_ns();
+  for (i = 0; i < OP_CNT; i++) {
+    int idx = random_ulong() % SLOT_CNT;
+    struct slot* s = &slots[idx];
+
+    if (s->pages != NULL) {
+      check_slot(s, idx);
+      palloc_free_multiple(s->pages, s->page_cnt);
+      s->pages = NULL;
+    } else {
+      s->page_cnt = random_ulong() % 2 ? 1 : random_ulong() % MAX_PAGES + 1;
+      s->pages = palloc_get_multiple(0, s->page_cnt);
+      if (s->pages == NULL) {
+        failures++;
+        continue;
+      }
+      allocs++;
+      memset(s->pages, idx, s->page_cnt * PGSIZE);
+    }
+  }
+  msg("%d operations, %d failed allocations: %lld ns per operation", OP_CNT, failures,
+      (timer_ns() - start) / OP_CNT);
+
+  for (i = 0; i < SLOT_CNT; i++)
+    if (slots[i].pages != NULL) {
+      check_slot(&slots[i], i);
+      palloc_free_multiple(slots[i].pages, slots[i].page_cnt);
+      slots[i].pages = NULL;
+    }
+
+  big = palloc_get_multiple(0, BIG_PAGES);
+  if (big == NULL)
+    fail("could not allocate %d contiguous pages after freeing everything", BIG_PAGES);
+  palloc_free_multiple(big, BIG_PAGES);
+  if (allocs == 0)
+    fail("no allocation succeeded");
+
+  pass();
+}
+
+/* Checks that the pages in slot S, number IDX, still hold its
+   tag at both ends of every page. */
+static void check_slot(const struct slot* s, int idx) {
+  size_t i;
+
+  for (i = 0; i < s->page_cnt; i++) {
+    const unsigned char* p = (const unsigned char*)s->pages + i * PGSIZE;
+    if (p[0] != idx || p[PGSIZE - 1] != idx)
+      fail("page %zu of slot %d was overwritten", i, idx);
+  }
+}
@@ -0,0 +1,18 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+
+common_checks ("run", @output);
+
+@output = get_core_output ("run", @output);
+fail "missing result line"
+  unless grep (/^\(palloc-bench\) \d+ operations, \d+ failed allocations: \d+ ns per operation$/,
+	       @output);
+fail "missing PASS in output"
+  unless grep ($_ eq '(palloc-bench) PASS', @output);
+
+pass;
@@ -0,0 +1,44 @@
+/* Tests that cond_broadcast() wakes up every thread waiting in
+   cond_wait(), and that they then run in order of priority. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+static thread_func priority_broadcast_thread;
+static struct lock lock;
+static struct condition condition;
+
+void test_priority_broadcast(void) {
+  int i;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT(!thread_mlfqs);
+
+  lock_init(&lock);
+  cond_init(&condition);
+
+  thread_set_priority(PRI_MIN);
+  for (i = 0; i < 10; i++) {
+    int priority = PRI_DEFAULT - (i + 7) % 10 - 1;
+    char name[16];
+    snprintf(name, sizeof name, "priority %d", priority);
+    thread_create(name, priority, priority_broadcast_thread, NULL);
+  }
+
+  lock_acquire(&lock);
+  msg("Broadcasting...");
+  cond_broadcast(&condition, &lock);
+  lock_release(&lock);
+  msg("Main thread done.");
+}
+
+static void priority_broadcast_thread(void* aux UNUSED) {
+  msg("Thread %s starting.", thread_name());
+  lock_acquire(&lock);
+  cond_wait(&condition, &lock);
+  msg("Thread %s woke up.", thread_name());
+  lock_release(&lock);
+}
@@ -0,0 +1,31 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(priority-broadcast) begin
+(priority-broadcast) Thread priority 23 starting.
+(priority-broadcast) Thread priority 22 starting.
+(priority-broadcast) Thread priority 21 starting.
+(priority-broadcast) Thread priority 30 starting.
+(priority-broadcast) Thread priority 29 starting.
+(priority-broadcast) Thread priority 28 starting.
+(priority-broadcast) Thread priority 27 starting.
+(priority-broadcast) Thread priority 26 starting.
+(priority-broadcast) Thread priority 25 starting.
+(priority-broadcast) Thread priority 24 starting.
+(priority-broadcast) Broadcasting...
+(priority-broadcast) Thread priority 30 woke up.
+(priority-broadcast) Thread priority 29 woke up.
+(priority-broadcast) Thread priority 28 woke up.
+(priority-broadcast) Thread priority 27 woke up.
+(priority-broadcast) Thread priority 26 woke up.
+(priority-broadcast) Thread priority 25 woke up.
+(priority-broadcast) Thread priority 24 woke up.
+(priority-broadcast) Thread priority 23 woke up.
+(priority-broadcast) Thread priority 22 woke up.
+(priority-broadcast) Thread priority 21 woke up.
+(priority-broadcast) Main thread done.
+(priority-broadcast) end
+EOF
+pass;
@@ -0,0 +1,115 @@
+/* Checks the xorshift128+ generator of lib/random.c: that a seed
+   gives the same sequence each time, that prng_bytes() hands out
+   the same bytes as prng_next(), and that prng_range() covers its
+   range evenly.  Then times it against the RC4 generator, for
+   bytes and for single numbers.  The times depend on the host,
+   so the test only fails if a check does. */
+
+#include <random.h>
+#include <stdio.h>
+#include <string.h>
+#include "tests/threads/tests.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "devices/timer.h"
+
+/* Bytes generated in each timed run, and times it is repeated. */
+#define BUF_SIZE PGSIZE
+#define ROUND_CNT 64
+
+/* Numbers generated for the timing of single numbers. */
+#define NUMBER_CNT 100000
+
+/* Buckets of prng_range() and numbers drawn into them. */
+#define BUCKET_CNT 10
+#define DRAW_CNT 100000
+#define SHARE (DRAW_CNT / BUCKET_CNT)
+
+static volatile unsigned long sink;
+
+static int64_t time_bytes(uint8_t* buf, bool fast);
+static int64_t time_numbers(bool fast);
+
+void test_random_bench(void) {
+  uint8_t* buf = palloc_get_page(0);
+  struct prng a, b;
+  unsigned buckets[BUCKET_CNT];
+  int64_t rc4_ns, fast_ns;
+  int i;
+
+  if (buf == NULL)
+    fail("out of memory");
+
+  /* Same seed, same sequence; prng_bytes() in the same order as
+     prng_next(), down to a partial word. */
+  prng_init(&a, 42);
+  prng_init(&b, 42);
+  prng_bytes(&a, buf, 8 * 3 + 5);
+  for (i = 0; i < 4; i++) {
+    uint64_t x = prng_next(&b);
+
+    if (memcmp(buf + 8 * i, &x, i < 3 ? 8 : 5))
+      fail("prng_bytes() and prng_next() differ at word %d", i);
+  }
+  prng_init(&b, 43);
+  if (prng_next(&a) == prng_next(&b))
+    fail("seeds 42 and 43 give the same number");
+
+  /* Each bucket should get close to its share. */
+  memset(buckets, 0, sizeof buckets);
+  for (i = 0; i < DRAW_CNT; i++) {
+    unsigned long x = prng_range(&a, BUCKET_CNT);
+
+    if (x >= BUCKET_CNT)
+      fail("prng_range(%d) returned %lu", BUCKET_CNT, x);
+    buckets[x]++;
+  }
+  for (i = 0; i < BUCKET_CNT; i++)
+    if (buckets[i] < SHARE * 9 / 10 || buckets[i] > SHARE * 11 / 10)
+      fail("bucket %d got %u of %d draws", i, buckets[i], DRAW_CNT);
+  msg("%d draws spread evenly over %d buckets", DRAW_CNT, BUCKET_CNT);
+
+  rc4_ns = time_bytes(buf, false);
+  fast_ns = time_bytes(buf, true);
+  msg("bytes: RC4 %lld MB/s, xorshift128+ %lld MB/s",
+      (long long)BUF_SIZE * ROUND_CNT * 1000 / (rc4_ns > 0 ? rc4_ns : 1),
+      (long long)BUF_SIZE * ROUND_CNT * 1000 / (fast_ns > 0 ? fast_ns : 1));
+
+  rc4_ns = time_numbers(false);
+  fast_ns = time_numbers(true);
+  msg("numbers: RC4 %lld ns, xorshift128+ %lld ns", rc4_ns / NUMBER_CNT, fast_ns / NUMBER_CNT);
+
+  palloc_free_page(buf);
+  pass();
+}
+
+/* Fills BUF with BUF_SIZE random bytes ROUND_CNT times, from the
+   running thread's xorshift128+ generator if FAST is true and
+   from RC4 otherwise.  Returns the time taken. */
+static int64_t time_bytes(uint8_t* buf, bool fast) {
+  int64_t start = timer_ns();
+  int i;
+
+  for (i = 0; i < ROUND_CNT; i++) {
+    if (fast)
+      prng_bytes(&thread_current()->prng, buf, BUF_SIZE);
+    else
+      random_bytes(buf, BUF_SIZE);
+    barrier();
+  }
+  return timer_ns() - start;
+}
+
+/* Draws NUMBER_CNT random numbers, as time_bytes() does bytes.
+   Returns the time taken. */
+static int64_t time_numbers(bool fast) {
+  struct prng* p = &thread_current()->prng;
+  int64_t start = timer_ns();
+  int i;
+
+  for (i = 0; i < NUMBER_CNT; i++)
+    sink = fast ? (unsigned long)prng_next(p) : random_ulong();
+  return timer_ns() - start;
+}
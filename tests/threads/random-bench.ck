@@ -0,0 +1,19 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+
+common_checks ("run", @output);
+
+@output = get_core_output ("run", @output);
+fail "missing result lines"
+  unless grep ($_ eq '(random-bench) 100000 draws spread evenly over 10 buckets', @output)
+    && grep (/^\(random-bench\) bytes: RC4 \d+ MB\/s, xorshift128\+ \d+ MB\/s$/, @output)
+    && grep (/^\(random-bench\) numbers: RC4 \d+ ns, xorshift128\+ \d+ ns$/, @output);
+fail "missing PASS in output"
+  unless grep ($_ eq '(random-bench) PASS', @output);
+
+pass;
@@ -0,0 +1,93 @@
+/* Times sort() on arrays of 100, 1,000 and 4,000 elements that
+   are 4, 16 and 64 bytes wide, with random keys, and checks that
+   each array comes out in order with its elements intact.  The
+   times depend on the host, so the test only fails if an array
+   is sorted wrongly. */
+
+#include <random.h>
+#include <round.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "tests/threads/tests.h"
+#include "threads/palloc.h"
+#include "threads/vaddr.h"
+#include "devices/timer.h"
+
+/* Widest element, in bytes. */
+#define MAX_WIDTH 64
+
+/* Most elements. */
+#define MAX_CNT 4000
+
+/* Pages in the array. */
+#define BUF_PAGES DIV_ROUND_UP(MAX_WIDTH * MAX_CNT, PGSIZE)
+
+/* Element widths and counts timed. */
+static const size_t widths[] = {4, 16, MAX_WIDTH};
+static const size_t cnts[] = {100, 1000, MAX_CNT};
+
+static int compare_keys(const void*, const void*, void* aux);
+
+void test_sort_bench(void) {
+  unsigned char* array = palloc_get_multiple(0, BUF_PAGES);
+  size_t w, c;
+
+  if (array == NULL)
+    fail("out of memory");
+  random_init(0);
+
+  for (w = 0; w < sizeof widths / sizeof *widths; w++)
+    for (c = 0; c < sizeof cnts / sizeof *cnts; c++) {
+      size_t width = widths[w];
+      size_t cnt = cnts[c];
+      unsigned sum_before = 0, sum_after = 0;
+      int64_t start, ns;
+      size_t i;
+
+      /* Each element is its key followed by copies of the key's
+         low byte, so that a torn swap shows up. */
+      for (i = 0; i < cnt; i++) {
+        unsigned char* e = array + i * width;
+        unsigned key = random_ulong() % (cnt * 4);
+
+        memcpy(e, &key, sizeof key);
+        memset(e + sizeof key, key, width - sizeof key);
+        sum_before += key;
+      }
+
+      start = timer_ns();
+      sort(array, cnt, width, compare_keys, NULL);
+      ns = timer_ns() - start;
+
+      for (i = 0; i < cnt; i++) {
+        unsigned char* e = array + i * width;
+        unsigned key;
+        size_t j;
+
+        memcpy(&key, e, sizeof key);
+        if (i > 0 && compare_keys(e - width, e, NULL) > 0)
+          fail("%zu elements of %zu bytes: element %zu out of order", cnt, width, i);
+        for (j = sizeof key; j < width; j++)
+          if (e[j] != (unsigned char)key)
+            fail("%zu elements of %zu bytes: element %zu corrupted", cnt, width, i);
+        sum_after += key;
+      }
+      if (sum_after != sum_before)
+        fail("%zu elements of %zu bytes: keys lost", cnt, width);
+
+      msg("%zu elements of %zu bytes: %lld us", cnt, width, ns / 1000);
+    }
+
+  palloc_free_multiple(array, BUF_PAGES);
+  pass();
+}
+
+/* Compares the unsigned keys at the start of elements A and B. */
+static int compare_keys(const void* a, const void* b, void* aux UNUSED) {
+  unsigned x, y;
+
+  memcpy(&x, a, sizeof x);
+  memcpy(&y, b, sizeof y);
+  return x < y ? -1 : x > y;
+}
@@ -0,0 +1,17 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+
+common_checks ("run", @output);
+
+@output = get_core_output ("run", @output);
+fail "missing result lines"
+  unless grep (/^\(sort-bench\) \d+ elements of \d+ bytes: \d+ us$/, @output) == 9;
+fail "missing PASS in output"
+  unless grep ($_ eq '(sort-bench) PASS', @output);
+
+pass;
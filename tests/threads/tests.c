@@ -1,4 +1,5 @@
 #include "tests/threads/tests.h"
+#include "tests/bench/bench.h"
 #include <debug.h>
 #include <string.h>
 #include <stdio.h>
@@ -15,6 +16,7 @@ static const struct test tests[] = {
     {"alarm-priority", test_alarm_priority},
     {"alarm-zero", test_alarm_zero},
     {"alarm-negative", test_alarm_negative},
+    {"alarm-hrtimer", test_alarm_hrtimer},
     {"priority-change", test_priority_change},
     {"priority-donate-one", test_priority_donate_one},
     {"priority-donate-multiple", test_priority_donate_multiple},
@@ -27,6 +29,16 @@ static const struct test tests[] = {
     {"priority-preempt", test_priority_preempt},
     {"priority-sema", test_priority_sema},
     {"priority-condvar", test_priority_condvar},
+    {"priority-broadcast", test_priority_broadcast},
+    {"lock-bench", test_lock_bench},
+    {"malloc-bench", test_malloc_bench},
+    {"palloc-bench", test_palloc_bench},
+    {"tlb-bench", test_tlb_bench},
+    {"memcpy-bench", test_memcpy_bench},
+    {"sort-bench", test_sort_bench},
+    {"fp-bench", test_fp_bench},
+    {"div-bench", test_div_bench},
+    {"random-bench", test_random_bench},
     {"mlfqs-load-1", test_mlfqs_load_1},
     {"mlfqs-load-60", test_mlfqs_load_60},
     {"mlfqs-load-avg", test_mlfqs_load_avg},
@@ -36,6 +48,14 @@ static const struct test tests[] = {
     {"mlfqs-nice-2", test_mlfqs_nice_2},
     {"mlfqs-nice-10", test_mlfqs_nice_10},
     {"mlfqs-block", test_mlfqs_block},
+    {"mlfqs-switch", test_mlfqs_switch},
+    {"bench-context-switch", test_bench_context_switch},
+    {"bench-lock", test_bench_lock},
+    {"bench-sema", test_bench_sema},
+    {"bench-timer", test_bench_timer},
+    {"bench-alloc", test_bench_alloc},
+    {"bench-containers", test_bench_containers},
+    {"bench-thread-create", test_bench_thread_create},
 };
 
 static const char* test_name;
@@ -11,6 +11,7 @@ extern test_func test_alarm_simultaneous;
 extern test_func test_alarm_priority;
 extern test_func test_alarm_zero;
 extern test_func test_alarm_negative;
+extern test_func test_alarm_hrtimer;
 extern test_func test_priority_change;
 extern test_func test_priority_donate_one;
 extern test_func test_priority_donate_multiple;
@@ -23,6 +24,16 @@ extern test_func test_priority_fifo;
 extern test_func test_priority_preempt;
 extern test_func test_priority_sema;
 extern test_func test_priority_condvar;
+extern test_func test_priority_broadcast;
+extern test_func test_lock_bench;
+extern test_func test_malloc_bench;
+extern test_func test_palloc_bench;
+extern test_func test_tlb_bench;
+extern test_func test_memcpy_bench;
+extern test_func test_sort_bench;
+extern test_func test_fp_bench;
+extern test_func test_div_bench;
+extern test_func test_random_bench;
 extern test_func test_mlfqs_load_1;
 extern test_func test_mlfqs_load_60;
 extern test_func test_mlfqs_load_avg;
@@ -32,6 +43,7 @@ extern test_func test_mlfqs_fair_20;
 extern test_func test_mlfqs_nice_2;
 extern test_func test_mlfqs_nice_10;
 extern test_func test_mlfqs_block;
+extern test_func test_mlfqs_switch;
 
 void msg(const char*, ...);
 void fail(const char*, ...);
@@ -0,0 +1,52 @@
+/* Measures the cost of TLB misses on the kernel's mapping of RAM.
+
+   Reads one word from each page of RAM above the first 4 MB, so
+   that nearly every read needs a translation the TLB does not hold
+   when RAM is mapped with 4 kB pages, then makes as many reads
+   within a single page for comparison.  Run it with and without
+   -no-pse to compare 4 kB and 4 MB mappings.  The numbers depend
+   on the host, so the test only checks that it ran. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/loader.h"
+#include "threads/pte.h"
+#include "threads/vaddr.h"
+#include "devices/timer.h"
+
+/* Passes over RAM. */
+#define ROUNDS 8
+
+void test_tlb_bench(void) {
+  size_t first = PTSPAN / PGSIZE;
+  size_t page_cnt, round, i;
+  volatile uint32_t sum = 0;
+  int64_t start, spread_ns, local_ns;
+  const uint32_t* local = ptov(first * PGSIZE);
+
+  if (init_ram_pages <= first)
+    fail("need more than 4 MB of RAM");
+  page_cnt = init_ram_pages - first;
+
+  /* Vary the offset within each page, so the reads do not all
+     land in the same cache set. */
+  start = timer_ns();
+  for (round = 0; round < ROUNDS; round++)
+    for (i = 0; i < page_cnt; i++) {
+      const uint32_t* p = ptov((first + i) * PGSIZE);
+      sum += p[(i * 16 + round) % (PGSIZE / sizeof *p)];
+    }
+  spread_ns = timer_ns() - start;
+
+  start = timer_ns();
+  for (round = 0; round < ROUNDS; round++)
+    for (i = 0; i < page_cnt; i++)
+      sum += local[(i * 16 + round) % (PGSIZE / sizeof *local)];
+  local_ns = timer_ns() - start;
+
+  msg("%zu pages, %s mapping: %lld ns per read across pages, %lld ns within a page", page_cnt,
+      init_large_pages ? "4 MB" : "4 kB", spread_ns / (int64_t)(ROUNDS * page_cnt),
+      local_ns / (int64_t)(ROUNDS * page_cnt));
+  pass();
+}
@@ -0,0 +1,18 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+
+common_checks ("run", @output);
+
+@output = get_core_output ("run", @output);
+fail "missing result line"
+  unless grep (/^\(tlb-bench\) \d+ pages, 4 [Mk]B mapping: \d+ ns per read across pages, \d+ ns within a page$/,
+	       @output);
+fail "missing PASS in output"
+  unless grep ($_ eq '(tlb-bench) PASS', @output);
+
+pass;
@@ -0,0 +1,42 @@
+/* Gives each kind of madvise() advice for some pages and checks
+   that they keep their contents, then reads a file after each
+   kind of fadvise() advice, and checks that bad advice fails. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/userprog/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_CNT 3
+
+static char pages[PAGE_CNT * 4096] __attribute__((aligned(4096)));
+
+void test_main(void) {
+  size_t size = sizeof sample - 1;
+  char buf[sizeof sample];
+  int advice, handle;
+  size_t i;
+
+  for (i = 0; i < sizeof pages; i++)
+    pages[i] = i % 251;
+  for (advice = MADV_NORMAL; advice <= MADV_DONTNEED; advice++) {
+    CHECK(madvise(pages, sizeof pages, advice), "madvise %d", advice);
+    for (i = 0; i < sizeof pages; i++)
+      if (pages[i] != (char)(i % 251))
+        fail("byte %zu changed after madvise %d", i, advice);
+  }
+  CHECK(!madvise(pages + 1, 4095, MADV_DONTNEED), "madvise unaligned address fails");
+  CHECK(!madvise(pages, sizeof pages, 5), "madvise bad advice fails");
+
+  CHECK((handle = open("sample.txt")) > 1, "open \"sample.txt\"");
+  for (advice = POSIX_FADV_NORMAL; advice <= POSIX_FADV_DONTNEED; advice++) {
+    CHECK(fadvise(handle, 0, 0, advice), "fadvise %d", advice);
+    seek(handle, 0);
+    memset(buf, 0, sizeof buf);
+    if (read(handle, buf, size) != (int)size || memcmp(buf, sample, size))
+      fail("read wrong data after fadvise %d", advice);
+  }
+  CHECK(!fadvise(handle, 0, 0, 5), "fadvise bad advice fails");
+  CHECK(!fadvise(1, 0, 0, POSIX_FADV_NORMAL), "fadvise the console fails");
+}
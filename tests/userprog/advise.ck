@@ -0,0 +1,25 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(advise) begin
+(advise) madvise 0
+(advise) madvise 1
+(advise) madvise 2
+(advise) madvise 3
+(advise) madvise 4
+(advise) madvise unaligned address fails
+(advise) madvise bad advice fails
+(advise) open "sample.txt"
+(advise) fadvise 0
+(advise) fadvise 1
+(advise) fadvise 2
+(advise) fadvise 3
+(advise) fadvise 4
+(advise) fadvise bad advice fails
+(advise) fadvise the console fails
+(advise) end
+advise: exit(0)
+EOF
+pass;
@@ -0,0 +1,25 @@
+/* Appends to one file through two descriptors opened with
+   O_APPEND and checks that every write lands at the end, whatever
+   the descriptor's position, while pwrite() still writes where it
+   is told. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void test_main(void) {
+  int a, b;
+
+  CHECK(create("log", 0), "create \"log\"");
+  CHECK((a = open_flags("log", O_APPEND)) > 1, "open \"log\" with O_APPEND");
+  CHECK((b = open_flags("log", O_APPEND)) > 1, "open \"log\" with O_APPEND again");
+  CHECK((fcntl(a, F_GETFL, 0) & O_APPEND) != 0, "fcntl reports O_APPEND");
+
+  CHECK(write(a, "aaaa", 4) == 4, "append through the first descriptor");
+  CHECK(write(b, "bbbb", 4) == 4, "append through the second descriptor");
+  seek(a, 0);
+  CHECK(write(a, "cc", 2) == 2, "append after seeking to 0");
+  CHECK(tell(a) == 10, "position is at the end");
+  CHECK(pwrite(b, "d", 1, 0) == 1, "pwrite at offset 0");
+  check_file("log", "daaabbbbcc", 10);
+}
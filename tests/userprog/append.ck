@@ -0,0 +1,22 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(append) begin
+(append) create "log"
+(append) open "log" with O_APPEND
+(append) open "log" with O_APPEND again
+(append) fcntl reports O_APPEND
+(append) append through the first descriptor
+(append) append through the second descriptor
+(append) append after seeking to 0
+(append) position is at the end
+(append) pwrite at offset 0
+(append) open "log" for verification
+(append) verified contents of "log"
+(append) close "log"
+(append) end
+append: exit(0)
+EOF
+pass;
@@ -0,0 +1,36 @@
+/* Reads the I/O statistics of the file system device, which
+   loading this program has read from, and checks that they add
+   up.  Also checks that a role no device plays is refused. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+/* Returns the number of requests counted in HIST. */
+static long long hist_sum(const unsigned hist[BLKSTAT_HIST_CNT]) {
+  long long sum = 0;
+  int i;
+
+  for (i = 0; i < BLKSTAT_HIST_CNT; i++)
+    sum += hist[i];
+  return sum;
+}
+
+void test_main(void) {
+  struct blkstat s;
+  int d;
+
+  CHECK(blkstat(BLKSTAT_FILESYS, &s), "blkstat file system device");
+  CHECK(s.name[0] != '\0', "device has a name");
+  CHECK(s.requests[BLKSTAT_READ] > 0, "device has been read");
+  for (d = BLKSTAT_READ; d <= BLKSTAT_WRITE; d++) {
+    if (hist_sum(s.latency_hist[d]) != s.requests[d])
+      fail("histogram counts %lld requests, not %lld", hist_sum(s.latency_hist[d]),
+           s.requests[d]);
+    if (s.bytes[d] < s.requests[d] * 512)
+      fail("requests moved less than a sector each");
+  }
+  if (s.in_flight > s.max_in_flight)
+    fail("more requests in flight than ever");
+  CHECK(!blkstat(BLKSTAT_ROLE_CNT, &s), "blkstat of a bad role fails");
+}
@@ -0,0 +1,14 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(blkstat) begin
+(blkstat) blkstat file system device
+(blkstat) device has a name
+(blkstat) device has been read
+(blkstat) blkstat of a bad role fails
+(blkstat) end
+blkstat: exit(0)
+EOF
+pass;
@@ -0,0 +1,37 @@
+/* Writes sample.inc to a file, copies it to another file with
+   copy_file_range() in two pieces, and checks the copy, both
+   file positions, and that copying from end of file or with a
+   bad descriptor copies nothing. */
+
+#include <syscall.h>
+#include "tests/userprog/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void test_main(void) {
+  size_t size = sizeof sample - 1;
+  int in, out, byte_cnt;
+
+  CHECK(create("sample.txt", size), "create \"sample.txt\"");
+  CHECK((in = open("sample.txt")) > 1, "open \"sample.txt\"");
+  CHECK(write(in, sample, size) == (int)size, "write \"sample.txt\"");
+  seek(in, 0);
+  CHECK(create("copy.txt", 0), "create \"copy.txt\"");
+  CHECK((out = open("copy.txt")) > 1, "open \"copy.txt\"");
+
+  msg("copy_file_range");
+  byte_cnt = copy_file_range(in, out, 100);
+  if (byte_cnt != 100)
+    fail("copy_file_range() returned %d instead of 100", byte_cnt);
+  byte_cnt = copy_file_range(in, out, size);
+  if (byte_cnt != (int)size - 100)
+    fail("copy_file_range() returned %d instead of %zu", byte_cnt, size - 100);
+  if (tell(in) != size || tell(out) != size)
+    fail("positions are %u and %u instead of %zu", tell(in), tell(out), size);
+  byte_cnt = copy_file_range(in, out, size);
+  if (byte_cnt != 0)
+    fail("copy_file_range() at end of file returned %d", byte_cnt);
+  if (copy_file_range(in, 1, size) != -1)
+    fail("copy_file_range() to the console did not fail");
+  check_file("copy.txt", sample, size);
+}
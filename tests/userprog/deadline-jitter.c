@@ -0,0 +1,63 @@
+/* Runs a periodic loop in the deadline class while another
+   thread of the process spins, and measures how far apart from
+   the period its activations come: the jitter.  Also checks that
+   admission control refuses impossible settings.  The jitter
+   depends on the host, so the test only fails if the loop misses
+   a whole period. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+/* Period and budget of the loop, in microseconds. */
+#define PERIOD_US 50000
+#define RUNTIME_US 10000
+
+/* Activations measured. */
+#define ACTIVATION_CNT 20
+
+static volatile bool done;
+static char stack[4096];
+
+/* Spins until the loop is done. */
+static int spin(void* aux UNUSED) {
+  while (!done)
+    continue;
+  return 0;
+}
+
+void test_main(void) {
+  long long prev, jitter = 0;
+  tid_t tid;
+  int i;
+
+  CHECK(!sched_deadline(RUNTIME_US, RUNTIME_US / 2, PERIOD_US), "runtime past deadline refused");
+  CHECK(!sched_deadline(PERIOD_US, PERIOD_US, PERIOD_US), "full utilization refused");
+
+  tid = thread_create(spin, NULL, stack, sizeof stack);
+  if (tid == TID_ERROR)
+    fail("thread_create() failed");
+  CHECK(sched_deadline(RUNTIME_US, PERIOD_US, PERIOD_US), "periodic loop admitted");
+
+  sched_yield();
+  prev = clock_ns();
+  for (i = 0; i < ACTIVATION_CNT; i++) {
+    long long now, error;
+
+    sched_yield();
+    now = clock_ns();
+    error = now - prev - PERIOD_US * 1000LL;
+    if (error < 0)
+      error = -error;
+    if (error >= PERIOD_US * 1000LL)
+      fail("activation %d came %lld ns off the period", i, error);
+    if (error > jitter)
+      jitter = error;
+    prev = now;
+  }
+
+  done = true;
+  CHECK(sched_deadline(0, 0, 0), "left the deadline class");
+  CHECK(thread_join(tid) == 0, "spinner joined");
+  msg("jitter: %lld ns max over %d periods", jitter, ACTIVATION_CNT);
+}
@@ -0,0 +1,23 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+
+common_checks ("run", @output);
+
+@output = get_core_output ("run", @output);
+foreach my $line ('runtime past deadline refused', 'full utilization refused',
+                  'periodic loop admitted', 'left the deadline class',
+                  'spinner joined') {
+    fail "missing \"$line\""
+      unless grep ($_ eq "(deadline-jitter) $line", @output);
+}
+fail "missing jitter result line"
+  unless grep (/^\(deadline-jitter\) jitter: \d+ ns max over \d+ periods$/, @output);
+fail "missing exit line"
+  unless grep ($_ eq 'deadline-jitter: exit(0)', @output);
+
+pass;
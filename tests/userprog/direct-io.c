@@ -0,0 +1,41 @@
+/* Writes a file through a descriptor opened with O_DIRECT and
+   checks that a cached descriptor sees the data, then changes
+   it through the cached descriptor and checks that a direct read
+   sees that.  An unaligned read of the direct descriptor falls
+   back to the cache. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define SIZE 4096
+
+static char data[SIZE] __attribute__((aligned(512)));
+static char buf[SIZE] __attribute__((aligned(512)));
+
+void test_main(void) {
+  int direct, cached;
+  size_t i;
+
+  for (i = 0; i < SIZE; i++)
+    data[i] = i * 7;
+
+  CHECK(create("direct", 0), "create \"direct\"");
+  CHECK((direct = open_flags("direct", O_DIRECT)) > 1, "open \"direct\" with O_DIRECT");
+  CHECK(open_flags("direct", 0x80) == -1, "open with an unknown flag fails");
+  CHECK(write(direct, data, SIZE) == SIZE, "write \"direct\"");
+  check_file("direct", data, SIZE);
+
+  msg("write through the cache");
+  CHECK((cached = open("direct")) > 1, "open \"direct\"");
+  memset(data + 1000, 'x', 100);
+  CHECK(pwrite(cached, data + 1000, 100, 1000) == 100, "pwrite \"direct\"");
+
+  msg("read directly");
+  CHECK(pread(direct, buf, SIZE, 0) == SIZE, "pread \"direct\"");
+  compare_bytes(buf, data, SIZE, 0, "direct");
+  seek(direct, 0);
+  CHECK(read(direct, buf + 1, 100) == 100, "unaligned read \"direct\"");
+  compare_bytes(buf + 1, data, 100, 0, "direct");
+}
@@ -0,0 +1,23 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(direct-io) begin
+(direct-io) create "direct"
+(direct-io) open "direct" with O_DIRECT
+(direct-io) open with an unknown flag fails
+(direct-io) write "direct"
+(direct-io) open "direct" for verification
+(direct-io) verified contents of "direct"
+(direct-io) close "direct"
+(direct-io) write through the cache
+(direct-io) open "direct"
+(direct-io) pwrite "direct"
+(direct-io) read directly
+(direct-io) pread "direct"
+(direct-io) unaligned read "direct"
+(direct-io) end
+direct-io: exit(0)
+EOF
+pass;
@@ -0,0 +1,29 @@
+/* Runs child-simple many times, one after another, and measures
+   the average time to exec and wait for it, which is dominated
+   by process creation.  The timings depend on the host, so the
+   test only checks that every child ran and exited with the
+   right status. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+/* Children run. */
+#define CHILD_CNT 1000
+
+void test_main(void) {
+  long long start = clock_ns();
+  int i;
+
+  for (i = 0; i < CHILD_CNT; i++) {
+    pid_t pid = exec("child-simple");
+    int status;
+
+    if (pid == PID_ERROR)
+      fail("exec #%d failed", i);
+    status = wait(pid);
+    if (status != 81)
+      fail("wait for child #%d returned %d", i, status);
+  }
+  msg("%d children: %lld ns per exec and wait", CHILD_CNT, (clock_ns() - start) / CHILD_CNT);
+}
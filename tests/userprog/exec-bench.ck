@@ -0,0 +1,19 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+
+common_checks ("run", @output);
+
+@output = get_core_output ("run", @output);
+fail "missing result line"
+  unless grep (/^\(exec-bench\) 1000 children: \d+ ns per exec and wait$/, @output);
+fail "wrong number of children run"
+  unless grep ($_ eq 'child-simple: exit(81)', @output) == 1000;
+fail "missing exit line"
+  unless grep ($_ eq 'exec-bench: exit(0)', @output);
+
+pass;
@@ -0,0 +1,28 @@
+/* Allocates a file's sectors with fallocate(), checks that they
+   read back as zeros, and then writes part of them and checks
+   the file again. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define SIZE 5000
+
+static char buf[SIZE];
+
+void test_main(void) {
+  int handle;
+
+  CHECK(create("prealloc", 0), "create \"prealloc\"");
+  CHECK((handle = open("prealloc")) > 1, "open \"prealloc\"");
+  CHECK(fallocate(handle, SIZE), "fallocate \"prealloc\"");
+  CHECK(filesize(handle) == SIZE, "filesize is %d", SIZE);
+  CHECK(!fallocate(1, SIZE), "fallocate the console fails");
+  check_file("prealloc", buf, SIZE);
+
+  memset(buf + 700, 'x', 1000);
+  CHECK(pwrite(handle, buf + 700, 1000, 700) == 1000, "pwrite \"prealloc\"");
+  CHECK(fallocate(handle, 100), "fallocate less than the file");
+  check_file("prealloc", buf, SIZE);
+}
@@ -0,0 +1,57 @@
+/* Opens the same file many times and measures the cost of a
+   one-byte read through the newest and the oldest descriptor,
+   which should be the same however many files are open.  Also
+   checks that a closed descriptor is the next one handed out.
+   The timings depend on the host, so the test only checks that
+   it ran. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+/* Files held open at once. */
+#define FILE_CNT 128
+
+/* Reads timed per descriptor. */
+#define READ_CNT 1000
+
+/* Returns the average time in ns of a one-byte read from FD. */
+static long long time_reads(int fd) {
+  long long start = clock_ns();
+  char c;
+  int i;
+
+  for (i = 0; i < READ_CNT; i++) {
+    seek(fd, 0);
+    if (read(fd, &c, 1) != 1)
+      fail("read from fd %d failed", fd);
+  }
+  return (clock_ns() - start) / READ_CNT;
+}
+
+void test_main(void) {
+  int fds[FILE_CNT];
+  long long newest_ns, oldest_ns;
+  int i, fd;
+
+  for (i = 0; i < FILE_CNT; i++) {
+    fds[i] = open("sample.txt");
+    if (fds[i] < 2)
+      fail("open #%d returned %d", i, fds[i]);
+    if (i > 0 && fds[i] != fds[i - 1] + 1)
+      fail("open #%d returned %d after %d", i, fds[i], fds[i - 1]);
+  }
+
+  newest_ns = time_reads(fds[FILE_CNT - 1]);
+  oldest_ns = time_reads(fds[0]);
+  msg("%d open files: %lld ns per read on the newest fd, %lld ns on the oldest", FILE_CNT,
+      newest_ns, oldest_ns);
+
+  close(fds[FILE_CNT / 2]);
+  fd = open("sample.txt");
+  if (fd != fds[FILE_CNT / 2])
+    fail("open after closing fd %d returned %d", fds[FILE_CNT / 2], fd);
+
+  for (i = 0; i < FILE_CNT; i++)
+    close(fds[i]);
+}
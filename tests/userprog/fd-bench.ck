@@ -0,0 +1,18 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+
+common_checks ("run", @output);
+
+@output = get_core_output ("run", @output);
+fail "missing result line"
+  unless grep (/^\(fd-bench\) 128 open files: \d+ ns per read on the newest fd, \d+ ns on the oldest$/,
+	       @output);
+fail "missing exit line"
+  unless grep ($_ eq 'fd-bench: exit(0)', @output);
+
+pass;
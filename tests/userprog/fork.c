@@ -0,0 +1,28 @@
+/* Forks a child that checks it sees the parent's memory and then
+   changes it, and checks that the parent's copy is unchanged. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static char buf[8192];
+
+void test_main(void) {
+  pid_t pid;
+
+  memset(buf, 'p', sizeof buf);
+  pid = fork();
+  if (pid == 0) {
+    if (buf[0] != 'p' || buf[sizeof buf - 1] != 'p')
+      fail("child does not see the parent's memory");
+    memset(buf, 'c', sizeof buf);
+    msg("child wrote its copy");
+    exit(81);
+  }
+  if (pid < 0)
+    fail("fork() failed");
+  msg("wait(fork()) = %d", wait(pid));
+  if (buf[0] != 'p' || buf[sizeof buf - 1] != 'p')
+    fail("child's write reached the parent");
+}
@@ -0,0 +1,13 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(fork) begin
+(fork) child wrote its copy
+fork: exit(81)
+(fork) wait(fork()) = 81
+(fork) end
+fork: exit(0)
+EOF
+pass;
@@ -0,0 +1,62 @@
+/* Keeps values in the x87 registers while yielding the CPU many
+   times, in a parent and in a child forked after it loaded one,
+   and checks that each process gets its own registers back,
+   including the value the child inherited. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+/* Times each process yields with its registers loaded. */
+#define YIELD_CNT 200
+
+static const double parent_value = 3.75, child_value = -2.25, inherited_value = 1.5;
+
+/* Pushes *X onto the x87 stack, yields YIELD_CNT times, then pops
+   the top of the stack and returns true if it is still *X.  User
+   programs are compiled without floating point, so no compiled
+   code touches the x87 stack, and doubles are compared by their
+   bits. */
+static bool hold(const double* x) {
+  double y;
+  int i;
+
+  asm volatile("fldl %0" : : "m"(*x));
+  for (i = 0; i < YIELD_CNT; i++)
+    sched_yield();
+  asm volatile("fstpl %0" : "=m"(y));
+  return !memcmp(&y, x, sizeof y);
+}
+
+/* Pops the top of the x87 stack and returns true if it is *X. */
+static bool pop_equals(const double* x) {
+  double y;
+
+  asm volatile("fstpl %0" : "=m"(y));
+  return !memcmp(&y, x, sizeof y);
+}
+
+void test_main(void) {
+  pid_t pid;
+
+  asm volatile("fldl %0" : : "m"(inherited_value));
+  pid = fork();
+  if (pid == 0) {
+    if (!hold(&child_value))
+      fail("child's registers changed");
+    if (!pop_equals(&inherited_value))
+      fail("child did not inherit the parent's registers");
+    msg("child kept its registers");
+    exit(0);
+  }
+  if (pid < 0)
+    fail("fork() failed");
+
+  if (!hold(&parent_value))
+    fail("parent's registers changed");
+  msg("wait(fork()) = %d", wait(pid));
+  if (!pop_equals(&inherited_value))
+    fail("parent's registers changed across fork()");
+  msg("parent kept its registers");
+}
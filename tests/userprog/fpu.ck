@@ -0,0 +1,14 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(fpu) begin
+(fpu) child kept its registers
+fpu: exit(0)
+(fpu) wait(fork()) = 0
+(fpu) parent kept its registers
+(fpu) end
+fpu: exit(0)
+EOF
+pass;
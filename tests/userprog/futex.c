@@ -0,0 +1,73 @@
+/* Has a parent and a forked child increment a counter in shared
+   memory many times under a futex-based mutex, and checks that
+   no increment is lost.  Then has the child wait on a condition
+   variable until the parent sets a flag.  Also checks that
+   futex_wait() returns at once when the word has changed. */
+
+#include <synch.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+/* Segment key and where it is attached. */
+#define KEY 0xf007
+#define ADDR ((struct shared*)0x10000000)
+
+/* Increments by each process. */
+#define ITERATIONS 20000
+
+/* Data shared between parent and child. */
+struct shared {
+  struct mutex lock;
+  struct condvar flag_set;
+  int counter;
+  int flag;
+};
+
+/* Increments S's counter ITERATIONS times under its lock. */
+static void increment(struct shared* s) {
+  int i;
+
+  for (i = 0; i < ITERATIONS; i++) {
+    mutex_lock(&s->lock);
+    s->counter++;
+    mutex_unlock(&s->lock);
+  }
+}
+
+void test_main(void) {
+  struct shared* s;
+  pid_t pid;
+  int word = 1;
+
+  CHECK(!futex_wait(&word, 2), "futex_wait() on a changed word returns");
+  CHECK(futex_wake(&word, 1) == 0, "futex_wake() with no waiters wakes none");
+
+  s = shmat(shmget(KEY, sizeof *s), ADDR);
+  if (s != ADDR)
+    fail("shmat() failed");
+
+  pid = fork();
+  if (pid == 0) {
+    increment(s);
+
+    mutex_lock(&s->lock);
+    while (!s->flag)
+      cond_wait(&s->flag_set, &s->lock);
+    mutex_unlock(&s->lock);
+    exit(0);
+  }
+  if (pid < 0)
+    fail("fork() failed");
+  increment(s);
+
+  mutex_lock(&s->lock);
+  s->flag = 1;
+  cond_signal(&s->flag_set);
+  mutex_unlock(&s->lock);
+
+  CHECK(wait(pid) == 0, "wait for the child");
+  if (s->counter != 2 * ITERATIONS)
+    fail("counter is %d, not %d", s->counter, 2 * ITERATIONS);
+  msg("counter is %d", s->counter);
+}
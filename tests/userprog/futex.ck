@@ -0,0 +1,15 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(futex) begin
+(futex) futex_wait() on a changed word returns
+(futex) futex_wake() with no waiters wakes none
+futex: exit(0)
+(futex) wait for the child
+(futex) counter is 40000
+(futex) end
+futex: exit(0)
+EOF
+pass;
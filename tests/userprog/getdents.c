@@ -0,0 +1,62 @@
+/* Creates a directory with a subdirectory and several files,
+   lists it with getdents() a few entries at a time, and checks
+   that each entry comes back once with its type and inode
+   number. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define FILE_CNT 10
+
+void test_main(void) {
+  bool seen[FILE_CNT + 1];
+  struct dirent entries[3];
+  int dir_fd, cnt, total = 0, i;
+  char name[16];
+
+  CHECK(mkdir("d"), "mkdir \"d\"");
+  CHECK(mkdir("d/sub"), "mkdir \"d/sub\"");
+  for (i = 0; i < FILE_CNT; i++) {
+    snprintf(name, sizeof name, "d/f%d", i);
+    if (!create(name, 0))
+      fail("create \"%s\" failed", name);
+  }
+  msg("created %d files", FILE_CNT);
+  CHECK((dir_fd = open("d")) > 1, "open \"d\"");
+
+  memset(seen, 0, sizeof seen);
+  while ((cnt = getdents(dir_fd, entries, 3)) > 0)
+    for (i = 0; i < cnt; i++) {
+      const struct dirent* e = &entries[i];
+      int idx, fd;
+
+      if (!strcmp(e->d_name, "sub")) {
+        idx = FILE_CNT;
+        if (e->d_type != DT_DIR)
+          fail("\"sub\" is not a directory");
+      } else {
+        if (e->d_name[0] != 'f' || (idx = atoi(e->d_name + 1)) < 0 || idx >= FILE_CNT)
+          fail("unexpected entry \"%s\"", e->d_name);
+        if (e->d_type != DT_REG)
+          fail("\"%s\" is not a file", e->d_name);
+      }
+      if (seen[idx])
+        fail("\"%s\" listed twice", e->d_name);
+      seen[idx] = true;
+      total++;
+
+      snprintf(name, sizeof name, "d/%s", e->d_name);
+      fd = open(name);
+      if (fd < 0 || inumber(fd) != e->d_ino)
+        fail("\"%s\" has the wrong inode number", e->d_name);
+      close(fd);
+    }
+  if (cnt < 0)
+    fail("getdents() failed");
+  CHECK(total == FILE_CNT + 1, "listed %d entries", FILE_CNT + 1);
+  CHECK(getdents(1, entries, 3) == -1, "getdents of the console fails");
+}
@@ -0,0 +1,16 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(getdents) begin
+(getdents) mkdir "d"
+(getdents) mkdir "d/sub"
+(getdents) created 10 files
+(getdents) open "d"
+(getdents) listed 11 entries
+(getdents) getdents of the console fails
+(getdents) end
+getdents: exit(0)
+EOF
+pass;
@@ -0,0 +1,25 @@
+/* Calls getrusage twice around a busy loop and checks that the
+   counters it reports only move forward. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void test_main(void) {
+  struct rusage before, after;
+  volatile int i;
+
+  CHECK(getrusage(&before) == 0, "getrusage");
+  for (i = 0; i < 10000000; i++)
+    continue;
+  CHECK(getrusage(&after) == 0, "getrusage");
+
+  if (after.user_ticks < before.user_ticks || after.kernel_ticks < before.kernel_ticks ||
+      after.lock_wait_ticks < before.lock_wait_ticks ||
+      after.voluntary_switches < before.voluntary_switches ||
+      after.involuntary_switches < before.involuntary_switches ||
+      after.minor_faults < before.minor_faults || after.major_faults < before.major_faults)
+    fail("resource usage went backward");
+  if (after.peak_rss_pages < after.rss_pages)
+    fail("resident set is larger than its peak");
+}
@@ -0,0 +1,82 @@
+/* Reads sample.txt through a batched system call ring: one
+   ioring_enter() opens it, a second reads all of it in small
+   pieces, seeks back, reads the start again and closes it.  Also
+   checks that bad entries fail on their own. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/userprog/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+/* Where the ring goes, and the size of each read. */
+#define RING_ADDR ((void*)0x10000000)
+#define CHUNK 16
+
+static struct io_ring* ring;
+
+/* Queues an entry. */
+static void submit(enum io_op op, int fd, void* buf, unsigned len, unsigned user_data) {
+  struct io_sqe* sqe = &ring->sqes[ring->sq_tail % IORING_ENTRIES];
+
+  sqe->op = op;
+  sqe->fd = fd;
+  sqe->buf = buf;
+  sqe->len = len;
+  sqe->user_data = user_data;
+  ring->sq_tail++;
+}
+
+/* Takes the next completion, checks that it belongs to entry
+   USER_DATA, and returns its result. */
+static int complete(unsigned user_data) {
+  struct io_cqe* cqe;
+
+  if (ring->cq_head == ring->cq_tail)
+    fail("no completion for entry %u", user_data);
+  cqe = &ring->cqes[ring->cq_head++ % IORING_ENTRIES];
+  if (cqe->user_data != user_data)
+    fail("completion for entry %u, expected %u", cqe->user_data, user_data);
+  return cqe->res;
+}
+
+void test_main(void) {
+  static char buf[sizeof sample];
+  char start[CHUNK];
+  size_t size = sizeof sample - 1;
+  unsigned chunk_cnt = (size + CHUNK - 1) / CHUNK;
+  unsigned i;
+  int fd;
+
+  CHECK(ioring_enter() == -1, "ioring_enter without a ring");
+  CHECK((ring = ioring_setup(RING_ADDR)) == RING_ADDR, "ioring_setup");
+  CHECK(ioring_setup(RING_ADDR) == NULL, "second ioring_setup");
+
+  submit(IORING_OP_OPEN, 0, "sample.txt", 0, 0);
+  CHECK(ioring_enter() == 1, "submit open");
+  CHECK((fd = complete(0)) > 1, "open result");
+
+  for (i = 0; i < chunk_cnt; i++)
+    submit(IORING_OP_READ, fd, buf + i * CHUNK, CHUNK, i);
+  submit(IORING_OP_SEEK, fd, NULL, 0, chunk_cnt);
+  submit(IORING_OP_READ, fd, start, CHUNK, chunk_cnt + 1);
+  submit(IORING_OP_READ, fd, (void*)0xc0000000, CHUNK, chunk_cnt + 2);
+  submit(99, fd, NULL, 0, chunk_cnt + 3);
+  submit(IORING_OP_CLOSE, fd, NULL, 0, chunk_cnt + 4);
+  CHECK(ioring_enter() == (int)chunk_cnt + 5, "submit %u entries at once", chunk_cnt + 5);
+
+  for (i = 0; i < chunk_cnt; i++) {
+    int expected = i < chunk_cnt - 1 ? CHUNK : (int)(size - i * CHUNK);
+
+    if (complete(i) != expected)
+      fail("read #%u returned the wrong size", i);
+  }
+  if (memcmp(buf, sample, size))
+    fail("file contents differ");
+  CHECK(complete(chunk_cnt) == 0, "seek result");
+  CHECK(complete(chunk_cnt + 1) == CHUNK && !memcmp(start, sample, CHUNK), "read after seek");
+  CHECK(complete(chunk_cnt + 2) == -1, "read into kernel memory fails");
+  CHECK(complete(chunk_cnt + 3) == -1, "bad operation fails");
+  CHECK(complete(chunk_cnt + 4) == 0, "close result");
+  CHECK(read(fd, buf, 1) == -1, "fd is closed");
+}
@@ -0,0 +1,22 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(ioring) begin
+(ioring) ioring_enter without a ring
+(ioring) ioring_setup
+(ioring) second ioring_setup
+(ioring) submit open
+(ioring) open result
+(ioring) submit 20 entries at once
+(ioring) seek result
+(ioring) read after seek
+(ioring) read into kernel memory fails
+(ioring) bad operation fails
+(ioring) close result
+(ioring) fd is closed
+(ioring) end
+ioring: exit(0)
+EOF
+pass;
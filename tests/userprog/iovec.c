@@ -0,0 +1,45 @@
+/* Writes sample.inc to a file with writev() in uneven pieces,
+   one of them empty, then reads it back with readv() into
+   buffers split at different places and checks the result. */
+
+#include <iovec.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/userprog/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void test_main(void) {
+  size_t size = sizeof sample - 1;
+  char head[100], tail[sizeof sample];
+  struct iovec iov[4];
+  int handle, byte_cnt;
+
+  CHECK(create("test.txt", size), "create \"test.txt\"");
+  CHECK((handle = open("test.txt")) > 1, "open \"test.txt\"");
+
+  iov[0].iov_base = sample;
+  iov[0].iov_len = 7;
+  iov[1].iov_base = sample + 7;
+  iov[1].iov_len = 0;
+  iov[2].iov_base = sample + 7;
+  iov[2].iov_len = 200;
+  iov[3].iov_base = sample + 207;
+  iov[3].iov_len = size - 207;
+  byte_cnt = writev(handle, iov, 4);
+  if (byte_cnt != (int)size)
+    fail("writev() returned %d instead of %zu", byte_cnt, size);
+  check_file("test.txt", sample, size);
+
+  seek(handle, 0);
+  iov[0].iov_base = head;
+  iov[0].iov_len = sizeof head;
+  iov[1].iov_base = tail;
+  iov[1].iov_len = sizeof tail;
+  msg("readv");
+  byte_cnt = readv(handle, iov, 2);
+  if (byte_cnt != (int)size)
+    fail("readv() returned %d instead of %zu", byte_cnt, size);
+  compare_bytes(head, sample, sizeof head, 0, "test.txt");
+  compare_bytes(tail, sample + sizeof head, size - sizeof head, sizeof head, "test.txt");
+}
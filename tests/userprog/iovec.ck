@@ -0,0 +1,16 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(iovec) begin
+(iovec) create "test.txt"
+(iovec) open "test.txt"
+(iovec) open "test.txt" for verification
+(iovec) verified contents of "test.txt"
+(iovec) close "test.txt"
+(iovec) readv
+(iovec) end
+iovec: exit(0)
+EOF
+pass;
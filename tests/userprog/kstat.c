@@ -0,0 +1,34 @@
+/* Takes snapshots of the kernel's statistics and checks that a
+   known counter is there and goes up between them. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define STAT_MAX 256
+
+static struct kstat stats[STAT_MAX];
+
+/* Returns the value of the statistic NAME in a new snapshot. */
+static long long value_of(const char* name) {
+  int cnt = kstat(stats, STAT_MAX);
+  int i;
+
+  if (cnt < 0)
+    fail("kstat failed");
+  for (i = 0; i < cnt && i < STAT_MAX; i++)
+    if (!strcmp(stats[i].name, name))
+      return stats[i].value;
+  fail("no statistic named %s", name);
+}
+
+void test_main(void) {
+  int cnt = kstat(stats, STAT_MAX);
+  long long before;
+
+  CHECK(cnt > 0 && kstat(NULL, 0) == cnt, "kstat(NULL, 0) counts the statistics");
+  before = value_of("console.chars");
+  msg("writing to the console");
+  CHECK(value_of("console.chars") > before, "console.chars went up");
+}
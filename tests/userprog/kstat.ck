@@ -0,0 +1,13 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(kstat) begin
+(kstat) kstat(NULL, 0) counts the statistics
+(kstat) writing to the console
+(kstat) console.chars went up
+(kstat) end
+kstat: exit(0)
+EOF
+pass;
@@ -0,0 +1,23 @@
+/* Raises and lowers the nice value, checks that it stays within
+   -20...20 and that a child inherits it, and yields. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void test_main(void) {
+  pid_t pid;
+
+  CHECK(getnice() == 0, "initial nice is 0");
+  CHECK(nice(5) == 5, "nice(5) gives 5");
+  CHECK(nice(100) == 20, "nice(100) stops at 20");
+  CHECK(nice(-100) == -20, "nice(-100) stops at -20");
+  CHECK(nice(30) == 10, "nice(30) gives 10");
+  sched_yield();
+  CHECK(getnice() == 10, "nice is still 10 after yielding");
+
+  pid = fork();
+  if (pid == 0)
+    exit(getnice());
+  CHECK(wait(pid) == 10, "child inherits nice 10");
+}
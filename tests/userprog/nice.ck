@@ -0,0 +1,18 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(nice) begin
+(nice) initial nice is 0
+(nice) nice(5) gives 5
+(nice) nice(100) stops at 20
+(nice) nice(-100) stops at -20
+(nice) nice(30) gives 10
+(nice) nice is still 10 after yielding
+nice: exit(10)
+(nice) child inherits nice 10
+(nice) end
+nice: exit(0)
+EOF
+pass;
@@ -0,0 +1,59 @@
+/* Forks a child that writes a megabyte into a pipe in page-size
+   chunks while the parent reads it back, checks every byte, and
+   measures the throughput.  Then checks that the parent sees end
+   of file once the child is gone.  The timing depends on the
+   host, so the test only checks that it ran. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+/* Bytes sent through the pipe. */
+#define TOTAL (1024 * 1024)
+
+/* Bytes per write. */
+#define CHUNK 4096
+
+static unsigned char buf[CHUNK];
+
+void test_main(void) {
+  long long start, ns;
+  int fds[2];
+  int done, i;
+  pid_t pid;
+
+  CHECK(pipe(fds) == 0, "pipe()");
+  pid = fork();
+  if (pid == 0) {
+    close(fds[0]);
+    for (done = 0; done < TOTAL; done += CHUNK) {
+      for (i = 0; i < CHUNK; i++)
+        buf[i] = (done + i) % 251;
+      if (write(fds[1], buf, CHUNK) != CHUNK)
+        fail("write at byte %d failed", done);
+    }
+    exit(0);
+  }
+  if (pid < 0)
+    fail("fork() failed");
+  close(fds[1]);
+
+  start = clock_ns();
+  for (done = 0; done < TOTAL;) {
+    int n = read(fds[0], buf, sizeof buf);
+
+    if (n <= 0)
+      fail("read at byte %d returned %d", done, n);
+    for (i = 0; i < n; i++)
+      if (buf[i] != (done + i) % 251)
+        fail("byte %d is %d, not %d", done + i, buf[i], (done + i) % 251);
+    done += n;
+  }
+  ns = clock_ns() - start;
+  msg("%d bytes through a pipe: %lld kB/s", TOTAL,
+      ns > 0 ? (long long)TOTAL * 1000000000 / 1024 / ns : 0);
+
+  if (wait(pid) != 0)
+    fail("writer did not exit cleanly");
+  CHECK(read(fds[0], buf, sizeof buf) == 0, "read after the writer exits returns 0");
+}
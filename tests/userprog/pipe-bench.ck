@@ -0,0 +1,19 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+
+common_checks ("run", @output);
+
+@output = get_core_output ("run", @output);
+fail "missing result line"
+  unless grep (/^\(pipe-bench\) 1048576 bytes through a pipe: \d+ kB\/s$/, @output);
+fail "missing end-of-file check"
+  unless grep ($_ eq '(pipe-bench) read after the writer exits returns 0', @output);
+fail "missing exit lines"
+  unless grep ($_ eq 'pipe-bench: exit(0)', @output) == 2;
+
+pass;
@@ -0,0 +1,41 @@
+/* Counts the cycles and instructions of a loop in user code with
+   the performance counters, if the CPU has them, and checks that
+   the counts make sense.  Without counters, checks that setting
+   them up fails.  Either way, checks that a bad mode is
+   refused. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+/* Iterations of the counted loop. */
+#define LOOP_CNT 100000
+
+void test_main(void) {
+  unsigned events[PMU_COUNTER_CNT] = {PMU_CYCLES, PMU_INSTRUCTIONS};
+  uint64_t counts[PMU_COUNTER_CNT];
+  volatile int sink = 0;
+  int i;
+
+  CHECK(!pmu_setup(events, 0), "pmu_setup with no mode fails");
+  if (pmu_read(counts) < 2) {
+    if (pmu_setup(events, PMU_USER))
+      fail("pmu_setup succeeded without counters");
+  } else {
+    if (!pmu_setup(events, PMU_USER))
+      fail("pmu_setup failed");
+    for (i = 0; i < LOOP_CNT; i++)
+      sink += i;
+    pmu_read(counts);
+    if (counts[0] == 0)
+      fail("no cycles counted");
+    if (counts[1] < LOOP_CNT)
+      fail("%llu instructions counted, expected at least %d", counts[1], LOOP_CNT);
+    if (counts[2] != 0 || counts[3] != 0)
+      fail("unused counters counted");
+    events[0] = events[1] = PMU_NONE;
+    if (!pmu_setup(events, PMU_USER))
+      fail("turning counters off failed");
+  }
+  msg("counters ok");
+}
@@ -0,0 +1,12 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(pmu) begin
+(pmu) pmu_setup with no mode fails
+(pmu) counters ok
+(pmu) end
+pmu: exit(0)
+EOF
+pass;
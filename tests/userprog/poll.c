@@ -0,0 +1,71 @@
+/* Polls pipes: for readiness without waiting, for a timeout, and
+   for data that a child writes while the parent sleeps.  Also
+   checks reads and writes of non-blocking pipe ends. */
+
+#include <fcntl.h>
+#include <poll.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static char buf[8192];
+
+void test_main(void) {
+  struct pollfd pfds[3];
+  int idle[2], busy[2];
+  long long start;
+  pid_t pid;
+  int ready;
+
+  CHECK(pipe(idle) == 0 && pipe(busy) == 0, "create two pipes");
+
+  pfds[0].fd = idle[0];
+  pfds[0].events = POLLIN;
+  pfds[1].fd = idle[1];
+  pfds[1].events = POLLOUT;
+  CHECK(poll(pfds, 2, 0) == 1 && pfds[0].revents == 0 && pfds[1].revents == POLLOUT,
+        "empty pipe is writable, not readable");
+
+  CHECK(fcntl(idle[0], F_SETFL, O_NONBLOCK) == 0 && fcntl(idle[0], F_GETFL, 0) == O_NONBLOCK,
+        "set O_NONBLOCK on read end");
+  CHECK(read(idle[0], buf, 1) == -1, "non-blocking read of empty pipe fails");
+
+  CHECK(fcntl(idle[1], F_SETFL, O_NONBLOCK) == 0, "set O_NONBLOCK on write end");
+  CHECK(write(idle[1], buf, sizeof buf) == 4096, "non-blocking write fills the pipe");
+  CHECK(write(idle[1], buf, 1) == -1, "non-blocking write to full pipe fails");
+
+  start = clock_ns();
+  CHECK(poll(&pfds[1], 1, 50) == 0 && pfds[1].revents == 0, "poll of full pipe times out");
+  if (clock_ns() - start < 40 * 1000 * 1000LL)
+    fail("poll returned too early");
+
+  pid = fork();
+  if (pid == 0) {
+    start = clock_ns();
+    while (clock_ns() - start < 100 * 1000 * 1000LL)
+      continue;
+    write(busy[1], "x", 1);
+    exit(0);
+  }
+  if (pid < 0)
+    fail("fork() failed");
+  close(busy[1]);
+
+  pfds[0].fd = idle[1];
+  pfds[0].events = POLLOUT;
+  pfds[1].fd = busy[0];
+  pfds[1].events = POLLIN;
+  pfds[2].fd = -1;
+  pfds[2].events = POLLIN;
+  ready = poll(pfds, 3, -1);
+  wait(pid);
+  CHECK(ready == 1 && pfds[0].revents == 0 && pfds[1].revents == POLLIN && pfds[2].revents == 0,
+        "poll wakes for the child's write");
+  CHECK(read(busy[0], buf, 2) == 1 && buf[0] == 'x', "read the child's byte");
+  CHECK(poll(&pfds[1], 1, 0) == 1 && pfds[1].revents == (POLLIN | POLLHUP),
+        "pipe with no writer left polls as hung up");
+
+  close(idle[0]);
+  pfds[0].fd = idle[0];
+  CHECK(poll(pfds, 1, 0) == 1 && pfds[0].revents == POLLNVAL, "closed descriptor is invalid");
+}
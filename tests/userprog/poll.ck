@@ -0,0 +1,23 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(poll) begin
+(poll) create two pipes
+(poll) empty pipe is writable, not readable
+(poll) set O_NONBLOCK on read end
+(poll) non-blocking read of empty pipe fails
+(poll) set O_NONBLOCK on write end
+(poll) non-blocking write fills the pipe
+(poll) non-blocking write to full pipe fails
+(poll) poll of full pipe times out
+poll: exit(0)
+(poll) poll wakes for the child's write
+(poll) read the child's byte
+(poll) pipe with no writer left polls as hung up
+(poll) closed descriptor is invalid
+(poll) end
+poll: exit(0)
+EOF
+pass;
@@ -0,0 +1,38 @@
+/* Writes sample.inc to a file with pwrite(), back half first,
+   then reads part of it back with pread(), and checks that
+   neither call moves the file position. */
+
+#include <syscall.h>
+#include "tests/userprog/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void test_main(void) {
+  size_t size = sizeof sample - 1;
+  char buf[50];
+  int handle, byte_cnt;
+
+  CHECK(create("test.txt", size), "create \"test.txt\"");
+  CHECK((handle = open("test.txt")) > 1, "open \"test.txt\"");
+
+  byte_cnt = pwrite(handle, sample + 100, size - 100, 100);
+  if (byte_cnt != (int)size - 100)
+    fail("pwrite() returned %d instead of %zu", byte_cnt, size - 100);
+  byte_cnt = pwrite(handle, sample, 100, 0);
+  if (byte_cnt != 100)
+    fail("pwrite() returned %d instead of 100", byte_cnt);
+  if (tell(handle) != 0)
+    fail("pwrite() moved the position to %u", tell(handle));
+  check_file("test.txt", sample, size);
+
+  msg("pread");
+  byte_cnt = pread(handle, buf, sizeof buf, 150);
+  if (byte_cnt != sizeof buf)
+    fail("pread() returned %d instead of %zu", byte_cnt, sizeof buf);
+  compare_bytes(buf, sample + 150, sizeof buf, 150, "test.txt");
+  if (tell(handle) != 0)
+    fail("pread() moved the position to %u", tell(handle));
+  byte_cnt = pread(handle, buf, sizeof buf, size);
+  if (byte_cnt != 0)
+    fail("pread() at end of file returned %d", byte_cnt);
+}
@@ -0,0 +1,33 @@
+/* Lowers the file descriptor and child limits with setrlimit()
+   and checks that open() and spawn() fail once they are reached
+   and succeed again once a descriptor is closed or a child is
+   waited for.  Also checks that a limit cannot be raised. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void test_main(void) {
+  pid_t a, b;
+  int fd1, fd2;
+
+  CHECK(getrlimit(RLIMIT_NOFILE) == RLIM_INFINITY, "no descriptor limit at first");
+  CHECK(setrlimit(RLIMIT_NOFILE, 4), "limit descriptors to 4");
+  CHECK(!setrlimit(RLIMIT_NOFILE, 5), "raising the limit fails");
+  CHECK((fd1 = open("sample.txt")) == 2, "open sample.txt as fd 2");
+  CHECK((fd2 = open("sample.txt")) == 3, "open sample.txt as fd 3");
+  CHECK(open("sample.txt") == -1, "third open fails");
+  close(fd1);
+  CHECK(open("sample.txt") == fd1, "open after close succeeds");
+  close(fd1);
+  close(fd2);
+
+  CHECK(setrlimit(RLIMIT_NPROC, 2), "limit children to 2");
+  CHECK((a = spawn("child-simple")) != PID_ERROR, "spawn first child");
+  CHECK((b = spawn("child-simple")) != PID_ERROR, "spawn second child");
+  CHECK(spawn("child-simple") == PID_ERROR, "third spawn fails");
+  CHECK(wait(a) == 81, "wait for first child");
+  CHECK((a = spawn("child-simple")) != PID_ERROR, "spawn after wait succeeds");
+  wait(a);
+  wait(b);
+}
@@ -0,0 +1,22 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(rlimit) begin
+(rlimit) no descriptor limit at first
+(rlimit) limit descriptors to 4
+(rlimit) raising the limit fails
+(rlimit) open sample.txt as fd 2
+(rlimit) open sample.txt as fd 3
+(rlimit) third open fails
+(rlimit) open after close succeeds
+(rlimit) limit children to 2
+(rlimit) spawn first child
+(rlimit) spawn second child
+(rlimit) third spawn fails
+(rlimit) wait for first child
+(rlimit) spawn after wait succeeds
+(rlimit) end
+EOF
+pass;
@@ -0,0 +1,67 @@
+/* Grows and shrinks the heap with sbrk(), checking that new heap
+   memory reads as zeros and keeps what is written to it, and
+   that the break cannot move below the heap's start.  Then
+   exercises malloc(), realloc() and free() from the user
+   library. */
+
+#include <malloc.h>
+#include <stdint.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+/* Bytes to grow the heap by: a little over three pages. */
+#define GROW_SIZE (3 * 4096 + 100)
+
+/* Blocks allocated with malloc(). */
+#define BLOCK_CNT 64
+
+void test_main(void) {
+  uint8_t* start;
+  uint8_t* p;
+  char* blocks[BLOCK_CNT];
+  char* big;
+  size_t i;
+
+  start = sbrk(0);
+  CHECK(start != (void*)-1, "sbrk(0)");
+  CHECK(sbrk(GROW_SIZE) == start, "grow heap by %d bytes", GROW_SIZE);
+  CHECK(sbrk(0) == start + GROW_SIZE, "break moved");
+  for (i = 0; i < GROW_SIZE; i++)
+    if (start[i] != 0)
+      fail("byte %zu of new heap is %d, not 0", i, start[i]);
+  memset(start, 0x5a, GROW_SIZE);
+
+  CHECK(sbrk(-GROW_SIZE) == start + GROW_SIZE, "shrink heap");
+  CHECK(sbrk(-1) == (void*)-1, "shrink below start fails");
+  CHECK(sbrk(GROW_SIZE) == start, "grow heap again");
+  for (p = start; p < start + GROW_SIZE; p++)
+    if (*p != 0 && *p != 0x5a)
+      fail("byte %zu of regrown heap is %d", (size_t)(p - start), *p);
+  CHECK(brk(start) == 0, "brk back to start");
+
+  for (i = 0; i < BLOCK_CNT; i++) {
+    size_t size = 1 + i * 37;
+
+    blocks[i] = malloc(size);
+    if (blocks[i] == NULL)
+      fail("malloc(%zu) failed", size);
+    memset(blocks[i], i, size);
+  }
+  for (i = 0; i < BLOCK_CNT; i++)
+    if (blocks[i][i * 37] != (char)i)
+      fail("block %zu was overwritten", i);
+  for (i = 0; i < BLOCK_CNT; i += 2)
+    free(blocks[i]);
+
+  big = malloc(20000);
+  CHECK(big != NULL, "malloc 20000 bytes");
+  memset(big, 'x', 20000);
+  big = realloc(big, 40000);
+  CHECK(big != NULL && big[19999] == 'x', "realloc to 40000 bytes");
+  free(big);
+  for (i = 1; i < BLOCK_CNT; i += 2)
+    free(blocks[i]);
+  msg("heap ok");
+}
@@ -0,0 +1,20 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(sbrk) begin
+(sbrk) sbrk(0)
+(sbrk) grow heap by 12388 bytes
+(sbrk) break moved
+(sbrk) shrink heap
+(sbrk) shrink below start fails
+(sbrk) grow heap again
+(sbrk) brk back to start
+(sbrk) malloc 20000 bytes
+(sbrk) realloc to 40000 bytes
+(sbrk) heap ok
+(sbrk) end
+sbrk: exit(0)
+EOF
+pass;
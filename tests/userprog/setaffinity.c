@@ -0,0 +1,18 @@
+/* Pins the process to the bootstrap processor, checks that it
+   keeps running across yields, that masks without a CPU that
+   schedules threads fail, and allows all CPUs again. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void test_main(void) {
+  int i;
+
+  CHECK(setaffinity(1), "pin to CPU 0");
+  for (i = 0; i < 4; i++)
+    sched_yield();
+  CHECK(!setaffinity(0), "empty mask fails");
+  CHECK(!setaffinity(1u << 31), "mask of missing CPUs fails");
+  CHECK(setaffinity(~0u), "allow all CPUs");
+}
@@ -0,0 +1,14 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(setaffinity) begin
+(setaffinity) pin to CPU 0
+(setaffinity) empty mask fails
+(setaffinity) mask of missing CPUs fails
+(setaffinity) allow all CPUs
+(setaffinity) end
+setaffinity: exit(0)
+EOF
+pass;
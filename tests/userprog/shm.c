@@ -0,0 +1,54 @@
+/* Attaches a shared memory segment, forks a child that fills it,
+   and checks that the parent sees the child's data in place,
+   without any copying.  Also checks that a second attachment of
+   the same segment shows the same bytes. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+/* Segment key and size. */
+#define KEY 0x5a5a
+#define SIZE (16 * 4096)
+
+/* Where the segment is attached. */
+#define ADDR ((unsigned char*)0x10000000)
+#define ADDR2 ((unsigned char*)0x20000000)
+
+void test_main(void) {
+  unsigned char* p;
+  int id, i;
+  pid_t pid;
+
+  id = shmget(KEY, SIZE);
+  if (id < 0)
+    fail("shmget() failed");
+  CHECK(shmget(KEY, SIZE) == id, "shmget() of the same key returns the same id");
+  CHECK(shmget(KEY, 2 * SIZE) < 0, "shmget() larger than the segment fails");
+  p = shmat(id, ADDR);
+  CHECK(p == ADDR, "shmat()");
+
+  pid = fork();
+  if (pid == 0) {
+    for (i = 0; i < SIZE; i++)
+      p[i] = i % 253;
+    exit(0);
+  }
+  if (pid < 0)
+    fail("fork() failed");
+  CHECK(wait(pid) == 0, "wait for the writer");
+
+  for (i = 0; i < SIZE; i++)
+    if (p[i] != i % 253)
+      fail("byte %d is %d, not %d", i, p[i], i % 253);
+  msg("parent sees the child's %d bytes", SIZE);
+
+  CHECK(shmat(id, ADDR2) == ADDR2, "second shmat()");
+  for (i = 0; i < SIZE; i += 4096)
+    if (ADDR2[i] != p[i])
+      fail("second attachment differs at byte %d", i);
+  CHECK(shmat(id, ADDR) == NULL, "shmat() over an attachment fails");
+
+  CHECK(shmdt(ADDR2) == 0, "shmdt()");
+  CHECK(shmdt(ADDR2) < 0, "second shmdt() fails");
+}
@@ -0,0 +1,20 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(shm) begin
+(shm) shmget() of the same key returns the same id
+(shm) shmget() larger than the segment fails
+(shm) shmat()
+shm: exit(0)
+(shm) wait for the writer
+(shm) parent sees the child's 65536 bytes
+(shm) second shmat()
+(shm) shmat() over an attachment fails
+(shm) shmdt()
+(shm) second shmdt() fails
+(shm) end
+shm: exit(0)
+EOF
+pass;
@@ -0,0 +1,25 @@
+/* Starts many copies of child-simple with spawn(), which returns
+   before each child has loaded, then waits for all of them and
+   checks their exit codes.  Also checks that spawning a missing
+   program fails at once. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+/* Children running at once. */
+#define CHILD_CNT 16
+
+void test_main(void) {
+  pid_t pids[CHILD_CNT];
+  int i;
+
+  CHECK(spawn("no-such-file") == PID_ERROR, "spawn(\"no-such-file\")");
+  for (i = 0; i < CHILD_CNT; i++)
+    if ((pids[i] = spawn("child-simple")) == PID_ERROR)
+      fail("spawn #%d failed", i);
+  for (i = 0; i < CHILD_CNT; i++)
+    if (wait(pids[i]) != 81)
+      fail("wait for child #%d did not return 81", i);
+  msg("%d children exited with 81", CHILD_CNT);
+}
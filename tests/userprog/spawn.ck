@@ -0,0 +1,21 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+
+common_checks ("run", @output);
+
+@output = get_core_output ("run", @output);
+fail "missing spawn check"
+  unless grep ($_ eq '(spawn) spawn("no-such-file")', @output);
+fail "wrong number of children run"
+  unless grep ($_ eq 'child-simple: exit(81)', @output) == 16;
+fail "missing result line"
+  unless grep ($_ eq '(spawn) 16 children exited with 81', @output);
+fail "missing exit line"
+  unless grep ($_ eq 'spawn: exit(0)', @output);
+
+pass;
@@ -0,0 +1,18 @@
+/* Turns on system call tracing, makes a few calls and turns it
+   off again, checking that the calls are logged with their
+   arguments and results and that the calls after are not. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void test_main(void) {
+  int fd;
+
+  CHECK(strace(true), "turn tracing on");
+  fd = open("sample.txt");
+  close(fd);
+  open("no-such-file");
+  CHECK(strace(false), "turn tracing off");
+  filesize(fd);
+}
@@ -0,0 +1,24 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+
+common_checks ("run", @output);
+
+fail "open of sample.txt not traced"
+  unless grep (/^strace: strace\[\d+\]: open\(0x[0-9a-f]+\) = 0x2 \(\d+ ns\)$/, @output);
+fail "close not traced"
+  unless grep (/^strace: strace\[\d+\]: close\(0x2\) = 0 \(\d+ ns\)$/, @output);
+fail "failed open not traced"
+  unless grep (/^strace: strace\[\d+\]: open\(0x[0-9a-f]+\) = 0xffffffff/, @output);
+fail "strace(false) not traced"
+  unless grep (/^strace: strace\[\d+\]: strace\(0\) = 0x1/, @output);
+fail "call after tracing was turned off was traced"
+  if grep (/^strace: .*filesize/, @output);
+fail "missing exit line"
+  unless grep ($_ eq 'strace: exit(0)', @output);
+
+pass;
@@ -0,0 +1,36 @@
+/* Measures the latency of a system call that does nothing, made
+   first with int $0x30 and then, if the kernel allows it, with
+   sysenter.  The timings depend on the host, so the test only
+   checks that both paths return the right answer. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+/* Calls made on each path. */
+#define CALL_CNT 100000
+
+/* Makes CALL_CNT null system calls and returns the average time
+   per call in nanoseconds.  Fails if one returns other than
+   EXPECTED. */
+static long long time_calls(bool expected) {
+  long long start = clock_ns();
+  int i;
+
+  for (i = 0; i < CALL_CNT; i++)
+    if (sysenter_available() != expected)
+      fail("call #%d returned %d", i, !expected);
+  return (clock_ns() - start) / CALL_CNT;
+}
+
+void test_main(void) {
+  bool available = syscall_sysenter;
+
+  syscall_sysenter = false;
+  msg("int $0x30: %lld ns per call", time_calls(available));
+  if (available) {
+    syscall_sysenter = true;
+    msg("sysenter: %lld ns per call", time_calls(available));
+  } else
+    msg("sysenter: not available");
+}
@@ -0,0 +1,19 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+
+common_checks ("run", @output);
+
+@output = get_core_output ("run", @output);
+fail "missing int \$0x30 result line"
+  unless grep (/^\(syscall-bench\) int \$0x30: \d+ ns per call$/, @output);
+fail "missing sysenter result line"
+  unless grep (/^\(syscall-bench\) sysenter: (\d+ ns per call|not available)$/, @output);
+fail "missing exit line"
+  unless grep ($_ eq 'syscall-bench: exit(0)', @output);
+
+pass;
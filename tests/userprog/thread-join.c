@@ -0,0 +1,57 @@
+/* Starts a few threads that share the process's memory, has each
+   increment a shared counter many times under a mutex, and checks
+   that no increment is lost and that each thread's exit status
+   reaches thread_join().  Also checks that a thread cannot be
+   joined twice. */
+
+#include <synch.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+/* Threads started, and increments by each. */
+#define THREAD_CNT 4
+#define ITERATIONS 20000
+
+/* Stack size of each thread. */
+#define STACK_SIZE 4096
+
+static char stacks[THREAD_CNT][STACK_SIZE];
+static struct mutex lock;
+static int counter;
+
+/* Increments the counter ITERATIONS times under the lock, and
+   exits with status 10 more than its index, AUX. */
+static int increment(void* aux) {
+  int i;
+
+  for (i = 0; i < ITERATIONS; i++) {
+    mutex_lock(&lock);
+    counter++;
+    mutex_unlock(&lock);
+  }
+  return (int)aux + 10;
+}
+
+void test_main(void) {
+  tid_t tids[THREAD_CNT];
+  int i;
+
+  mutex_init(&lock);
+  for (i = 0; i < THREAD_CNT; i++) {
+    tids[i] = thread_create(increment, (void*)i, stacks[i], STACK_SIZE);
+    if (tids[i] == TID_ERROR)
+      fail("thread_create() failed");
+  }
+  msg("started %d threads", THREAD_CNT);
+
+  for (i = 0; i < THREAD_CNT; i++)
+    if (thread_join(tids[i]) != i + 10)
+      fail("thread %d exited with the wrong status", i);
+  msg("joined %d threads", THREAD_CNT);
+  CHECK(thread_join(tids[0]) == -1, "second join of a thread fails");
+
+  if (counter != THREAD_CNT * ITERATIONS)
+    fail("counter is %d, not %d", counter, THREAD_CNT * ITERATIONS);
+  msg("counter is %d", counter);
+}
@@ -0,0 +1,14 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(thread-join) begin
+(thread-join) started 4 threads
+(thread-join) joined 4 threads
+(thread-join) second join of a thread fails
+(thread-join) counter is 80000
+(thread-join) end
+thread-join: exit(0)
+EOF
+pass;
@@ -0,0 +1,18 @@
+/* Reads and changes a kernel tunable, and checks that values out
+   of range, unknown names and boot-only tunables are refused. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void test_main(void) {
+  unsigned slice, value;
+
+  CHECK(gettunable("sched.time_slice", &slice), "get sched.time_slice");
+  CHECK(settunable("sched.time_slice", slice + 1), "set sched.time_slice");
+  CHECK(gettunable("sched.time_slice", &value) && value == slice + 1, "new value reads back");
+  CHECK(!settunable("sched.time_slice", 0), "value out of range is refused");
+  CHECK(!gettunable("no.such.tunable", &value), "unknown tunable is refused");
+  CHECK(!settunable("palloc.colors", 0), "boot-only tunable is refused");
+  CHECK(settunable("sched.time_slice", slice), "restore sched.time_slice");
+}
@@ -0,0 +1,17 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(tunable) begin
+(tunable) get sched.time_slice
+(tunable) set sched.time_slice
+(tunable) new value reads back
+(tunable) value out of range is refused
+(tunable) unknown tunable is refused
+(tunable) boot-only tunable is refused
+(tunable) restore sched.time_slice
+(tunable) end
+tunable: exit(0)
+EOF
+pass;
@@ -0,0 +1,52 @@
+/* Checks the ids and the clock that the kernel's shared page
+   gives without a system call: getpid() and gettid() in the main
+   thread, in another thread, and in a forked child, and that
+   clock_ns() and clock_ticks() move forward.  Also checks that a
+   process that writes to the page is killed. */
+
+#include <syscall.h>
+#include <vdso.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static char stack[4096];
+static pid_t thread_pid;
+static tid_t thread_tid;
+
+/* Records the ids that the thread sees. */
+static int record_ids(void* aux UNUSED) {
+  thread_pid = getpid();
+  thread_tid = gettid();
+  return 0;
+}
+
+void test_main(void) {
+  pid_t pid = getpid();
+  long long ns, ticks;
+  tid_t tid;
+
+  CHECK(gettid() == pid, "main thread's id is the process id");
+
+  tid = thread_create(record_ids, NULL, stack, sizeof stack);
+  if (tid == TID_ERROR || thread_join(tid) != 0)
+    fail("thread failed");
+  CHECK(thread_pid == pid && thread_tid == tid, "other thread sees its own ids");
+
+  tid = fork();
+  if (tid == 0)
+    exit(getpid() != pid && gettid() == getpid() ? 0 : 1);
+  CHECK(tid > 0 && wait(tid) == 0, "forked child sees its own ids");
+
+  ns = clock_ns();
+  ticks = clock_ticks();
+  while (clock_ticks() < ticks + 2)
+    sched_yield();
+  CHECK(clock_ns() - ns >= 1000000000 / VDSO_ADDR->timer_freq, "clock moves forward");
+
+  tid = fork();
+  if (tid == 0) {
+    *(volatile unsigned*)&VDSO_ADDR->seq = 0;
+    fail("wrote to the shared page");
+  }
+  msg("wait(fork()) = %d", wait(tid));
+}
@@ -0,0 +1,17 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_USER_FAULTS => 1, [<<'EOF']);
+(vdso) begin
+(vdso) main thread's id is the process id
+(vdso) other thread sees its own ids
+vdso: exit(0)
+(vdso) forked child sees its own ids
+(vdso) clock moves forward
+vdso: exit(-1)
+(vdso) wait(fork()) = -1
+(vdso) end
+vdso: exit(0)
+EOF
+pass;
@@ -0,0 +1,28 @@
+/* Starts many copies of child-simple at once, waits for them in
+   the reverse order, and checks that a second wait for each one
+   fails.  Leaves the last few children unwaited, for the kernel
+   to clean up when the parent exits. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+/* Children started, and children never waited for. */
+#define CHILD_CNT 64
+#define ORPHAN_CNT 4
+
+void test_main(void) {
+  pid_t pids[CHILD_CNT];
+  int i;
+
+  for (i = 0; i < CHILD_CNT; i++)
+    if ((pids[i] = spawn("child-simple")) == PID_ERROR)
+      fail("spawn #%d failed", i);
+  for (i = CHILD_CNT - 1; i >= ORPHAN_CNT; i--) {
+    if (wait(pids[i]) != 81)
+      fail("wait for child #%d did not return 81", i);
+    if (wait(pids[i]) != -1)
+      fail("second wait for child #%d did not fail", i);
+  }
+  msg("waited for %d children", CHILD_CNT - ORPHAN_CNT);
+}
@@ -0,0 +1,17 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+
+common_checks ("run", @output);
+
+@output = get_core_output ("run", @output);
+fail "missing result line"
+  unless grep ($_ eq '(wait-many) waited for 60 children', @output);
+fail "missing exit line"
+  unless grep ($_ eq 'wait-many: exit(0)', @output);
+
+pass;
@@ -0,0 +1,43 @@
+/* Starts several copies of child-simple and reaps them with
+   waitany() in whatever order they exit, checking that each pid
+   comes back exactly once with the right status.  Also checks
+   that waitany() fails with no children and that the
+   non-blocking form does not wait. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+/* Children started. */
+#define CHILD_CNT 8
+
+void test_main(void) {
+  pid_t pids[CHILD_CNT];
+  int status;
+  int i, j;
+
+  CHECK(waitany(&status, true) == PID_ERROR, "waitany with no children");
+  for (i = 0; i < CHILD_CNT; i++)
+    if ((pids[i] = spawn("child-simple")) == PID_ERROR)
+      fail("spawn #%d failed", i);
+
+  for (i = 0; i < CHILD_CNT; i++) {
+    pid_t pid = waitany(&status, i % 2 == 0);
+
+    if (pid == 0) {
+      /* Nothing has exited yet: wait for real. */
+      pid = waitany(&status, true);
+    }
+    for (j = 0; j < CHILD_CNT; j++)
+      if (pids[j] == pid)
+        break;
+    if (j == CHILD_CNT)
+      fail("waitany returned unknown pid %d", pid);
+    if (status != 81)
+      fail("child #%d exited with %d", j, status);
+    pids[j] = PID_ERROR;
+  }
+  msg("reaped %d children", CHILD_CNT);
+
+  CHECK(waitany(&status, false) == PID_ERROR, "waitany after reaping all");
+}
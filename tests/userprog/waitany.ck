@@ -0,0 +1,23 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+
+common_checks ("run", @output);
+
+@output = get_core_output ("run", @output);
+fail "missing no-children check"
+  unless grep ($_ eq '(waitany) waitany with no children', @output);
+fail "wrong number of children run"
+  unless grep ($_ eq 'child-simple: exit(81)', @output) == 8;
+fail "missing result line"
+  unless grep ($_ eq '(waitany) reaped 8 children', @output);
+fail "missing final check"
+  unless grep ($_ eq '(waitany) waitany after reaping all', @output);
+fail "missing exit line"
+  unless grep ($_ eq 'waitany: exit(0)', @output);
+
+pass;
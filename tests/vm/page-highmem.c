@@ -0,0 +1,50 @@
+/* Fills 2 MB of memory, more than the user pool holds when the
+   kernel maps only 4 MB of RAM directly, so that most of it lands
+   in high memory.  Verifies it, then writes part of it to a file
+   opened with O_DIRECT and reads it back into another part, so
+   that the disk transfers to and from frames that the kernel
+   must map to reach. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/arc4.h"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define SIZE (2 * 1024 * 1024)
+#define FILE_SIZE (64 * 1024)
+
+static char buf[SIZE] __attribute__((aligned(512)));
+
+void test_main(void) {
+  struct arc4 arc4;
+  size_t i;
+  int fd;
+
+  msg("initialize");
+  memset(buf, 0x5a, sizeof buf);
+  arc4_init(&arc4, "foobar", 6);
+  arc4_crypt(&arc4, buf, SIZE);
+
+  msg("read pass");
+  arc4_init(&arc4, "foobar", 6);
+  arc4_crypt(&arc4, buf, SIZE);
+  for (i = 0; i < SIZE; i++)
+    if (buf[i] != 0x5a)
+      fail("byte %zu != 0x5a", i);
+
+  /* Write the last 64 kB to a file and read it back over the
+     first 64 kB, after changing those. */
+  for (i = 0; i < FILE_SIZE; i++)
+    buf[SIZE - FILE_SIZE + i] = i % 251;
+  memset(buf, 0, FILE_SIZE);
+  CHECK(create("data", FILE_SIZE), "create \"data\"");
+  CHECK((fd = open_flags("data", O_DIRECT)) > 1, "open \"data\" with O_DIRECT");
+  CHECK(write(fd, buf + SIZE - FILE_SIZE, FILE_SIZE) == FILE_SIZE, "write \"data\"");
+  seek(fd, 0);
+  CHECK(read(fd, buf, FILE_SIZE) == FILE_SIZE, "read \"data\"");
+  close(fd);
+  for (i = 0; i < FILE_SIZE; i++)
+    if (buf[i] != (char)(i % 251))
+      fail("byte %zu of \"data\" is %d, not %d", i, buf[i], (char)(i % 251));
+}
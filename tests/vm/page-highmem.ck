@@ -0,0 +1,15 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(page-highmem) begin
+(page-highmem) initialize
+(page-highmem) read pass
+(page-highmem) create "data"
+(page-highmem) open "data" with O_DIRECT
+(page-highmem) write "data"
+(page-highmem) read "data"
+(page-highmem) end
+EOF
+pass;
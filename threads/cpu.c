@@ -0,0 +1,264 @@
+#include "threads/cpu.h"
+#include <debug.h>
+#include <packed.h>
+#include <stdio.h>
+#include <string.h>
+#include "devices/timer.h"
+#include "threads/init.h"
+#include "threads/interrupt.h"
+#include "threads/lapic.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+
+/* Multiprocessor support.
+
+   CPUs are discovered through the MP configuration table that
+   the BIOS leaves in low memory; see [MP] chapter 4, "MP
+   Configuration Table".  With the -smp option, smp_init() then
+   starts every application processor (AP) with the INIT,
+   start-up, start-up IPI sequence from [MP] appendix B.4.
+
+   The rest of the kernel still relies on turning interrupts off
+   for mutual exclusion, which does not exclude other CPUs, so an
+   AP that comes up only initializes its local APIC, marks itself
+   started and parks in its idle loop with interrupts off.  All
+   threads are scheduled on the bootstrap processor (BSP) until
+   the kernel's critical sections are protected by spinlocks. */
+
+struct cpu cpus[CPU_MAX];
+unsigned cpu_cnt;
+bool smp_enabled;
+
+/* Filled in by smp_init() for the AP being started, and read by
+   ap-start.S. */
+uint32_t ap_page_dir;      /* Physical address of init_page_dir. */
+void* ap_stack;            /* Top of the AP's initial stack. */
+static struct cpu* ap_cpu; /* The AP being started. */
+
+/* Defined in ap-start.S. */
+extern char ap_start[];
+
+void ap_main(void) NO_RETURN;
+
+/* MP floating pointer structure.  See [MP] 4.1. */
+struct mp_fps {
+  char signature[4];  /* "_MP_". */
+  uint32_t config;    /* Physical address of MP configuration table. */
+  uint8_t length;     /* Length in 16-byte paragraphs; 1. */
+  uint8_t spec_rev;   /* MP specification revision. */
+  uint8_t checksum;   /* All bytes sum to 0. */
+  uint8_t feature[5]; /* Default configuration type, IMCR flag. */
+} PACKED;
+
+/* MP configuration table header.  See [MP] 4.2. */
+struct mp_config {
+  char signature[4];       /* "PCMP". */
+  uint16_t length;         /* Length of base table, including header. */
+  uint8_t spec_rev;        /* MP specification revision. */
+  uint8_t checksum;        /* All bytes of base table sum to 0. */
+  char oem_id[8];          /* OEM identifier. */
+  char product_id[12];     /* Product identifier. */
+  uint32_t oem_table;      /* Physical address of OEM table, or 0. */
+  uint16_t oem_table_size; /* Size of OEM table. */
+  uint16_t entry_cnt;      /* Number of base table entries. */
+  uint32_t lapic_addr;     /* Physical address of local APICs. */
+  uint16_t ext_length;     /* Length of extended entries. */
+  uint8_t ext_checksum;    /* Checksum of extended entries. */
+  uint8_t reserved;
+} PACKED;
+
+/* MP configuration table processor entry.  See [MP] 4.3.1.
+   All other entry types are 8 bytes long. */
+struct mp_processor {
+  uint8_t type;       /* MP_PROCESSOR. */
+  uint8_t apic_id;    /* Local APIC ID. */
+  uint8_t apic_ver;   /* Local APIC version. */
+  uint8_t flags;      /* MP_CPU_*. */
+  uint32_t signature; /* CPU stepping, model, family. */
+  uint32_t features;  /* CPUID feature flags. */
+  uint32_t reserved[2];
+} PACKED;
+
+#define MP_PROCESSOR 0     /* Processor entry type. */
+#define MP_CPU_ENABLED 0x1 /* Processor is usable. */
+#define MP_CPU_BSP 0x2     /* Processor is the bootstrap processor. */
+
+static struct mp_fps* mp_search(void);
+static struct mp_fps* mp_search_range(uintptr_t paddr, size_t size);
+static bool mp_checksum_ok(const void* p, size_t size);
+static void mp_parse(struct mp_config*);
+static void start_ap(struct cpu*);
+
+/* Initializes cpus[0] as the bootstrap processor.  Called by
+   thread_init() before any thread is queued, with interrupts
+   off. */
+void cpu_init(void) {
+  struct cpu* c = &cpus[0];
+  int i;
+
+  ASSERT(intr_get_level() == INTR_OFF);
+
+  c->id = 0;
+  c->started = true;
+  c->scheduling = true;
+  for (i = PRI_MIN; i <= PRI_MAX; i++)
+    list_init(&c->ready_lists[i]);
+  list_init(&c->dl_ready);
+  list_init(&c->dl_throttled);
+  cpu_cnt = 1;
+}
+
+/* Discovers the other CPUs and, if -smp was given, starts them.
+   Must be called after timer_calibrate(), because the start-up
+   sequence needs timer_udelay(). */
+void smp_init(void) {
+  struct mp_fps* fps = mp_search();
+  unsigned i;
+
+  ipi_init();
+  if (fps == NULL || fps->config == 0)
+    return;
+  mp_parse(ptov(fps->config));
+
+  if (!smp_enabled || !lapic_present())
+    return;
+
+  lapic_enable();
+  for (i = 1; i < cpu_cnt; i++)
+    start_ap(&cpus[i]);
+
+  printf("SMP: %u CPUs found, application processors parked.\n", cpu_cnt);
+}
+
+/* Returns the bootstrap processor. */
+struct cpu* cpu_bsp(void) { return &cpus[0]; }
+
+/* Prints CPU statistics. */
+void cpu_print_stats(void) {
+  unsigned i, started = 0;
+
+  for (i = 0; i < cpu_cnt; i++)
+    if (cpus[i].started)
+      started++;
+  printf("CPU: %u found, %u started\n", cpu_cnt, started);
+}
+
+/* Looks for the MP floating pointer structure in the places
+   listed in [MP] 4: the first kB of the extended BIOS data area,
+   the last kB of base memory, and the BIOS ROM. */
+static struct mp_fps* mp_search(void) {
+  uint16_t ebda_seg = *(uint16_t*)ptov(0x40e);
+  uint16_t base_kb = *(uint16_t*)ptov(0x413);
+  struct mp_fps* fps = NULL;
+
+  if (ebda_seg != 0)
+    fps = mp_search_range((uintptr_t)ebda_seg << 4, 1024);
+  if (fps == NULL && base_kb != 0)
+    fps = mp_search_range(((uintptr_t)base_kb - 1) * 1024, 1024);
+  if (fps == NULL)
+    fps = mp_search_range(0xf0000, 0x10000);
+  return fps;
+}
+
+/* Looks for the MP floating pointer structure in the SIZE bytes
+   starting at physical address PADDR. */
+static struct mp_fps* mp_search_range(uintptr_t paddr, size_t size) {
+  uint8_t* p = ptov(paddr);
+  uint8_t* end = p + size;
+
+  for (; p + sizeof(struct mp_fps) <= end; p += 16)
+    if (!memcmp(p, "_MP_", 4) && mp_checksum_ok(p, sizeof(struct mp_fps)))
+      return (struct mp_fps*)p;
+  return NULL;
+}
+
+/* Returns true if the SIZE bytes at P sum to 0. */
+static bool mp_checksum_ok(const void* p_, size_t size) {
+  const uint8_t* p = p_;
+  uint8_t sum = 0;
+
+  while (size-- > 0)
+    sum += *p++;
+  return sum == 0;
+}
+
+/* Records the processors listed in the MP configuration table
+   CONFIG, with the BSP as cpus[0], and maps the local APIC. */
+static void mp_parse(struct mp_config* config) {
+  uint8_t* entry;
+  uint16_t i;
+
+  if (memcmp(config->signature, "PCMP", 4) || !mp_checksum_ok(config, config->length))
+    return;
+
+  entry = (uint8_t*)(config + 1);
+  for (i = 0; i < config->entry_cnt; i++) {
+    if (*entry == MP_PROCESSOR) {
+      struct mp_processor* proc = (struct mp_processor*)entry;
+
+      if (proc->flags & MP_CPU_BSP)
+        cpus[0].apic_id = proc->apic_id;
+      else if ((proc->flags & MP_CPU_ENABLED) && cpu_cnt < CPU_MAX) {
+        struct cpu* c = &cpus[cpu_cnt];
+        int pri;
+
+        c->id = cpu_cnt++;
+        c->apic_id = proc->apic_id;
+        for (pri = PRI_MIN; pri <= PRI_MAX; pri++)
+          list_init(&c->ready_lists[pri]);
+        list_init(&c->dl_ready);
+        list_init(&c->dl_throttled);
+      }
+      entry += sizeof(struct mp_processor);
+    } else
+      entry += 8;
+  }
+
+  if (config->lapic_addr != 0)
+    lapic_init(config->lapic_addr);
+}
+
+/* Starts application processor C and waits up to 10 ms for it to
+   come up. */
+static void start_ap(struct cpu* c) {
+  void* page = palloc_get_page(PAL_ZERO);
+  int i;
+
+  if (page == NULL)
+    return;
+
+  /* The AP's first stack page becomes its idle thread. */
+  thread_init_idle(c, page);
+
+  ap_cpu = c;
+  ap_page_dir = vtop(init_page_dir);
+  ap_stack = (uint8_t*)page + PGSIZE;
+  barrier();
+
+  lapic_send_init(c->apic_id);
+  timer_mdelay(10);
+  for (i = 0; i < 2; i++) {
+    lapic_send_startup(c->apic_id, vtop(ap_start));
+    timer_udelay(200);
+  }
+
+  for (i = 0; i < 10 && !c->started; i++)
+    timer_mdelay(1);
+  if (!c->started)
+    printf("SMP: CPU %u (APIC %u) did not start\n", c->id, c->apic_id);
+}
+
+/* First C code run by an application processor, called by
+   ap-start.S with interrupts off, on the stack of the idle thread
+   that start_ap() prepared. */
+void ap_main(void) {
+  struct cpu* c = ap_cpu;
+
+  lapic_enable();
+  c->started = true;
+
+  /* Park.  See the comment at the top of this file. */
+  for (;;)
+    asm volatile("cli; hlt" : : : "memory");
+}
@@ -0,0 +1,66 @@
+#ifndef THREADS_CPU_H
+#define THREADS_CPU_H
+
+#include <list.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "threads/ipi.h"
+#include "threads/thread.h"
+
+/* Maximum number of CPUs we keep state for. */
+#define CPU_MAX 8
+
+/* Number of 32-bit words in a run queue occupancy bitmap. */
+#define READY_BITMAP_WORDS ((PRI_MAX + 1) / 32)
+
+/* Per-CPU state.
+
+   Each CPU has its own run queue: one list of THREAD_READY
+   threads per priority plus an occupancy bitmap, in which bit P
+   (counted across the words, least significant bit first) is set
+   iff ready_lists[P] is non-empty.  Threads in the deadline
+   class are queued apart, ahead of all priorities: on dl_ready,
+   earliest deadline first, while they have budget left, or on
+   dl_throttled until their next period.  A thread is queued on
+   the run queue of its `cpu' member, which is the CPU it last ran
+   on; a thread that another CPU wakes is queued there by an
+   inter-processor interrupt.  Only CPUs whose `scheduling' member is true take threads
+   from their run queues; the others never have threads placed on
+   them. */
+struct cpu {
+  unsigned id;                /* Index in cpus[]. */
+  uint8_t apic_id;            /* Local APIC ID, from the MP table. */
+  volatile bool started;      /* True once the CPU runs kernel code. */
+  bool scheduling;            /* True if the CPU runs threads from its run queue. */
+  struct thread* idle_thread; /* Runs when the run queue is empty. */
+  struct thread* running;     /* Thread currently running here. */
+  uint32_t* pagedir;          /* User page directory loaded, or null. */
+
+  /* Calls queued by other CPUs (see threads/ipi.c). */
+  struct ipi_msg* volatile ipi_mailbox;
+
+  /* kmap_atomic() slots in use (see threads/highmem.c). */
+  unsigned kmap_depth;
+
+  /* Run queue.  Owned by thread.c. */
+  struct list ready_lists[PRI_MAX + 1];
+  uint32_t ready_bitmap[READY_BITMAP_WORDS];
+  struct list dl_ready;     /* Deadline threads with budget left. */
+  struct list dl_throttled; /* Deadline threads out of budget. */
+  int ready_threads_cnt;    /* Queued threads, excluding internal and throttled ones. */
+};
+
+/* All CPUs found at boot.  cpus[0] is the bootstrap processor. */
+extern struct cpu cpus[CPU_MAX];
+extern unsigned cpu_cnt;
+
+/* -smp: Start the application processors at boot? */
+extern bool smp_enabled;
+
+void cpu_init(void);
+void smp_init(void);
+struct cpu* cpu_current(void);
+struct cpu* cpu_bsp(void);
+void cpu_print_stats(void);
+
+#endif /* threads/cpu.h */
@@ -0,0 +1,224 @@
+#include "threads/fpu.h"
+#include <debug.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "threads/interrupt.h"
+#include "threads/slab.h"
+
+/* Floating-point unit.
+
+   The x87 FPU and the SSE unit have their own registers, which
+   switch_threads() does not save.  Instead of saving and
+   restoring them at every switch, which few threads need, they
+   are switched lazily.  The registers belong to one thread at a
+   time, fpu_owner.  When any other thread runs, CR0.TS is set,
+   so that its first floating-point instruction raises #NM
+   ("device not available") instead.  The handler calls
+   fpu_load(), which saves the owner's registers in its struct
+   fpu_state, loads the running thread's, and makes it the owner.
+   A thread that never uses floating point has no fpu_state and
+   never traps, and its switches cost a test and, if the owner
+   was running, a write to CR0.
+
+   A thread's first #NM gives it an fpu_state holding the
+   registers as FNINIT leaves them, with SSE's MXCSR at its reset
+   value.  fork() copies the parent's registers to the child.
+
+   The registers are saved with FXSAVE, which also covers SSE, if
+   the CPU has it, and with FNSAVE otherwise.  The kernel itself
+   is compiled without floating point, so only user programs
+   trap.  Only the bootstrap processor runs threads, so there is
+   one owner. */
+
+/* Control register bits. */
+#define CR0_MP 0x00000002         /* Monitor coprocessor: WAIT traps with TS. */
+#define CR0_EM 0x00000004         /* Emulation: floating point traps. */
+#define CR0_TS 0x00000008         /* Task switched: floating point traps. */
+#define CR0_NE 0x00000020         /* Numeric error: report errors as #MF. */
+#define CR4_OSFXSR 0x00000200     /* FXSAVE and FXRSTOR, and SSE, enabled. */
+#define CR4_OSXMMEXCPT 0x00000400 /* SSE errors reported as #XF. */
+
+/* CPUID leaf 1 EDX feature flags. */
+#define CPUID_FXSR (1 << 24) /* FXSAVE and FXRSTOR. */
+#define CPUID_SSE (1 << 25)  /* SSE. */
+
+/* Saved registers, in the format of FXSAVE, or of FNSAVE, which
+   uses the first 108 bytes. */
+struct fpu_state {
+  uint8_t regs[512];
+} __attribute__((aligned(16)));
+
+static bool use_fxsave;              /* Save with FXSAVE, not FNSAVE? */
+static struct fpu_state init_state;  /* Registers for a thread's first use. */
+static struct kmem_cache* fpu_cache; /* Allocates struct fpu_state. */
+static struct thread* fpu_owner;     /* Thread whose registers are loaded, if any. */
+static bool ts_set;                  /* Is CR0.TS set? */
+
+/* Statistics. */
+static long long load_cnt; /* Registers loaded into the FPU. */
+static long long save_cnt; /* Registers saved from the FPU. */
+
+static void save(struct fpu_state*);
+static void restore(const struct fpu_state*);
+static void give_up_owner(void);
+static void set_ts(bool);
+static uint32_t read_cr0(void);
+static void write_cr0(uint32_t);
+
+/* Turns the FPU on, with CR0.TS set so that its first use
+   traps. */
+void fpu_init(void) {
+  uint32_t eax, ebx, ecx, edx;
+
+  asm volatile("cpuid" : "=a"(eax), "=b"(ebx), "=c"(ecx), "=d"(edx) : "a"(1), "c"(0));
+  use_fxsave = (edx & CPUID_FXSR) != 0;
+  if (use_fxsave) {
+    uint32_t cr4, bits = CR4_OSFXSR | (edx & CPUID_SSE ? CR4_OSXMMEXCPT : 0);
+    asm volatile("movl %%cr4, %0; orl %1, %0; movl %0, %%cr4" : "=&r"(cr4) : "r"(bits));
+  }
+
+  write_cr0((read_cr0() & ~(CR0_EM | CR0_TS)) | CR0_MP | CR0_NE);
+  asm volatile("fninit");
+  save(&init_state);
+  set_ts(true);
+
+  fpu_cache = kmem_cache_create("fpu", sizeof(struct fpu_state), __alignof__(struct fpu_state),
+                                NULL);
+}
+
+/* Loads the running thread's registers into the FPU, for the
+   #NM handler.  Returns false if there was no memory for them. */
+bool fpu_load(void) {
+  struct thread* cur = thread_current();
+  enum intr_level old_level;
+
+  if (cur->fpu == NULL) {
+    struct fpu_state* state = kmem_cache_alloc(fpu_cache);
+    if (state == NULL)
+      return false;
+    memcpy(state, &init_state, sizeof *state);
+    cur->fpu = state;
+  }
+
+  old_level = intr_disable();
+  set_ts(false);
+  if (fpu_owner != cur) {
+    if (fpu_owner != NULL) {
+      save(fpu_owner->fpu);
+      save_cnt++;
+    }
+    restore(cur->fpu);
+    load_cnt++;
+    fpu_owner = cur;
+  }
+  intr_set_level(old_level);
+  return true;
+}
+
+/* Sets CR0.TS for NEXT, which is about to run: clear if NEXT
+   owns the FPU, set otherwise.  Called by schedule() with
+   interrupts off. */
+void fpu_switch(struct thread* next) {
+  ASSERT(intr_get_level() == INTR_OFF);
+
+  set_ts(next != fpu_owner);
+}
+
+/* Gives the running thread, just created by fork(), a copy of
+   PARENT's registers.  Returns false if there was no memory for
+   them. */
+bool fpu_fork(struct thread* parent) {
+  struct thread* cur = thread_current();
+  struct fpu_state* state;
+  enum intr_level old_level;
+
+  if (parent->fpu == NULL)
+    return true;
+  state = kmem_cache_alloc(fpu_cache);
+  if (state == NULL)
+    return false;
+
+  old_level = intr_disable();
+  if (fpu_owner == parent)
+    give_up_owner();
+  memcpy(state, parent->fpu, sizeof *state);
+  cur->fpu = state;
+  intr_set_level(old_level);
+  return true;
+}
+
+/* Frees the saved registers of the running thread, which is
+   exiting. */
+void fpu_exit(void) {
+  struct thread* cur = thread_current();
+  struct fpu_state* state = cur->fpu;
+  enum intr_level old_level;
+
+  if (state == NULL)
+    return;
+
+  old_level = intr_disable();
+  if (fpu_owner == cur) {
+    fpu_owner = NULL;
+    set_ts(true);
+  }
+  cur->fpu = NULL;
+  intr_set_level(old_level);
+  kmem_cache_free(fpu_cache, state);
+}
+
+/* Prints FPU statistics. */
+void fpu_print_stats(void) {
+  printf("FPU: %lld register loads, %lld saves\n", load_cnt, save_cnt);
+}
+
+/* Saves the owner's registers, leaving the FPU without an owner
+   and CR0.TS set.  Interrupts must be off. */
+static void give_up_owner(void) {
+  set_ts(false);
+  save(fpu_owner->fpu);
+  save_cnt++;
+  fpu_owner = NULL;
+  set_ts(true);
+}
+
+/* Saves the FPU's registers in STATE.  FNSAVE also reinitializes
+   the FPU. */
+static void save(struct fpu_state* state) {
+  if (use_fxsave)
+    asm volatile("fxsave %0" : "=m"(*state));
+  else
+    asm volatile("fnsave %0; fwait" : "=m"(*state));
+}
+
+/* Loads the FPU's registers from STATE. */
+static void restore(const struct fpu_state* state) {
+  if (use_fxsave)
+    asm volatile("fxrstor %0" : : "m"(*state));
+  else
+    asm volatile("frstor %0" : : "m"(*state));
+}
+
+/* Sets CR0.TS if SET is true, otherwise clears it, unless it
+   already is that way. */
+static void set_ts(bool set) {
+  if (set == ts_set)
+    return;
+  if (set)
+    write_cr0(read_cr0() | CR0_TS);
+  else
+    asm volatile("clts");
+  ts_set = set;
+}
+
+/* Returns CR0. */
+static uint32_t read_cr0(void) {
+  uint32_t cr0;
+
+  asm volatile("movl %%cr0, %0" : "=r"(cr0));
+  return cr0;
+}
+
+/* Sets CR0 to CR0. */
+static void write_cr0(uint32_t cr0) { asm volatile("movl %0, %%cr0" : : "r"(cr0) : "memory"); }
@@ -0,0 +1,14 @@
+#ifndef THREADS_FPU_H
+#define THREADS_FPU_H
+
+#include <stdbool.h>
+#include "threads/thread.h"
+
+void fpu_init(void);
+bool fpu_load(void);
+void fpu_switch(struct thread* next);
+bool fpu_fork(struct thread* parent);
+void fpu_exit(void);
+void fpu_print_stats(void);
+
+#endif /* threads/fpu.h */
@@ -0,0 +1,207 @@
+#include "threads/highmem.h"
+#include <debug.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include "threads/cpu.h"
+#include "threads/init.h"
+#include "threads/interrupt.h"
+#include "threads/kstat.h"
+#include "threads/loader.h"
+#include "threads/palloc.h"
+#include "threads/pte.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+
+/* High memory.
+
+   The kernel maps RAM at PHYS_BASE only up to KMAP_BASE, a
+   little under 492 MB, or less with -lowmem.  The RAM beyond is
+   high memory.  Its frames go to the user pool (see
+   palloc_get_frame()), and user page tables map them like any
+   other, but the kernel has no address of its own for them: to
+   read or write one, it maps the frame into the kmap area for as
+   long as it needs to.
+
+   kmap() maps a frame at one of the first KMAP_SLOTS pages of
+   the area, until kunmap().  It may sleep, waiting for a free
+   slot, and the mapping may be held across sleeps, such as the
+   disk transfers of paging.  A thread holds at most two at once,
+   the second only while the page cache serves a read into the
+   first, so the slots run out only with hundreds of threads
+   paging at once.
+
+   kmap_atomic() maps a frame at one of KMAP_ATOMIC_DEPTH slots
+   that belong to the running CPU, with interrupts off, for
+   copies and comparisons where sleeping is not allowed, such as
+   under the frame table's lock.  Only the CPU that made such a
+   mapping uses it, so kunmap_atomic() needs no lock and flushes
+   only its own TLB.
+
+   Both return the direct mapping of a frame in low memory
+   without taking a slot, so their callers need not care where a
+   frame is.  A device may transfer to or from a page that
+   kmap() mapped, as long as the transfer stays within the page;
+   drivers find its physical address with kmap_vtop(). */
+
+/* Slots of kmap_atomic() for each CPU, and so how deeply its
+   mappings may nest. */
+#define KMAP_ATOMIC_DEPTH 2
+
+/* Slots of kmap(), at the start of the area.  The slots of
+   kmap_atomic() follow. */
+#define KMAP_SLOTS (KMAP_PAGES - CPU_MAX * KMAP_ATOMIC_DEPTH)
+
+static uint32_t* kmap_pt;          /* Page table of the kmap area. */
+static struct lock kmap_lock;      /* Protects the kmap() slots. */
+static struct condition kmap_free; /* Signaled when a kmap() slot is freed. */
+static size_t slots_used;          /* kmap() slots in use. */
+static size_t next_slot;           /* Where to look for a free slot first. */
+
+/* Statistics. */
+static long long kmap_cnt;   /* Frames mapped by kmap(). */
+static long long kmap_waits; /* kmap() calls that waited for a slot. */
+static long long atomic_cnt; /* Frames mapped by kmap_atomic(). */
+static size_t peak_slots;    /* Most kmap() slots in use at once. */
+
+static bool is_kmap_addr(const void*);
+static size_t slot_of(const void* kaddr);
+static void invalidate(const void* kaddr);
+
+/* Creates the page table of the kmap area in init_page_dir.
+   Must be called after paging_init() and before the first
+   process starts, so that every page directory shares it. */
+void highmem_init(void) {
+  ASSERT(init_page_dir[pd_no(KMAP_BASE)] == 0);
+
+  kmap_pt = palloc_get_page(PAL_ASSERT | PAL_ZERO);
+  init_page_dir[pd_no(KMAP_BASE)] = pde_create(kmap_pt);
+  lock_init(&kmap_lock);
+  cond_init(&kmap_free);
+
+  kstat_counter("highmem.kmaps", &kmap_cnt);
+  kstat_counter("highmem.kmap_waits", &kmap_waits);
+  kstat_counter("highmem.atomic_kmaps", &atomic_cnt);
+}
+
+/* Returns true if the frame at physical address PADDR is in high
+   memory, with no address in the kernel's direct mapping. */
+bool is_highmem(uintptr_t paddr) { return paddr >= (uintptr_t)init_lowmem_pages << PGBITS; }
+
+/* Returns a kernel address for the frame at physical address
+   PADDR, valid until kunmap().  May sleep. */
+void* kmap(uintptr_t paddr) {
+  size_t slot;
+
+  ASSERT((paddr & PGMASK) == 0);
+  ASSERT(!intr_context());
+
+  if (!is_highmem(paddr))
+    return ptov(paddr);
+
+  lock_acquire(&kmap_lock);
+  if (slots_used == KMAP_SLOTS)
+    kmap_waits++;
+  while (slots_used == KMAP_SLOTS)
+    cond_wait(&kmap_free, &kmap_lock);
+  while (kmap_pt[next_slot] != 0)
+    next_slot = (next_slot + 1) % KMAP_SLOTS;
+  slot = next_slot;
+  next_slot = (next_slot + 1) % KMAP_SLOTS;
+  kmap_pt[slot] = pte_create_phys(paddr, true);
+  kmap_cnt++;
+  if (++slots_used > peak_slots)
+    peak_slots = slots_used;
+  lock_release(&kmap_lock);
+
+  return KMAP_BASE + slot * PGSIZE;
+}
+
+/* Ends the mapping at KADDR, which kmap() returned. */
+void kunmap(void* kaddr) {
+  size_t slot;
+
+  if (!is_kmap_addr(kaddr))
+    return;
+  slot = slot_of(kaddr);
+  ASSERT(slot < KMAP_SLOTS);
+  ASSERT(kmap_pt[slot] & PTE_P);
+
+  lock_acquire(&kmap_lock);
+  kmap_pt[slot] = 0;
+  invalidate(kaddr);
+  slots_used--;
+  cond_signal(&kmap_free, &kmap_lock);
+  lock_release(&kmap_lock);
+}
+
+/* Returns a kernel address for the frame at physical address
+   PADDR, valid until kunmap_atomic(), which must be called
+   before interrupts go back on.  Interrupts must be off.
+   Mappings nest, and must be ended in reverse order. */
+void* kmap_atomic(uintptr_t paddr) {
+  struct cpu* c;
+  size_t slot;
+
+  ASSERT((paddr & PGMASK) == 0);
+  ASSERT(intr_get_level() == INTR_OFF);
+
+  if (!is_highmem(paddr))
+    return ptov(paddr);
+
+  c = cpu_current();
+  ASSERT(c->kmap_depth < KMAP_ATOMIC_DEPTH);
+  slot = KMAP_SLOTS + c->id * KMAP_ATOMIC_DEPTH + c->kmap_depth++;
+  kmap_pt[slot] = pte_create_phys(paddr, true);
+  atomic_cnt++;
+  return KMAP_BASE + slot * PGSIZE;
+}
+
+/* Ends the mapping at KADDR, which kmap_atomic() returned. */
+void kunmap_atomic(void* kaddr) {
+  struct cpu* c;
+
+  ASSERT(intr_get_level() == INTR_OFF);
+
+  if (!is_kmap_addr(kaddr))
+    return;
+  c = cpu_current();
+  ASSERT(c->kmap_depth > 0);
+  ASSERT(slot_of(kaddr) == KMAP_SLOTS + c->id * KMAP_ATOMIC_DEPTH + c->kmap_depth - 1);
+  kmap_pt[slot_of(kaddr)] = 0;
+  invalidate(kaddr);
+  c->kmap_depth--;
+}
+
+/* Returns the physical address that kernel virtual address
+   VADDR maps to, whether in the direct mapping or in a page that
+   kmap() or kmap_atomic() mapped. */
+uintptr_t kmap_vtop(const void* vaddr) {
+  uint32_t pte;
+
+  if (!is_kmap_addr(vaddr))
+    return vtop(vaddr);
+  pte = kmap_pt[slot_of(vaddr)];
+  ASSERT(pte & PTE_P);
+  return (pte & PTE_ADDR) | pg_ofs(vaddr);
+}
+
+/* Prints high memory statistics. */
+void highmem_print_stats(void) {
+  if (init_ram_pages > init_lowmem_pages)
+    printf("Highmem: %" PRIu32 " pages, %lld kmaps (%lld waited, peak %zu slots), %lld atomic\n",
+           init_ram_pages - init_lowmem_pages, kmap_cnt, kmap_waits, peak_slots, atomic_cnt);
+}
+
+/* Returns true if VADDR is in the kmap area. */
+static bool is_kmap_addr(const void* vaddr) {
+  const uint8_t* p = vaddr;
+  return p >= KMAP_BASE && p < KMAP_BASE + KMAP_PAGES * PGSIZE;
+}
+
+/* Returns the index of KADDR's slot in the kmap area. */
+static size_t slot_of(const void* kaddr) { return pg_no(kaddr) - pg_no(KMAP_BASE); }
+
+/* Removes the stale translation of KADDR from this CPU's TLB. */
+static void invalidate(const void* kaddr) {
+  asm volatile("invlpg (%0)" : : "r"(pg_round_down(kaddr)) : "memory");
+}
@@ -0,0 +1,24 @@
+#ifndef THREADS_HIGHMEM_H
+#define THREADS_HIGHMEM_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* The kmap area: kernel virtual addresses that kmap() and
+   kmap_atomic() map pages of high memory at, one page table's
+   worth just below the vmalloc area.  RAM is mapped at PHYS_BASE
+   only up to KMAP_BASE; the rest is high memory. */
+#define KMAP_BASE ((uint8_t*)0xdec00000)
+#define KMAP_PAGES 1024
+
+void highmem_init(void);
+bool is_highmem(uintptr_t paddr);
+void* kmap(uintptr_t paddr);
+void kunmap(void* kaddr);
+void* kmap_atomic(uintptr_t paddr);
+void kunmap_atomic(void* kaddr);
+uintptr_t kmap_vtop(const void* vaddr);
+void highmem_print_stats(void);
+
+#endif /* threads/highmem.h */
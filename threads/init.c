@@ -4,6 +4,7 @@
 #include <inttypes.h>
 #include <limits.h>
 #include <random.h>
+#include <round.h>
 #include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -15,17 +16,33 @@
 #include "devices/timer.h"
 #include "devices/vga.h"
 #include "devices/rtc.h"
+#include "threads/cpu.h"
+#include "threads/fpu.h"
+#include "threads/highmem.h"
 #include "threads/interrupt.h"
 #include "threads/io.h"
+#include "threads/lock-stats.h"
 #include "threads/loader.h"
 #include "threads/malloc.h"
 #include "threads/palloc.h"
+#include "threads/pmu.h"
 #include "threads/pte.h"
+#include "threads/profile.h"
+#include "threads/sched-trace.h"
 #include "threads/thread.h"
+#include "threads/tracepoint.h"
+#include "threads/tunable.h"
+#include "threads/vdso.h"
+#include "threads/vmalloc.h"
+#include "threads/workqueue.h"
 #ifdef USERPROG
 #include "userprog/process.h"
+#include "userprog/shm.h"
 #include "userprog/exception.h"
+#include "userprog/futex.h"
 #include "userprog/gdt.h"
+#include "userprog/pagedir.h"
+#include "userprog/strace.h"
 #include "userprog/syscall.h"
 #include "userprog/tss.h"
 #else
@@ -34,13 +51,47 @@
 #ifdef FILESYS
 #include "devices/block.h"
 #include "devices/ide.h"
+#include "devices/ramdisk.h"
+#include "devices/virtio-blk.h"
+#include "devices/ahci.h"
+#include "filesys/cache.h"
 #include "filesys/filesys.h"
 #include "filesys/fsutil.h"
+#include "filesys/initramfs.h"
+#include "filesys/inode.h"
+#endif
+#ifdef VM
+#include "vm/frame.h"
+#include "vm/page.h"
+#include "vm/swap.h"
+#include "vm/zswap.h"
 #endif
 
 /* Page directory with kernel mappings only. */
 uint32_t* init_page_dir;
 
+/* True if init_page_dir maps RAM with 4 MB pages. */
+bool init_large_pages;
+
+/* True if init_page_dir maps RAM with global pages. */
+bool init_global_pages;
+
+/* Pages of RAM that init_page_dir maps at PHYS_BASE. */
+uint32_t init_lowmem_pages;
+
+/* -no-pse: Map RAM with 4 kB pages only? */
+static bool no_pse;
+
+/* -no-pge: Map RAM with non-global pages? */
+static bool no_pge;
+
+/* -lowmem: Most pages of RAM to map at PHYS_BASE. */
+static size_t lowmem_limit = SIZE_MAX;
+
+/* Start of the RAM that palloc_init() manages.  paging_init()
+   takes its page tables from here first. */
+static uint8_t* free_start;
+
 #ifdef FILESYS
 /* -f: Format the file system? */
 static bool format_filesys;
@@ -57,8 +108,33 @@ static const char* swap_bdev_name;
 /* -ul: Maximum number of pages to put into palloc's user pool. */
 static size_t user_page_limit = SIZE_MAX;
 
+/* -bootstats: Print how long each phase of boot took? */
+static bool boot_stats;
+
+/* Boot profile.  boot_phase() reads the TSC as each phase of
+   boot ends.  The TSC's rate is only known once the timer is
+   calibrated, so the times are converted when they are printed,
+   at shutdown. */
+#define BOOT_PHASE_MAX 24
+struct boot_phase {
+  const char* name; /* Phase that ended. */
+  uint64_t tsc;     /* TSC when it ended. */
+};
+static struct boot_phase boot_phases[BOOT_PHASE_MAX];
+static size_t boot_phase_cnt;
+static uint64_t boot_tsc; /* TSC when main() started. */
+
 static void bss_init(void);
 static void paging_init(void);
+static void* boot_page(void);
+static uint32_t cpuid_features(void);
+static uint64_t boot_clock(void);
+static void boot_phase(const char* name);
+
+/* CPUID feature flags. */
+#define CPUID_PSE (1 << 3)  /* 4 MB pages. */
+#define CPUID_TSC (1 << 4)  /* Time stamp counter. */
+#define CPUID_PGE (1 << 13) /* Global pages. */
 
 static char** read_command_line(void);
 static char** parse_options(char** argv);
@@ -78,6 +154,7 @@ int main(void) {
 
   /* Clear BSS. */
   bss_init();
+  boot_tsc = boot_clock();
 
   /* Break command line into arguments and parse options. */
   argv = read_command_line();
@@ -87,44 +164,91 @@ int main(void) {
      then enable console locking. */
   thread_init();
   console_init();
+  boot_phase("command line, thread, console");
 
   /* Greet user. */
   printf("Pintos booting with %'" PRIu32 " kB RAM...\n", init_ram_pages * PGSIZE / 1024);
 
-  /* Initialize memory system. */
-  palloc_init(user_page_limit);
-  malloc_init();
+  /* Initialize memory system.  Paging comes first, because the
+     loader maps only the first 64 MB of RAM, and the page
+     allocator's pools may reach past it. */
   paging_init();
+  palloc_init(free_start, user_page_limit);
+  tracepoint_init();
+  boot_phase("paging_init, palloc_init");
+  profile_init();
+  malloc_init();
+  boot_phase("malloc_init");
+  vmalloc_init();
+  highmem_init();
+  boot_phase("vmalloc_init, highmem_init");
+  vdso_init();
 
 /* Segmentation. */
 #ifdef USERPROG
   tss_init();
   gdt_init();
+  boot_phase("tss_init, gdt_init");
 #endif
 
   /* Initialize interrupt handlers. */
   intr_init();
   timer_init();
+  pmu_init();
+  fpu_init();
   kbd_init();
   input_init();
+  boot_phase("intr_init, timer_init, kbd_init");
 #ifdef USERPROG
   exception_init();
   syscall_init();
+  pagedir_init();
+  process_init();
+  shm_init();
+  futex_init();
+  boot_phase("exception, syscall, process init");
 #endif
 
   /* Start thread scheduler and enable interrupts. */
   thread_start();
   serial_init_queue();
+  console_start();
+  workqueue_init();
+  boot_phase("thread_start, kernel threads");
   timer_calibrate();
+  boot_phase("timer_calibrate");
+  smp_init();
+  boot_phase("smp_init");
 
 #ifdef FILESYS
   /* Initialize file system. */
   ide_init();
+  boot_phase("ide_init");
+  virtio_blk_init();
+  ahci_init();
+  ramdisk_init();
   locate_block_devices();
+  boot_phase("other block devices");
   filesys_init(format_filesys);
+  boot_phase("filesys_init");
+  initramfs_init();
+  boot_phase("initramfs_init");
+#endif
+
+#ifdef VM
+  /* Initialize virtual memory. */
+  page_init();
+  frame_init();
+  swap_init();
+  boot_phase("page, frame, swap init");
+#endif
+
+#ifdef USERPROG
+  strace_init();
 #endif
 
   printf("Boot complete.\n");
+  boot_phase("boot complete");
 
   /* Run actions specified on kernel command line. */
   run_actions(argv);
@@ -148,27 +272,57 @@ static void bss_init(void) {
 /* Populates the base page directory and page table with the
    kernel virtual mapping, and then sets up the CPU to use the
    new page directory.  Points init_page_dir to the page
-   directory it creates. */
+   directory it creates.  Where the CPU allows, RAM is mapped
+   with 4 MB pages, and with global pages, which stay in the TLB
+   when a context switch loads another page directory, since
+   every page directory maps the kernel the same way.
+
+   RAM is mapped up to the kmap area, or up to -lowmem, and the
+   rest is left to threads/highmem.c.  The page tables come from
+   boot_page(), since the page allocator is not ready yet. */
 static void paging_init(void) {
   uint32_t *pd, *pt;
+  uint32_t features, global, cr4_bits;
+  size_t lowmem_max = (KMAP_BASE - (uint8_t*)PHYS_BASE) / PGSIZE;
   size_t page;
   extern char _start, _end_kernel_text;
 
-  pd = init_page_dir = palloc_get_page(PAL_ASSERT | PAL_ZERO);
+  init_lowmem_pages = init_ram_pages;
+  if (init_lowmem_pages > lowmem_max)
+    init_lowmem_pages = lowmem_max;
+  if (init_lowmem_pages > lowmem_limit)
+    init_lowmem_pages = lowmem_limit;
+
+  free_start = ptov(1024 * 1024);
+  pd = init_page_dir = boot_page();
+  features = cpuid_features();
+  init_large_pages = !no_pse && (features & CPUID_PSE);
+  init_global_pages = !no_pge && (features & CPUID_PGE);
+  global = init_global_pages ? PTE_G : 0;
   pt = NULL;
-  for (page = 0; page < init_ram_pages; page++) {
+  for (page = 0; page < init_lowmem_pages; page++) {
     uintptr_t paddr = page * PGSIZE;
     char* vaddr = ptov(paddr);
     size_t pde_idx = pd_no(vaddr);
     size_t pte_idx = pt_no(vaddr);
     bool in_kernel_text = &_start <= vaddr && vaddr < &_end_kernel_text;
 
+    /* Map each whole 4 MB of RAM with a single 4 MB page, which
+       takes one TLB entry instead of 1,024, unless it holds
+       kernel text, which must stay read-only page by page. */
+    if (init_large_pages && pte_idx == 0 && page + PTSPAN / PGSIZE <= init_lowmem_pages
+        && (vaddr + PTSPAN <= &_start || vaddr >= &_end_kernel_text)) {
+      pd[pde_idx] = pde_create_large(vaddr, true) | global;
+      page += PTSPAN / PGSIZE - 1;
+      continue;
+    }
+
     if (pd[pde_idx] == 0) {
-      pt = palloc_get_page(PAL_ASSERT | PAL_ZERO);
+      pt = boot_page();
       pd[pde_idx] = pde_create(pt);
     }
 
-    pt[pte_idx] = pte_create_kernel(vaddr, !in_kernel_text);
+    pt[pte_idx] = pte_create_kernel(vaddr, !in_kernel_text) | global;
   }
 
   /* Store the physical address of the page directory into CR3
@@ -176,9 +330,105 @@ static void paging_init(void) {
      new page tables immediately.  See [IA32-v2a] "MOV--Move
      to/from Control Registers" and [IA32-v3a] 3.7.5 "Base Address
      of the Page Directory". */
+  cr4_bits = (init_large_pages ? CR4_PSE : 0) | (init_global_pages ? CR4_PGE : 0);
+  if (cr4_bits != 0) {
+    uint32_t cr4;
+    asm volatile("movl %%cr4, %0; orl %1, %0; movl %0, %%cr4" : "=&r"(cr4) : "r"(cr4_bits));
+  }
   asm volatile("movl %0, %%cr3" : : "r"(vtop(init_page_dir)));
 }
 
+/* Returns a zeroed page for paging_init(), taken from the start
+   of free RAM, which the loader maps.  palloc_init() manages the
+   RAM that follows. */
+static void* boot_page(void) {
+  void* page = free_start;
+
+  free_start += PGSIZE;
+  memset(page, 0, PGSIZE);
+  return page;
+}
+
+/* Maps the SIZE bytes of device registers at physical address
+   PADDR into init_page_dir, uncached, at a kernel virtual address
+   equal to PADDR, and returns it.  Devices put their registers
+   far above the RAM mapped at PHYS_BASE, so PADDR is always a
+   kernel address.  Must be called before the first process
+   starts, so that every page directory that pagedir_create()
+   makes afterward inherits the mapping. */
+void* init_map_device(uintptr_t paddr, size_t size) {
+  uintptr_t page;
+
+  ASSERT(paddr >= (uintptr_t)ptov(init_lowmem_pages * PGSIZE));
+  ASSERT(!is_vmalloc_addr((void*)paddr) && !is_vmalloc_addr((void*)(paddr + size - 1)));
+
+  for (page = ROUND_DOWN(paddr, PGSIZE); page < paddr + size; page += PGSIZE) {
+    uint32_t* pd = init_page_dir;
+    void* vaddr = (void*)page;
+    uint32_t* pt;
+
+    ASSERT(!(pd[pd_no(vaddr)] & PTE_PS));
+    if ((pd[pd_no(vaddr)] & PTE_P) == 0) {
+      pt = palloc_get_page(PAL_ASSERT | PAL_ZERO);
+      pd[pd_no(vaddr)] = pde_create(pt);
+    } else
+      pt = pde_get_pt(pd[pd_no(vaddr)]);
+    pt[pt_no(vaddr)] = page | PTE_P | PTE_W | PTE_PCD;
+  }
+  return (void*)paddr;
+}
+
+/* Returns the feature flags that the CPUID instruction reports
+   in EDX.  See [IA32-v2a] "CPUID". */
+static uint32_t cpuid_features(void) {
+  uint32_t eax = 1, ebx, ecx, edx;
+
+  asm volatile("cpuid" : "+a"(eax), "=b"(ebx), "=c"(ecx), "=d"(edx));
+  return edx;
+}
+
+/* Returns the time stamp counter, or 0 if the CPU has none.
+   Unlike timer_cycles(), works before the timer is calibrated. */
+static uint64_t boot_clock(void) {
+  uint64_t tsc;
+
+  if (!(cpuid_features() & CPUID_TSC))
+    return 0;
+  asm volatile("rdtsc" : "=A"(tsc));
+  return tsc;
+}
+
+/* Records that the boot phase NAME has just ended. */
+static void boot_phase(const char* name) {
+  if (boot_phase_cnt < BOOT_PHASE_MAX) {
+    boot_phases[boot_phase_cnt].name = name;
+    boot_phases[boot_phase_cnt].tsc = boot_clock();
+    boot_phase_cnt++;
+  }
+}
+
+/* With -bootstats, prints how long each phase of boot took, up
+   to the load of the first user process. */
+void init_print_boot_stats(void) {
+  uint64_t prev = boot_tsc;
+  size_t i;
+
+  if (!boot_stats)
+    return;
+  if (boot_tsc == 0 || timer_cycles() == 0) {
+    printf("Boot profile: no calibrated TSC\n");
+    return;
+  }
+  printf("Boot profile:\n");
+  for (i = 0; i < boot_phase_cnt; i++) {
+    const struct boot_phase* p = &boot_phases[i];
+
+    printf("  %-36s %'8" PRId64 " us  (at %'8" PRId64 " us)\n", p->name,
+           timer_cycles_ns(p->tsc - prev) / 1000, timer_cycles_ns(p->tsc - boot_tsc) / 1000);
+    prev = p->tsc;
+  }
+}
+
 /* Breaks the kernel command line into words and returns them as
    an argv-like array. */
 static char** read_command_line(void) {
@@ -232,15 +482,92 @@ static char** parse_options(char** argv) {
       filesys_bdev_name = value;
     else if (!strcmp(name, "-scratch"))
       scratch_bdev_name = value;
+    else if (!strcmp(name, "-initramfs"))
+      initramfs_enabled = true;
+    else if (!strcmp(name, "-read-ahead"))
+      inode_read_ahead = atoi(value);
+    else if (!strcmp(name, "-inode-cache"))
+      inode_cache_max = atoi(value);
+    else if (!strcmp(name, "-flush"))
+      cache_flush_interval = atoi(value);
+    else if (!strcmp(name, "-no-dma"))
+      ide_no_dma = true;
+    else if (!strcmp(name, "-big-disks"))
+      ide_big_disks = true;
+    else if (!strcmp(name, "-ramdisk"))
+      ramdisk_kb = atoi(value);
 #ifdef VM
     else if (!strcmp(name, "-swap"))
       swap_bdev_name = value;
+    else if (!strcmp(name, "-stack"))
+      page_stack_limit = (size_t)atoi(value) * 1024;
+    else if (!strcmp(name, "-fault-around"))
+      page_fault_around = atoi(value);
+    else if (!strcmp(name, "-vm-stats"))
+      page_stats_enabled = true;
+    else if (!strcmp(name, "-zswap"))
+      zswap_limit = (size_t)atoi(value) * 1024;
+    else if (!strcmp(name, "-max-frames"))
+      thread_rlimits[RLIMIT_FRAMES] = atoi(value);
+    else if (!strcmp(name, "-merge"))
+      frame_merge_enabled = true;
+#endif
 #endif
+    else if (!strcmp(name, "-no-pse"))
+      no_pse = true;
+    else if (!strcmp(name, "-no-pge"))
+      no_pge = true;
+    else if (!strcmp(name, "-lowmem"))
+      lowmem_limit = (size_t)atoi(value) * (1024 * 1024 / PGSIZE);
+#ifdef USERPROG
+    else if (!strcmp(name, "-no-sysenter"))
+      sysenter_disabled = true;
+    else if (!strcmp(name, "-max-fds"))
+      thread_rlimits[RLIMIT_NOFILE] = atoi(value);
+    else if (!strcmp(name, "-max-children"))
+      thread_rlimits[RLIMIT_NPROC] = atoi(value);
+    else if (!strcmp(name, "-strace"))
+      strace_enabled = true;
 #endif
     else if (!strcmp(name, "-rs"))
       random_init(atoi(value));
     else if (!strcmp(name, "-mlfqs"))
       thread_mlfqs = true;
+    else if (!strcmp(name, "-mlfqs-tick"))
+      thread_mlfqs = thread_mlfqs_tick = true;
+    else if (!strcmp(name, "-smp"))
+      smp_enabled = true;
+    else if (!strcmp(name, "-balance"))
+      thread_balance_interval = atoi(value);
+    else if (!strcmp(name, "-tune"))
+      tunable_option(value);
+    else if (!strcmp(name, "-sched-trace"))
+      sched_trace_enabled = true;
+    else if (!strcmp(name, "-tracepoints"))
+      tracepoints_enabled = true;
+    else if (!strcmp(name, "-profile"))
+      profile_enabled = true;
+    else if (!strcmp(name, "-tickless"))
+      timer_tickless = true;
+    else if (!strcmp(name, "-loops"))
+      timer_calib_loops = atoi(value);
+    else if (!strcmp(name, "-tsc-khz"))
+      timer_calib_tsc_khz = atoi(value);
+    else if (!strcmp(name, "-lock-stats"))
+      lock_stats_enabled = true;
+    else if (!strcmp(name, "-intr-stats"))
+      intr_stats_enabled = true;
+    else if (!strcmp(name, "-bootstats"))
+      boot_stats = true;
+    else if (!strcmp(name, "-malloc-trace"))
+      malloc_trace = true;
+    else if (!strcmp(name, "-palloc")) {
+      if (!strcmp(value, "buddy"))
+        palloc_buddy = true;
+      else if (strcmp(value, "bitmap"))
+        PANIC("unknown page allocator `%s' (use bitmap or buddy)", value);
+    } else if (!strcmp(name, "-colors"))
+      palloc_colors = atoi(value);
 #ifdef USERPROG
     else if (!strcmp(name, "-ul"))
       user_page_limit = atoi(value);
@@ -268,7 +595,16 @@ static void run_task(char** argv) {
 
   printf("Executing '%s':\n", task);
 #ifdef USERPROG
-  process_wait(process_execute(task));
+  {
+    static bool loaded_one;
+    tid_t tid = process_execute(task);
+
+    if (!loaded_one) {
+      boot_phase("first user process loaded");
+      loaded_one = true;
+    }
+    process_wait(tid);
+  }
 #else
   run_test(task);
 #endif
@@ -294,6 +630,7 @@ static void run_actions(char** argv) {
       {"rm", 2, fsutil_rm},
       {"extract", 1, fsutil_extract},
       {"append", 2, fsutil_append},
+      {"bench", 2, fsutil_bench},
 #endif
       {NULL, 0, NULL},
   };
@@ -336,6 +673,7 @@ static void usage(void) {
          "  ls                 List files in the root directory.\n"
          "  cat FILE           Print FILE to the console.\n"
          "  rm FILE            Delete FILE.\n"
+         "  bench BDEV         Time reading BDEV by DMA and by PIO.\n"
          "Use these actions indirectly via `pintos' -g and -p options:\n"
          "  extract            Untar from scratch device into file system.\n"
          "  append FILE        Append FILE to tar file on scratch device.\n"
@@ -348,16 +686,55 @@ static void usage(void) {
          "  -f                 Format file system device during startup.\n"
          "  -filesys=BDEV      Use BDEV for file system instead of default.\n"
          "  -scratch=BDEV      Use BDEV for scratch instead of default.\n"
+         "  -initramfs         Run programs from the scratch archive, loaded into memory.\n"
+         "  -read-ahead=N      Read N sectors ahead of sequential file reads (default 8).\n"
+         "  -inode-cache=N     Keep up to N closed inodes for reuse (default 32).\n"
+         "  -flush=TICKS       Write dirty cached sectors every TICKS ticks (default 100).\n"
+         "  -no-dma            Transfer to and from IDE disks by PIO only.\n"
+         "  -big-disks         Use IDE disks over 1 GB, which are ignored for safety.\n"
+         "  -ramdisk=KB        Make a KB kB RAM disk, ram0, to name in -filesys etc.\n"
 #ifdef VM
          "  -swap=BDEV         Use BDEV for swap instead of default.\n"
+         "  -stack=KB          Let user stacks grow to KB kB (default 8192).\n"
+         "  -fault-around=N    Read N pages ahead of file page faults (default 4).\n"
+         "  -vm-stats          Print each process's paging statistics at exit.\n"
+         "  -zswap=KB          Keep up to KB kB of swapped pages compressed in memory.\n"
+         "  -max-frames=N      Keep at most N pages of each process in memory.\n"
+         "  -merge             Share one frame among anonymous pages with equal contents.\n"
+#endif
 #endif
+         "  -no-pse            Map kernel memory with 4 kB pages only.\n"
+         "  -no-pge            Map kernel memory with non-global pages.\n"
+         "  -lowmem=MB         Map at most MB MB of RAM directly; the rest is high memory.\n"
+#ifdef USERPROG
+         "  -no-sysenter       Make system calls through int $0x30 only.\n"
+         "  -max-fds=N         Limit each process to file descriptors below N.\n"
+         "  -max-children=N    Limit each process to N children not waited for.\n"
+         "  -strace            Log every process's system calls to the console.\n"
 #endif
          "  -rs=SEED           Set random number seed to SEED.\n"
          "  -mlfqs             Use multi-level feedback queue scheduler.\n"
+         "  -mlfqs-tick        Same, with statistics updated in the timer interrupt.\n"
+         "  -smp               Start application processors (parked).\n"
+         "  -balance=TICKS     Rebalance run queues every TICKS ticks (0: never).\n"
+         "  -tune=NAME=VALUE   Set tunable NAME, from the list below, to VALUE.\n"
+         "  -sched-trace       Trace thread switches, dump them at shutdown.\n"
+         "  -tracepoints       Record fs, block, vm and syscall events, dump them at shutdown.\n"
+         "  -profile           Sample code on each timer tick, dump samples at shutdown.\n"
+         "  -tickless          Stop the periodic timer tick while idle.\n"
+         "  -loops=N           Take N loops per timer tick instead of calibrating.\n"
+         "  -tsc-khz=N         Take the TSC to run at N kHz instead of calibrating.\n"
+         "  -lock-stats        Profile lock contention, report it at shutdown.\n"
+         "  -intr-stats        Time interrupts and interrupts-off windows.\n"
+         "  -bootstats         Time each phase of boot, report it at shutdown.\n"
+         "  -malloc-trace      Record malloc() callers, report leaks at shutdown.\n"
+         "  -palloc=BACKEND    Allocate pages with BACKEND: bitmap (default) or buddy.\n"
+         "  -colors=N          Give user pages N physical colors matching their virtual ones.\n"
 #ifdef USERPROG
          "  -ul=COUNT          Limit user memory to COUNT pages.\n"
 #endif
          );
+  tunable_print();
   shutdown_power_off();
 }
 
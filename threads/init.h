@@ -9,4 +9,18 @@
 /* Page directory with kernel mappings only. */
 extern uint32_t* init_page_dir;
 
+/* True if init_page_dir maps RAM with 4 MB pages. */
+extern bool init_large_pages;
+
+/* True if init_page_dir maps RAM with global pages. */
+extern bool init_global_pages;
+
+/* Pages of RAM that init_page_dir maps at PHYS_BASE, from
+   physical address 0.  The rest, up to init_ram_pages, is high
+   memory (see threads/highmem.c). */
+extern uint32_t init_lowmem_pages;
+
+void* init_map_device(uintptr_t paddr, size_t size);
+void init_print_boot_stats(void);
+
 #endif /* threads/init.h */
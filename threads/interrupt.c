@@ -9,6 +9,9 @@
 #include "threads/thread.h"
 #include "threads/vaddr.h"
 #include "devices/timer.h"
+#ifdef USERPROG
+#include "userprog/process.h"
+#endif
 
 /* Programmable Interrupt Controller (PIC) registers.
    A PC has two PICs, called the master and slave PICs, with the
@@ -37,6 +40,44 @@ static const char* intr_names[INTR_CNT];
    unexpected interrupt is one that has no registered handler. */
 static unsigned int unexpected_cnt[INTR_CNT];
 
+/* Interrupt statistics.
+
+   With the -intr-stats option, every vector's interrupts are
+   counted and the time stamp counter measures the cycles spent
+   in each vector's handler, from intr_handler() calling it until
+   it returns, and every window in which interrupts are off: from
+   intr_disable() or interrupt entry turning them off until
+   intr_enable() or the return from the interrupt turns them back
+   on.  A window longer than a timer tick loses a tick.  The
+   longest window is reported with the addresses of the code that
+   opened and closed it, which the backtrace utility turns into
+   functions and lines; for a window opened or closed by an
+   interrupt, that is the address of its handler.  Windows are
+   measured on one CPU at a time, which is all the -smp kernel
+   runs threads on.  Until timer_calibrate() has run, the TSC
+   clock reads 0 and nothing is timed. */
+bool intr_stats_enabled;
+
+/* Number of buckets in the histogram of interrupts-off windows.
+   Bucket B counts windows of 2**B to 2**(B+1) - 1 cycles. */
+#define OFF_HIST_CNT 40
+
+static unsigned long long vec_cnt[INTR_CNT];    /* Interrupts per vector. */
+static unsigned long long vec_cycles[INTR_CNT]; /* Cycles in each vector's handler. */
+static uint64_t vec_max[INTR_CNT];              /* Longest run of each vector's handler. */
+
+static bool off_timing;                           /* Is an interrupts-off window open? */
+static uint64_t off_start;                        /* TSC when it opened. */
+static void* off_site;                            /* Code that opened it. */
+static unsigned long long off_cnt;                /* Windows measured. */
+static unsigned long long off_hist[OFF_HIST_CNT]; /* Their lengths. */
+static uint64_t off_max;                          /* Longest window. */
+static void* off_max_begin;                       /* Code that opened it. */
+static void* off_max_end;                         /* Code that closed it. */
+
+static void off_begin(void* site);
+static void off_end(void* site);
+
 /* External interrupts are those generated by devices outside the
    CPU, such as the timer.  External interrupts run with
    interrupts turned off, so they never nest, nor are they ever
@@ -47,6 +88,26 @@ static unsigned int unexpected_cnt[INTR_CNT];
 static bool in_external_intr; /* Are we processing an external interrupt? */
 static bool yield_on_return;  /* Should we yield on interrupt return? */
 
+/* Deferred work.
+
+   An external interrupt handler keeps its own work, which runs
+   with interrupts off, to what cannot wait, such as
+   acknowledging its device, and passes the rest to intr_defer().
+   Deferred work runs once the interrupt has been acknowledged on
+   the PIC, just before the outermost external interrupt returns,
+   in the order it was deferred, with interrupts on, so that other
+   interrupts can come in while it runs.  Such a nested interrupt
+   leaves the deferred work it adds, and its request to yield, to
+   the interrupt it came in on.
+
+   Deferred work runs in whichever thread was interrupted, so it
+   is still interrupt context: it may not sleep, but it may call
+   intr_yield_on_return(). */
+static struct list deferred; /* Work deferred and not yet run. */
+static bool in_deferred;     /* Are we running deferred work? */
+
+static void run_deferred(void);
+
 /* Programmable Interrupt Controller helpers. */
 static void pic_init(void);
 static void pic_end_of_interrupt(int irq);
@@ -59,6 +120,8 @@ static inline uint64_t make_idtr_operand(uint16_t limit, void* base);
 /* Interrupt handlers. */
 void intr_handler(struct intr_frame* args);
 static void unexpected_interrupt(const struct intr_frame*);
+static enum intr_level enable_at(void* site);
+static enum intr_level disable_at(void* site);
 
 /* Returns the current interrupt status. */
 enum intr_level intr_get_level(void) {
@@ -76,13 +139,23 @@ enum intr_level intr_get_level(void) {
 /* Enables or disables interrupts as specified by LEVEL and
    returns the previous interrupt status. */
 enum intr_level intr_set_level(enum intr_level level) {
-  return level == INTR_ON ? intr_enable() : intr_disable();
+  void* site = __builtin_return_address(0);
+  return level == INTR_ON ? enable_at(site) : disable_at(site);
 }
 
 /* Enables interrupts and returns the previous interrupt status. */
-enum intr_level intr_enable(void) {
+enum intr_level intr_enable(void) { return enable_at(__builtin_return_address(0)); }
+
+/* Disables interrupts and returns the previous interrupt status. */
+enum intr_level intr_disable(void) { return disable_at(__builtin_return_address(0)); }
+
+/* Does the work of intr_enable() for a call from SITE. */
+static enum intr_level enable_at(void* site) {
   enum intr_level old_level = intr_get_level();
-  ASSERT(!intr_context());
+  ASSERT(!in_external_intr);
+
+  if (old_level == INTR_OFF && intr_stats_enabled)
+    off_end(site);
 
   /* Enable interrupts by setting the interrupt flag.
 
@@ -93,8 +166,8 @@ enum intr_level intr_enable(void) {
   return old_level;
 }
 
-/* Disables interrupts and returns the previous interrupt status. */
-enum intr_level intr_disable(void) {
+/* Does the work of intr_disable() for a call from SITE. */
+static enum intr_level disable_at(void* site) {
   enum intr_level old_level = intr_get_level();
 
   /* Disable interrupts by clearing the interrupt flag.
@@ -102,6 +175,9 @@ enum intr_level intr_disable(void) {
      Hardware Interrupts". */
   asm volatile("cli" : : : "memory");
 
+  if (old_level == INTR_ON && intr_stats_enabled)
+    off_begin(site);
+
   return old_level;
 }
 
@@ -112,6 +188,7 @@ void intr_init(void) {
 
   /* Initialize interrupt controller. */
   pic_init();
+  list_init(&deferred);
 
   /* Initialize IDT. */
   for (i = 0; i < INTR_CNT; i++)
@@ -189,14 +266,14 @@ void intr_register_int(uint8_t vec_no, int dpl, enum intr_level level, intr_hand
   register_handler(vec_no, dpl, level, handler, name);
 }
 
-/* Returns true during processing of an external interrupt
-   and false at all other times. */
-bool intr_context(void) { return in_external_intr; }
+/* Returns true during processing of an external interrupt or of
+   deferred work, and false at all other times. */
+bool intr_context(void) { return in_external_intr || in_deferred; }
 
-/* During processing of an external interrupt, directs the
-   interrupt handler to yield to a new process just before
-   returning from the interrupt.  May not be called at any other
-   time. */
+/* During processing of an external interrupt or deferred work,
+   directs the interrupt handler to yield to a new process just
+   before returning from the interrupt.  May not be called at any
+   other time. */
 void intr_yield_on_return(void) {
   ASSERT(intr_context());
   yield_on_return = true;
@@ -309,6 +386,15 @@ static inline uint64_t make_idtr_operand(uint16_t limit, void* base) {
 void intr_handler(struct intr_frame* frame) {
   bool external;
   intr_handler_func* handler;
+  uint64_t start = 0;
+
+  if (intr_stats_enabled) {
+    /* An interrupt gate turned interrupts off on the way in. */
+    if ((frame->eflags & FLAG_IF) && intr_get_level() == INTR_OFF)
+      off_begin((void*)intr_handlers[frame->vec_no]);
+    vec_cnt[frame->vec_no]++;
+    start = timer_cycles();
+  }
 
   /* External interrupts are special.
      We only handle one at a time (so interrupts must be off)
@@ -317,10 +403,14 @@ void intr_handler(struct intr_frame* frame) {
   external = frame->vec_no >= 0x20 && frame->vec_no < 0x30;
   if (external) {
     ASSERT(intr_get_level() == INTR_OFF);
-    ASSERT(!intr_context());
+    ASSERT(!in_external_intr);
 
     in_external_intr = true;
-    yield_on_return = false;
+    if (!in_deferred)
+      yield_on_return = false;
+
+    /* Account for the ticks of a tickless idle period. */
+    timer_restart_ticks();
   }
 
   /* Invoke the interrupt's handler. */
@@ -334,6 +424,14 @@ void intr_handler(struct intr_frame* frame) {
   } else
     unexpected_interrupt(frame);
 
+  if (start != 0) {
+    uint64_t cycles = timer_cycles() - start;
+
+    vec_cycles[frame->vec_no] += cycles;
+    if (cycles > vec_max[frame->vec_no])
+      vec_max[frame->vec_no] = cycles;
+  }
+
   /* Complete the processing of an external interrupt. */
   if (external) {
     ASSERT(intr_get_level() == INTR_OFF);
@@ -342,9 +440,113 @@ void intr_handler(struct intr_frame* frame) {
     in_external_intr = false;
     pic_end_of_interrupt(frame->vec_no);
 
-    if (yield_on_return)
-      thread_yield();
+    if (!in_deferred) {
+      if (!list_empty(&deferred))
+        run_deferred();
+      if (yield_on_return)
+        thread_preempt();
+    }
+  }
+
+#ifdef USERPROG
+  /* The threads of an exiting process die on their way back to
+     user mode. */
+  if (external && !in_deferred && (frame->cs & 3) == 3)
+    process_check_exit();
+#endif
+
+  /* Returning will turn interrupts back on. */
+  if (intr_stats_enabled && (frame->eflags & FLAG_IF) && intr_get_level() == INTR_OFF)
+    off_end((void*)intr_handlers[frame->vec_no]);
+}
+
+/* Initializes W as work that calls FUNC, passing AUX, when it is
+   deferred. */
+void intr_work_init(struct intr_work* w, intr_work_func* func, void* aux) {
+  w->func = func;
+  w->aux = aux;
+  w->pending = false;
+}
+
+/* Defers work W to run just before the current external
+   interrupt returns, unless it is already deferred and has not
+   run yet.  Must be called in interrupt context. */
+void intr_defer(struct intr_work* w) {
+  ASSERT(intr_context());
+  ASSERT(intr_get_level() == INTR_OFF);
+
+  if (!w->pending) {
+    w->pending = true;
+    list_push_back(&deferred, &w->elem);
+  }
+}
+
+/* Runs deferred work until there is none left, with interrupts
+   on while each piece runs. */
+static void run_deferred(void) {
+  ASSERT(intr_get_level() == INTR_OFF);
+
+  in_deferred = true;
+  while (!list_empty(&deferred)) {
+    struct intr_work* w = list_entry(list_pop_front(&deferred), struct intr_work, elem);
+
+    w->pending = false;
+    intr_enable();
+    w->func(w->aux);
+    intr_disable();
   }
+  in_deferred = false;
+}
+
+/* Opens an interrupts-off window, which SITE has just turned
+   interrupts off for. */
+static void off_begin(void* site) {
+  off_start = timer_cycles();
+  off_site = site;
+  off_timing = off_start != 0;
+}
+
+/* Closes the open interrupts-off window, if any, as SITE is
+   about to turn interrupts on. */
+static void off_end(void* site) {
+  uint64_t cycles;
+  int b;
+
+  if (!off_timing)
+    return;
+  off_timing = false;
+  cycles = timer_cycles() - off_start;
+
+  off_cnt++;
+  for (b = 0; b < OFF_HIST_CNT - 1 && cycles >> (b + 1) != 0; b++)
+    continue;
+  off_hist[b]++;
+  if (cycles > off_max) {
+    off_max = cycles;
+    off_max_begin = off_site;
+    off_max_end = site;
+  }
+}
+
+/* Prints interrupt statistics. */
+void intr_print_stats(void) {
+  int i;
+
+  if (!intr_stats_enabled)
+    return;
+  for (i = 0; i < INTR_CNT; i++)
+    if (vec_cnt[i] != 0)
+      printf("Interrupt %#04x (%s): %llu, %" PRId64 " ns avg, %" PRId64 " ns max\n", i,
+             intr_names[i], vec_cnt[i], timer_cycles_ns(vec_cycles[i] / vec_cnt[i]),
+             timer_cycles_ns(vec_max[i]));
+  if (off_cnt == 0)
+    return;
+  printf("Interrupts off: %llu windows, longest %" PRId64 " ns from %p to %p\n", off_cnt,
+         timer_cycles_ns(off_max), off_max_begin, off_max_end);
+  for (i = 0; i < OFF_HIST_CNT; i++)
+    if (off_hist[i] != 0)
+      printf("Interrupts off: %llu windows of %" PRId64 " ns or more\n", off_hist[i],
+             timer_cycles_ns((uint64_t)1 << i));
 }
 
 /* Handles an unexpected interrupt with interrupt frame F.  An
@@ -1,6 +1,7 @@
 #ifndef THREADS_INTERRUPT_H
 #define THREADS_INTERRUPT_H
 
+#include <list.h>
 #include <stdbool.h>
 #include <stdint.h>
 
@@ -10,6 +11,9 @@ enum intr_level {
   INTR_ON   /* Interrupts enabled. */
 };
 
+/* -intr-stats: Time interrupt handlers and interrupts-off windows? */
+extern bool intr_stats_enabled;
+
 enum intr_level intr_get_level(void);
 enum intr_level intr_set_level(enum intr_level);
 enum intr_level intr_enable(void);
@@ -61,7 +65,21 @@ void intr_register_int(uint8_t vec, int dpl, enum intr_level, intr_handler_func*
 bool intr_context(void);
 void intr_yield_on_return(void);
 
+/* Work that an external interrupt handler defers to run with
+   interrupts on, just before the interrupt returns. */
+typedef void intr_work_func(void* aux);
+struct intr_work {
+  struct list_elem elem; /* Element in the deferred work list. */
+  intr_work_func* func;  /* Function to call. */
+  void* aux;             /* Its argument. */
+  bool pending;          /* Deferred and not yet run? */
+};
+
+void intr_work_init(struct intr_work*, intr_work_func*, void* aux);
+void intr_defer(struct intr_work*);
+
 void intr_dump_frame(const struct intr_frame*);
 const char* intr_name(uint8_t vec);
+void intr_print_stats(void);
 
 #endif /* threads/interrupt.h */
@@ -0,0 +1,190 @@
+#include "threads/ipi.h"
+#include <debug.h>
+#include "threads/cpu.h"
+#include "threads/interrupt.h"
+#include "threads/kstat.h"
+#include "threads/lapic.h"
+#include "threads/vaddr.h"
+
+/* Inter-processor interrupts.
+
+   One CPU asks another to run a function by queuing a message in
+   the other's mailbox with ipi_call() and interrupting it through
+   the local APICs.  The interrupted CPU takes the whole mailbox
+   in ipi_drain() and runs the calls in the order they were
+   queued.  thread_unblock() uses this to put a woken thread on
+   another CPU's run queue, and tlb_shootdown() to flush stale
+   translations from the TLBs of the other CPUs that have a page
+   directory loaded.
+
+   A mailbox is a singly linked stack that any number of CPUs
+   push onto with compare-and-exchange and that its own CPU
+   empties with one exchange, so neither side takes a lock, and
+   no message can be lost or taken twice.  Only a push onto an
+   empty mailbox sends an interrupt: later ones ride along with
+   the interrupt that is already on its way, so a burst of calls
+   to one CPU costs one interrupt.
+
+   The application processors are parked for now (see
+   threads/cpu.c), and none schedules threads or loads a user page
+   directory, so every call still stays on the bootstrap
+   processor; this is the signalling that lets the others take
+   part later. */
+
+/* Pages above which tlb_shootdown() reloads CR3 instead of
+   invalidating each page. */
+#define FLUSH_PAGES_MAX 32
+
+/* A TLB shootdown waiting for other CPUs. */
+struct shootdown {
+  uint32_t* pd;         /* Page directory whose pages changed. */
+  const void* start;    /* First page. */
+  size_t page_cnt;      /* Number of pages. */
+  volatile int pending; /* CPUs that have not flushed yet. */
+};
+
+/* Statistics. */
+static long long ipi_sent;       /* Interrupts sent. */
+static long long ipi_calls;      /* Calls run from mailboxes. */
+static long long shootdowns;     /* tlb_shootdown() calls. */
+static long long remote_flushes; /* Flushes done at another CPU's request. */
+
+static intr_handler_func ipi_interrupt;
+static ipi_func remote_flush;
+static void flush_local(uint32_t* pd, const void* start, size_t page_cnt);
+static uint32_t* active_pd(void);
+
+/* Registers the inter-processor interrupt. */
+void ipi_init(void) {
+  intr_register_int(IPI_VECTOR, 0, INTR_OFF, ipi_interrupt, "IPI");
+  kstat_counter("ipi.sent", &ipi_sent);
+  kstat_counter("ipi.calls", &ipi_calls);
+  kstat_counter("tlb.shootdowns", &shootdowns);
+  kstat_counter("tlb.remote_flushes", &remote_flushes);
+}
+
+/* Arranges for CPU C to call FUNC with AUX, using M, as soon as
+   it takes an interrupt.  Calls to C run in the order queued.
+   Does not wait for the call.  Interrupts must be off. */
+void ipi_call(struct cpu* c, struct ipi_msg* m, ipi_func* func, void* aux) {
+  struct ipi_msg* head;
+
+  ASSERT(intr_get_level() == INTR_OFF);
+
+  m->func = func;
+  m->aux = aux;
+  do {
+    head = c->ipi_mailbox;
+    m->next = head;
+  } while (!__sync_bool_compare_and_swap(&c->ipi_mailbox, head, m));
+
+  if (head == NULL) {
+    ipi_sent++;
+    lapic_send_ipi(c->apic_id, IPI_VECTOR);
+  }
+}
+
+/* Runs the calls in the current CPU's mailbox.  Interrupts must
+   be off. */
+void ipi_drain(void) {
+  struct ipi_msg* m;
+  struct ipi_msg* fifo = NULL;
+
+  ASSERT(intr_get_level() == INTR_OFF);
+
+  /* Take the whole stack, then reverse it into queuing order. */
+  m = __sync_lock_test_and_set(&cpu_current()->ipi_mailbox, NULL);
+  while (m != NULL) {
+    struct ipi_msg* next = m->next;
+
+    m->next = fifo;
+    fifo = m;
+    m = next;
+  }
+
+  while (fifo != NULL) {
+    struct ipi_msg* next = fifo->next;
+
+    ipi_calls++;
+    fifo->func(fifo->aux);
+    fifo = next;
+  }
+}
+
+/* Invalidates the PAGE_CNT pages starting at START, which have
+   changed in page directory PD, in the TLB of every CPU that has
+   PD loaded, and waits until they all have.  A range takes one
+   message per CPU, however many pages it has. */
+void tlb_shootdown(uint32_t* pd, const void* start, size_t page_cnt) {
+  struct ipi_msg msgs[CPU_MAX];
+  struct shootdown s;
+  enum intr_level old_level;
+  struct cpu* self;
+  unsigned i;
+
+  ASSERT(pg_ofs(start) == 0);
+
+  old_level = intr_disable();
+  shootdowns++;
+  flush_local(pd, start, page_cnt);
+
+  self = cpu_current();
+  s.pd = pd;
+  s.start = start;
+  s.page_cnt = page_cnt;
+  s.pending = 0;
+  for (i = 0; i < cpu_cnt; i++) {
+    struct cpu* c = &cpus[i];
+
+    if (c != self && c->started && c->pagedir == pd) {
+      __sync_fetch_and_add(&s.pending, 1);
+      ipi_call(c, &msgs[i], remote_flush, &s);
+    }
+  }
+
+  /* Serve our own mailbox while waiting, in case one of the CPUs
+     is waiting on us in turn. */
+  while (s.pending > 0)
+    ipi_drain();
+  intr_set_level(old_level);
+}
+
+/* Handles an inter-processor interrupt. */
+static void ipi_interrupt(struct intr_frame* f UNUSED) {
+  lapic_eoi();
+  ipi_drain();
+}
+
+/* Flushes the range of the struct shootdown S_ from this CPU's
+   TLB, at another CPU's request. */
+static void remote_flush(void* s_) {
+  struct shootdown* s = s_;
+
+  remote_flushes++;
+  flush_local(s->pd, s->start, s->page_cnt);
+  __sync_fetch_and_sub(&s->pending, 1);
+}
+
+/* Invalidates the PAGE_CNT pages starting at START in this CPU's
+   TLB, if PD is loaded: one at a time, or by reloading CR3 for a
+   large range. */
+static void flush_local(uint32_t* pd, const void* start, size_t page_cnt) {
+  const uint8_t* p = start;
+  size_t i;
+
+  if (active_pd() != pd)
+    return;
+  if (page_cnt > FLUSH_PAGES_MAX)
+    asm volatile("movl %0, %%cr3" : : "r"(vtop(pd)) : "memory");
+  else
+    for (i = 0; i < page_cnt; i++)
+      asm volatile("invlpg (%0)" : : "r"(p + i * PGSIZE) : "memory");
+}
+
+/* Returns the page directory loaded in CR3. */
+static uint32_t* active_pd(void) {
+  uintptr_t pd;
+
+  asm volatile("movl %%cr3, %0" : "=r"(pd));
+  return ptov(pd);
+}
@@ -0,0 +1,29 @@
+#ifndef THREADS_IPI_H
+#define THREADS_IPI_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct cpu;
+
+/* Interrupt vector of inter-processor interrupts. */
+#define IPI_VECTOR 0xf0
+
+/* Function that ipi_call() runs on another CPU, with interrupts
+   off, given its AUX. */
+typedef void ipi_func(void* aux);
+
+/* A call queued in a CPU's mailbox.  Must stay valid until FUNC
+   has started; FUNC may reuse or free it. */
+struct ipi_msg {
+  struct ipi_msg* next; /* Next in the mailbox. */
+  ipi_func* func;       /* Function to call. */
+  void* aux;            /* Its argument. */
+};
+
+void ipi_init(void);
+void ipi_call(struct cpu*, struct ipi_msg*, ipi_func*, void* aux);
+void ipi_drain(void);
+void tlb_shootdown(uint32_t* pd, const void* start, size_t page_cnt);
+
+#endif /* threads/ipi.h */
@@ -0,0 +1,127 @@
+#include "threads/kstat.h"
+#include <debug.h>
+#include <string.h>
+#include "threads/interrupt.h"
+#include "threads/percpu.h"
+
+/* Registry of kernel statistics.
+
+   Each subsystem keeps counting in its own variables, which it
+   already prints at shutdown, and registers them here under a
+   name, so that the kstat system call can report them all while
+   the system runs.  A counter is registered by address: bumping
+   it stays a plain increment, with nothing added to the hot
+   path, and only a snapshot reads it.  A per-CPU counter (see
+   threads/percpu.c) is registered the same way and summed when
+   read.  A gauge is registered as a function that computes its
+   value, for levels such as free pages that no one variable
+   holds.
+
+   Entries are never removed, so the registry is a fixed array
+   that fills in the order of registration.  Registering is safe
+   from the earliest *_init() functions, before malloc() is
+   ready. */
+
+#define KSTAT_MAX 128 /* Most statistics that may be registered. */
+
+/* A registered statistic. */
+struct kstat_entry {
+  char name[KSTAT_NAME_MAX + 1];       /* Name. */
+  const long long* counter;            /* Counter, or null. */
+  const struct percpu_counter* percpu; /* Per-CPU counter, or null. */
+  kstat_func* func;                    /* Gauge's function, or null. */
+  void* aux;                           /* Its argument. */
+};
+
+static struct kstat_entry entries[KSTAT_MAX];
+static int entry_cnt; /* Entries registered so far. */
+
+static void add_entry(const char*, const long long*, const struct percpu_counter*, kstat_func*,
+                      void*);
+static long long read_counter(const long long*);
+
+/* Registers COUNTER, which must stay allocated for good, under
+   NAME. */
+void kstat_counter(const char* name, const long long* counter) {
+  ASSERT(counter != NULL);
+  add_entry(name, counter, NULL, NULL, NULL);
+}
+
+/* Registers per-CPU counter COUNTER, which must stay allocated
+   for good, under NAME. */
+void kstat_percpu(const char* name, const struct percpu_counter* counter) {
+  ASSERT(counter != NULL);
+  add_entry(name, NULL, counter, NULL, NULL);
+}
+
+/* Registers a gauge named NAME whose value FUNC(AUX) reports.
+   FUNC is called with interrupts on and may take locks. */
+void kstat_gauge(const char* name, kstat_func* func, void* aux) {
+  ASSERT(func != NULL);
+  add_entry(name, NULL, NULL, func, aux);
+}
+
+/* Stores the values of up to MAX statistics in BUF, in the order
+   they were registered, and returns the number registered, which
+   may be more than MAX.  The counters are read together with
+   interrupts off; the gauges afterward. */
+int kstat_snapshot(struct kstat* buf, int max) {
+  enum intr_level old_level;
+  int cnt, i;
+
+  ASSERT(!intr_context());
+
+  old_level = intr_disable();
+  cnt = entry_cnt < max ? entry_cnt : max;
+  for (i = 0; i < cnt; i++) {
+    const struct kstat_entry* e = &entries[i];
+
+    memcpy(buf[i].name, e->name, sizeof buf[i].name);
+    buf[i].type = e->func == NULL ? KSTAT_COUNTER : KSTAT_GAUGE;
+    if (e->counter != NULL)
+      buf[i].value = read_counter(e->counter);
+    else if (e->percpu != NULL)
+      buf[i].value = percpu_read(e->percpu);
+    else
+      buf[i].value = 0;
+  }
+  intr_set_level(old_level);
+
+  for (i = 0; i < cnt; i++)
+    if (entries[i].func != NULL)
+      buf[i].value = entries[i].func(entries[i].aux);
+  return entry_cnt;
+}
+
+/* Adds an entry named NAME to the registry. */
+static void add_entry(const char* name, const long long* counter,
+                      const struct percpu_counter* percpu, kstat_func* func, void* aux) {
+  enum intr_level old_level = intr_disable();
+  struct kstat_entry* e;
+
+  if (entry_cnt >= KSTAT_MAX)
+    PANIC("kstat: too many statistics, registering \"%s\"", name);
+  e = &entries[entry_cnt];
+  strlcpy(e->name, name, sizeof e->name);
+  e->counter = counter;
+  e->percpu = percpu;
+  e->func = func;
+  e->aux = aux;
+  entry_cnt++;
+  intr_set_level(old_level);
+}
+
+/* Reads *COUNTER, which another CPU may be incrementing.  A
+   64-bit load is two 32-bit loads here, so a carry into the high
+   word between them would tear the value: read until the high
+   word holds still. */
+static long long read_counter(const long long* counter) {
+  const volatile unsigned* words = (const volatile unsigned*)counter;
+  unsigned hi, lo;
+
+  do {
+    hi = words[1];
+    lo = words[0];
+  } while (words[1] != hi);
+  return (long long)hi << 32 | lo;
+}
@@ -0,0 +1,17 @@
+#ifndef THREADS_KSTAT_H
+#define THREADS_KSTAT_H
+
+#include <kstat.h>
+
+struct percpu_counter;
+
+/* Function that reports the current value of a gauge, given the
+   AUX that kstat_gauge() registered it with. */
+typedef long long kstat_func(void* aux);
+
+void kstat_counter(const char* name, const long long* counter);
+void kstat_percpu(const char* name, const struct percpu_counter*);
+void kstat_gauge(const char* name, kstat_func*, void* aux);
+int kstat_snapshot(struct kstat*, int max);
+
+#endif /* threads/kstat.h */
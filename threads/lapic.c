@@ -0,0 +1,104 @@
+#include "threads/lapic.h"
+#include <debug.h>
+#include "threads/init.h"
+#include "threads/vaddr.h"
+
+/* Local APIC.  See [IA32-v3a] chapter 8 "Advanced Programmable
+   Interrupt Controller (APIC)" for details.
+
+   Each processor has a local APIC whose registers are memory
+   mapped, by default at physical address 0xfee00000.  That is
+   far above the RAM we map at PHYS_BASE, so lapic_init() maps
+   the register page with init_map_device(). */
+
+/* Register offsets, in bytes. */
+#define LAPIC_ID 0x020     /* Local APIC ID; ID in bits 24...31. */
+#define LAPIC_EOI 0x0b0    /* End of interrupt. */
+#define LAPIC_SVR 0x0f0    /* Spurious interrupt vector register. */
+#define LAPIC_ICR_LO 0x300 /* Interrupt command register, low half. */
+#define LAPIC_ICR_HI 0x310 /* Interrupt command register, high half. */
+
+/* SVR bits. */
+#define SVR_ENABLE 0x100 /* APIC software enable. */
+#define SVR_VECTOR 0xff  /* Vector for spurious interrupts. */
+
+/* ICR bits. */
+#define ICR_FIXED 0x00000000   /* Fixed delivery mode, with a vector. */
+#define ICR_INIT 0x00000500    /* INIT delivery mode. */
+#define ICR_STARTUP 0x00000600 /* Start-up delivery mode. */
+#define ICR_PENDING 0x00001000 /* Delivery status: send pending. */
+#define ICR_ASSERT 0x00004000  /* Level: assert. */
+
+/* Mapped register page, or a null pointer if we have no local
+   APIC. */
+static volatile uint32_t* lapic;
+
+static uint32_t lapic_read(uint32_t reg);
+static void lapic_write(uint32_t reg, uint32_t value);
+static void lapic_wait(void);
+
+/* Maps the local APIC registers at physical address PHYS_BASE,
+   as reported by the MP configuration table. */
+void lapic_init(uintptr_t phys_base) {
+  lapic = init_map_device(phys_base, PGSIZE);
+}
+
+/* Returns true if lapic_init() mapped a local APIC. */
+bool lapic_present(void) { return lapic != NULL; }
+
+/* Software-enables the current CPU's local APIC. */
+void lapic_enable(void) {
+  ASSERT(lapic_present());
+  lapic_write(LAPIC_SVR, lapic_read(LAPIC_SVR) | SVR_ENABLE | SVR_VECTOR);
+}
+
+/* Returns the local APIC ID of the current CPU. */
+uint8_t lapic_id(void) { return lapic_present() ? lapic_read(LAPIC_ID) >> 24 : 0; }
+
+/* Sends an INIT IPI to the CPU with the given APIC_ID, which
+   resets it into a wait-for-SIPI state. */
+void lapic_send_init(uint8_t apic_id) {
+  ASSERT(lapic_present());
+  lapic_write(LAPIC_ICR_HI, (uint32_t)apic_id << 24);
+  lapic_write(LAPIC_ICR_LO, ICR_INIT | ICR_ASSERT);
+  lapic_wait();
+}
+
+/* Sends a start-up IPI to the CPU with the given APIC_ID, which
+   starts it in real mode at physical address START_PADDR.
+   START_PADDR must be page-aligned and below 1 MB. */
+void lapic_send_startup(uint8_t apic_id, uintptr_t start_paddr) {
+  ASSERT(lapic_present());
+  ASSERT(start_paddr % PGSIZE == 0 && start_paddr < 0x100000);
+  lapic_write(LAPIC_ICR_HI, (uint32_t)apic_id << 24);
+  lapic_write(LAPIC_ICR_LO, ICR_STARTUP | ICR_ASSERT | (start_paddr >> 12));
+  lapic_wait();
+}
+
+/* Sends an interrupt with vector VEC to the CPU with the given
+   APIC_ID. */
+void lapic_send_ipi(uint8_t apic_id, uint8_t vec) {
+  ASSERT(lapic_present());
+  lapic_write(LAPIC_ICR_HI, (uint32_t)apic_id << 24);
+  lapic_write(LAPIC_ICR_LO, ICR_FIXED | ICR_ASSERT | vec);
+  lapic_wait();
+}
+
+/* Acknowledges the interrupt that the current CPU's local APIC
+   delivered last. */
+void lapic_eoi(void) {
+  if (lapic_present())
+    lapic_write(LAPIC_EOI, 0);
+}
+
+/* Returns the register at byte offset REG. */
+static uint32_t lapic_read(uint32_t reg) { return lapic[reg / sizeof *lapic]; }
+
+/* Sets the register at byte offset REG to VALUE. */
+static void lapic_write(uint32_t reg, uint32_t value) { lapic[reg / sizeof *lapic] = value; }
+
+/* Waits for the last IPI to be accepted. */
+static void lapic_wait(void) {
+  while (lapic_read(LAPIC_ICR_LO) & ICR_PENDING)
+    continue;
+}
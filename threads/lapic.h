@@ -0,0 +1,16 @@
+#ifndef THREADS_LAPIC_H
+#define THREADS_LAPIC_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+void lapic_init(uintptr_t phys_base);
+bool lapic_present(void);
+void lapic_enable(void);
+uint8_t lapic_id(void);
+void lapic_send_init(uint8_t apic_id);
+void lapic_send_startup(uint8_t apic_id, uintptr_t start_paddr);
+void lapic_send_ipi(uint8_t apic_id, uint8_t vec);
+void lapic_eoi(void);
+
+#endif /* threads/lapic.h */
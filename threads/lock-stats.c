@@ -0,0 +1,159 @@
+#include "threads/lock-stats.h"
+#include <debug.h>
+#include <stdio.h>
+#include "devices/timer.h"
+#include "threads/interrupt.h"
+
+/* Lock contention profile.
+
+   With the -lock-stats option, lock_acquire(), lock_try_acquire()
+   and sema_down() account every acquisition to the code that
+   asked for it, identified by its return address (the "site"),
+   so that all locks taken at one place in the code are counted
+   together.  For each site we keep the number of acquisitions,
+   how many of them found the lock or semaphore unavailable, the
+   total and maximum time spent waiting, a histogram of the wait
+   times and, for locks, the total time the lock was held.  Times
+   are in timer ticks.
+
+   lock_print_stats() prints the sites sorted by total wait time.
+   A site's address can be turned into a function and line with
+   the backtrace utility. */
+
+bool lock_stats_enabled;
+
+/* Number of wait time histogram buckets.  Bucket 0 counts waits
+   of 0 ticks, bucket B counts waits of 2**(B-1) to 2**B - 1
+   ticks, and the last bucket counts all longer waits. */
+#define LOCK_HIST_BUCKETS 8
+
+/* Profile of one acquiring site. */
+struct lock_site {
+  void* pc;                             /* Return address of the acquire call. */
+  bool is_sema;                         /* True for sema_down(), false for locks. */
+  int64_t acquired;                     /* Acquisitions. */
+  int64_t contended;                    /* Acquisitions that had to wait. */
+  int64_t wait;                         /* Total ticks spent waiting. */
+  int64_t max_wait;                     /* Longest wait, in ticks. */
+  int64_t held;                         /* Total ticks held, for locks. */
+  int64_t histogram[LOCK_HIST_BUCKETS]; /* Wait times. */
+};
+
+/* Sites, hashed on their address with linear probing.  Must be
+   a power of 2. */
+#define LOCK_SITE_CNT 128
+static struct lock_site sites[LOCK_SITE_CNT];
+static unsigned site_cnt;   /* Sites in use. */
+static int64_t dropped_cnt; /* Acquisitions not recorded, table full. */
+
+static struct lock_site* site_lookup(void* pc, bool is_sema);
+static void site_record(struct lock_site*, int64_t wait, bool contended);
+
+/* Records that the current thread acquired LOCK at SITE after
+   waiting WAIT ticks.  CONTENDED is true if LOCK was not free
+   when it was first tried. */
+void lock_stats_acquired(struct lock* lock, void* site, int64_t wait, bool contended) {
+  enum intr_level old_level = intr_disable();
+  struct lock_site* s = site_lookup(site, false);
+
+  if (s != NULL) {
+    site_record(s, wait, contended);
+    lock->stats_site = s;
+    lock->acquire_tick = timer_ticks();
+  }
+  intr_set_level(old_level);
+}
+
+/* Records that LOCK is being released. */
+void lock_stats_released(struct lock* lock) {
+  enum intr_level old_level = intr_disable();
+
+  if (lock->stats_site != NULL) {
+    lock->stats_site->held += timer_elapsed(lock->acquire_tick);
+    lock->stats_site = NULL;
+  }
+  intr_set_level(old_level);
+}
+
+/* Records a sema_down() at SITE that waited WAIT ticks.
+   CONTENDED is true if the semaphore's value was 0. */
+void lock_stats_sema(void* site, int64_t wait, bool contended) {
+  enum intr_level old_level = intr_disable();
+  struct lock_site* s = site_lookup(site, true);
+
+  if (s != NULL)
+    site_record(s, wait, contended);
+  intr_set_level(old_level);
+}
+
+/* Prints the lock profile, if -lock-stats was given. */
+void lock_print_stats(void) {
+  struct lock_site* order[LOCK_SITE_CNT];
+  unsigned i, j, n = 0;
+
+  if (!lock_stats_enabled)
+    return;
+
+  /* Insertion sort by total wait, longest first. */
+  for (i = 0; i < LOCK_SITE_CNT; i++)
+    if (sites[i].pc != NULL) {
+      for (j = n++; j > 0 && order[j - 1]->wait < sites[i].wait; j--)
+        order[j] = order[j - 1];
+      order[j] = &sites[i];
+    }
+
+  printf("Lock stats: %u sites, %lld acquisitions dropped\n", site_cnt, dropped_cnt);
+  printf("%10s %4s %9s %9s %7s %5s %7s  wait histogram 0/1/2/4/8/16/32/64+\n", "site", "kind",
+         "acquired", "contended", "wait", "max", "held");
+  for (i = 0; i < n; i++) {
+    struct lock_site* s = order[i];
+    int b;
+
+    printf("%10p %4s %9lld %9lld %7lld %5lld %7lld ", s->pc, s->is_sema ? "sema" : "lock",
+           s->acquired, s->contended, s->wait, s->max_wait, s->held);
+    for (b = 0; b < LOCK_HIST_BUCKETS; b++)
+      printf("%c%lld", b == 0 ? ' ' : '/', s->histogram[b]);
+    printf("\n");
+  }
+}
+
+/* Returns the site for PC, creating it if necessary, or a null
+   pointer if the table is full.  Must be called with interrupts
+   off. */
+static struct lock_site* site_lookup(void* pc, bool is_sema) {
+  unsigned i = ((uintptr_t)pc >> 2) % LOCK_SITE_CNT;
+  unsigned probes;
+
+  ASSERT(intr_get_level() == INTR_OFF);
+
+  for (probes = 0; probes < LOCK_SITE_CNT; probes++) {
+    struct lock_site* s = &sites[i];
+    if (s->pc == pc && s->is_sema == is_sema)
+      return s;
+    if (s->pc == NULL) {
+      s->pc = pc;
+      s->is_sema = is_sema;
+      site_cnt++;
+      return s;
+    }
+    i = (i + 1) % LOCK_SITE_CNT;
+  }
+  dropped_cnt++;
+  return NULL;
+}
+
+/* Adds an acquisition that waited WAIT ticks to site S. */
+static void site_record(struct lock_site* s, int64_t wait, bool contended) {
+  int b = 0;
+
+  s->acquired++;
+  if (contended)
+    s->contended++;
+  s->wait += wait;
+  if (wait > s->max_wait)
+    s->max_wait = wait;
+
+  while (b < LOCK_HIST_BUCKETS - 1 && wait >= (1LL << b))
+    b++;
+  s->histogram[b]++;
+}
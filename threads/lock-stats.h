@@ -0,0 +1,16 @@
+#ifndef THREADS_LOCK_STATS_H
+#define THREADS_LOCK_STATS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "threads/synch.h"
+
+/* -lock-stats: Profile lock and semaphore contention? */
+extern bool lock_stats_enabled;
+
+void lock_stats_acquired(struct lock*, void* site, int64_t wait, bool contended);
+void lock_stats_released(struct lock*);
+void lock_stats_sema(void* site, int64_t wait, bool contended);
+void lock_print_stats(void);
+
+#endif /* threads/lock-stats.h */
@@ -5,15 +5,19 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
+#include "threads/cpu.h"
+#include "threads/interrupt.h"
 #include "threads/palloc.h"
 #include "threads/synch.h"
 #include "threads/vaddr.h"
 
 /* A simple implementation of malloc().
 
-   The size of each request, in bytes, is rounded up to a power
-   of 2 and assigned to the "descriptor" that manages blocks of
-   that size.  The descriptor keeps a list of free blocks.  If
+   The size of each request, in bytes, is rounded up to the next
+   size class and assigned to the "descriptor" that manages
+   blocks of that size.  Size classes are multiples of 8 bytes
+   that grow by about 1.25 times from one to the next, so that
+   rounding wastes at most about a fifth of a block.  The descriptor keeps a list of free blocks.  If
    the free list is nonempty, one of its blocks is used to
    satisfy the request.
 
@@ -28,18 +32,50 @@
    blocks, we remove all of the arena's blocks from the free list
    and give the arena back to the page allocator.
 
-   We can't handle blocks bigger than 2 kB using this scheme,
-   because they're too big to fit in a single page with a
-   descriptor.  We handle those by allocating contiguous pages
-   with the page allocator and sticking the allocation size at
-   the beginning of the allocated block's arena header. */
+   We don't handle blocks bigger than MAX_BLOCK_SIZE using this
+   scheme, because fewer than two would fit in a page with the
+   arena header.  We handle those "big blocks" by allocating just
+   enough contiguous pages with the page allocator and recording
+   the page count in a hash table of struct big_block.  A big
+   block is page-aligned, which no block in an arena is, so
+   free() can tell the two apart.
+
+   In front of each descriptor's free list sits a "magazine" per
+   CPU, a small stack of free blocks.  malloc() and free() use
+   the running CPU's magazine with interrupts briefly off, and
+   only take the descriptor's lock when the magazine is empty or
+   full, to move MAG_BATCH blocks between it and the free list at
+   once.  Blocks in a magazine count as in use in their arena, so
+   an arena is not given back while a magazine holds any of its
+   blocks.
+
+   malloc_print_stats() reports, besides totals since boot, the
+   bytes each size class and the big blocks hold right now and
+   the peak of their sum.  With -malloc-trace, every block also
+   gets a record of its size and the address malloc() was called
+   from, so that blocks still live at shutdown can be listed by
+   caller.  The records come from a fixed table; blocks allocated
+   while it is full are counted but not listed. */
+
+/* Blocks per magazine, and blocks moved between a magazine and
+   the free list at once. */
+#define MAG_SIZE 16
+#define MAG_BATCH (MAG_SIZE / 2)
+
+/* A per-CPU stack of free blocks. */
+struct magazine {
+  size_t cnt;                     /* Number of blocks. */
+  struct block* blocks[MAG_SIZE]; /* Blocks, top of stack last. */
+};
 
 /* Descriptor. */
 struct desc {
-  size_t block_size;       /* Size of each element in bytes. */
-  size_t blocks_per_arena; /* Number of blocks in an arena. */
-  struct list free_list;   /* List of free blocks. */
-  struct lock lock;        /* Lock. */
+  size_t block_size;             /* Size of each element in bytes. */
+  size_t blocks_per_arena;       /* Number of blocks in an arena. */
+  struct list free_list;         /* List of free blocks. */
+  struct lock lock;              /* Lock. */
+  struct magazine mags[CPU_MAX]; /* Per-CPU magazines. */
+  size_t live_cnt;               /* Blocks handed out and not freed. */
 };
 
 /* Magic number for detecting arena corruption. */
@@ -48,8 +84,8 @@ struct desc {
 /* Arena. */
 struct arena {
   unsigned magic;    /* Always set to ARENA_MAGIC. */
-  struct desc* desc; /* Owning descriptor, null for big block. */
-  size_t free_cnt;   /* Free blocks; pages in big block. */
+  struct desc* desc; /* Owning descriptor. */
+  size_t free_cnt;   /* Free blocks. */
 };
 
 /* Free block. */
@@ -57,87 +93,153 @@ struct block {
   struct list_elem free_elem; /* Free list element. */
 };
 
+/* Largest block size handled by a descriptor: two blocks per
+   arena. */
+#define MAX_BLOCK_SIZE ROUND_DOWN((PGSIZE - sizeof(struct arena)) / 2, 8)
+
 /* Our set of descriptors. */
-static struct desc descs[10]; /* Descriptors. */
+static struct desc descs[24]; /* Descriptors. */
 static size_t desc_cnt;       /* Number of descriptors. */
 
+/* Maps a request of SIZE bytes, up to MAX_BLOCK_SIZE, to the
+   smallest descriptor that satisfies it, which is entry
+   DIV_ROUND_UP(SIZE, 8). */
+static uint8_t size_to_desc[MAX_BLOCK_SIZE / 8 + 1];
+
+/* A block too big for any descriptor. */
+struct big_block {
+  struct list_elem elem; /* Element in a big_blocks bucket. */
+  void* pages;           /* First page. */
+  size_t page_cnt;       /* Number of pages. */
+};
+
+/* Big blocks, hashed on their page number. */
+#define BIG_BUCKET_CNT 32
+static struct list big_blocks[BIG_BUCKET_CNT];
+static struct lock big_lock;
+
+/* Statistics, for malloc_print_stats().  Protected by turning
+   interrupts off. */
+static long long requested_bytes; /* Sum of all request sizes. */
+static long long reserved_bytes;  /* Sum of the block sizes returned. */
+static size_t live_bytes;         /* Bytes in blocks not yet freed. */
+static size_t peak_bytes;         /* Maximum of live_bytes. */
+static size_t big_live_bytes;     /* Part of live_bytes in big blocks. */
+
+/* -malloc-trace: Record the caller of every malloc()? */
+bool malloc_trace;
+
+/* Allocation record kept with -malloc-trace. */
+struct trace_rec {
+  void* block;            /* Block returned by malloc(). */
+  void* caller;           /* Return address of the malloc() call. */
+  size_t size;            /* Requested size. */
+  struct trace_rec* next; /* Next in bucket or free list. */
+};
+
+/* Allocation records, hashed on the block address.  Protected
+   by turning interrupts off. */
+#define TRACE_MAX 2048
+#define TRACE_BUCKET_CNT 256
+static struct trace_rec trace_recs[TRACE_MAX];
+static struct trace_rec* trace_buckets[TRACE_BUCKET_CNT];
+static struct trace_rec* trace_free;
+static size_t trace_dropped; /* Allocations made with no record to spare. */
+
 static struct arena* block_to_arena(struct block*);
 static struct block* arena_to_block(struct arena*, size_t idx);
+static struct block* desc_refill(struct desc*);
+static void desc_drain(struct desc*, struct block*);
+static struct block* desc_get_block(struct desc*);
+static void desc_put_block(struct desc*, struct block*);
+static void* big_alloc(size_t size);
+static struct big_block* big_find(void* pages);
+static void* malloc_at(size_t size, void* caller);
+static void account(size_t requested, size_t reserved);
+static void account_free(size_t reserved);
+static void trace_add(void* block, size_t size, void* caller);
+static void trace_remove(void* block);
+static void trace_print_leaks(void);
 
 /* Initializes the malloc() descriptors. */
 void malloc_init(void) {
-  size_t block_size;
+  size_t block_size, i;
 
-  for (block_size = 16; block_size < PGSIZE / 2; block_size *= 2) {
+  for (block_size = 16; block_size <= MAX_BLOCK_SIZE;) {
     struct desc* d = &descs[desc_cnt++];
     ASSERT(desc_cnt <= sizeof descs / sizeof *descs);
     d->block_size = block_size;
     d->blocks_per_arena = (PGSIZE - sizeof(struct arena)) / block_size;
     list_init(&d->free_list);
     lock_init(&d->lock);
+    memset(d->mags, 0, sizeof d->mags);
+
+    if (block_size == MAX_BLOCK_SIZE)
+      break;
+    block_size = ROUND_UP(block_size * 5 / 4, 8);
+    if (block_size > MAX_BLOCK_SIZE)
+      block_size = MAX_BLOCK_SIZE;
+  }
+
+  for (i = 0; i < sizeof size_to_desc; i++) {
+    size_t d = 0;
+    while (descs[d].block_size < i * 8)
+      d++;
+    size_to_desc[i] = d;
+  }
+
+  for (i = 0; i < BIG_BUCKET_CNT; i++)
+    list_init(&big_blocks[i]);
+  lock_init(&big_lock);
+
+  for (i = 0; i < TRACE_MAX; i++) {
+    trace_recs[i].next = trace_free;
+    trace_free = &trace_recs[i];
   }
 }
 
 /* Obtains and returns a new block of at least SIZE bytes.
    Returns a null pointer if memory is not available. */
-void* malloc(size_t size) {
+void* malloc(size_t size) { return malloc_at(size, __builtin_return_address(0)); }
+
+/* Does the work of malloc() for a call from CALLER, which is
+   recorded with -malloc-trace unless it is a null pointer. */
+static void* malloc_at(size_t size, void* caller) {
   struct desc* d;
   struct block* b;
-  struct arena* a;
+  struct magazine* m;
+  enum intr_level old_level;
 
   /* A null pointer satisfies a request for 0 bytes. */
   if (size == 0)
     return NULL;
 
-  /* Find the smallest descriptor that satisfies a SIZE-byte
-     request. */
-  for (d = descs; d < descs + desc_cnt; d++)
-    if (d->block_size >= size)
-      break;
-  if (d == descs + desc_cnt) {
-    /* SIZE is too big for any descriptor.
-         Allocate enough pages to hold SIZE plus an arena. */
-    size_t page_cnt = DIV_ROUND_UP(size + sizeof *a, PGSIZE);
-    a = palloc_get_multiple(0, page_cnt);
-    if (a == NULL)
-      return NULL;
-
-    /* Initialize the arena to indicate a big block of PAGE_CNT
-         pages, and return it. */
-    a->magic = ARENA_MAGIC;
-    a->desc = NULL;
-    a->free_cnt = page_cnt;
-    return a + 1;
+  /* SIZE is too big for any descriptor. */
+  if (size > MAX_BLOCK_SIZE) {
+    b = big_alloc(size);
+    if (b != NULL && malloc_trace && caller != NULL)
+      trace_add(b, size, caller);
+    return b;
   }
 
-  lock_acquire(&d->lock);
-
-  /* If the free list is empty, create a new arena. */
-  if (list_empty(&d->free_list)) {
-    size_t i;
-
-    /* Allocate a page. */
-    a = palloc_get_page(0);
-    if (a == NULL) {
-      lock_release(&d->lock);
+  /* Take the top block of this CPU's magazine, if any. */
+  d = &descs[size_to_desc[DIV_ROUND_UP(size, 8)]];
+  old_level = intr_disable();
+  m = &d->mags[cpu_current()->id];
+  if (m->cnt > 0)
+    b = m->blocks[--m->cnt];
+  else {
+    intr_set_level(old_level);
+    b = desc_refill(d);
+    if (b == NULL)
       return NULL;
-    }
-
-    /* Initialize arena and add its blocks to the free list. */
-    a->magic = ARENA_MAGIC;
-    a->desc = d;
-    a->free_cnt = d->blocks_per_arena;
-    for (i = 0; i < d->blocks_per_arena; i++) {
-      struct block* b = arena_to_block(a, i);
-      list_push_back(&d->free_list, &b->free_elem);
-    }
+    intr_disable();
   }
-
-  /* Get a block from free list and return it. */
-  b = list_entry(list_pop_front(&d->free_list), struct block, free_elem);
-  a = block_to_arena(b);
-  a->free_cnt--;
-  lock_release(&d->lock);
+  d->live_cnt++;
+  account(size, d->block_size);
+  if (malloc_trace && caller != NULL)
+    trace_add(b, size, caller);
+  intr_set_level(old_level);
   return b;
 }
 
@@ -153,7 +255,7 @@ void* calloc(size_t a, size_t b) {
     return NULL;
 
   /* Allocate and zero memory. */
-  p = malloc(size);
+  p = malloc_at(size, __builtin_return_address(0));
   if (p != NULL)
     memset(p, 0, size);
 
@@ -162,11 +264,17 @@ void* calloc(size_t a, size_t b) {
 
 /* Returns the number of bytes allocated for BLOCK. */
 static size_t block_size(void* block) {
-  struct block* b = block;
-  struct arena* a = block_to_arena(b);
-  struct desc* d = a->desc;
-
-  return d != NULL ? d->block_size : PGSIZE * a->free_cnt - pg_ofs(block);
+  if (pg_ofs(block) == 0) {
+    struct big_block* bb;
+    size_t page_cnt;
+
+    lock_acquire(&big_lock);
+    bb = big_find(block);
+    page_cnt = bb->page_cnt;
+    lock_release(&big_lock);
+    return page_cnt * PGSIZE;
+  }
+  return block_to_arena(block)->desc->block_size;
 }
 
 /* Attempts to resize OLD_BLOCK to NEW_SIZE bytes, possibly
@@ -180,7 +288,7 @@ void* realloc(void* old_block, size_t new_size) {
     free(old_block);
     return NULL;
   } else {
-    void* new_block = malloc(new_size);
+    void* new_block = malloc_at(new_size, __builtin_return_address(0));
     if (old_block != NULL && new_block != NULL) {
       size_t old_size = block_size(old_block);
       size_t min_size = new_size < old_size ? new_size : old_size;
@@ -194,45 +302,78 @@ void* realloc(void* old_block, size_t new_size) {
 /* Frees block P, which must have been previously allocated with
    malloc(), calloc(), or realloc(). */
 void free(void* p) {
-  if (p != NULL) {
+  enum intr_level old_level;
+
+  if (p != NULL && pg_ofs(p) == 0) {
+    /* It's a big block.  Free its pages. */
+    struct big_block* bb;
+
+    lock_acquire(&big_lock);
+    bb = big_find(p);
+    list_remove(&bb->elem);
+    lock_release(&big_lock);
+
+    old_level = intr_disable();
+    account_free(bb->page_cnt * PGSIZE);
+    big_live_bytes -= bb->page_cnt * PGSIZE;
+    if (malloc_trace)
+      trace_remove(p);
+    intr_set_level(old_level);
+
+    palloc_free_multiple(bb->pages, bb->page_cnt);
+    free(bb);
+  } else if (p != NULL) {
+    /* It's a normal block.  We handle it here. */
     struct block* b = p;
     struct arena* a = block_to_arena(b);
     struct desc* d = a->desc;
-
-    if (d != NULL) {
-/* It's a normal block.  We handle it here. */
+    struct magazine* m;
 
 #ifndef NDEBUG
-      /* Clear the block to help detect use-after-free bugs. */
-      memset(b, 0xcc, d->block_size);
+    /* Clear the block to help detect use-after-free bugs. */
+    memset(b, 0xcc, d->block_size);
 #endif
 
-      lock_acquire(&d->lock);
-
-      /* Add block to free list. */
-      list_push_front(&d->free_list, &b->free_elem);
-
-      /* If the arena is now entirely unused, free it. */
-      if (++a->free_cnt >= d->blocks_per_arena) {
-        size_t i;
-
-        ASSERT(a->free_cnt == d->blocks_per_arena);
-        for (i = 0; i < d->blocks_per_arena; i++) {
-          struct block* b = arena_to_block(a, i);
-          list_remove(&b->free_elem);
-        }
-        palloc_free_page(a);
-      }
-
-      lock_release(&d->lock);
-    } else {
-      /* It's a big block.  Free its pages. */
-      palloc_free_multiple(a, a->free_cnt);
+    /* Push the block on this CPU's magazine, if it has room. */
+    old_level = intr_disable();
+    d->live_cnt--;
+    account_free(d->block_size);
+    if (malloc_trace)
+      trace_remove(p);
+    m = &d->mags[cpu_current()->id];
+    if (m->cnt < MAG_SIZE) {
+      m->blocks[m->cnt++] = b;
+      intr_set_level(old_level);
       return;
     }
+    intr_set_level(old_level);
+
+    desc_drain(d, b);
   }
 }
 
+/* Prints how much memory malloc() reserved to satisfy the
+   requests it got, counting every request since boot, and how
+   much is in use now.  With -malloc-trace, also lists the
+   blocks that are still allocated. */
+void malloc_print_stats(void) {
+  long long ratio = reserved_bytes > 0 ? requested_bytes * 100 / reserved_bytes : 100;
+  size_t i;
+
+  printf("Malloc: %lld bytes requested, %lld bytes reserved, %lld%% used\n", requested_bytes,
+         reserved_bytes, ratio);
+  printf("Malloc: %zu bytes live, %zu bytes peak\n", live_bytes, peak_bytes);
+  for (i = 0; i < desc_cnt; i++)
+    if (descs[i].live_cnt > 0)
+      printf("Malloc:   %4zu-byte blocks: %zu live, %zu bytes\n", descs[i].block_size,
+             descs[i].live_cnt, descs[i].live_cnt * descs[i].block_size);
+  if (big_live_bytes > 0)
+    printf("Malloc:   big blocks: %zu bytes\n", big_live_bytes);
+
+  if (malloc_trace)
+    trace_print_leaks();
+}
+
 /* Returns the arena that block B is inside. */
 static struct arena* block_to_arena(struct block* b) {
   struct arena* a = pg_round_down(b);
@@ -242,8 +383,8 @@ static struct arena* block_to_arena(struct block* b) {
   ASSERT(a->magic == ARENA_MAGIC);
 
   /* Check that the block is properly aligned for the arena. */
-  ASSERT(a->desc == NULL || (pg_ofs(b) - sizeof *a) % a->desc->block_size == 0);
-  ASSERT(a->desc != NULL || pg_ofs(b) == sizeof *a);
+  ASSERT(a->desc != NULL);
+  ASSERT((pg_ofs(b) - sizeof *a) % a->desc->block_size == 0);
 
   return a;
 }
@@ -255,3 +396,256 @@ static struct block* arena_to_block(struct arena* a, size_t idx) {
   ASSERT(idx < a->desc->blocks_per_arena);
   return (struct block*)((uint8_t*)a + sizeof *a + idx * a->desc->block_size);
 }
+
+/* Called by malloc() when the running CPU's magazine for D is
+   empty.  Moves up to MAG_BATCH blocks from D's free list into
+   the magazine, creating an arena if the free list is empty, and
+   returns one more block for the caller.  Returns a null pointer
+   if memory is not available. */
+static struct block* desc_refill(struct desc* d) {
+  struct block* batch[MAG_BATCH];
+  struct block* b;
+  enum intr_level old_level;
+  struct magazine* m;
+  size_t cnt = 0;
+
+  lock_acquire(&d->lock);
+  b = desc_get_block(d);
+  while (b != NULL && cnt < MAG_BATCH && !list_empty(&d->free_list))
+    batch[cnt++] = desc_get_block(d);
+
+  /* We may have moved to another CPU while waiting for the
+     lock, and its magazine may have filled up meanwhile. */
+  old_level = intr_disable();
+  m = &d->mags[cpu_current()->id];
+  while (cnt > 0 && m->cnt < MAG_SIZE)
+    m->blocks[m->cnt++] = batch[--cnt];
+  intr_set_level(old_level);
+
+  while (cnt > 0)
+    desc_put_block(d, batch[--cnt]);
+  lock_release(&d->lock);
+
+  return b;
+}
+
+/* Called by free() when the running CPU's magazine for D is
+   full.  Returns block B and MAG_BATCH blocks of the magazine to
+   D's free list. */
+static void desc_drain(struct desc* d, struct block* b) {
+  struct block* batch[MAG_BATCH];
+  enum intr_level old_level;
+  struct magazine* m;
+  size_t cnt = 0;
+
+  old_level = intr_disable();
+  m = &d->mags[cpu_current()->id];
+  while (cnt < MAG_BATCH && m->cnt > 0)
+    batch[cnt++] = m->blocks[--m->cnt];
+  intr_set_level(old_level);
+
+  lock_acquire(&d->lock);
+  desc_put_block(d, b);
+  while (cnt > 0)
+    desc_put_block(d, batch[--cnt]);
+  lock_release(&d->lock);
+}
+
+/* Removes a block from D's free list, creating a new arena if
+   the list is empty, and returns it.  Returns a null pointer if
+   memory is not available.  D's lock must be held. */
+static struct block* desc_get_block(struct desc* d) {
+  struct block* b;
+  struct arena* a;
+
+  ASSERT(lock_held_by_current_thread(&d->lock));
+
+  /* If the free list is empty, create a new arena. */
+  if (list_empty(&d->free_list)) {
+    size_t i;
+
+    /* Allocate a page. */
+    a = palloc_get_page(0);
+    if (a == NULL)
+      return NULL;
+
+    /* Initialize arena and add its blocks to the free list. */
+    a->magic = ARENA_MAGIC;
+    a->desc = d;
+    a->free_cnt = d->blocks_per_arena;
+    for (i = 0; i < d->blocks_per_arena; i++) {
+      struct block* b = arena_to_block(a, i);
+      list_push_back(&d->free_list, &b->free_elem);
+    }
+  }
+
+  /* Get a block from free list. */
+  b = list_entry(list_pop_front(&d->free_list), struct block, free_elem);
+  a = block_to_arena(b);
+  a->free_cnt--;
+  return b;
+}
+
+/* Adds block B to D's free list, giving its arena back to the
+   page allocator if that leaves the arena entirely unused.  D's
+   lock must be held. */
+static void desc_put_block(struct desc* d, struct block* b) {
+  struct arena* a = block_to_arena(b);
+
+  ASSERT(lock_held_by_current_thread(&d->lock));
+
+  /* Add block to free list. */
+  list_push_front(&d->free_list, &b->free_elem);
+
+  /* If the arena is now entirely unused, free it. */
+  if (++a->free_cnt >= d->blocks_per_arena) {
+    size_t i;
+
+    ASSERT(a->free_cnt == d->blocks_per_arena);
+    for (i = 0; i < d->blocks_per_arena; i++) {
+      struct block* b = arena_to_block(a, i);
+      list_remove(&b->free_elem);
+    }
+    palloc_free_page(a);
+  }
+}
+
+/* Allocates a big block of SIZE bytes, which takes just enough
+   whole pages.  Returns a null pointer if memory is not
+   available. */
+static void* big_alloc(size_t size) {
+  size_t page_cnt = DIV_ROUND_UP(size, PGSIZE);
+  struct big_block* bb = malloc_at(sizeof *bb, NULL);
+  enum intr_level old_level;
+
+  if (bb == NULL)
+    return NULL;
+  bb->pages = palloc_get_multiple(0, page_cnt);
+  if (bb->pages == NULL) {
+    free(bb);
+    return NULL;
+  }
+  bb->page_cnt = page_cnt;
+
+  lock_acquire(&big_lock);
+  list_push_front(&big_blocks[pg_no(bb->pages) % BIG_BUCKET_CNT], &bb->elem);
+  lock_release(&big_lock);
+
+  old_level = intr_disable();
+  account(size, page_cnt * PGSIZE);
+  big_live_bytes += page_cnt * PGSIZE;
+  intr_set_level(old_level);
+  return bb->pages;
+}
+
+/* Returns the big block that starts at PAGES.  big_lock must be
+   held. */
+static struct big_block* big_find(void* pages) {
+  struct list* bucket = &big_blocks[pg_no(pages) % BIG_BUCKET_CNT];
+  struct list_elem* e;
+
+  ASSERT(lock_held_by_current_thread(&big_lock));
+
+  for (e = list_begin(bucket); e != list_end(bucket); e = list_next(e)) {
+    struct big_block* bb = list_entry(e, struct big_block, elem);
+    if (bb->pages == pages)
+      return bb;
+  }
+  PANIC("free() or realloc() of %p, which malloc() did not return", pages);
+}
+
+/* Adds an allocation of RESERVED bytes for a request of
+   REQUESTED bytes to the statistics.  Interrupts must be off. */
+static void account(size_t requested, size_t reserved) {
+  ASSERT(intr_get_level() == INTR_OFF);
+
+  requested_bytes += requested;
+  reserved_bytes += reserved;
+  live_bytes += reserved;
+  if (live_bytes > peak_bytes)
+    peak_bytes = live_bytes;
+}
+
+/* Removes a freed block of RESERVED bytes from the statistics.
+   Interrupts must be off. */
+static void account_free(size_t reserved) {
+  ASSERT(intr_get_level() == INTR_OFF);
+
+  live_bytes -= reserved;
+}
+
+/* Returns the bucket in trace_buckets for BLOCK. */
+static struct trace_rec** trace_bucket(void* block) {
+  return &trace_buckets[((uintptr_t)block >> 3) % TRACE_BUCKET_CNT];
+}
+
+/* Records that CALLER allocated BLOCK of SIZE bytes.  Interrupts
+   must be off. */
+static void trace_add(void* block, size_t size, void* caller) {
+  struct trace_rec** bucket = trace_bucket(block);
+  struct trace_rec* r = trace_free;
+
+  ASSERT(intr_get_level() == INTR_OFF);
+
+  if (r == NULL) {
+    trace_dropped++;
+    return;
+  }
+  trace_free = r->next;
+  r->block = block;
+  r->caller = caller;
+  r->size = size;
+  r->next = *bucket;
+  *bucket = r;
+}
+
+/* Drops the record of BLOCK, if there is one.  Interrupts must be
+   off. */
+static void trace_remove(void* block) {
+  struct trace_rec** rp;
+
+  ASSERT(intr_get_level() == INTR_OFF);
+
+  for (rp = trace_bucket(block); *rp != NULL; rp = &(*rp)->next)
+    if ((*rp)->block == block) {
+      struct trace_rec* r = *rp;
+      *rp = r->next;
+      r->next = trace_free;
+      trace_free = r;
+      return;
+    }
+}
+
+/* Prints the recorded blocks that are still allocated, summed
+   up by caller. */
+static void trace_print_leaks(void) {
+  enum intr_level old_level = intr_disable();
+  size_t i;
+
+  /* Each pass prints the first caller not printed yet, marking
+     its records by clearing their caller. */
+  for (i = 0; i < TRACE_BUCKET_CNT; i++) {
+    struct trace_rec* r;
+
+    for (r = trace_buckets[i]; r != NULL; r = r->next)
+      if (r->caller != NULL) {
+        void* caller = r->caller;
+        size_t cnt = 0, bytes = 0, j;
+
+        for (j = i; j < TRACE_BUCKET_CNT; j++) {
+          struct trace_rec* q;
+
+          for (q = trace_buckets[j]; q != NULL; q = q->next)
+            if (q->caller == caller) {
+              cnt++;
+              bytes += q->size;
+              q->caller = NULL;
+            }
+        }
+        printf("Malloc leak: %zu blocks, %zu bytes, allocated from %p\n", cnt, bytes, caller);
+      }
+  }
+  if (trace_dropped > 0)
+    printf("Malloc leak: %zu allocations were not traced\n", trace_dropped);
+  intr_set_level(old_level);
+}
@@ -2,12 +2,17 @@
 #define THREADS_MALLOC_H
 
 #include <debug.h>
+#include <stdbool.h>
 #include <stddef.h>
 
+/* -malloc-trace: Record the caller of every malloc()? */
+extern bool malloc_trace;
+
 void malloc_init(void);
 void* malloc(size_t) __attribute__((malloc));
 void* calloc(size_t, size_t) __attribute__((malloc));
 void* realloc(void*, size_t);
 void free(void*);
+void malloc_print_stats(void);
 
 #endif /* threads/malloc.h */
@@ -2,13 +2,19 @@
 #include <bitmap.h>
 #include <debug.h>
 #include <inttypes.h>
+#include <list.h>
 #include <round.h>
 #include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
+#include "threads/highmem.h"
+#include "threads/init.h"
+#include "threads/interrupt.h"
+#include "threads/kstat.h"
 #include "threads/loader.h"
 #include "threads/synch.h"
+#include "threads/tracepoint.h"
 #include "threads/vaddr.h"
 
 /* Page allocator.  Hands out memory in page-size (or
@@ -23,30 +29,152 @@
 
    By default, half of system RAM is given to the kernel pool and
    half to the user pool.  That should be huge overkill for the
-   kernel pool, but that's just fine for demonstration purposes. */
+   kernel pool, but that's just fine for demonstration purposes.
+
+   That is, half of the RAM that the kernel maps at PHYS_BASE.
+   RAM beyond it, high memory, goes to a third pool, the high
+   pool, which holds user pages only.  Its pages have no kernel
+   virtual address, so it hands out physical addresses through
+   palloc_get_frame(), which takes from the high pool first and
+   then from the user pool, and the caller maps a page with
+   kmap() to touch it (see threads/highmem.c).
+
+   Each pool tracks its pages with one of two backends, chosen at
+   boot with -palloc.  The default keeps a bitmap of used pages
+   and scans it for a long enough run of free pages.  The buddy
+   backend keeps lists of free blocks of 2**ORDER pages, each
+   aligned to its size within the pool, for each ORDER up to
+   BUDDY_MAX_ORDER.  Allocation splits the smallest large enough
+   block and freeing merges a block with its "buddy", the other
+   half of the block of the next order, whenever that is free
+   too, so both take O(log n) time.  A request for a number of
+   pages that is not a power of 2 gets the pages it asked for,
+   and the rest of the block is freed again right away.
+
+   With either backend, each pool counts its free pages, so a
+   request that cannot fit fails without looking at the pool.
+   The bitmap backend also remembers where its last allocation
+   ended and starts the next search there ("next fit"), falling
+   back to a search from the start of the pool, so it does not
+   walk past the same used pages every time.
+
+   Each pool also keeps a short list of pages that the idle
+   thread took from it and zeroed ahead of time, through
+   palloc_zero_idle().  A request for one page with PAL_ZERO is
+   served from that list when it is non-empty, so no memset()
+   happens in the caller's path.  The list is protected by
+   turning interrupts off, because the idle thread must never
+   wait for the pool's lock.  Pages on the list count as
+   allocated, so when a pool runs out, its list is given back to
+   it before the request fails.  After that, the function set with
+   palloc_set_reclaim(), if any, may give back pages that another
+   module holds on to only to free them later.
+
+   With -colors=N, palloc_get_colored() gives out pages by
+   "color", the page's physical page number modulo N, so that a
+   caller can match a user page's physical color to its virtual
+   one.  Pages of different colors map to different sets of a
+   physically indexed cache, so a buffer that is contiguous in
+   virtual memory then spreads evenly over the cache's sets
+   instead of wherever the free pages happened to fall.  N should
+   be the cache size divided by its associativity and by PGSIZE.
+   Only the bitmap backend colors pages: it scans for a free page
+   of the right color from its next-fit position, stepping by N,
+   and falls back to any free page if there is none.
+
+   The high pool always uses the bitmap backend, with its bitmap
+   in the kernel pool, since the buddy backend keeps its free
+   lists in the free pages themselves.  Nor does it keep
+   pre-zeroed pages. */
+
+/* Number of pre-zeroed pages the idle thread keeps in each
+   pool. */
+#define ZEROED_TARGET 32
+
+/* Largest block order the buddy backend keeps. */
+#define BUDDY_MAX_ORDER 14
 
 /* A memory pool. */
 struct pool {
-  struct lock lock;        /* Mutual exclusion. */
+  struct lock lock; /* Mutual exclusion. */
+  uint8_t* base;    /* Base of pool, or a null pointer for the high pool. */
+  uintptr_t phys;   /* Physical address of base. */
+  bool buddy;       /* Use the buddy backend? */
+  size_t page_cnt;  /* Number of pages in pool. */
+  size_t free_cnt;  /* Number of free pages. */
+  size_t peak_used; /* Most pages ever in use at once. */
+
+  /* Bitmap backend. */
   struct bitmap* used_map; /* Bitmap of free pages. */
-  uint8_t* base;           /* Base of pool. */
+  size_t next_fit;         /* Where to start the next search. */
+
+  /* Buddy backend. */
+  uint8_t* free_order;                         /* Per page: 1 + order if it starts a free block. */
+  struct list free_lists[BUDDY_MAX_ORDER + 1]; /* Free blocks of each order. */
+
+  /* Pre-zeroed pages. */
+  struct list zeroed; /* Zeroed pages, as struct zeroed_page. */
+  size_t zeroed_cnt;  /* Number of pages in zeroed. */
+};
+
+/* A free block in the buddy backend, stored in its first page. */
+struct buddy_block {
+  struct list_elem elem; /* Element in a free_lists list. */
 };
 
+/* A pre-zeroed page, except for the list element at its start. */
+struct zeroed_page {
+  struct list_elem elem; /* Element in a zeroed list. */
+};
+
+/* Statistics, for palloc_print_stats(). */
+static long long zeroed_hits;   /* PAL_ZERO pages served pre-zeroed. */
+static long long zeroed_misses; /* PAL_ZERO pages zeroed by the caller. */
+static long long color_hits;    /* Colored requests served in their color. */
+static long long color_misses;  /* Colored requests served in another color. */
+
+/* -palloc=buddy: Use the buddy backend? */
+bool palloc_buddy;
+
+/* -colors: Number of page colors, or 0 not to color pages. */
+unsigned palloc_colors;
+
 /* Two pools: one for kernel data, one for user pages. */
 static struct pool kernel_pool, user_pool;
 
+/* User pages in high memory. */
+static struct pool high_pool;
+
+/* Called when a pool runs out.  See palloc_set_reclaim(). */
+static palloc_reclaim_func* reclaim;
+
 static void init_pool(struct pool*, void* base, size_t page_cnt, const char* name);
+static void init_high_pool(struct pool*, size_t page_cnt);
 static bool page_from_pool(const struct pool*, void* page);
+static size_t pool_alloc(struct pool*, size_t page_cnt);
+static kstat_func read_free_cnt;
+static size_t pool_alloc_colored(struct pool*, unsigned color);
+static size_t color_scan(struct pool*, size_t start, size_t end, unsigned color);
+static void pool_free(struct pool*, size_t page_idx, size_t page_cnt);
+static void* zeroed_pop(struct pool*);
+static void zeroed_release(struct pool*);
+static void print_pool_stats(const struct pool*, const char* name);
+static size_t buddy_alloc(struct pool*, size_t page_cnt);
+static void buddy_free(struct pool*, size_t page_idx, size_t page_cnt);
+static void buddy_free_block(struct pool*, size_t page_idx, int order);
 
-/* Initializes the page allocator.  At most USER_PAGE_LIMIT
-   pages are put into the user pool. */
-void palloc_init(size_t user_page_limit) {
-  /* Free memory starts at 1 MB and runs to the end of RAM. */
-  uint8_t* free_start = ptov(1024 * 1024);
-  uint8_t* free_end = ptov(init_ram_pages * PGSIZE);
+/* Initializes the page allocator, with the memory from
+   FREE_START to the end of the kernel's direct mapping and with
+   high memory.  At most USER_PAGE_LIMIT pages are put into the
+   user and high pools together. */
+void palloc_init(void* free_start_, size_t user_page_limit) {
+  /* Free memory starts at FREE_START and runs to the end of the
+     direct mapping. */
+  uint8_t* free_start = free_start_;
+  uint8_t* free_end = ptov(init_lowmem_pages * PGSIZE);
   size_t free_pages = (free_end - free_start) / PGSIZE;
   size_t user_pages = free_pages / 2;
-  size_t kernel_pages;
+  size_t kernel_pages, high_pages;
   if (user_pages > user_page_limit)
     user_pages = user_page_limit;
   kernel_pages = free_pages - user_pages;
@@ -54,6 +182,20 @@ void palloc_init(size_t user_page_limit) {
   /* Give half of memory to kernel, half to user. */
   init_pool(&kernel_pool, free_start, kernel_pages, "kernel pool");
   init_pool(&user_pool, free_start + kernel_pages * PGSIZE, user_pages, "user pool");
+
+  /* Give high memory to user pages too. */
+  high_pages = init_ram_pages - init_lowmem_pages;
+  if (high_pages > user_page_limit - user_pages)
+    high_pages = user_page_limit - user_pages;
+  if (high_pages > 0)
+    init_high_pool(&high_pool, high_pages);
+
+  kstat_gauge("palloc.kernel_free", read_free_cnt, (void*)0);
+  kstat_gauge("palloc.user_free", read_free_cnt, (void*)PAL_USER);
+  kstat_counter("palloc.zeroed_hits", &zeroed_hits);
+  kstat_counter("palloc.zeroed_misses", &zeroed_misses);
+  kstat_counter("palloc.color_hits", &color_hits);
+  kstat_counter("palloc.color_misses", &color_misses);
 }
 
 /* Obtains and returns a group of PAGE_CNT contiguous free pages.
@@ -70,10 +212,36 @@ void* palloc_get_multiple(enum palloc_flags flags, size_t page_cnt) {
   if (page_cnt == 0)
     return NULL;
 
+  TRACEPOINT(TP_PALLOC, TP_BEGIN, flags, page_cnt);
+  if ((flags & PAL_ZERO) && page_cnt == 1) {
+    pages = zeroed_pop(pool);
+    if (pages != NULL) {
+      zeroed_hits++;
+      TRACEPOINT(TP_PALLOC, TP_END, flags, pages);
+      return pages;
+    }
+    zeroed_misses++;
+  }
+
   lock_acquire(&pool->lock);
-  page_idx = bitmap_scan_and_flip(pool->used_map, 0, page_cnt, false);
+  page_idx = pool_alloc(pool, page_cnt);
   lock_release(&pool->lock);
 
+  /* Out of pages: take back the pre-zeroed ones and retry. */
+  if (page_idx == BITMAP_ERROR && pool->zeroed_cnt > 0) {
+    zeroed_release(pool);
+    lock_acquire(&pool->lock);
+    page_idx = pool_alloc(pool, page_cnt);
+    lock_release(&pool->lock);
+  }
+
+  /* Still out: have pages freed that are only waiting to be. */
+  if (page_idx == BITMAP_ERROR && reclaim != NULL && !intr_context() && reclaim()) {
+    lock_acquire(&pool->lock);
+    page_idx = pool_alloc(pool, page_cnt);
+    lock_release(&pool->lock);
+  }
+
   if (page_idx != BITMAP_ERROR)
     pages = pool->base + PGSIZE * page_idx;
   else
@@ -87,6 +255,7 @@ void* palloc_get_multiple(enum palloc_flags flags, size_t page_cnt) {
       PANIC("palloc_get: out of pages");
   }
 
+  TRACEPOINT(TP_PALLOC, TP_END, flags, pages);
   return pages;
 }
 
@@ -99,6 +268,91 @@ void* palloc_get_multiple(enum palloc_flags flags, size_t page_cnt) {
    FLAGS, in which case the kernel panics. */
 void* palloc_get_page(enum palloc_flags flags) { return palloc_get_multiple(flags, 1); }
 
+/* Obtains a single free page whose color, its physical page
+   number modulo palloc_colors, is COLOR modulo palloc_colors, and
+   returns its kernel virtual address.  If no such page is free,
+   or pages are not colored, returns any free page, like
+   palloc_get_page() with FLAGS. */
+void* palloc_get_colored(enum palloc_flags flags, unsigned color) {
+  struct pool* pool = flags & PAL_USER ? &user_pool : &kernel_pool;
+  size_t page_idx;
+  void* page;
+
+  if (palloc_colors == 0 || pool->buddy)
+    return palloc_get_page(flags);
+
+  lock_acquire(&pool->lock);
+  page_idx = pool_alloc_colored(pool, color % palloc_colors);
+  lock_release(&pool->lock);
+  if (page_idx == BITMAP_ERROR) {
+    color_misses++;
+    return palloc_get_page(flags);
+  }
+  color_hits++;
+
+  page = pool->base + PGSIZE * page_idx;
+  if (flags & PAL_ZERO)
+    memset(page, 0, PGSIZE);
+  return page;
+}
+
+/* Obtains a free frame for a user page and returns its physical
+   address, or 0 if none is free.  Takes a frame from the high
+   pool if it can, and otherwise from the user pool, like
+   palloc_get_colored() with FLAGS and COLOR.  The caller must
+   kmap() the frame to touch it. */
+uintptr_t palloc_get_frame(enum palloc_flags flags, unsigned color) {
+  size_t page_idx = BITMAP_ERROR;
+  void* page;
+
+  if (high_pool.page_cnt > 0) {
+    lock_acquire(&high_pool.lock);
+    if (palloc_colors != 0)
+      page_idx = pool_alloc_colored(&high_pool, color % palloc_colors);
+    if (page_idx == BITMAP_ERROR)
+      page_idx = pool_alloc(&high_pool, 1);
+    lock_release(&high_pool.lock);
+  }
+  if (page_idx != BITMAP_ERROR) {
+    uintptr_t paddr = high_pool.phys + page_idx * PGSIZE;
+
+    if (palloc_colors != 0) {
+      if ((paddr >> PGBITS) % palloc_colors == color % palloc_colors)
+        color_hits++;
+      else
+        color_misses++;
+    }
+    if (flags & PAL_ZERO) {
+      page = kmap(paddr);
+      memset(page, 0, PGSIZE);
+      kunmap(page);
+    }
+    return paddr;
+  }
+
+  page = palloc_get_colored(flags | PAL_USER, color);
+  return page != NULL ? vtop(page) : 0;
+}
+
+/* Frees the frame at physical address PADDR, which
+   palloc_get_frame() returned. */
+void palloc_free_frame(uintptr_t paddr) {
+  ASSERT((paddr & PGMASK) == 0);
+
+  if (high_pool.page_cnt > 0 && paddr >= high_pool.phys) {
+    lock_acquire(&high_pool.lock);
+    pool_free(&high_pool, (paddr - high_pool.phys) >> PGBITS, 1);
+    lock_release(&high_pool.lock);
+  } else
+    palloc_free_page(ptov(paddr));
+}
+
+/* Sets RECLAIM to be called, with no lock of the page allocator
+   held, when a request finds its pool out of pages.  It must not
+   allocate memory or take a lock that a caller of the page
+   allocator may hold. */
+void palloc_set_reclaim(palloc_reclaim_func* reclaim_) { reclaim = reclaim_; }
+
 /* Frees the PAGE_CNT pages starting at PAGES. */
 void palloc_free_multiple(void* pages, size_t page_cnt) {
   struct pool* pool;
@@ -121,20 +375,91 @@ void palloc_free_multiple(void* pages, size_t page_cnt) {
   memset(pages, 0xcc, PGSIZE * page_cnt);
 #endif
 
-  ASSERT(bitmap_all(pool->used_map, page_idx, page_cnt));
-  bitmap_set_multiple(pool->used_map, page_idx, page_cnt, false);
+  lock_acquire(&pool->lock);
+  pool_free(pool, page_idx, page_cnt);
+  lock_release(&pool->lock);
 }
 
 /* Frees the page at PAGE. */
 void palloc_free_page(void* page) { palloc_free_multiple(page, 1); }
 
+/* Called by the idle thread, with interrupts off, to zero one
+   free page for a pool whose pre-zeroed list is short.  Returns
+   true if it zeroed a page, false if there was nothing to do or
+   the pool was busy.  Interrupts are on while the page is
+   zeroed and off again on return. */
+bool palloc_zero_idle(void) {
+  struct pool* pool;
+  size_t page_idx;
+  void* page;
+
+  ASSERT(intr_get_level() == INTR_OFF);
+
+  if (kernel_pool.zeroed_cnt < ZEROED_TARGET && kernel_pool.free_cnt > ZEROED_TARGET)
+    pool = &kernel_pool;
+  else if (user_pool.zeroed_cnt < ZEROED_TARGET && user_pool.free_cnt > ZEROED_TARGET)
+    pool = &user_pool;
+  else
+    return false;
+
+  /* Interrupts stay off while the lock is held, so no thread can
+     end up waiting on the idle thread. */
+  if (!lock_try_acquire(&pool->lock))
+    return false;
+  page_idx = pool_alloc(pool, 1);
+  lock_release(&pool->lock);
+  if (page_idx == BITMAP_ERROR)
+    return false;
+
+  page = pool->base + PGSIZE * page_idx;
+  intr_enable();
+  memset(page, 0, PGSIZE);
+  intr_disable();
+
+  list_push_back(&pool->zeroed, &((struct zeroed_page*)page)->elem);
+  pool->zeroed_cnt++;
+  return true;
+}
+
+/* Returns the number of free pages in the user and high pools if
+   FLAGS has PAL_USER, otherwise in the kernel pool, counting the
+   pre-zeroed ones.  The pools may change as soon as this
+   returns, so the count is only a hint. */
+size_t palloc_free_cnt(enum palloc_flags flags) {
+  if (flags & PAL_USER)
+    return user_pool.free_cnt + user_pool.zeroed_cnt + high_pool.free_cnt;
+  return kernel_pool.free_cnt + kernel_pool.zeroed_cnt;
+}
+
+/* Returns palloc_free_cnt(FLAGS), for kstat. */
+static long long read_free_cnt(void* flags) { return palloc_free_cnt((enum palloc_flags)flags); }
+
+/* Prints page allocator statistics. */
+void palloc_print_stats(void) {
+  print_pool_stats(&kernel_pool, "kernel pool");
+  print_pool_stats(&user_pool, "user pool");
+  if (high_pool.page_cnt > 0)
+    print_pool_stats(&high_pool, "high pool");
+  printf("Palloc: %lld pre-zeroed page hits, %lld misses\n", zeroed_hits, zeroed_misses);
+  if (palloc_colors != 0)
+    printf("Palloc: %u colors, %lld colored page hits, %lld misses\n", palloc_colors, color_hits,
+           color_misses);
+}
+
+/* Prints how many pages of POOL, called NAME, are in use. */
+static void print_pool_stats(const struct pool* pool, const char* name) {
+  printf("Palloc: %s: %zu of %zu pages used (%zu pre-zeroed), %zu peak\n", name,
+         pool->page_cnt - pool->free_cnt, pool->page_cnt, pool->zeroed_cnt, pool->peak_used);
+}
+
 /* Initializes pool P as starting at START and ending at END,
    naming it NAME for debugging purposes. */
 static void init_pool(struct pool* p, void* base, size_t page_cnt, const char* name) {
-  /* We'll put the pool's used_map at its base.
-     Calculate the space needed for the bitmap
-     and subtract it from the pool's size. */
-  size_t bm_pages = DIV_ROUND_UP(bitmap_buf_size(page_cnt), PGSIZE);
+  /* We'll put the pool's used_map or free_order at its base.
+     Calculate the space needed for it and subtract it from the
+     pool's size. */
+  size_t map_size = palloc_buddy ? page_cnt : bitmap_buf_size(page_cnt);
+  size_t bm_pages = DIV_ROUND_UP(map_size, PGSIZE);
   if (bm_pages > page_cnt)
     PANIC("Not enough memory in %s for bitmap.", name);
   page_cnt -= bm_pages;
@@ -143,8 +468,48 @@ static void init_pool(struct pool* p, void* base, size_t page_cnt, const char* n
 
   /* Initialize the pool. */
   lock_init(&p->lock);
-  p->used_map = bitmap_create_in_buf(page_cnt, base, bm_pages * PGSIZE);
-  p->base = base + bm_pages * PGSIZE;
+  p->base = (uint8_t*)base + bm_pages * PGSIZE;
+  p->phys = vtop(p->base);
+  p->buddy = palloc_buddy;
+  p->page_cnt = page_cnt;
+  p->free_cnt = page_cnt;
+  p->peak_used = 0;
+  list_init(&p->zeroed);
+  p->zeroed_cnt = 0;
+  if (p->buddy) {
+    int order;
+
+    p->free_order = base;
+    memset(p->free_order, 0, page_cnt);
+    for (order = 0; order <= BUDDY_MAX_ORDER; order++)
+      list_init(&p->free_lists[order]);
+    buddy_free(p, 0, page_cnt);
+  } else {
+    p->used_map = bitmap_create_in_buf(page_cnt, base, bm_pages * PGSIZE);
+    p->next_fit = 0;
+  }
+}
+
+/* Initializes P as the high pool, with the PAGE_CNT pages that
+   follow the direct mapping.  Its bitmap comes from the kernel
+   pool. */
+static void init_high_pool(struct pool* p, size_t page_cnt) {
+  size_t bm_pages = DIV_ROUND_UP(bitmap_buf_size(page_cnt), PGSIZE);
+  void* map = palloc_get_multiple(PAL_ASSERT, bm_pages);
+
+  printf("%zu pages available in high pool.\n", page_cnt);
+
+  lock_init(&p->lock);
+  p->base = NULL;
+  p->phys = (uintptr_t)init_lowmem_pages << PGBITS;
+  p->buddy = false;
+  p->page_cnt = page_cnt;
+  p->free_cnt = page_cnt;
+  p->peak_used = 0;
+  list_init(&p->zeroed);
+  p->zeroed_cnt = 0;
+  p->used_map = bitmap_create_in_buf(page_cnt, map, bm_pages * PGSIZE);
+  p->next_fit = 0;
 }
 
 /* Returns true if PAGE was allocated from POOL,
@@ -152,7 +517,191 @@ static void init_pool(struct pool* p, void* base, size_t page_cnt, const char* n
 static bool page_from_pool(const struct pool* pool, void* page) {
   size_t page_no = pg_no(page);
   size_t start_page = pg_no(pool->base);
-  size_t end_page = start_page + bitmap_size(pool->used_map);
+  size_t end_page = start_page + pool->page_cnt;
 
   return page_no >= start_page && page_no < end_page;
 }
+
+/* Allocates PAGE_CNT contiguous pages from POOL with its backend
+   and returns the index of the first, or BITMAP_ERROR if there
+   is no room.  POOL's lock must be held. */
+static size_t pool_alloc(struct pool* pool, size_t page_cnt) {
+  size_t page_idx;
+
+  if (page_cnt > pool->free_cnt)
+    return BITMAP_ERROR;
+
+  if (pool->buddy)
+    page_idx = buddy_alloc(pool, page_cnt);
+  else {
+    page_idx = bitmap_scan_and_flip(pool->used_map, pool->next_fit, page_cnt, false);
+    if (page_idx == BITMAP_ERROR && pool->next_fit != 0)
+      page_idx = bitmap_scan_and_flip(pool->used_map, 0, page_cnt, false);
+    if (page_idx != BITMAP_ERROR)
+      pool->next_fit = (page_idx + page_cnt) % pool->page_cnt;
+  }
+  if (page_idx != BITMAP_ERROR) {
+    pool->free_cnt -= page_cnt;
+    if (pool->page_cnt - pool->free_cnt > pool->peak_used)
+      pool->peak_used = pool->page_cnt - pool->free_cnt;
+  }
+  return page_idx;
+}
+
+/* Allocates one page of COLOR from POOL's bitmap and returns
+   its index, or BITMAP_ERROR if no page of COLOR is free.
+   POOL's lock must be held. */
+static size_t pool_alloc_colored(struct pool* pool, unsigned color) {
+  size_t page_idx;
+
+  if (pool->free_cnt == 0)
+    return BITMAP_ERROR;
+
+  page_idx = color_scan(pool, pool->next_fit, pool->page_cnt, color);
+  if (page_idx == BITMAP_ERROR)
+    page_idx = color_scan(pool, 0, pool->next_fit, color);
+  if (page_idx == BITMAP_ERROR)
+    return BITMAP_ERROR;
+
+  bitmap_mark(pool->used_map, page_idx);
+  pool->next_fit = (page_idx + 1) % pool->page_cnt;
+  pool->free_cnt--;
+  if (pool->page_cnt - pool->free_cnt > pool->peak_used)
+    pool->peak_used = pool->page_cnt - pool->free_cnt;
+  return page_idx;
+}
+
+/* Returns the index of the first free page of COLOR in POOL at
+   or after START and before END, or BITMAP_ERROR if there is
+   none. */
+static size_t color_scan(struct pool* pool, size_t start, size_t end, unsigned color) {
+  size_t start_color = ((pool->phys >> PGBITS) + start) % palloc_colors;
+  size_t page_idx = start + (color + palloc_colors - start_color) % palloc_colors;
+
+  for (; page_idx < end; page_idx += palloc_colors)
+    if (!bitmap_test(pool->used_map, page_idx))
+      return page_idx;
+  return BITMAP_ERROR;
+}
+
+/* Returns the PAGE_CNT pages starting at PAGE_IDX to POOL's
+   backend.  POOL's lock must be held. */
+static void pool_free(struct pool* pool, size_t page_idx, size_t page_cnt) {
+  if (pool->buddy)
+    buddy_free(pool, page_idx, page_cnt);
+  else {
+    ASSERT(bitmap_all(pool->used_map, page_idx, page_cnt));
+    bitmap_set_multiple(pool->used_map, page_idx, page_cnt, false);
+  }
+  pool->free_cnt += page_cnt;
+}
+
+/* Removes and returns a page from POOL's pre-zeroed list, or a
+   null pointer if the list is empty. */
+static void* zeroed_pop(struct pool* pool) {
+  enum intr_level old_level = intr_disable();
+  struct zeroed_page* page = NULL;
+
+  if (!list_empty(&pool->zeroed)) {
+    page = list_entry(list_pop_front(&pool->zeroed), struct zeroed_page, elem);
+    pool->zeroed_cnt--;
+  }
+  intr_set_level(old_level);
+
+  if (page != NULL)
+    memset(page, 0, sizeof *page);
+  return page;
+}
+
+/* Returns every page on POOL's pre-zeroed list to the pool. */
+static void zeroed_release(struct pool* pool) {
+  void* page;
+
+  while ((page = zeroed_pop(pool)) != NULL) {
+    lock_acquire(&pool->lock);
+    pool_free(pool, pg_no(page) - pg_no(pool->base), 1);
+    lock_release(&pool->lock);
+  }
+}
+
+/* Returns the buddy_block header of the page at PAGE_IDX in
+   POOL. */
+static struct buddy_block* buddy_block(struct pool* pool, size_t page_idx) {
+  return (struct buddy_block*)(pool->base + page_idx * PGSIZE);
+}
+
+/* Allocates PAGE_CNT contiguous pages from POOL's buddy lists
+   and returns the index of the first, or BITMAP_ERROR if there
+   is no large enough free block.  POOL's lock must be held. */
+static size_t buddy_alloc(struct pool* pool, size_t page_cnt) {
+  struct buddy_block* b;
+  size_t page_idx;
+  int order = 0, o;
+
+  while (((size_t)1 << order) < page_cnt)
+    if (++order > BUDDY_MAX_ORDER)
+      return BITMAP_ERROR;
+
+  /* Find the smallest free block that is large enough. */
+  for (o = order; o <= BUDDY_MAX_ORDER; o++)
+    if (!list_empty(&pool->free_lists[o]))
+      break;
+  if (o > BUDDY_MAX_ORDER)
+    return BITMAP_ERROR;
+
+  b = list_entry(list_pop_front(&pool->free_lists[o]), struct buddy_block, elem);
+  page_idx = ((uint8_t*)b - pool->base) / PGSIZE;
+  pool->free_order[page_idx] = 0;
+
+  /* Split it, putting the upper halves back, until it has the
+     order we want. */
+  while (o > order) {
+    o--;
+    pool->free_order[page_idx + ((size_t)1 << o)] = o + 1;
+    list_push_front(&pool->free_lists[o], &buddy_block(pool, page_idx + ((size_t)1 << o))->elem);
+  }
+
+  /* Give back the pages beyond PAGE_CNT. */
+  if (page_cnt < ((size_t)1 << order))
+    buddy_free(pool, page_idx + page_cnt, ((size_t)1 << order) - page_cnt);
+  return page_idx;
+}
+
+/* Frees the PAGE_CNT pages starting at PAGE_IDX in POOL, as the
+   largest aligned blocks that cover them.  POOL's lock must be
+   held, except during initialization. */
+static void buddy_free(struct pool* pool, size_t page_idx, size_t page_cnt) {
+  size_t end = page_idx + page_cnt;
+
+  ASSERT(end <= pool->page_cnt);
+  while (page_idx < end) {
+    int order = 0;
+
+    while (order < BUDDY_MAX_ORDER && page_idx % ((size_t)2 << order) == 0
+           && page_idx + ((size_t)2 << order) <= end)
+      order++;
+    buddy_free_block(pool, page_idx, order);
+    page_idx += (size_t)1 << order;
+  }
+}
+
+/* Frees the block of order ORDER at PAGE_IDX in POOL, merging it
+   with its buddy as long as the buddy is free. */
+static void buddy_free_block(struct pool* pool, size_t page_idx, int order) {
+  ASSERT(pool->free_order[page_idx] == 0);
+
+  while (order < BUDDY_MAX_ORDER) {
+    size_t buddy = page_idx ^ ((size_t)1 << order);
+
+    if (buddy + ((size_t)1 << order) > pool->page_cnt || pool->free_order[buddy] != order + 1)
+      break;
+    list_remove(&buddy_block(pool, buddy)->elem);
+    pool->free_order[buddy] = 0;
+    if (buddy < page_idx)
+      page_idx = buddy;
+    order++;
+  }
+
+  pool->free_order[page_idx] = order + 1;
+  list_push_front(&pool->free_lists[order], &buddy_block(pool, page_idx)->elem);
+}
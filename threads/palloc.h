@@ -1,7 +1,9 @@
 #ifndef THREADS_PALLOC_H
 #define THREADS_PALLOC_H
 
+#include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
 
 /* How to allocate pages. */
 enum palloc_flags {
@@ -10,10 +12,27 @@ enum palloc_flags {
   PAL_USER = 004    /* User page. */
 };
 
-void palloc_init(size_t user_page_limit);
+/* Gives back pages that are allocated but no longer needed, when
+   a pool runs out.  Returns true if it freed any. */
+typedef bool palloc_reclaim_func(void);
+
+/* -palloc=buddy: Use the buddy page allocator? */
+extern bool palloc_buddy;
+
+/* -colors: Number of page colors, or 0 not to color pages. */
+extern unsigned palloc_colors;
+
+void palloc_init(void* free_start, size_t user_page_limit);
 void* palloc_get_page(enum palloc_flags);
 void* palloc_get_multiple(enum palloc_flags, size_t page_cnt);
+void* palloc_get_colored(enum palloc_flags, unsigned color);
 void palloc_free_page(void*);
 void palloc_free_multiple(void*, size_t page_cnt);
+uintptr_t palloc_get_frame(enum palloc_flags, unsigned color);
+void palloc_free_frame(uintptr_t paddr);
+bool palloc_zero_idle(void);
+void palloc_set_reclaim(palloc_reclaim_func*);
+size_t palloc_free_cnt(enum palloc_flags);
+void palloc_print_stats(void);
 
 #endif /* threads/palloc.h */
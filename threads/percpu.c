@@ -0,0 +1,44 @@
+#include "threads/percpu.h"
+
+/* Per-CPU counters.
+
+   A statistic that every CPU bumps, such as the count of timer
+   ticks or page faults, would make the cache line holding it
+   move from CPU to CPU on each update, so that counting costs
+   more than the work counted.  A per-CPU counter gives each CPU
+   a slot in a cache line of its own, which only that CPU writes,
+   with interrupts off so that a handler on the same CPU cannot
+   interleave.  Reading, which only statistics reports do, adds
+   up all the slots.  The sum is not a snapshot: a CPU may count
+   in a slot already read.
+
+   Before the application processors are started, cpu_cnt is 1
+   and every count goes to slot 0 without looking up the running
+   CPU, so counting also works before thread_init(). */
+
+static long long read_slot(const struct percpu_slot*);
+
+/* Returns the sum of counter C over all CPUs. */
+long long percpu_read(const struct percpu_counter* c) {
+  long long sum = 0;
+  unsigned i;
+
+  for (i = 0; i < CPU_MAX; i++)
+    sum += read_slot(&c->slots[i]);
+  return sum;
+}
+
+/* Reads slot S, which its CPU may be adding to.  A 64-bit load
+   is two 32-bit loads here, so a carry into the high word
+   between them would tear the value: read until the high word
+   holds still. */
+static long long read_slot(const struct percpu_slot* s) {
+  const volatile unsigned* words = (const volatile unsigned*)&s->value;
+  unsigned hi, lo;
+
+  do {
+    hi = words[1];
+    lo = words[0];
+  } while (words[1] != hi);
+  return (long long)hi << 32 | lo;
+}
@@ -0,0 +1,38 @@
+#ifndef THREADS_PERCPU_H
+#define THREADS_PERCPU_H
+
+#include <stdint.h>
+#include "threads/cpu.h"
+#include "threads/interrupt.h"
+
+/* Size of a cache line, in bytes. */
+#define PERCPU_LINE 64
+
+/* One CPU's share of a per-CPU counter, alone in its cache
+   line. */
+struct percpu_slot {
+  long long value;
+} __attribute__((aligned(PERCPU_LINE)));
+
+/* A statistic counter that each CPU adds to in its own slot, so
+   that counting never moves a cache line between CPUs.  Only
+   percpu_read() adds the slots up.  Zero-initialized, it reads
+   0. */
+struct percpu_counter {
+  struct percpu_slot slots[CPU_MAX];
+};
+
+/* Adds N to counter C on the running CPU. */
+static inline void percpu_add(struct percpu_counter* c, long long n) {
+  enum intr_level old_level = intr_disable();
+
+  c->slots[cpu_cnt > 1 ? cpu_current()->id : 0].value += n;
+  intr_set_level(old_level);
+}
+
+/* Adds 1 to counter C on the running CPU. */
+static inline void percpu_inc(struct percpu_counter* c) { percpu_add(c, 1); }
+
+long long percpu_read(const struct percpu_counter*);
+
+#endif /* threads/percpu.h */
@@ -0,0 +1,214 @@
+#include "threads/pmu.h"
+#include <debug.h>
+#include "threads/interrupt.h"
+
+/* Hardware performance counters.
+
+   Intel's architectural performance monitoring unit, which CPUID
+   leaf 0xa describes, has a few general-purpose counters, each
+   programmed through an event select MSR with an event, a unit
+   mask, and the privilege levels to count at.  See [IA32-v3b]
+   "Architectural Performance Monitoring".
+
+   The counters are virtualized per thread.  pmu_setup() stores
+   the running thread's event selects in its struct thread and
+   starts the counters from zero.  On every switch away from the
+   thread, pmu_switch() stops them and adds their values to the
+   thread's totals; on every switch back, it starts them from
+   zero again.  So a thread counts only its own events, in user
+   code or in the kernel on its behalf, however it is scheduled.
+   A switch between two threads that use no counters costs two
+   tests.
+
+   Only the bootstrap processor runs threads, so only its
+   counters are used.  A CPU without an architectural PMU, such
+   as QEMU's default CPU, has no counters, and pmu_setup() fails
+   on it. */
+
+/* Model-specific registers. */
+#define MSR_PMC0 0x0c1             /* First counter. */
+#define MSR_PERFEVTSEL0 0x186      /* First counter's event select. */
+#define MSR_PERF_GLOBAL_CTRL 0x38f /* Counter enables, in version 2 and up. */
+
+/* Event select bits, above the event and unit mask. */
+#define EVTSEL_USR (1 << 16) /* Count at privilege level 3. */
+#define EVTSEL_OS (1 << 17)  /* Count at privilege level 0. */
+#define EVTSEL_EN (1 << 22)  /* Counter enabled. */
+
+/* CPUID leaf 1 EDX feature flag. */
+#define CPUID_MSR (1 << 5) /* rdmsr and wrmsr. */
+
+/* Architectural events, by their bit in CPUID leaf 0xa EBX,
+   which is set if the CPU does not count the event. */
+static const unsigned arch_events[] = {
+    PMU_CYCLES,            /* Bit 0. */
+    PMU_INSTRUCTIONS,      /* Bit 1. */
+    PMU_EVENT(0x3c, 0x01), /* Bit 2: reference cycles. */
+    PMU_CACHE_REFS,        /* Bit 3. */
+    PMU_CACHE_MISSES,      /* Bit 4. */
+    PMU_BRANCHES,          /* Bit 5. */
+    PMU_BRANCH_MISSES,     /* Bit 6. */
+};
+
+static unsigned counter_cnt;    /* Counters we use, at most PMU_COUNTER_CNT. */
+static unsigned arch_event_cnt; /* Architectural events CPUID describes. */
+static uint32_t missing_events; /* CPUID leaf 0xa EBX. */
+
+static void cpuid(uint32_t leaf, uint32_t regs[4]);
+static uint64_t read_msr(uint32_t msr);
+static void write_msr(uint32_t msr, uint64_t value);
+static bool event_ok(unsigned event);
+static void start_counters(struct thread*);
+static void stop_counters(struct thread*);
+
+/* Finds the counters, if the CPU has an architectural PMU. */
+void pmu_init(void) {
+  uint32_t regs[4];
+  unsigned version, i;
+
+  cpuid(0, regs);
+  if (regs[0] < 0xa)
+    return;
+  cpuid(1, regs);
+  if (!(regs[3] & CPUID_MSR))
+    return;
+  cpuid(0xa, regs);
+  version = regs[0] & 0xff;
+  if (version == 0)
+    return;
+
+  counter_cnt = (regs[0] >> 8) & 0xff;
+  if (counter_cnt > PMU_COUNTER_CNT)
+    counter_cnt = PMU_COUNTER_CNT;
+  arch_event_cnt = regs[0] >> 24;
+  missing_events = regs[1];
+
+  for (i = 0; i < counter_cnt; i++)
+    write_msr(MSR_PERFEVTSEL0 + i, 0);
+  if (version >= 2)
+    write_msr(MSR_PERF_GLOBAL_CTRL, read_msr(MSR_PERF_GLOBAL_CTRL) | ((1u << counter_cnt) - 1));
+}
+
+/* Returns the number of counters a thread may use, which is 0 if
+   the CPU has no PMU. */
+unsigned pmu_counter_cnt(void) { return counter_cnt; }
+
+/* Sets up the running thread's counters to count EVENTS[i] with
+   counter i, each at the privilege levels in MODE, a combination
+   of PMU_USER and PMU_KERNEL, and starts them from zero.
+   PMU_NONE leaves a counter unused; setting up no events at all
+   stops counting.  Returns false, changing nothing, if the CPU
+   lacks a counter or does not count an event, or if MODE is
+   empty. */
+bool pmu_setup(const unsigned events[PMU_COUNTER_CNT], int mode) {
+  struct thread* t = thread_current();
+  uint32_t evtsel = EVTSEL_EN;
+  enum intr_level old_level;
+  int i;
+
+  if (mode == 0 || (mode & ~(PMU_USER | PMU_KERNEL)) != 0)
+    return false;
+  for (i = 0; i < PMU_COUNTER_CNT; i++)
+    if (events[i] != PMU_NONE && ((unsigned)i >= counter_cnt || !event_ok(events[i])))
+      return false;
+  if (mode & PMU_USER)
+    evtsel |= EVTSEL_USR;
+  if (mode & PMU_KERNEL)
+    evtsel |= EVTSEL_OS;
+
+  old_level = intr_disable();
+  stop_counters(t);
+  t->pmu_active = false;
+  for (i = 0; i < PMU_COUNTER_CNT; i++) {
+    t->pmu_evtsel[i] = events[i] != PMU_NONE ? events[i] | evtsel : 0;
+    t->pmu_counts[i] = 0;
+    if (t->pmu_evtsel[i] != 0)
+      t->pmu_active = true;
+  }
+  start_counters(t);
+  intr_set_level(old_level);
+  return true;
+}
+
+/* Stores in COUNTS[i] the number of events counter i of the
+   running thread has counted since pmu_setup(), or 0 if it is
+   unused. */
+void pmu_read(uint64_t counts[PMU_COUNTER_CNT]) {
+  struct thread* t = thread_current();
+  enum intr_level old_level = intr_disable();
+  unsigned i;
+
+  for (i = 0; i < PMU_COUNTER_CNT; i++) {
+    counts[i] = t->pmu_counts[i];
+    if (t->pmu_evtsel[i] != 0)
+      counts[i] += read_msr(MSR_PMC0 + i);
+  }
+  intr_set_level(old_level);
+}
+
+/* Moves the counters from PREV, which is being switched away
+   from, to NEXT.  Called by schedule() with interrupts off. */
+void pmu_switch(struct thread* prev, struct thread* next) {
+  ASSERT(intr_get_level() == INTR_OFF);
+
+  if (prev->pmu_active)
+    stop_counters(prev);
+  if (next->pmu_active)
+    start_counters(next);
+}
+
+/* Returns true if EVENT fits an event select and, if it is an
+   architectural event, the CPU counts it. */
+static bool event_ok(unsigned event) {
+  unsigned i;
+
+  if (event > 0xffff)
+    return false;
+  for (i = 0; i < sizeof arch_events / sizeof *arch_events; i++)
+    if (event == arch_events[i])
+      return i < arch_event_cnt && !(missing_events & (1u << i));
+  return true;
+}
+
+/* Starts T's counters from zero. */
+static void start_counters(struct thread* t) {
+  unsigned i;
+
+  for (i = 0; i < counter_cnt; i++)
+    if (t->pmu_evtsel[i] != 0) {
+      write_msr(MSR_PMC0 + i, 0);
+      write_msr(MSR_PERFEVTSEL0 + i, t->pmu_evtsel[i]);
+    }
+}
+
+/* Stops T's counters and adds their values to its totals. */
+static void stop_counters(struct thread* t) {
+  unsigned i;
+
+  for (i = 0; i < counter_cnt; i++)
+    if (t->pmu_evtsel[i] != 0) {
+      write_msr(MSR_PERFEVTSEL0 + i, 0);
+      t->pmu_counts[i] += read_msr(MSR_PMC0 + i);
+    }
+}
+
+/* Executes CPUID for LEAF and stores EAX, EBX, ECX and EDX in
+   REGS.  See [IA32-v2a] "CPUID". */
+static void cpuid(uint32_t leaf, uint32_t regs[4]) {
+  asm volatile("cpuid"
+               : "=a"(regs[0]), "=b"(regs[1]), "=c"(regs[2]), "=d"(regs[3])
+               : "a"(leaf), "c"(0));
+}
+
+/* Returns the value of model-specific register MSR. */
+static uint64_t read_msr(uint32_t msr) {
+  uint64_t value;
+
+  asm volatile("rdmsr" : "=A"(value) : "c"(msr));
+  return value;
+}
+
+/* Sets model-specific register MSR to VALUE. */
+static void write_msr(uint32_t msr, uint64_t value) {
+  asm volatile("wrmsr" : : "c"(msr), "A"(value));
+}
@@ -0,0 +1,15 @@
+#ifndef THREADS_PMU_H
+#define THREADS_PMU_H
+
+#include <pmu.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "threads/thread.h"
+
+void pmu_init(void);
+unsigned pmu_counter_cnt(void);
+bool pmu_setup(const unsigned events[PMU_COUNTER_CNT], int mode);
+void pmu_read(uint64_t counts[PMU_COUNTER_CNT]);
+void pmu_switch(struct thread* prev, struct thread* next);
+
+#endif /* threads/pmu.h */
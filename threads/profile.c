@@ -0,0 +1,113 @@
+#include "threads/profile.h"
+#include <debug.h>
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "devices/timer.h"
+#include "threads/palloc.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+
+/* Sampling profiler.
+
+   With the -profile option, timer_interrupt() records on every
+   tick where the interrupted code was: its eip, whether it was
+   user or kernel code, the running thread, and, for kernel code,
+   the return addresses of up to PROFILE_DEPTH callers, found by
+   following the chain of saved frame pointers.  The samples go
+   into a ring of PROFILE_PAGES pages allocated at boot,
+   overwriting the oldest once it is full.  Recording only copies
+   a few words, with interrupts off, so it needs no lock and must
+   not allocate or print.  Without the option the only cost is
+   the test of profile_enabled.
+
+   At shutdown the ring is dumped between a "PROFILE BEGIN" line
+   and a "PROFILE END" line, one sample per line, oldest first:
+
+       tid,kernel,eip,caller,caller,...
+       tid,user,eip
+
+   with addresses in hex.  utils/pintos-profile turns a dump into
+   a flat profile or into folded stacks for a flame graph. */
+
+bool profile_enabled;
+
+/* Callers recorded per kernel sample. */
+#define PROFILE_DEPTH 8
+
+/* A recorded sample. */
+struct profile_sample {
+  uint32_t eip;                    /* Interrupted instruction. */
+  tid_t tid;                       /* Running thread. */
+  bool user;                       /* Interrupted user code? */
+  uint8_t depth;                   /* Number of CALLERS. */
+  uint32_t callers[PROFILE_DEPTH]; /* Return addresses, innermost first. */
+};
+
+/* Pages allocated for samples. */
+#define PROFILE_PAGES 64
+#define PROFILE_SIZE (PROFILE_PAGES * PGSIZE / sizeof(struct profile_sample))
+
+static struct profile_sample* ring;
+static uint32_t ring_head; /* Total number of samples recorded. */
+
+/* Allocates the sample ring, if profiling is enabled.  Must be
+   called after palloc_init(). */
+void profile_init(void) {
+  if (profile_enabled)
+    ring = palloc_get_multiple(PAL_ASSERT, PROFILE_PAGES);
+}
+
+/* Records a sample of the code interrupted with frame F.  Called
+   by timer_interrupt(). */
+void profile_sample(const struct intr_frame* f) {
+  struct profile_sample* s;
+
+  ASSERT(intr_get_level() == INTR_OFF);
+  if (ring == NULL)
+    return;
+
+  s = &ring[ring_head++ % PROFILE_SIZE];
+  s->eip = (uint32_t)f->eip;
+  s->tid = thread_current()->tid;
+  s->user = (f->cs & 3) == 3;
+  s->depth = 0;
+  if (!s->user) {
+    /* Follow the saved frame pointers, as long as each frame lies
+       further up the same stack page as F. */
+    uintptr_t stack_end = (uintptr_t)pg_round_down(f) + PGSIZE;
+    uintptr_t frame = f->ebp;
+
+    while (s->depth < PROFILE_DEPTH && frame > (uintptr_t)f
+           && frame <= stack_end - 2 * sizeof(uint32_t)) {
+      const uint32_t* fp = (const uint32_t*)frame;
+
+      s->callers[s->depth++] = fp[1];
+      if (fp[0] <= frame)
+        break;
+      frame = fp[0];
+    }
+  }
+}
+
+/* Prints the recorded samples, if profiling is enabled. */
+void profile_dump(void) {
+  uint32_t i, start;
+
+  if (ring == NULL)
+    return;
+
+  start = ring_head > PROFILE_SIZE ? ring_head - PROFILE_SIZE : 0;
+  printf("PROFILE BEGIN %" PRIu32 " samples, %" PRIu32 " dropped, %d Hz\n", ring_head - start,
+         start, TIMER_FREQ);
+  for (i = start; i != ring_head; i++) {
+    const struct profile_sample* s = &ring[i % PROFILE_SIZE];
+    int d;
+
+    printf("%d,%s,%08" PRIx32, s->tid, s->user ? "user" : "kernel", s->eip);
+    for (d = 0; d < s->depth; d++)
+      printf(",%08" PRIx32, s->callers[d]);
+    printf("\n");
+  }
+  printf("PROFILE END\n");
+}
@@ -0,0 +1,15 @@
+#ifndef THREADS_PROFILE_H
+#define THREADS_PROFILE_H
+
+#include <stdbool.h>
+#include "threads/interrupt.h"
+
+/* -profile: Sample the interrupted code on each timer tick and
+   dump the samples at shutdown? */
+extern bool profile_enabled;
+
+void profile_init(void);
+void profile_sample(const struct intr_frame*);
+void profile_dump(void);
+
+#endif /* threads/profile.h */
@@ -60,8 +60,17 @@ static inline uintptr_t pd_no(const void* va) { return (uintptr_t)va >> PDSHIFT;
 #define PTE_P 0x1            /* 1=present, 0=not present. */
 #define PTE_W 0x2            /* 1=read/write, 0=read-only. */
 #define PTE_U 0x4            /* 1=user/kernel, 0=kernel only. */
+#define PTE_PCD 0x10         /* 1=caching disabled, for device registers. */
 #define PTE_A 0x20           /* 1=accessed, 0=not acccessed. */
 #define PTE_D 0x40           /* 1=dirty, 0=not dirty (PTEs only). */
+#define PTE_PS 0x80          /* 1=4 MB page, 0=page table (PDEs only). */
+#define PTE_G 0x100          /* 1=global, kept in the TLB across CR3 loads. */
+#define PTE_SHARED 0x200     /* 1=page not owned by the page directory (in PTE_AVL). */
+
+/* Control register 4 bits that make the CPU honor PTE_PS and
+   PTE_G. */
+#define CR4_PSE 0x00000010
+#define CR4_PGE 0x00000080
 
 /* Returns a PDE that points to page table PT. */
 static inline uint32_t pde_create(uint32_t* pt) {
@@ -69,20 +78,42 @@ static inline uint32_t pde_create(uint32_t* pt) {
   return vtop(pt) | PTE_U | PTE_P | PTE_W;
 }
 
+/* Returns a PDE that maps the 4 MB of memory starting at PAGE,
+   which must be 4 MB aligned, for the kernel, without a page
+   table.  Such a PDE only works with CR4.PSE set; see [IA32-v3a]
+   3.7.3 "Mixing 4-KByte and 4-MByte Pages".  If WRITABLE is true
+   then the memory is writable as well as readable. */
+static inline uint32_t pde_create_large(void* page, bool writable) {
+  ASSERT(vtop(page) % PTSPAN == 0);
+  return vtop(page) | PTE_PS | PTE_P | (writable ? PTE_W : 0);
+}
+
 /* Returns a pointer to the page table that page directory entry
-   PDE, which must "present", points to. */
+   PDE, which must "present" and not map a 4 MB page, points
+   to. */
 static inline uint32_t* pde_get_pt(uint32_t pde) {
   ASSERT(pde & PTE_P);
+  ASSERT(!(pde & PTE_PS));
   return ptov(pde & PTE_ADDR);
 }
 
+/* Returns a PTE that points to the page at physical address
+   PADDR, which may be in high memory.
+   The PTE's page is readable.
+   If WRITABLE is true then it will be writable as well.
+   The page will be usable only by ring 0 code (the kernel). */
+static inline uint32_t pte_create_phys(uintptr_t paddr, bool writable) {
+  ASSERT((paddr & PGMASK) == 0);
+  return paddr | PTE_P | (writable ? PTE_W : 0);
+}
+
 /* Returns a PTE that points to PAGE.
    The PTE's page is readable.
    If WRITABLE is true then it will be writable as well.
    The page will be usable only by ring 0 code (the kernel). */
 static inline uint32_t pte_create_kernel(void* page, bool writable) {
   ASSERT(pg_ofs(page) == 0);
-  return vtop(page) | PTE_P | (writable ? PTE_W : 0);
+  return pte_create_phys(vtop(page), writable);
 }
 
 /* Returns a PTE that points to PAGE.
@@ -0,0 +1,170 @@
+#include "threads/rcu.h"
+#include <debug.h>
+#include <stdio.h>
+#include "threads/interrupt.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+/* Read-copy update.
+
+   Lets readers walk a list, such as the list of all threads,
+   without taking a lock or turning interrupts off, while writers
+   change it.  A reader brackets its walk with rcu_read_lock()
+   and rcu_read_unlock().  A writer, with its own exclusion from
+   other writers, unlinks a node with rcu_list_remove(), which
+   leaves the node's own links intact for a reader standing on
+   it, and hands the node to call_rcu() instead of freeing it.
+   The callback runs once every reader that might still see the
+   node has finished: after a grace period.
+
+   Grace periods are counted in two phases.  A reader counts
+   itself in readers[] under the phase current when it starts.
+   Callbacks queued by call_rcu() wait in `waiting'.  At each
+   context switch, rcu_quiescent() moves them to `draining' and
+   flips the phase, so that later readers count in the other
+   phase.  Every reader that could have seen their nodes is then
+   counted under the old phase, and at a later context switch
+   that finds its count at zero, the callbacks run.  A reader may
+   block or be preempted; that only makes the grace period
+   longer.
+
+   Entering and leaving a read-side section are a few
+   instructions, with a locked add to count the reader, so they
+   also work from interrupt handlers and, later, on more than one
+   CPU.  The callback queues are protected by turning interrupts
+   off, which is enough while only the bootstrap processor runs
+   threads. */
+
+static volatile int readers[2]; /* Readers in each phase. */
+static volatile int phase;      /* Phase that new readers count in. */
+static struct list waiting;     /* Callbacks queued since the last flip. */
+static struct list draining;    /* Callbacks waiting for the old phase's readers. */
+
+/* Statistics. */
+static long long grace_periods; /* Grace periods completed. */
+static long long callback_cnt;  /* Callbacks run. */
+
+static void atomic_add(volatile int*, int);
+
+/* Initializes read-copy update. */
+void rcu_init(void) {
+  list_init(&waiting);
+  list_init(&draining);
+}
+
+/* Starts a read-side section, in which the nodes that the
+   running thread reaches stay allocated.  Sections nest.
+
+   The running thread's rcu_state holds twice its nesting depth,
+   plus the phase it counts in, and changes with single stores,
+   so that an interrupt handler that reads in between leaves it
+   as it found it. */
+void rcu_read_lock(void) {
+  struct thread* t = thread_current();
+  int state = t->rcu_state;
+  int p;
+
+  if (state >= 2) {
+    t->rcu_state = state + 2;
+    return;
+  }
+
+  /* Count in the current phase, and check that the phase did not
+     flip before we were counted. */
+  for (;;) {
+    p = phase;
+    atomic_add(&readers[p], 1);
+    if (phase == p)
+      break;
+    atomic_add(&readers[p], -1);
+  }
+  t->rcu_state = 2 | p;
+}
+
+/* Ends a read-side section that rcu_read_lock() started. */
+void rcu_read_unlock(void) {
+  struct thread* t = thread_current();
+  int state = t->rcu_state;
+
+  ASSERT(state >= 2);
+
+  if (state >= 4)
+    t->rcu_state = state - 2;
+  else {
+    t->rcu_state = 0;
+    atomic_add(&readers[state & 1], -1);
+  }
+}
+
+/* Arranges for FUNC to be called with HEAD after a grace period,
+   once no reader can still see the node that HEAD is embedded
+   in, which must already be unlinked.  FUNC runs at a context
+   switch, with interrupts off, so it must not sleep. */
+void call_rcu(struct rcu_head* head, rcu_func* func) {
+  enum intr_level old_level = intr_disable();
+
+  head->func = func;
+  list_push_back(&waiting, &head->elem);
+  intr_set_level(old_level);
+}
+
+/* Called at each context switch, with interrupts off.  Runs the
+   callbacks whose grace period is over, and starts a grace
+   period for those queued since. */
+void rcu_quiescent(void) {
+  ASSERT(intr_get_level() == INTR_OFF);
+
+  if (!list_empty(&draining)) {
+    if (readers[!phase] != 0)
+      return;
+    grace_periods++;
+    while (!list_empty(&draining)) {
+      struct rcu_head* head = list_entry(list_pop_front(&draining), struct rcu_head, elem);
+
+      callback_cnt++;
+      head->func(head);
+    }
+  }
+  if (!list_empty(&waiting)) {
+    list_splice(list_end(&draining), list_begin(&waiting), list_end(&waiting));
+    phase = !phase;
+  }
+}
+
+/* Prints read-copy update statistics. */
+void rcu_print_stats(void) {
+  printf("RCU: %lld grace periods, %lld callbacks\n", grace_periods, callback_cnt);
+}
+
+/* Inserts ELEM just before BEFORE, like list_insert(), in a list
+   that readers walk forward in read-side sections.  ELEM's links
+   are set before it is published.  The caller must exclude other
+   writers. */
+void rcu_list_insert(struct list_elem* before, struct list_elem* elem) {
+  elem->prev = before->prev;
+  elem->next = before;
+  barrier();
+  before->prev->next = elem;
+  before->prev = elem;
+}
+
+/* Inserts ELEM at the end of LIST, like list_push_back(), in a
+   list that readers walk in read-side sections. */
+void rcu_list_push_back(struct list* list, struct list_elem* elem) {
+  rcu_list_insert(list_end(list), elem);
+}
+
+/* Removes ELEM from a list that readers walk in read-side
+   sections.  ELEM keeps its links, so a reader on it still finds
+   the rest of the list; it may be freed only after a grace
+   period. */
+void rcu_list_remove(struct list_elem* elem) {
+  elem->prev->next = elem->next;
+  elem->next->prev = elem->prev;
+  barrier();
+}
+
+/* Adds N to *P atomically, as a full memory barrier. */
+static void atomic_add(volatile int* p, int n) {
+  asm volatile("lock addl %1, %0" : "+m"(*p) : "ir"(n) : "memory");
+}
@@ -0,0 +1,30 @@
+#ifndef THREADS_RCU_H
+#define THREADS_RCU_H
+
+#include <list.h>
+
+struct rcu_head;
+
+/* Function that call_rcu() calls once no reader can still see
+   the object that its rcu_head is embedded in. */
+typedef void rcu_func(struct rcu_head*);
+
+/* A callback queued by call_rcu(), embedded in the object it
+   frees.  Must stay valid until FUNC has been called. */
+struct rcu_head {
+  struct list_elem elem; /* Element in a callback queue. */
+  rcu_func* func;        /* Function to call. */
+};
+
+void rcu_init(void);
+void rcu_read_lock(void);
+void rcu_read_unlock(void);
+void call_rcu(struct rcu_head*, rcu_func*);
+void rcu_quiescent(void);
+void rcu_print_stats(void);
+
+void rcu_list_insert(struct list_elem* before, struct list_elem* elem);
+void rcu_list_push_back(struct list*, struct list_elem*);
+void rcu_list_remove(struct list_elem*);
+
+#endif /* threads/rcu.h */
@@ -0,0 +1,83 @@
+#include "threads/sched-trace.h"
+#include <debug.h>
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "devices/timer.h"
+#include "threads/cpu.h"
+#include "threads/interrupt.h"
+
+/* Scheduler trace.
+
+   With the -sched-trace option, schedule() records every thread
+   switch in a fixed-size ring, overwriting the oldest events
+   once it is full.  Recording happens with interrupts off, from
+   inside schedule(), so it needs no lock and must not allocate
+   or print.  Without the option the only cost is the test of
+   sched_trace_enabled.
+
+   At shutdown the ring is dumped as CSV between a
+   "SCHED-TRACE BEGIN" line and a "SCHED-TRACE END" line, one
+   event per line, oldest first:
+
+       tick,ns,cpu,prev_tid,prev_priority,next_tid,next_priority,reason
+
+   where ns is timer_ns() and reason is one of block, yield,
+   preempt or exit.
+   utils/sched-timeline turns a dump into a timeline. */
+
+bool sched_trace_enabled;
+
+/* A recorded thread switch. */
+struct sched_trace_event {
+  int64_t tick;     /* timer_ticks() at the switch. */
+  int64_t ns;       /* timer_ns() at the switch. */
+  uint8_t cpu;      /* CPU that switched. */
+  uint8_t reason;   /* enum sched_trace_reason. */
+  uint8_t prev_pri; /* Priority of the previous thread. */
+  uint8_t next_pri; /* Priority of the next thread. */
+  tid_t prev_tid;   /* Previous thread. */
+  tid_t next_tid;   /* Next thread. */
+};
+
+/* Number of events kept.  Must be a power of 2. */
+#define SCHED_TRACE_SIZE 1024
+
+static struct sched_trace_event ring[SCHED_TRACE_SIZE];
+static uint32_t ring_head; /* Total number of events recorded. */
+
+static const char* reason_names[] = {"block", "yield", "preempt", "exit"};
+
+/* Records a switch from PREV to NEXT for REASON.  Called by
+   schedule() with interrupts off. */
+void sched_trace_switch(struct thread* prev, struct thread* next, enum sched_trace_reason reason) {
+  struct sched_trace_event* e = &ring[ring_head++ % SCHED_TRACE_SIZE];
+
+  ASSERT(intr_get_level() == INTR_OFF);
+
+  e->tick = timer_ticks();
+  e->ns = timer_ns();
+  e->cpu = prev->cpu->id;
+  e->reason = reason;
+  e->prev_pri = prev->priority;
+  e->next_pri = next->priority;
+  e->prev_tid = prev->tid;
+  e->next_tid = next->tid;
+}
+
+/* Prints the recorded events, if tracing is enabled. */
+void sched_trace_dump(void) {
+  uint32_t i, start;
+
+  if (!sched_trace_enabled)
+    return;
+
+  start = ring_head > SCHED_TRACE_SIZE ? ring_head - SCHED_TRACE_SIZE : 0;
+  printf("SCHED-TRACE BEGIN %" PRIu32 " events, %" PRIu32 " dropped\n", ring_head - start, start);
+  for (i = start; i != ring_head; i++) {
+    const struct sched_trace_event* e = &ring[i % SCHED_TRACE_SIZE];
+    printf("%lld,%lld,%u,%d,%u,%d,%u,%s\n", e->tick, e->ns, e->cpu, e->prev_tid, e->prev_pri,
+           e->next_tid, e->next_pri, reason_names[e->reason]);
+  }
+  printf("SCHED-TRACE END\n");
+}
@@ -0,0 +1,21 @@
+#ifndef THREADS_SCHED_TRACE_H
+#define THREADS_SCHED_TRACE_H
+
+#include <stdbool.h>
+#include "threads/thread.h"
+
+/* Why a thread switch happened. */
+enum sched_trace_reason {
+  SCHED_TRACE_BLOCK,   /* Previous thread blocked. */
+  SCHED_TRACE_YIELD,   /* Previous thread called thread_yield(). */
+  SCHED_TRACE_PREEMPT, /* Previous thread was preempted. */
+  SCHED_TRACE_EXIT     /* Previous thread exited. */
+};
+
+/* -sched-trace: Record thread switches and dump them at shutdown? */
+extern bool sched_trace_enabled;
+
+void sched_trace_switch(struct thread* prev, struct thread* next, enum sched_trace_reason);
+void sched_trace_dump(void);
+
+#endif /* threads/sched-trace.h */
@@ -0,0 +1,203 @@
+#include "threads/slab.h"
+#include <debug.h>
+#include <list.h>
+#include <round.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+
+/* A slab allocator for fixed-size objects, after Bonwick, "The
+   Slab Allocator: An Object-Caching Kernel Memory Allocator".
+
+   A cache hands out objects of a single size.  It carves pages
+   from the page allocator, called "slabs", into as many objects
+   as fit after a small header, so an object takes exactly its
+   size rounded up to its alignment, without malloc()'s rounding
+   to a power of 2.
+
+   A cache may have a constructor, which is run on each object
+   when its slab is created, not on every allocation.  An object
+   must be in its constructed state again when it is freed, so
+   the initialization the constructor does (for example, of
+   locks that are never held across a free) is paid for once per
+   object rather than once per use.  For that reason a slab's free
+   objects are tracked by index in the header instead of being
+   linked through the objects themselves.
+
+   Each slab with a free object is on its cache's `partial' list.
+   When a slab becomes entirely free, it goes back to the page
+   allocator. */
+
+/* Magic number for detecting slab corruption. */
+#define SLAB_MAGIC 0x51ab51ab
+
+/* A cache. */
+struct kmem_cache {
+  const char* name;     /* For kmem_print_stats(). */
+  size_t size;          /* Object size, a multiple of the alignment. */
+  size_t obj_ofs;       /* Offset of the first object in a slab. */
+  size_t objs_per_slab; /* Objects in each slab. */
+  kmem_ctor_func* ctor; /* Constructor, or a null pointer. */
+  struct lock lock;     /* Protects the members below. */
+  struct list partial;  /* Slabs with at least one free object. */
+  size_t slab_cnt;      /* Slabs allocated. */
+  size_t obj_cnt;       /* Objects in use. */
+};
+
+/* Slab header, at the start of each slab page. */
+struct slab {
+  unsigned magic;           /* Always set to SLAB_MAGIC. */
+  struct kmem_cache* cache; /* Owning cache. */
+  struct list_elem elem;    /* Element in cache's partial list. */
+  uint16_t free_cnt;        /* Number of free objects. */
+  uint16_t free[];          /* Stack of indexes of free objects. */
+};
+
+/* Caches are allocated from this table, so that caches can be
+   created before malloc() is initialized. */
+#define KMEM_CACHE_MAX 16
+static struct kmem_cache caches[KMEM_CACHE_MAX];
+static size_t cache_cnt;
+
+static struct slab* slab_create(struct kmem_cache*);
+static void* slab_object(struct kmem_cache*, struct slab*, size_t idx);
+
+/* Creates and returns a cache of objects SIZE bytes long, placed
+   at multiples of ALIGN bytes, which must be a power of 2 (0
+   means the alignment of a pointer).  If CTOR is non-null, it is
+   called on each object when the object's slab is created, and
+   kmem_cache_free() must always be given objects in the state
+   CTOR leaves them in.  Panics if too many caches are created. */
+struct kmem_cache* kmem_cache_create(const char* name, size_t size, size_t align,
+                                     kmem_ctor_func* ctor) {
+  struct kmem_cache* c;
+  size_t cnt;
+
+  if (align == 0)
+    align = sizeof(void*);
+  ASSERT((align & (align - 1)) == 0);
+  ASSERT(size > 0);
+  if (cache_cnt >= KMEM_CACHE_MAX)
+    PANIC("too many slab caches");
+
+  c = &caches[cache_cnt++];
+  c->name = name;
+  c->size = ROUND_UP(size, align);
+  c->ctor = ctor;
+  lock_init(&c->lock);
+  list_init(&c->partial);
+  c->slab_cnt = c->obj_cnt = 0;
+
+  /* Find the largest number of objects that fit in a page after
+     the header and its free index stack. */
+  for (cnt = PGSIZE / c->size; cnt > 0; cnt--) {
+    size_t ofs = ROUND_UP(sizeof(struct slab) + cnt * sizeof(uint16_t), align);
+    if (ofs + cnt * c->size <= PGSIZE) {
+      c->obj_ofs = ofs;
+      break;
+    }
+  }
+  ASSERT(cnt > 0);
+  c->objs_per_slab = cnt;
+
+  return c;
+}
+
+/* Allocates and returns an object from cache C.  Returns a null
+   pointer if memory is not available. */
+void* kmem_cache_alloc(struct kmem_cache* c) {
+  struct slab* s;
+  void* obj;
+
+  ASSERT(c != NULL);
+
+  lock_acquire(&c->lock);
+  if (list_empty(&c->partial)) {
+    s = slab_create(c);
+    if (s == NULL) {
+      lock_release(&c->lock);
+      return NULL;
+    }
+    list_push_front(&c->partial, &s->elem);
+  }
+
+  s = list_entry(list_front(&c->partial), struct slab, elem);
+  obj = slab_object(c, s, s->free[--s->free_cnt]);
+  if (s->free_cnt == 0)
+    list_remove(&s->elem);
+  c->obj_cnt++;
+  lock_release(&c->lock);
+
+  return obj;
+}
+
+/* Returns OBJ, which must have been allocated from cache C, to
+   C.  A null OBJ is ignored. */
+void kmem_cache_free(struct kmem_cache* c, void* obj) {
+  struct slab* s;
+  size_t ofs;
+
+  if (obj == NULL)
+    return;
+
+  s = pg_round_down(obj);
+  ofs = pg_ofs(obj);
+  ASSERT(s->magic == SLAB_MAGIC);
+  ASSERT(s->cache == c);
+  ASSERT(ofs >= c->obj_ofs && (ofs - c->obj_ofs) % c->size == 0);
+
+  lock_acquire(&c->lock);
+  ASSERT(s->free_cnt < c->objs_per_slab);
+  s->free[s->free_cnt++] = (ofs - c->obj_ofs) / c->size;
+  c->obj_cnt--;
+  if (s->free_cnt == 1)
+    list_push_front(&c->partial, &s->elem);
+  else if (s->free_cnt == c->objs_per_slab) {
+    list_remove(&s->elem);
+    c->slab_cnt--;
+    palloc_free_page(s);
+  }
+  lock_release(&c->lock);
+}
+
+/* Prints statistics for each cache. */
+void kmem_print_stats(void) {
+  size_t i;
+
+  for (i = 0; i < cache_cnt; i++) {
+    struct kmem_cache* c = &caches[i];
+    printf("Slab %s: %zu objects of %zu bytes in use, %zu slabs\n", c->name, c->obj_cnt, c->size,
+           c->slab_cnt);
+  }
+}
+
+/* Allocates a new slab for cache C and constructs its objects.
+   Returns a null pointer if memory is not available.  C's lock
+   must be held. */
+static struct slab* slab_create(struct kmem_cache* c) {
+  struct slab* s = palloc_get_page(0);
+  size_t i;
+
+  if (s == NULL)
+    return NULL;
+
+  s->magic = SLAB_MAGIC;
+  s->cache = c;
+  s->free_cnt = c->objs_per_slab;
+  for (i = 0; i < c->objs_per_slab; i++) {
+    s->free[i] = c->objs_per_slab - 1 - i;
+    if (c->ctor != NULL)
+      c->ctor(slab_object(c, s, i));
+  }
+  c->slab_cnt++;
+  return s;
+}
+
+/* Returns object IDX within slab S of cache C. */
+static void* slab_object(struct kmem_cache* c, struct slab* s, size_t idx) {
+  ASSERT(idx < c->objs_per_slab);
+  return (uint8_t*)s + c->obj_ofs + idx * c->size;
+}
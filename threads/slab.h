@@ -0,0 +1,15 @@
+#ifndef THREADS_SLAB_H
+#define THREADS_SLAB_H
+
+#include <stddef.h>
+
+/* Object constructor, see kmem_cache_create(). */
+typedef void kmem_ctor_func(void* object);
+
+struct kmem_cache* kmem_cache_create(const char* name, size_t size, size_t align,
+                                     kmem_ctor_func*);
+void* kmem_cache_alloc(struct kmem_cache*);
+void kmem_cache_free(struct kmem_cache*, void*);
+void kmem_print_stats(void);
+
+#endif /* threads/slab.h */
@@ -29,9 +29,22 @@
 #include "threads/synch.h"
 #include <stdio.h>
 #include <string.h>
+#include "devices/timer.h"
 #include "threads/interrupt.h"
+#include "threads/lock-stats.h"
 #include "threads/thread.h"
 
+/* Maximum number of times lock_acquire() checks a lock whose
+   holder runs on another CPU before blocking. */
+#define LOCK_SPIN_LIMIT 1000
+
+static void sema_down_at(struct semaphore*, void* site);
+static void sema_wake(struct semaphore*);
+static void lock_adopt_donors(struct lock*);
+static void drop_donors(struct lock*, struct rwlock*);
+static void drop_waiting_donors(struct list*);
+static bool lock_spin(struct lock*);
+
 /* Initializes semaphore SEMA to VALUE.  A semaphore is a
    nonnegative integer along with two atomic operators for
    manipulating it:
@@ -55,19 +68,31 @@ void sema_init(struct semaphore* sema, unsigned value) {
    interrupt handler.  This function may be called with
    interrupts disabled, but if it sleeps then the next scheduled
    thread will probably turn interrupts back on. */
-void sema_down(struct semaphore* sema) {
+void sema_down(struct semaphore* sema) { sema_down_at(sema, __builtin_return_address(0)); }
+
+/* Does the work of sema_down().  With -lock-stats, the wait is
+   accounted to SITE, unless SITE is a null pointer. */
+static void sema_down_at(struct semaphore* sema, void* site) {
   enum intr_level old_level;
+  bool contended;
+  int64_t start = 0;
 
   ASSERT(sema != NULL);
   ASSERT(!intr_context());
 
   old_level = intr_disable();
+  contended = sema->value == 0;
+  if (contended && site != NULL && lock_stats_enabled)
+    start = timer_ticks();
   while (sema->value == 0) {
     list_push_back(&sema->waiters, &thread_current()->elem);
     thread_block();
   }
   sema->value--;
   intr_set_level(old_level);
+
+  if (site != NULL && lock_stats_enabled)
+    lock_stats_sema(site, contended ? timer_elapsed(start) : 0, contended);
 }
 
 /* Down or "P" operation on a semaphore, but only if the
@@ -93,7 +118,8 @@ bool sema_try_down(struct semaphore* sema) {
 }
 
 /* Up or "V" operation on a semaphore.  Increments SEMA's value
-   and wakes up one thread of those waiting for SEMA, if any.
+   and wakes up the highest priority thread of those waiting for
+   SEMA, if any.
 
    This function may be called from an interrupt handler. */
 void sema_up(struct semaphore* sema) {
@@ -102,12 +128,23 @@ void sema_up(struct semaphore* sema) {
   ASSERT(sema != NULL);
 
   old_level = intr_disable();
-  if (!list_empty(&sema->waiters))
-    thread_unblock(list_entry(list_pop_front(&sema->waiters), struct thread, elem));
-  sema->value++;
+  sema_wake(sema);
   intr_set_level(old_level);
 }
 
+/* Does the work of sema_up() on SEMA, with interrupts off.  Wakes
+   the highest-priority waiter, but never yields to it. */
+static void sema_wake(struct semaphore* sema) {
+  ASSERT(intr_get_level() == INTR_OFF);
+
+  if (!list_empty(&sema->waiters)) {
+    struct list_elem* e = list_max(&sema->waiters, thread_priority_less, NULL);
+    list_remove(e);
+    thread_unblock(list_entry(e, struct thread, elem));
+  }
+  sema->value++;
+}
+
 static void sema_test_helper(void* sema_);
 
 /* Self-test for semaphores that makes control "ping-pong"
@@ -158,6 +195,7 @@ void lock_init(struct lock* lock) {
   ASSERT(lock != NULL);
 
   lock->holder = NULL;
+  lock->stats_site = NULL;
   sema_init(&lock->semaphore, 1);
 }
 
@@ -165,17 +203,142 @@ void lock_init(struct lock* lock) {
    necessary.  The lock must not already be held by the current
    thread.
 
+   While the current thread sleeps, it donates its priority to the
+   lock's holder.  On waking up it takes over the donations of the
+   threads still waiting for LOCK.
+
    This function may sleep, so it must not be called within an
    interrupt handler.  This function may be called with
    interrupts disabled, but interrupts will be turned back on if
    we need to sleep. */
 void lock_acquire(struct lock* lock) {
+  void* site = __builtin_return_address(0);
+  struct thread* cur = thread_current();
+  enum intr_level old_level;
+  int64_t start, wait;
+
   ASSERT(lock != NULL);
   ASSERT(!intr_context());
   ASSERT(!lock_held_by_current_thread(lock));
 
-  sema_down(&lock->semaphore);
-  lock->holder = thread_current();
+  /* Fast path: take a free lock without going through
+     sema_down(). */
+  old_level = intr_disable();
+  if (lock->semaphore.value > 0) {
+    lock->semaphore.value--;
+    lock->holder = cur;
+    if (lock_stats_enabled)
+      lock_stats_acquired(lock, site, 0, false);
+    intr_set_level(old_level);
+    return;
+  }
+  intr_set_level(old_level);
+
+  if (lock_spin(lock)) {
+    if (lock_stats_enabled)
+      lock_stats_acquired(lock, site, 0, true);
+    return;
+  }
+
+  start = timer_ticks();
+  old_level = intr_disable();
+  if (lock->holder != NULL && !thread_mlfqs) {
+    cur->wait_lock = lock;
+    thread_donate(cur, lock->holder);
+  }
+  sema_down_at(&lock->semaphore, NULL);
+  cur->wait_lock = NULL;
+  cur->thread_lock = NULL;
+  lock->holder = cur;
+  if (!thread_mlfqs)
+    lock_adopt_donors(lock);
+  intr_set_level(old_level);
+
+  wait = timer_elapsed(start);
+  old_level = thread_stats_begin();
+  cur->lock_wait_ticks += wait;
+  thread_stats_end(old_level);
+  if (lock_stats_enabled)
+    lock_stats_acquired(lock, site, wait, true);
+}
+
+/* Makes the threads waiting for LOCK donate their priority to its
+   new holder, the current thread.  Must be called with interrupts
+   off. */
+static void lock_adopt_donors(struct lock* lock) {
+  struct thread* cur = thread_current();
+  struct list_elem* e;
+
+  ASSERT(intr_get_level() == INTR_OFF);
+
+  for (e = list_begin(&lock->semaphore.waiters); e != list_end(&lock->semaphore.waiters);
+       e = list_next(e))
+    thread_donate(list_entry(e, struct thread, elem), cur);
+}
+
+/* Takes back the priority that the current thread received from
+   the threads waiting for LOCK, if LOCK is non-null, or for RW,
+   if RW is non-null.  Must be called with interrupts off. */
+static void drop_donors(struct lock* lock, struct rwlock* rw) {
+  ASSERT(intr_get_level() == INTR_OFF);
+
+  if (lock != NULL)
+    drop_waiting_donors(&lock->semaphore.waiters);
+  if (rw != NULL) {
+    drop_waiting_donors(&rw->read_waiters);
+    drop_waiting_donors(&rw->write_waiters);
+  }
+  thread_refresh_priority(thread_current());
+}
+
+/* Removes the threads on WAITERS that donate their priority to
+   the current thread from its donors queue.  A thread waits for
+   one lock at a time, so these are the donors that waiting on
+   WAITERS made. */
+static void drop_waiting_donors(struct list* waiters) {
+  struct thread* cur = thread_current();
+  struct list_elem* e;
+
+  for (e = list_begin(waiters); e != list_end(waiters); e = list_next(e)) {
+    struct thread* donor = list_entry(e, struct thread, elem);
+    if (donor->thread_lock == cur) {
+      pqueue_remove(&cur->donors, &donor->donorelem);
+      donor->thread_lock = NULL;
+    }
+  }
+}
+
+/* Spins for up to LOCK_SPIN_LIMIT iterations waiting for LOCK to
+   become free, as long as its holder is running on another CPU
+   and so is likely to release it soon.  Returns true if LOCK was
+   acquired, false if the caller should block instead.  On a
+   single CPU the holder can't be running, so this returns false
+   right away. */
+static bool lock_spin(struct lock* lock) {
+  struct thread* cur = thread_current();
+  enum intr_level old_level;
+  int i;
+
+  for (i = 0; i < LOCK_SPIN_LIMIT; i++) {
+    struct thread* holder;
+    bool spin;
+
+    old_level = intr_disable();
+    if (lock->semaphore.value > 0) {
+      lock->semaphore.value--;
+      lock->holder = cur;
+      intr_set_level(old_level);
+      return true;
+    }
+    holder = lock->holder;
+    spin = holder != NULL && holder->status == THREAD_RUNNING && holder->cpu != cur->cpu;
+    intr_set_level(old_level);
+
+    if (!spin)
+      return false;
+    asm volatile("pause" : : : "memory");
+  }
+  return false;
 }
 
 /* Tries to acquires LOCK and returns true if successful or false
@@ -191,8 +354,11 @@ bool lock_try_acquire(struct lock* lock) {
   ASSERT(!lock_held_by_current_thread(lock));
 
   success = sema_try_down(&lock->semaphore);
-  if (success)
+  if (success) {
     lock->holder = thread_current();
+    if (lock_stats_enabled)
+      lock_stats_acquired(lock, __builtin_return_address(0), 0, false);
+  }
   return success;
 }
 
@@ -202,11 +368,21 @@ bool lock_try_acquire(struct lock* lock) {
    make sense to try to release a lock within an interrupt
    handler. */
 void lock_release(struct lock* lock) {
+  enum intr_level old_level;
+
   ASSERT(lock != NULL);
   ASSERT(lock_held_by_current_thread(lock));
 
+  if (lock_stats_enabled)
+    lock_stats_released(lock);
+
+  old_level = intr_disable();
   lock->holder = NULL;
+  if (!thread_mlfqs)
+    drop_donors(lock, NULL);
   sema_up(&lock->semaphore);
+  intr_set_level(old_level);
+  thread_yield_if_outranked();
 }
 
 /* Returns true if the current thread holds LOCK, false
@@ -222,8 +398,11 @@ bool lock_held_by_current_thread(const struct lock* lock) {
 struct semaphore_elem {
   struct list_elem elem;      /* List element. */
   struct semaphore semaphore; /* This semaphore. */
+  struct thread* thread;      /* Thread that waits on it. */
 };
 
+static list_less_func waiter_less;
+
 /* Initializes condition variable COND.  A condition variable
    allows one piece of code to signal a condition and cooperating
    code to receive the signal and act upon it. */
@@ -262,15 +441,16 @@ void cond_wait(struct condition* cond, struct lock* lock) {
   ASSERT(lock_held_by_current_thread(lock));
 
   sema_init(&waiter.semaphore, 0);
+  waiter.thread = thread_current();
   list_push_back(&cond->waiters, &waiter.elem);
   lock_release(lock);
-  sema_down(&waiter.semaphore);
+  sema_down_at(&waiter.semaphore, NULL);
   lock_acquire(lock);
 }
 
 /* If any threads are waiting on COND (protected by LOCK), then
-   this function signals one of them to wake up from its wait.
-   LOCK must be held before calling this function.
+   this function signals the highest-priority one to wake up from
+   its wait.  LOCK must be held before calling this function.
 
    An interrupt handler cannot acquire a lock, so it does not
    make sense to try to signal a condition variable within an
@@ -281,20 +461,226 @@ void cond_signal(struct condition* cond, struct lock* lock UNUSED) {
   ASSERT(!intr_context());
   ASSERT(lock_held_by_current_thread(lock));
 
-  if (!list_empty(&cond->waiters))
-    sema_up(&list_entry(list_pop_front(&cond->waiters), struct semaphore_elem, elem)->semaphore);
+  if (!list_empty(&cond->waiters)) {
+    struct list_elem* e = list_max(&cond->waiters, waiter_less, NULL);
+    list_remove(e);
+    sema_up(&list_entry(e, struct semaphore_elem, elem)->semaphore);
+  }
 }
 
 /* Wakes up all threads, if any, waiting on COND (protected by
    LOCK).  LOCK must be held before calling this function.
 
+   The waiters are all made ready in one go, with interrupts off,
+   so that no timer tick switches threads halfway through.  None
+   of them runs before the caller releases LOCK, which each needs
+   back; lock_release() then hands the lock, and the CPU, to the
+   highest-priority one, with the only preemption check that
+   waking them takes.
+
    An interrupt handler cannot acquire a lock, so it does not
    make sense to try to signal a condition variable within an
    interrupt handler. */
 void cond_broadcast(struct condition* cond, struct lock* lock) {
+  enum intr_level old_level;
+
   ASSERT(cond != NULL);
   ASSERT(lock != NULL);
+  ASSERT(!intr_context());
+  ASSERT(lock_held_by_current_thread(lock));
 
+  old_level = intr_disable();
   while (!list_empty(&cond->waiters))
-    cond_signal(cond, lock);
+    sema_wake(&list_entry(list_pop_front(&cond->waiters), struct semaphore_elem, elem)->semaphore);
+  intr_set_level(old_level);
+}
+
+/* Returns true if the thread waiting on condition variable waiter
+   A has a lower priority than the one waiting on B. */
+static bool waiter_less(const struct list_elem* a, const struct list_elem* b,
+                        void* aux UNUSED) {
+  const struct semaphore_elem* wa = list_entry(a, struct semaphore_elem, elem);
+  const struct semaphore_elem* wb = list_entry(b, struct semaphore_elem, elem);
+
+  return wa->thread->priority < wb->thread->priority;
+}
+
+/* Initializes RW as a reader-writer lock, which any number of
+   threads may hold for reading at once, or a single thread for
+   writing.
+
+   Writers are preferred: once a writer waits, new readers wait
+   too, so a steady stream of readers can't starve writers.  A
+   thread that waits while RW is held for writing donates its
+   priority to the writer, through the writer's donors queue, for
+   as long as it waits.  Readers don't receive donations, because
+   RW doesn't keep track of which threads hold it for reading. */
+void rwlock_init(struct rwlock* rw) {
+  ASSERT(rw != NULL);
+
+  rw->writer = NULL;
+  rw->readers = 0;
+  list_init(&rw->read_waiters);
+  list_init(&rw->write_waiters);
+}
+
+/* Blocks the current thread on WAITERS, one of RW's wait lists,
+   donating its priority to RW's writer if there is one.  Must be
+   called with interrupts off. */
+static void rwlock_wait(struct rwlock* rw, struct list* waiters) {
+  struct thread* cur = thread_current();
+
+  ASSERT(intr_get_level() == INTR_OFF);
+
+  if (rw->writer != NULL && !thread_mlfqs) {
+    cur->wait_rwlock = rw;
+    thread_donate(cur, rw->writer);
+  }
+
+  list_push_back(waiters, &cur->elem);
+  thread_block();
+  cur->wait_rwlock = NULL;
+  cur->thread_lock = NULL;
+}
+
+/* Acquires RW for reading, sleeping until no thread holds or
+   waits for it for writing.  Must not be called within an
+   interrupt handler. */
+void rwlock_acquire_read(struct rwlock* rw) {
+  enum intr_level old_level;
+
+  ASSERT(rw != NULL);
+  ASSERT(!intr_context());
+  ASSERT(!rwlock_held_for_write(rw));
+
+  old_level = intr_disable();
+  while (rw->writer != NULL || !list_empty(&rw->write_waiters))
+    rwlock_wait(rw, &rw->read_waiters);
+  rw->readers++;
+  intr_set_level(old_level);
+}
+
+/* Releases RW, which the current thread holds for reading. */
+void rwlock_release_read(struct rwlock* rw) {
+  enum intr_level old_level;
+
+  ASSERT(rw != NULL);
+  ASSERT(rw->readers > 0);
+
+  old_level = intr_disable();
+  if (--rw->readers == 0 && !list_empty(&rw->write_waiters))
+    thread_unblock(list_entry(list_pop_front(&rw->write_waiters), struct thread, elem));
+  intr_set_level(old_level);
+  thread_yield_if_outranked();
+}
+
+/* Acquires RW for writing, sleeping until no other thread holds
+   it.  Must not be called within an interrupt handler. */
+void rwlock_acquire_write(struct rwlock* rw) {
+  enum intr_level old_level;
+
+  ASSERT(rw != NULL);
+  ASSERT(!intr_context());
+  ASSERT(!rwlock_held_for_write(rw));
+
+  old_level = intr_disable();
+  while (rw->writer != NULL || rw->readers > 0)
+    rwlock_wait(rw, &rw->write_waiters);
+  rw->writer = thread_current();
+  intr_set_level(old_level);
+}
+
+/* Releases RW, which the current thread holds for writing, and
+   gives up the priority donated by the threads waiting for it.
+   The next writer, if any, gets the lock; otherwise all waiting
+   readers do. */
+void rwlock_release_write(struct rwlock* rw) {
+  enum intr_level old_level;
+
+  ASSERT(rw != NULL);
+  ASSERT(rwlock_held_for_write(rw));
+
+  old_level = intr_disable();
+  rw->writer = NULL;
+  drop_donors(NULL, rw);
+
+  if (!list_empty(&rw->write_waiters))
+    thread_unblock(list_entry(list_pop_front(&rw->write_waiters), struct thread, elem));
+  else
+    while (!list_empty(&rw->read_waiters))
+      thread_unblock(list_entry(list_pop_front(&rw->read_waiters), struct thread, elem));
+  intr_set_level(old_level);
+  thread_yield_if_outranked();
+}
+
+/* Returns true if the current thread holds RW for writing. */
+bool rwlock_held_for_write(const struct rwlock* rw) {
+  ASSERT(rw != NULL);
+
+  return rw->writer == thread_current();
+}
+
+/* Initializes SL as a sequence lock, for data that is read often
+   and written rarely, such as a clock or a set of counters.
+
+   Readers take no lock and never disable interrupts.  They read
+   the data between seqlock_read_begin() and seqlock_read_retry(),
+   and read it again if a writer was active meanwhile:
+
+     do {
+       seq = seqlock_read_begin(&sl);
+       ...copy the data...
+     } while (seqlock_read_retry(&sl, seq));
+
+   so a reader must only copy the data in its loop, and must not
+   follow pointers that a writer may change.
+
+   Writers bracket each change with seqlock_write_begin() and
+   seqlock_write_end(), which make the sequence number odd while
+   the data is changing.  Writers must exclude each other, and
+   must not be interrupted by a reader on their own CPU, so they
+   run with interrupts off, as in an interrupt handler.  Writes
+   never wait for readers. */
+void seqlock_init(struct seqlock* sl) {
+  ASSERT(sl != NULL);
+
+  sl->seq = 0;
+}
+
+/* Starts a change to the data that SL protects.  Interrupts must
+   be off. */
+void seqlock_write_begin(struct seqlock* sl) {
+  ASSERT(intr_get_level() == INTR_OFF);
+  ASSERT(sl->seq % 2 == 0);
+
+  sl->seq++;
+  barrier();
+}
+
+/* Ends a change to the data that SL protects. */
+void seqlock_write_end(struct seqlock* sl) {
+  ASSERT(sl->seq % 2 == 1);
+
+  barrier();
+  sl->seq++;
+}
+
+/* Starts a read of the data that SL protects, waiting for a
+   writer on another CPU to finish, and returns the sequence
+   number to pass to seqlock_read_retry(). */
+unsigned seqlock_read_begin(const struct seqlock* sl) {
+  unsigned seq;
+
+  while ((seq = sl->seq) % 2 != 0)
+    asm volatile("pause");
+  barrier();
+  return seq;
+}
+
+/* Returns true if the data that SL protects may have changed
+   since seqlock_read_begin() returned SEQ, so that what was read
+   must be read again. */
+bool seqlock_read_retry(const struct seqlock* sl, unsigned seq) {
+  barrier();
+  return sl->seq != seq;
 }
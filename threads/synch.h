@@ -3,6 +3,7 @@
 
 #include <list.h>
 #include <stdbool.h>
+#include <stdint.h>
 
 /* A counting semaphore. */
 struct semaphore {
@@ -18,8 +19,10 @@ void sema_self_test(void);
 
 /* Lock. */
 struct lock {
-  struct thread* holder;      /* Thread holding lock (for debugging). */
-  struct semaphore semaphore; /* Binary semaphore controlling access. */
+  struct thread* holder;        /* Thread holding lock (for debugging). */
+  struct semaphore semaphore;   /* Binary semaphore controlling access. */
+  struct lock_site* stats_site; /* Site that acquired it, for -lock-stats. */
+  int64_t acquire_tick;         /* When it was acquired, for -lock-stats. */
 };
 
 void lock_init(struct lock*);
@@ -38,6 +41,32 @@ void cond_wait(struct condition*, struct lock*);
 void cond_signal(struct condition*, struct lock*);
 void cond_broadcast(struct condition*, struct lock*);
 
+/* Reader-writer lock. */
+struct rwlock {
+  struct thread* writer;     /* Thread holding it for writing, or NULL. */
+  unsigned readers;          /* Number of threads holding it for reading. */
+  struct list read_waiters;  /* Threads waiting to read. */
+  struct list write_waiters; /* Threads waiting to write. */
+};
+
+void rwlock_init(struct rwlock*);
+void rwlock_acquire_read(struct rwlock*);
+void rwlock_release_read(struct rwlock*);
+void rwlock_acquire_write(struct rwlock*);
+void rwlock_release_write(struct rwlock*);
+bool rwlock_held_for_write(const struct rwlock*);
+
+/* Sequence lock. */
+struct seqlock {
+  volatile unsigned seq; /* Odd while a writer is active. */
+};
+
+void seqlock_init(struct seqlock*);
+void seqlock_write_begin(struct seqlock*);
+void seqlock_write_end(struct seqlock*);
+unsigned seqlock_read_begin(const struct seqlock*);
+bool seqlock_read_retry(const struct seqlock*, unsigned seq);
+
 /* Optimization barrier.
 
    The compiler will not reorder operations across an
@@ -0,0 +1,60 @@
+/* Build-time report of the layout of struct thread.
+
+   This file is compiled to assembly, not linked into the kernel.
+   Each REPORT() leaves a "->NAME VALUE" marker in the assembly,
+   which Makefile.build collects into thread-layout.txt and prints:
+   the size of struct thread, the stack space it leaves in its
+   page, and the offsets of the members that every thread switch
+   touches.
+
+   The build also fails if those members do not fit in the first
+   CACHE_LINE bytes of struct thread, or if struct thread leaves
+   less than STACK_MIN bytes of stack. */
+
+#include <stddef.h>
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+
+/* Size of a cache line, in bytes. */
+#define CACHE_LINE 64
+
+/* Least stack space that struct thread must leave in its page. */
+#define STACK_MIN (PGSIZE / 2)
+
+/* Fails to compile unless COND is true. */
+#define BUILD_CHECK(NAME, COND) extern char NAME[(COND) ? 1 : -1]
+
+/* Offset of the byte just past MEMBER of struct thread.  Uses
+   the compiler's offsetof, because lib/stddef.h's is not a
+   constant expression that an array size may use. */
+#define END_OF(MEMBER)                                                                             \
+  (__builtin_offsetof(struct thread, MEMBER) + sizeof ((struct thread*)0)->MEMBER)
+
+BUILD_CHECK(hot_members_share_a_cache_line,
+            END_OF(stack) <= CACHE_LINE && END_OF(status) <= CACHE_LINE
+                && END_OF(priority) <= CACHE_LINE && END_OF(cpu) <= CACHE_LINE
+                && END_OF(elem) <= CACHE_LINE);
+BUILD_CHECK(struct_thread_leaves_enough_stack, PGSIZE - sizeof(struct thread) >= STACK_MIN);
+BUILD_CHECK(magic_is_last, END_OF(magic) == sizeof(struct thread));
+
+/* Leaves a marker for NAME with VALUE in the assembly. */
+#define REPORT(NAME, VALUE) asm volatile("\n->" NAME " %c0" : : "i"(VALUE))
+#define REPORT_MEMBER(MEMBER) REPORT(#MEMBER, offsetof(struct thread, MEMBER))
+
+void thread_layout(void);
+
+void thread_layout(void) {
+  REPORT("sizeof(struct-thread)", sizeof(struct thread));
+  REPORT("stack-bytes", PGSIZE - sizeof(struct thread));
+  REPORT_MEMBER(stack);
+  REPORT_MEMBER(status);
+  REPORT_MEMBER(priority);
+  REPORT_MEMBER(cpu);
+  REPORT_MEMBER(tid);
+  REPORT_MEMBER(elem);
+  REPORT_MEMBER(allelem);
+  REPORT_MEMBER(sleep_elem);
+  REPORT_MEMBER(donors);
+  REPORT_MEMBER(pmu_active);
+  REPORT_MEMBER(magic);
+}
@@ -1,19 +1,29 @@
 #include "threads/thread.h"
 #include <debug.h>
+#include <div64.h>
 #include <stddef.h>
 #include <random.h>
+#include <round.h>
 #include <stdio.h>
 #include <string.h>
 #include "devices/timer.h"
-#include "lib/fp_arithmetic.h"
+#include "threads/cpu.h"
 #include "threads/flags.h"
+#include "threads/fpu.h"
 #include "threads/interrupt.h"
 #include "threads/intr-stubs.h"
+#include "threads/kstat.h"
 #include "threads/malloc.h"
 #include "threads/palloc.h"
+#include "threads/percpu.h"
+#include "threads/pmu.h"
+#include "threads/rcu.h"
+#include "threads/sched-trace.h"
+#include "threads/slab.h"
 #include "threads/switch.h"
 #include "threads/synch.h"
 #include "threads/vaddr.h"
+#include "threads/vdso.h"
 #ifdef USERPROG
 #include "userprog/process.h"
 #endif
@@ -23,16 +33,39 @@
    of thread.h for details. */
 #define THREAD_MAGIC 0xcd6abf4b
 
-/* List of processes in THREAD_READY state, that is, processes
-   that are ready to run but not actually running. */
-static struct list ready_list;
+/* Pattern that thread_create() fills a new thread's stack with,
+   so that we can tell how deep the stack has ever grown.  See
+   the big comment at the top of thread.h. */
+#define STACK_CANARY 0x5ca1ab1e
+
+/* Deepest any thread's stack has grown, in bytes, and the name of
+   that thread. */
+static size_t stack_max_depth;
+static char stack_max_name[16];
+
+/* Processes in THREAD_READY state, that is, processes that are
+   ready to run but not actually running, are kept in the run
+   queue of a CPU, one list per priority plus an occupancy bitmap
+   (see cpu.h).  Both the priority scheduler and the MLFQS use the
+   same run queues. */
 
 /* List of all processes.  Processes are added to this list
    when they are first scheduled and removed when they exit. */
 static struct list all_list;
 
-/* Idle thread. */
-static struct thread* idle_thread;
+/* Cache for struct child_process. */
+struct kmem_cache* child_process_cache;
+
+static tid_t create(const char* name, int priority, thread_func*, void* aux, bool sibling);
+static struct thread* prepare_thread(const char* name, int priority, thread_func*, void* aux,
+                                     bool sibling, tid_t);
+static void start_threads(struct list* batch, bool sibling);
+static unsigned child_hash(const struct hash_elem*, void* aux);
+static void read_rusage(struct thread*, struct rusage*);
+static bool child_less(const struct hash_elem*, const struct hash_elem*, void* aux);
+static bool children_init(struct thread*);
+static void child_release(struct child_process*);
+static void child_forget(struct hash_elem*, void* aux);
 
 /* Initial thread, the thread running init.c:main(). */
 static struct thread* initial_thread;
@@ -47,20 +80,74 @@ struct kernel_thread_frame {
   void* aux;             /* Auxiliary data for function. */
 };
 
-/* Statistics. */
-static long long idle_ticks;   /* # of timer ticks spent idle. */
-static long long kernel_ticks; /* # of timer ticks in kernel threads. */
-static long long user_ticks;   /* # of timer ticks in user programs. */
+/* Statistics.  stats_seq protects each thread's CPU and memory
+   accounting, so that thread_get_rusage() reads them without
+   turning interrupts off.  Every CPU counts ticks, so the totals
+   are per-CPU counters. */
+static struct seqlock stats_seq;
+static struct percpu_counter idle_ticks;   /* # of timer ticks spent idle. */
+static struct percpu_counter kernel_ticks; /* # of timer ticks in kernel threads. */
+static struct percpu_counter user_ticks;   /* # of timer ticks in user programs. */
+static long long steals;       /* # of threads stolen by an idle CPU. */
+static long long migrations;   /* # of threads moved by rebalancing. */
+static long long wakeup_moves; /* # of threads woken onto another CPU. */
+static long long stack_hits;   /* # of thread pages reused from the cache. */
+static long long stack_misses; /* # of thread pages obtained from palloc. */
+
+/* Pages of dead threads, kept for reuse by thread_create() so
+   that it doesn't need to take the page allocator's lock and
+   zero a whole page for every thread.  Only the struct thread at
+   the bottom of a page needs to be cleared, which init_thread()
+   does.  Accessed with interrupts off. */
+#define STACK_CACHE_SIZE 8
+static struct thread* stack_cache[STACK_CACHE_SIZE];
+static size_t stack_cache_cnt;
 
 /* Scheduling. */
-#define TIME_SLICE 4          /* # of timer ticks to give each thread. */
-static unsigned thread_ticks; /* # of timer ticks since last yield. */
+unsigned thread_time_slice = 4; /* # of timer ticks to give each thread. */
+static unsigned thread_ticks;   /* # of timer ticks since last yield. */
+
+/* Deadline class.  DL_UTIL_MAX caps the sum of runtime/period of
+   the threads in it, in thousandths of a CPU, so that the
+   priority classes always get some time. */
+#define DL_UTIL_MAX 950
+static struct list dl_list;   /* Threads in the deadline class. */
+static int dl_util;           /* Their utilization, in thousandths. */
+static unsigned dl_throttles; /* Times one used up its budget. */
 
 /* If false (default), use round-robin scheduler.
    If true, use multi-level feedback queue scheduler.
    Controlled by kernel command-line option "-o mlfqs". */
 bool thread_mlfqs;
 
+/* If false (default), MLFQS statistics are recomputed by work that
+   thread_tick() defers to the end of the timer interrupt, with
+   interrupts on.  If true, they are recomputed directly in
+   thread_tick().
+   Controlled by kernel command-line option "-mlfqs-tick". */
+bool thread_mlfqs_tick;
+
+/* Load balancing between the CPUs' run queues.  A CPU whose run
+   queue is empty steals a thread from the busiest one instead of
+   switching to its idle thread.  In addition, every
+   thread_balance_interval ticks, a CPU pulls one thread from the
+   busiest run queue if that has at least thread_balance_imbalance
+   more queued threads than its own; an interval of 0 turns this
+   periodic rebalancing off.  The interval is controlled by kernel
+   command-line option "-balance=TICKS".
+
+   A thread runs only on the CPUs in its cpu_mask, which it
+   inherits from the thread that created it.  thread_unblock()
+   puts a woken thread back on the CPU it last ran on, whose
+   caches may still hold its working set, unless that CPU is not
+   allowed or has thread_balance_imbalance more queued threads
+   than the least loaded allowed one, which it goes to instead. */
+unsigned thread_balance_interval = 20;
+unsigned thread_balance_imbalance = 2;
+
+/* Resource limits of the initial thread.  See thread.h. */
+unsigned thread_rlimits[RLIMIT_CNT] = {RLIM_INFINITY, RLIM_INFINITY, RLIM_INFINITY};
+
 static void kernel_thread(thread_func*, void* aux);
 
 static void idle(void* aux UNUSED);
@@ -71,7 +158,13 @@ static bool is_thread(struct thread*) UNUSED;
 static void* alloc_frame(struct thread*, size_t size);
 static void schedule(void);
 void thread_schedule_tail(struct thread* prev);
-static tid_t allocate_tid(void);
+static tid_t allocate_tids(int cnt);
+static struct thread* alloc_thread_page(void);
+static void free_thread_page(struct thread*);
+static void free_dead_thread(struct rcu_head*);
+static void stack_fill(struct thread*);
+static void stack_check(struct thread*);
+static void stack_record(struct thread*);
 
 /* Custom Prototypes and Variables */
 
@@ -81,14 +174,37 @@ static tid_t allocate_tid(void);
 /* Multiply by this factor when returning load_avg and recent_cpu */
 int MULTIPLICATION_FACTOR;
 
-/* MLFQ Scheduler Queues */
-static struct list mlfqs_lists[PRI_MAX + 1];
+/* Threads whose recent_cpu changed since their MLFQS priority was last
+  computed. Only these are visited by thread_update_priorities() */
+static struct list mlfqs_stale_list;
+
+/* Returns true for the threads the kernel runs to drive the scheduler
+  itself, which are left out of the MLFQS load and priority math */
+static bool thread_is_internal(struct thread* t);
 
-/* Create a new thread whose only job is to schedule */
-struct thread* mlfqs_thread;
+/* Add T to mlfqs_stale_list, unless it's already there */
+static void thread_mark_stale(struct thread* t);
 
-/* The mlfqs_scheduler that is assigned to the mlfqs_thread */
-void mlfqs_scheduler(void* arg UNUSED);
+/* Returns true if T is the idle thread of its CPU */
+static bool thread_is_idle(struct thread* t);
+
+/* Queue T at the back of its CPU's ready list for its current priority.
+  Also counts T in the CPU's ready_threads_cnt, unless it is internal, so
+  that load_avg doesn't need to scan all_list */
+static void ready_push(struct thread* t);
+
+/* Take T off the ready list of its CPU it is queued on */
+static void ready_remove(struct thread* t);
+
+/* Change the priority of T, moving it to the matching ready list if it is queued */
+static void thread_requeue(struct thread* t, int priority);
+
+/* Run whichever MLFQS updates thread_tick() asked for */
+static void mlfqs_update(void);
+
+/* Deferred work that runs mlfqs_update() */
+static intr_work_func mlfqs_deferred;
+static struct intr_work mlfqs_work;
 
 /* Update the priorities of a single thread, using the MLFQS equations */
 void thread_update_priority(struct thread* t);
@@ -103,12 +219,43 @@ void thread_update_recent_cpu(void);
 /* Update global load_avg using the formula mentioned in the documentation */
 void thread_update_load_avg(void);
 
-/* Get the highest priority level present in the MLFQ Scheduling lists */
-int thread_mlfqs_get_highest_priority(void);
+/* Get the highest priority level present in the ready lists */
+int thread_get_highest_ready_priority(void);
+
+/* Get the highest priority level present in the ready lists of CPU */
+static int cpu_get_highest_ready_priority(struct cpu* cpu);
 
-/* For priority scheduling - Compare priorities of 2 threads */
-static bool thread_compare_priorities(const struct list_elem* a, const struct list_elem* b,
-                                      void* aux UNUSED);
+/* Returns the started CPU other than SELF with the most queued threads,
+  or NULL if no other CPU has any */
+static struct cpu* busiest_cpu(struct cpu* self);
+
+/* Moves the thread at the front of the highest non-empty priority level
+  of FROM's run queue to TO and returns it, without queuing it on TO */
+static struct thread* steal_thread(struct cpu* from, struct cpu* to);
+
+/* Periodic rebalancing, called from thread_tick() */
+static void thread_balance(void);
+
+/* Returns true if T may be queued on CPU C */
+static bool cpu_allowed(const struct thread* t, const struct cpu* c);
+
+/* Chooses the CPU whose run queue a woken thread T goes on */
+static struct cpu* wakeup_cpu(struct thread* t);
+static ipi_func remote_wakeup;
+
+/* Returns the thread that CPU would run next from its own run queue,
+  or NULL if it has none */
+static struct thread* highest_ready(struct cpu* cpu);
+
+/* Returns true if a thread on the running thread's run queue should run
+  before it */
+static bool thread_outranked(void);
+
+/* Deadline class helpers */
+static bool dl_runnable(const struct thread* t);
+static int dl_util_of(const struct thread* t);
+static bool dl_earlier(const struct list_elem* a, const struct list_elem* b, void* aux);
+static void dl_replenish(int64_t now);
 
 /* Initializes the threading system by transforming the code
    that's currently running into a thread.  This can't work in
@@ -126,21 +273,27 @@ static bool thread_compare_priorities(const struct list_elem* a, const struct li
 void thread_init(void) {
   ASSERT(intr_get_level() == INTR_OFF);
 
+  cpu_init();
   lock_init(&tid_lock);
-  list_init(&ready_list);
   list_init(&all_list);
-
-  /* Initialize the global filesystem lock. We use it when doing filesys operations */
-  lock_init(&global_filesystem_lock);
-
-  if (thread_mlfqs) {
-    int i;
-    for (i = PRI_MIN; i <= PRI_MAX; i++)
-      list_init(&mlfqs_lists[i]);
-  }
+  list_init(&dl_list);
+  rcu_init();
+  child_process_cache = kmem_cache_create("child_process", sizeof(struct child_process),
+                                          __alignof__(struct child_process), NULL);
+
+  list_init(&mlfqs_stale_list);
+  seqlock_init(&stats_seq);
+  kstat_percpu("thread.idle_ticks", &idle_ticks);
+  kstat_percpu("thread.kernel_ticks", &kernel_ticks);
+  kstat_percpu("thread.user_ticks", &user_ticks);
+  kstat_counter("sched.steals", &steals);
+  kstat_counter("sched.migrations", &migrations);
+  kstat_counter("sched.wakeup_moves", &wakeup_moves);
+  kstat_counter("thread.stack_hits", &stack_hits);
+  kstat_counter("thread.stack_misses", &stack_misses);
 
   /* Set the value of load_avg to be 0 at boot */
-  load_avg = 0;
+  load_avg = fp_int(0);
 
   /* Initialize updates to false */
   is_recent_cpu_update = false;
@@ -151,7 +304,10 @@ void thread_init(void) {
   initial_thread = running_thread();
   init_thread(initial_thread, "main", PRI_DEFAULT);
   initial_thread->status = THREAD_RUNNING;
-  initial_thread->tid = allocate_tid();
+  initial_thread->tid = allocate_tids(1);
+  rcu_list_push_back(&all_list, &initial_thread->allelem);
+  memcpy(initial_thread->rlimits, thread_rlimits, sizeof initial_thread->rlimits);
+  cpu_bsp()->running = initial_thread;
 }
 
 /* Starts preemptive thread scheduling by enabling interrupts.
@@ -160,13 +316,10 @@ void thread_start(void) {
   /* Create the idle thread. */
   struct semaphore idle_started;
   sema_init(&idle_started, 0);
+  if (!children_init(initial_thread))
+    PANIC("thread_start: out of memory");
   thread_create("idle", PRI_MIN, idle, &idle_started);
-  /*
-    Create a new thread, whose only job is to wake up every 4 ticks,
-    recalculate MLFQ priorities and fix them. Assign this thread to the
-    `mlfqs_scheduler` function and give it max priority (PRI_MAX)
-   */
-  thread_create("mlfqs_thread", PRI_MAX, mlfqs_scheduler, NULL);
+  intr_work_init(&mlfqs_work, mlfqs_deferred, NULL);
 
   /* Start preemptive thread scheduling. */
   intr_enable();
@@ -179,41 +332,92 @@ void thread_start(void) {
    Thus, this function runs in an external interrupt context. */
 void thread_tick(void) {
   struct thread* t = thread_current();
-  t->recent_cpu = INT_ADD(t->recent_cpu, 1);
+  t->recent_cpu = fp_add_int(t->recent_cpu, 1);
+  if (thread_mlfqs && !thread_is_internal(t))
+    thread_mark_stale(t);
 
   /* Update statistics. */
-  if (t == idle_thread)
-    idle_ticks++;
+  seqlock_write_begin(&stats_seq);
+  if (thread_is_idle(t))
+    percpu_inc(&idle_ticks);
 #ifdef USERPROG
-  else if (t->pagedir != NULL)
-    user_ticks++;
+  else if (t->pagedir != NULL) {
+    percpu_inc(&user_ticks);
+    t->user_ticks++;
+  }
 #endif
-  else
-    kernel_ticks++;
+  else {
+    percpu_inc(&kernel_ticks);
+    t->kernel_ticks++;
+  }
+  seqlock_write_end(&stats_seq);
+
+  /* Charge a deadline thread for the tick, and throttle it until
+     its next period once its budget is gone. */
+  if (dl_runnable(t) && --t->dl_budget == 0) {
+    dl_throttles++;
+    intr_yield_on_return();
+  }
 
   int64_t ticks = timer_ticks();
 
-  if (ticks % TIMER_FREQ == 0)
+  if (!list_empty(&dl_list))
+    dl_replenish(ticks);
+
+  if (thread_balance_interval != 0 && mod_u64(ticks, thread_balance_interval) == 0)
+    thread_balance();
+
+  if (mod_u64(ticks, TIMER_FREQ) == 0)
     is_recent_cpu_update = true;
 
   /* Enforce preemption. */
-  if (++thread_ticks >= TIME_SLICE) {
+  if (++thread_ticks >= thread_time_slice) {
     is_mlfqs_priority_update = true;
     intr_yield_on_return();
   }
 
-  if (thread_mlfqs && (is_mlfqs_priority_update || is_recent_cpu_update) &&
-      mlfqs_thread->status == THREAD_BLOCKED) {
-    // printf("Update CPU: %d | Priority Update: %d | ticks: %ld\n", is_recent_cpu_update, is_mlfqs_priority_update, ticks);
-    thread_unblock(mlfqs_thread);
-    intr_yield_on_return();
-  }
+  if (!thread_mlfqs || !(is_mlfqs_priority_update || is_recent_cpu_update))
+    return;
+
+  /*
+    In tick mode the updates are done right here, with the state exactly as
+    of this tick. The work is one O(1) load_avg update and a recent_cpu pass
+    once a second, plus one priority recompute per stale thread per time slice.
+    We are about to yield at the end of the slice anyway, so no extra switch
+    is needed to pick up the new priorities
+   */
+  if (thread_mlfqs_tick)
+    mlfqs_update();
+  else
+    intr_defer(&mlfqs_work);
 }
 
 /* Prints thread statistics. */
 void thread_print_stats(void) {
-  printf("Thread: %lld idle ticks, %lld kernel ticks, %lld user ticks\n", idle_ticks, kernel_ticks,
-         user_ticks);
+  printf("Thread: %lld idle ticks, %lld kernel ticks, %lld user ticks\n", percpu_read(&idle_ticks),
+         percpu_read(&kernel_ticks), percpu_read(&user_ticks));
+  printf("Scheduler: %lld steals, %lld migrations, %lld wakeup moves\n", steals, migrations,
+         wakeup_moves);
+  printf("Deadline class: %u throttles\n", dl_throttles);
+  printf("Thread stacks: %lld cache hits, %lld misses\n", stack_hits, stack_misses);
+
+  /* CPU accounting of every thread that is still alive. */
+  struct list_elem* e;
+  enum intr_level old_level = intr_disable();
+
+  for (e = list_begin(&all_list); e != list_end(&all_list); e = list_next(e)) {
+    struct thread* t = list_entry(e, struct thread, allelem);
+    stack_record(t);
+    printf("Thread %d (%s): %lld user ticks, %lld kernel ticks, %lld lock wait ticks, "
+           "%u voluntary and %u involuntary switches\n",
+           t->tid, t->name, t->user_ticks, t->kernel_ticks, t->lock_wait_ticks,
+           t->voluntary_switches, t->involuntary_switches);
+  }
+  if (stack_max_depth > 0)
+    printf("Thread stacks: deepest %zu of %zu bytes, in %s\n", stack_max_depth,
+           PGSIZE - sizeof(struct thread), stack_max_name);
+  intr_set_level(old_level);
+  rcu_print_stats();
 }
 
 /* Creates a new kernel thread named NAME with the given initial
@@ -232,36 +436,131 @@ void thread_print_stats(void) {
    PRIORITY, but no actual priority scheduling is implemented.
    Priority scheduling is the goal of Problem 1-3. */
 tid_t thread_create(const char* name, int priority, thread_func* function, void* aux) {
+  return create(name, priority, function, aux, false);
+}
+
+/* Like thread_create(), but the new thread belongs to the running
+   thread's process instead of starting a process of its own: it
+   shares the process's state, which the process's main thread
+   holds, and its record goes in the main thread's table of
+   threads, for thread_join(), instead of its table of
+   children. */
+tid_t thread_create_sibling(const char* name, int priority, thread_func* function, void* aux) {
+  return create(name, priority, function, aux, true);
+}
+
+/* Creates up to CNT new kernel threads named NAME with the given
+   initial PRIORITY, thread i executing FUNCTION passing AUX[i] as
+   the argument, and stores their identifiers in TIDS.  Returns the
+   number of threads created, which is less than CNT only if
+   memory ran out, in which case the first that many succeeded.
+
+   Does the same as CNT calls to thread_create(), but cheaper for
+   bursts of workers: the threads get consecutive identifiers
+   from one trip through tid_lock, and all of them go on the list
+   of all threads and the run queue in a single critical
+   section. */
+int thread_create_batch(const char* name, int priority, thread_func* function, void* aux[],
+                        tid_t tids[], int cnt) {
+  struct list batch;
+  tid_t tid;
+  int i;
+
+  ASSERT(function != NULL);
+  ASSERT(cnt >= 0);
+
+  list_init(&batch);
+  tid = allocate_tids(cnt);
+  for (i = 0; i < cnt; i++) {
+    struct thread* t = prepare_thread(name, priority, function, aux[i], false, tid + i);
+    if (t == NULL)
+      break;
+    list_push_back(&batch, &t->elem);
+    tids[i] = tid + i;
+  }
+  start_threads(&batch, false);
+  return i;
+}
+
+/* Does the work of thread_create() and, if SIBLING is true, of
+   thread_create_sibling(). */
+static tid_t create(const char* name, int priority, thread_func* function, void* aux,
+                    bool sibling) {
+  struct list batch;
+  struct thread* t;
+  tid_t tid;
+
+  ASSERT(function != NULL);
+
+  tid = allocate_tids(1);
+  t = prepare_thread(name, priority, function, aux, sibling, tid);
+  if (t == NULL)
+    return TID_ERROR;
+
+  list_init(&batch);
+  list_push_back(&batch, &t->elem);
+  start_threads(&batch, sibling);
+  return tid;
+}
+
+/* Allocates and initializes a new thread with identifier TID,
+   ready for its first run, but doesn't make it visible to the
+   rest of the kernel yet: start_threads() does that.  Returns the
+   thread, or a null pointer if memory runs out.  SIBLING is as
+   for create(). */
+static struct thread* prepare_thread(const char* name, int priority, thread_func* function,
+                                     void* aux, bool sibling, tid_t tid) {
+  struct thread* process = running_thread()->process;
+  struct hash* table = sibling ? &process->threads : &process->process_children;
   struct thread* t;
   struct kernel_thread_frame* kf;
   struct switch_entry_frame* ef;
   struct switch_threads_frame* sf;
-  tid_t tid;
+  struct child_process* c;
   enum intr_level old_level;
 
-  ASSERT(function != NULL);
+  /* The table of threads is only needed once a process has more
+     than one. */
+  if (sibling && table->buckets == NULL && !hash_init(table, child_hash, child_less, NULL))
+    return NULL;
 
   /* Allocate thread. */
-  t = palloc_get_page(PAL_ZERO);
+  t = alloc_thread_page();
   if (t == NULL)
-    return TID_ERROR;
+    return NULL;
+
+  /* Userprog Part 1 */
+  c = kmem_cache_alloc(child_process_cache);
+  if (c == NULL)
+    goto fail;
 
   /* Initialize thread. */
   init_thread(t, name, priority);
-  tid = t->tid = allocate_tid();
+  if (!children_init(t)) {
+    kmem_cache_free(child_process_cache, c);
+    goto fail;
+  }
+  t->tid = tid;
+  stack_fill(t);
+  if (sibling) {
+    t->process = process;
+#ifdef USERPROG
+    t->pagedir = process->pagedir;
+#endif
+  }
 
-  /* Userprog Part 1 */
-  struct child_process* c = malloc(sizeof(*c));
   c->tid = tid;
+  c->joinable = sibling;
   c->exit_status = t->exit_status;
-  c->did_execute = false;
-  list_push_back(&running_thread()->process_children, &c->elem);
+  c->reported = false;
+  c->waited = false;
+  sema_init(&c->exited, 0);
+  c->ref_cnt = 2;
+  t->child_record = c;
   /* Userprog Part 1 */
 
-  /* Prepare thread for first run by initializing its stack.
-     Do this atomically so intermediate values for the 'stack'
-     member cannot be observed. */
-  old_level = intr_disable();
+  /* Prepare thread for first run by initializing its stack.  No
+     other thread can see T yet, so this needs no locking. */
 
   /* Stack frame for kernel_thread(). */
   kf = alloc_frame(t, sizeof *kf);
@@ -278,19 +577,39 @@ tid_t thread_create(const char* name, int priority, thread_func* function, void*
   sf->eip = switch_entry;
   sf->ebp = 0;
 
+  return t;
+
+fail:
+  old_level = intr_disable();
+  free_thread_page(t);
   intr_set_level(old_level);
+  return NULL;
+}
 
-  /* Add to run queue. */
-  thread_unblock(t);
+/* Starts the threads in BATCH, which prepare_thread() prepared,
+   in one critical section: records each one in the running
+   process's table of children, or of threads if SIBLING is true,
+   puts it on the list of all threads, and makes it ready to run.
+   Then yields if one of them has a higher priority than the
+   running thread. */
+static void start_threads(struct list* batch, bool sibling) {
+  struct thread* process = running_thread()->process;
+  struct hash* table = sibling ? &process->threads : &process->process_children;
+  enum intr_level old_level;
 
   old_level = intr_disable();
-
-  if (t->priority > thread_current()->priority && (t != idle_thread))
+  while (!list_empty(batch)) {
+    struct thread* t = list_entry(list_pop_front(batch), struct thread, elem);
+
+    ASSERT(t->status == THREAD_BLOCKED);
+    hash_insert(table, &t->child_record->elem);
+    rcu_list_push_back(&all_list, &t->allelem);
+    ready_push(t);
+    t->status = THREAD_READY;
+  }
+  if (thread_outranked())
     thread_yield();
-
   intr_set_level(old_level);
-
-  return tid;
 }
 
 /* Puts the current thread to sleep.  It will not be scheduled
@@ -326,15 +645,19 @@ void thread_unblock(struct thread* t) {
 
   ASSERT(t->status == THREAD_BLOCKED);
 
-  if (!thread_mlfqs)
-    list_insert_ordered(&ready_list, &t->elem, thread_compare_priorities, NULL);
-  else
-    list_push_back(&mlfqs_lists[t->priority], &t->mlfqselem);
-
+  t->cpu = wakeup_cpu(t);
   t->status = THREAD_READY;
+  if (t->cpu != cpu_current())
+    ipi_call(t->cpu, &t->wakeup_msg, remote_wakeup, t);
+  else
+    ready_push(t);
   intr_set_level(old_level);
 }
 
+/* Queues T, which another CPU woke, on this CPU's run queue.
+   Called through an inter-processor interrupt. */
+static void remote_wakeup(void* t) { ready_push(t); }
+
 /* Returns the name of the running thread. */
 const char* thread_name(void) { return thread_current()->name; }
 
@@ -367,17 +690,47 @@ void thread_exit(void) {
   process_exit();
 #endif
 
+  fpu_exit();
+
   /* Userprog Part 1 */
-  while (!list_empty(&thread_current()->process_children)) {
-    list_pop_front(&thread_current()->process_children);
+  /* Report our exit status, then let go of our own record and of
+     our children's. */
+  struct child_process* c = thread_current()->child_record;
+  if (c != NULL) {
+    enum intr_level old_level;
+
+    c->exit_status = thread_current()->exit_status;
+
+    /* The parent is alive as long as it holds its reference,
+       which it drops with interrupts off. */
+    old_level = intr_disable();
+    if (c->ref_cnt == 2 && !c->joinable) {
+      list_push_back(&thread_current()->parent->exited_children, &c->exited_elem);
+      c->reported = true;
+      sema_up(&thread_current()->parent->child_exited);
+    }
+    intr_set_level(old_level);
+
+    sema_up(&c->exited);
+    child_release(c);
   }
+  hash_destroy(&thread_current()->process_children, child_forget);
+  if (thread_current()->threads.buckets != NULL)
+    hash_destroy(&thread_current()->threads, child_forget);
   /* Userprog Part 1 */
 
   /* Remove thread from all threads list, set our status to dying,
      and schedule another process.  That process will destroy us
      when it calls thread_schedule_tail(). */
+  ASSERT(thread_current()->rcu_state == 0);
   intr_disable();
-  list_remove(&thread_current()->allelem);
+  if (thread_current()->dl_period != 0) {
+    list_remove(&thread_current()->dlelem);
+    dl_util -= dl_util_of(thread_current());
+  }
+  rcu_list_remove(&thread_current()->allelem);
+  if (thread_current()->mlfqs_stale)
+    list_remove(&thread_current()->mlfqselem);
   thread_current()->status = THREAD_DYING;
   schedule();
   NOT_REACHED();
@@ -392,49 +745,240 @@ void thread_yield(void) {
   ASSERT(!intr_context());
 
   old_level = intr_disable();
-  if (cur != idle_thread) {
-    if (!thread_mlfqs)
-      list_insert_ordered(&ready_list, &cur->elem, thread_compare_priorities, NULL);
-    else
-      list_push_back(&mlfqs_lists[cur->priority], &cur->mlfqselem);
-  }
+  if (!thread_is_idle(cur))
+    ready_push(cur);
   cur->status = THREAD_READY;
   schedule();
   intr_set_level(old_level);
 }
 
+/* Yields the CPU like thread_yield(), but counts the switch as
+   involuntary.  Called by the interrupt handler on behalf of
+   intr_yield_on_return(). */
+void thread_preempt(void) {
+  struct thread* cur = thread_current();
+
+  cur->preempted = true;
+  thread_yield();
+  cur->preempted = false;
+}
+
 /* Invoke function 'func' on all threads, passing along 'aux'.
-   This function must be called with interrupts off. */
+   Walks all_list in an RCU read-side section, so interrupts may
+   be on, and FUNC may even sleep, but it may see a thread that is
+   exiting or miss one that is being created. */
 void thread_foreach(thread_action_func* func, void* aux) {
   struct list_elem* e;
 
-  ASSERT(intr_get_level() == INTR_OFF);
-
+  rcu_read_lock();
   for (e = list_begin(&all_list); e != list_end(&all_list); e = list_next(e)) {
     struct thread* t = list_entry(e, struct thread, allelem);
     func(t, aux);
   }
+  rcu_read_unlock();
 }
 
-/* Sets the current thread's priority to NEW_PRIORITY. */
+/* Sets the current thread's priority to NEW_PRIORITY.  The
+   thread keeps running at a higher donated priority, if any. */
 void thread_set_priority(int new_priority) {
   struct thread* curr = thread_current();
 
   enum intr_level old_level = intr_disable();
 
   curr->orig_priority = CLAMP(new_priority, PRI_MIN, PRI_MAX);
+  thread_refresh_priority(curr);
+
+  if (thread_outranked())
+    thread_yield();
+
+  intr_set_level(old_level);
+}
+
+/* Orders threads in a donors queue, highest priority first. */
+static bool donor_higher_priority(const struct pqueue_elem* a_, const struct pqueue_elem* b_,
+                                  void* aux UNUSED) {
+  const struct thread* a = pqueue_entry(a_, struct thread, donorelem);
+  const struct thread* b = pqueue_entry(b_, struct thread, donorelem);
 
-  if (list_empty(&curr->donors_list) || new_priority > curr->priority) {
-    curr->priority = new_priority;
+  return a->priority > b->priority;
+}
+
+/* Returns true if the thread of list element A, linked through
+   its `elem' member, has a lower priority than that of B. */
+bool thread_priority_less(const struct list_elem* a_, const struct list_elem* b_,
+                          void* aux UNUSED) {
+  const struct thread* a = list_entry(a_, struct thread, elem);
+  const struct thread* b = list_entry(b_, struct thread, elem);
+
+  return a->priority < b->priority;
+}
+
+/* Makes DONOR, which is about to wait for a lock that DONEE
+   holds, donate its priority to DONEE for as long as it waits.
+   Must be called with interrupts off. */
+void thread_donate(struct thread* donor, struct thread* donee) {
+  ASSERT(intr_get_level() == INTR_OFF);
+
+  donor->thread_lock = donee;
+  pqueue_push(&donee->donors, &donor->donorelem);
+  thread_refresh_priority(donee);
+}
+
+/* Recomputes T's priority as the higher of its own priority and
+   that of the front of its donors queue, and passes the change on
+   along the chain of threads that T and its holders wait for.
+   Each step costs no more than moving one thread within the next
+   donors queue, and the walk stops at the first thread whose
+   priority is unchanged.  Must be called with interrupts off. */
+void thread_refresh_priority(struct thread* t) {
+  ASSERT(intr_get_level() == INTR_OFF);
+
+  while (t != NULL) {
+    int priority = t->orig_priority;
+    bool raised;
+
+    if (!pqueue_empty(&t->donors)) {
+      struct thread* top = pqueue_entry(pqueue_front(&t->donors), struct thread, donorelem);
+      if (top->priority > priority)
+        priority = top->priority;
+    }
+
+    if (priority == t->priority)
+      break;
+    raised = priority > t->priority;
+    thread_requeue(t, priority);
+
+    /* T's place among the donors of the thread it waits for
+       depends on its priority. */
+    if (t->thread_lock != NULL) {
+      if (raised)
+        pqueue_promote(&t->thread_lock->donors, &t->donorelem);
+      else {
+        pqueue_remove(&t->thread_lock->donors, &t->donorelem);
+        pqueue_push(&t->thread_lock->donors, &t->donorelem);
+      }
+    }
+    t = t->thread_lock;
   }
+}
 
-  if (!list_empty(&ready_list)) {
-    struct thread* front = list_entry(list_front(&ready_list), struct thread, elem);
-    if (front->priority > thread_current()->priority)
-      thread_yield();
+/* Yields the CPU if a ready thread has a higher priority than the
+   running thread.  Must not be called within an interrupt
+   handler. */
+void thread_yield_if_outranked(void) {
+  enum intr_level old_level = intr_disable();
+
+  if (thread_outranked())
+    thread_yield();
+  intr_set_level(old_level);
+}
+
+/* Returns true if T, which is ready, should run before the
+   running thread.  A thread in the deadline class with budget
+   left comes before every other thread, and before another such
+   thread with a later deadline; a throttled one comes before
+   none.  Otherwise, the higher priority comes first. */
+bool thread_preempts(const struct thread* t) {
+  struct thread* cur = running_thread();
+
+  if (t->dl_period != 0)
+    return dl_runnable(t) && (!dl_runnable(cur) || t->dl_abs_deadline < cur->dl_abs_deadline);
+  return !dl_runnable(cur) && t->priority > cur->priority;
+}
+
+/* Puts the running thread in the deadline class, in which it is
+   guaranteed RUNTIME timer ticks of CPU time in every PERIOD
+   ticks, within DEADLINE ticks of the period's start.  The first
+   period starts now.  Threads in the class run earliest deadline
+   first, ahead of all priorities, and are throttled until their
+   next period once they have used up RUNTIME ticks, so that they
+   cannot starve the rest of the system.
+
+   Admission control keeps the sum of RUNTIME / PERIOD over the
+   class within DL_UTIL_MAX, which is what lets every thread in
+   it meet its deadlines.  Returns false, changing nothing, if the
+   running thread would not fit, or unless 0 < RUNTIME <= DEADLINE
+   <= PERIOD.  A RUNTIME of 0 takes the running thread out of the
+   class. */
+bool thread_set_deadline(int runtime, int deadline, int period) {
+  struct thread* cur = thread_current();
+  enum intr_level old_level;
+  int util = 0;
+
+  if (runtime != 0) {
+    if (runtime < 0 || deadline < runtime || period < deadline)
+      return false;
+    util = DIV_ROUND_UP((long long)runtime * 1000, period);
+  }
+
+  old_level = intr_disable();
+  if (dl_util - dl_util_of(cur) + util > DL_UTIL_MAX) {
+    intr_set_level(old_level);
+    return false;
+  }
+  if (cur->dl_period != 0) {
+    list_remove(&cur->dlelem);
+    dl_util -= dl_util_of(cur);
+  }
+  cur->dl_runtime = runtime;
+  cur->dl_deadline = deadline;
+  cur->dl_period = runtime != 0 ? period : 0;
+  if (runtime != 0) {
+    int64_t now = timer_ticks();
+
+    list_push_back(&dl_list, &cur->dlelem);
+    dl_util += util;
+    cur->dl_budget = runtime;
+    cur->dl_abs_deadline = now + deadline;
+    cur->dl_next_period = now + period;
   }
+  intr_set_level(old_level);
+
+  thread_yield_if_outranked();
+  return true;
+}
+
+/* Gives up the rest of the running thread's budget for this
+   period, if it is in the deadline class, so that it next runs
+   when its next period starts, and yields. */
+void thread_yield_period(void) {
+  struct thread* cur = thread_current();
+  enum intr_level old_level = intr_disable();
+
+  if (cur->dl_period != 0)
+    cur->dl_budget = 0;
+  thread_yield();
+  intr_set_level(old_level);
+}
+
+/* Lets T run only on the CPUs in MASK, bit I standing for
+   cpus[I].  Returns false, changing nothing, unless MASK includes
+   a CPU that schedules threads.  A queued thread on a CPU that
+   MASK leaves out moves at once; a running one moves when it is
+   next woken. */
+bool thread_set_affinity(struct thread* t, uint32_t mask) {
+  enum intr_level old_level;
+  unsigned i;
+
+  ASSERT(is_thread(t));
+
+  if (cpu_cnt < 32)
+    mask &= (1u << cpu_cnt) - 1;
+  for (i = 0; i < cpu_cnt; i++)
+    if ((mask & (1u << i)) && cpus[i].scheduling)
+      break;
+  if (i == cpu_cnt)
+    return false;
 
+  old_level = intr_disable();
+  t->cpu_mask = mask;
+  if (t->status == THREAD_READY && !cpu_allowed(t, t->cpu)) {
+    ready_remove(t);
+    t->cpu = wakeup_cpu(t);
+    ready_push(t);
+  }
   intr_set_level(old_level);
+  return true;
 }
 
 /* Returns the current thread's priority. */
@@ -443,19 +987,22 @@ int thread_get_priority(void) {
   return curr->priority;
 }
 
-/* Sets the current thread's nice value to NICE. */
-void thread_set_nice(int nice UNUSED) {
+/* Sets the current thread's nice value to NICE, clamped to
+   NICE_MIN...NICE_MAX.  Only the MLFQS scheduler derives
+   priorities from nice values; the priority scheduler just keeps
+   it, and threads created later inherit it either way. */
+void thread_set_nice(int nice) {
   struct thread* curr = thread_current();
 
   enum intr_level old_level = intr_disable();
 
   curr->nice = CLAMP(nice, NICE_MIN, NICE_MAX);
 
-  thread_update_priority(curr);
-
-  int highest_priority = thread_mlfqs_get_highest_priority();
-  if (highest_priority != -1 && curr->priority < highest_priority)
-    thread_yield();
+  if (thread_mlfqs) {
+    thread_update_priority(curr);
+    if (thread_outranked())
+      thread_yield();
+  }
 
   intr_set_level(old_level);
 }
@@ -468,13 +1015,13 @@ int thread_get_nice(void) {
 
 /* Returns MULTIPLICATION_FACTOR times the system load average. */
 int thread_get_load_avg(void) {
-  return ROUND_CLOSEST(INT_MULTIPLY(load_avg, MULTIPLICATION_FACTOR));
+  return fp_round(fp_mul_int(load_avg, MULTIPLICATION_FACTOR));
 }
 
 /* Returns MULTIPLICATION_FACTOR times the current thread's recent_cpu value. */
 int thread_get_recent_cpu(void) {
   struct thread* curr = thread_current();
-  return ROUND_CLOSEST(INT_MULTIPLY(curr->recent_cpu, MULTIPLICATION_FACTOR));
+  return fp_round(fp_mul_int(curr->recent_cpu, MULTIPLICATION_FACTOR));
 }
 
 /* Idle thread.  Executes when no other thread is ready to run.
@@ -488,7 +1035,7 @@ int thread_get_recent_cpu(void) {
    special case when the ready list is empty. */
 static void idle(void* idle_started_ UNUSED) {
   struct semaphore* idle_started = idle_started_;
-  idle_thread = thread_current();
+  cpu_current()->idle_thread = thread_current();
   sema_up(idle_started);
 
   for (;;) {
@@ -496,6 +1043,13 @@ static void idle(void* idle_started_ UNUSED) {
     intr_disable();
     thread_block();
 
+    /* Zero a page for palloc's pre-zeroed lists while there is
+       nothing else to do.  Interrupts are off again afterward,
+       so blocking above picks up any thread that woke up
+       meanwhile. */
+    if (palloc_zero_idle())
+      continue;
+
     /* Re-enable interrupts and wait for the next one.
 
 	 The `sti' instruction disables interrupts until the
@@ -508,6 +1062,7 @@ static void idle(void* idle_started_ UNUSED) {
 
 	 See [IA32-v2a] "HLT", [IA32-v2b] "STI", and [IA32-v3a]
 	 7.11.1 "HLT Instruction". */
+    timer_stop_ticks();
     asm volatile("sti; hlt" : : : "memory");
   }
 }
@@ -533,6 +1088,12 @@ struct thread* running_thread(void) {
   return pg_round_down(esp);
 }
 
+/* Returns the CPU we are running on.  A thread's `cpu' member
+   is kept pointing to the CPU it runs on by schedule(). */
+struct cpu* cpu_current(void) {
+  return running_thread()->cpu;
+}
+
 /* Returns true if T appears to point to a valid thread. */
 static bool is_thread(struct thread* t) { return t != NULL && t->magic == THREAD_MAGIC; }
 
@@ -549,26 +1110,45 @@ static void init_thread(struct thread* t, const char* name, int priority) {
   t->stack = (uint8_t*)t + PGSIZE;
   t->priority = priority;
   t->magic = THREAD_MAGIC;
+  t->cpu = t == initial_thread ? cpu_bsp() : running_thread()->cpu;
+  t->cpu_mask = t == initial_thread ? UINT32_MAX : running_thread()->cpu_mask;
+  prng_init(&t->prng, prng_next(&running_thread()->prng));
 
   t->orig_priority = priority;
-  list_init(&t->donors_list);
+  pqueue_init(&t->donors, donor_higher_priority, NULL);
   t->wait_lock = NULL;
   t->thread_lock = NULL;
 
   /* Initialize members needed for userprogs */
-  t->parent = running_thread();
-  list_init(&t->process_children);
+  t->process = t;
+  t->creator = running_thread();
+  t->parent = t->creator->process;
+  list_init(&t->exited_children);
+  sema_init(&t->child_exited, 0);
+  t->child_record = NULL;
   sema_init(&t->child_process_lock, 0);
-  t->tid_wait = 0;
   t->executable_file = NULL;
-  t->num_fd = 2;
-  list_init(&t->files);
+  t->cwd = NULL;
+  t->heap_start = t->heap_end = NULL;
+  t->fds = NULL;
+  t->fd_cnt = 0;
+  t->fd_free = 2;
+  memcpy(t->rlimits, t->parent->rlimits, sizeof t->rlimits);
+  t->syscall_trace = t->parent->syscall_trace;
+  list_init(&t->shm_maps);
+  t->ioring = NULL;
+  sema_init(&t->thread_end, 0);
+  lock_init(&t->fd_lock);
+  lock_init(&t->heap_lock);
+#ifdef VM
+  lock_init(&t->pages_lock);
+#endif
   t->exit_status = EXIT_STATUS_FAIL;
 
   /* Custom defined values */
   if (t->tid == initial_thread->tid) {
-    t->nice = NICE_INIT; /* The initial thread has a nice value of 0 */
-    t->recent_cpu = 0;   /* The initial thread has a recent CPU value of 0 */
+    t->nice = NICE_INIT;       /* The initial thread has a nice value of 0 */
+    t->recent_cpu = fp_int(0); /* The initial thread has a recent CPU value of 0 */
   } else {
     /* Inherit nice and recent_cpu from parent */
     t->nice = thread_current()->nice;
@@ -576,8 +1156,6 @@ static void init_thread(struct thread* t, const char* name, int priority) {
   }
 
   ASSERT(is_thread(t)); /* TODO: Remove this */
-
-  list_push_back(&all_list, &t->allelem);
 }
 
 /* Allocates a SIZE-byte frame at the top of thread T's stack and
@@ -597,18 +1175,20 @@ static void* alloc_frame(struct thread* t, size_t size) {
    will be in the run queue.)  If the run queue is empty, return
    idle_thread. */
 static struct thread* next_thread_to_run(void) {
-  if (!thread_mlfqs) {
-    if (list_empty(&ready_list))
-      return idle_thread;
-    else
-      return list_entry(list_pop_front(&ready_list), struct thread, elem);
+  struct cpu* cpu = running_thread()->cpu;
+  struct thread* t = highest_ready(cpu);
+
+  if (t != NULL) {
+    ready_remove(t);
+    return t;
   } else {
-    int highest_priority = thread_mlfqs_get_highest_priority();
+    struct cpu* victim = busiest_cpu(cpu);
 
-    if (highest_priority != -1)
-      return list_entry(list_pop_front(&mlfqs_lists[highest_priority]), struct thread, mlfqselem);
-    else
-      return idle_thread;
+    if (victim != NULL && (t = steal_thread(victim, cpu)) != NULL) {
+      steals++;
+      return t;
+    }
+    return cpu->idle_thread;
   }
 }
 
@@ -635,6 +1215,7 @@ void thread_schedule_tail(struct thread* prev) {
 
   /* Mark us as running. */
   cur->status = THREAD_RUNNING;
+  cur->cpu->running = cur;
 
   /* Start new time slice. */
   thread_ticks = 0;
@@ -646,13 +1227,18 @@ void thread_schedule_tail(struct thread* prev) {
 
   /* If the thread we switched from is dying, destroy its struct
      thread.  This must happen late so that thread_exit() doesn't
-     pull out the rug under itself.  (We don't free
-     initial_thread because its memory was not obtained via
-     palloc().) */
+     pull out the rug under itself, and only after a grace period,
+     because a thread_foreach() that was walking all_list may
+     still stand on it.  (We don't free initial_thread because its
+     memory was not obtained via palloc().) */
   if (prev != NULL && prev->status == THREAD_DYING && prev != initial_thread) {
     ASSERT(prev != cur);
-    palloc_free_page(prev);
+    stack_record(prev);
+    call_rcu(&prev->rcu, free_dead_thread);
   }
+
+  /* A context switch is a quiescent state. */
+  rcu_quiescent();
 }
 
 /* Schedules a new process.  At entry, interrupts must be off and
@@ -671,18 +1257,115 @@ static void schedule(void) {
   ASSERT(cur->status != THREAD_RUNNING);
   ASSERT(is_thread(next));
 
-  if (cur != next)
+  /* NEXT runs here now, whatever run queue it came from. */
+  next->cpu = cur->cpu;
+
+  if (cur != next) {
+    seqlock_write_begin(&stats_seq);
+    if (cur->preempted && cur->status == THREAD_READY)
+      cur->involuntary_switches++;
+    else
+      cur->voluntary_switches++;
+    seqlock_write_end(&stats_seq);
+    if (sched_trace_enabled)
+      sched_trace_switch(cur, next,
+                         cur->status == THREAD_BLOCKED ? SCHED_TRACE_BLOCK
+                         : cur->status == THREAD_DYING ? SCHED_TRACE_EXIT
+                         : cur->preempted              ? SCHED_TRACE_PREEMPT
+                                                       : SCHED_TRACE_YIELD);
+    stack_check(cur);
+    pmu_switch(cur, next);
+    fpu_switch(next);
     prev = switch_threads(cur, next);
+  }
   thread_schedule_tail(prev);
 }
 
-/* Returns a tid to use for a new thread. */
-static tid_t allocate_tid(void) {
+/* Returns a page for a new thread, from the cache of dead
+   threads' pages if possible, or a null pointer if memory is
+   exhausted.  Unlike a fresh page, a cached page isn't zeroed. */
+static struct thread* alloc_thread_page(void) {
+  struct thread* t = NULL;
+  enum intr_level old_level;
+
+  old_level = intr_disable();
+  if (stack_cache_cnt > 0) {
+    t = stack_cache[--stack_cache_cnt];
+    stack_hits++;
+  }
+  intr_set_level(old_level);
+
+  if (t == NULL) {
+    t = palloc_get_page(PAL_ZERO);
+    if (t != NULL)
+      stack_misses++;
+  }
+  return t;
+}
+
+/* Releases T's page, which must not be in use anymore, to the
+   cache, or to the page allocator if the cache is full. */
+static void free_thread_page(struct thread* t) {
+  ASSERT(intr_get_level() == INTR_OFF);
+
+  if (stack_cache_cnt < STACK_CACHE_SIZE)
+    stack_cache[stack_cache_cnt++] = t;
+  else
+    palloc_free_page(t);
+}
+
+/* Frees the page of the dead thread that HEAD is embedded in,
+   once a grace period has passed.  Called by rcu_quiescent(). */
+static void free_dead_thread(struct rcu_head* head) {
+  free_thread_page(pg_round_down(head));
+}
+
+/* Fills the unused part of new thread T's stack with
+   STACK_CANARY. */
+static void stack_fill(struct thread* t) {
+  uint32_t* p;
+
+  for (p = (uint32_t*)(t + 1); p < (uint32_t*)t->stack; p++)
+    *p = STACK_CANARY;
+  t->stack_canary = true;
+}
+
+/* Panics if T's stack has grown down to its last word, which is
+   the last chance to catch an overflow before it reaches T's
+   struct thread. */
+static void stack_check(struct thread* t) {
+  if (t->stack_canary && *(uint32_t*)(t + 1) != STACK_CANARY)
+    PANIC("kernel stack overflow in thread %d (%s)", t->tid, t->name);
+}
+
+/* Updates stack_max_depth with the deepest T's stack has grown,
+   found by scanning up from its end for the first word that no
+   longer holds STACK_CANARY. */
+static void stack_record(struct thread* t) {
+  uint32_t* p = (uint32_t*)(t + 1);
+  uint32_t* top = (uint32_t*)((uint8_t*)t + PGSIZE);
+  size_t depth;
+
+  if (!t->stack_canary)
+    return;
+  while (p < top && *p == STACK_CANARY)
+    p++;
+  depth = (uint8_t*)top - (uint8_t*)p;
+  if (depth > stack_max_depth) {
+    stack_max_depth = depth;
+    strlcpy(stack_max_name, t->name, sizeof stack_max_name);
+  }
+}
+
+/* Reserves CNT consecutive tids for new threads and returns the
+   first. */
+static tid_t allocate_tids(int cnt) {
   static tid_t next_tid = 1;
   tid_t tid;
 
   lock_acquire(&tid_lock);
-  tid = next_tid++;
+  tid = next_tid;
+  next_tid += cnt;
   lock_release(&tid_lock);
 
   return tid;
@@ -692,117 +1375,487 @@ static tid_t allocate_tid(void) {
    Used by switch.S, which can't figure it out on its own. */
 uint32_t thread_stack_ofs = offsetof(struct thread, stack);
 
-void mlfqs_scheduler(void* arg UNUSED) {
-  mlfqs_thread = thread_current();
-
-  for (;;) {
-    enum intr_level old_level = intr_disable();
-    thread_block();
-    intr_set_level(old_level);
-
-    if (is_recent_cpu_update) {
-      thread_update_load_avg();
-      thread_update_recent_cpu();
-    }
+/* Runs the MLFQS updates at the end of the timer interrupt and
+  then yields, so that the new priorities take effect at once */
+static void mlfqs_deferred(void* aux UNUSED) {
+  mlfqs_update();
+  intr_yield_on_return();
+}
 
-    if (is_mlfqs_priority_update)
-      thread_update_priorities();
+static void mlfqs_update(void) {
+  if (is_recent_cpu_update) {
+    thread_update_load_avg();
+    thread_update_recent_cpu();
   }
+
+  if (is_mlfqs_priority_update)
+    thread_update_priorities();
 }
 
 void thread_update_load_avg(void) {
   int ready_threads = 0;
-
-  struct list_elem* iter;
-  for (iter = list_begin(&all_list); iter != list_end(&all_list); iter = list_next(iter)) {
-    struct thread* curr = list_entry(iter, struct thread, allelem);
-    tid_t curr_tid = curr->tid;
-
-    if (curr->status == THREAD_READY && curr_tid != wakeup_thread->tid &&
-        curr_tid != mlfqs_thread->tid && curr_tid != idle_thread->tid)
-      ready_threads++;
+  unsigned i;
+
+  for (i = 0; i < cpu_cnt; i++) {
+    struct cpu* c = &cpus[i];
+    if (c->started) {
+      ready_threads += c->ready_threads_cnt;
+      if (c->running != NULL && !thread_is_internal(c->running))
+        ready_threads++;
+    }
   }
 
-  struct thread* curr = thread_current();
-  tid_t curr_tid = curr->tid;
-
-  if (curr_tid != wakeup_thread->tid && curr_tid != mlfqs_thread->tid &&
-      curr_tid != idle_thread->tid)
-    ready_threads++;
-
-  int64_t n = INT_ADD(INT_MULTIPLY(load_avg, 59), ready_threads);
-  load_avg = INT_DIVIDE(n, 60);
-
-  // printf("Load average is %d and number of threads is %d\n", load_avg, ready_threads);
+  /* Within 32 bits, so the compiler divides by 60 with a multiply. */
+  load_avg = fp_div_int(fp_add_int(fp_mul_int(load_avg, 59), ready_threads), 60);
+  vdso_set_load_avg(thread_get_load_avg());
 }
 
+/* Every thread's recent_cpu decays once a second, so this is the one
+  pass that has to visit all of all_list. It leaves every thread stale
+  for the next thread_update_priorities() */
 void thread_update_recent_cpu(void) {
   is_recent_cpu_update = false;
 
+  enum intr_level old_level = intr_disable();
+
+  fixed_t temp1 = fp_mul_int(load_avg, 2);
+  fixed_t temp2 = fp_div(temp1, fp_add_int(temp1, 1));
+
   struct list_elem* iter;
   for (iter = list_begin(&all_list); iter != list_end(&all_list); iter = list_next(iter)) {
     struct thread* curr = list_entry(iter, struct thread, allelem);
-    tid_t curr_tid = curr->tid;
-
-    if (curr_tid != wakeup_thread->tid && curr_tid != mlfqs_thread->tid &&
-        curr_tid != idle_thread->tid) {
-      int temp1 = INT_MULTIPLY(load_avg, 2);
-      int temp2 = DIVIDE(temp1, INT_ADD(temp1, 1));
-      int temp3 = MULTIPLY(temp2, curr->recent_cpu);
-      curr->recent_cpu = INT_ADD(temp3, curr->nice);
+
+    if (!thread_is_internal(curr)) {
+      fixed_t temp3 = fp_mul(temp2, curr->recent_cpu);
+      curr->recent_cpu = fp_add_int(temp3, curr->nice);
+      thread_mark_stale(curr);
     }
   }
+
+  intr_set_level(old_level);
 }
 
 void thread_update_priority(struct thread* t) {
-  tid_t curr_tid = t->tid;
-  if (curr_tid != wakeup_thread->tid && curr_tid != mlfqs_thread->tid &&
-      curr_tid != idle_thread->tid) {
-    int temp1 = INT_ADD(INT_DIVIDE(t->recent_cpu, 4), 2 * t->nice);
-    int temp2 = ROUND_ZERO(INT_SUB(PRI_MAX, temp1));
-    t->priority = CLAMP(temp2, PRI_MIN, PRI_MAX);
-  }
-
-  if (t->status == THREAD_READY) {
-    enum intr_level old_level = intr_disable();
-    list_remove(&t->mlfqselem);
-    list_push_back(&mlfqs_lists[t->priority], &t->mlfqselem);
-    intr_set_level(old_level);
+  int new_priority = t->priority;
+
+  if (!thread_is_internal(t)) {
+    fixed_t temp1 = fp_add_int(fp_div_int(t->recent_cpu, 4), 2 * t->nice);
+    int temp2 = fp_trunc(fp_sub_from_int(PRI_MAX, temp1));
+    new_priority = CLAMP(temp2, PRI_MIN, PRI_MAX);
   }
+
+  /* thread_requeue() leaves a thread on its list if its priority is unchanged */
+  thread_requeue(t, new_priority);
 }
 
+/* Recompute the priority of the threads whose recent_cpu changed since
+  the last pass: the threads that ran in the last time slice, or
+  everyone right after the once a second recent_cpu update */
 void thread_update_priorities() {
   is_mlfqs_priority_update = false;
 
-  struct list_elem* iter;
-  for (iter = list_begin(&all_list); iter != list_end(&all_list); iter = list_next(iter)) {
-    struct thread* curr = list_entry(iter, struct thread, allelem);
+  enum intr_level old_level = intr_disable();
+
+  while (!list_empty(&mlfqs_stale_list)) {
+    struct thread* curr = list_entry(list_pop_front(&mlfqs_stale_list), struct thread, mlfqselem);
+    curr->mlfqs_stale = false;
     thread_update_priority(curr);
   }
+
+  intr_set_level(old_level);
+}
+
+static bool thread_is_internal(struct thread* t) {
+  return thread_is_idle(t);
+}
+
+static bool thread_is_idle(struct thread* t) { return t == t->cpu->idle_thread; }
+
+static void thread_mark_stale(struct thread* t) {
+  if (!t->mlfqs_stale) {
+    t->mlfqs_stale = true;
+    list_push_back(&mlfqs_stale_list, &t->mlfqselem);
+  }
 }
 
-/* Fetches the priority such that the MLFQ list corresponding to that
+/* Fetches the priority such that the ready list corresponding to that
   priority is not empty. If no such list is found, return -1, indicating
   a situation where no thread is present to be scheduled
+
+  The answer comes from the occupancy bitmap: the most significant set
+  bit of the highest non-zero word (a single `bsr' instruction)
 */
-int thread_mlfqs_get_highest_priority(void) {
+int thread_get_highest_ready_priority(void) {
+  return cpu_get_highest_ready_priority(running_thread()->cpu);
+}
+
+static int cpu_get_highest_ready_priority(struct cpu* cpu) {
   int i;
-  for (i = PRI_MAX; i >= PRI_MIN; i--) {
-    struct list* cur_list = &mlfqs_lists[i];
-    if (!list_empty(cur_list))
-      return i;
+  for (i = READY_BITMAP_WORDS - 1; i >= 0; i--) {
+    if (cpu->ready_bitmap[i] != 0)
+      return i * 32 + (31 - __builtin_clz(cpu->ready_bitmap[i]));
   }
 
   return -1;
 }
 
-static bool thread_compare_priorities(const struct list_elem* a, const struct list_elem* b,
-                                      void* aux UNUSED) {
-  struct thread* t1 = list_entry(a, struct thread, elem);
-  struct thread* t2 = list_entry(b, struct thread, elem);
+static void ready_push(struct thread* t) {
+  struct cpu* cpu = t->cpu;
+
+  if (t->dl_period != 0) {
+    if (dl_runnable(t)) {
+      list_insert_ordered(&cpu->dl_ready, &t->elem, dl_earlier, NULL);
+      cpu->ready_threads_cnt++;
+    } else
+      list_push_back(&cpu->dl_throttled, &t->elem);
+    return;
+  }
+  list_push_back(&cpu->ready_lists[t->priority], &t->elem);
+  cpu->ready_bitmap[t->priority / 32] |= 1u << (t->priority % 32);
+  if (!thread_is_internal(t))
+    cpu->ready_threads_cnt++;
+}
+
+static void ready_remove(struct thread* t) {
+  struct cpu* cpu = t->cpu;
+  list_remove(&t->elem);
+  if (t->dl_period != 0) {
+    if (dl_runnable(t))
+      cpu->ready_threads_cnt--;
+    return;
+  }
+  if (list_empty(&cpu->ready_lists[t->priority]))
+    cpu->ready_bitmap[t->priority / 32] &= ~(1u << (t->priority % 32));
+  if (!thread_is_internal(t))
+    cpu->ready_threads_cnt--;
+}
+
+/* A queued thread has to leave the list of its old priority before the
+  priority changes, so that the occupancy bit of that list stays right.
+  Threads blocked or running only need the new value */
+static void thread_requeue(struct thread* t, int priority) {
+  enum intr_level old_level = intr_disable();
+
+  if (t->status == THREAD_READY && t->priority != priority) {
+    ready_remove(t);
+    t->priority = priority;
+    ready_push(t);
+  } else
+    t->priority = priority;
+
+  intr_set_level(old_level);
+}
+
+/* Sets up PAGE, which will be the first stack page of CPU C, as
+   C's idle thread, so that thread_current() works on C as soon as
+   it runs kernel code. */
+void thread_init_idle(struct cpu* c, void* page) {
+  struct thread* t = page;
+  enum intr_level old_level;
+
+  old_level = intr_disable();
+  init_thread(t, "idle", PRI_MIN);
+  t->tid = allocate_tids(1);
+  rcu_list_push_back(&all_list, &t->allelem);
+  t->status = THREAD_RUNNING;
+  t->cpu = c;
+  c->idle_thread = c->running = t;
+  intr_set_level(old_level);
+}
+
+static struct cpu* busiest_cpu(struct cpu* self) {
+  struct cpu* busiest = NULL;
+  unsigned i;
+
+  for (i = 0; i < cpu_cnt; i++) {
+    struct cpu* c = &cpus[i];
+    if (c != self && c->started && c->ready_threads_cnt > 0 &&
+        (busiest == NULL || c->ready_threads_cnt > busiest->ready_threads_cnt))
+      busiest = c;
+  }
+
+  return busiest;
+}
+
+/*
+  Only the thread FROM would run next is looked at, so a thread is never
+  stolen ahead of a more important one on the same queue.  Returns null
+  if that thread may not run on TO
+*/
+static struct thread* steal_thread(struct cpu* from, struct cpu* to) {
+  struct thread* t = highest_ready(from);
 
-  if (t1->priority > t2->priority)
-    return true;
+  if (t == NULL || !cpu_allowed(t, to))
+    return NULL;
+  ready_remove(t);
+  t->cpu = to;
+  return t;
+}
 
-  return false;
-}
\ No newline at end of file
+static void thread_balance(void) {
+  struct cpu* self = running_thread()->cpu;
+  struct cpu* victim = busiest_cpu(self);
+  struct thread* t;
+
+  ASSERT(intr_get_level() == INTR_OFF);
+
+  if (victim == NULL ||
+      victim->ready_threads_cnt < self->ready_threads_cnt + (int)thread_balance_imbalance)
+    return;
+
+  t = steal_thread(victim, self);
+  if (t == NULL)
+    return;
+  ready_push(t);
+  migrations++;
+  if (thread_preempts(t))
+    intr_yield_on_return();
+}
+
+static bool cpu_allowed(const struct thread* t, const struct cpu* c) {
+  return c->scheduling && (t->cpu_mask & (1u << c->id)) != 0;
+}
+
+/*
+  T's last CPU keeps it, for the sake of its caches, unless T may not
+  run there or it has thread_balance_imbalance more queued threads than
+  the least loaded CPU T may run on
+*/
+static struct cpu* wakeup_cpu(struct thread* t) {
+  struct cpu* last = t->cpu;
+  struct cpu* idlest = NULL;
+  unsigned i;
+
+  for (i = 0; i < cpu_cnt; i++) {
+    struct cpu* c = &cpus[i];
+    if (cpu_allowed(t, c) && (idlest == NULL || c->ready_threads_cnt < idlest->ready_threads_cnt))
+      idlest = c;
+  }
+
+  if (idlest == NULL
+      || (cpu_allowed(t, last)
+          && last->ready_threads_cnt < idlest->ready_threads_cnt + (int)thread_balance_imbalance))
+    return last;
+  wakeup_moves++;
+  return idlest;
+}
+
+/*
+  The deadline class comes first, earliest deadline first, then the
+  highest non-empty priority level
+*/
+static struct thread* highest_ready(struct cpu* cpu) {
+  int priority;
+
+  if (!list_empty(&cpu->dl_ready))
+    return list_entry(list_front(&cpu->dl_ready), struct thread, elem);
+  priority = cpu_get_highest_ready_priority(cpu);
+  if (priority == -1)
+    return NULL;
+  return list_entry(list_front(&cpu->ready_lists[priority]), struct thread, elem);
+}
+
+static bool thread_outranked(void) {
+  struct thread* t = highest_ready(running_thread()->cpu);
+  return t != NULL && thread_preempts(t);
+}
+
+/* True if T is in the deadline class and has budget left */
+static bool dl_runnable(const struct thread* t) { return t->dl_period != 0 && t->dl_budget > 0; }
+
+/* T's share of the CPU, in thousandths, rounded up, or 0 if T is not in
+  the deadline class */
+static int dl_util_of(const struct thread* t) {
+  return t->dl_period != 0 ? DIV_ROUND_UP((long long)t->dl_runtime * 1000, t->dl_period) : 0;
+}
+
+/* Orders deadline threads, linked through `elem', by deadline */
+static bool dl_earlier(const struct list_elem* a_, const struct list_elem* b_,
+                       void* aux UNUSED) {
+  const struct thread* a = list_entry(a_, struct thread, elem);
+  const struct thread* b = list_entry(b_, struct thread, elem);
+
+  return a->dl_abs_deadline < b->dl_abs_deadline;
+}
+
+/*
+  Starts a new period for each deadline thread whose next period has
+  come by timer tick NOW: refills its budget and moves its deadline on.
+  A queued thread is requeued, which takes a throttled one off
+  dl_throttled. A thread that fell more than a period behind, because
+  it ran past the end of the last one, starts its period afresh at NOW
+*/
+static void dl_replenish(int64_t now) {
+  struct list_elem* e;
+
+  for (e = list_begin(&dl_list); e != list_end(&dl_list); e = list_next(e)) {
+    struct thread* t = list_entry(e, struct thread, dlelem);
+    bool queued = t->status == THREAD_READY;
+
+    if (now < t->dl_next_period)
+      continue;
+    if (queued)
+      ready_remove(t);
+    t->dl_budget = t->dl_runtime;
+    t->dl_abs_deadline = t->dl_next_period + t->dl_deadline;
+    t->dl_next_period += t->dl_period;
+    if (t->dl_next_period <= now) {
+      t->dl_abs_deadline = now + t->dl_deadline;
+      t->dl_next_period = now + t->dl_period;
+    }
+    if (queued) {
+      ready_push(t);
+      if (thread_preempts(t))
+        intr_yield_on_return();
+    }
+  }
+}
+
+/* Starts a change to the CPU or memory accounting of a thread,
+   with interrupts off, and returns the previous interrupt level,
+   to pass to thread_stats_end(). */
+enum intr_level thread_stats_begin(void) {
+  enum intr_level old_level = intr_disable();
+
+  seqlock_write_begin(&stats_seq);
+  return old_level;
+}
+
+/* Ends a change that thread_stats_begin() started, and restores
+   interrupt level OLD_LEVEL. */
+void thread_stats_end(enum intr_level old_level) {
+  seqlock_write_end(&stats_seq);
+  intr_set_level(old_level);
+}
+
+/* Copies the CPU accounting of T, and the memory accounting of
+   its process, into USAGE. */
+void thread_get_rusage(struct thread* t, struct rusage* usage) {
+  unsigned seq;
+
+  do {
+    seq = seqlock_read_begin(&stats_seq);
+    read_rusage(t, usage);
+  } while (seqlock_read_retry(&stats_seq, seq));
+}
+
+/* Copies the accounting of T into USAGE, for
+   thread_get_rusage(). */
+static void read_rusage(struct thread* t, struct rusage* usage) {
+  usage->user_ticks = t->user_ticks;
+  usage->kernel_ticks = t->kernel_ticks;
+  usage->lock_wait_ticks = t->lock_wait_ticks;
+  usage->voluntary_switches = t->voluntary_switches;
+  usage->involuntary_switches = t->involuntary_switches;
+#ifdef VM
+  usage->minor_faults = t->process->minor_faults;
+  usage->major_faults = t->process->major_faults;
+  usage->swap_ins = t->process->swap_ins;
+  usage->swap_outs = t->process->swap_outs;
+  usage->rss_pages = t->process->rss_pages;
+  usage->peak_rss_pages = t->process->peak_rss_pages;
+  usage->refaults = t->process->refaults;
+#else
+  usage->minor_faults = usage->major_faults = 0;
+  usage->swap_ins = usage->swap_outs = 0;
+  usage->rss_pages = usage->peak_rss_pages = 0;
+  usage->refaults = 0;
+#endif
+}
+
+/* Returns a hash value for child_process C. */
+static unsigned child_hash(const struct hash_elem* c_, void* aux UNUSED) {
+  const struct child_process* c = hash_entry(c_, struct child_process, elem);
+  return hash_int(c->tid);
+}
+
+/* Returns true if child_process A precedes child_process B. */
+static bool child_less(const struct hash_elem* a_, const struct hash_elem* b_,
+                       void* aux UNUSED) {
+  const struct child_process* a = hash_entry(a_, struct child_process, elem);
+  const struct child_process* b = hash_entry(b_, struct child_process, elem);
+  return a->tid < b->tid;
+}
+
+/* Initializes T's table of children.  Returns false if memory
+   runs out. */
+static bool children_init(struct thread* t) {
+  return hash_init(&t->process_children, child_hash, child_less, NULL);
+}
+
+/* Drops one reference to child record C, freeing it if that was
+   the last.  Parent and child may exit at the same time, so the
+   count is updated with interrupts off. */
+static void child_release(struct child_process* c) {
+  enum intr_level old_level = intr_disable();
+  bool last = --c->ref_cnt == 0;
+
+  intr_set_level(old_level);
+  if (last)
+    kmem_cache_free(child_process_cache, c);
+}
+
+/* Drops the parent's reference to the child record in E, which
+   has already been removed from the parent's table. */
+static void child_forget(struct hash_elem* e, void* aux UNUSED) {
+  child_release(hash_entry(e, struct child_process, elem));
+}
+
+/* Returns the current process's record of its child TID, or a
+   null pointer if it has no such child or has already forgotten
+   it.  All of the process's threads use its tables of children
+   and threads, so those are only changed with interrupts off. */
+struct child_process* thread_find_child(tid_t tid) {
+  struct child_process key;
+  struct hash_elem* e;
+  enum intr_level old_level;
+
+  key.tid = tid;
+  old_level = intr_disable();
+  e = hash_find(&thread_current()->process->process_children, &key.elem);
+  intr_set_level(old_level);
+  return e != NULL ? hash_entry(e, struct child_process, elem) : NULL;
+}
+
+/* Removes child record C from the current process's table and
+   drops the parent's reference to it.  The child may still be
+   running. */
+void thread_forget_child(struct child_process* c) {
+  enum intr_level old_level = intr_disable();
+
+  if (c->reported)
+    list_remove(&c->exited_elem);
+  hash_delete(&thread_current()->process->process_children, &c->elem);
+  intr_set_level(old_level);
+
+  child_release(c);
+}
+
+/* Waits for thread TID of the current process, which
+   thread_create_sibling() created, to exit and returns its exit
+   status.  Returns -1 at once if there is no such thread other
+   than the running one, or if it has been joined already.  The
+   record leaves the table before the wait, so that only one
+   thread can join TID. */
+int thread_join(tid_t tid) {
+  struct hash* threads = &thread_current()->process->threads;
+  struct child_process key;
+  struct child_process* c;
+  struct hash_elem* e;
+  enum intr_level old_level;
+  int status;
+
+  if (tid == thread_tid() || threads->buckets == NULL)
+    return -1;
+  key.tid = tid;
+  old_level = intr_disable();
+  e = hash_delete(threads, &key.elem);
+  intr_set_level(old_level);
+  if (e == NULL)
+    return -1;
+  c = hash_entry(e, struct child_process, elem);
+  sema_down(&c->exited);
+  status = c->exit_status;
+  child_release(c);
+  return status;
+}
@@ -2,8 +2,18 @@
 #define THREADS_THREAD_H
 
 #include <debug.h>
+#include <fp_arithmetic.h>
+#include <hash.h>
 #include <list.h>
+#include <pmu.h>
+#include <pqueue.h>
+#include <random.h>
 #include <stdint.h>
+#include <rlimit.h>
+#include <rusage.h>
+#include <threads/interrupt.h>
+#include <threads/ipi.h>
+#include <threads/rcu.h>
 #include <threads/synch.h>
 
 /* States in a thread's life cycle. */
@@ -58,8 +68,8 @@ typedef int tid_t;
              |              magic              |
              |                :                |
              |                :                |
-             |               name              |
              |              status             |
+             |              stack              |
         0 kB +---------------------------------+
 
    The upshot of this is twofold:
@@ -68,7 +78,8 @@ typedef int tid_t;
          big.  If it does, then there will not be enough room for
          the kernel stack.  Our base `struct thread' is only a
          few bytes in size.  It probably should stay well under 1
-         kB.
+         kB.  The build prints its size and the stack space it
+         leaves in thread-layout.txt.
 
       2. Second, kernel stacks must not be allowed to grow too
          large.  If a stack overflows, it will corrupt the thread
@@ -81,7 +92,11 @@ typedef int tid_t;
    an assertion failure in thread_current(), which checks that
    the `magic' member of the running thread's `struct thread' is
    set to THREAD_MAGIC.  Stack overflow will normally change this
-   value, triggering the assertion. */
+   value, triggering the assertion.  Before that, thread_create()
+   fills a new thread's stack with a canary pattern, and a switch
+   away from a thread whose stack has reached the last canary
+   word panics, naming the thread.  The deepest any stack has
+   reached is printed at shutdown. */
 /* The `elem' member has a dual purpose.  It can be an element in
    the run queue (thread.c), or it can be an element in a
    semaphore wait list (synch.c).  It can be used these two ways
@@ -90,28 +105,70 @@ typedef int tid_t;
    blocked state is on a semaphore wait list. */
 
 struct thread {
-  /* Owned by thread.c. */
-  tid_t tid;                 /* Thread identifier. */
-  enum thread_status status; /* Thread state. */
-  char name[16];             /* Name (for debugging purposes). */
+  /* Owned by thread.c.  The members that every thread switch and
+     run queue operation touches come first, so that they share
+     one cache line.  threads/thread-layout.c checks this at build
+     time. */
   uint8_t* stack;            /* Saved stack pointer. */
+  enum thread_status status; /* Thread state. */
   int priority;              /* Priority. */
-  struct list_elem allelem;  /* List element for all threads list. */
+  struct cpu* cpu;           /* CPU running or last to run this thread. */
+  tid_t tid;                 /* Thread identifier. */
 
   /* Shared between thread.c and synch.c. */
   struct list_elem elem; /* List element. */
 
+  /* Owned by thread.c. */
+  struct list_elem allelem;  /* List element for all threads list. */
+  char name[16];             /* Name (for debugging purposes). */
+  int rcu_state;             /* RCU read-side nesting * 2 + phase. */
+  struct rcu_head rcu;       /* Frees the page once the thread is dead. */
+  struct prng prng;          /* This thread's fast random numbers. */
+  uint32_t cpu_mask;         /* CPUs it may run on, one bit per cpus[] index. */
+  struct ipi_msg wakeup_msg; /* Asks another CPU to queue it when woken there. */
+
 #ifdef USERPROG
   /* Owned by userprog/process.c. */
   uint32_t* pagedir; /* Page directory. */
 #endif
+#ifdef VM
+  /* Owned by vm/page.c. */
+  struct hash pages;          /* Supplemental page table. */
+  struct lock pages_lock;     /* Protects PAGES from the process's other threads. */
+  void* user_esp;             /* User stack pointer on entry to a system call. */
+  void* fault_around_next;    /* Page just past the last fault-around window. */
+  size_t fault_around_window; /* Pages in the last fault-around window. */
+  size_t swap_next;           /* Slot after the last one it swapped out to. */
+  long long minor_faults;     /* Page faults served without I/O. */
+  long long major_faults;     /* Page faults that read a file or swap. */
+  long long swap_ins;         /* Pages read back from swap. */
+  long long swap_outs;        /* Pages written to swap. */
+  size_t rss_pages;           /* Pages in frames. */
+  size_t peak_rss_pages;      /* Most pages in frames at once. */
+  long long refaults;         /* Pages read back soon after their eviction. */
+
+  /* Owned by vm/frame.c. */
+  unsigned thrash_window;   /* Thrash window that THRASH_REFAULTS counts in. */
+  unsigned thrash_refaults; /* Refaults in that window. */
+  int64_t thrash_until;     /* Page faults wait until this tick. */
+
+  /* Owned by vm/mmap.c. */
+  struct list mappings; /* Memory-mapped files. */
+  int next_mapid;       /* Identifier for the next mapping. */
+#endif
+#ifdef FILESYS
+  /* Owned by filesys/journal.c. */
+  int journal_depth; /* Journal operations begun and not ended. */
 
-  /* Owned by thread.c. */
-  unsigned magic; /* Detects stack overflow. */
+  /* Owned by filesys/cache.c. */
+  unsigned dirtied;   /* Data sectors it dirtied since flush DIRTY_GEN. */
+  unsigned dirty_gen; /* Flush that DIRTIED counts from. */
+#endif
 
   /* Alarm Clock Data Structures */
-  int64_t wakeup_time;        /* Timer ticks till wakeup */
-  struct list_elem sleepelem; /* List element for sleeping threads list. */
+  int64_t wakeup_time;           /* Timer ticks till wakeup */
+  int64_t wakeup_ns;             /* timer_ns() to wake up at from a short sleep. */
+  struct pqueue_elem sleep_elem; /* Element in a sleeping threads queue. */
 
   /* MLFQ Scheduler Data Structures */
   /*
@@ -132,13 +189,42 @@ struct thread {
     (Recalculate when timer_ticks % TIMER_FREQ = 0 since tests assume this)
     ```recent_cpu = (2*load_avg)/(2*load_avg + 1) * recent_cpu + nice```
     (Load avg is a global, which is also updated to reflect real CPU usage)
-    We store 100 * recent_cpu to make it simpler to deal as an integer
+    Stored as a fixed-point number
   */
-  int recent_cpu;
+  fixed_t recent_cpu;
 
-  /* List element for MLFQ Scheduler Lists */
+  /* True if recent_cpu changed since the MLFQS priority was last computed */
+  bool mlfqs_stale;
+
+  /* List element for the list of threads with a stale MLFQS priority */
   struct list_elem mlfqselem;
 
+  /* CPU accounting, reported by thread_print_stats() and getrusage(),
+     and changed only between thread_stats_begin() and thread_stats_end() */
+  int64_t user_ticks;            /* Timer ticks while running a user program */
+  int64_t kernel_ticks;          /* Timer ticks while running in the kernel */
+  unsigned voluntary_switches;   /* Switches away by yielding or blocking */
+  unsigned involuntary_switches; /* Switches away by preemption */
+  bool preempted;                /* Yielding because of intr_yield_on_return() */
+  int64_t lock_wait_ticks;       /* Timer ticks spent blocked in lock_acquire() */
+
+  /* Performance counters (see threads/pmu.c) */
+  uint32_t pmu_evtsel[PMU_COUNTER_CNT]; /* Event selects, 0 for unused counters */
+  uint64_t pmu_counts[PMU_COUNTER_CNT]; /* Counts up to the last switch away */
+  bool pmu_active;                      /* Any counter in use? */
+
+  /* Floating-point registers (see threads/fpu.c) */
+  struct fpu_state* fpu; /* Saved registers, or null if the FPU was never used */
+
+  /* Deadline class (see thread_set_deadline()), in timer ticks */
+  int dl_runtime;          /* Budget per period, or 0 outside the class */
+  int dl_deadline;         /* Deadline, from the start of each period */
+  int dl_period;           /* Length of a period */
+  int dl_budget;           /* Budget left in this period */
+  int64_t dl_abs_deadline; /* Deadline of this period */
+  int64_t dl_next_period;  /* Start of the next period */
+  struct list_elem dlelem; /* List element for the list of deadline threads */
+
   /* The original priority of the thread. Need to handle donation */
   int orig_priority;
 
@@ -148,40 +234,86 @@ struct thread {
   /* The thread that holds the lock `wait_lock` */
   struct thread* thread_lock;
 
-  /* All possible donor threads */
-  struct list donors_list;
+  /* The reader-writer lock that given thread is waiting for, if any */
+  struct rwlock* wait_rwlock;
 
-  /* List element for donor lists */
-  struct list_elem donorelem;
+  /* Threads donating their priority to this one, highest priority
+     at the front, so that the front one tells the donated priority */
+  struct pqueue donors;
 
-  /* User Program Members */
+  /* Priority queue element for donor queues */
+  struct pqueue_elem donorelem;
+
+  /* User Program Members.  A process's state is kept in its main
+     thread, the one that exec() or fork() created.  The other
+     threads of the process (see process_thread_create()) reach it
+     through PROCESS and leave their own copies unused, except for
+     PAGEDIR, which they point at the process's page directory. */
+  struct thread* process; /* Main thread of this thread's process, maybe itself */
+  struct thread* creator; /* Thread that created this one, for exec and fork */
   bool complete;
 
   int exit_status;
 
-  /* The tid we're waiting for */
-  tid_t tid_wait;
-  struct list process_children;        /* A list of child processes */
-  struct thread* parent;               /* Parent thread for a given thread */
-  struct semaphore child_process_lock; /* Semaphore for child process */
-
-  struct list files;            /* The list of files opened by the process */
-  int num_fd;                   /* The number of files open, initialized to 2 */
+  struct hash process_children;        /* Records of children, by tid */
+  struct list exited_children;         /* Records of exited children, oldest first */
+  struct semaphore child_exited;       /* Upped whenever a child exits */
+  struct child_process* child_record;  /* This thread's record in its parent's table */
+  struct thread* parent;               /* Main thread of the parent process */
+  struct semaphore child_process_lock; /* Signals the result of an exec or fork */
+
+  struct hash threads;         /* Records of the process's other threads, by tid */
+  int thread_cnt;              /* Other threads of the process still running */
+  struct semaphore thread_end; /* Upped whenever one of them exits */
+  bool exiting;                /* Is the process exiting? */
+  struct lock fd_lock;         /* Protects fds, fd_cnt and fd_free */
+
+  struct fd_entry* fds;         /* Open files indexed by fd, or null (see userprog/fd.c) */
+  int fd_cnt;                   /* Number of elements in fds */
+  int fd_free;                  /* Lowest fd that may be free */
+  bool console_nonblock[2];     /* O_NONBLOCK set on fds 0 and 1? (see userprog/fd.c) */
+  unsigned rlimits[RLIMIT_CNT]; /* Resource limits, inherited by children */
+  bool syscall_trace;           /* Log system calls? (see userprog/strace.c) */
   struct file* executable_file; /* Pointer to the running executable file */
+  struct dir* cwd;              /* Current directory, or null for the root */
+  void* heap_start;             /* Start of the heap (see userprog/heap.c) */
+  void* heap_end;               /* Current break */
+  struct lock heap_lock;        /* Serializes sbrk() calls by the process's threads */
+  struct list shm_maps;         /* Attached shared memory (see userprog/shm.c) */
+  struct io_ring* ioring;       /* Kernel address of the system call ring, or null */
+  void* ioring_addr;            /* User address of the system call ring */
+
+  /* Owned by thread.c.  MAGIC must stay last, next to the stack. */
+  bool stack_canary; /* Was the stack filled with the canary pattern? */
+  unsigned magic;    /* Detects stack overflow. */
 };
 
+/* What a parent knows about one of its children.  The child
+   fills in EXIT_STATUS and ups EXITED as it exits, so waiting
+   for one child involves no other thread.  The record is shared
+   by parent and child and freed when both have let go of it, in
+   whichever order they exit.  An exited child's record also goes
+   on the parent's exited_children list, for process_wait_any().
+   The threads of a process have records of the same kind in its
+   main thread's THREADS table, for thread_join(). */
 struct child_process {
-  int tid;
-  struct list_elem elem;
-  int exit_status;
-  bool did_execute;
+  tid_t tid;                    /* Child's thread id. */
+  bool joinable;                /* A thread of the parent's own process? */
+  struct hash_elem elem;        /* Element in the parent's process_children. */
+  struct list_elem exited_elem; /* Element in the parent's exited_children. */
+  bool reported;                /* In the parent's exited_children? */
+  bool waited;                  /* Claimed by a process_wait() call? */
+  int exit_status;              /* Child's exit status, once EXITED is up. */
+  struct semaphore exited;      /* Upped once, when the child exits. */
+  int ref_cnt;                  /* Holders among parent and child. */
 };
 
-struct process_file {
-  int fd;
-  struct file* fileptr;
-  struct list_elem elem;
-};
+/* Slab cache for the structure above */
+extern struct kmem_cache* child_process_cache;
+
+struct child_process* thread_find_child(tid_t tid);
+void thread_forget_child(struct child_process*);
+int thread_join(tid_t tid);
 
 /*
   Load avg is a global, which is also updated to reflect real CPU usage
@@ -192,9 +324,9 @@ struct process_file {
 
   ```load_avg = (59/60)*load_avg + (1/60)*ready_threads```
 
-  We store 100 * recent_cpu to make it simpler to deal as an integer
+  Stored as a fixed-point number
 */
-int load_avg;
+fixed_t load_avg;
 
 /*
   Update the values of recent_cpu for all threads, when
@@ -216,14 +348,38 @@ bool is_mlfqs_priority_update;
    Controlled by kernel command-line option "-o mlfqs". */
 extern bool thread_mlfqs;
 
+/* If false (default), MLFQS statistics are recomputed by a kernel thread.
+   If true, they are recomputed in the timer interrupt.
+   Controlled by kernel command-line option "-mlfqs-tick". */
+extern bool thread_mlfqs_tick;
+
+/* Length of a time slice, in timer ticks (see threads/tunable.c). */
+extern unsigned thread_time_slice;
+
+/* Load balancer tunables.  See thread.c. */
+extern unsigned thread_balance_interval;
+extern unsigned thread_balance_imbalance;
+
+/* Resource limits of the first process, which every later
+   process inherits, indexed by enum rlimit_resource.  Set by the
+   kernel command-line options "-max-frames", "-max-fds" and
+   "-max-children"; RLIM_INFINITY by default. */
+extern unsigned thread_rlimits[RLIMIT_CNT];
+
+struct cpu;
+
 void thread_init(void);
 void thread_start(void);
+void thread_init_idle(struct cpu*, void* page);
 
 void thread_tick(void);
 void thread_print_stats(void);
 
 typedef void thread_func(void* aux);
 tid_t thread_create(const char* name, int priority, thread_func*, void*);
+tid_t thread_create_sibling(const char* name, int priority, thread_func*, void*);
+int thread_create_batch(const char* name, int priority, thread_func*, void* aux[], tid_t tids[],
+                        int cnt);
 
 void thread_block(void);
 void thread_unblock(struct thread*);
@@ -234,6 +390,7 @@ const char* thread_name(void);
 
 void thread_exit(void) NO_RETURN;
 void thread_yield(void);
+void thread_preempt(void);
 
 /* Performs some operation on thread t, given auxiliary data AUX. */
 typedef void thread_action_func(struct thread* t, void* aux);
@@ -241,12 +398,23 @@ void thread_foreach(thread_action_func*, void*);
 
 int thread_get_priority(void);
 void thread_set_priority(int);
+void thread_donate(struct thread* donor, struct thread* donee);
+void thread_refresh_priority(struct thread*);
+bool thread_priority_less(const struct list_elem*, const struct list_elem*, void* aux);
+void thread_yield_if_outranked(void);
+bool thread_preempts(const struct thread*);
+
+bool thread_set_deadline(int runtime, int deadline, int period);
+void thread_yield_period(void);
+bool thread_set_affinity(struct thread*, uint32_t mask);
 
 int thread_get_nice(void);
 void thread_set_nice(int);
 int thread_get_recent_cpu(void);
 int thread_get_load_avg(void);
 
-struct lock global_filesystem_lock;
+enum intr_level thread_stats_begin(void);
+void thread_stats_end(enum intr_level);
+void thread_get_rusage(struct thread*, struct rusage*);
 
 #endif /* threads/thread.h */
@@ -0,0 +1,125 @@
+#include "threads/tracepoint.h"
+#include <debug.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include "devices/timer.h"
+#include "threads/cpu.h"
+#include "threads/interrupt.h"
+#include "threads/palloc.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+
+/* Static tracepoints.
+
+   TRACEPOINT() marks the start and end of work in the file
+   system, the block layer, the page allocator, the page fault
+   handler and the system call entry.  With the -tracepoints
+   option, each one records a fixed-size event, stamped with the
+   time stamp counter and the running thread, in a ring of the
+   CPU it runs on, overwriting the oldest events once the ring is
+   full.  Recording turns interrupts off for a few stores, so it
+   works from any context and needs no lock.  Without the option
+   a tracepoint is a test of tracepoints_enabled.
+
+   At shutdown the rings are dumped as CSV between a
+   "TRACEPOINTS BEGIN" line and a "TRACEPOINTS END" line, one
+   event per line, each CPU's oldest first:
+
+       cpu,tsc,ns,tid,event,phase,arg0,arg1
+
+   where ns is the TSC converted to nanoseconds, or 0 for events
+   recorded before timer_calibrate() started the TSC clock, and
+   phase is B or E.  utils/tracepoint-decode pairs the events
+   into nested spans per thread, which shows where the time of a
+   request went from layer to layer. */
+
+bool tracepoints_enabled;
+
+/* A recorded tracepoint. */
+struct tracepoint {
+  uint64_t tsc;  /* timer_cycles() when recorded. */
+  tid_t tid;     /* Running thread. */
+  uint8_t event; /* enum tracepoint_event. */
+  uint8_t phase; /* enum tracepoint_phase. */
+  uint32_t arg0; /* First argument. */
+  uint32_t arg1; /* Second argument. */
+};
+
+/* Pages in each CPU's ring. */
+#define RING_PAGES 6
+
+/* Number of events each CPU's ring keeps. */
+#define RING_SIZE (RING_PAGES * PGSIZE / sizeof(struct tracepoint))
+
+/* A CPU's ring of events. */
+struct ring {
+  struct tracepoint* events; /* RING_SIZE events, or null before tracepoint_init(). */
+  uint32_t head;             /* Total number of events recorded. */
+};
+
+static struct ring rings[CPU_MAX];
+
+static const char* event_names[TP_EVENT_CNT] = {
+    "syscall", "inode_read", "inode_write", "block_read", "block_write", "palloc", "page_fault",
+};
+
+/* Allocates the rings, if tracepoints are enabled.  Events
+   before this are not recorded. */
+void tracepoint_init(void) {
+  uint8_t* pages;
+  int i;
+
+  if (!tracepoints_enabled)
+    return;
+  pages = palloc_get_multiple(PAL_ASSERT, RING_PAGES * CPU_MAX);
+  for (i = 0; i < CPU_MAX; i++)
+    rings[i].events = (struct tracepoint*)(pages + i * RING_PAGES * PGSIZE);
+}
+
+/* Records PHASE of EVENT with ARG0 and ARG1.  Called through
+   TRACEPOINT(). */
+void tracepoint_record(enum tracepoint_event event, enum tracepoint_phase phase, uint32_t arg0,
+                       uint32_t arg1) {
+  enum intr_level old_level = intr_disable();
+  struct ring* r = &rings[cpu_current()->id];
+
+  if (r->events != NULL) {
+    struct tracepoint* e = &r->events[r->head++ % RING_SIZE];
+
+    e->tsc = timer_cycles();
+    e->tid = thread_current()->tid;
+    e->event = event;
+    e->phase = phase;
+    e->arg0 = arg0;
+    e->arg1 = arg1;
+  }
+  intr_set_level(old_level);
+}
+
+/* Prints the recorded events, if tracepoints are enabled. */
+void tracepoint_dump(void) {
+  uint32_t total = 0, dropped = 0;
+  unsigned cpu;
+
+  if (!tracepoints_enabled)
+    return;
+
+  for (cpu = 0; cpu < CPU_MAX; cpu++) {
+    total += rings[cpu].head;
+    dropped += rings[cpu].head > RING_SIZE ? rings[cpu].head - RING_SIZE : 0;
+  }
+  printf("TRACEPOINTS BEGIN %" PRIu32 " events, %" PRIu32 " dropped\n", total - dropped, dropped);
+  for (cpu = 0; cpu < CPU_MAX; cpu++) {
+    const struct ring* r = &rings[cpu];
+    uint32_t i = r->head > RING_SIZE ? r->head - RING_SIZE : 0;
+
+    for (; i != r->head; i++) {
+      const struct tracepoint* e = &r->events[i % RING_SIZE];
+
+      printf("%u,%" PRIu64 ",%lld,%d,%s,%c,%" PRIu32 ",%" PRIu32 "\n", cpu, e->tsc,
+             timer_cycles_ns(e->tsc), e->tid, event_names[e->event],
+             e->phase == TP_BEGIN ? 'B' : 'E', e->arg0, e->arg1);
+    }
+  }
+  printf("TRACEPOINTS END\n");
+}
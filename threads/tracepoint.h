@@ -0,0 +1,41 @@
+#ifndef THREADS_TRACEPOINT_H
+#define THREADS_TRACEPOINT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Places in the kernel that a tracepoint marks. */
+enum tracepoint_event {
+  TP_SYSCALL,     /* System call: number; result. */
+  TP_INODE_READ,  /* inode_read_at(): inode sector, offset; bytes read. */
+  TP_INODE_WRITE, /* inode_write_at(): inode sector, offset; bytes written. */
+  TP_BLOCK_READ,  /* Block device read: sector, sector count. */
+  TP_BLOCK_WRITE, /* Block device write: sector, sector count. */
+  TP_PALLOC,      /* palloc_get_multiple(): flags, page count; first page. */
+  TP_PAGE_FAULT,  /* Page fault: fault address, error code. */
+  TP_EVENT_CNT    /* Number of events. */
+};
+
+/* Whether a tracepoint starts or ends the work it marks. */
+enum tracepoint_phase {
+  TP_BEGIN, /* Work starts. */
+  TP_END    /* Work ends. */
+};
+
+/* -tracepoints: Record tracepoints and dump them at shutdown? */
+extern bool tracepoints_enabled;
+
+/* Records PHASE of EVENT, with arguments ARG0 and ARG1, if
+   tracepoints are enabled.  Disabled, a tracepoint costs a load
+   and a branch that the compiler lays out as not taken. */
+#define TRACEPOINT(EVENT, PHASE, ARG0, ARG1)                                                       \
+  do {                                                                                             \
+    if (__builtin_expect(tracepoints_enabled, 0))                                                  \
+      tracepoint_record(EVENT, PHASE, (uint32_t)(ARG0), (uint32_t)(ARG1));                        \
+  } while (0)
+
+void tracepoint_init(void);
+void tracepoint_record(enum tracepoint_event, enum tracepoint_phase, uint32_t arg0, uint32_t arg1);
+void tracepoint_dump(void);
+
+#endif /* threads/tracepoint.h */
@@ -0,0 +1,136 @@
+#include "threads/tunable.h"
+#include <debug.h>
+#include <hash.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "threads/palloc.h"
+#include "threads/thread.h"
+#ifdef FILESYS
+#include "devices/ramdisk.h"
+#include "filesys/cache.h"
+#include "filesys/inode.h"
+#endif
+#ifdef VM
+#include "vm/page.h"
+#include "vm/zswap.h"
+#endif
+
+/* Tunables.
+
+   Settings that change how fast the kernel does its work but not
+   what it does, such as the length of a time slice or how far
+   files are read ahead.  Each is an unsigned variable in its own
+   module, with a default that suits most machines; the table
+   here names it and gives the range it may take.  The kernel
+   command line sets any of them with -tune=NAME=VALUE, and the
+   gettunable and settunable system calls read and change them
+   while the kernel runs, so that a machine can be tuned without
+   a rebuild.
+
+   A tunable that sizes a table or decides at boot whether to
+   start a thread takes effect only once, so it may be set only
+   from the command line.  The others are read afresh each time
+   they are used, and a single aligned store changes them, so
+   they need no lock.
+
+   Some constants stay compile-time: TIMER_FREQ, which time is
+   counted in throughout, and the sizes of fixed arrays such as
+   the interrupt queues' and malloc()'s descriptors. */
+
+/* A tunable. */
+struct tunable {
+  const char* name;  /* Name, as MODULE.SETTING. */
+  unsigned* var;     /* Variable that holds it. */
+  unsigned min, max; /* Range of values it may take. */
+  bool boot_only;    /* Settable only from the command line? */
+  const char* doc;   /* Description. */
+};
+
+static const struct tunable tunables[] = {
+    {"sched.time_slice", &thread_time_slice, 1, 1000, false, "ticks each thread runs"},
+    {"sched.balance_interval", &thread_balance_interval, 0, 100000, false,
+     "ticks between run queue rebalances (0: never)"},
+    {"sched.balance_imbalance", &thread_balance_imbalance, 1, 1000, false,
+     "queued threads of imbalance that move a thread"},
+    {"hash.elems_per_bucket", &hash_elems_per_bucket, 1, 64, false,
+     "elements per bucket that hash tables aim for"},
+    {"palloc.colors", &palloc_colors, 0, 1024, true, "physical page colors for user pages"},
+#ifdef FILESYS
+    {"ramdisk.kb", &ramdisk_kb, 0, 1024 * 1024, true, "size of the RAM disk in kB"},
+    {"inode.read_ahead", &inode_read_ahead, 0, 1024, false, "sectors read ahead"},
+    {"inode.cache_max", &inode_cache_max, 0, 100000, false, "closed inodes kept for reuse"},
+    {"cache.flush_interval", &cache_flush_interval, 0, 100000, true,
+     "ticks between writes of dirty sectors (0: never)"},
+    {"cache.dirty_limit", &cache_dirty_limit, 1, 64, false,
+     "dirty sectors above which heavy writers wait"},
+#endif
+#ifdef VM
+    {"vm.stack_limit", &page_stack_limit, 4096, 0x40000000, false, "largest user stack in bytes"},
+    {"vm.fault_around", &page_fault_around, 0, 64, false, "pages read ahead of file faults"},
+    {"vm.zswap_limit", &zswap_limit, 0, 0x40000000, true, "bytes of compressed swap in memory"},
+#endif
+};
+
+#define TUNABLE_CNT (sizeof tunables / sizeof *tunables)
+
+/* Returns the tunable called NAME, or a null pointer if there is
+   none. */
+static const struct tunable* tunable_lookup(const char* name) {
+  size_t i;
+
+  for (i = 0; i < TUNABLE_CNT; i++)
+    if (!strcmp(tunables[i].name, name))
+      return &tunables[i];
+  return NULL;
+}
+
+/* Stores the value of the tunable called NAME in *VALUE.
+   Returns false if there is no such tunable. */
+bool tunable_get(const char* name, unsigned* value) {
+  const struct tunable* t = tunable_lookup(name);
+
+  if (t == NULL)
+    return false;
+  *value = *t->var;
+  return true;
+}
+
+/* Sets the tunable called NAME to VALUE, from the kernel command
+   line if BOOT is true.  Returns false if there is no such
+   tunable, if VALUE is out of its range, or if it may be set only
+   at boot and BOOT is false. */
+bool tunable_set(const char* name, unsigned value, bool boot) {
+  const struct tunable* t = tunable_lookup(name);
+
+  if (t == NULL || value < t->min || value > t->max || (t->boot_only && !boot))
+    return false;
+  *t->var = value;
+  return true;
+}
+
+/* Sets a tunable from ASSIGNMENT, which has the form NAME=VALUE,
+   for the -tune command-line option.  Panics if it cannot. */
+void tunable_option(char* assignment) {
+  char* save_ptr;
+  char* name = assignment != NULL ? strtok_r(assignment, "=", &save_ptr) : NULL;
+  char* value = name != NULL ? strtok_r(NULL, "", &save_ptr) : NULL;
+
+  if (value == NULL)
+    PANIC("-tune needs NAME=VALUE");
+  if (atoi(value) < 0 || !tunable_set(name, atoi(value), true))
+    PANIC("unknown tunable `%s' or value `%s' out of range", name, value);
+}
+
+/* Prints each tunable with its value, range and description. */
+void tunable_print(void) {
+  size_t i;
+
+  printf("\nTunables, set with -tune=NAME=VALUE:\n");
+  for (i = 0; i < TUNABLE_CNT; i++) {
+    const struct tunable* t = &tunables[i];
+
+    printf("  %-24s %u (%u...%u%s): %s\n", t->name, *t->var, t->min, t->max,
+           t->boot_only ? ", boot only" : "", t->doc);
+  }
+}
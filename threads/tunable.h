@@ -0,0 +1,11 @@
+#ifndef THREADS_TUNABLE_H
+#define THREADS_TUNABLE_H
+
+#include <stdbool.h>
+
+bool tunable_get(const char* name, unsigned* value);
+bool tunable_set(const char* name, unsigned value, bool boot);
+void tunable_option(char* assignment);
+void tunable_print(void);
+
+#endif /* threads/tunable.h */
@@ -0,0 +1,84 @@
+#include "threads/vdso.h"
+#include <debug.h>
+#include "devices/timer.h"
+#include "threads/interrupt.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+
+/* The kernel's shared page (see lib/vdso.h).
+
+   The timer interrupt and timer_calibrate() keep its clock
+   fields current, under its sequence number, the way ticks_seq
+   protects the kernel's own tick count.  A user program reads
+   the page directly, so it has to follow the protocol itself; a
+   struct seqlock, private to the kernel, cannot stand in.  The
+   running thread's ids are written at each switch to a thread
+   with a user process, without the sequence number, because only
+   that thread reads them until the next switch.  Only the
+   bootstrap processor runs threads, so one page serves all. */
+
+static struct vdso_data* vdso;
+
+static void write_begin(void);
+static void write_end(void);
+
+/* Allocates the shared page. */
+void vdso_init(void) {
+  vdso = palloc_get_page(PAL_ASSERT | PAL_ZERO);
+  vdso->timer_freq = TIMER_FREQ;
+}
+
+/* Returns the shared page, for mapping into a process. */
+void* vdso_page(void) { return vdso; }
+
+/* Publishes the timer tick count TICKS.  Interrupts must be
+   off. */
+void vdso_set_ticks(int64_t ticks) {
+  write_begin();
+  vdso->ticks = ticks;
+  write_end();
+}
+
+/* Publishes the TSC clock: the TSC runs at TSC_HZ cycles per
+   second and read TSC_START at timer tick TSC_TICKS. */
+void vdso_set_clock(uint64_t tsc_hz, uint64_t tsc_start, int64_t tsc_ticks) {
+  enum intr_level old_level = intr_disable();
+
+  write_begin();
+  vdso->tsc_hz = tsc_hz;
+  vdso->tsc_start = tsc_start;
+  vdso->tsc_ticks = tsc_ticks;
+  write_end();
+  intr_set_level(old_level);
+}
+
+/* Publishes the load average, LOAD_AVG hundredths. */
+void vdso_set_load_avg(int load_avg) {
+  enum intr_level old_level = intr_disable();
+
+  write_begin();
+  vdso->load_avg = load_avg;
+  write_end();
+  intr_set_level(old_level);
+}
+
+/* Publishes the ids of T, which is about to run. */
+void vdso_set_thread(const struct thread* t) {
+  vdso->tid = t->tid;
+  vdso->pid = t->process != NULL ? t->process->tid : t->tid;
+}
+
+/* Starts a change to the clock fields. */
+static void write_begin(void) {
+  ASSERT(intr_get_level() == INTR_OFF);
+  ASSERT(vdso->seq % 2 == 0);
+
+  vdso->seq++;
+  barrier();
+}
+
+/* Ends a change to the clock fields. */
+static void write_end(void) {
+  barrier();
+  vdso->seq++;
+}
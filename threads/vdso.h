@@ -0,0 +1,15 @@
+#ifndef THREADS_VDSO_H
+#define THREADS_VDSO_H
+
+#include <stdint.h>
+#include <vdso.h>
+#include "threads/thread.h"
+
+void vdso_init(void);
+void* vdso_page(void);
+void vdso_set_ticks(int64_t ticks);
+void vdso_set_clock(uint64_t tsc_hz, uint64_t tsc_start, int64_t tsc_ticks);
+void vdso_set_load_avg(int load_avg);
+void vdso_set_thread(const struct thread*);
+
+#endif /* threads/vdso.h */
@@ -0,0 +1,186 @@
+#include "threads/vmalloc.h"
+#include <bitmap.h>
+#include <debug.h>
+#include <round.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "threads/init.h"
+#include "threads/loader.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/pte.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+
+/* Virtually contiguous kernel allocations.
+
+   palloc_get_multiple() needs physically contiguous pages, which
+   a kernel that has run for a while may no longer have even with
+   plenty of memory free.  vmalloc() instead takes single pages
+   from the kernel pool, wherever they are, and maps them next to
+   each other in the vmalloc area, a range of kernel virtual
+   addresses above the RAM mapped at PHYS_BASE and the kmap area
+   (see threads/highmem.c), and below the device registers that
+   init_map_device() maps.
+
+   The area's page tables are made by vmalloc_init(), before the
+   first process starts, so that every page directory that
+   pagedir_create() copies from init_page_dir shares them, and
+   vmalloc() and vfree() only ever change their entries.  Each
+   allocation is followed by an unmapped guard page, which
+   catches overruns and tells vfree() where the allocation ends.
+
+   Memory from vmalloc() is not physically contiguous, so it must
+   not be handed to a device, whose DMA goes by vtop().  It suits
+   large tables that live long and grow, such as hash bucket
+   arrays and file descriptor tables; kvmalloc() picks malloc()
+   or vmalloc() for them by size. */
+
+/* The vmalloc area: 16 MB below the device registers. */
+#define VMALLOC_BASE ((uint8_t*)0xdf000000)
+#define VMALLOC_PAGES 4096
+
+static struct bitmap* used_pages; /* Pages of the area in use, guard pages included. */
+static struct lock vmalloc_lock;  /* Protects used_pages. */
+static bool vmalloc_ready;        /* Has vmalloc_init() run? */
+
+/* Statistics. */
+static long long alloc_cnt; /* Allocations. */
+static long long fail_cnt;  /* Allocations that failed. */
+static size_t mapped_pages; /* Pages mapped now. */
+static size_t peak_pages;   /* Most pages mapped at once. */
+
+static size_t unmap_pages(uint8_t* base, size_t max_cnt);
+static uint32_t* lookup_pte(const void* vaddr);
+
+/* Creates the page tables of the vmalloc area in init_page_dir.
+   Must be called after paging_init() and before the first
+   process starts. */
+void vmalloc_init(void) {
+  static uint8_t bitmap_buf[VMALLOC_PAGES / 8 + 64]; /* With room for struct bitmap. */
+  uint8_t* vaddr;
+
+  ASSERT((uintptr_t)ptov(init_lowmem_pages * PGSIZE) <= (uintptr_t)VMALLOC_BASE);
+
+  for (vaddr = VMALLOC_BASE; vaddr < VMALLOC_BASE + VMALLOC_PAGES * PGSIZE; vaddr += PTSPAN)
+    init_page_dir[pd_no(vaddr)] = pde_create(palloc_get_page(PAL_ASSERT | PAL_ZERO));
+  used_pages = bitmap_create_in_buf(VMALLOC_PAGES, bitmap_buf, sizeof bitmap_buf);
+  lock_init(&vmalloc_lock);
+  vmalloc_ready = true;
+}
+
+/* Allocates SIZE bytes, page-aligned, from pages of the kernel
+   pool that need not be contiguous.  Returns a null pointer if
+   the vmalloc area or the kernel pool runs out. */
+void* vmalloc(size_t size) {
+  size_t page_cnt = DIV_ROUND_UP(size, PGSIZE);
+  size_t idx, i;
+  uint8_t* base;
+
+  ASSERT(vmalloc_ready);
+
+  if (page_cnt == 0)
+    return NULL;
+  lock_acquire(&vmalloc_lock);
+  idx = bitmap_scan_and_flip(used_pages, 0, page_cnt + 1, false);
+  if (idx == BITMAP_ERROR) {
+    fail_cnt++;
+    lock_release(&vmalloc_lock);
+    return NULL;
+  }
+  lock_release(&vmalloc_lock);
+
+  base = VMALLOC_BASE + idx * PGSIZE;
+  for (i = 0; i < page_cnt; i++) {
+    void* page = palloc_get_page(0);
+    if (page == NULL) {
+      unmap_pages(base, i);
+      lock_acquire(&vmalloc_lock);
+      bitmap_set_multiple(used_pages, idx, page_cnt + 1, false);
+      fail_cnt++;
+      lock_release(&vmalloc_lock);
+      return NULL;
+    }
+    *lookup_pte(base + i * PGSIZE) = pte_create_kernel(page, true);
+  }
+
+  lock_acquire(&vmalloc_lock);
+  alloc_cnt++;
+  mapped_pages += page_cnt;
+  if (mapped_pages > peak_pages)
+    peak_pages = mapped_pages;
+  lock_release(&vmalloc_lock);
+  return base;
+}
+
+/* Frees P, which vmalloc() returned, and its pages. */
+void vfree(void* p) {
+  uint8_t* base = p;
+  size_t idx = (base - VMALLOC_BASE) / PGSIZE;
+  size_t page_cnt;
+
+  ASSERT(is_vmalloc_addr(p) && pg_ofs(p) == 0);
+
+  /* The guard page ends the allocation. */
+  page_cnt = unmap_pages(base, VMALLOC_PAGES - idx);
+  lock_acquire(&vmalloc_lock);
+  bitmap_set_multiple(used_pages, idx, page_cnt + 1, false);
+  mapped_pages -= page_cnt;
+  lock_release(&vmalloc_lock);
+}
+
+/* Returns true if P is in the vmalloc area. */
+bool is_vmalloc_addr(const void* p) {
+  const uint8_t* vaddr = p;
+  return vaddr >= VMALLOC_BASE && vaddr < VMALLOC_BASE + VMALLOC_PAGES * PGSIZE;
+}
+
+/* Allocates SIZE bytes with malloc() if they fit in a page, and
+   with vmalloc() otherwise, so that a table that grows past a
+   page never needs contiguous pages.  Before vmalloc_init(),
+   always uses malloc().  Free the block with kvfree(). */
+void* kvmalloc(size_t size) {
+  if (size <= PGSIZE || !vmalloc_ready)
+    return malloc(size);
+  return vmalloc(size);
+}
+
+/* Frees P, which kvmalloc() returned. */
+void kvfree(void* p) {
+  if (is_vmalloc_addr(p))
+    vfree(p);
+  else
+    free(p);
+}
+
+/* Prints vmalloc statistics. */
+void vmalloc_print_stats(void) {
+  printf("vmalloc: %lld allocations, %lld failed, %zu pages mapped (peak %zu)\n", alloc_cnt,
+         fail_cnt, mapped_pages, peak_pages);
+}
+
+/* Unmaps and frees the pages mapped from BASE on, up to the
+   first unmapped page or MAX_CNT pages, and returns how many
+   there were. */
+static size_t unmap_pages(uint8_t* base, size_t max_cnt) {
+  size_t cnt;
+
+  for (cnt = 0; cnt < max_cnt; cnt++) {
+    uint8_t* vaddr = base + cnt * PGSIZE;
+    uint32_t* pte = lookup_pte(vaddr);
+
+    if ((*pte & PTE_P) == 0)
+      break;
+    palloc_free_page(pte_get_page(*pte));
+    *pte = 0;
+    asm volatile("invlpg (%0)" : : "r"(vaddr) : "memory");
+  }
+  return cnt;
+}
+
+/* Returns the page table entry for VADDR, which must be in the
+   vmalloc area. */
+static uint32_t* lookup_pte(const void* vaddr) {
+  ASSERT(is_vmalloc_addr(vaddr));
+  return pde_get_pt(init_page_dir[pd_no(vaddr)]) + pt_no(vaddr);
+}
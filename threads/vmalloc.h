@@ -0,0 +1,15 @@
+#ifndef THREADS_VMALLOC_H
+#define THREADS_VMALLOC_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+void vmalloc_init(void);
+void* vmalloc(size_t size);
+void vfree(void*);
+bool is_vmalloc_addr(const void*);
+void* kvmalloc(size_t size);
+void kvfree(void*);
+void vmalloc_print_stats(void);
+
+#endif /* threads/vmalloc.h */
@@ -0,0 +1,95 @@
+#include "threads/waitq.h"
+#include <debug.h>
+#include "devices/timer.h"
+#include "threads/interrupt.h"
+#include "threads/thread.h"
+
+/* Wait queues.
+
+   Lets one thread wait for any of several objects at once, as
+   poll() does.  The waiter puts an entry in the wait queue of
+   each object it cares about, checks whether any of them is
+   ready already, and if not calls waitq_wait().  An object calls
+   waitq_wake() whenever it may have become ready, which marks
+   each of its waiters ready and unblocks those that are waiting.
+   A wakeup between the check and the wait is not lost, because
+   the entry is queued before the check and waitq_wait() returns
+   at once for a waiter already marked ready.  A wakeup says only
+   that something may have changed, so the waiter checks again.
+
+   The queues are protected by turning interrupts off, so that
+   interrupt handlers, such as the keyboard's, may wake them. */
+
+/* Initializes Q as an empty wait queue. */
+void waitq_init(struct waitq* q) { list_init(&q->entries); }
+
+/* Puts E, which wakes W, into Q. */
+void waitq_add(struct waitq* q, struct waitq_entry* e, struct waitq_waiter* w) {
+  enum intr_level old_level = intr_disable();
+
+  ASSERT(!e->queued);
+  e->owner = w;
+  e->queued = true;
+  list_push_back(&q->entries, &e->elem);
+  intr_set_level(old_level);
+}
+
+/* Takes E out of its wait queue, if it is in one. */
+void waitq_remove(struct waitq_entry* e) {
+  enum intr_level old_level = intr_disable();
+
+  if (e->queued) {
+    list_remove(&e->elem);
+    e->queued = false;
+  }
+  intr_set_level(old_level);
+}
+
+/* Wakes every waiter in Q.  May be called from an interrupt
+   handler. */
+void waitq_wake(struct waitq* q) {
+  enum intr_level old_level = intr_disable();
+  struct list_elem* e;
+
+  for (e = list_begin(&q->entries); e != list_end(&q->entries); e = list_next(e)) {
+    struct waitq_waiter* w = list_entry(e, struct waitq_entry, elem)->owner;
+
+    w->ready = true;
+    if (w->waiting && w->thread->status == THREAD_BLOCKED) {
+      w->waiting = false;
+      timer_wake(w->thread);
+    }
+  }
+  intr_set_level(old_level);
+}
+
+/* Initializes W as a waiter for the running thread. */
+void waitq_waiter_init(struct waitq_waiter* w) {
+  w->thread = thread_current();
+  w->ready = false;
+  w->waiting = false;
+}
+
+/* Waits until a queue that W has an entry in is woken, or until
+   TICKS timer ticks have passed if TICKS is not negative.
+   Returns true if a queue was woken, since W was initialized or
+   since the last call, and false on a timeout. */
+bool waitq_wait(struct waitq_waiter* w, int64_t ticks) {
+  enum intr_level old_level = intr_disable();
+  bool ready;
+
+  ASSERT(w->thread == thread_current());
+
+  if (!w->ready && ticks != 0) {
+    w->waiting = true;
+    if (ticks < 0)
+      thread_block();
+    else
+      timer_block(ticks);
+    w->waiting = false;
+  }
+  ready = w->ready;
+  w->ready = false;
+  intr_set_level(old_level);
+  return ready;
+}
@@ -0,0 +1,38 @@
+#ifndef THREADS_WAITQ_H
+#define THREADS_WAITQ_H
+
+#include <list.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+struct thread;
+
+/* A queue of threads waiting for an object, such as a pipe or
+   the keyboard buffer, to become ready. */
+struct waitq {
+  struct list entries; /* Waiters' entries. */
+};
+
+/* A thread that waits on one or more wait queues at once. */
+struct waitq_waiter {
+  struct thread* thread; /* Waiting thread. */
+  bool ready;            /* Woken since the last waitq_wait()? */
+  bool waiting;          /* Blocked in waitq_wait()? */
+};
+
+/* A waiter's place in one wait queue. */
+struct waitq_entry {
+  struct list_elem elem;      /* Element in the queue's `entries'. */
+  struct waitq_waiter* owner; /* Waiter to wake. */
+  bool queued;                /* In a queue? */
+};
+
+void waitq_init(struct waitq*);
+void waitq_add(struct waitq*, struct waitq_entry*, struct waitq_waiter*);
+void waitq_remove(struct waitq_entry*);
+void waitq_wake(struct waitq*);
+
+void waitq_waiter_init(struct waitq_waiter*);
+bool waitq_wait(struct waitq_waiter*, int64_t ticks);
+
+#endif /* threads/waitq.h */
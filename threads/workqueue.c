@@ -0,0 +1,144 @@
+#include "threads/workqueue.h"
+#include <debug.h>
+#include <stdio.h>
+#include "threads/interrupt.h"
+#include "threads/synch.h"
+
+/* Kernel workqueue.
+
+   Rather than each kind of background work having a thread of
+   its own, with a stack page and a place in the scheduler that
+   are idle most of the time, kernel code queues a struct work
+   with work_queue() and one of a fixed pool of WORKER_CNT worker
+   threads calls its function.  Each work_priority level has its
+   own queue, and a worker always takes the first work of the
+   most urgent level that has any, running it at that level's
+   thread priority.
+
+   A work is queued at most once at a time: queuing a work that
+   is already queued does nothing.  Nor does it ever run in two
+   workers at once: a work queued while it runs is queued again
+   only when it returns.  So a function that handles everything
+   that has been asked of it by the time it returns, like the
+   loops of the daemons it replaces, can be queued each time
+   there is something new to do and never misses any of it.
+
+   The queues are protected by disabling interrupts, so work may
+   be queued from interrupt context, including deferred
+   interrupt work. */
+
+/* Number of worker threads. */
+#define WORKER_CNT 4
+
+/* Thread priority that a worker runs each level's work at. */
+static const int level_priority[WORK_PRI_CNT] = {
+    [WORK_HIGH] = PRI_DEFAULT + 10,
+    [WORK_NORMAL] = PRI_DEFAULT,
+    [WORK_LOW] = PRI_MIN + 1,
+};
+
+static struct list queues[WORK_PRI_CNT]; /* Queued work, by level. */
+static struct semaphore queued_sema;     /* Counts queued work. */
+
+/* Statistics. */
+static long long run_cnt[WORK_PRI_CNT]; /* Work run at each level. */
+static long long requeue_cnt;           /* Work queued while it ran. */
+static int busy_cnt;                    /* Workers running work. */
+static int max_busy_cnt;                /* Most workers busy at once. */
+
+static thread_func worker;
+static void enqueue(struct work*);
+
+/* Initializes the workqueue and starts its workers.  Called
+   once the scheduler runs. */
+void workqueue_init(void) {
+  int i;
+
+  for (i = 0; i < WORK_PRI_CNT; i++)
+    list_init(&queues[i]);
+  sema_init(&queued_sema, 0);
+  for (i = 0; i < WORKER_CNT; i++) {
+    char name[16];
+
+    snprintf(name, sizeof name, "worker%d", i);
+    if (thread_create(name, PRI_DEFAULT, worker, NULL) == TID_ERROR)
+      PANIC("workqueue: worker creation failed");
+  }
+}
+
+/* Initializes W as work that calls FUNC, passing AUX. */
+void work_init(struct work* w, thread_func* func, void* aux) {
+  w->func = func;
+  w->aux = aux;
+  w->pri = WORK_NORMAL;
+  w->pending = w->running = false;
+}
+
+/* Queues W to be run at level PRI.  Returns false if W was
+   already queued, in which case it keeps its place. */
+bool work_queue(struct work* w, enum work_priority pri) {
+  enum intr_level old_level;
+  bool queued;
+
+  ASSERT(pri < WORK_PRI_CNT);
+
+  old_level = intr_disable();
+  queued = !w->pending;
+  if (queued) {
+    w->pending = true;
+    w->pri = pri;
+    if (w->running)
+      requeue_cnt++;
+    else
+      enqueue(w);
+  }
+  intr_set_level(old_level);
+  return queued;
+}
+
+/* Prints workqueue statistics. */
+void workqueue_print_stats(void) {
+  printf("Workqueue: %lld high, %lld normal, %lld low priority work run, %lld requeued, "
+         "%d of %d workers busy at most\n",
+         run_cnt[WORK_HIGH], run_cnt[WORK_NORMAL], run_cnt[WORK_LOW], requeue_cnt, max_busy_cnt,
+         WORKER_CNT);
+}
+
+/* Adds pending work W to the end of its level's queue. */
+static void enqueue(struct work* w) {
+  ASSERT(intr_get_level() == INTR_OFF);
+
+  list_push_back(&queues[w->pri], &w->elem);
+  sema_up(&queued_sema);
+}
+
+/* A worker thread.  Runs queued work, most urgent first. */
+static void worker(void* aux UNUSED) {
+  for (;;) {
+    enum intr_level old_level;
+    struct work* w;
+    int pri;
+
+    sema_down(&queued_sema);
+    old_level = intr_disable();
+    for (pri = 0; list_empty(&queues[pri]); pri++)
+      ASSERT(pri < WORK_PRI_CNT - 1);
+    w = list_entry(list_pop_front(&queues[pri]), struct work, elem);
+    w->pending = false;
+    w->running = true;
+    run_cnt[pri]++;
+    if (++busy_cnt > max_busy_cnt)
+      max_busy_cnt = busy_cnt;
+    intr_set_level(old_level);
+
+    thread_set_priority(level_priority[pri]);
+    w->func(w->aux);
+
+    old_level = intr_disable();
+    w->running = false;
+    if (w->pending)
+      enqueue(w);
+    busy_cnt--;
+    intr_set_level(old_level);
+  }
+}
@@ -0,0 +1,33 @@
+#ifndef THREADS_WORKQUEUE_H
+#define THREADS_WORKQUEUE_H
+
+#include <list.h>
+#include <stdbool.h>
+#include "threads/thread.h"
+
+/* Urgency of work.  Queued work of a more urgent level runs
+   first, and its worker thread runs at a higher priority. */
+enum work_priority {
+  WORK_HIGH,   /* Others are waiting for it. */
+  WORK_NORMAL, /* Ordinary background work. */
+  WORK_LOW,    /* Only worth doing when the CPU is otherwise idle. */
+  WORK_PRI_CNT /* Number of levels. */
+};
+
+/* A piece of work: FUNC is called with AUX by a worker thread.
+   Must stay valid as long as it is queued or running. */
+struct work {
+  struct list_elem elem;  /* Element in a queue. */
+  thread_func* func;      /* Function to call. */
+  void* aux;              /* Its argument. */
+  enum work_priority pri; /* Level it is queued at. */
+  bool pending;           /* Queued, and not yet started? */
+  bool running;           /* Being run by a worker? */
+};
+
+void workqueue_init(void);
+void work_init(struct work*, thread_func*, void* aux);
+bool work_queue(struct work*, enum work_priority);
+void workqueue_print_stats(void);
+
+#endif /* threads/workqueue.h */
@@ -4,14 +4,24 @@
 #include "userprog/gdt.h"
 #include "userprog/handlers.h"
 #include "userprog/syscall.h"
+#include "threads/fpu.h"
 #include "threads/interrupt.h"
+#include "threads/kstat.h"
+#include "threads/percpu.h"
 #include "threads/thread.h"
+#include "threads/tracepoint.h"
+#include "threads/vaddr.h"
+#ifdef VM
+#include "vm/frame.h"
+#include "vm/page.h"
+#endif
 
 /* Number of page faults processed. */
-static long long page_fault_cnt;
+static struct percpu_counter page_fault_cnt;
 
 static void kill(struct intr_frame*);
 static void page_fault(struct intr_frame*);
+static void device_not_available(struct intr_frame*);
 
 /* Registers handlers for interrupts that can be caused by user
    programs.
@@ -44,7 +54,7 @@ void exception_init(void) {
   intr_register_int(0, 0, INTR_ON, kill, "#DE Divide Error");
   intr_register_int(1, 0, INTR_ON, kill, "#DB Debug Exception");
   intr_register_int(6, 0, INTR_ON, kill, "#UD Invalid Opcode Exception");
-  intr_register_int(7, 0, INTR_ON, kill, "#NM Device Not Available Exception");
+  intr_register_int(7, 0, INTR_ON, device_not_available, "#NM Device Not Available Exception");
   intr_register_int(11, 0, INTR_ON, kill, "#NP Segment Not Present");
   intr_register_int(12, 0, INTR_ON, kill, "#SS Stack Fault Exception");
   intr_register_int(13, 0, INTR_ON, kill, "#GP General Protection Exception");
@@ -55,10 +65,21 @@ void exception_init(void) {
      We need to disable interrupts for page faults because the
      fault address is stored in CR2 and needs to be preserved. */
   intr_register_int(14, 0, INTR_OFF, page_fault, "#PF Page-Fault Exception");
+
+  kstat_percpu("exception.page_faults", &page_fault_cnt);
 }
 
 /* Prints exception statistics. */
-void exception_print_stats(void) { printf("Exception: %lld page faults\n", page_fault_cnt); }
+void exception_print_stats(void) {
+#ifdef VM
+  printf("Exception: %lld page faults, %lld avoided by fault-around (%lld pages read ahead)\n",
+         percpu_read(&page_fault_cnt), page_prefetch_hits, page_prefetch_cnt);
+  printf("Exception: %lld zero page mappings, %lld replaced on write\n", page_zero_maps,
+         page_zero_copies);
+#else
+  printf("Exception: %lld page faults\n", percpu_read(&page_fault_cnt));
+#endif
+}
 
 /* Handler for an exception (probably) caused by a user process. */
 static void kill(struct intr_frame* f) {
@@ -98,6 +119,15 @@ static void kill(struct intr_frame* f) {
   }
 }
 
+/* Handler for #NM, raised by the first floating-point
+   instruction of a thread that does not own the FPU.  Loads the
+   thread's registers, or kills the process if there is no memory
+   for them. */
+static void device_not_available(struct intr_frame* f) {
+  if (!fpu_load())
+    kill(f);
+}
+
 /* Page fault handler.  This is a skeleton that must be filled in
    to implement virtual memory.  Some solutions to project 2 may
    also require modifying this code.
@@ -129,16 +159,45 @@ static void page_fault(struct intr_frame* f) {
   intr_enable();
 
   /* Count page faults. */
-  page_fault_cnt++;
+  percpu_inc(&page_fault_cnt);
+  TRACEPOINT(TP_PAGE_FAULT, TP_BEGIN, fault_addr, f->error_code);
 
   /* Determine cause. */
   not_present = (f->error_code & PF_P) == 0;
   write = (f->error_code & PF_W) != 0;
   user = (f->error_code & PF_U) != 0;
 
-  /* To implement virtual memory, delete the rest of the function
-     body, and replace it with code that brings in the page to
-     which fault_addr refers. */
+#ifdef VM
+  /* A process suspended for thrashing waits at its faults. */
+  if (user)
+    frame_throttle();
+
+  /* Bring in the page if it is part of the process's address
+     space but not loaded yet, or grow the stack.  The kernel
+     faults on user pages too, when it touches the buffers passed
+     to system calls, and then the user stack pointer is the one
+     saved by syscall_handler(). */
+  if (not_present && is_user_vaddr(fault_addr)) {
+    void* esp = user ? f->esp : thread_current()->user_esp;
+    if (page_in(fault_addr, write) || page_grow_stack(fault_addr, esp)) {
+      TRACEPOINT(TP_PAGE_FAULT, TP_END, fault_addr, f->error_code);
+      return;
+    }
+  }
+
+  /* A write to a page shared copy-on-write since a fork(), or to
+     the zero page. */
+  if (!not_present && write && is_user_vaddr(fault_addr) && page_cow(fault_addr)) {
+    TRACEPOINT(TP_PAGE_FAULT, TP_END, fault_addr, f->error_code);
+    return;
+  }
+
+  /* The kernel touched a bad user address on behalf of the
+     process.  That's the process's fault, not a kernel bug. */
+  if (!user && is_user_vaddr(fault_addr))
+    SYSCALL_exit_handler(-1);
+#endif
+
   printf("Page fault at %p: %s error %s page in %s context.\n", fault_addr,
          not_present ? "not present" : "rights violation", write ? "writing" : "reading",
          user ? "user" : "kernel");
@@ -0,0 +1,374 @@
+#include "userprog/fd.h"
+#include <debug.h>
+#include <fcntl.h>
+#include <string.h>
+#include "filesys/file.h"
+#include "filesys/inode.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vmalloc.h"
+#include "userprog/pipe.h"
+
+/* File descriptor table.
+
+   Each process keeps its open files in an array indexed by file
+   descriptor, so looking up a descriptor takes constant time no
+   matter how many files are open.  Descriptors 0 and 1 are the
+   console and never have an entry.  A new file gets the lowest
+   free descriptor, as in POSIX; `fd_free' remembers that no
+   descriptor below it is free, so the search rarely looks at
+   more than one entry.  The array starts out empty and doubles
+   in size whenever it fills up.  Once it outgrows a page it
+   comes from vmalloc() (see kvmalloc()), so a process with many
+   files open needs no contiguous pages for its table.
+
+   A process may not use descriptors at or above its
+   RLIMIT_NOFILE limit, which also bounds the table's size.
+
+   An entry holds either an open file or one end of a pipe.
+   fd_lookup() only finds files and fd_lookup_pipe() only pipes,
+   so the file system calls fail cleanly on a pipe.  An open file
+   may be a directory, whose data fd_lookup_file() keeps the
+   calls that read and write bytes away from.  An entry also
+   holds the descriptor's O_NONBLOCK flag; the console's flags
+   live in the process, as console_nonblock[].
+
+   All of a process's threads share its table, which its main
+   thread holds.  The functions here that change or search the
+   table hold the process's fd_lock while they do.  A file that
+   one thread closes while another reads or writes it is the
+   program's own race, as it is in POSIX. */
+
+/* Smallest descriptor handed out. */
+#define FD_MIN 2
+
+/* Entries in a table's first allocation. */
+#define FD_INIT_CNT 16
+
+static bool fd_grow(struct thread*);
+static bool fd_copy(struct thread* parent, bool files);
+static void fd_release(struct fd_entry*);
+
+/* Returns the current process's entry for FD, or a null pointer
+   if FD is out of range.  The caller must hold fd_lock. */
+static struct fd_entry* fd_entry(int fd) {
+  struct thread* t = thread_current()->process;
+
+  return fd >= FD_MIN && fd < t->fd_cnt ? &t->fds[fd] : NULL;
+}
+
+/* Returns a free descriptor in the current process's table, or
+   -1 if memory runs out or every descriptor below the process's
+   RLIMIT_NOFILE limit is in use.  The caller must hold
+   fd_lock. */
+static int fd_alloc(void) {
+  struct thread* t = thread_current()->process;
+  int fd;
+
+  for (fd = t->fd_free; fd < t->fd_cnt; fd++)
+    if (t->fds[fd].file == NULL && t->fds[fd].pipe == NULL)
+      break;
+  if ((unsigned)fd >= t->rlimits[RLIMIT_NOFILE])
+    return -1;
+  if (fd >= t->fd_cnt && !fd_grow(t))
+    return -1;
+  t->fd_free = fd + 1;
+  return fd;
+}
+
+/* Adds FILE to the current process's table and returns its new
+   descriptor, or returns -1 if memory runs out or the process
+   has too many descriptors. */
+int fd_install(struct file* file) {
+  struct thread* t = thread_current()->process;
+  int fd;
+
+  lock_acquire(&t->fd_lock);
+  fd = fd_alloc();
+  if (fd >= 0)
+    t->fds[fd].file = file;
+  lock_release(&t->fd_lock);
+  return fd;
+}
+
+/* Adds the write end of PIPE, if WRITER is true, or its read end
+   otherwise, to the current process's table and returns its new
+   descriptor, or returns -1 if memory runs out or the process
+   has too many descriptors. */
+int fd_install_pipe(struct pipe* pipe, bool writer) {
+  struct thread* t = thread_current()->process;
+  int fd;
+
+  lock_acquire(&t->fd_lock);
+  fd = fd_alloc();
+  if (fd >= 0) {
+    t->fds[fd].pipe = pipe;
+    t->fds[fd].writer = writer;
+  }
+  lock_release(&t->fd_lock);
+  return fd;
+}
+
+/* Returns the current process's file open as FD, or a null
+   pointer if FD is not an open file. */
+struct file* fd_lookup(int fd) {
+  struct lock* lock = &thread_current()->process->fd_lock;
+  struct fd_entry* e;
+  struct file* file;
+
+  lock_acquire(lock);
+  e = fd_entry(fd);
+  file = e != NULL ? e->file : NULL;
+  lock_release(lock);
+  return file;
+}
+
+/* Returns the current process's file open as FD, or a null
+   pointer if FD is not an open file or is a directory. */
+struct file* fd_lookup_file(int fd) {
+  struct file* file = fd_lookup(fd);
+
+  return file != NULL && !inode_is_dir(file_get_inode(file)) ? file : NULL;
+}
+
+/* Returns the pipe whose write end, if WRITER is true, or read
+   end otherwise, the current process has open as FD, or a null
+   pointer if FD is not that end of a pipe. */
+struct pipe* fd_lookup_pipe(int fd, bool writer) {
+  struct lock* lock = &thread_current()->process->fd_lock;
+  struct fd_entry* e;
+  struct pipe* pipe;
+
+  lock_acquire(lock);
+  e = fd_entry(fd);
+  pipe = e != NULL && e->pipe != NULL && e->writer == writer ? e->pipe : NULL;
+  lock_release(lock);
+  return pipe;
+}
+
+/* Returns the pipe that the current process has one end of open
+   as FD, and sets *WRITER to whether it is the write end, or
+   returns a null pointer if FD is not a pipe.  Counts another
+   descriptor open on that end (see pipe_dup()), so that the pipe
+   stays around even if FD is closed, until the caller calls
+   pipe_close(). */
+struct pipe* fd_get_pipe(int fd, bool* writer) {
+  struct lock* lock = &thread_current()->process->fd_lock;
+  struct fd_entry* e;
+  struct pipe* pipe = NULL;
+
+  lock_acquire(lock);
+  e = fd_entry(fd);
+  if (e != NULL && e->pipe != NULL) {
+    pipe = e->pipe;
+    *writer = e->writer;
+    pipe_dup(pipe, *writer);
+  }
+  lock_release(lock);
+  return pipe;
+}
+
+/* Returns the <fcntl.h> flags of the current process's
+   descriptor FD: O_NONBLOCK, and O_DIRECT and O_APPEND for a
+   file.  Returns -1 if FD is not open. */
+int fd_get_flags(int fd) {
+  struct thread* t = thread_current()->process;
+  struct fd_entry* e;
+  int flags = -1;
+
+  if (fd >= 0 && fd < FD_MIN)
+    return t->console_nonblock[fd] ? O_NONBLOCK : 0;
+
+  lock_acquire(&t->fd_lock);
+  e = fd_entry(fd);
+  if (e != NULL && (e->file != NULL || e->pipe != NULL)) {
+    flags = e->nonblock ? O_NONBLOCK : 0;
+    if (e->file != NULL && file_is_direct(e->file))
+      flags |= O_DIRECT;
+    if (e->file != NULL && file_is_append(e->file))
+      flags |= O_APPEND;
+  }
+  lock_release(&t->fd_lock);
+  return flags;
+}
+
+/* Sets the <fcntl.h> flags of the current process's descriptor
+   FD to FLAGS.  Returns false if FD is not open, if FLAGS has
+   unknown flags, or if it has O_DIRECT or O_APPEND for something
+   other than a file that is not a directory. */
+bool fd_set_flags(int fd, int flags) {
+  struct thread* t = thread_current()->process;
+  bool direct = (flags & O_DIRECT) != 0;
+  bool append = (flags & O_APPEND) != 0;
+  struct fd_entry* e;
+  bool ok;
+
+  if ((flags & ~(O_DIRECT | O_NONBLOCK | O_APPEND)) != 0)
+    return false;
+  if (fd >= 0 && fd < FD_MIN) {
+    if (direct || append)
+      return false;
+    t->console_nonblock[fd] = (flags & O_NONBLOCK) != 0;
+    return true;
+  }
+
+  lock_acquire(&t->fd_lock);
+  e = fd_entry(fd);
+  if (e != NULL && e->file != NULL)
+    ok = !(direct || append) || !inode_is_dir(file_get_inode(e->file));
+  else
+    ok = e != NULL && e->pipe != NULL && !direct && !append;
+  if (ok) {
+    e->nonblock = (flags & O_NONBLOCK) != 0;
+    if (e->file != NULL) {
+      file_set_direct(e->file, direct);
+      file_set_append(e->file, append);
+    }
+  }
+  lock_release(&t->fd_lock);
+  return ok;
+}
+
+/* Returns true if the current process's descriptor FD is open
+   and has O_NONBLOCK set. */
+bool fd_nonblock(int fd) {
+  int flags = fd_get_flags(fd);
+
+  return flags >= 0 && (flags & O_NONBLOCK) != 0;
+}
+
+/* Closes the current process's file or pipe end open as FD.
+   Returns false if FD is not open. */
+bool fd_close(int fd) {
+  struct thread* t = thread_current()->process;
+  struct fd_entry* e;
+  bool ok;
+
+  lock_acquire(&t->fd_lock);
+  e = fd_entry(fd);
+  ok = e != NULL && (e->file != NULL || e->pipe != NULL);
+  if (ok) {
+    fd_release(e);
+    if (fd < t->fd_free)
+      t->fd_free = fd;
+  }
+  lock_release(&t->fd_lock);
+  return ok;
+}
+
+/* Closes all of the current process's files and pipes and frees
+   its table.  The table is detached first, then the pipe ends
+   are closed, so that readers and writers at the other ends see
+   end of file or a broken pipe without waiting for the files.
+   Closing a file that is open elsewhere too takes no file system
+   lock (see inode_close()).  Called when the process's other
+   threads are gone, so it needs no lock. */
+void fd_close_all(void) {
+  struct thread* t = thread_current();
+  struct fd_entry* fds = t->fds;
+  int cnt = t->fd_cnt;
+  int fd;
+
+  t->fds = NULL;
+  t->fd_cnt = 0;
+  t->fd_free = FD_MIN;
+
+  for (fd = FD_MIN; fd < cnt; fd++)
+    if (fds[fd].pipe != NULL)
+      fd_release(&fds[fd]);
+  for (fd = FD_MIN; fd < cnt; fd++)
+    fd_release(&fds[fd]);
+  kvfree(fds);
+}
+
+/* Gives the current process, whose table must be empty, its own
+   copies of PARENT's open files and pipe ends, under the same
+   descriptors, with files at the same positions.  Returns false
+   if memory runs out. */
+bool fd_fork(struct thread* parent) { return fd_copy(parent, true); }
+
+/* Gives the current process, whose table must be empty, PARENT's
+   pipe ends under the same descriptors, but none of its files,
+   as exec() does.  Returns false if memory runs out. */
+bool fd_inherit_pipes(struct thread* parent) { return fd_copy(parent, false); }
+
+/* Copies PARENT's pipe ends, and its files if FILES is true,
+   into the current process's empty table.  PARENT's other threads
+   may still be running, so its fd_lock is held meanwhile.
+   Returns false if memory runs out. */
+static bool fd_copy(struct thread* parent, bool files) {
+  struct thread* t = thread_current();
+  bool ok = true;
+  int fd;
+
+  ASSERT(t->fds == NULL);
+
+  lock_acquire(&parent->fd_lock);
+  memcpy(t->console_nonblock, parent->console_nonblock, sizeof t->console_nonblock);
+  if (parent->fd_cnt == 0)
+    goto done;
+  t->fds = kvmalloc(parent->fd_cnt * sizeof *t->fds);
+  if (t->fds == NULL) {
+    ok = false;
+    goto done;
+  }
+  memset(t->fds, 0, parent->fd_cnt * sizeof *t->fds);
+  t->fd_cnt = parent->fd_cnt;
+  t->fd_free = files ? parent->fd_free : FD_MIN;
+
+  for (fd = FD_MIN; fd < parent->fd_cnt && ok; fd++) {
+    const struct fd_entry* pe = &parent->fds[fd];
+    struct fd_entry* e = &t->fds[fd];
+
+    if (pe->pipe != NULL) {
+      pipe_dup(pe->pipe, pe->writer);
+      *e = *pe;
+    } else if (pe->file != NULL && files) {
+      e->file = file_reopen(pe->file);
+      if (e->file == NULL)
+        ok = false;
+      else {
+        file_seek(e->file, file_tell(pe->file));
+        file_set_direct(e->file, file_is_direct(pe->file));
+        file_set_append(e->file, file_is_append(pe->file));
+        e->nonblock = pe->nonblock;
+      }
+    }
+  }
+
+done:
+  lock_release(&parent->fd_lock);
+  return ok;
+}
+
+/* Closes whatever E holds and marks it free. */
+static void fd_release(struct fd_entry* e) {
+  if (e->pipe != NULL)
+    pipe_close(e->pipe, e->writer);
+  file_close(e->file);
+  e->file = NULL;
+  e->pipe = NULL;
+  e->nonblock = false;
+}
+
+/* Doubles the size of T's table.  Returns false if memory runs
+   out. */
+static bool fd_grow(struct thread* t) {
+  int cnt = t->fd_cnt > 0 ? t->fd_cnt * 2 : FD_INIT_CNT;
+  struct fd_entry* fds = kvmalloc(cnt * sizeof *fds);
+  int fd;
+
+  if (fds == NULL)
+    return false;
+  if (t->fd_cnt > 0)
+    memcpy(fds, t->fds, t->fd_cnt * sizeof *fds);
+  for (fd = t->fd_cnt; fd < cnt; fd++) {
+    fds[fd].file = NULL;
+    fds[fd].pipe = NULL;
+    fds[fd].nonblock = false;
+  }
+  kvfree(t->fds);
+  t->fds = fds;
+  t->fd_cnt = cnt;
+  return true;
+}
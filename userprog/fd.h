@@ -0,0 +1,33 @@
+#ifndef USERPROG_FD_H
+#define USERPROG_FD_H
+
+#include <stdbool.h>
+
+struct file;
+struct pipe;
+struct thread;
+
+/* An entry in a file descriptor table: an open file, an end of a
+   pipe, or neither if the descriptor is free. */
+struct fd_entry {
+  struct file* file; /* Open file, or null. */
+  struct pipe* pipe; /* Pipe, or null. */
+  bool writer;       /* With PIPE, the write end rather than the read end? */
+  bool nonblock;     /* O_NONBLOCK set? */
+};
+
+int fd_install(struct file*);
+int fd_install_pipe(struct pipe*, bool writer);
+struct file* fd_lookup(int fd);
+struct file* fd_lookup_file(int fd);
+struct pipe* fd_lookup_pipe(int fd, bool writer);
+struct pipe* fd_get_pipe(int fd, bool* writer);
+int fd_get_flags(int fd);
+bool fd_set_flags(int fd, int flags);
+bool fd_nonblock(int fd);
+bool fd_close(int fd);
+void fd_close_all(void);
+bool fd_fork(struct thread* parent);
+bool fd_inherit_pipes(struct thread* parent);
+
+#endif /* userprog/fd.h */
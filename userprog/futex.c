@@ -0,0 +1,189 @@
+#include "userprog/futex.h"
+#include <debug.h>
+#include <hash.h>
+#include <list.h>
+#include <stdint.h>
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "userprog/pagedir.h"
+#include "userprog/usermem.h"
+#ifdef VM
+#include "vm/page.h"
+#endif
+
+/* Futexes: waiting on and waking words of user memory.
+
+   futex_wait() blocks the calling process if a user word still
+   holds the value it expects, and futex_wake() wakes processes
+   blocked on a word.  Checking the value and queuing the waiter
+   happen under the lock that futex_wake() takes, so a wakeup
+   between a user program's own check of the word and its
+   futex_wait() is never lost: either the wait sees the new value
+   and returns at once, or the wake finds the waiter queued.
+   User-space locks built on this (see lib/user/synch.c) only
+   enter the kernel when they have to block or to wake.
+
+   A word is identified by a key.  A word in shared memory (see
+   userprog/shm.c) has the same kernel address in every process
+   that attaches it, so processes that share it meet on the same
+   key.  A word in private memory, which the VM may page out and
+   back into another frame, is identified instead by the
+   process's page directory and the word's user address.
+
+   Waiters are queued in a fixed hash table of buckets, each with
+   its own lock, by the hash of their key.  A process that is
+   exiting wakes all of its waiting threads with futex_cancel(),
+   so that they can die. */
+
+/* Number of buckets. */
+#define FUTEX_BUCKETS 64
+
+/* Identity of a user word. */
+struct futex_key {
+  const void* space; /* Page directory, or null for shared memory. */
+  uintptr_t addr;    /* User address, or kernel address for shared memory. */
+};
+
+/* A thread blocked in futex_wait(). */
+struct futex_waiter {
+  struct list_elem elem;  /* Element in its bucket's `waiters'. */
+  struct futex_key key;   /* Word it waits on. */
+  struct thread* process; /* Main thread of the waiter's process. */
+  struct semaphore woken; /* Up'd by futex_wake() or futex_cancel(). */
+};
+
+/* A hash bucket. */
+struct futex_bucket {
+  struct lock lock;    /* Protects WAITERS. */
+  struct list waiters; /* Waiters whose keys hash here. */
+};
+
+static struct futex_bucket buckets[FUTEX_BUCKETS];
+
+static bool get_key(const int* uaddr, struct futex_key*);
+static struct futex_bucket* key_bucket(const struct futex_key*);
+
+/* Initializes the futex module. */
+void futex_init(void) {
+  size_t i;
+
+  for (i = 0; i < FUTEX_BUCKETS; i++) {
+    lock_init(&buckets[i].lock);
+    list_init(&buckets[i].waiters);
+  }
+}
+
+/* If the user word at UADDR holds VAL, blocks until
+   futex_wake() wakes the caller and returns 1.  Otherwise, or if
+   the caller's process is exiting, returns 0 at once.  Returns -1
+   if UADDR is not an aligned, mapped user address. */
+int futex_wait(const int* uaddr, int val) {
+  struct futex_waiter w;
+  struct futex_bucket* b;
+  int cur;
+
+  if (!get_key(uaddr, &w.key))
+    return -1;
+  b = key_bucket(&w.key);
+
+  lock_acquire(&b->lock);
+  if (!copy_from_user(&cur, uaddr, sizeof cur)) {
+    lock_release(&b->lock);
+    return -1;
+  }
+  w.process = thread_current()->process;
+  if (cur != val || w.process->exiting) {
+    lock_release(&b->lock);
+    return 0;
+  }
+  sema_init(&w.woken, 0);
+  list_push_back(&b->waiters, &w.elem);
+  lock_release(&b->lock);
+
+  sema_down(&w.woken);
+  return 1;
+}
+
+/* Wakes up to CNT processes waiting on the user word at UADDR,
+   oldest first, and returns the number woken.  Returns -1 if
+   UADDR is not an aligned, mapped user address. */
+int futex_wake(const int* uaddr, int cnt) {
+  struct futex_key key;
+  struct futex_bucket* b;
+  struct list_elem* e;
+  int woken = 0;
+
+  if (!get_key(uaddr, &key))
+    return -1;
+  b = key_bucket(&key);
+
+  lock_acquire(&b->lock);
+  for (e = list_begin(&b->waiters); e != list_end(&b->waiters) && woken < cnt;) {
+    struct futex_waiter* w = list_entry(e, struct futex_waiter, elem);
+
+    if (w->key.space == key.space && w->key.addr == key.addr) {
+      e = list_remove(e);
+      sema_up(&w->woken);
+      woken++;
+    } else
+      e = list_next(e);
+  }
+  lock_release(&b->lock);
+  return woken;
+}
+
+/* Wakes every thread of process P, given by its main thread,
+   that is blocked in futex_wait().  P must be marked as exiting
+   already, so that none of its threads starts waiting after
+   this. */
+void futex_cancel(struct thread* p) {
+  size_t i;
+
+  for (i = 0; i < FUTEX_BUCKETS; i++) {
+    struct futex_bucket* b = &buckets[i];
+    struct list_elem* e;
+
+    lock_acquire(&b->lock);
+    for (e = list_begin(&b->waiters); e != list_end(&b->waiters);) {
+      struct futex_waiter* w = list_entry(e, struct futex_waiter, elem);
+
+      if (w->process == p) {
+        e = list_remove(e);
+        sema_up(&w->woken);
+      } else
+        e = list_next(e);
+    }
+    lock_release(&b->lock);
+  }
+}
+
+/* Stores the key of the user word at UADDR in KEY.  Returns
+   false if UADDR is not aligned or not mapped in the running
+   process. */
+static bool get_key(const int* uaddr, struct futex_key* key) {
+  uint32_t* pd = thread_current()->pagedir;
+  void* kaddr;
+
+  if ((uintptr_t)uaddr % sizeof *uaddr != 0 || !is_user_vaddr(uaddr))
+    return false;
+#ifdef VM
+  /* Pages in the supplemental page table are private. */
+  if (page_lookup(uaddr) != NULL) {
+    key->space = pd;
+    key->addr = (uintptr_t)uaddr;
+    return true;
+  }
+#endif
+  kaddr = pagedir_get_page(pd, uaddr);
+  if (kaddr == NULL)
+    return false;
+  key->space = NULL;
+  key->addr = (uintptr_t)kaddr;
+  return true;
+}
+
+/* Returns the bucket for KEY. */
+static struct futex_bucket* key_bucket(const struct futex_key* key) {
+  return &buckets[hash_bytes(key, sizeof *key) % FUTEX_BUCKETS];
+}
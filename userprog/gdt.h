@@ -4,7 +4,9 @@
 #include "threads/loader.h"
 
 /* Segment selectors.
-   More selectors are defined by the loader in loader.h. */
+   More selectors are defined by the loader in loader.h.
+   sysenter and sysexit require SEL_KCSEG, SEL_KDSEG, SEL_UCSEG
+   and SEL_UDSEG to be consecutive, in that order. */
 #define SEL_UCSEG 0x1B /* User code selector. */
 #define SEL_UDSEG 0x23 /* User data selector. */
 #define SEL_TSS 0x28   /* Task-state segment. */
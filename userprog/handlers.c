@@ -1,226 +1,781 @@
 #include "userprog/handlers.h"
 #include <debug.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <mman.h>
+#include <round.h>
 #include <stdio.h>
 #include <stdbool.h>
 #include <string.h>
+#include "devices/block.h"
 #include "devices/input.h"
+#include "devices/timer.h"
+#include "filesys/directory.h"
 #include "filesys/file.h"
 #include "filesys/filesys.h"
+#include "filesys/inode.h"
 #include "lib/kernel/list.h"
+#include "threads/kstat.h"
 #include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/pmu.h"
 #include "threads/thread.h"
 #include "threads/synch.h"
+#include "threads/tunable.h"
 #include "threads/vaddr.h"
+#include "userprog/fd.h"
+#include "userprog/futex.h"
+#include "userprog/heap.h"
+#include "userprog/ioring.h"
+#include "userprog/pipe.h"
+#include "userprog/poll.h"
+#include "userprog/shm.h"
 #include "userprog/process.h"
-#include "userprog/pagedir.h"
-
+#include "userprog/strace.h"
+#include "userprog/tss.h"
+#include "userprog/usermem.h"
+#ifdef VM
+#include "vm/mmap.h"
+#include "vm/page.h"
+#endif
+
+/* Exits with STATUS.  thread_exit() hands it to the parent, and
+   the process's other threads die too. */
 void SYSCALL_exit_handler(int status) {
-  struct list_elem* e;
-
-  for (e = list_begin(&thread_current()->parent->process_children);
-       e != list_end(&thread_current()->parent->process_children); e = list_next(e)) {
-    struct child_process* f = list_entry(e, struct child_process, elem);
-    if (f->tid == thread_current()->tid) {
-      f->did_execute = true;
-      f->exit_status = status;
-    }
-  }
-
   thread_current()->exit_status = status;
-
-  if (thread_current()->parent->tid_wait == thread_current()->tid)
-    sema_up(&thread_current()->parent->child_process_lock);
-
+  process_terminate(status);
   thread_exit();
 }
 
-int SYSCALL_execute_handler(char* file_name) {
-  lock_acquire(&global_filesystem_lock);
+/* Runs the command line at user address UCMD_LINE. */
+int SYSCALL_execute_handler(const char* ucmd_line) { return process_execute_user(ucmd_line, false); }
 
-  char* filename_temp = malloc(strlen(file_name) + 1);
-  strlcpy(filename_temp, file_name, strlen(file_name) + 1);
+/* Like SYSCALL_execute_handler(), but returns before the new
+   process has loaded. */
+int SYSCALL_spawn_handler(const char* ucmd_line) { return process_execute_user(ucmd_line, true); }
 
-  char* save_ptr;
-  filename_temp = strtok_r(filename_temp, " ", &save_ptr);
-
-  struct file* f = filesys_open(filename_temp);
-
-  if (f == NULL) {
-    lock_release(&global_filesystem_lock);
-    return -1;
-  } else {
-    file_close(f);
-    lock_release(&global_filesystem_lock);
-    return process_execute(file_name);
-  }
-}
+/* Duplicates the process that entered the kernel with interrupt
+   frame F */
+int SYSCALL_fork_handler(const struct intr_frame* f) { return process_fork(f); }
 
 int SYSCALL_wait_handler(tid_t child_tid) { return process_wait(child_tid); }
 
-int SYSCALL_create_handler(const char* name, off_t initial_size) {
-  lock_acquire(&global_filesystem_lock);
+/* Reaps whichever child exits first, storing its exit status in
+   *STATUS.  Returns its pid, -1 if there are no children, or 0
+   if BLOCK is false and none has exited. */
+tid_t SYSCALL_waitany_handler(int* status, bool block) { return process_wait_any(status, block); }
 
+int SYSCALL_create_handler(const char* name, off_t initial_size) {
   bool status = filesys_create(name, initial_size);
 
-  lock_release(&global_filesystem_lock);
   return (int)status;
 }
 
 int SYSCALL_remove_handler(const char* name) {
-  lock_acquire(&global_filesystem_lock);
-
   bool status = filesys_remove(name);
 
-  lock_release(&global_filesystem_lock);
   return (int)status;
 }
 
-int SYSCALL_open_handler(const char* name) {
-  lock_acquire(&global_filesystem_lock);
+int SYSCALL_open_handler(const char* name) { return SYSCALL_open_flags_handler(name, 0); }
+
+/* Opens the file called NAME, like open, with FLAGS from
+   <fcntl.h>.  Fails on unknown flags, and O_DIRECT and O_APPEND
+   fail on a directory. */
+int SYSCALL_open_flags_handler(const char* name, int flags) {
+  if ((flags & ~(O_DIRECT | O_NONBLOCK | O_APPEND)) != 0)
+    return -1;
+
   struct file* fileptr = filesys_open(name);
-  lock_release(&global_filesystem_lock);
 
   if (!fileptr) {
     return -1;
   }
+  if ((flags & (O_DIRECT | O_APPEND)) && inode_is_dir(file_get_inode(fileptr))) {
+    file_close(fileptr);
+    return -1;
+  }
 
-  struct process_file* newfile = malloc(sizeof(newfile));
-  newfile->fileptr = fileptr;
-  newfile->fd = thread_current()->num_fd;
-  thread_current()->num_fd++;
-  list_push_back(&thread_current()->files, &newfile->elem);
-  return newfile->fd;
+  int fd = fd_install(fileptr);
+  if (fd < 0)
+    file_close(fileptr);
+  else
+    fd_set_flags(fd, flags);
+  return fd;
 }
 
 int SYSCALL_filesize_handler(int fd) {
-  lock_acquire(&global_filesystem_lock);
-  int fsize = -1;
-  struct list_elem* e;
-
-  for (e = list_begin(&thread_current()->files); e != list_end(&thread_current()->files);
-       e = list_next(e)) {
-    struct process_file* f = list_entry(e, struct process_file, elem);
-    if (f->fd == fd) {
-      fsize = file_length(f->fileptr);
+  struct file* f = fd_lookup(fd);
+
+  return f != NULL ? file_length(f) : -1;
+}
+
+/* Keys moved from the input buffer to user memory at a time. */
+#define STDIN_CHUNK 128
+
+/* Reads up to SIZE keys typed at the console into BUFFER and
+   returns the number read.  Like a terminal in non-canonical
+   mode, returns as soon as some input is there: if BLOCK is
+   true, waits only until there is at least one key, otherwise
+   does not wait at all. */
+static int read_stdin(void* buffer, unsigned size, bool block) {
+  uint8_t keys[STDIN_CHUNK];
+  uint8_t* dst = buffer;
+  unsigned done = 0;
+
+  /* Keys go through a kernel buffer, because touching user memory
+     may fault, which must not happen with interrupts off. */
+  while (done < size) {
+    size_t want = size - done < sizeof keys ? size - done : sizeof keys;
+    size_t n = input_read(keys, want, block && done == 0);
+
+    memcpy(dst + done, keys, n);
+    done += n;
+    if (n < want)
       break;
-    }
   }
+  return done;
+}
 
-  lock_release(&global_filesystem_lock);
-  return fsize;
+/* Returns true if a transfer of SIZE bytes between FILE at
+   OFFSET and user BUFFER may bypass the buffer cache: FILE is
+   open with O_DIRECT and all three are multiples of the sector
+   size. */
+static bool direct_ok(struct file* file, const void* buffer, unsigned size, off_t offset) {
+  return file_is_direct(file)
+         && ((uintptr_t)buffer | size | (unsigned)offset) % BLOCK_SECTOR_SIZE == 0;
 }
 
+/* Moves SIZE bytes between FILE at OFFSET and user BUFFER, as
+   direct_ok() allows, writing to FILE if WRITE is true and
+   reading from it otherwise, one page of BUFFER at a time, and
+   returns the number of bytes moved.  Each page is pinned while
+   the disk transfers to or from it, so it cannot be evicted or
+   fault midway. */
+static int direct_io(struct file* file, void* buffer, unsigned size, off_t offset, bool write) {
+  struct inode* inode = file_get_inode(file);
+  uint8_t* ubuf = buffer;
+  unsigned done = 0;
+
+  while (done < size) {
+    unsigned chunk = PGSIZE - pg_ofs(ubuf + done);
+    void* kbuf = user_pin(ubuf + done, !write);
+    off_t n;
+
+    if (kbuf == NULL)
+      SYSCALL_exit_handler(-1);
+    if (chunk > size - done)
+      chunk = size - done;
+    n = write ? inode_write_direct(inode, kbuf, chunk, offset + done)
+              : inode_read_direct(inode, kbuf, chunk, offset + done);
+    user_unpin(ubuf + done);
+    done += n;
+    if ((unsigned)n != chunk)
+      break;
+  }
+  return done;
+}
+
+/* Reads from FD into BUFFER.  With O_NONBLOCK, returns -1
+   instead of waiting for input. */
 int SYSCALL_read_handler(int fd, void* buffer, unsigned size) {
   if (fd == STDIN_FD) {
-    unsigned i;
-    uint8_t* buff = buffer;
-
-    for (i = 0; i < size; i++)
-      buff[i] = input_getc();
+    bool block = !fd_nonblock(fd);
+    int n = read_stdin(buffer, size, block);
 
-    return size;
+    return n == 0 && size > 0 && !block ? -1 : n;
   }
 
-  int retstatus = -1;
-  struct list_elem* e;
-  lock_acquire(&global_filesystem_lock);
+  struct file* f = fd_lookup_file(fd);
+  struct pipe* p;
 
-  for (e = list_begin(&thread_current()->files); e != list_end(&thread_current()->files);
-       e = list_next(e)) {
-    struct process_file* f = list_entry(e, struct process_file, elem);
-    if (f->fd == fd) {
-      retstatus = file_read(f->fileptr, buffer, size);
-      break;
-    }
-  }
-  lock_release(&global_filesystem_lock);
+  if (f != NULL && direct_ok(f, buffer, size, file_tell(f))) {
+    int n = direct_io(f, buffer, size, file_tell(f), false);
 
-  return retstatus;
+    file_seek(f, file_tell(f) + n);
+    return n;
+  }
+  if (f != NULL)
+    return file_read(f, buffer, size);
+  p = fd_lookup_pipe(fd, false);
+  return p != NULL ? pipe_read(p, buffer, size, !fd_nonblock(fd)) : -1;
 }
 
+/* Writes BUFFER to FD.  With O_NONBLOCK, writes only what fits
+   in a pipe without waiting.  With O_APPEND, writes at the end
+   of the file, through the cache, in one step. */
 int SYSCALL_write_handler(int fd, const void* buffer, unsigned size) {
   if (fd == STDOUT_FD) {
     putbuf(buffer, size);
     return size;
   }
 
-  int retstatus = -1;
-  struct list_elem* e;
-  lock_acquire(&global_filesystem_lock);
+  struct file* f = fd_lookup_file(fd);
+  struct pipe* p;
 
-  for (e = list_begin(&thread_current()->files); e != list_end(&thread_current()->files);
-       e = list_next(e)) {
-    struct process_file* f = list_entry(e, struct process_file, elem);
-    if (f->fd == fd) {
-      retstatus = file_write(f->fileptr, buffer, size);
-      break;
-    }
-  }
-  lock_release(&global_filesystem_lock);
+  if (f != NULL && !file_is_append(f) && direct_ok(f, buffer, size, file_tell(f))) {
+    int n = direct_io(f, (void*)buffer, size, file_tell(f), true);
 
-  return retstatus;
+    file_seek(f, file_tell(f) + n);
+    return n;
+  }
+  if (f != NULL)
+    return file_write(f, buffer, size);
+  p = fd_lookup_pipe(fd, true);
+  return p != NULL ? pipe_write(p, buffer, size, !fd_nonblock(fd)) : -1;
 }
 
 void SYSCALL_seek_handler(int fd, off_t position) {
-  struct list_elem* e;
-  lock_acquire(&global_filesystem_lock);
-
-  for (e = list_begin(&thread_current()->files); e != list_end(&thread_current()->files);
-       e = list_next(e)) {
-    struct process_file* f = list_entry(e, struct process_file, elem);
-    if (f->fd == fd) {
-      file_seek(f->fileptr, position);
-      break;
-    }
-  }
+  struct file* f = fd_lookup(fd);
 
-  lock_release(&global_filesystem_lock);
+  if (f != NULL)
+    file_seek(f, position);
 }
 
 off_t SYSCALL_tell_handler(int fd) {
-  off_t retstatus = -1;
-  struct list_elem* e;
-  lock_acquire(&global_filesystem_lock);
-
-  for (e = list_begin(&thread_current()->files); e != list_end(&thread_current()->files);
-       e = list_next(e)) {
-    struct process_file* f = list_entry(e, struct process_file, elem);
-    if (f->fd == fd) {
-      retstatus = file_tell(f->fileptr);
-      break;
-    }
+  struct file* f = fd_lookup(fd);
+
+  return f != NULL ? file_tell(f) : -1;
+}
+
+void SYSCALL_close_handler(int fd) { fd_close(fd); }
+
+bool SYSCALL_chdir_handler(const char* name) { return filesys_chdir(name); }
+
+bool SYSCALL_mkdir_handler(const char* name) { return filesys_mkdir(name); }
+
+/* Reads the next entry of the directory open as FD into NAME,
+   which must hold NAME_MAX + 1 bytes.  The file position of FD
+   is the position in the directory.  Returns false at the end of
+   the directory or if FD is not a directory. */
+bool SYSCALL_readdir_handler(int fd, char* name) {
+  struct file* f = fd_lookup(fd);
+  char kname[NAME_MAX + 1];
+  struct dir* dir;
+  bool found;
+
+  if (f == NULL || !inode_is_dir(file_get_inode(f)))
+    return false;
+  dir = dir_open(inode_reopen(file_get_inode(f)));
+  if (dir == NULL)
+    return false;
+  dir_seek(dir, file_tell(f));
+  found = dir_readdir(dir, kname);
+  file_seek(f, dir_tell(dir));
+  dir_close(dir);
+
+  /* Copy out with no lock held, since NAME may fault. */
+  if (found)
+    memcpy(name, kname, sizeof kname);
+  return found;
+}
+
+/* Reads up to CNT of the next entries of directory FD into
+   ENTRIES and returns the number read, 0 at the end of the
+   directory, or -1 if FD is not a directory or memory runs
+   out. */
+int SYSCALL_getdents_handler(int fd, struct dirent* entries, unsigned cnt) {
+  struct file* f = fd_lookup(fd);
+  struct dirent* kentries;
+  struct dir* dir;
+  size_t n;
+
+  if (f == NULL || !inode_is_dir(file_get_inode(f)))
+    return -1;
+  if (cnt == 0)
+    return 0;
+  kentries = malloc(cnt * sizeof *kentries);
+  dir = dir_open(inode_reopen(file_get_inode(f)));
+  if (kentries == NULL || dir == NULL) {
+    free(kentries);
+    dir_close(dir);
+    return -1;
   }
+  dir_seek(dir, file_tell(f));
+  n = dir_readdir_many(dir, kentries, cnt);
+  file_seek(f, dir_tell(dir));
+  dir_close(dir);
+
+  /* Copy out with no lock held, since ENTRIES may fault. */
+  memcpy(entries, kentries, n * sizeof *kentries);
+  free(kentries);
+  return n;
+}
 
-  lock_release(&global_filesystem_lock);
-  return retstatus;
+bool SYSCALL_isdir_handler(int fd) {
+  struct file* f = fd_lookup(fd);
+
+  return f != NULL && inode_is_dir(file_get_inode(f));
 }
 
-void SYSCALL_close_handler(int fd) {
-  struct list_elem* e;
-  lock_acquire(&global_filesystem_lock);
+int SYSCALL_inumber_handler(int fd) {
+  struct file* f = fd_lookup(fd);
 
-  for (e = list_begin(&thread_current()->files); e != list_end(&thread_current()->files);
-       e = list_next(e)) {
-    struct process_file* f = list_entry(e, struct process_file, elem);
-    if (f->fd == fd) {
-      file_close(f->fileptr);
-      thread_current()->num_fd--;
-      list_remove(e);
-    }
+  return f != NULL ? (int)inode_get_inumber(file_get_inode(f)) : -1;
+}
+
+/* Creates a pipe and stores the descriptors of its read and
+   write ends in FDS[0] and FDS[1].  Returns 0 if successful, -1
+   otherwise. */
+int SYSCALL_pipe_handler(int fds[2]) {
+  struct pipe* p = pipe_create();
+
+  if (p == NULL)
+    return -1;
+  fds[0] = fd_install_pipe(p, false);
+  if (fds[0] < 0) {
+    pipe_close(p, false);
+    pipe_close(p, true);
+    return -1;
+  }
+  fds[1] = fd_install_pipe(p, true);
+  if (fds[1] < 0) {
+    fd_close(fds[0]);
+    pipe_close(p, true);
+    return -1;
   }
-  lock_release(&global_filesystem_lock);
+  return 0;
 }
 
-bool is_valid_address(int* vaddr) {
-  if (!is_user_vaddr(vaddr)) {
-    SYSCALL_exit_handler(-1);
+/* Returns the id of the shared memory segment with KEY, creating
+   it with at least SIZE bytes if needed, or -1 on failure. */
+int SYSCALL_shmget_handler(int key, unsigned size) { return shm_get(key, size); }
+
+/* Attaches shared memory segment ID at ADDR and returns ADDR, or
+   a null pointer on failure. */
+void* SYSCALL_shmat_handler(int id, void* addr) { return shm_attach(id, addr); }
+
+/* Detaches the shared memory segment at ADDR.  Returns 0, or -1
+   if none is attached there. */
+int SYSCALL_shmdt_handler(void* addr) { return shm_detach(addr) ? 0 : -1; }
+
+/* Returns true if system calls may be made with sysenter as well
+   as int $0x30. */
+bool SYSCALL_sysenter_handler(void) { return tss_sysenter_enabled(); }
+
+/* Maps a batched system call ring at ADDR and returns ADDR, or a
+   null pointer on failure (see userprog/ioring.c). */
+struct io_ring* SYSCALL_ioring_setup_handler(void* addr) { return ioring_setup(addr); }
+
+/* Runs the calls queued in the ring and returns how many ran, or
+   -1 if there is no ring. */
+int SYSCALL_ioring_enter_handler(void) { return ioring_enter(); }
+
+/* Moves the break by INCREMENT bytes and returns the old one, or
+   (void*)-1 on failure (see userprog/heap.c). */
+void* SYSCALL_sbrk_handler(intptr_t increment) { return heap_sbrk(increment); }
+
+/* Returns the running process's limit on RESOURCE, or 0 if
+   RESOURCE is not an enum rlimit_resource. */
+unsigned SYSCALL_getrlimit_handler(int resource) {
+  return resource >= 0 && resource < RLIMIT_CNT ? thread_current()->process->rlimits[resource] : 0;
+}
+
+/* Lowers the running process's limit on RESOURCE to LIMIT, which
+   its children inherit.  Limits cannot be raised, so that a
+   parent can bound what a child and its descendants use.
+   Returns false if RESOURCE is bad or LIMIT is higher than the
+   current limit. */
+bool SYSCALL_setrlimit_handler(int resource, unsigned limit) {
+  unsigned* rlimits = thread_current()->process->rlimits;
+
+  if (resource < 0 || resource >= RLIMIT_CNT || limit > rlimits[resource])
     return false;
-  }
+  rlimits[resource] = limit;
+  return true;
+}
 
-  void* ptr = (void*)pagedir_get_page((uint32_t*)thread_current()->pagedir, vaddr);
-  if (!ptr) {
-    SYSCALL_exit_handler(-1);
+/* Turns tracing of the running process's system calls on or off
+   (see userprog/strace.c).  Returns false if tracing cannot be
+   started. */
+bool SYSCALL_strace_handler(bool on) { return strace_set(on); }
+
+/* Copies the I/O statistics of the block device that plays ROLE
+   into STATS.  Returns false if ROLE is not a role or no device
+   plays it. */
+bool SYSCALL_blkstat_handler(int role, struct blkstat* stats) {
+  struct block* block;
+
+  if (role < 0 || role >= BLOCK_ROLE_CNT || (block = block_get_role(role)) == NULL)
     return false;
+  block_get_stats(block, stats);
+  return true;
+}
+
+/* Sets up the running process's performance counters to count
+   EVENTS at the privilege levels in MODE (see threads/pmu.c).
+   Returns false if the CPU cannot count them. */
+bool SYSCALL_pmu_setup_handler(const unsigned events[PMU_COUNTER_CNT], int mode) {
+  return pmu_setup(events, mode);
+}
+
+/* Copies the running process's performance counts into COUNTS
+   and returns the number of counters the CPU has. */
+unsigned SYSCALL_pmu_read_handler(uint64_t counts[PMU_COUNTER_CNT]) {
+  pmu_read(counts);
+  return pmu_counter_cnt();
+}
+
+/* Blocks the running process until another wakes it through the
+   user word at UADDR, if the word holds VAL (see
+   userprog/futex.c).  Returns true if it blocked, false if the
+   word held another value.  Kills the process if UADDR is bad. */
+bool SYSCALL_futex_wait_handler(const int* uaddr, int val) {
+  int result = futex_wait(uaddr, val);
+
+  if (result < 0)
+    SYSCALL_exit_handler(-1);
+  return result;
+}
+
+/* Wakes up to CNT processes waiting on the user word at UADDR
+   and returns how many it woke.  Kills the process if UADDR is
+   bad. */
+int SYSCALL_futex_wake_handler(const int* uaddr, int cnt) {
+  int result = futex_wake(uaddr, cnt);
+
+  if (result < 0)
+    SYSCALL_exit_handler(-1);
+  return result;
+}
+
+/* Starts a thread of the running process at user address EIP,
+   with user stack pointer ESP, and returns its thread id, or
+   TID_ERROR if either address is bad or the thread cannot be
+   created.  F is the caller's interrupt frame. */
+tid_t SYSCALL_thread_create_handler(const struct intr_frame* f, void* eip, void* esp) {
+  if (!is_user_vaddr(eip) || !is_user_vaddr(esp))
+    return TID_ERROR;
+  return process_thread_create(f, eip, esp);
+}
+
+/* Waits for thread TID of the running process to exit and
+   returns its exit status, or -1 if there is no such thread. */
+int SYSCALL_thread_join_handler(tid_t tid) { return thread_join(tid); }
+
+/* Ends the running thread with STATUS. */
+void SYSCALL_thread_exit_handler(int status) { process_thread_exit(status); }
+
+/* Returns US microseconds in timer ticks, rounded up. */
+static int us_to_ticks(unsigned us) { return DIV_ROUND_UP((uint64_t)us * TIMER_FREQ, 1000000); }
+
+/* Puts the running thread in the deadline class with RUNTIME
+   microseconds of CPU time in every PERIOD, by DEADLINE after the
+   start of the period, each rounded up to whole timer ticks, or
+   takes it out if RUNTIME is 0.  Returns false if admission
+   control refuses it (see thread_set_deadline()). */
+bool SYSCALL_sched_deadline_handler(unsigned runtime, unsigned deadline, unsigned period) {
+  return thread_set_deadline(us_to_ticks(runtime), us_to_ticks(deadline), us_to_ticks(period));
+}
+
+/* Yields the CPU.  A thread in the deadline class gives up the
+   rest of its budget and next runs in its next period. */
+void SYSCALL_sched_yield_handler(void) { thread_yield_period(); }
+
+/* Lets the running thread run only on the CPUs in MASK, one bit
+   per CPU, the bootstrap processor's being bit 0.  Threads that
+   it starts later inherit MASK.  Returns false unless MASK
+   includes a CPU that schedules threads. */
+bool SYSCALL_setaffinity_handler(unsigned mask) {
+  return thread_set_affinity(thread_current(), mask);
+}
+
+/* Adds INCREMENT to the running thread's nice value, which stays
+   within NICE_MIN...NICE_MAX, and returns the new value.  Under
+   "-o mlfqs", a higher nice value lowers the thread's priority. */
+int SYSCALL_nice_handler(int increment) {
+  int nice = thread_get_nice();
+
+  if (increment > NICE_MAX - nice)
+    increment = NICE_MAX - nice;
+  else if (increment < NICE_MIN - nice)
+    increment = NICE_MIN - nice;
+  thread_set_nice(nice + increment);
+  return thread_get_nice();
+}
+
+/* Returns the running thread's nice value. */
+int SYSCALL_getnice_handler(void) { return thread_get_nice(); }
+
+/* Waits for one of the NFDS descriptors in FDS to become ready,
+   for up to TIMEOUT milliseconds (see userprog/poll.c). */
+int SYSCALL_poll_handler(struct pollfd* fds, int nfds, int timeout) {
+  return poll_fds(fds, nfds, timeout);
+}
+
+/* Gets FD's <fcntl.h> flags with F_GETFL, or sets them to ARG
+   with F_SETFL and returns 0.  Returns -1 on failure. */
+int SYSCALL_fcntl_handler(int fd, int cmd, int arg) {
+  switch (cmd) {
+    case F_GETFL:
+      return fd_get_flags(fd);
+    case F_SETFL:
+      return fd_set_flags(fd, arg) ? 0 : -1;
+    default:
+      return -1;
   }
+}
+
+/* Stores the value of the kernel tunable NAME in *VALUE (see
+   threads/tunable.c).  Returns false if there is no such
+   tunable. */
+bool SYSCALL_gettunable_handler(const char* name, unsigned* value) {
+  return tunable_get(name, value);
+}
+
+/* Sets the kernel tunable NAME to VALUE.  Returns false if there
+   is no such tunable, VALUE is out of its range, or it may be set
+   only at boot. */
+bool SYSCALL_settunable_handler(const char* name, unsigned value) {
+  return tunable_set(name, value, false);
+}
+
+/* Stores a snapshot of up to CNT kernel statistics in STATS (see
+   threads/kstat.c) and returns the number registered, or -1 if
+   memory runs out. */
+int SYSCALL_kstat_handler(struct kstat* stats, unsigned cnt) {
+  struct kstat* kstats;
+  int total;
+
+  if (cnt == 0)
+    return kstat_snapshot(NULL, 0);
+  kstats = malloc(cnt * sizeof *kstats);
+  if (kstats == NULL)
+    return -1;
+  total = kstat_snapshot(kstats, cnt);
+
+  /* Copy out with interrupts on, since STATS may fault. */
+  memcpy(stats, kstats, (total < (int)cnt ? (unsigned)total : cnt) * sizeof *kstats);
+  free(kstats);
+  return total;
+}
+
+/* Allocates the sectors of the first LENGTH bytes of FD, which
+   is extended to LENGTH bytes if it is shorter, so that writing
+   them later needs no allocation. */
+bool SYSCALL_fallocate_handler(int fd, unsigned length) {
+  struct file* f = fd_lookup_file(fd);
+
+  return f != NULL && length <= INT_MAX && file_allocate(f, length);
+}
+
+/* Applies ADVICE, one of the MADV_* values in <mman.h>, to the
+   running process's pages that overlap the LENGTH bytes at ADDR,
+   which must be page-aligned.  Without VM there is no paging for
+   advice to steer, so only the arguments are checked. */
+bool SYSCALL_madvise_handler(void* addr, unsigned length, int advice) {
+  if (pg_ofs(addr) != 0 || !is_user_vaddr(addr) || advice < MADV_NORMAL
+      || advice > MADV_DONTNEED || length > (uintptr_t)PHYS_BASE - (uintptr_t)addr)
+    return false;
+#ifdef VM
+  page_advise(addr, DIV_ROUND_UP(length, PGSIZE), advice);
+#endif
   return true;
 }
+
+/* Applies ADVICE, one of the POSIX_FADV_* values in <fcntl.h>, to
+   the LENGTH bytes at OFFSET of the file open as FD, or to the
+   rest of it if LENGTH is 0. */
+bool SYSCALL_fadvise_handler(int fd, unsigned offset, unsigned length, int advice) {
+  struct file* f = fd_lookup_file(fd);
+
+  if (f == NULL || offset > INT_MAX || length > INT_MAX || advice < POSIX_FADV_NORMAL
+      || advice > POSIX_FADV_DONTNEED)
+    return false;
+  file_advise(f, offset, length, advice);
+  return true;
+}
+
+/* Copies up to LEN bytes from FD_IN to FD_OUT, each from its
+   file position, without passing them through user memory, and
+   returns the number of bytes copied. */
+int SYSCALL_copy_file_range_handler(int fd_in, int fd_out, unsigned len) {
+  struct file* in = fd_lookup_file(fd_in);
+  struct file* out = fd_lookup_file(fd_out);
+
+  if (in == NULL || out == NULL)
+    return -1;
+  return file_copy(out, in, len < INT_MAX ? len : INT_MAX);
+}
+
+/* Reads SIZE bytes from FD at byte OFFSET into BUFFER, leaving
+   the file position alone, and returns the number of bytes
+   read.  The console has no positions, so STDIN_FD fails. */
+int SYSCALL_pread_handler(int fd, void* buffer, unsigned size, off_t offset) {
+  struct file* f = fd_lookup_file(fd);
+
+  if (f == NULL || offset < 0)
+    return -1;
+  if (direct_ok(f, buffer, size, offset))
+    return direct_io(f, buffer, size, offset, false);
+  return file_read_at(f, buffer, size, offset);
+}
+
+/* Writes SIZE bytes from BUFFER to FD at byte OFFSET, leaving
+   the file position alone, and returns the number of bytes
+   written. */
+int SYSCALL_pwrite_handler(int fd, const void* buffer, unsigned size, off_t offset) {
+  struct file* f = fd_lookup_file(fd);
+
+  if (f == NULL || offset < 0)
+    return -1;
+  if (direct_ok(f, buffer, size, offset))
+    return direct_io(f, (void*)buffer, size, offset, true);
+  return file_write_at(f, buffer, size, offset);
+}
+
+/* Returns the total size of the IOVCNT buffers in IOV, or -1 if
+   it does not fit in an int. */
+static int iov_total(const struct iovec* iov, int iovcnt) {
+  size_t total = 0;
+  int i;
+
+  for (i = 0; i < iovcnt; i++) {
+    if (iov[i].iov_len > INT_MAX - total)
+      return -1;
+    total += iov[i].iov_len;
+  }
+  return total;
+}
+
+/* Copies SIZE bytes between the kernel buffer KBUF and the
+   buffers in IOV, starting OFS bytes into them: into the
+   buffers if TO_IOV is true, out of them otherwise. */
+static void iov_copy(const struct iovec* iov, size_t ofs, void* kbuf, size_t size, bool to_iov) {
+  uint8_t* k = kbuf;
+
+  for (; ofs >= iov->iov_len && size > 0; iov++)
+    ofs -= iov->iov_len;
+  while (size > 0) {
+    size_t chunk = iov->iov_len - ofs < size ? iov->iov_len - ofs : size;
+    uint8_t* u = (uint8_t*)iov->iov_base + ofs;
+
+    if (to_iov)
+      memcpy(u, k, chunk);
+    else
+      memcpy(k, u, chunk);
+    k += chunk;
+    size -= chunk;
+    ofs = 0;
+    iov++;
+  }
+}
+
+/* Reads from FD into the IOVCNT buffers in IOV, in order, and
+   returns the number of bytes read.  File data goes through a
+   page-size kernel buffer, so the file system sees one read per
+   page of data however many buffers there are. */
+int SYSCALL_readv_handler(int fd, const struct iovec* iov, int iovcnt) {
+  int total = iov_total(iov, iovcnt);
+  bool block = !fd_nonblock(fd);
+  int done = 0;
+  int i;
+
+  if (total < 0)
+    return -1;
+
+  if (fd == STDIN_FD) {
+    for (i = 0; i < iovcnt; i++) {
+      int n = read_stdin(iov[i].iov_base, iov[i].iov_len, block && done == 0);
+
+      done += n;
+      if (n < (int)iov[i].iov_len)
+        break;
+    }
+    return done == 0 && total > 0 && !block ? -1 : done;
+  }
+
+  struct file* f = fd_lookup_file(fd);
+  struct pipe* p = f == NULL ? fd_lookup_pipe(fd, false) : NULL;
+  void* kbuf;
+
+  if (f == NULL && p == NULL)
+    return -1;
+  kbuf = palloc_get_page(0);
+  if (kbuf == NULL)
+    return -1;
+  while (done < total) {
+    off_t want = total - done < PGSIZE ? total - done : PGSIZE;
+    off_t n = f != NULL ? file_read(f, kbuf, want) : pipe_read(p, kbuf, want, block && done == 0);
+
+    if (n < 0) {
+      done = done > 0 ? done : -1;
+      break;
+    }
+    iov_copy(iov, done, kbuf, n, true);
+    done += n;
+    if (n < want)
+      break;
+  }
+  palloc_free_page(kbuf);
+  return done;
+}
+
+/* Writes the IOVCNT buffers in IOV to FD, in order, and returns
+   the number of bytes written.  The buffers are gathered into a
+   page-size kernel buffer, so that many small buffers take a
+   single write to the file system. */
+int SYSCALL_writev_handler(int fd, const struct iovec* iov, int iovcnt) {
+  int total = iov_total(iov, iovcnt);
+  bool block = !fd_nonblock(fd);
+  int done = 0;
+  int i;
+
+  if (total < 0)
+    return -1;
+
+  if (fd == STDOUT_FD) {
+    for (i = 0; i < iovcnt; i++)
+      putbuf(iov[i].iov_base, iov[i].iov_len);
+    return total;
+  }
+
+  struct file* f = fd_lookup_file(fd);
+  struct pipe* p = f == NULL ? fd_lookup_pipe(fd, true) : NULL;
+  void* kbuf;
+
+  if (f == NULL && p == NULL)
+    return -1;
+  kbuf = palloc_get_page(0);
+  if (kbuf == NULL)
+    return -1;
+  while (done < total) {
+    off_t want = total - done < PGSIZE ? total - done : PGSIZE;
+    off_t n;
+
+    iov_copy(iov, done, kbuf, want, false);
+    n = f != NULL ? file_write(f, kbuf, want) : pipe_write(p, kbuf, want, block);
+    if (n < 0) {
+      done = done > 0 ? done : -1;
+      break;
+    }
+    done += n;
+    if (n < want)
+      break;
+  }
+  palloc_free_page(kbuf);
+  return done;
+}
+
+/* Copies the CPU accounting of the running thread, and the memory
+  accounting of its process, into USAGE */
+int SYSCALL_getrusage_handler(struct rusage* usage) {
+  thread_get_rusage(thread_current(), usage);
+  return 0;
+}
+
+/* Stores the monotonic nanosecond clock in NS */
+void SYSCALL_clock_ns_handler(int64_t* ns) { *ns = timer_ns(); }
+
+#ifdef VM
+/* Maps the file open as FD at ADDR and returns the mapping's
+   identifier, or MAP_FAILED. */
+int SYSCALL_mmap_handler(int fd, void* addr) {
+  struct file* f = fd_lookup_file(fd);
+
+  return f != NULL ? mmap_map(f, addr) : MAP_FAILED;
+}
+
+/* Unmaps the mapping MAPID */
+void SYSCALL_munmap_handler(int mapid) { mmap_unmap(mapid); }
+#endif
@@ -1,5 +1,13 @@
+#include <blkstat.h>
+#include <dirent.h>
+#include <iovec.h>
+#include <kstat.h>
+#include <pmu.h>
+#include <poll.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include "filesys/off_t.h"
+#include "threads/interrupt.h"
 #include "threads/thread.h"
 
 #define STDIN_FD 0
@@ -7,7 +15,10 @@
 
 void SYSCALL_exit_handler(int status);
 int SYSCALL_wait_handler(tid_t child_tid);
-int SYSCALL_execute_handler(char* file_name);
+tid_t SYSCALL_waitany_handler(int* status, bool block);
+int SYSCALL_execute_handler(const char* ucmd_line);
+int SYSCALL_spawn_handler(const char* ucmd_line);
+int SYSCALL_fork_handler(const struct intr_frame* f);
 int SYSCALL_create_handler(const char* name, off_t initial_size);
 int SYSCALL_remove_handler(const char* name);
 int SYSCALL_open_handler(const char* name);
@@ -17,6 +28,53 @@ int SYSCALL_write_handler(int fd, const void* buffer, unsigned size);
 void SYSCALL_seek_handler(int fd, off_t position);
 off_t SYSCALL_tell_handler(int fd);
 void SYSCALL_close_handler(int fd);
-
-// Helper functions
-bool is_valid_address(int* vaddr);
+bool SYSCALL_chdir_handler(const char* name);
+bool SYSCALL_mkdir_handler(const char* name);
+bool SYSCALL_readdir_handler(int fd, char* name);
+bool SYSCALL_isdir_handler(int fd);
+int SYSCALL_inumber_handler(int fd);
+int SYSCALL_pipe_handler(int fds[2]);
+int SYSCALL_shmget_handler(int key, unsigned size);
+void* SYSCALL_shmat_handler(int id, void* addr);
+int SYSCALL_shmdt_handler(void* addr);
+bool SYSCALL_sysenter_handler(void);
+struct io_ring* SYSCALL_ioring_setup_handler(void* addr);
+int SYSCALL_ioring_enter_handler(void);
+void* SYSCALL_sbrk_handler(intptr_t increment);
+unsigned SYSCALL_getrlimit_handler(int resource);
+bool SYSCALL_setrlimit_handler(int resource, unsigned limit);
+bool SYSCALL_strace_handler(bool on);
+bool SYSCALL_blkstat_handler(int role, struct blkstat* stats);
+bool SYSCALL_pmu_setup_handler(const unsigned events[PMU_COUNTER_CNT], int mode);
+unsigned SYSCALL_pmu_read_handler(uint64_t counts[PMU_COUNTER_CNT]);
+bool SYSCALL_futex_wait_handler(const int* uaddr, int val);
+int SYSCALL_futex_wake_handler(const int* uaddr, int cnt);
+tid_t SYSCALL_thread_create_handler(const struct intr_frame* f, void* eip, void* esp);
+int SYSCALL_thread_join_handler(tid_t tid);
+bool SYSCALL_sched_deadline_handler(unsigned runtime, unsigned deadline, unsigned period);
+void SYSCALL_sched_yield_handler(void);
+bool SYSCALL_setaffinity_handler(unsigned mask);
+int SYSCALL_nice_handler(int increment);
+int SYSCALL_getnice_handler(void);
+int SYSCALL_kstat_handler(struct kstat* stats, unsigned cnt);
+int SYSCALL_poll_handler(struct pollfd* fds, int nfds, int timeout);
+int SYSCALL_fcntl_handler(int fd, int cmd, int arg);
+bool SYSCALL_gettunable_handler(const char* name, unsigned* value);
+bool SYSCALL_settunable_handler(const char* name, unsigned value);
+int SYSCALL_copy_file_range_handler(int fd_in, int fd_out, unsigned len);
+int SYSCALL_open_flags_handler(const char* name, int flags);
+bool SYSCALL_fallocate_handler(int fd, unsigned length);
+int SYSCALL_getdents_handler(int fd, struct dirent* entries, unsigned cnt);
+bool SYSCALL_madvise_handler(void* addr, unsigned length, int advice);
+bool SYSCALL_fadvise_handler(int fd, unsigned offset, unsigned length, int advice);
+void SYSCALL_thread_exit_handler(int status);
+int SYSCALL_readv_handler(int fd, const struct iovec* iov, int iovcnt);
+int SYSCALL_writev_handler(int fd, const struct iovec* iov, int iovcnt);
+int SYSCALL_pread_handler(int fd, void* buffer, unsigned size, off_t offset);
+int SYSCALL_pwrite_handler(int fd, const void* buffer, unsigned size, off_t offset);
+int SYSCALL_getrusage_handler(struct rusage* usage);
+void SYSCALL_clock_ns_handler(int64_t* ns);
+#ifdef VM
+int SYSCALL_mmap_handler(int fd, void* addr);
+void SYSCALL_munmap_handler(int mapid);
+#endif
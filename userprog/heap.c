@@ -0,0 +1,128 @@
+#include "userprog/heap.h"
+#include <debug.h>
+#include <round.h>
+#include "threads/palloc.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "userprog/pagedir.h"
+#ifdef VM
+#include "vm/page.h"
+#endif
+
+/* Process heaps.
+
+   A process's heap starts at the page boundary after its highest
+   loaded segment and ends at its break, which the sbrk system
+   call moves.  With VM, growing the heap only records zero pages
+   in the supplemental page table, so memory is committed a page
+   at a time as the process touches it, and a page that is only
+   read maps the shared zero page.  Without VM there is nothing to
+   fault pages in, so they are allocated as the break passes
+   them.
+
+   The heap may grow up to the lowest address the stack may grow
+   down to, and not over any page already in use, such as a
+   memory-mapped file or a shared memory segment.  fork() copies
+   the heap with the rest of the address space. */
+
+static void* move_break(struct thread*, intptr_t increment);
+static bool add_page(void* upage);
+static void remove_page(void* upage);
+
+/* Starts the current process's heap, empty, at START. */
+void heap_init(void* start) {
+  struct thread* t = thread_current()->process;
+
+  t->heap_start = t->heap_end = start;
+}
+
+/* Returns the lowest address the stack may reach. */
+static uint8_t* stack_limit(void) {
+#ifdef VM
+  return (uint8_t*)PHYS_BASE - page_stack_limit;
+#else
+  return (uint8_t*)PHYS_BASE - PGSIZE;
+#endif
+}
+
+/* Moves the current process's break by INCREMENT bytes and
+   returns the old break, or (void*)-1 if the heap would shrink
+   below its start or grow into the stack or a page in use, or if
+   memory runs out, in which case the break does not move.  The
+   process's threads move the break one at a time. */
+void* heap_sbrk(intptr_t increment) {
+  struct thread* t = thread_current()->process;
+  void* old_end;
+
+  lock_acquire(&t->heap_lock);
+  old_end = move_break(t, increment);
+  lock_release(&t->heap_lock);
+  return old_end;
+}
+
+/* Does the work of heap_sbrk() for process T, with its heap lock
+   held. */
+static void* move_break(struct thread* t, intptr_t increment) {
+  uint8_t* old_end = t->heap_end;
+  uint8_t* new_end = old_end + increment;
+  uint8_t* old_top = (uint8_t*)ROUND_UP((uintptr_t)old_end, PGSIZE);
+  uint8_t* new_top = (uint8_t*)ROUND_UP((uintptr_t)new_end, PGSIZE);
+  uint8_t* upage;
+
+  if (t->heap_start == NULL)
+    return (void*)-1;
+  if (increment > 0) {
+    if (new_end < old_end || new_end > stack_limit())
+      return (void*)-1;
+    for (upage = old_top; upage < new_top; upage += PGSIZE)
+      if (!add_page(upage)) {
+        while (upage > old_top)
+          remove_page(upage -= PGSIZE);
+        return (void*)-1;
+      }
+  } else if (increment < 0) {
+    if (new_end > old_end || new_end < (uint8_t*)t->heap_start)
+      return (void*)-1;
+    for (upage = new_top; upage < old_top; upage += PGSIZE)
+      remove_page(upage);
+  }
+  t->heap_end = new_end;
+  return old_end;
+}
+
+/* Adds zeroed page UPAGE to the current process's heap.  Returns
+   false if UPAGE is in use or memory runs out. */
+static bool add_page(void* upage) {
+#ifdef VM
+  return page_add_zero(upage, true);
+#else
+  struct thread* t = thread_current();
+  void* kpage;
+
+  if (pagedir_is_mapped(t->pagedir, upage))
+    return false;
+  kpage = palloc_get_page(PAL_USER | PAL_ZERO);
+  if (kpage == NULL)
+    return false;
+  if (!pagedir_set_page(t->pagedir, upage, kpage, true)) {
+    palloc_free_page(kpage);
+    return false;
+  }
+  return true;
+#endif
+}
+
+/* Removes page UPAGE from the current process's heap and frees
+   its memory. */
+static void remove_page(void* upage) {
+#ifdef VM
+  page_remove(upage);
+#else
+  struct thread* t = thread_current();
+  void* kpage = pagedir_get_page(t->pagedir, upage);
+
+  ASSERT(kpage != NULL);
+  pagedir_clear_page(t->pagedir, upage);
+  palloc_free_page(kpage);
+#endif
+}
@@ -0,0 +1,9 @@
+#ifndef USERPROG_HEAP_H
+#define USERPROG_HEAP_H
+
+#include <stdint.h>
+
+void heap_init(void* start);
+void* heap_sbrk(intptr_t increment);
+
+#endif /* userprog/heap.h */
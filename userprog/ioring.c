@@ -0,0 +1,142 @@
+#include "userprog/ioring.h"
+#include <debug.h>
+#include "threads/palloc.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "userprog/handlers.h"
+#include "userprog/pagedir.h"
+#include "userprog/usermem.h"
+#ifdef VM
+#include "vm/page.h"
+#endif
+
+/* Batched system calls.
+
+   ioring_setup() maps one zeroed page, laid out as a struct
+   io_ring (see lib/ioring.h), into the calling process, which
+   queues file system calls in it and runs them all with one
+   ioring_enter() call.  The kernel reaches the page through its
+   own mapping, so running an entry costs no trap and no copy of
+   the ring, only the work of the system call itself.
+
+   Like a shared memory segment, the page stays out of the frame
+   table and the supplemental page table, so it is never evicted.
+   fork() does not give the child a ring.
+
+   The process may change the page at any time, so every entry is
+   copied before it is used and every index is reduced modulo
+   IORING_ENTRIES.  A bad pointer in an entry fails that entry
+   with -1 instead of killing the process. */
+
+/* Longest file name IORING_OP_OPEN takes, as for open(). */
+#define NAME_BUF_SIZE 128
+
+#define RING_MASK (IORING_ENTRIES - 1)
+
+static int run_entry(const struct io_sqe*);
+
+/* Maps a new ring into the current process at ADDR, which must be
+   page-aligned and unused.  Returns the ring's user address, or
+   a null pointer if that is impossible or the process already
+   has a ring. */
+struct io_ring* ioring_setup(void* addr) {
+  struct thread* t = thread_current()->process;
+  struct io_ring* ring;
+
+  ASSERT(sizeof *ring <= PGSIZE);
+
+  if (t->ioring != NULL || addr == NULL || pg_ofs(addr) != 0 || !is_user_vaddr(addr))
+    return NULL;
+#ifdef VM
+  if (page_lookup(addr) != NULL)
+    return NULL;
+#endif
+  if (pagedir_is_mapped(t->pagedir, addr))
+    return NULL;
+
+  ring = palloc_get_page(PAL_USER | PAL_ZERO);
+  if (ring == NULL)
+    return NULL;
+  if (!pagedir_set_page(t->pagedir, addr, ring, true)) {
+    palloc_free_page(ring);
+    return NULL;
+  }
+  t->ioring = ring;
+  t->ioring_addr = addr;
+  return addr;
+}
+
+/* Runs the entries the current process has submitted, stopping
+   early if the completion ring fills up.  Returns the number
+   run, or -1 if the process has no ring or its indices are
+   inconsistent. */
+int ioring_enter(void) {
+  struct io_ring* ring = thread_current()->process->ioring;
+  uint32_t head, tail;
+  int cnt = 0;
+
+  if (ring == NULL)
+    return -1;
+  head = ring->sq_head;
+  tail = ring->sq_tail;
+  if (tail - head > IORING_ENTRIES)
+    return -1;
+
+  for (; head != tail && ring->cq_tail - ring->cq_head < IORING_ENTRIES; head++) {
+    struct io_sqe sqe = ring->sqes[head & RING_MASK];
+    struct io_cqe* cqe;
+    int res;
+
+    res = run_entry(&sqe);
+    cqe = &ring->cqes[ring->cq_tail & RING_MASK];
+    cqe->user_data = sqe.user_data;
+    cqe->res = res;
+    ring->cq_tail++;
+    ring->sq_head = head + 1;
+    cnt++;
+  }
+  return cnt;
+}
+
+/* Unmaps and frees the current process's ring, if it has one.
+   Must be called while its page directory still exists, before
+   pagedir_destroy() would free the page. */
+void ioring_exit(void) {
+  struct thread* t = thread_current();
+
+  if (t->ioring == NULL)
+    return;
+  pagedir_clear_page(t->pagedir, t->ioring_addr);
+  palloc_free_page(t->ioring);
+  t->ioring = NULL;
+}
+
+/* Runs submission entry SQE and returns its result. */
+static int run_entry(const struct io_sqe* sqe) {
+  char name[NAME_BUF_SIZE];
+  int len;
+
+  switch (sqe->op) {
+    case IORING_OP_READ:
+      if (!user_buffer_ok(sqe->buf, sqe->len, true))
+        return -1;
+      return SYSCALL_read_handler(sqe->fd, sqe->buf, sqe->len);
+    case IORING_OP_WRITE:
+      if (!user_buffer_ok(sqe->buf, sqe->len, false))
+        return -1;
+      return SYSCALL_write_handler(sqe->fd, sqe->buf, sqe->len);
+    case IORING_OP_SEEK:
+      SYSCALL_seek_handler(sqe->fd, sqe->len);
+      return 0;
+    case IORING_OP_OPEN:
+      len = strncpy_from_user(name, sqe->buf, sizeof name);
+      if (len < 0 || len >= (int)sizeof name)
+        return -1;
+      return SYSCALL_open_handler(name);
+    case IORING_OP_CLOSE:
+      SYSCALL_close_handler(sqe->fd);
+      return 0;
+    default:
+      return -1;
+  }
+}
@@ -0,0 +1,10 @@
+#ifndef USERPROG_IORING_H
+#define USERPROG_IORING_H
+
+#include <ioring.h>
+
+struct io_ring* ioring_setup(void* addr);
+int ioring_enter(void);
+void ioring_exit(void);
+
+#endif /* userprog/ioring.h */
@@ -1,45 +1,297 @@
 #include "userprog/pagedir.h"
+#include <hash.h>
+#include <list.h>
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdio.h>
 #include <string.h>
+#include "threads/cpu.h"
+#include "threads/highmem.h"
 #include "threads/init.h"
+#include "threads/ipi.h"
+#include "threads/loader.h"
+#include "threads/malloc.h"
 #include "threads/pte.h"
 #include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/vdso.h"
+#include "threads/workqueue.h"
 
+/* Number of page directory entries for user virtual memory, and
+   of 32-bit words in a bitmap with one bit per entry. */
+#define USER_PDE_CNT (LOADER_PHYS_BASE >> PDSHIFT)
+#define USED_WORDS (USER_PDE_CNT / 32)
+
+/* Page directories and page tables that pagedir_destroy() freed,
+   kept for reuse, so that a process that exec() or fork() starts
+   after another exits gets them without a trip to the page
+   allocator and without copying init_page_dir.  A cached page
+   directory still holds the kernel mappings of init_page_dir,
+   which do not change once processes run, and no user mappings;
+   a cached page table is all zeros. */
+#define PD_CACHE_SIZE 8
+#define PT_CACHE_SIZE 16
+static uint32_t* pd_cache[PD_CACHE_SIZE];
+static size_t pd_cache_cnt;
+static uint32_t* pt_cache[PT_CACHE_SIZE];
+static size_t pt_cache_cnt;
+
+/* Which user page directory entries of a page directory point to
+   page tables, so that pagedir_destroy() and pagedir_copy() visit
+   only those.  A bit may also be set for an entry that is still
+   empty, because allocating its page table failed. */
+struct pd_info {
+  struct hash_elem elem;      /* Element in pd_infos. */
+  struct list_elem reap_elem; /* Element in reap_list or reaped_list. */
+  uint32_t* pd;               /* Page directory. */
+  uint32_t used[USED_WORDS];  /* Bit I set if entry I may be in use. */
+};
+
+/* Bookkeeping of every page directory that pagedir_create()
+   returned, by address. */
+static struct hash pd_infos;
+
+/* Page directories of exited processes, which the reaper, work
+   queued at WORK_LOW, destroys in the background, so that a
+   process reports its exit status to its parent without first
+   walking its page tables and freeing its pages.  If a pool runs
+   out of pages meanwhile, the page allocator calls
+   pagedir_reclaim(), which destroys the waiting directories at
+   once and leaves their bookkeeping on reaped_list for the
+   reaper to free. */
+static struct list reap_list;
+static struct list reaped_list;
+static struct work reap_work;
+
+/* Protects the caches, pd_infos, the reaper's lists and the
+   statistics.  Never held across a call to the page allocator,
+   which may call pagedir_reclaim(). */
+static struct lock pd_lock;
+
+/* Statistics. */
+static long long pd_hits, pd_misses;    /* Page directories reused, allocated. */
+static long long pt_hits, pt_misses;    /* Page tables reused, allocated. */
+static long long reap_cnt, reclaim_cnt; /* Directories destroyed by the reaper, on demand. */
+
+static hash_hash_func pd_info_hash;
+static hash_less_func pd_info_less;
+static struct pd_info* find_info(uint32_t* pd);
+static void destroy(struct pd_info*);
+static thread_func reap;
+static palloc_reclaim_func pagedir_reclaim;
+static int pop_used(uint32_t used[USED_WORDS]);
+static void free_page_table(uint32_t* pt);
+static uint32_t* lookup_page(uint32_t* pd, const void* vaddr, bool create);
+static size_t pt_run(const uint8_t* upage, const uint8_t* end);
 static uint32_t* active_pd(void);
-static void invalidate_pagedir(uint32_t*);
+static void invalidate_page(uint32_t*, const void* vaddr);
+
+/* Initializes the page directory module. */
+void pagedir_init(void) {
+  hash_init(&pd_infos, pd_info_hash, pd_info_less, NULL);
+  lock_init(&pd_lock);
+  list_init(&reap_list);
+  list_init(&reaped_list);
+  work_init(&reap_work, reap, NULL);
+  palloc_set_reclaim(pagedir_reclaim);
+}
 
 /* Creates a new page directory that has mappings for kernel
-   virtual addresses, but none for user virtual addresses.
-   Returns the new page directory, or a null pointer if memory
-   allocation fails. */
+   virtual addresses and, at VDSO_ADDR, for the kernel's shared
+   page (see threads/vdso.c), but none for other user virtual
+   addresses.  Returns the new page directory, or a null pointer
+   if memory allocation fails. */
 uint32_t* pagedir_create(void) {
-  uint32_t* pd = palloc_get_page(0);
-  if (pd != NULL)
+  struct pd_info* info = malloc(sizeof *info);
+  uint32_t* pd = NULL;
+  uint32_t* pte;
+
+  if (info == NULL)
+    return NULL;
+
+  lock_acquire(&pd_lock);
+  if (pd_cache_cnt > 0) {
+    pd = pd_cache[--pd_cache_cnt];
+    pd_hits++;
+  } else
+    pd_misses++;
+  lock_release(&pd_lock);
+
+  if (pd == NULL) {
+    pd = palloc_get_page(0);
+    if (pd == NULL) {
+      free(info);
+      return NULL;
+    }
     memcpy(pd, init_page_dir, PGSIZE);
+  }
+
+  info->pd = pd;
+  memset(info->used, 0, sizeof info->used);
+  lock_acquire(&pd_lock);
+  hash_insert(&pd_infos, &info->elem);
+  lock_release(&pd_lock);
+
+  /* The shared page is not the process's own, so
+     pagedir_destroy() and pagedir_copy() leave it alone. */
+  pte = lookup_page(pd, VDSO_ADDR, true);
+  if (pte == NULL) {
+    pagedir_destroy(pd);
+    return NULL;
+  }
+  *pte = pte_create_user(vdso_page(), false) | PTE_SHARED;
   return pd;
 }
 
 /* Destroys page directory PD, freeing all the pages it
-   references. */
+   references except the shared page.  Visits only the page
+   tables that PD has, and keeps them and PD for reuse if the
+   caches have room. */
 void pagedir_destroy(uint32_t* pd) {
-  uint32_t* pde;
+  struct pd_info* info;
+
+  if (pd == NULL)
+    return;
+
+  ASSERT(pd != init_page_dir);
+  lock_acquire(&pd_lock);
+  info = find_info(pd);
+  hash_delete(&pd_infos, &info->elem);
+  lock_release(&pd_lock);
+
+  destroy(info);
+  free(info);
+}
+
+/* Hands PD, which no thread may activate again, to the reaper,
+   which destroys it like pagedir_destroy() once the CPU has
+   nothing more urgent to do, or sooner if memory runs out. */
+void pagedir_destroy_async(uint32_t* pd) {
+  struct pd_info* info;
 
   if (pd == NULL)
     return;
 
   ASSERT(pd != init_page_dir);
-  for (pde = pd; pde < pd + pd_no(PHYS_BASE); pde++)
-    if (*pde & PTE_P) {
-      uint32_t* pt = pde_get_pt(*pde);
-      uint32_t* pte;
-
-      for (pte = pt; pte < pt + PGSIZE / sizeof *pte; pte++)
-        if (*pte & PTE_P)
-          palloc_free_page(pte_get_page(*pte));
-      palloc_free_page(pt);
+  lock_acquire(&pd_lock);
+  info = find_info(pd);
+  hash_delete(&pd_infos, &info->elem);
+  list_push_back(&reap_list, &info->reap_elem);
+  lock_release(&pd_lock);
+  work_queue(&reap_work, WORK_LOW);
+}
+
+/* The reaper.  Destroys the page directories on reap_list and
+   frees their bookkeeping and that on reaped_list. */
+static void reap(void* aux UNUSED) {
+  for (;;) {
+    struct pd_info* info = NULL;
+    bool destroyed = false;
+
+    lock_acquire(&pd_lock);
+    if (!list_empty(&reaped_list)) {
+      info = list_entry(list_pop_front(&reaped_list), struct pd_info, reap_elem);
+      destroyed = true;
+    } else if (!list_empty(&reap_list)) {
+      info = list_entry(list_pop_front(&reap_list), struct pd_info, reap_elem);
+      reap_cnt++;
+    }
+    lock_release(&pd_lock);
+
+    if (info == NULL)
+      return;
+    if (!destroyed)
+      destroy(info);
+    free(info);
+  }
+}
+
+/* Destroys the page directories on reap_list at once, for the
+   page allocator when a pool runs out.  Leaves their bookkeeping
+   to the reaper, because the allocator's caller may hold a lock
+   that free() needs.  Returns true if there were any. */
+static bool pagedir_reclaim(void) {
+  bool any = false;
+
+  for (;;) {
+    struct pd_info* info;
+
+    lock_acquire(&pd_lock);
+    if (list_empty(&reap_list)) {
+      lock_release(&pd_lock);
+      break;
     }
-  palloc_free_page(pd);
+    info = list_entry(list_pop_front(&reap_list), struct pd_info, reap_elem);
+    reclaim_cnt++;
+    lock_release(&pd_lock);
+
+    destroy(info);
+    lock_acquire(&pd_lock);
+    list_push_back(&reaped_list, &info->reap_elem);
+    lock_release(&pd_lock);
+    any = true;
+  }
+  if (any)
+    work_queue(&reap_work, WORK_LOW);
+  return any;
+}
+
+/* Frees the page tables of the page directory that INFO
+   describes, with the pages they map, and then the directory,
+   keeping them for reuse if the caches have room. */
+static void destroy(struct pd_info* info) {
+  uint32_t* pd = info->pd;
+  int i;
+
+  while ((i = pop_used(info->used)) != -1)
+    if (pd[i] & PTE_P) {
+      free_page_table(pde_get_pt(pd[i]));
+      pd[i] = 0;
+    }
+
+  lock_acquire(&pd_lock);
+  if (pd_cache_cnt < PD_CACHE_SIZE) {
+    pd_cache[pd_cache_cnt++] = pd;
+    pd = NULL;
+  }
+  lock_release(&pd_lock);
+  if (pd != NULL)
+    palloc_free_page(pd);
+}
+
+/* Maps a copy of each user page mapped in SRC at the same
+   address in DST, which must have no user pages of its own
+   besides the shared page that pagedir_create() maps.
+   Returns false if memory runs out, leaving the pages copied so
+   far in DST. */
+bool pagedir_copy(uint32_t* dst, uint32_t* src) {
+  uint32_t used[USED_WORDS];
+  int pde;
+
+  lock_acquire(&pd_lock);
+  memcpy(used, find_info(src)->used, sizeof used);
+  lock_release(&pd_lock);
+
+  while ((pde = pop_used(used)) != -1)
+    if (src[pde] & PTE_P) {
+      uint32_t* pt = pde_get_pt(src[pde]);
+      size_t i;
+
+      for (i = 0; i < PGSIZE / sizeof *pt; i++)
+        if ((pt[i] & (PTE_P | PTE_SHARED)) == PTE_P) {
+          void* upage = (void*)(((uintptr_t)pde << PDSHIFT) | (i << PTSHIFT));
+          void* kpage = palloc_get_page(PAL_USER);
+
+          if (kpage == NULL)
+            return false;
+          memcpy(kpage, pte_get_page(pt[i]), PGSIZE);
+          if (!pagedir_set_page(dst, upage, kpage, (pt[i] & PTE_W) != 0)) {
+            palloc_free_page(kpage);
+            return false;
+          }
+        }
+    }
+  return true;
 }
 
 /* Returns the address of the page table entry for virtual
@@ -57,11 +309,25 @@ static uint32_t* lookup_page(uint32_t* pd, const void* vaddr, bool create) {
   ASSERT(!create || is_user_vaddr(vaddr));
 
   /* Check for a page table for VADDR.
-     If one is missing, create one if requested. */
+     If one is missing, create one if requested, from the cache if
+     possible, and note that PD uses the entry. */
   pde = pd + pd_no(vaddr);
   if (*pde == 0) {
     if (create) {
-      pt = palloc_get_page(PAL_ZERO);
+      size_t i = pde - pd;
+
+      pt = NULL;
+      lock_acquire(&pd_lock);
+      find_info(pd)->used[i / 32] |= 1u << (i % 32);
+      if (pt_cache_cnt > 0) {
+        pt = pt_cache[--pt_cache_cnt];
+        pt_hits++;
+      } else
+        pt_misses++;
+      lock_release(&pd_lock);
+
+      if (pt == NULL)
+        pt = palloc_get_page(PAL_ZERO);
       if (pt == NULL)
         return NULL;
 
@@ -75,6 +341,15 @@ static uint32_t* lookup_page(uint32_t* pd, const void* vaddr, bool create) {
   return &pt[pt_no(vaddr)];
 }
 
+/* Returns how many of the pages from UPAGE up to END have their
+   entries in the same page table as UPAGE. */
+static size_t pt_run(const uint8_t* upage, const uint8_t* end) {
+  size_t n = PGSIZE / sizeof(uint32_t) - pt_no(upage);
+  size_t left = (end - upage) / PGSIZE;
+
+  return n < left ? n : left;
+}
+
 /* Adds a mapping in page directory PD from user virtual page
    UPAGE to the physical frame identified by kernel virtual
    address KPAGE.
@@ -86,40 +361,106 @@ static uint32_t* lookup_page(uint32_t* pd, const void* vaddr, bool create) {
    Returns true if successful, false if memory allocation
    failed. */
 bool pagedir_set_page(uint32_t* pd, void* upage, void* kpage, bool writable) {
+  ASSERT(pg_ofs(kpage) == 0);
+  return pagedir_set_phys(pd, upage, vtop(kpage), writable);
+}
+
+/* Like pagedir_set_page(), but maps UPAGE to the frame at
+   physical address PADDR, which may be in high memory. */
+bool pagedir_set_phys(uint32_t* pd, void* upage, uintptr_t paddr, bool writable) {
   uint32_t* pte;
 
   ASSERT(pg_ofs(upage) == 0);
-  ASSERT(pg_ofs(kpage) == 0);
+  ASSERT((paddr & PGMASK) == 0);
   ASSERT(is_user_vaddr(upage));
-  ASSERT(vtop(kpage) >> PTSHIFT < init_ram_pages);
+  ASSERT(paddr >> PGBITS < init_ram_pages);
   ASSERT(pd != init_page_dir);
 
   pte = lookup_page(pd, upage, true);
 
   if (pte != NULL) {
     ASSERT((*pte & PTE_P) == 0);
-    *pte = pte_create_user(kpage, writable);
+    *pte = pte_create_phys(paddr, writable) | PTE_U;
     return true;
   } else
     return false;
 }
 
+/* Maps the PAGE_CNT consecutive user virtual pages starting at
+   UPAGE to the PAGE_CNT consecutive frames starting at kernel
+   virtual address KPAGE, like as many calls to
+   pagedir_set_page(), but with one walk of PD for each page table
+   the range touches instead of one for each page.
+   If WRITABLE is true, the new pages are read/write; otherwise
+   they are read-only.
+   Returns true if successful, or false, mapping nothing, if any
+   of the user pages is already mapped or memory allocation
+   failed. */
+bool pagedir_set_range(uint32_t* pd, void* upage, void* kpage, size_t page_cnt, bool writable) {
+  uint8_t* end = (uint8_t*)upage + page_cnt * PGSIZE;
+  uint8_t *u, *k;
+  size_t i, n;
+
+  ASSERT(pg_ofs(upage) == 0);
+  ASSERT(pg_ofs(kpage) == 0);
+  ASSERT(is_user_vaddr(upage));
+  ASSERT(page_cnt == 0 || is_user_vaddr(end - 1));
+  ASSERT((vtop(kpage) >> PGBITS) + page_cnt <= init_lowmem_pages);
+  ASSERT(pd != init_page_dir);
+
+  /* Make sure every page table exists and every entry is free
+     before changing any, so that a failure maps nothing. */
+  for (u = upage; u < end; u += n * PGSIZE) {
+    uint32_t* pte = lookup_page(pd, u, true);
+
+    if (pte == NULL)
+      return false;
+    n = pt_run(u, end);
+    for (i = 0; i < n; i++)
+      if (pte[i] & PTE_P)
+        return false;
+  }
+
+  /* Fill the entries, one page table at a time. */
+  for (u = upage, k = kpage; u < end; u += n * PGSIZE, k += n * PGSIZE) {
+    uint32_t* pte = lookup_page(pd, u, false);
+
+    n = pt_run(u, end);
+    for (i = 0; i < n; i++)
+      pte[i] = pte_create_user(k + i * PGSIZE, writable);
+  }
+  return true;
+}
+
 /* Looks up the physical address that corresponds to user virtual
    address UADDR in PD.  Returns the kernel virtual address
    corresponding to that physical address, or a null pointer if
-   UADDR is unmapped. */
+   UADDR is unmapped.  UADDR must not be mapped to a frame in
+   high memory, which has no kernel virtual address; use
+   pagedir_is_mapped() only to ask whether a page is mapped. */
 void* pagedir_get_page(uint32_t* pd, const void* uaddr) {
   uint32_t* pte;
 
   ASSERT(is_user_vaddr(uaddr));
 
   pte = lookup_page(pd, uaddr, false);
-  if (pte != NULL && (*pte & PTE_P) != 0)
+  if (pte != NULL && (*pte & PTE_P) != 0) {
+    ASSERT(!is_highmem(*pte & PTE_ADDR));
     return pte_get_page(*pte) + pg_ofs(uaddr);
-  else
+  } else
     return NULL;
 }
 
+/* Returns true if user virtual address UADDR is mapped in PD. */
+bool pagedir_is_mapped(uint32_t* pd, const void* uaddr) {
+  uint32_t* pte;
+
+  ASSERT(is_user_vaddr(uaddr));
+
+  pte = lookup_page(pd, uaddr, false);
+  return pte != NULL && (*pte & PTE_P) != 0;
+}
+
 /* Marks user virtual page UPAGE "not present" in page
    directory PD.  Later accesses to the page will fault.  Other
    bits in the page table entry are preserved.
@@ -133,10 +474,36 @@ void pagedir_clear_page(uint32_t* pd, void* upage) {
   pte = lookup_page(pd, upage, false);
   if (pte != NULL && (*pte & PTE_P) != 0) {
     *pte &= ~PTE_P;
-    invalidate_pagedir(pd);
+    invalidate_page(pd, upage);
   }
 }
 
+/* Marks the PAGE_CNT pages starting at UPAGE "not present" in
+   page directory PD, like pagedir_clear_page() on each, but
+   flushes the TLBs that may hold them only once.  The pages need
+   not be mapped. */
+void pagedir_clear_range(uint32_t* pd, void* upage, size_t page_cnt) {
+  uint8_t* p = upage;
+  size_t i;
+
+  ASSERT(pg_ofs(upage) == 0);
+  ASSERT(is_user_vaddr(p + page_cnt * PGSIZE - 1));
+
+  for (i = 0; i < page_cnt; i++) {
+    uint32_t* pte = lookup_page(pd, p + i * PGSIZE, false);
+    if (pte != NULL)
+      *pte &= ~PTE_P;
+  }
+  tlb_shootdown(pd, upage, page_cnt);
+}
+
+/* Returns true if PD maps virtual page VPAGE writable.
+   Returns false if PD contains no PTE for VPAGE. */
+bool pagedir_is_writable(uint32_t* pd, const void* vpage) {
+  uint32_t* pte = lookup_page(pd, vpage, false);
+  return pte != NULL && (*pte & (PTE_P | PTE_W)) == (PTE_P | PTE_W);
+}
+
 /* Returns true if the PTE for virtual page VPAGE in PD is dirty,
    that is, if the page has been modified since the PTE was
    installed.
@@ -155,7 +522,7 @@ void pagedir_set_dirty(uint32_t* pd, const void* vpage, bool dirty) {
       *pte |= PTE_D;
     else {
       *pte &= ~(uint32_t)PTE_D;
-      invalidate_pagedir(pd);
+      invalidate_page(pd, vpage);
     }
   }
 }
@@ -178,16 +545,22 @@ void pagedir_set_accessed(uint32_t* pd, const void* vpage, bool accessed) {
       *pte |= PTE_A;
     else {
       *pte &= ~(uint32_t)PTE_A;
-      invalidate_pagedir(pd);
+      invalidate_page(pd, vpage);
     }
   }
 }
 
 /* Loads page directory PD into the CPU's page directory base
-   register. */
+   register, unless it is already there.  Loading CR3 flushes the
+   TLB of everything but global pages, which is why the kernel's
+   own mappings are global (see paging_init()), and why changes
+   to the active page directory invalidate single pages instead. */
 void pagedir_activate(uint32_t* pd) {
   if (pd == NULL)
     pd = init_page_dir;
+  cpu_current()->pagedir = pd;
+  if (pd == active_pd())
+    return;
 
   /* Store the physical address of the page directory into CR3
      aka PDBR (page directory base register).  This activates our
@@ -197,6 +570,79 @@ void pagedir_activate(uint32_t* pd) {
   asm volatile("movl %0, %%cr3" : : "r"(vtop(pd)) : "memory");
 }
 
+/* Prints page directory and page table reuse statistics. */
+void pagedir_print_stats(void) {
+  printf("Page directories: %lld reused, %lld allocated, %lld reaped, %lld reclaimed\n", pd_hits,
+         pd_misses, reap_cnt, reclaim_cnt);
+  printf("Page tables: %lld reused, %lld allocated\n", pt_hits, pt_misses);
+}
+
+/* Frees the pages mapped in page table PT, except shared ones,
+   and clears it, then keeps it for reuse if the cache has room
+   or frees it. */
+static void free_page_table(uint32_t* pt) {
+  uint32_t* pte;
+
+  for (pte = pt; pte < pt + PGSIZE / sizeof *pte; pte++)
+    if (*pte != 0) {
+      if ((*pte & (PTE_P | PTE_SHARED)) == PTE_P)
+        palloc_free_page(pte_get_page(*pte));
+      *pte = 0;
+    }
+
+  lock_acquire(&pd_lock);
+  if (pt_cache_cnt < PT_CACHE_SIZE) {
+    pt_cache[pt_cache_cnt++] = pt;
+    pt = NULL;
+  }
+  lock_release(&pd_lock);
+  if (pt != NULL)
+    palloc_free_page(pt);
+}
+
+/* Returns the bookkeeping of PD, which pagedir_create() must have
+   returned.  The caller must hold pd_lock. */
+static struct pd_info* find_info(uint32_t* pd) {
+  struct pd_info key;
+  struct hash_elem* e;
+
+  ASSERT(lock_held_by_current_thread(&pd_lock));
+
+  key.pd = pd;
+  e = hash_find(&pd_infos, &key.elem);
+  ASSERT(e != NULL);
+  return hash_entry(e, struct pd_info, elem);
+}
+
+/* Clears the lowest set bit in USED and returns its index, or
+   returns -1 if no bit is set. */
+static int pop_used(uint32_t used[USED_WORDS]) {
+  size_t i;
+
+  for (i = 0; i < USED_WORDS; i++)
+    if (used[i] != 0) {
+      int bit = __builtin_ctz(used[i]);
+
+      used[i] &= used[i] - 1;
+      return i * 32 + bit;
+    }
+  return -1;
+}
+
+/* Returns a hash value for pd_info E. */
+static unsigned pd_info_hash(const struct hash_elem* e, void* aux UNUSED) {
+  const struct pd_info* info = hash_entry(e, struct pd_info, elem);
+  return hash_bytes(&info->pd, sizeof info->pd);
+}
+
+/* Returns true if pd_info A precedes pd_info B. */
+static bool pd_info_less(const struct hash_elem* a_, const struct hash_elem* b_,
+                         void* aux UNUSED) {
+  const struct pd_info* a = hash_entry(a_, struct pd_info, elem);
+  const struct pd_info* b = hash_entry(b_, struct pd_info, elem);
+  return a->pd < b->pd;
+}
+
 /* Returns the currently active page directory. */
 static uint32_t* active_pd(void) {
   /* Copy CR3, the page directory base register (PDBR), into
@@ -208,18 +654,14 @@ static uint32_t* active_pd(void) {
   return ptov(pd);
 }
 
-/* Seom page table changes can cause the CPU's translation
+/* Some page table changes can cause the CPU's translation
    lookaside buffer (TLB) to become out-of-sync with the page
-   table.  When this happens, we have to "invalidate" the TLB by
-   re-activating it.
-
-   This function invalidates the TLB if PD is the active page
-   directory.  (If PD is not active then its entries are not in
-   the TLB, so there is no need to invalidate anything.) */
-static void invalidate_pagedir(uint32_t* pd) {
-  if (active_pd() == pd) {
-    /* Re-activating PD clears the TLB.  See [IA32-v3a] 3.12
-         "Translation Lookaside Buffers (TLBs)". */
-    pagedir_activate(pd);
-  }
-}
+   table.  When this happens, we have to "invalidate" the stale
+   entry.
+
+   This function invalidates the TLB entry for VADDR on every CPU
+   that has PD active.  (If PD is not active then its entries
+   are not in the TLB, so there is no need to invalidate
+   anything.)  See [IA32-v3a] 3.12 "Translation Lookaside Buffers
+   (TLBs)" and [IA32-v2a] "INVLPG". */
+static void invalidate_page(uint32_t* pd, const void* vaddr) { tlb_shootdown(pd, vaddr, 1); }
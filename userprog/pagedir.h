@@ -2,17 +2,27 @@
 #define USERPROG_PAGEDIR_H
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
+void pagedir_init(void);
 uint32_t* pagedir_create(void);
 void pagedir_destroy(uint32_t* pd);
+void pagedir_destroy_async(uint32_t* pd);
+bool pagedir_copy(uint32_t* dst, uint32_t* src);
 bool pagedir_set_page(uint32_t* pd, void* upage, void* kpage, bool rw);
+bool pagedir_set_phys(uint32_t* pd, void* upage, uintptr_t paddr, bool rw);
+bool pagedir_set_range(uint32_t* pd, void* upage, void* kpage, size_t page_cnt, bool rw);
 void* pagedir_get_page(uint32_t* pd, const void* upage);
+bool pagedir_is_mapped(uint32_t* pd, const void* upage);
 void pagedir_clear_page(uint32_t* pd, void* upage);
+void pagedir_clear_range(uint32_t* pd, void* upage, size_t page_cnt);
+bool pagedir_is_writable(uint32_t* pd, const void* upage);
 bool pagedir_is_dirty(uint32_t* pd, const void* upage);
 void pagedir_set_dirty(uint32_t* pd, const void* upage, bool dirty);
 bool pagedir_is_accessed(uint32_t* pd, const void* upage);
 void pagedir_set_accessed(uint32_t* pd, const void* upage, bool accessed);
 void pagedir_activate(uint32_t* pd);
+void pagedir_print_stats(void);
 
 #endif /* userprog/pagedir.h */
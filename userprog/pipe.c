@@ -0,0 +1,198 @@
+#include "userprog/pipe.h"
+#include <debug.h>
+#include <poll.h>
+#include <stdint.h>
+#include <string.h>
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+#include "threads/waitq.h"
+
+/* Anonymous pipes.
+
+   A pipe is a ring buffer of one page in kernel memory, with a
+   count of the descriptors open on each end.  Reads wait until
+   there is data or no writer is left, then return what is there,
+   up to the size asked for.  Writes wait for room until all of
+   their data is in the ring, or until no reader is left.  Data
+   never touches the file system.  A descriptor set to
+   O_NONBLOCK reads and writes without waiting instead, and
+   poll() waits for either end through the pipe's wait queue,
+   which is woken along with the condition variables.
+
+   The descriptors of either end may be shared by several
+   processes, through fork() or exec(), so each pipe has a lock.
+   Readers and writers copy to and from user memory while holding
+   it, which may fault a user page in; nothing on that path takes
+   a pipe lock. */
+
+/* A pipe. */
+struct pipe {
+  struct lock lock;          /* Protects everything here. */
+  struct condition readable; /* Signaled when data arrives or the last writer goes. */
+  struct condition writable; /* Signaled when room appears or the last reader goes. */
+  uint8_t* buf;              /* Ring buffer of PGSIZE bytes. */
+  size_t start;              /* Offset of the first byte in BUF. */
+  size_t len;                /* Number of bytes in BUF. */
+  int readers;               /* Descriptors open on the read end. */
+  int writers;               /* Descriptors open on the write end. */
+  struct waitq pollers;      /* Threads in poll(), woken along with READABLE and WRITABLE. */
+};
+
+/* Creates a pipe with one descriptor open on each end.  Returns
+   a null pointer if memory runs out. */
+struct pipe* pipe_create(void) {
+  struct pipe* p = malloc(sizeof *p);
+
+  if (p == NULL)
+    return NULL;
+  p->buf = palloc_get_page(0);
+  if (p->buf == NULL) {
+    free(p);
+    return NULL;
+  }
+  lock_init(&p->lock);
+  cond_init(&p->readable);
+  cond_init(&p->writable);
+  waitq_init(&p->pollers);
+  p->start = p->len = 0;
+  p->readers = p->writers = 1;
+  return p;
+}
+
+/* Records another descriptor open on the write end of P if
+   WRITER is true, or on its read end otherwise. */
+void pipe_dup(struct pipe* p, bool writer) {
+  lock_acquire(&p->lock);
+  if (writer)
+    p->writers++;
+  else
+    p->readers++;
+  lock_release(&p->lock);
+}
+
+/* Closes a descriptor open on the write end of P if WRITER is
+   true, or on its read end otherwise.  Frees P when no
+   descriptor is left on either end. */
+void pipe_close(struct pipe* p, bool writer) {
+  bool dead;
+
+  lock_acquire(&p->lock);
+  if (writer) {
+    ASSERT(p->writers > 0);
+    if (--p->writers == 0) {
+      cond_broadcast(&p->readable, &p->lock);
+      waitq_wake(&p->pollers);
+    }
+  } else {
+    ASSERT(p->readers > 0);
+    if (--p->readers == 0) {
+      cond_broadcast(&p->writable, &p->lock);
+      waitq_wake(&p->pollers);
+    }
+  }
+  dead = p->readers == 0 && p->writers == 0;
+  lock_release(&p->lock);
+
+  if (dead) {
+    palloc_free_page(p->buf);
+    free(p);
+  }
+}
+
+/* Reads up to SIZE bytes from P into BUFFER and returns the
+   number read.  If P is empty, and has no writer left, returns 0
+   for end of file.  If P is empty but still has a writer, first
+   waits until it is not if BLOCK is true, or else returns -1. */
+int pipe_read(struct pipe* p, void* buffer, size_t size, bool block) {
+  uint8_t* dst = buffer;
+  size_t done = 0;
+
+  lock_acquire(&p->lock);
+  while (block && size > 0 && p->len == 0 && p->writers > 0)
+    cond_wait(&p->readable, &p->lock);
+  if (size > 0 && p->len == 0 && p->writers > 0) {
+    lock_release(&p->lock);
+    return -1;
+  }
+  while (done < size && p->len > 0) {
+    size_t chunk = PGSIZE - p->start;
+
+    if (chunk > p->len)
+      chunk = p->len;
+    if (chunk > size - done)
+      chunk = size - done;
+    memcpy(dst + done, p->buf + p->start, chunk);
+    p->start = (p->start + chunk) % PGSIZE;
+    p->len -= chunk;
+    done += chunk;
+  }
+  if (done > 0) {
+    cond_broadcast(&p->writable, &p->lock);
+    waitq_wake(&p->pollers);
+  }
+  lock_release(&p->lock);
+  return done;
+}
+
+/* Writes the SIZE bytes at BUFFER to P, waiting for room as
+   needed, and returns the number written.  Returns fewer than
+   SIZE if the last reader goes away in the meantime, or -1 if P
+   had no reader to begin with.  If BLOCK is false, never waits:
+   writes what fits, and returns -1 if nothing does. */
+int pipe_write(struct pipe* p, const void* buffer, size_t size, bool block) {
+  const uint8_t* src = buffer;
+  size_t done = 0;
+
+  lock_acquire(&p->lock);
+  if (p->readers == 0) {
+    lock_release(&p->lock);
+    return -1;
+  }
+  while (done < size && p->readers > 0) {
+    size_t end = (p->start + p->len) % PGSIZE;
+    size_t chunk = PGSIZE - p->len;
+
+    if (chunk == 0 && !block)
+      break;
+    if (chunk == 0) {
+      cond_wait(&p->writable, &p->lock);
+      continue;
+    }
+    if (chunk > PGSIZE - end)
+      chunk = PGSIZE - end;
+    if (chunk > size - done)
+      chunk = size - done;
+    memcpy(p->buf + end, src + done, chunk);
+    p->len += chunk;
+    done += chunk;
+    cond_broadcast(&p->readable, &p->lock);
+    waitq_wake(&p->pollers);
+  }
+  lock_release(&p->lock);
+  return done > 0 || size == 0 || block ? (int)done : -1;
+}
+
+/* Returns the poll() events that are ready on the write end of
+   P, if WRITER is true, or on its read end otherwise.  If E is
+   not null, first puts it in P's queue of waiters on behalf of
+   W. */
+int pipe_poll(struct pipe* p, bool writer, struct waitq_entry* e, struct waitq_waiter* w) {
+  int events = 0;
+
+  lock_acquire(&p->lock);
+  if (e != NULL)
+    waitq_add(&p->pollers, e, w);
+  if (!writer) {
+    if (p->len > 0)
+      events |= POLLIN;
+    if (p->writers == 0)
+      events |= POLLIN | POLLHUP;
+  } else if (p->readers == 0)
+    events |= POLLERR;
+  else if (p->len < PGSIZE)
+    events |= POLLOUT;
+  lock_release(&p->lock);
+  return events;
+}
@@ -0,0 +1,115 @@
+#include "userprog/poll.h"
+#include <poll.h>
+#include <round.h>
+#include "devices/input.h"
+#include "devices/timer.h"
+#include "threads/malloc.h"
+#include "threads/waitq.h"
+#include "userprog/fd.h"
+#include "userprog/handlers.h"
+#include "userprog/pipe.h"
+
+/* Waiting for descriptors to become ready.
+
+   poll_fds() lets one thread serve many pipes, and the console,
+   without blocking on any one of them or spinning.  Each pipe,
+   and the console's input buffer, has a wait queue (see
+   threads/waitq.c) that it wakes whenever it may have become
+   ready.  On its first pass over the descriptors, poll_fds()
+   puts an entry for the thread in the queue of each one that it
+   checks; if none is ready, it sleeps until one of the queues is
+   woken, or its time runs out, and checks them all again.  Files
+   and console output are always ready.
+
+   Each polled pipe end counts a descriptor for the duration (see
+   fd_get_pipe()), so a pipe cannot be freed with our entry still
+   in its queue, even if another thread closes the descriptor. */
+
+/* A descriptor being polled. */
+struct poll_target {
+  struct pollfd pfd;        /* Copy of the caller's entry. */
+  struct pipe* pipe;        /* Pipe that PFD.fd is an end of, or null. */
+  bool writer;              /* With PIPE, the write end? */
+  struct waitq_entry entry; /* Entry in PIPE's or the console's wait queue. */
+};
+
+static int poll_target(struct poll_target*, struct waitq_waiter*, bool first);
+
+/* Waits until at least one of the NFDS descriptors in FDS has
+   one of the events it asks for, or until TIMEOUT milliseconds
+   have passed, or forever if TIMEOUT is negative.  Sets the
+   `revents' of each of FDS, and returns the number with events,
+   0 on a timeout, or -1 if memory runs out. */
+int poll_fds(struct pollfd* fds, int nfds, int timeout) {
+  struct poll_target* targets = NULL;
+  struct waitq_waiter w;
+  int64_t deadline = 0;
+  bool first;
+  int ready;
+  int i;
+
+  if (nfds > 0) {
+    targets = calloc(nfds, sizeof *targets);
+    if (targets == NULL)
+      return -1;
+  }
+  for (i = 0; i < nfds; i++) {
+    targets[i].pfd = fds[i];
+    targets[i].pipe = fd_get_pipe(fds[i].fd, &targets[i].writer);
+  }
+
+  waitq_waiter_init(&w);
+  if (timeout > 0)
+    deadline = timer_ticks() + DIV_ROUND_UP((int64_t)timeout * TIMER_FREQ, 1000);
+  for (first = true;; first = false) {
+    int64_t ticks = -1;
+
+    ready = 0;
+    for (i = 0; i < nfds; i++)
+      if (poll_target(&targets[i], &w, first) != 0)
+        ready++;
+    if (ready > 0 || timeout == 0)
+      break;
+    if (timeout > 0) {
+      ticks = deadline - timer_ticks();
+      if (ticks <= 0)
+        break;
+    }
+    waitq_wait(&w, ticks);
+  }
+
+  for (i = 0; i < nfds; i++) {
+    waitq_remove(&targets[i].entry);
+    if (targets[i].pipe != NULL)
+      pipe_close(targets[i].pipe, targets[i].writer);
+    fds[i].revents = targets[i].pfd.revents;
+  }
+  free(targets);
+  return ready;
+}
+
+/* Checks T for events, stores those that it asks for in its
+   `revents', along with any error, and returns them.  On the
+   FIRST pass, also puts T's entry in the wait queue of the
+   object it polls, on behalf of W. */
+static int poll_target(struct poll_target* t, struct waitq_waiter* w, bool first) {
+  struct waitq_entry* e = first ? &t->entry : NULL;
+  int fd = t->pfd.fd;
+  int events;
+
+  if (fd < 0)
+    events = 0;
+  else if (t->pipe != NULL)
+    events = pipe_poll(t->pipe, t->writer, e, w);
+  else if (fd == STDIN_FD)
+    events = input_poll(e, w) ? POLLIN : 0;
+  else if (fd == STDOUT_FD)
+    events = POLLOUT;
+  else if (fd_lookup(fd) != NULL)
+    events = POLLIN | POLLOUT;
+  else
+    events = POLLNVAL;
+  events &= t->pfd.events | POLLERR | POLLHUP | POLLNVAL;
+  t->pfd.revents = events;
+  return events;
+}
@@ -0,0 +1,8 @@
+#ifndef USERPROG_POLL_H
+#define USERPROG_POLL_H
+
+struct pollfd;
+
+int poll_fds(struct pollfd*, int nfds, int timeout);
+
+#endif /* userprog/poll.h */
@@ -2,68 +2,228 @@
 #include "filesys/directory.h"
 #include "filesys/file.h"
 #include "filesys/filesys.h"
+#include "filesys/initramfs.h"
+#include "filesys/inode.h"
 #include "threads/flags.h"
+#include "threads/fpu.h"
 #include "threads/init.h"
 #include "threads/interrupt.h"
 #include "threads/malloc.h"
+#include "threads/slab.h"
 #include "threads/palloc.h"
 #include "threads/thread.h"
 #include "threads/vaddr.h"
+#include "threads/vdso.h"
+#include "userprog/fd.h"
+#include "userprog/futex.h"
 #include "userprog/gdt.h"
 #include "userprog/handlers.h"
+#include "userprog/heap.h"
 #include "userprog/pagedir.h"
+#include "userprog/ioring.h"
+#include "userprog/shm.h"
 #include "userprog/tss.h"
+#include "userprog/usermem.h"
+#ifdef VM
+#include "vm/mmap.h"
+#include "vm/page.h"
+#endif
 #include <debug.h>
 #include <inttypes.h>
 #include <round.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+/* Most arguments a command line may have. */
+#define EXEC_MAX_ARGS 128
+
+/* A command line split into arguments, with its executable
+   already open.  execute() builds one at the start of a page and
+   hands the page to the child, so the command line is copied and
+   parsed once, and the executable opened once, per exec.
+
+   The arguments are packed into CMDLINE exactly as they go on the
+   user stack, each followed by a null, so that setup_stack()
+   copies them with one memcpy(). */
+struct exec_args {
+  struct file* file;         /* Executable, owned by the child. */
+  bool spawn;                /* Release the parent after the ELF header? */
+  bool released;             /* Has the parent been released? */
+  int argc;                  /* Number of arguments. */
+  size_t arg_len;            /* Bytes of packed arguments in CMDLINE. */
+  char* argv[EXEC_MAX_ARGS]; /* Arguments, pointing into CMDLINE. */
+  char cmdline[];            /* Command line, packed in place. */
+};
+
+/* Room for the command line in an exec_args page. */
+#define CMDLINE_MAX (PGSIZE - offsetof(struct exec_args, cmdline))
+
 static thread_func start_process NO_RETURN;
-static bool load(const char* cmdline, void (**eip)(void), void** esp);
+static thread_func start_fork NO_RETURN;
+static thread_func start_thread NO_RETURN;
+static bool load(struct exec_args* args, void (**eip)(void), void** esp);
+static bool fork_files(struct thread* parent);
+static bool fork_address_space(struct thread* parent);
 
 extern struct list all_list;
 
+/* Copies CMDLINE, which is at a user address if USER is true,
+   into a new page and splits it into arguments.  Returns the
+   page, or a null pointer if no page is free or CMDLINE is
+   empty, too long, or has too many arguments.  Kills the current
+   process if CMDLINE is a bad user pointer. */
+static struct exec_args* parse_cmdline(const char* cmdline, bool user) {
+  struct exec_args* args = palloc_get_page(0);
+  const char* src;
+  char* dst;
+  size_t len;
+
+  if (args == NULL)
+    return NULL;
+  if (user) {
+    int ulen = strncpy_from_user(args->cmdline, cmdline, CMDLINE_MAX);
+
+    if (ulen < 0) {
+      palloc_free_page(args);
+      SYSCALL_exit_handler(-1);
+    }
+    len = ulen;
+  } else
+    len = strlcpy(args->cmdline, cmdline, CMDLINE_MAX);
+  if (len >= CMDLINE_MAX)
+    goto fail;
+
+  /* Squeeze out the spaces in one pass, leaving each argument
+     null-terminated right after the previous one. */
+  args->argc = 0;
+  for (src = dst = args->cmdline; *src != '\0';) {
+    if (*src == ' ') {
+      src++;
+      continue;
+    }
+    if (args->argc == EXEC_MAX_ARGS)
+      goto fail;
+    args->argv[args->argc++] = dst;
+    while (*src != ' ' && *src != '\0')
+      *dst++ = *src++;
+    *dst++ = '\0';
+  }
+  if (args->argc == 0)
+    goto fail;
+  args->arg_len = dst - args->cmdline;
+  args->file = NULL;
+  args->spawn = false;
+  args->released = false;
+  return args;
+
+fail:
+  palloc_free_page(args);
+  return NULL;
+}
+
+/* Returns true if the current process may not start another
+   child, because as many as its RLIMIT_NPROC limit allows have
+   not been waited for yet. */
+static bool too_many_children(void) {
+  struct thread* t = thread_current()->process;
+
+  return hash_size(&t->process_children) >= t->rlimits[RLIMIT_NPROC];
+}
+
 /* Starts a new thread running a user program loaded from
-   FILENAME.  The new thread may be scheduled (and may even exit)
-   before process_execute() returns.  Returns the new process's
-   thread id, or TID_ERROR if the thread cannot be created. */
-tid_t process_execute(const char* file_name) {
-  char* filename_temp;
-  char* f_name;
+   FILE_NAME, which is at a user address if USER is true, and
+   waits for the new thread to release it: once the program is
+   loaded, or if SPAWN is true, once its ELF header has been read
+   and checked.  Returns the new process's thread id, or TID_ERROR
+   if the process has too many children, the thread cannot be
+   created or the program cannot be loaded as far as that. */
+static tid_t execute(const char* file_name, bool user, bool spawn) {
+  struct exec_args* args;
   tid_t tid;
 
-  /* Make a copy of FILE_NAME.
+  if (too_many_children())
+    return TID_ERROR;
+
+  /* Parse a copy of FILE_NAME.
      Otherwise there's a race between the caller and load(). */
-  filename_temp = palloc_get_page(0);
-  if (filename_temp == NULL)
+  args = parse_cmdline(file_name, user);
+  if (args == NULL)
+    return TID_ERROR;
+  args->spawn = spawn;
+
+  /* Open the executable here, so that a missing one fails
+     without creating a thread.  A program in the initramfs is
+     read from memory. */
+  args->file = initramfs_open(args->argv[0]);
+  if (args->file == NULL)
+    args->file = filesys_open(args->argv[0]);
+  if (args->file == NULL) {
+    printf("load: %s: open failed\n", args->argv[0]);
+    palloc_free_page(args);
     return TID_ERROR;
-  strlcpy(filename_temp, file_name, PGSIZE);
-  char* save_ptr;
-  f_name = malloc(strlen(file_name) + 1);
-  strlcpy(f_name, file_name, strlen(file_name) + 1);
-  f_name = strtok_r(f_name, " ", &save_ptr);
+  }
+
   /* Create a new thread to execute FILE_NAME. */
-  // printf("%d\n", thread_current()->tid);
-  tid = thread_create(f_name, PRI_DEFAULT, start_process, filename_temp);
-  free(f_name);
-  if (tid == TID_ERROR)
-    palloc_free_page(filename_temp);
+  tid = thread_create(args->argv[0], PRI_DEFAULT, start_process, args);
+  if (tid == TID_ERROR) {
+    file_close(args->file);
+    palloc_free_page(args);
+    return TID_ERROR;
+  }
 
   sema_down(&thread_current()->child_process_lock);
 
-  if (!thread_current()->complete)
-    return -1;
+  if (!thread_current()->complete) {
+    /* Nobody can wait for the child, which is exiting. */
+    thread_forget_child(thread_find_child(tid));
+    return TID_ERROR;
+  }
 
   return tid;
 }
 
+/* Starts a new thread running a user program loaded from
+   FILENAME.  The new thread may be scheduled (and may even exit)
+   before process_execute() returns.  Returns the new process's
+   thread id, or TID_ERROR if the thread cannot be created or the
+   program cannot be loaded. */
+tid_t process_execute(const char* file_name) { return execute(file_name, false, false); }
+
+/* Like process_execute(), but returns as soon as the new process
+   has checked its ELF header, while it loads its segments and
+   builds its stack.  If that fails, the process exits with
+   status -1, which process_wait() reports as usual.  Returns
+   TID_ERROR only if the program cannot be opened or its header is
+   bad. */
+tid_t process_spawn(const char* file_name) { return execute(file_name, false, true); }
+
+/* Like process_execute() or, if SPAWN is true, process_spawn(),
+   for a command line at user address UCMD_LINE, which is copied
+   straight into the page handed to the new process.  Kills the
+   current process if UCMD_LINE is a bad pointer. */
+tid_t process_execute_user(const char* ucmd_line, bool spawn) {
+  return execute(ucmd_line, true, spawn);
+}
+
+/* Releases the thread that created the current one, which is
+   waiting in execute(), reporting SUCCESS, unless it was released
+   already. */
+static void release_parent(struct exec_args* args, bool success) {
+  struct thread* parent = thread_current()->creator;
+
+  if (args->released)
+    return;
+  args->released = true;
+  parent->complete = success;
+  sema_up(&parent->child_process_lock);
+}
+
 /* A thread function that loads a user process and starts it
    running. */
-static void start_process(void* file_name_) {
-  // printf("In start_process\n");
-  char* file_name = file_name_;
+static void start_process(void* args_) {
+  struct exec_args* args = args_;
   struct intr_frame if_;
   bool success;
 
@@ -72,19 +232,13 @@ static void start_process(void* file_name_) {
   if_.gs = if_.fs = if_.es = if_.ds = if_.ss = SEL_UDSEG;
   if_.cs = SEL_UCSEG;
   if_.eflags = FLAG_IF | FLAG_MBS;
-  success = load(file_name, &if_.eip, &if_.esp);
+  success = load(args, &if_.eip, &if_.esp);
 
   /* If load failed, quit. */
-  palloc_free_page(file_name);
-  if (!success) {
-    // printf("%d %d\n",thread_current()->tid, thread_current()->parent->tid);
-    thread_current()->parent->complete = false;
-    sema_up(&thread_current()->parent->child_process_lock);
+  release_parent(args, success);
+  palloc_free_page(args);
+  if (!success)
     thread_exit();
-  } else {
-    thread_current()->parent->complete = true;
-    sema_up(&thread_current()->parent->child_process_lock);
-  }
 
   /* Start the user process by simulating a return from an
      interrupt, implemented by intr_exit (in
@@ -96,6 +250,61 @@ static void start_process(void* file_name_) {
   NOT_REACHED();
 }
 
+/* Starts a new thread running a copy of the current process,
+   which entered the kernel with interrupt frame IF_, and waits
+   for the copy to be made.  The child returns from the fork()
+   system call with 0.  With VM, the child shares the parent's
+   frames copy-on-write; without it, every page is copied now.
+   Returns the new process's thread id, or TID_ERROR if the
+   process has too many children or the copy cannot be created. */
+tid_t process_fork(const struct intr_frame* if_) {
+  struct intr_frame* child_if;
+  tid_t tid;
+
+  if (too_many_children())
+    return TID_ERROR;
+  child_if = malloc(sizeof *child_if);
+  if (child_if == NULL)
+    return TID_ERROR;
+  *child_if = *if_;
+  tid = thread_create(thread_current()->name, PRI_DEFAULT, start_fork, child_if);
+  if (tid == TID_ERROR) {
+    free(child_if);
+    return TID_ERROR;
+  }
+
+  sema_down(&thread_current()->child_process_lock);
+
+  if (!thread_current()->complete) {
+    /* Nobody can wait for the child, which is exiting. */
+    thread_forget_child(thread_find_child(tid));
+    return TID_ERROR;
+  }
+
+  return tid;
+}
+
+/* A thread function that copies the process of its parent, whose
+   thread that called fork() waits in process_fork(), and starts
+   the copy running from that thread's interrupt frame IF_. */
+static void start_fork(void* if_) {
+  struct thread* t = thread_current();
+  struct intr_frame frame = *(struct intr_frame*)if_;
+  bool success;
+
+  free(if_);
+  success = fork_files(t->parent) && fork_address_space(t->parent) && fpu_fork(t->parent);
+  t->creator->complete = success;
+  sema_up(&t->creator->child_process_lock);
+  if (!success)
+    thread_exit();
+
+  /* fork() returns 0 in the child. */
+  frame.eax = 0;
+  asm volatile("movl %0, %%esp; jmp intr_exit" : : "g"(&frame) : "memory");
+  NOT_REACHED();
+}
+
 /* Waits for thread TID to die and returns its exit status.  If
    it was terminated by the kernel (i.e. killed due to an
    exception), returns -1.  If TID is invalid or if it was not a
@@ -103,66 +312,244 @@ static void start_process(void* file_name_) {
    been successfully called for the given TID, returns -1
    immediately, without waiting.
 
-   This function will be implemented in problem 2-2.  For now, it
-   does nothing. */
+   The child is found by tid in a hash table and reports its exit
+   through a semaphore of its own, so waiting takes constant time
+   however many children there are.  Children belong to the whole
+   process, so two of its threads may try to wait for the same
+   one; the second gets -1. */
 int process_wait(tid_t child_tid) {
+  struct child_process* c;
+  enum intr_level old_level;
+  int status;
+
+  old_level = intr_disable();
+  c = thread_find_child(child_tid);
+  if (c != NULL && c->waited)
+    c = NULL;
+  if (c != NULL)
+    c->waited = true;
+  intr_set_level(old_level);
+  if (c == NULL)
+    return -1;
+  sema_down(&c->exited);
+  status = c->exit_status;
+  thread_forget_child(c);
+  return status;
+}
+
+/* Waits for whichever child of the current process exits first,
+   or takes the one that exited longest ago, stores its exit
+   status in *STATUS, and returns its thread id.  Returns
+   TID_ERROR at once if there are no children left to wait for.
+   If BLOCK is false and no child has exited yet, returns 0
+   without waiting. */
+tid_t process_wait_any(int* status, bool block) {
+  struct thread* t = thread_current()->process;
+  struct child_process* c = NULL;
   struct list_elem* e;
+  enum intr_level old_level;
+  tid_t tid;
 
-  struct child_process* ch = NULL;
-  struct list_elem* e1 = NULL;
+  for (;;) {
+    if (hash_empty(&t->process_children))
+      return TID_ERROR;
 
-  for (e = list_begin(&thread_current()->process_children);
-       e != list_end(&thread_current()->process_children); e = list_next(e)) {
-    struct child_process* f = list_entry(e, struct child_process, elem);
-    if (f->tid == child_tid) {
-      ch = f;
-      e1 = e;
+    /* Skip children that another thread is waiting for. */
+    old_level = intr_disable();
+    for (e = list_begin(&t->exited_children); e != list_end(&t->exited_children);
+         e = list_next(e)) {
+      c = list_entry(e, struct child_process, exited_elem);
+      if (!c->waited)
+        break;
+    }
+    if (e != list_end(&t->exited_children)) {
+      list_remove(e);
+      c->reported = false;
+      c->waited = true;
+      intr_set_level(old_level);
+      break;
     }
+    intr_set_level(old_level);
+
+    if (!block)
+      return 0;
+
+    /* The semaphore counts every exit, including those of
+       children reaped by process_wait(), so check again. */
+    sema_down(&t->child_exited);
   }
 
-  if (!ch || !e1)
-    return -1;
+  *status = c->exit_status;
+  tid = c->tid;
+  thread_forget_child(c);
+  return tid;
+}
+
+/* Threads of a process.
+
+   process_thread_create() starts a new kernel thread in the
+   current process, running user code on a user stack of the
+   program's choosing.  It shares the process's page directory,
+   open files, children and everything else that the process's
+   main thread holds (see struct thread), so the threads of a
+   process can run its code at once and reach the same memory.
+
+   A thread ends with process_thread_exit(), which its creator
+   can collect with thread_join().  exit(), or a fault in any
+   thread, ends the whole process: the process is marked as
+   exiting, and each of its threads dies the next time it is
+   about to return to user mode, from a system call or from an
+   interrupt (see process_check_exit()), so a thread that runs in
+   a loop dies at its next timer tick.  Threads blocked in
+   futex_wait() are woken for this.  The main thread waits for the
+   others to be gone before it frees the process's resources in
+   process_exit().  A thread blocked in the kernel for some other
+   reason holds up the exit until it returns. */
+
+/* Starts a new thread in the current process, which entered the
+   kernel with interrupt frame IF_, running user code at EIP with
+   user stack pointer ESP.  Returns the new thread's id, or
+   TID_ERROR if the process is exiting or the thread cannot be
+   created. */
+tid_t process_thread_create(const struct intr_frame* if_, void* eip, void* esp) {
+  struct thread* p = thread_current()->process;
+  struct intr_frame* frame;
+  enum intr_level old_level;
+  tid_t tid;
+
+  frame = malloc(sizeof *frame);
+  if (frame == NULL)
+    return TID_ERROR;
+  *frame = *if_;
+  frame->eip = eip;
+  frame->esp = esp;
+  frame->eax = 0;
+
+  old_level = intr_disable();
+  if (p->exiting) {
+    intr_set_level(old_level);
+    free(frame);
+    return TID_ERROR;
+  }
+  p->thread_cnt++;
+  intr_set_level(old_level);
+
+  tid = thread_create_sibling(thread_current()->name, PRI_DEFAULT, start_thread, frame);
+  if (tid == TID_ERROR) {
+    old_level = intr_disable();
+    p->thread_cnt--;
+    intr_set_level(old_level);
+    free(frame);
+  }
+  return tid;
+}
+
+/* A thread function that starts a thread of its process running
+   in user mode from interrupt frame IF_. */
+static void start_thread(void* if_) {
+  struct intr_frame frame = *(struct intr_frame*)if_;
 
-  thread_current()->tid_wait = ch->tid;
+  free(if_);
+  asm volatile("movl %0, %%esp; jmp intr_exit" : : "g"(&frame) : "memory");
+  NOT_REACHED();
+}
 
-  if (!ch->did_execute)
-    sema_down(&thread_current()->child_process_lock);
+/* Ends the running thread with STATUS, for thread_join().  In the
+   process's main thread, first waits for the process's other
+   threads to exit, then ends the process with STATUS, unless
+   another thread ended it already. */
+void process_thread_exit(int status) {
+  struct thread* t = thread_current();
 
-  int temp = ch->exit_status;
-  list_remove(e1);
+  if (t == t->process) {
+    while (t->thread_cnt > 0)
+      sema_down(&t->thread_end);
+    process_terminate(status);
+  } else
+    t->exit_status = status;
+  thread_exit();
+}
 
-  return temp;
+/* Marks the current process as exiting with STATUS, unless it is
+   exiting already, and wakes its threads that are blocked in
+   futex_wait(), so that they die.  Called by exit() before the
+   calling thread exits. */
+void process_terminate(int status) {
+  struct thread* p = thread_current()->process;
+  enum intr_level old_level = intr_disable();
+  bool first = !p->exiting;
+
+  if (first) {
+    p->exiting = true;
+    p->exit_status = status;
+  }
+  intr_set_level(old_level);
+  if (first && p->pagedir != NULL)
+    futex_cancel(p);
 }
 
-// /* Free the current process's resources. */
+/* Kills the running thread if its process is exiting.  Called on
+   the way back to user mode, so interrupts may be off. */
+void process_check_exit(void) {
+  if (thread_current()->process->exiting) {
+    intr_enable();
+    thread_exit();
+  }
+}
+
+/* Frees the current process's resources, or, in a thread other
+   than the process's main thread, just lets the main thread know
+   that it is gone. */
 void process_exit(void) {
   struct thread* curr = thread_current();
+  struct thread* p = curr->process;
+  enum intr_level old_level;
   uint32_t* pd;
 
+  if (curr != p) {
+    /* A fault kills the whole process. */
+    if (curr->exit_status == EXIT_STATUS_FAIL) {
+      curr->exit_status = -1;
+      process_terminate(-1);
+    }
+    /* The main thread destroys the page directory once we are
+       gone, so stop using it at the next switch. */
+    curr->pagedir = NULL;
+    old_level = intr_disable();
+    p->thread_cnt--;
+    sema_up(&p->thread_end);
+    intr_set_level(old_level);
+    return;
+  }
+
   if (curr->exit_status == EXIT_STATUS_FAIL)
     SYSCALL_exit_handler(-1);
 
+  /* Wait for the other threads, which die on their way back to
+     user mode. */
+  process_terminate(curr->exit_status);
+  while (curr->thread_cnt > 0)
+    sema_down(&curr->thread_end);
+
   int exit_code = curr->exit_status;
   printf("%s: exit(%d)\n", curr->name, exit_code);
+#ifdef VM
+  if (page_stats_enabled)
+    page_print_stats();
+#endif
 
-  lock_acquire(&global_filesystem_lock);
   file_close(curr->executable_file);
 
-  struct list* filelist = &thread_current()->files;
-  struct list_elem* e;
-
-  while (!list_empty(filelist)) {
-    e = list_pop_front(filelist);
-    struct process_file* f = list_entry(e, struct process_file, elem);
-
-    file_close(f->fileptr);
-    list_remove(e);
-    free(f);
-  }
-  lock_release(&global_filesystem_lock);
+  fd_close_all();
+  dir_close(curr->cwd);
+  curr->cwd = NULL;
+  shm_exit();
+  ioring_exit();
 
-  /* Destroy the current process's page directory and switch back
-     to the kernel-only page directory. */
+  /* Switch back to the kernel-only page directory and leave the
+     current process's page directory to the reaper, so that our
+     parent hears of our exit without waiting for it to be
+     destroyed. */
   pd = curr->pagedir;
   if (pd != NULL) {
     /* Correct ordering here is crucial.  We must set
@@ -172,9 +559,16 @@ void process_exit(void) {
          directory before destroying the process's page
          directory, or our active page directory will be one
          that's been freed (and cleared). */
+#ifdef VM
+    /* Writes back mapped files and frees the frames of the pages
+       in the supplemental page table, which needs the page
+       directory to unmap them. */
+    mmap_exit();
+    page_table_destroy(&curr->pages);
+#endif
     curr->pagedir = NULL;
     pagedir_activate(NULL);
-    pagedir_destroy(pd);
+    pagedir_destroy_async(pd);
   }
 }
 
@@ -190,6 +584,9 @@ void process_activate(void) {
   /* Set thread's kernel stack for use in processing
      interrupts. */
   tss_update();
+
+  /* Tell it its ids through the shared page. */
+  vdso_set_thread(t);
 }
 
 /* We load ELF binaries.  The following definitions are taken
@@ -253,56 +650,157 @@ struct Elf32_Phdr {
 #define PF_W 2 /* Writable. */
 #define PF_R 4 /* Readable. */
 
-static bool setup_stack(void** esp, const char* cmdline);
+static bool setup_stack(void** esp, const struct exec_args* args);
 static bool validate_segment(const struct Elf32_Phdr*, struct file*);
 static bool load_segment(struct file* file, off_t ofs, uint8_t* upage, uint32_t read_bytes,
                          uint32_t zero_bytes, bool writable);
 
-/* Loads an ELF executable from FILE_NAME into the current thread.
-   Stores the executable's entry point into *EIP
-   and its initial stack pointer into *ESP.
-   Returns true if successful, false otherwise. */
-bool load(const char* file_name, void (**eip)(void), void** esp) {
-  //printf("In load\n");
-  struct thread* t = thread_current();
-  struct Elf32_Ehdr ehdr;
-  struct file* file = NULL;
-  off_t file_ofs;
-  bool success = false;
-  int i;
+/* A loadable segment, as load_segment() wants it. */
+struct image_seg {
+  uint32_t file_page;  /* Offset in the file of the first page. */
+  uint32_t mem_page;   /* User address of the first page. */
+  uint32_t read_bytes; /* Bytes to read from the file. */
+  uint32_t zero_bytes; /* Bytes to zero after them. */
+  bool writable;       /* Are the pages writable? */
+};
 
-  lock_acquire(&global_filesystem_lock);
-  /* Allocate and activate page directory. */
-  t->pagedir = pagedir_create();
-  if (t->pagedir == NULL)
-    goto done;
-  process_activate();
+/* What load() needs from an executable's headers. */
+struct image {
+  void (*entry)(void);    /* Entry point. */
+  int seg_cnt;            /* Number of elements in SEGS. */
+  struct image_seg* segs; /* Segments to load, from malloc(). */
+};
+
+/* Executable image cache.
+
+   Every exec of a program reads its ELF header and program
+   headers and checks each segment with validate_segment().  The
+   cache keeps the result for the last few executables, keyed by
+   inode, so that running the same program again skips that I/O.
+   An entry holds its inode open, which keeps the inode's version
+   meaningful: any write to the file changes the version and
+   makes the entry stale.  Holding the inode also delays freeing
+   the blocks of a removed executable until its entry is
+   evicted. */
+#define IMAGE_CACHE_CNT 8
+
+/* A cached image. */
+struct image_entry {
+  struct inode* inode;    /* Executable, held open, or null if unused. */
+  unsigned version;       /* Inode version the image was read at. */
+  struct image image;     /* Parsed headers. */
+  unsigned long long use; /* Last use, for eviction. */
+};
 
-  /* Open executable file. */
+static struct image_entry images[IMAGE_CACHE_CNT]; /* The cache. */
+static unsigned long long image_clock;             /* Counts uses of the cache. */
+static struct lock image_lock;                     /* Protects the cache. */
 
-  char* fn_cp = malloc(strlen(file_name) + 1);
-  strlcpy(fn_cp, file_name, strlen(file_name) + 1);
+/* Initializes the process module. */
+void process_init(void) { lock_init(&image_lock); }
 
-  char* save_ptr;
-  fn_cp = strtok_r(fn_cp, " ", &save_ptr);
+/* Frees the cached image in E. */
+static void image_evict(struct image_entry* e) {
+  inode_close(e->inode);
+  free(e->image.segs);
+  e->inode = NULL;
+  e->image.segs = NULL;
+}
 
-  file = filesys_open(fn_cp);
+/* Copies SRC into DST, with its own segment array.  Returns
+   false if out of memory. */
+static bool image_copy(struct image* dst, const struct image* src) {
+  size_t size = src->seg_cnt * sizeof *src->segs;
+
+  dst->entry = src->entry;
+  dst->seg_cnt = src->seg_cnt;
+  dst->segs = NULL;
+  if (size == 0)
+    return true;
+  dst->segs = malloc(size);
+  if (dst->segs == NULL)
+    return false;
+  memcpy(dst->segs, src->segs, size);
+  return true;
+}
 
-  free(fn_cp);
-  //TODO : Free fn_cp
+/* Looks up the image of INODE, which must still be at VERSION,
+   and copies it into IMAGE if found.  Returns true if found. */
+static bool image_lookup(struct inode* inode, unsigned version, struct image* image) {
+  bool found = false;
+  int i;
 
-  if (file == NULL) {
-    printf("load: %s: open failed\n", file_name);
-    goto done;
+  lock_acquire(&image_lock);
+  for (i = 0; i < IMAGE_CACHE_CNT; i++) {
+    struct image_entry* e = &images[i];
+
+    if (e->inode != inode)
+      continue;
+    if (e->version != version)
+      image_evict(e);
+    else if (image_copy(image, &e->image)) {
+      e->use = ++image_clock;
+      found = true;
+    }
+    break;
+  }
+  lock_release(&image_lock);
+  return found;
+}
+
+/* Adds a copy of IMAGE, read from INODE at VERSION, to the cache,
+   evicting the least recently used entry if it is full. */
+static void image_insert(struct inode* inode, unsigned version, const struct image* image) {
+  struct image_entry* victim = NULL;
+  int i;
+
+  lock_acquire(&image_lock);
+  for (i = 0; i < IMAGE_CACHE_CNT; i++) {
+    struct image_entry* e = &images[i];
+
+    if (e->inode == inode) {
+      /* Another exec of the same program got here first. */
+      victim = e;
+      break;
+    }
+    if (victim == NULL || (e->inode == NULL && victim->inode != NULL) ||
+        (victim->inode != NULL && e->use < victim->use))
+      victim = e;
   }
+  if (victim->inode != NULL)
+    image_evict(victim);
+  if (image_copy(&victim->image, image)) {
+    victim->inode = inode_reopen(inode);
+    victim->version = version;
+    victim->use = ++image_clock;
+  }
+  lock_release(&image_lock);
+}
+
+/* Reads FILE's ELF header and program headers into IMAGE, which
+   the caller must free, checking every loadable segment.  Once
+   the ELF header checks out, releases a parent that spawned ARGS.
+   Returns true if successful, false otherwise. */
+static bool image_read(struct file* file, struct exec_args* args, struct image* image) {
+  struct Elf32_Ehdr ehdr;
+  off_t file_ofs;
+  int i;
 
   /* Read and verify executable header. */
   if (file_read(file, &ehdr, sizeof ehdr) != sizeof ehdr ||
       memcmp(ehdr.e_ident, "\177ELF\1\1\1", 7) || ehdr.e_type != 2 || ehdr.e_machine != 3 ||
       ehdr.e_version != 1 || ehdr.e_phentsize != sizeof(struct Elf32_Phdr) || ehdr.e_phnum > 1024) {
-    printf("load: %s: error loading executable\n", file_name);
-    goto done;
+    printf("load: %s: error loading executable\n", args->argv[0]);
+    return false;
   }
+  if (args->spawn)
+    release_parent(args, true);
+
+  image->entry = (void (*)(void))ehdr.e_entry;
+  image->seg_cnt = 0;
+  image->segs = malloc(ehdr.e_phnum * sizeof *image->segs);
+  if (image->segs == NULL && ehdr.e_phnum > 0)
+    return false;
 
   /* Read program headers. */
   file_ofs = ehdr.e_phoff;
@@ -310,11 +808,11 @@ bool load(const char* file_name, void (**eip)(void), void** esp) {
     struct Elf32_Phdr phdr;
 
     if (file_ofs < 0 || file_ofs > file_length(file))
-      goto done;
+      return false;
     file_seek(file, file_ofs);
 
     if (file_read(file, &phdr, sizeof phdr) != sizeof phdr)
-      goto done;
+      return false;
     file_ofs += sizeof phdr;
     switch (phdr.p_type) {
       case PT_NULL:
@@ -327,54 +825,170 @@ bool load(const char* file_name, void (**eip)(void), void** esp) {
       case PT_DYNAMIC:
       case PT_INTERP:
       case PT_SHLIB:
-        goto done;
+        return false;
       case PT_LOAD:
         if (validate_segment(&phdr, file)) {
-          bool writable = (phdr.p_flags & PF_W) != 0;
-          uint32_t file_page = phdr.p_offset & ~PGMASK;
-          uint32_t mem_page = phdr.p_vaddr & ~PGMASK;
+          struct image_seg* seg = &image->segs[image->seg_cnt++];
           uint32_t page_offset = phdr.p_vaddr & PGMASK;
-          uint32_t read_bytes, zero_bytes;
+
+          seg->writable = (phdr.p_flags & PF_W) != 0;
+          seg->file_page = phdr.p_offset & ~PGMASK;
+          seg->mem_page = phdr.p_vaddr & ~PGMASK;
           if (phdr.p_filesz > 0) {
             /* Normal segment.
                      Read initial part from disk and zero the rest. */
-            read_bytes = page_offset + phdr.p_filesz;
-            zero_bytes = (ROUND_UP(page_offset + phdr.p_memsz, PGSIZE) - read_bytes);
+            seg->read_bytes = page_offset + phdr.p_filesz;
+            seg->zero_bytes = (ROUND_UP(page_offset + phdr.p_memsz, PGSIZE) - seg->read_bytes);
           } else {
             /* Entirely zero.
                      Don't read anything from disk. */
-            read_bytes = 0;
-            zero_bytes = ROUND_UP(page_offset + phdr.p_memsz, PGSIZE);
+            seg->read_bytes = 0;
+            seg->zero_bytes = ROUND_UP(page_offset + phdr.p_memsz, PGSIZE);
           }
-          if (!load_segment(file, file_page, (void*)mem_page, read_bytes, zero_bytes, writable))
-            goto done;
         } else
-          goto done;
+          return false;
         break;
     }
   }
+  return true;
+}
+
+/* Loads the ELF executable that ARGS names, and which
+   process_execute() opened, into the current thread, which takes
+   ownership of the open file, and gives it the parent's pipes.
+   Stores the executable's entry point into *EIP and its initial
+   stack pointer into *ESP.  Releases a spawning parent once the
+   header checks out.
+   Returns true if successful, false otherwise. */
+static bool load(struct exec_args* args, void (**eip)(void), void** esp) {
+  struct thread* t = thread_current();
+  struct file* file = args->file;
+  struct inode* inode = file_get_inode(file);
+  unsigned version = inode_get_version(inode);
+  struct image image;
+  uint32_t heap_top;
+  bool success = false;
+  int i;
+
+  image.segs = NULL;
+
+  /* Closed by process_exit() even if loading fails. */
+  t->executable_file = file;
+
+  /* The parent's thread that called exec() is still waiting in
+     execute(), but its other threads may not be, so
+     fd_inherit_pipes() locks the descriptor table while it
+     copies the pipes. */
+  if (!fd_inherit_pipes(t->parent))
+    goto done;
+  if (t->parent->cwd != NULL && (t->cwd = dir_reopen(t->parent->cwd)) == NULL)
+    goto done;
+
+  /* Allocate and activate page directory. */
+  t->pagedir = pagedir_create();
+  if (t->pagedir == NULL)
+    goto done;
+#ifdef VM
+  if (!page_table_init(&t->pages)) {
+    pagedir_destroy(t->pagedir);
+    t->pagedir = NULL;
+    goto done;
+  }
+  list_init(&t->mappings);
+  t->next_mapid = 0;
+#endif
+  process_activate();
+
+  /* Get the headers from the cache or the file. */
+  if (image_lookup(inode, version, &image)) {
+    if (args->spawn)
+      release_parent(args, true);
+  } else {
+    if (!image_read(file, args, &image))
+      goto done;
+    image_insert(inode, version, &image);
+  }
+
+  /* Load the segments.  The heap starts above the highest. */
+  heap_top = 0;
+  for (i = 0; i < image.seg_cnt; i++) {
+    const struct image_seg* seg = &image.segs[i];
+    uint32_t seg_top = seg->mem_page + seg->read_bytes + seg->zero_bytes;
+
+    if (!load_segment(file, seg->file_page, (void*)seg->mem_page, seg->read_bytes,
+                      seg->zero_bytes, seg->writable))
+      goto done;
+    if (seg_top > heap_top)
+      heap_top = seg_top;
+  }
+  heap_init((void*)heap_top);
 
   /* Set up stack. */
-  if (!setup_stack(esp, file_name))
+  if (!setup_stack(esp, args))
     goto done;
 
   /* Start address. */
-  *eip = (void (*)(void))ehdr.e_entry;
+  *eip = image.entry;
   success = true;
 
   file_deny_write(file);
 
-  thread_current()->executable_file = file;
-
 done:
   /* We arrive here whether the load is successful or not. */
-  lock_release(&global_filesystem_lock);
+  free(image.segs);
   return success;
 }
 
+/* fork() helpers. */
+
+/* Gives the current process its own copies of PARENT's
+   executable, current directory and open files, under the same
+   descriptors and at the same positions.  Returns false if memory
+   runs out. */
+static bool fork_files(struct thread* parent) {
+  struct thread* t = thread_current();
+
+  t->executable_file = file_reopen(parent->executable_file);
+  if (t->executable_file == NULL)
+    return false;
+  if (parent->cwd != NULL && (t->cwd = dir_reopen(parent->cwd)) == NULL)
+    return false;
+  file_deny_write(t->executable_file);
+  return fd_fork(parent);
+}
+
+/* Gives the current process a page directory holding a copy of
+   PARENT's address space, and activates it.  Returns false if
+   memory runs out. */
+static bool fork_address_space(struct thread* parent) {
+  struct thread* t = thread_current();
+
+  t->heap_start = parent->heap_start;
+  t->heap_end = parent->heap_end;
+  t->pagedir = pagedir_create();
+  if (t->pagedir == NULL)
+    return false;
+#ifdef VM
+  if (!page_table_init(&t->pages)) {
+    pagedir_destroy(t->pagedir);
+    t->pagedir = NULL;
+    return false;
+  }
+  list_init(&t->mappings);
+  t->next_mapid = 0;
+  process_activate();
+  return page_table_fork(parent) && mmap_fork(parent) && shm_fork(parent);
+#else
+  process_activate();
+  return pagedir_copy(t->pagedir, parent->pagedir) && shm_fork(parent);
+#endif
+}
+
 /* load() helpers. */
 
+#ifndef VM
 static bool install_page(void* upage, void* kpage, bool writable);
+#endif
 
 /* Checks whether PHDR describes a valid, loadable segment in
    FILE and returns true if so, false otherwise. */
@@ -419,6 +1033,10 @@ static bool validate_segment(const struct Elf32_Phdr* phdr, struct file* file) {
   return true;
 }
 
+/* Most pages that load_segment() reads and maps at once, without
+   VM. */
+#define LOAD_CHUNK_PAGES 16
+
 /* Loads a segment starting at offset OFS in FILE at address
    UPAGE.  In total, READ_BYTES + ZERO_BYTES bytes of virtual
    memory are initialized, as follows:
@@ -431,6 +1049,9 @@ static bool validate_segment(const struct Elf32_Phdr* phdr, struct file* file) {
    The pages initialized by this function must be writable by the
    user process if WRITABLE is true, read-only otherwise.
 
+   With VM, the pages are only recorded in the supplemental page
+   table here and read in when the process first touches them.
+
    Return true if successful, false if a memory allocation error
    or disk read error occurs. */
 static bool load_segment(struct file* file, off_t ofs, uint8_t* upage, uint32_t read_bytes,
@@ -439,47 +1060,73 @@ static bool load_segment(struct file* file, off_t ofs, uint8_t* upage, uint32_t
   ASSERT(pg_ofs(upage) == 0);
   ASSERT(ofs % PGSIZE == 0);
 
-  file_seek(file, ofs);
+#ifdef VM
   while (read_bytes > 0 || zero_bytes > 0) {
-    /* Calculate how to fill this page.
-       We will read PAGE_READ_BYTES bytes from FILE
-       and zero the final PAGE_ZERO_BYTES bytes. */
     size_t page_read_bytes = read_bytes < PGSIZE ? read_bytes : PGSIZE;
     size_t page_zero_bytes = PGSIZE - page_read_bytes;
 
-    /* Get a page of memory. */
-    uint8_t* kpage = palloc_get_page(PAL_USER);
-    if (kpage == NULL)
+    if (!page_add_file(upage, file, ofs, page_read_bytes, writable))
       return false;
 
-    /* Load this page. */
-    if (file_read(file, kpage, page_read_bytes) != (int)page_read_bytes) {
-      palloc_free_page(kpage);
+    read_bytes -= page_read_bytes;
+    zero_bytes -= page_zero_bytes;
+    ofs += page_read_bytes;
+    upage += PGSIZE;
+  }
+  return true;
+#else
+  file_seek(file, ofs);
+  while (read_bytes > 0 || zero_bytes > 0) {
+    /* Take up to LOAD_CHUNK_PAGES pages at once, fewer if the user
+       pool has no run that long, so that one file_read() fills
+       them and one walk of the page directory maps them. */
+    size_t page_cnt = (read_bytes + zero_bytes) / PGSIZE;
+    size_t chunk_read_bytes, chunk_zero_bytes;
+    uint8_t* kpages;
+
+    if (page_cnt > LOAD_CHUNK_PAGES)
+      page_cnt = LOAD_CHUNK_PAGES;
+    while ((kpages = palloc_get_multiple(PAL_USER, page_cnt)) == NULL)
+      if ((page_cnt /= 2) == 0)
+        return false;
+
+    /* Read the file's part of the chunk and zero the rest. */
+    chunk_read_bytes = read_bytes < page_cnt * PGSIZE ? read_bytes : page_cnt * PGSIZE;
+    chunk_zero_bytes = page_cnt * PGSIZE - chunk_read_bytes;
+    if (file_read(file, kpages, chunk_read_bytes) != (int)chunk_read_bytes) {
+      palloc_free_multiple(kpages, page_cnt);
       return false;
     }
-    memset(kpage + page_read_bytes, 0, page_zero_bytes);
+    memset(kpages + chunk_read_bytes, 0, chunk_zero_bytes);
 
-    /* Add the page to the process's address space. */
-    if (!install_page(upage, kpage, writable)) {
-      palloc_free_page(kpage);
+    /* Add the pages to the process's address space. */
+    if (!pagedir_set_range(thread_current()->pagedir, upage, kpages, page_cnt, writable)) {
+      palloc_free_multiple(kpages, page_cnt);
       return false;
     }
 
     /* Advance. */
-    read_bytes -= page_read_bytes;
-    zero_bytes -= page_zero_bytes;
-    upage += PGSIZE;
+    read_bytes -= chunk_read_bytes;
+    zero_bytes -= chunk_zero_bytes;
+    upage += page_cnt * PGSIZE;
   }
   return true;
+#endif
 }
 
 /* Create a minimal stack by mapping a zeroed page at the top of
-   user virtual memory. */
-static bool setup_stack(void** esp, const char* file_name) {
-  uint8_t* kpage;
+   user virtual memory.  With VM, the page is only recorded and
+   faults in when the arguments are pushed; the stack grows from
+   there on demand. */
+static bool setup_stack(void** esp, const struct exec_args* args) {
   bool success = false;
 
-  kpage = palloc_get_page(PAL_USER | PAL_ZERO);
+#ifdef VM
+  success = page_add_zero(((uint8_t*)PHYS_BASE) - PGSIZE, true);
+  if (success)
+    *esp = PHYS_BASE;
+#else
+  uint8_t* kpage = palloc_get_page(PAL_USER | PAL_ZERO);
   if (kpage != NULL) {
     success = install_page(((uint8_t*)PHYS_BASE) - PGSIZE, kpage, true);
     if (success)
@@ -487,62 +1134,35 @@ static bool setup_stack(void** esp, const char* file_name) {
     else
       palloc_free_page(kpage);
   }
+#endif
+  if (!success)
+    return false;
 
-  char *token, *save_ptr;
-  int argc = 0, i;
-
-  char* copy = malloc(strlen(file_name) + 1);
-  char* tokenize_copy = malloc(strlen(file_name) + 1);
-  strlcpy(copy, file_name, strlen(file_name) + 1);
-  strlcpy(tokenize_copy, file_name, strlen(file_name) + 1);
-
-  for (token = strtok_r(copy, " ", &save_ptr); token != NULL;
-       token = strtok_r(NULL, " ", &save_ptr))
-    argc++;
-
-  int* argv = calloc(argc, sizeof(int));
-
-  for (token = strtok_r(tokenize_copy, " ", &save_ptr), i = 0; token != NULL;
-       token = strtok_r(NULL, " ", &save_ptr), i++) {
-    *esp -= strlen(token) + 1;
-    memcpy(*esp, token, strlen(token) + 1);
-
-    argv[i] = (int)*esp;
-  }
-
-  while ((int)*esp % 4 != 0) {
-    *esp -= sizeof(char);
-    char x = 0;
-    memcpy(*esp, &x, sizeof(char));
-  }
-
-  int zero = 0;
-
-  *esp -= sizeof(int);
-  memcpy(*esp, &zero, sizeof(int));
-
-  for (i = argc - 1; i >= 0; i--) {
-    *esp -= sizeof(int);
-    memcpy(*esp, &argv[i], sizeof(int));
-  }
-
-  int pt = (int)*esp;
-  *esp -= sizeof(int);
-  memcpy(*esp, &pt, sizeof(int));
-
-  *esp -= sizeof(int);
-  memcpy(*esp, &argc, sizeof(int));
-
-  *esp -= sizeof(int);
-  memcpy(*esp, &zero, sizeof(int));
-
-  free(copy);
-  free(tokenize_copy);
-  free(argv);
+  /* From the top of the page down: the packed arguments, padding
+     to a word boundary, argv[] with its null sentinel, then argv,
+     argc and a fake return address.  The page is already zeroed,
+     so the padding and the sentinel need no stores. */
+  int argc = args->argc, i;
+  char *strings, **argv;
+  uint32_t* sp;
 
+  if (ROUND_UP(args->arg_len, sizeof(char*)) + (argc + 4) * sizeof(uint32_t) > PGSIZE)
+    return false;
+  strings = (char*)PHYS_BASE - args->arg_len;
+  argv = (char**)ROUND_DOWN((uintptr_t)strings, sizeof(char*)) - (argc + 1);
+  sp = (uint32_t*)argv - 3;
+
+  memcpy(strings, args->cmdline, args->arg_len);
+  for (i = 0; i < argc; i++)
+    argv[i] = strings + (args->argv[i] - args->cmdline);
+  sp[0] = 0;
+  sp[1] = argc;
+  sp[2] = (uint32_t)argv;
+  *esp = sp;
   return success;
 }
 
+#ifndef VM
 /* Adds a mapping from user virtual address UPAGE to kernel
    virtual address KPAGE to the page table.
    If WRITABLE is true, the user process may modify the page;
@@ -557,6 +1177,7 @@ static bool install_page(void* upage, void* kpage, bool writable) {
 
   /* Verify that there's not already a page at that virtual
      address, then map our page there. */
-  return (pagedir_get_page(t->pagedir, upage) == NULL &&
+  return (!pagedir_is_mapped(t->pagedir, upage) &&
           pagedir_set_page(t->pagedir, upage, kpage, writable));
 }
+#endif
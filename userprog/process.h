@@ -1,11 +1,22 @@
 #ifndef USERPROG_PROCESS_H
 #define USERPROG_PROCESS_H
 
+#include "threads/interrupt.h"
 #include "threads/thread.h"
 
+void process_init(void);
 tid_t process_execute(const char* file_name);
+tid_t process_spawn(const char* file_name);
+tid_t process_execute_user(const char* ucmd_line, bool spawn);
+tid_t process_fork(const struct intr_frame*);
 int process_wait(tid_t);
+tid_t process_wait_any(int* status, bool block);
 void process_exit(void);
 void process_activate(void);
 
+tid_t process_thread_create(const struct intr_frame*, void* eip, void* esp);
+void process_thread_exit(int status) NO_RETURN;
+void process_terminate(int status);
+void process_check_exit(void);
+
 #endif /* userprog/process.h */
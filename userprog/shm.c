@@ -0,0 +1,280 @@
+#include "userprog/shm.h"
+#include <debug.h>
+#include <list.h>
+#include <round.h>
+#include <stdint.h>
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "userprog/pagedir.h"
+#ifdef VM
+#include "vm/page.h"
+#endif
+
+/* Shared memory segments.
+
+   A segment is a fixed set of zeroed user pages, found by a key
+   that cooperating processes agree on.  shm_attach() maps the
+   same pages into the calling process's page directory, so data
+   written by one process is seen by every other one that has the
+   segment attached, without any copying.
+
+   The pages stay out of the frame table and the supplemental
+   page table: they are never evicted, and the VM code sees them
+   only as page directory entries that it must not map over.  A
+   segment lives until its last attachment goes away, whether by
+   shm_detach() or by process exit; a segment that was never
+   attached stays until then too.  fork() gives the child its own
+   attachment to each of its parent's segments, at the same
+   address.
+
+   shm_lock protects the segment table and reference counts, and
+   each process's list of attachments, which all of the process's
+   threads use.  shm_fork() reads the parent's list while the
+   parent's thread that called fork() waits for it. */
+
+/* Number of segments that may exist at once. */
+#define SHM_MAX 64
+
+/* Largest segment, in pages. */
+#define SHM_MAX_PAGES 256
+
+/* A segment. */
+struct shm_seg {
+  int key;         /* Key given to shm_get(). */
+  size_t page_cnt; /* Number of pages, or 0 if this slot is free. */
+  void** kpages;   /* Kernel addresses of the pages. */
+  int attach_cnt;  /* Number of attachments. */
+};
+
+/* A process's attachment of a segment. */
+struct shm_map {
+  struct list_elem elem; /* Element in the thread's `shm_maps'. */
+  struct shm_seg* seg;   /* Segment attached. */
+  void* addr;            /* User address of its first page. */
+};
+
+static struct shm_seg segs[SHM_MAX]; /* Segments, indexed by id. */
+static struct lock shm_lock;         /* Protects SEGS. */
+
+static bool map_pages(struct shm_seg*, void* addr);
+static void unmap_pages(void* addr, size_t page_cnt);
+static void seg_release(struct shm_seg*);
+
+/* Initializes the shared memory module. */
+void shm_init(void) { lock_init(&shm_lock); }
+
+/* Returns the id of the segment with KEY, creating it with room
+   for at least SIZE bytes if there is none.  Returns -1 if SIZE
+   is 0 or too big, if an existing segment is smaller than SIZE,
+   or if the table or memory runs out. */
+int shm_get(int key, size_t size) {
+  size_t page_cnt = DIV_ROUND_UP(size, PGSIZE);
+  struct shm_seg* free_seg = NULL;
+  int id = -1;
+  size_t i;
+
+  if (size == 0 || page_cnt > SHM_MAX_PAGES)
+    return -1;
+
+  lock_acquire(&shm_lock);
+  for (i = 0; i < SHM_MAX; i++) {
+    struct shm_seg* s = &segs[i];
+
+    if (s->page_cnt == 0) {
+      if (free_seg == NULL)
+        free_seg = s;
+    } else if (s->key == key) {
+      id = s->page_cnt >= page_cnt ? (int)i : -1;
+      goto done;
+    }
+  }
+  if (free_seg == NULL)
+    goto done;
+
+  free_seg->kpages = calloc(page_cnt, sizeof *free_seg->kpages);
+  if (free_seg->kpages == NULL)
+    goto done;
+  for (i = 0; i < page_cnt; i++) {
+    free_seg->kpages[i] = palloc_get_page(PAL_USER | PAL_ZERO);
+    if (free_seg->kpages[i] == NULL) {
+      while (i-- > 0)
+        palloc_free_page(free_seg->kpages[i]);
+      free(free_seg->kpages);
+      goto done;
+    }
+  }
+  free_seg->key = key;
+  free_seg->page_cnt = page_cnt;
+  free_seg->attach_cnt = 0;
+  id = free_seg - segs;
+
+done:
+  lock_release(&shm_lock);
+  return id;
+}
+
+/* Attaches segment ID to the current process at user address
+   ADDR, which must be page-aligned, with every page of the
+   segment unused below PHYS_BASE.  Returns ADDR, or a null
+   pointer if that is not possible. */
+void* shm_attach(int id, void* addr) {
+  struct thread* t = thread_current()->process;
+  struct shm_map* m;
+  struct shm_seg* s;
+
+  if (id < 0 || id >= SHM_MAX || addr == NULL || pg_ofs(addr) != 0 || !is_user_vaddr(addr))
+    return NULL;
+  m = malloc(sizeof *m);
+  if (m == NULL)
+    return NULL;
+
+  lock_acquire(&shm_lock);
+  s = &segs[id];
+  if (s->page_cnt == 0 || !map_pages(s, addr)) {
+    lock_release(&shm_lock);
+    free(m);
+    return NULL;
+  }
+  s->attach_cnt++;
+  m->seg = s;
+  m->addr = addr;
+  list_push_back(&t->shm_maps, &m->elem);
+  lock_release(&shm_lock);
+  return addr;
+}
+
+/* Detaches the segment that the current process attached at
+   ADDR.  Returns false if there is none. */
+bool shm_detach(void* addr) {
+  struct thread* t = thread_current()->process;
+  struct list_elem* e;
+
+  lock_acquire(&shm_lock);
+  for (e = list_begin(&t->shm_maps); e != list_end(&t->shm_maps); e = list_next(e)) {
+    struct shm_map* m = list_entry(e, struct shm_map, elem);
+
+    if (m->addr == addr) {
+      list_remove(e);
+      unmap_pages(m->addr, m->seg->page_cnt);
+      seg_release(m->seg);
+      lock_release(&shm_lock);
+      free(m);
+      return true;
+    }
+  }
+  lock_release(&shm_lock);
+  return false;
+}
+
+/* Attaches each of PARENT's segments to the current process at
+   the same address, replacing any private copy of its pages.
+   Returns false if memory runs out. */
+bool shm_fork(struct thread* parent) {
+  struct thread* t = thread_current();
+  struct list_elem* e;
+
+  for (e = list_begin(&parent->shm_maps); e != list_end(&parent->shm_maps); e = list_next(e)) {
+    struct shm_map* pm = list_entry(e, struct shm_map, elem);
+    struct shm_map* m = malloc(sizeof *m);
+    size_t i;
+    bool ok;
+
+    if (m == NULL)
+      return false;
+    for (i = 0; i < pm->seg->page_cnt; i++) {
+      void* upage = (uint8_t*)pm->addr + i * PGSIZE;
+      void* kpage = pagedir_get_page(t->pagedir, upage);
+
+      if (kpage != NULL) {
+        pagedir_clear_page(t->pagedir, upage);
+        palloc_free_page(kpage);
+      }
+    }
+
+    lock_acquire(&shm_lock);
+    ok = map_pages(pm->seg, pm->addr);
+    if (ok)
+      pm->seg->attach_cnt++;
+    lock_release(&shm_lock);
+    if (!ok) {
+      free(m);
+      return false;
+    }
+
+    m->seg = pm->seg;
+    m->addr = pm->addr;
+    list_push_back(&t->shm_maps, &m->elem);
+  }
+  return true;
+}
+
+/* Detaches all of the current process's segments.  Must be
+   called while its page directory still exists, before
+   pagedir_destroy() would free the shared pages. */
+void shm_exit(void) {
+  struct thread* t = thread_current();
+
+  while (!list_empty(&t->shm_maps)) {
+    struct shm_map* m = list_entry(list_pop_front(&t->shm_maps), struct shm_map, elem);
+
+    lock_acquire(&shm_lock);
+    unmap_pages(m->addr, m->seg->page_cnt);
+    seg_release(m->seg);
+    lock_release(&shm_lock);
+    free(m);
+  }
+}
+
+/* Maps the pages of S into the current process at ADDR.  Returns
+   false, mapping nothing, if any of those pages is in use or
+   memory runs out. */
+static bool map_pages(struct shm_seg* s, void* addr) {
+  struct thread* t = thread_current();
+  size_t i;
+
+  ASSERT(lock_held_by_current_thread(&shm_lock));
+
+  if ((uintptr_t)PHYS_BASE - (uintptr_t)addr < s->page_cnt * PGSIZE)
+    return false;
+  for (i = 0; i < s->page_cnt; i++) {
+    void* upage = (uint8_t*)addr + i * PGSIZE;
+
+#ifdef VM
+    if (page_lookup(upage) != NULL)
+      return false;
+#endif
+    if (pagedir_is_mapped(t->pagedir, upage))
+      return false;
+  }
+  for (i = 0; i < s->page_cnt; i++)
+    if (!pagedir_set_page(t->pagedir, (uint8_t*)addr + i * PGSIZE, s->kpages[i], true)) {
+      unmap_pages(addr, i);
+      return false;
+    }
+  return true;
+}
+
+/* Unmaps the PAGE_CNT pages at ADDR from the current process,
+   without freeing them. */
+static void unmap_pages(void* addr, size_t page_cnt) {
+  pagedir_clear_range(thread_current()->pagedir, addr, page_cnt);
+}
+
+/* Drops an attachment of S, freeing S if it was the last. */
+static void seg_release(struct shm_seg* s) {
+  size_t i;
+
+  ASSERT(lock_held_by_current_thread(&shm_lock));
+  ASSERT(s->attach_cnt > 0);
+
+  if (--s->attach_cnt > 0)
+    return;
+  for (i = 0; i < s->page_cnt; i++)
+    palloc_free_page(s->kpages[i]);
+  free(s->kpages);
+  s->kpages = NULL;
+  s->page_cnt = 0;
+}
@@ -0,0 +1,16 @@
+#ifndef USERPROG_SHM_H
+#define USERPROG_SHM_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+struct thread;
+
+void shm_init(void);
+int shm_get(int key, size_t size);
+void* shm_attach(int id, void* addr);
+bool shm_detach(void* addr);
+bool shm_fork(struct thread* parent);
+void shm_exit(void);
+
+#endif /* userprog/shm.h */
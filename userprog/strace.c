@@ -0,0 +1,173 @@
+#include "userprog/strace.h"
+#include <debug.h>
+#include <stdio.h>
+#include <string.h>
+#include "threads/interrupt.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+/* System call tracing.
+
+   A process whose `syscall_trace' flag is set, which it shares
+   with the children it starts afterward, has each system call it
+   makes logged as
+
+       strace: NAME[TID]: CALL(ARG, ...) = RESULT (NS ns)
+
+   with arguments and result in hex.  exit and halt, which do not
+   return, are logged as they start, with a result of "?".  The
+   -strace option sets the flag of the first process; the strace
+   system call sets or clears a process's own.
+
+   syscall_handler() does not print: printf() takes the console
+   lock, and the serial port runs at about a character per 100
+   microseconds, so traced processes would crawl and serialize on
+   each other.  Instead strace_record() copies each call into a
+   ring with interrupts off, which takes well under a
+   microsecond, and a kernel thread drains the ring to the
+   console at its own pace.  When the ring is full, calls are
+   counted as lost rather than waiting for the drainer, and the
+   count is printed ahead of the next call that fits.  The drainer
+   is only started when tracing is first turned on, so an
+   untraced kernel runs exactly as before. */
+
+/* Number of calls the ring holds.  Must be a power of 2. */
+#define STRACE_SIZE 256
+
+/* A traced system call. */
+struct strace_event {
+  const char* name;               /* System call name. */
+  char thread_name[16];           /* Caller's name. */
+  tid_t tid;                      /* Caller. */
+  uint8_t arg_cnt;                /* Number of arguments. */
+  bool returned;                  /* Did the call return? */
+  uint32_t args[STRACE_MAX_ARGS]; /* Arguments. */
+  uint32_t result;                /* Value returned, if RETURNED. */
+  int64_t ns;                     /* Time taken, if RETURNED. */
+  uint32_t lost_before;           /* Calls lost just before this one. */
+};
+
+bool strace_enabled;
+
+/* The ring.  HEAD and TAIL count the calls ever recorded and
+   drained.  All of this is accessed with interrupts off. */
+static struct strace_event ring[STRACE_SIZE];
+static uint32_t ring_head;   /* Calls recorded. */
+static uint32_t ring_tail;   /* Calls drained. */
+static uint32_t lost_cnt;    /* Calls lost since the last one recorded. */
+static bool drainer_started; /* Has the drainer been created? */
+static bool drainer_idle;    /* Is the drainer waiting on drain_sema? */
+static struct semaphore drain_sema;
+
+static thread_func drainer;
+static bool drain_one(void);
+
+/* Turns on tracing for the first process if -strace was given.
+   Called once the scheduler runs. */
+void strace_init(void) {
+  sema_init(&drain_sema, 0);
+  if (strace_enabled && !strace_set(true))
+    printf("strace: cannot start drainer thread\n");
+}
+
+/* Turns tracing of the running process's system calls on or off,
+   starting the drainer if need be.  Returns false if the drainer
+   cannot be started. */
+bool strace_set(bool on) {
+  if (on && !drainer_started) {
+    if (thread_create("strace", PRI_DEFAULT, drainer, NULL) == TID_ERROR)
+      return false;
+    drainer_started = true;
+  }
+  thread_current()->process->syscall_trace = on;
+  return true;
+}
+
+/* Logs a system call NAME made by the running thread with the
+   ARG_CNT arguments in ARGS.  If RETURNED is true, the call
+   returned RESULT after NS nanoseconds; otherwise it is just
+   starting and will not return. */
+void strace_record(const char* name, const uint32_t* args, int arg_cnt, bool returned,
+                   uint32_t result, int64_t ns) {
+  struct thread* t = thread_current();
+  struct strace_event* e;
+  enum intr_level old_level;
+
+  if (arg_cnt > STRACE_MAX_ARGS)
+    arg_cnt = STRACE_MAX_ARGS;
+
+  old_level = intr_disable();
+  if (ring_head - ring_tail == STRACE_SIZE)
+    lost_cnt++;
+  else {
+    e = &ring[ring_head++ % STRACE_SIZE];
+    e->name = name;
+    strlcpy(e->thread_name, t->name, sizeof e->thread_name);
+    e->tid = t->tid;
+    e->arg_cnt = arg_cnt;
+    e->returned = returned;
+    memcpy(e->args, args, arg_cnt * sizeof *args);
+    e->result = result;
+    e->ns = ns;
+    e->lost_before = lost_cnt;
+    lost_cnt = 0;
+    if (drainer_idle) {
+      drainer_idle = false;
+      sema_up(&drain_sema);
+    }
+  }
+  intr_set_level(old_level);
+}
+
+/* Prints every call still in the ring.  Called at shutdown,
+   which may come before the drainer catches up. */
+void strace_flush(void) {
+  while (drain_one())
+    continue;
+  if (lost_cnt > 0)
+    printf("strace: %u calls lost\n", lost_cnt);
+}
+
+/* Prints calls from the ring as they arrive. */
+static void drainer(void* aux UNUSED) {
+  for (;;) {
+    enum intr_level old_level;
+
+    if (drain_one())
+      continue;
+    old_level = intr_disable();
+    if (ring_head == ring_tail) {
+      drainer_idle = true;
+      sema_down(&drain_sema);
+    }
+    intr_set_level(old_level);
+  }
+}
+
+/* Removes the oldest call from the ring and prints it, with the
+   calls lost before it if any.  Returns false if the ring is
+   empty. */
+static bool drain_one(void) {
+  struct strace_event e;
+  enum intr_level old_level;
+  int i;
+
+  old_level = intr_disable();
+  if (ring_head == ring_tail) {
+    intr_set_level(old_level);
+    return false;
+  }
+  e = ring[ring_tail++ % STRACE_SIZE];
+  intr_set_level(old_level);
+
+  if (e.lost_before > 0)
+    printf("strace: %u calls lost\n", e.lost_before);
+  printf("strace: %s[%d]: %s(", e.thread_name, e.tid, e.name);
+  for (i = 0; i < e.arg_cnt; i++)
+    printf("%s%#x", i > 0 ? ", " : "", e.args[i]);
+  if (e.returned)
+    printf(") = %#x (%lld ns)\n", e.result, e.ns);
+  else
+    printf(") = ?\n");
+  return true;
+}
@@ -0,0 +1,19 @@
+#ifndef USERPROG_STRACE_H
+#define USERPROG_STRACE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Most arguments logged per call. */
+#define STRACE_MAX_ARGS 4
+
+/* -strace: Trace the system calls of every process? */
+extern bool strace_enabled;
+
+void strace_init(void);
+bool strace_set(bool on);
+void strace_record(const char* name, const uint32_t* args, int arg_cnt, bool returned,
+                   uint32_t result, int64_t ns);
+void strace_flush(void);
+
+#endif /* userprog/strace.h */
@@ -2,119 +2,630 @@
 #include "list.h"
 #include "process.h"
 #include "devices/shutdown.h"
+#include "devices/timer.h"
+#include "filesys/directory.h"
 #include "filesys/off_t.h"
 #include "threads/interrupt.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
 #include "threads/thread.h"
+#include "threads/tracepoint.h"
 #include "threads/vaddr.h"
 #include "userprog/handlers.h"
+#include "userprog/strace.h"
+#include "userprog/usermem.h"
+#include <dirent.h>
 #include <stdio.h>
 #include <syscall-nr.h>
 
+/* Size of the kernel buffer that file names are copied into,
+   including the null terminator.  Longer names are rejected. */
+#define NAME_BUF_SIZE 128
+
+/* Most entries one getdents call returns: a page of them. */
+#define GETDENTS_MAX (PGSIZE / sizeof(struct dirent))
+
+/* Most statistics one kstat call returns. */
+#define KSTAT_CALL_MAX 256
+
+/* Most descriptors one poll call takes. */
+#define POLL_CALL_MAX 256
+
+/* Most arguments any system call takes. */
+#define SYSCALL_MAX_ARGS 4
+
+/* Does the work of a system call, given the interrupt frame F
+   and the call's arguments, and returns the value for eax. */
+typedef uint32_t syscall_func(struct intr_frame* f, const uint32_t* args);
+
+/* A system call in the dispatch table. */
+struct syscall {
+  const char* name;  /* Name, for the profile. */
+  int arg_cnt;       /* Number of 32-bit arguments. */
+  syscall_func* fn;  /* Implementation. */
+  long long calls;   /* Number of calls. */
+  long long time_ns; /* Time spent in calls that returned. */
+};
+
 static void syscall_handler(struct intr_frame*);
+static bool copy_name(char* name, const char* uname);
+static struct iovec* copy_iov(const struct iovec* uiov, int iovcnt, bool write);
+static syscall_func sys_halt, sys_exit, sys_exec, sys_wait, sys_create, sys_remove, sys_open,
+    sys_filesize, sys_read, sys_write, sys_seek, sys_tell, sys_close, sys_chdir, sys_mkdir,
+    sys_readdir, sys_isdir, sys_inumber, sys_getrusage,
+    sys_clock_ns, sys_fork, sys_readv, sys_writev, sys_pread, sys_pwrite, sys_spawn, sys_pipe,
+    sys_shmget, sys_shmat, sys_shmdt, sys_sysenter,
+    sys_waitany, sys_ioring_setup, sys_ioring_enter, sys_sbrk, sys_getrlimit, sys_setrlimit,
+    sys_strace, sys_blkstat, sys_pmu_setup, sys_pmu_read, sys_futex_wait, sys_futex_wake,
+    sys_thread_create, sys_thread_join, sys_thread_exit, sys_sched_deadline, sys_sched_yield,
+    sys_copy_file_range, sys_open_flags, sys_fallocate, sys_getdents, sys_madvise, sys_fadvise,
+    sys_setaffinity, sys_nice, sys_getnice, sys_kstat, sys_poll, sys_fcntl,
+    sys_gettunable, sys_settunable;
+#ifdef VM
+static syscall_func sys_mmap, sys_munmap;
+#endif
+
+/* Dispatch table, indexed by system call number.  Calls this
+   kernel does not implement have a null FN. */
+static struct syscall syscalls[] = {
+    [SYS_HALT] = {"halt", 0, sys_halt},
+    [SYS_EXIT] = {"exit", 1, sys_exit},
+    [SYS_EXEC] = {"exec", 1, sys_exec},
+    [SYS_WAIT] = {"wait", 1, sys_wait},
+    [SYS_CREATE] = {"create", 2, sys_create},
+    [SYS_REMOVE] = {"remove", 1, sys_remove},
+    [SYS_OPEN] = {"open", 1, sys_open},
+    [SYS_FILESIZE] = {"filesize", 1, sys_filesize},
+    [SYS_READ] = {"read", 3, sys_read},
+    [SYS_WRITE] = {"write", 3, sys_write},
+    [SYS_SEEK] = {"seek", 2, sys_seek},
+    [SYS_TELL] = {"tell", 1, sys_tell},
+    [SYS_CLOSE] = {"close", 1, sys_close},
+#ifdef VM
+    [SYS_MMAP] = {"mmap", 2, sys_mmap},
+    [SYS_MUNMAP] = {"munmap", 1, sys_munmap},
+#endif
+    [SYS_CHDIR] = {"chdir", 1, sys_chdir},
+    [SYS_MKDIR] = {"mkdir", 1, sys_mkdir},
+    [SYS_READDIR] = {"readdir", 2, sys_readdir},
+    [SYS_ISDIR] = {"isdir", 1, sys_isdir},
+    [SYS_INUMBER] = {"inumber", 1, sys_inumber},
+    [SYS_GETRUSAGE] = {"getrusage", 1, sys_getrusage},
+    [SYS_CLOCK_NS] = {"clock_ns", 1, sys_clock_ns},
+    [SYS_FORK] = {"fork", 0, sys_fork},
+    [SYS_READV] = {"readv", 3, sys_readv},
+    [SYS_WRITEV] = {"writev", 3, sys_writev},
+    [SYS_PREAD] = {"pread", 4, sys_pread},
+    [SYS_PWRITE] = {"pwrite", 4, sys_pwrite},
+    [SYS_SPAWN] = {"spawn", 1, sys_spawn},
+    [SYS_PIPE] = {"pipe", 1, sys_pipe},
+    [SYS_SHMGET] = {"shmget", 2, sys_shmget},
+    [SYS_SHMAT] = {"shmat", 2, sys_shmat},
+    [SYS_SHMDT] = {"shmdt", 1, sys_shmdt},
+    [SYS_SYSENTER] = {"sysenter", 0, sys_sysenter},
+    [SYS_WAITANY] = {"waitany", 2, sys_waitany},
+    [SYS_IORING_SETUP] = {"ioring_setup", 1, sys_ioring_setup},
+    [SYS_IORING_ENTER] = {"ioring_enter", 0, sys_ioring_enter},
+    [SYS_SBRK] = {"sbrk", 1, sys_sbrk},
+    [SYS_GETRLIMIT] = {"getrlimit", 1, sys_getrlimit},
+    [SYS_SETRLIMIT] = {"setrlimit", 2, sys_setrlimit},
+    [SYS_STRACE] = {"strace", 1, sys_strace},
+    [SYS_BLKSTAT] = {"blkstat", 2, sys_blkstat},
+    [SYS_PMU_SETUP] = {"pmu_setup", 2, sys_pmu_setup},
+    [SYS_PMU_READ] = {"pmu_read", 1, sys_pmu_read},
+    [SYS_FUTEX_WAIT] = {"futex_wait", 2, sys_futex_wait},
+    [SYS_FUTEX_WAKE] = {"futex_wake", 2, sys_futex_wake},
+    [SYS_THREAD_CREATE] = {"thread_create", 2, sys_thread_create},
+    [SYS_THREAD_JOIN] = {"thread_join", 1, sys_thread_join},
+    [SYS_THREAD_EXIT] = {"thread_exit", 1, sys_thread_exit},
+    [SYS_SCHED_DEADLINE] = {"sched_deadline", 3, sys_sched_deadline},
+    [SYS_SCHED_YIELD] = {"sched_yield", 0, sys_sched_yield},
+    [SYS_COPY_FILE_RANGE] = {"copy_file_range", 3, sys_copy_file_range},
+    [SYS_OPEN_FLAGS] = {"open_flags", 2, sys_open_flags},
+    [SYS_FALLOCATE] = {"fallocate", 2, sys_fallocate},
+    [SYS_GETDENTS] = {"getdents", 3, sys_getdents},
+    [SYS_MADVISE] = {"madvise", 3, sys_madvise},
+    [SYS_FADVISE] = {"fadvise", 4, sys_fadvise},
+    [SYS_SETAFFINITY] = {"setaffinity", 1, sys_setaffinity},
+    [SYS_NICE] = {"nice", 1, sys_nice},
+    [SYS_GETNICE] = {"getnice", 0, sys_getnice},
+    [SYS_KSTAT] = {"kstat", 2, sys_kstat},
+    [SYS_POLL] = {"poll", 3, sys_poll},
+    [SYS_FCNTL] = {"fcntl", 3, sys_fcntl},
+    [SYS_GETTUNABLE] = {"gettunable", 2, sys_gettunable},
+    [SYS_SETTUNABLE] = {"settunable", 2, sys_settunable},
+};
 
-extern bool running;
+#define SYSCALL_CNT (sizeof syscalls / sizeof *syscalls)
 
 /* Registers a new interrupt with the code 0x30, to be handled by the `syscall_handler` function */
 void syscall_init(void) { intr_register_int(0x30, 3, INTR_ON, syscall_handler, "syscall"); }
 
+/* Handles a system call made with sysenter.  sysenter_entry in
+   sysenter.S builds the same frame F that int $0x30 would. */
+void syscall_sysenter(struct intr_frame* f) { syscall_handler(f); }
+
+/* Prints the number of calls and the average time per call of
+   each system call that was used. */
+void syscall_print_stats(void) {
+  size_t i;
+
+  for (i = 0; i < SYSCALL_CNT; i++) {
+    const struct syscall* sc = &syscalls[i];
+
+    if (sc->calls > 0)
+      printf("Syscall %s: %lld calls, %lld ns total, %lld ns per call\n", sc->name, sc->calls,
+             sc->time_ns, sc->time_ns / sc->calls);
+  }
+}
+
 /*
   Each syscall is handled in two parts - memory checking and syscall handling
 
-  Memory checking is done by checking if an address on the stack is a valid
-  address. Since PintOS reserves memory above PHYS_BASE as kernel memory, user processes
-  can't access it. This is the first check. The other check if making sure that the address
-  belongs to a valid page from the processes page directory
+  The user stack holds the system call number followed by its arguments. The number selects an
+  entry in `syscalls', which says how many arguments the call takes, and those are copied into
+  the kernel in one go with the helpers in `userprog/usermem.c`, which check each user page
+  once. Buffers the arguments point to are checked the same way, strings are copied into kernel
+  buffers, and structures the kernel fills in are copied out, so a handler never sees a bad user
+  pointer. A process that passes one is killed
 
-  Once the addresses of all stack members are checked, a handler function is called, whose return
-  value (if any) is stored in the eax register of the interrupt frame. The kernel returns it to the
-  caller function in the user process once control returns to user mode from kernel mode
+  Once the arguments are checked, a handler function is called, whose return value is stored in
+  the eax register of the interrupt frame. The kernel returns it to the caller function in the
+  user process once control returns to user mode from kernel mode
 
   All  handler functions are defined in `userprog/handlers.c`
 */
 static void syscall_handler(struct intr_frame* f) {
-  int* p = f->esp;
+  const uint32_t* p = f->esp;
+  uint32_t args[SYSCALL_MAX_ARGS];
+  uint32_t nr;
+  struct syscall* sc;
+  bool traced = thread_current()->process->syscall_trace;
+  int64_t start, ns;
+
+#ifdef VM
+  /* Page faults in the kernel need this for stack growth. */
+  thread_current()->user_esp = f->esp;
+#endif
+  if (!copy_from_user(&nr, p, sizeof nr))
+    SYSCALL_exit_handler(-1);
+  if (nr >= SYSCALL_CNT || syscalls[nr].fn == NULL) {
+    f->eax = -1;
+    return;
+  }
+  sc = &syscalls[nr];
+  if (!copy_from_user(args, p + 1, sc->arg_cnt * sizeof *args))
+    SYSCALL_exit_handler(-1);
+
+  /* Count the call first: exit does not return. */
+  sc->calls++;
+  if (traced && (nr == SYS_EXIT || nr == SYS_HALT))
+    strace_record(sc->name, args, sc->arg_cnt, false, 0, 0);
+  TRACEPOINT(TP_SYSCALL, TP_BEGIN, nr, 0);
+  start = timer_ns();
+  f->eax = sc->fn(f, args);
+  ns = timer_ns() - start;
+  TRACEPOINT(TP_SYSCALL, TP_END, nr, f->eax);
+  sc->time_ns += ns;
+  if (traced)
+    strace_record(sc->name, args, sc->arg_cnt, true, f->eax, ns);
+
+  /* Another thread may have ended the process meanwhile. */
+  process_check_exit();
+}
+
+/* System calls.  Each passes ARGS on to its handler in
+   userprog/handlers.c. */
+
+static uint32_t sys_halt(struct intr_frame* f UNUSED, const uint32_t* args UNUSED) {
+  shutdown_power_off();
+  NOT_REACHED();
+}
+
+static uint32_t sys_exit(struct intr_frame* f UNUSED, const uint32_t* args) {
+  SYSCALL_exit_handler((int)args[0]);
+  NOT_REACHED();
+}
+
+/* Copies the command line at user address UCMD_LINE into the
+   kernel and passes it to START, which is
+   SYSCALL_execute_handler() or SYSCALL_spawn_handler(). */
+/* exec and spawn copy the command line straight into the page
+   that goes to the new process (see process.c), so they pass on
+   the user pointer. */
+static uint32_t sys_exec(struct intr_frame* f UNUSED, const uint32_t* args) {
+  return SYSCALL_execute_handler((const char*)args[0]);
+}
+
+static uint32_t sys_spawn(struct intr_frame* f UNUSED, const uint32_t* args) {
+  return SYSCALL_spawn_handler((const char*)args[0]);
+}
+
+static uint32_t sys_wait(struct intr_frame* f UNUSED, const uint32_t* args) {
+  return SYSCALL_wait_handler((tid_t)args[0]);
+}
+
+static uint32_t sys_waitany(struct intr_frame* f UNUSED, const uint32_t* args) {
+  int* ustatus = (int*)args[0];
+  int status;
+  tid_t tid;
+
+  /* Check the buffer first, so that a bad one reaps nothing. */
+  if (ustatus != NULL && !user_buffer_ok(ustatus, sizeof status, true))
+    SYSCALL_exit_handler(-1);
+  tid = SYSCALL_waitany_handler(&status, args[1] != 0);
+  if (tid > 0 && ustatus != NULL)
+    copy_to_user(ustatus, &status, sizeof status);
+  return tid;
+}
+
+static uint32_t sys_create(struct intr_frame* f UNUSED, const uint32_t* args) {
+  char name[NAME_BUF_SIZE];
+
+  return copy_name(name, (const char*)args[0]) && SYSCALL_create_handler(name, (off_t)args[1]);
+}
+
+static uint32_t sys_remove(struct intr_frame* f UNUSED, const uint32_t* args) {
+  char name[NAME_BUF_SIZE];
+
+  return copy_name(name, (const char*)args[0]) && SYSCALL_remove_handler(name);
+}
+
+static uint32_t sys_open(struct intr_frame* f UNUSED, const uint32_t* args) {
+  char name[NAME_BUF_SIZE];
+
+  return copy_name(name, (const char*)args[0]) ? SYSCALL_open_handler(name) : -1;
+}
+
+static uint32_t sys_filesize(struct intr_frame* f UNUSED, const uint32_t* args) {
+  return SYSCALL_filesize_handler((int)args[0]);
+}
+
+static uint32_t sys_read(struct intr_frame* f UNUSED, const uint32_t* args) {
+  if (!user_buffer_ok((void*)args[1], args[2], true))
+    SYSCALL_exit_handler(-1);
+  return SYSCALL_read_handler((int)args[0], (void*)args[1], args[2]);
+}
+
+static uint32_t sys_write(struct intr_frame* f UNUSED, const uint32_t* args) {
+  if (!user_buffer_ok((const void*)args[1], args[2], false))
+    SYSCALL_exit_handler(-1);
+  return SYSCALL_write_handler((int)args[0], (const void*)args[1], args[2]);
+}
+
+static uint32_t sys_seek(struct intr_frame* f UNUSED, const uint32_t* args) {
+  SYSCALL_seek_handler((int)args[0], (off_t)args[1]);
+  return 0;
+}
+
+static uint32_t sys_tell(struct intr_frame* f UNUSED, const uint32_t* args) {
+  return SYSCALL_tell_handler((int)args[0]);
+}
+
+static uint32_t sys_close(struct intr_frame* f UNUSED, const uint32_t* args) {
+  SYSCALL_close_handler((int)args[0]);
+  return 0;
+}
+
+static uint32_t sys_pipe(struct intr_frame* f UNUSED, const uint32_t* args) {
+  int fds[2];
+
+  if (!user_buffer_ok((int*)args[0], sizeof fds, true))
+    SYSCALL_exit_handler(-1);
+  if (SYSCALL_pipe_handler(fds) < 0)
+    return -1;
+  copy_to_user((int*)args[0], fds, sizeof fds);
+  return 0;
+}
+
+static uint32_t sys_shmget(struct intr_frame* f UNUSED, const uint32_t* args) {
+  return SYSCALL_shmget_handler((int)args[0], args[1]);
+}
+
+static uint32_t sys_shmat(struct intr_frame* f UNUSED, const uint32_t* args) {
+  return (uint32_t)SYSCALL_shmat_handler((int)args[0], (void*)args[1]);
+}
+
+static uint32_t sys_shmdt(struct intr_frame* f UNUSED, const uint32_t* args) {
+  return SYSCALL_shmdt_handler((void*)args[0]);
+}
+
+static uint32_t sys_getrusage(struct intr_frame* f UNUSED, const uint32_t* args) {
+  struct rusage usage;
+  int result = SYSCALL_getrusage_handler(&usage);
+
+  if (!copy_to_user((struct rusage*)args[0], &usage, sizeof usage))
+    SYSCALL_exit_handler(-1);
+  return result;
+}
+
+static uint32_t sys_sbrk(struct intr_frame* f UNUSED, const uint32_t* args) {
+  return (uint32_t)SYSCALL_sbrk_handler((intptr_t)args[0]);
+}
+
+static uint32_t sys_chdir(struct intr_frame* f UNUSED, const uint32_t* args) {
+  char name[NAME_BUF_SIZE];
+
+  return copy_name(name, (const char*)args[0]) && SYSCALL_chdir_handler(name);
+}
+
+static uint32_t sys_mkdir(struct intr_frame* f UNUSED, const uint32_t* args) {
+  char name[NAME_BUF_SIZE];
+
+  return copy_name(name, (const char*)args[0]) && SYSCALL_mkdir_handler(name);
+}
+
+static uint32_t sys_readdir(struct intr_frame* f UNUSED, const uint32_t* args) {
+  if (!user_buffer_ok((void*)args[1], NAME_MAX + 1, true))
+    SYSCALL_exit_handler(-1);
+  return SYSCALL_readdir_handler((int)args[0], (char*)args[1]);
+}
+
+static uint32_t sys_isdir(struct intr_frame* f UNUSED, const uint32_t* args) {
+  return SYSCALL_isdir_handler((int)args[0]);
+}
+
+static uint32_t sys_inumber(struct intr_frame* f UNUSED, const uint32_t* args) {
+  return SYSCALL_inumber_handler((int)args[0]);
+}
+
+static uint32_t sys_getrlimit(struct intr_frame* f UNUSED, const uint32_t* args) {
+  return SYSCALL_getrlimit_handler((int)args[0]);
+}
+
+static uint32_t sys_setrlimit(struct intr_frame* f UNUSED, const uint32_t* args) {
+  return SYSCALL_setrlimit_handler((int)args[0], (unsigned)args[1]);
+}
+
+static uint32_t sys_strace(struct intr_frame* f UNUSED, const uint32_t* args) {
+  return SYSCALL_strace_handler((bool)args[0]);
+}
+
+static uint32_t sys_blkstat(struct intr_frame* f UNUSED, const uint32_t* args) {
+  struct blkstat stats;
+  bool result = SYSCALL_blkstat_handler((int)args[0], &stats);
+
+  if (result && !copy_to_user((struct blkstat*)args[1], &stats, sizeof stats))
+    SYSCALL_exit_handler(-1);
+  return result;
+}
+
+static uint32_t sys_pmu_setup(struct intr_frame* f UNUSED, const uint32_t* args) {
+  unsigned events[PMU_COUNTER_CNT];
+
+  if (!copy_from_user(events, (const unsigned*)args[0], sizeof events))
+    SYSCALL_exit_handler(-1);
+  return SYSCALL_pmu_setup_handler(events, (int)args[1]);
+}
+
+static uint32_t sys_pmu_read(struct intr_frame* f UNUSED, const uint32_t* args) {
+  uint64_t counts[PMU_COUNTER_CNT];
+  unsigned result = SYSCALL_pmu_read_handler(counts);
+
+  if (!copy_to_user((uint64_t*)args[0], counts, sizeof counts))
+    SYSCALL_exit_handler(-1);
+  return result;
+}
 
-  is_valid_address((int*)p);
+static uint32_t sys_futex_wait(struct intr_frame* f UNUSED, const uint32_t* args) {
+  return SYSCALL_futex_wait_handler((const int*)args[0], (int)args[1]);
+}
 
-  int system_call = *p;
-  switch (system_call) {
-    case SYS_HALT:
-      shutdown_power_off();
-      break;
+static uint32_t sys_futex_wake(struct intr_frame* f UNUSED, const uint32_t* args) {
+  return SYSCALL_futex_wake_handler((const int*)args[0], (int)args[1]);
+}
 
-    case SYS_EXIT:
-      is_valid_address((int*)p + 1);
-      SYSCALL_exit_handler((int)*(p + 1));
-      break;
+static uint32_t sys_thread_create(struct intr_frame* f, const uint32_t* args) {
+  return SYSCALL_thread_create_handler(f, (void*)args[0], (void*)args[1]);
+}
 
-    case SYS_EXEC:
-      is_valid_address((int*)p + 1);
-      is_valid_address((int*)*(p + 1));
-      f->eax = SYSCALL_execute_handler((char*)*(p + 1));
-      break;
+static uint32_t sys_thread_join(struct intr_frame* f UNUSED, const uint32_t* args) {
+  return SYSCALL_thread_join_handler((tid_t)args[0]);
+}
 
-    case SYS_WAIT:
-      is_valid_address((int*)p + 1);
-      f->eax = SYSCALL_wait_handler((tid_t) * (p + 1));
-      break;
+static uint32_t sys_thread_exit(struct intr_frame* f UNUSED, const uint32_t* args) {
+  SYSCALL_thread_exit_handler((int)args[0]);
+  NOT_REACHED();
+}
 
-    case SYS_CREATE:
-      is_valid_address((int*)p + 5);
-      is_valid_address((int*)*(p + 4));
+static uint32_t sys_sched_deadline(struct intr_frame* f UNUSED, const uint32_t* args) {
+  return SYSCALL_sched_deadline_handler(args[0], args[1], args[2]);
+}
 
-      f->eax = SYSCALL_create_handler((const char*)*(p + 4), (off_t) * (p + 5));
-      break;
+static uint32_t sys_setaffinity(struct intr_frame* f UNUSED, const uint32_t* args) {
+  return SYSCALL_setaffinity_handler(args[0]);
+}
 
-    case SYS_REMOVE:
-      is_valid_address((int*)p + 1);
-      is_valid_address((int*)*(p + 1));
+static uint32_t sys_nice(struct intr_frame* f UNUSED, const uint32_t* args) {
+  return SYSCALL_nice_handler((int)args[0]);
+}
 
-      f->eax = SYSCALL_remove_handler((const char*)*(p + 1));
-      break;
+static uint32_t sys_getnice(struct intr_frame* f UNUSED, const uint32_t* args UNUSED) {
+  return SYSCALL_getnice_handler();
+}
 
-    case SYS_OPEN:
-      is_valid_address((int*)p + 1);
-      is_valid_address((int*)*(p + 1));
+static uint32_t sys_kstat(struct intr_frame* f UNUSED, const uint32_t* args) {
+  unsigned cnt = (int)args[1] <= 0 ? 0 : args[1] < KSTAT_CALL_MAX ? args[1] : KSTAT_CALL_MAX;
 
-      f->eax = SYSCALL_open_handler((const char*)*(p + 1));
-      break;
+  if (!user_buffer_ok((void*)args[0], cnt * sizeof(struct kstat), true))
+    SYSCALL_exit_handler(-1);
+  return SYSCALL_kstat_handler((struct kstat*)args[0], cnt);
+}
 
-    case SYS_FILESIZE:
-      is_valid_address((int*)p + 1);
+static uint32_t sys_poll(struct intr_frame* f UNUSED, const uint32_t* args) {
+  int nfds = (int)args[1];
 
-      f->eax = SYSCALL_filesize_handler((int)*(p + 1));
-      break;
+  if (nfds < 0 || nfds > POLL_CALL_MAX)
+    return -1;
+  if (!user_buffer_ok((void*)args[0], nfds * sizeof(struct pollfd), true))
+    SYSCALL_exit_handler(-1);
+  return SYSCALL_poll_handler((struct pollfd*)args[0], nfds, (int)args[2]);
+}
 
-    case SYS_READ:
-      is_valid_address((int*)p + 7);
-      is_valid_address((int*)*(p + 6));
+static uint32_t sys_fcntl(struct intr_frame* f UNUSED, const uint32_t* args) {
+  return SYSCALL_fcntl_handler((int)args[0], (int)args[1], (int)args[2]);
+}
 
-      f->eax = SYSCALL_read_handler((int)*(p + 5), (void*)*(p + 6), (unsigned int)*(p + 7));
-      break;
+static uint32_t sys_gettunable(struct intr_frame* f UNUSED, const uint32_t* args) {
+  char name[NAME_BUF_SIZE];
+  unsigned value;
+  bool result;
 
-    case SYS_WRITE:
-      is_valid_address((int*)p + 7);
-      is_valid_address((int*)*(p + 6));
+  if (!copy_name(name, (const char*)args[0]))
+    return false;
+  result = SYSCALL_gettunable_handler(name, &value);
+  if (result && !copy_to_user((unsigned*)args[1], &value, sizeof value))
+    SYSCALL_exit_handler(-1);
+  return result;
+}
 
-      f->eax = SYSCALL_write_handler((int)*(p + 5), (const void*)*(p + 6), (unsigned int)*(p + 7));
-      break;
+static uint32_t sys_settunable(struct intr_frame* f UNUSED, const uint32_t* args) {
+  char name[NAME_BUF_SIZE];
 
-    case SYS_SEEK:
-      is_valid_address((int*)p + 5);
+  return copy_name(name, (const char*)args[0]) && SYSCALL_settunable_handler(name, args[1]);
+}
 
-      SYSCALL_seek_handler((int)*(p + 4), (off_t) * (p + 5));
-      break;
+static uint32_t sys_sched_yield(struct intr_frame* f UNUSED, const uint32_t* args UNUSED) {
+  SYSCALL_sched_yield_handler();
+  return 0;
+}
+
+static uint32_t sys_copy_file_range(struct intr_frame* f UNUSED, const uint32_t* args) {
+  return SYSCALL_copy_file_range_handler(args[0], args[1], args[2]);
+}
 
-    case SYS_TELL:
-      is_valid_address((int*)p + 1);
+static uint32_t sys_open_flags(struct intr_frame* f UNUSED, const uint32_t* args) {
+  char name[NAME_BUF_SIZE];
 
-      SYSCALL_tell_handler((int)*(p + 1));
-      break;
+  return copy_name(name, (const char*)args[0]) ? SYSCALL_open_flags_handler(name, (int)args[1])
+                                               : -1;
+}
+
+static uint32_t sys_fallocate(struct intr_frame* f UNUSED, const uint32_t* args) {
+  return SYSCALL_fallocate_handler((int)args[0], (unsigned)args[1]);
+}
+
+static uint32_t sys_getdents(struct intr_frame* f UNUSED, const uint32_t* args) {
+  unsigned cnt = args[2] < GETDENTS_MAX ? args[2] : GETDENTS_MAX;
+
+  if (!user_buffer_ok((void*)args[1], cnt * sizeof(struct dirent), true))
+    SYSCALL_exit_handler(-1);
+  return SYSCALL_getdents_handler((int)args[0], (struct dirent*)args[1], cnt);
+}
+
+static uint32_t sys_madvise(struct intr_frame* f UNUSED, const uint32_t* args) {
+  return SYSCALL_madvise_handler((void*)args[0], (unsigned)args[1], (int)args[2]);
+}
+
+static uint32_t sys_fadvise(struct intr_frame* f UNUSED, const uint32_t* args) {
+  return SYSCALL_fadvise_handler((int)args[0], args[1], args[2], (int)args[3]);
+}
+
+static uint32_t sys_ioring_setup(struct intr_frame* f UNUSED, const uint32_t* args) {
+  return (uint32_t)SYSCALL_ioring_setup_handler((void*)args[0]);
+}
+
+static uint32_t sys_ioring_enter(struct intr_frame* f UNUSED, const uint32_t* args UNUSED) {
+  return SYSCALL_ioring_enter_handler();
+}
+
+static uint32_t sys_sysenter(struct intr_frame* f UNUSED, const uint32_t* args UNUSED) {
+  return SYSCALL_sysenter_handler();
+}
+
+static uint32_t sys_clock_ns(struct intr_frame* f UNUSED, const uint32_t* args) {
+  int64_t ns;
+
+  SYSCALL_clock_ns_handler(&ns);
+  if (!copy_to_user((int64_t*)args[0], &ns, sizeof ns))
+    SYSCALL_exit_handler(-1);
+  return 0;
+}
+
+static uint32_t sys_fork(struct intr_frame* f, const uint32_t* args UNUSED) {
+  return SYSCALL_fork_handler(f);
+}
+
+static uint32_t sys_readv(struct intr_frame* f UNUSED, const uint32_t* args) {
+  struct iovec* iov = copy_iov((const struct iovec*)args[1], (int)args[2], true);
+  int result;
+
+  if (iov == NULL)
+    return -1;
+  result = SYSCALL_readv_handler((int)args[0], iov, (int)args[2]);
+  free(iov);
+  return result;
+}
+
+static uint32_t sys_writev(struct intr_frame* f UNUSED, const uint32_t* args) {
+  struct iovec* iov = copy_iov((const struct iovec*)args[1], (int)args[2], false);
+  int result;
+
+  if (iov == NULL)
+    return -1;
+  result = SYSCALL_writev_handler((int)args[0], iov, (int)args[2]);
+  free(iov);
+  return result;
+}
+
+static uint32_t sys_pread(struct intr_frame* f UNUSED, const uint32_t* args) {
+  if (!user_buffer_ok((void*)args[1], args[2], true))
+    SYSCALL_exit_handler(-1);
+  return SYSCALL_pread_handler((int)args[0], (void*)args[1], args[2], (off_t)args[3]);
+}
+
+static uint32_t sys_pwrite(struct intr_frame* f UNUSED, const uint32_t* args) {
+  if (!user_buffer_ok((const void*)args[1], args[2], false))
+    SYSCALL_exit_handler(-1);
+  return SYSCALL_pwrite_handler((int)args[0], (const void*)args[1], args[2], (off_t)args[3]);
+}
+
+#ifdef VM
+static uint32_t sys_mmap(struct intr_frame* f UNUSED, const uint32_t* args) {
+  return SYSCALL_mmap_handler((int)args[0], (void*)args[1]);
+}
+
+static uint32_t sys_munmap(struct intr_frame* f UNUSED, const uint32_t* args) {
+  SYSCALL_munmap_handler((int)args[0]);
+  return 0;
+}
+#endif
+
+/* Copies the file name at user address UNAME into the
+   NAME_BUF_SIZE bytes at NAME.  Returns false if the name is too
+   long to be a valid file name.  Kills the current process if
+   UNAME is a bad pointer. */
+static bool copy_name(char* name, const char* uname) {
+  int len = strncpy_from_user(name, uname, NAME_BUF_SIZE);
+
+  if (len < 0)
+    SYSCALL_exit_handler(-1);
+  return len < NAME_BUF_SIZE;
+}
 
-    case SYS_CLOSE:
-      is_valid_address((int*)p + 1);
+/* Copies the IOVCNT iovecs at user address UIOV into a new
+   kernel array, which the caller must free, and checks that the
+   current process may read the buffers they describe or, if
+   WRITE is true, write them.  Returns a null pointer if IOVCNT
+   is out of range or memory runs out.  Kills the current process
+   if UIOV or one of the buffers is bad. */
+static struct iovec* copy_iov(const struct iovec* uiov, int iovcnt, bool write) {
+  struct iovec* iov;
+  int i;
 
-      SYSCALL_close_handler((int)*(p + 1));
-      break;
+  if (iovcnt <= 0 || iovcnt > IOV_MAX)
+    return NULL;
+  iov = malloc(iovcnt * sizeof *iov);
+  if (iov == NULL)
+    return NULL;
+  if (!copy_from_user(iov, uiov, iovcnt * sizeof *iov)) {
+    free(iov);
+    SYSCALL_exit_handler(-1);
   }
+  for (i = 0; i < iovcnt; i++)
+    if (!user_buffer_ok(iov[i].iov_base, iov[i].iov_len, write)) {
+      free(iov);
+      SYSCALL_exit_handler(-1);
+    }
+  return iov;
 }
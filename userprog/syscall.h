@@ -2,8 +2,10 @@
 #define USERPROG_SYSCALL_H
 
 #include <stdbool.h>
-void syscall_init(void);
+struct intr_frame;
 
-// bool is_valid_address(const void*);
+void syscall_init(void);
+void syscall_sysenter(struct intr_frame*);
+void syscall_print_stats(void);
 
 #endif /* userprog/syscall.h */
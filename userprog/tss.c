@@ -74,6 +74,38 @@ struct tss {
 /* Kernel TSS. */
 static struct tss* tss;
 
+/* Fast system calls.
+
+   sysenter enters ring 0 at the address in MSR_SYSENTER_EIP
+   with the stack pointer in MSR_SYSENTER_ESP, without consulting
+   the IDT or the TSS and without pushing anything, and sysexit
+   returns to ring 3 at %edx with the stack pointer in %ecx.  The
+   code and stack selectors both instructions load are fixed
+   offsets from MSR_SYSENTER_CS, which is why the GDT puts the
+   user selectors right after the kernel ones.
+
+   MSR_SYSENTER_ESP points at the esp0 member of the TSS, not at
+   a stack, so that tss_update() need not rewrite an MSR on every
+   thread switch: sysenter_entry in sysenter.S loads the real
+   kernel stack pointer from there.  See [IA32-v3a] 4.8.7
+   "Performing Fast Calls to System Procedures with the SYSENTER
+   and SYSEXIT Instructions". */
+#define MSR_SYSENTER_CS 0x174  /* Ring 0 code selector. */
+#define MSR_SYSENTER_ESP 0x175 /* Ring 0 stack pointer. */
+#define MSR_SYSENTER_EIP 0x176 /* Ring 0 entry point. */
+
+/* CPUID feature flag: sysenter and sysexit. */
+#define CPUID_SEP (1 << 11)
+
+/* -no-sysenter: Take every system call through int $0x30? */
+bool sysenter_disabled;
+
+static bool sysenter_enabled; /* Are the MSRs set up? */
+
+void sysenter_entry(void);
+static bool sysenter_supported(void);
+static void write_msr(uint32_t msr, uint32_t value);
+
 /* Initializes the kernel TSS. */
 void tss_init(void) {
   /* Our TSS is never used in a call gate or task gate, so only a
@@ -83,8 +115,19 @@ void tss_init(void) {
   tss->ss0 = SEL_KDSEG;
   tss->bitmap = 0xdfff;
   tss_update();
+
+  if (!sysenter_disabled && sysenter_supported()) {
+    write_msr(MSR_SYSENTER_CS, SEL_KCSEG);
+    write_msr(MSR_SYSENTER_ESP, (uint32_t)&tss->esp0);
+    write_msr(MSR_SYSENTER_EIP, (uint32_t)sysenter_entry);
+    sysenter_enabled = true;
+  }
 }
 
+/* Returns true if user programs may make system calls with
+   sysenter. */
+bool tss_sysenter_enabled(void) { return sysenter_enabled; }
+
 /* Returns the kernel TSS. */
 struct tss* tss_get(void) {
   ASSERT(tss != NULL);
@@ -97,3 +140,22 @@ void tss_update(void) {
   ASSERT(tss != NULL);
   tss->esp0 = (uint8_t*)thread_current() + PGSIZE;
 }
+
+/* Returns true if the CPU implements sysenter and sysexit.  The
+   earliest Pentium Pros report the feature flag without
+   implementing the instructions. */
+static bool sysenter_supported(void) {
+  uint32_t eax = 1, ebx, ecx, edx;
+  unsigned family, model, stepping;
+
+  asm volatile("cpuid" : "+a"(eax), "=b"(ebx), "=c"(ecx), "=d"(edx));
+  family = (eax >> 8) & 0xf;
+  model = (eax >> 4) & 0xf;
+  stepping = eax & 0xf;
+  return (edx & CPUID_SEP) && !(family == 6 && model < 3 && stepping < 3);
+}
+
+/* Sets model-specific register MSR to VALUE. */
+static void write_msr(uint32_t msr, uint32_t value) {
+  asm volatile("wrmsr" : : "c"(msr), "a"(value), "d"(0));
+}
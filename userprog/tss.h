@@ -1,11 +1,16 @@
 #ifndef USERPROG_TSS_H
 #define USERPROG_TSS_H
 
+#include <stdbool.h>
 #include <stdint.h>
 
+/* -no-sysenter: Take every system call through int $0x30? */
+extern bool sysenter_disabled;
+
 struct tss;
 void tss_init(void);
 struct tss* tss_get(void);
 void tss_update(void);
+bool tss_sysenter_enabled(void);
 
 #endif /* userprog/tss.h */
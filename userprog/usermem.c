@@ -0,0 +1,166 @@
+#include "userprog/usermem.h"
+#include <debug.h>
+#include <stdint.h>
+#include <string.h>
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "userprog/pagedir.h"
+#ifdef VM
+#include "vm/page.h"
+#endif
+
+/* Access to user memory from system calls.
+
+   A system call may only touch user memory that belongs to the
+   calling process, and only in the way the process itself could.
+   These functions check each page of a user buffer once, however
+   large the buffer is, before the kernel touches it, so a
+   multi-page read costs one check per page instead of one per
+   byte or argument.
+
+   With VM, a page that the process has in its supplemental page
+   table is good even if it is not in memory yet: the kernel's
+   access faults it in, or gives it a copy of its own if it is
+   copy-on-write.  A page that is not there is good if the access
+   is one the stack may grow to (see page_grow_stack()). */
+
+static bool user_page_ok(const void* uaddr, bool write);
+
+/* Returns true if the current process may read the SIZE bytes
+   at UBUF or, if WRITE is true, write them. */
+bool user_buffer_ok(const void* ubuf, size_t size, bool write) {
+  const uint8_t* start = ubuf;
+  const uint8_t* end = start + size;
+  const uint8_t* p;
+
+  if (size == 0)
+    return true;
+  if (end < start || !is_user_vaddr(end - 1))
+    return false;
+
+  if (!user_page_ok(start, write))
+    return false;
+  for (p = (const uint8_t*)pg_round_down(start) + PGSIZE; p < end; p += PGSIZE)
+    if (!user_page_ok(p, write))
+      return false;
+  return true;
+}
+
+/* Copies SIZE bytes from user address USRC to kernel address
+   DST.  Returns false, copying nothing, if the current process
+   may not read all of them. */
+bool copy_from_user(void* dst, const void* usrc, size_t size) {
+  if (!user_buffer_ok(usrc, size, false))
+    return false;
+  memcpy(dst, usrc, size);
+  return true;
+}
+
+/* Copies SIZE bytes from kernel address SRC to user address
+   UDST.  Returns false, copying nothing, if the current process
+   may not write all of them. */
+bool copy_to_user(void* udst, const void* src, size_t size) {
+  if (!user_buffer_ok(udst, size, true))
+    return false;
+  memcpy(udst, src, size);
+  return true;
+}
+
+/* Copies the null-terminated string at user address USRC into
+   the SIZE-byte buffer DST, where SIZE is at least 2, and
+   returns its length.  If the string does not fit, copies its
+   first SIZE - 1 bytes and returns SIZE.  Returns -1 if the
+   current process may not read the string. */
+int strncpy_from_user(char* dst, const char* usrc, size_t size) {
+  size_t len = 0;
+
+  while (len < size - 1) {
+    const char* s = usrc + len;
+    size_t chunk = PGSIZE - pg_ofs(s);
+
+    if (!is_user_vaddr(s) || !user_page_ok(s, false))
+      return -1;
+    if (chunk > size - 1 - len)
+      chunk = size - 1 - len;
+    for (; chunk > 0; chunk--, len++)
+      if ((dst[len] = usrc[len]) == '\0')
+        return len;
+  }
+  dst[len] = '\0';
+  return size;
+}
+
+/* Returns the kernel address that user address UADDR maps to,
+   for a device to transfer to or from without going through a
+   kernel buffer, or a null pointer if the current process may
+   not read the page that contains it or, if WRITE is true, write
+   it.  With VM, the page is brought in and stays in its frame,
+   and no other thread of the process may fault, until
+   user_unpin(). */
+void* user_pin(const void* uaddr, bool write) {
+  struct thread* t = thread_current();
+  void* kaddr;
+#ifdef VM
+  bool locked;
+#endif
+
+  if (!is_user_vaddr(uaddr))
+    return NULL;
+#ifdef VM
+  locked = page_table_lock();
+  ASSERT(locked);
+  if (page_lookup(uaddr) != NULL || page_grow_stack(uaddr, t->user_esp)) {
+    kaddr = page_pin(uaddr, write);
+    if (kaddr == NULL)
+      page_table_unlock(locked);
+    return kaddr;
+  }
+#endif
+
+  /* Without VM, and for shared memory, the page directory has
+     every page, and its frames never move. */
+  kaddr = pagedir_get_page(t->pagedir, uaddr);
+  if (kaddr != NULL && write && !pagedir_is_writable(t->pagedir, pg_round_down(uaddr)))
+    kaddr = NULL;
+#ifdef VM
+  if (kaddr == NULL)
+    page_table_unlock(locked);
+#endif
+  return kaddr;
+}
+
+/* Releases the page that contains UADDR, which user_pin()
+   returned a kernel address for. */
+void user_unpin(const void* uaddr UNUSED) {
+#ifdef VM
+  page_unpin(uaddr);
+  page_table_unlock(true);
+#endif
+}
+
+/* Returns true if the current process may read or, if WRITE is
+   true, write the page that contains user address UADDR. */
+static bool user_page_ok(const void* uaddr, bool write) {
+  struct thread* t = thread_current();
+
+#ifdef VM
+  bool locked = page_table_lock();
+  struct page* p = page_lookup(uaddr);
+  bool writable = p != NULL && p->writable;
+
+  page_table_unlock(locked);
+  if (p != NULL)
+    return writable || !write;
+
+  /* Shared memory (see userprog/shm.c) is only in the page
+     directory. */
+  if (pagedir_is_mapped(t->pagedir, pg_round_down(uaddr)))
+    return !write || pagedir_is_writable(t->pagedir, pg_round_down(uaddr));
+  return page_grow_stack(uaddr, t->user_esp);
+#else
+  void* upage = pg_round_down(uaddr);
+
+  return write ? pagedir_is_writable(t->pagedir, upage)
+               : pagedir_is_mapped(t->pagedir, upage);
+#endif
+}
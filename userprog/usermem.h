@@ -0,0 +1,14 @@
+#ifndef USERPROG_USERMEM_H
+#define USERPROG_USERMEM_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+bool user_buffer_ok(const void* ubuf, size_t size, bool write);
+bool copy_from_user(void* dst, const void* usrc, size_t size);
+bool copy_to_user(void* udst, const void* src, size_t size);
+int strncpy_from_user(char* dst, const char* usrc, size_t size);
+void* user_pin(const void* uaddr, bool write);
+void user_unpin(const void* uaddr);
+
+#endif /* userprog/usermem.h */
@@ -0,0 +1,1007 @@
+#include "vm/frame.h"
+#include <debug.h>
+#include <mman.h>
+#include <ohash.h>
+#include <stdio.h>
+#include <string.h>
+#include "devices/timer.h"
+#include "filesys/inode.h"
+#include "threads/highmem.h"
+#include "threads/interrupt.h"
+#include "threads/kstat.h"
+#include "threads/palloc.h"
+#include "threads/slab.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "threads/workqueue.h"
+#include "vm/page.h"
+#include "vm/swap.h"
+
+/* Frame table.
+
+   Every user pool page that holds process data has a struct
+   frame in frame_table.  When the user pool runs out,
+   frame_alloc() picks a victim with the clock (second chance)
+   algorithm: it sweeps the table from where the last sweep
+   stopped, clears the accessed bits of each recently used frame
+   it passes, and takes the first frame none of whose pages was
+   accessed since the last sweep.  page_out() then writes each of
+   the victim's pages to swap or drops it, and the frame is
+   handed over as is.
+
+   Frames come from palloc_get_frame(), high memory first, so a
+   frame is known by its physical address, and the kernel maps it
+   with kmap() for as long as it reads or writes it (see
+   threads/highmem.c).
+
+   Read-only pages of executables are shared: page_in() looks for
+   a frame already holding the same part of the same inode with
+   frame_find_shared() before reading it, and enters the frames
+   it does read in the share table with frame_share().
+
+   The share table is also the page cache for file data.  Clean
+   pages of mapped files are entered in it too, and mapped
+   read-only and copy-on-write, so that every mapping of a page
+   of a file, and the executable's text, uses one frame.  A frame
+   in the share table is not freed when its last page lets go of
+   it with frame_detach(): it stays in the frame table, holding a
+   reference to its inode, for the next exec or mmap of the file
+   to map, and for inode_read_at() to copy reads from with
+   frame_read_cached().  The clock evicts such a frame like any
+   other, counting reads through the cache as uses.  Each entry
+   records the inode's version when it was read, and an entry
+   whose inode was written since is dropped when it is found, so
+   the cache never serves stale data.
+
+   frame_lock protects the table, the share table and the clock
+   hand.  Each frame's own lock is held while the frame is being
+   filled or evicted and while its list of pages changes, so a
+   page is never evicted halfway through being read in, and a
+   process that faults on a page under eviction waits for the
+   eviction to finish.  The clock only ever try-acquires frame
+   locks, so it skips busy frames instead of waiting for them.
+
+   A thread may still be waiting for the lock of a frame that is
+   freed, so a struct frame is never given back: freed frames
+   keep their lock and wait on free_frames to be reused.
+
+   So that a process rarely has to wait for an eviction, page-out
+   work on the workqueue keeps a few user pages free.
+   frame_alloc() queues it when fewer than pageout_low pages are
+   left.  It first
+   writes a batch of the dirty, unused frames just ahead of the
+   clock hand to a run of adjacent swap slots, which the disk
+   takes in a single sweep, and then evicts frames with the
+   clock, which finds those frames clean, until pageout_high
+   pages are free.
+
+   A process whose resident set has reached its RLIMIT_FRAMES
+   limit gets no more of the pool: frame_alloc() evicts one of
+   the process's own frames instead, sweeping the clock as usual
+   but passing over frames that other processes use too.  One
+   process faulting over a large address space then only pages
+   against itself.
+
+   When the processes together need more memory than there is,
+   they thrash: each evicts pages the others are about to use.
+   The frame table notices this from refault distances.  Each
+   evicted page records the eviction count, and when it is read
+   back in, the number of evictions in between tells how much
+   more memory would have kept it resident.  A refault within
+   frame_cnt evictions is a working-set refault: the page was in
+   use, and was lost only to memory pressure.  Read-ins are
+   counted in windows of THRASH_WINDOW, and once THRASH_PATIENCE
+   windows in a row are mostly working-set refaults, the process
+   with the highest badness, its resident pages plus its
+   refaults in the current window, is suspended at its page
+   faults for THRASH_SUSPEND ticks.  Its frames go unused
+   meanwhile, so the clock gives them to the others, which can
+   then make progress; it resumes later with the memory they
+   freed.  No process is suspended unless at least two compete,
+   since a process that thrashes alone slows down nobody but
+   itself.
+
+   With -merge, anonymous pages with the same contents share a
+   frame, as pages do after a fork(): many processes running the
+   same program have identical data and heap pages.  Merge work
+   on the workqueue at WORK_LOW, so that it runs only when the
+   CPU has nothing else to do, walks the frame table with a hand
+   of its own and hashes the frames whose pages are all
+   anonymous.  A frame whose hash has not changed since the last
+   walk is stable, and likely to stay so: its pages are
+   write-protected and it is entered in the merge table, keyed on
+   its contents.  If a frame with the same contents is there
+   already, the stable frame's pages are moved to it instead and
+   the stable frame is freed.  Every page of a frame in the merge
+   table is mapped read-only, so its contents cannot change while
+   it is there; the first write to one of its pages takes a
+   copy-on-write fault, and page_cow() gives the page a frame of
+   its own, or takes the frame out of the merge table if no other
+   page uses it.  Frame allocation queues the merge work every
+   MERGE_INTERVAL ticks, and the work queues itself again until a
+   walk of the whole table finds no frame it had not hashed
+   before. */
+
+static struct list frame_table;  /* Frames in use, in clock order. */
+static struct list free_frames;  /* Frames without a page. */
+static struct ohash share_table; /* Shared text frames. */
+static struct ohash merge_table; /* Merged anonymous frames. */
+static struct list_elem* hand;   /* Next frame the clock looks at. */
+static struct lock frame_lock;   /* Protects the tables and hand. */
+static struct kmem_cache* frame_cache;
+
+/* Page-out work. */
+#define PAGEOUT_BATCH 8 /* Most frames cleaned per wakeup. */
+#define PAGEOUT_SCAN 32 /* Frames ahead of the hand looked at per wakeup. */
+#define PAGEOUT_MAX 64  /* Largest high watermark, in pages. */
+static size_t pageout_low;       /* Queue page-out below this many free pages. */
+static size_t pageout_high;      /* Page-out frees pages up to this many. */
+static struct work pageout_work; /* Runs pageout(). */
+static bool pageout_wanted;      /* Queued, but not done yet? */
+
+/* Thrashing. */
+#define THRASH_WINDOW 64          /* Read-ins per window. */
+#define THRASH_PATIENCE 4         /* Thrashing windows in a row before suspending. */
+#define THRASH_SUSPEND TIMER_FREQ /* Ticks to suspend the worst process. */
+static size_t frame_cnt;          /* Pages in the user pool. */
+static unsigned thrash_window;    /* Current window, counting from 1. */
+static unsigned window_reads;     /* Pages read in during the window. */
+static unsigned window_refaults;  /* Working-set refaults among them. */
+static unsigned thrash_streak;    /* Thrashing windows in a row. */
+
+/* Same-page merging. */
+#define MERGE_BATCH 32               /* Frames hashed per run of merge work. */
+#define MERGE_INTERVAL TIMER_FREQ    /* Ticks between walks started by allocation. */
+bool frame_merge_enabled;            /* -merge: Merge anonymous pages? */
+static struct list_elem* merge_hand; /* Next frame the merge work looks at. */
+static struct work merge_work;       /* Runs merge(). */
+static int64_t merge_next;           /* Tick at which allocation next queues merge(). */
+static bool merge_found;             /* Hashed a frame for the first time in this walk? */
+
+/* Statistics. */
+static long long eviction_cnt; /* Frames taken from other pages. */
+static long long share_hits;   /* Pages found in the share table. */
+static long long clean_cnt;    /* Pages cleaned ahead of eviction. */
+static long long reclaim_cnt;  /* Frames freed by page-out. */
+static long long limit_cnt;    /* Frames taken from processes at their limit. */
+static long long advice_cnt;   /* Frames freed on MADV_DONTNEED. */
+static long long keep_cnt;     /* Frames kept in the page cache after their last page. */
+static long long read_hits;    /* Reads copied from the page cache. */
+static long long refault_cnt;  /* Working-set refaults. */
+static long long thrash_cnt;   /* Windows that were mostly refaults. */
+static long long suspend_cnt;  /* Processes suspended for thrashing. */
+static long long merge_cnt;    /* Frames freed by merging their pages into others. */
+static long long scan_cnt;     /* Frames hashed by merge work. */
+
+static struct frame* frame_get(struct page*, bool evict);
+static struct frame* frame_evict(struct thread* owner);
+static bool frame_owned_by(struct frame*, struct thread*);
+static bool frame_accessed(struct frame*);
+static void frame_free(struct frame*);
+static struct inode* unshare(struct frame*);
+static void uncache(struct frame*);
+static void advance_hand(void);
+static void pageout_wake(void);
+static thread_func pageout;
+static void pageout_clean(void);
+static void sort_batch(struct frame**, size_t cnt);
+static hash_hash_func share_hash;
+static hash_less_func share_less;
+static void merge_wake(void);
+static thread_func merge;
+static bool merge_frame(struct frame*);
+static bool frame_anonymous(struct frame*);
+static hash_hash_func merge_hash;
+static hash_less_func merge_less;
+static void thrash_suspend(unsigned window);
+static thread_action_func thrash_pick;
+static thread_action_func thrash_mark;
+
+/* Initializes the frame table. */
+void frame_init(void) {
+  list_init(&frame_table);
+  list_init(&free_frames);
+  if (!ohash_init(&share_table, share_hash, share_less, NULL)
+      || !ohash_init(&merge_table, merge_hash, merge_less, NULL))
+    PANIC("frame: share table creation failed");
+  hand = merge_hand = list_end(&frame_table);
+  lock_init(&frame_lock);
+  frame_cache = kmem_cache_create("frame", sizeof(struct frame), __alignof__(struct frame), NULL);
+
+  /* Keep about 3% of the user pool free.  The whole pool is free
+     at this point. */
+  frame_cnt = palloc_free_cnt(PAL_USER);
+  thrash_window = 1;
+  merge_found = true;
+  pageout_high = frame_cnt / 32;
+  if (pageout_high > PAGEOUT_MAX)
+    pageout_high = PAGEOUT_MAX;
+  pageout_low = pageout_high / 2;
+  work_init(&pageout_work, pageout, NULL);
+  work_init(&merge_work, merge, NULL);
+
+  kstat_counter("vm.evictions", &eviction_cnt);
+  kstat_counter("vm.share_hits", &share_hits);
+  kstat_counter("vm.cleaned", &clean_cnt);
+  kstat_counter("vm.reclaimed", &reclaim_cnt);
+  kstat_counter("vm.limit_evictions", &limit_cnt);
+  kstat_counter("vm.page_cache_reads", &read_hits);
+  kstat_counter("vm.refaults", &refault_cnt);
+  kstat_counter("vm.thrash_suspends", &suspend_cnt);
+  kstat_counter("vm.merged", &merge_cnt);
+}
+
+/* Returns a frame for PAGE, evicting other pages if the user
+   pool is empty, or returns a null pointer if nothing can be
+   evicted.  The frame is returned with its lock held; the caller
+   releases it once the frame is filled and mapped. */
+struct frame* frame_alloc(struct page* page) { return frame_get(page, true); }
+
+/* Like frame_alloc(), but returns a null pointer instead of
+   evicting anything if the user pool is empty.  For reading
+   ahead, which is not worth an eviction. */
+struct frame* frame_try_alloc(struct page* page) { return frame_get(page, false); }
+
+/* Returns a frame for PAGE, locked, evicting other pages for it
+   if the user pool is empty or PAGE's owner is at its resident
+   limit, and EVICT is true. */
+static struct frame* frame_get(struct page* page, bool evict) {
+  struct thread* owner = page->owner;
+  uintptr_t paddr;
+  struct frame* f;
+
+  if (owner->rss_pages >= owner->rlimits[RLIMIT_FRAMES]) {
+    if (!evict)
+      return NULL;
+    f = frame_evict(owner);
+    if (f != NULL) {
+      list_push_back(&f->pages, &page->frame_elem);
+      limit_cnt++;
+    }
+    return f;
+  }
+
+  paddr = palloc_get_frame(0, pg_no(page->upage));
+  pageout_wake();
+  merge_wake();
+  if (paddr == 0) {
+    if (!evict)
+      return NULL;
+    f = frame_evict(NULL);
+    if (f != NULL)
+      list_push_back(&f->pages, &page->frame_elem);
+    return f;
+  }
+
+  lock_acquire(&frame_lock);
+  if (!list_empty(&free_frames))
+    f = list_entry(list_pop_front(&free_frames), struct frame, elem);
+  else {
+    f = kmem_cache_alloc(frame_cache);
+    if (f == NULL) {
+      lock_release(&frame_lock);
+      palloc_free_frame(paddr);
+      return NULL;
+    }
+    lock_init(&f->lock);
+  }
+  f->paddr = paddr;
+  f->kaddr = NULL;
+  list_init(&f->pages);
+  list_push_back(&f->pages, &page->frame_elem);
+  f->inode = NULL;
+  f->scanned = f->merged = false;
+  list_push_back(&frame_table, &f->elem);
+  lock_release(&frame_lock);
+
+  lock_acquire(&f->lock);
+  return f;
+}
+
+/* Removes PAGE, which must already be unmapped, from frame F,
+   and frees F if no other page uses it and it is not in the page
+   cache.  Releases F's lock, which must be held. */
+void frame_detach(struct frame* f, struct page* page) {
+  ASSERT(lock_held_by_current_thread(&f->lock));
+
+  list_remove(&page->frame_elem);
+  if (!list_empty(&f->pages))
+    lock_release(&f->lock);
+  else if (f->inode != NULL) {
+    keep_cnt++;
+    lock_release(&f->lock);
+  } else
+    frame_free(f);
+}
+
+/* Looks for a shared frame holding READ_BYTES bytes of INODE at
+   OFS, as INODE holds them now.  If there is one, adds PAGE to
+   it and returns it, with its lock held.  Otherwise, returns a
+   null pointer. */
+struct frame* frame_find_shared(struct page* page, struct inode* inode, off_t ofs,
+                                size_t read_bytes) {
+  struct frame key;
+  struct hash_elem* e;
+  struct frame* f;
+
+  key.inode = inode;
+  key.ofs = ofs;
+  key.read_bytes = read_bytes;
+
+  lock_acquire(&frame_lock);
+  e = ohash_find(&share_table, &key.share_elem);
+  lock_release(&frame_lock);
+  if (e == NULL)
+    return NULL;
+
+  /* The frame may be filled or evicted while we wait for it. */
+  f = hash_entry(e, struct frame, share_elem);
+  lock_acquire(&f->lock);
+  if (f->inode != inode || f->ofs != ofs || f->read_bytes != read_bytes) {
+    lock_release(&f->lock);
+    return NULL;
+  }
+  if (f->version != inode_get_version(inode)) {
+    uncache(f);
+    return NULL;
+  }
+  list_push_back(&f->pages, &page->frame_elem);
+  share_hits++;
+  return f;
+}
+
+/* Enters frame F, whose lock must be held and which holds
+   READ_BYTES bytes of INODE at OFS, read when INODE's version
+   was VERSION, in the share table.  Does nothing if another
+   frame is there already. */
+void frame_share(struct frame* f, struct inode* inode, off_t ofs, size_t read_bytes,
+                 unsigned version) {
+  ASSERT(lock_held_by_current_thread(&f->lock));
+  ASSERT(f->inode == NULL);
+
+  f->inode = inode;
+  f->ofs = ofs;
+  f->read_bytes = read_bytes;
+  f->version = version;
+  f->referenced = false;
+  lock_acquire(&frame_lock);
+  if (ohash_insert(&share_table, &f->share_elem) != NULL)
+    f->inode = NULL;
+  lock_release(&frame_lock);
+
+  /* Nobody can take F out of the table before we let go of its
+     lock. */
+  if (f->inode != NULL)
+    inode_reopen(inode);
+}
+
+/* Takes frame F, whose lock must be held, out of the share
+   table or the merge table, so that its page may be written in
+   place. */
+void frame_unshare(struct frame* f) {
+  struct inode* inode;
+
+  ASSERT(lock_held_by_current_thread(&f->lock));
+
+  lock_acquire(&frame_lock);
+  inode = unshare(f);
+  lock_release(&frame_lock);
+  inode_close(inode);
+}
+
+/* Copies SIZE bytes at OFS within the page that holds READ_BYTES
+   bytes of INODE at PAGE_OFS into BUFFER, if the page cache
+   holds that page as INODE holds it now.  Returns false if it
+   does not.  For inode_read_at(), which holds INODE's data lock,
+   so that an eviction that is writing the frame's pages back to
+   INODE may be holding the frame's lock: a busy frame counts as
+   a miss. */
+bool frame_read_cached(struct inode* inode, off_t page_ofs, size_t read_bytes, void* buffer,
+                       off_t ofs, off_t size) {
+  struct frame key;
+  struct hash_elem* e;
+  struct frame* f = NULL;
+  uint8_t* kpage;
+
+  ASSERT(ofs >= 0 && ofs + size <= (off_t)read_bytes);
+
+  key.inode = inode;
+  key.ofs = page_ofs;
+  key.read_bytes = read_bytes;
+
+  lock_acquire(&frame_lock);
+  e = ohash_find(&share_table, &key.share_elem);
+  if (e != NULL) {
+    f = hash_entry(e, struct frame, share_elem);
+    if (lock_held_by_current_thread(&f->lock) || !lock_try_acquire(&f->lock))
+      f = NULL;
+  }
+  lock_release(&frame_lock);
+  if (f == NULL)
+    return false;
+
+  if (f->version != inode_get_version(inode)) {
+    uncache(f);
+    return false;
+  }
+  kpage = kmap(f->paddr);
+  memcpy(buffer, kpage + ofs, size);
+  kunmap(kpage);
+  f->referenced = true;
+  read_hits++;
+  lock_release(&f->lock);
+  return true;
+}
+
+/* Pages out the pages of frame F, whose lock must be held, and
+   frees F, for a process that advised it will not use them
+   soon.  Releases F's lock.  Returns false, leaving F in use, if
+   another process shares F or a page cannot be paged out. */
+bool frame_reclaim(struct frame* f) {
+  struct inode* inode;
+
+  ASSERT(lock_held_by_current_thread(&f->lock));
+
+  if (!frame_owned_by(f, thread_current()->process)) {
+    lock_release(&f->lock);
+    return false;
+  }
+
+  /* Out of the share table, nobody else can find the frame. */
+  lock_acquire(&frame_lock);
+  inode = unshare(f);
+  lock_release(&frame_lock);
+  inode_close(inode);
+
+  while (!list_empty(&f->pages)) {
+    struct page* p = list_entry(list_front(&f->pages), struct page, frame_elem);
+    if (!page_out(p)) {
+      lock_release(&f->lock);
+      return false;
+    }
+    list_remove(&p->frame_elem);
+  }
+  advice_cnt++;
+  frame_free(f);
+  return true;
+}
+
+/* Called when page P was read back in from swap or its file.
+   Counts a working-set refault if P was evicted recently, and
+   suspends the worst process if the system is thrashing. */
+void frame_refault(struct page* p) {
+  struct thread* t = p->owner;
+  bool refault = false;
+  unsigned thrashing = 0;
+
+  lock_acquire(&frame_lock);
+  if (p->evicted_at != 0 && (unsigned)eviction_cnt - p->evicted_at < frame_cnt) {
+    refault = true;
+    refault_cnt++;
+    window_refaults++;
+    if (t->thrash_window != thrash_window) {
+      t->thrash_window = thrash_window;
+      t->thrash_refaults = 0;
+    }
+    t->thrash_refaults++;
+  }
+  p->evicted_at = 0;
+
+  if (++window_reads == THRASH_WINDOW) {
+    if (window_refaults * 4 >= window_reads * 3) {
+      thrash_cnt++;
+      if (++thrash_streak == THRASH_PATIENCE) {
+        thrash_streak = 0;
+        thrashing = thrash_window;
+      }
+    } else
+      thrash_streak = 0;
+    window_reads = window_refaults = 0;
+    if (++thrash_window == 0)
+      thrash_window = 1;
+  }
+  lock_release(&frame_lock);
+
+  if (refault) {
+    enum intr_level old_level = thread_stats_begin();
+    t->refaults++;
+    thread_stats_end(old_level);
+  }
+  if (thrashing != 0)
+    thrash_suspend(thrashing);
+}
+
+/* Waits out the current process's suspension for thrashing, if
+   there is one.  Called at the start of each user page fault. */
+void frame_throttle(void) {
+  int64_t until = thread_current()->process->thrash_until;
+  int64_t now = timer_ticks();
+
+  if (until > now)
+    timer_sleep(until - now);
+}
+
+/* Prints frame table statistics. */
+void frame_print_stats(void) {
+  printf("Frames: %zu in use, %lld evictions, %lld shared text hits\n", list_size(&frame_table),
+         eviction_cnt, share_hits);
+  printf("Pageout: %lld pages cleaned ahead of eviction, %lld frames freed\n", clean_cnt,
+         reclaim_cnt);
+  if (limit_cnt > 0)
+    printf("Frames: %lld evictions by processes at their resident limit\n", limit_cnt);
+  if (advice_cnt > 0)
+    printf("Frames: %lld freed on MADV_DONTNEED\n", advice_cnt);
+  printf("Page cache: %lld pages kept after their last unmap, %lld reads served\n", keep_cnt,
+         read_hits);
+  printf("Thrashing: %lld working-set refaults, %lld thrashing windows, %lld suspensions\n",
+         refault_cnt, thrash_cnt, suspend_cnt);
+  if (frame_merge_enabled)
+    printf("Merging: %lld frames saved, %lld frames hashed, %zu frames in the merge table\n",
+           merge_cnt, scan_cnt, ohash_size(&merge_table));
+}
+
+/* Picks a frame with the clock algorithm, pages out its pages
+   and returns it, locked and with no pages.  If OWNER is
+   non-null, only frames all of whose pages belong to OWNER are
+   considered.  Returns a null pointer if no frame can be
+   evicted. */
+static struct frame* frame_evict(struct thread* owner) {
+  struct frame* victim = NULL;
+  struct inode* inode = NULL;
+  size_t i, n;
+
+  lock_acquire(&frame_lock);
+
+  /* Two sweeps are enough: the first clears every accessed bit
+     it passes. */
+  n = 2 * list_size(&frame_table);
+  for (i = 0; i < n && victim == NULL; i++) {
+    struct frame* f;
+
+    if (hand == list_end(&frame_table))
+      hand = list_begin(&frame_table);
+    f = list_entry(hand, struct frame, elem);
+    advance_hand();
+
+    /* Our own locked frame is the one a copy-on-write fault is
+       copying. */
+    if (lock_held_by_current_thread(&f->lock) || !lock_try_acquire(&f->lock))
+      continue;
+    if ((owner != NULL && (list_empty(&f->pages) || !frame_owned_by(f, owner)))
+        || frame_accessed(f))
+      lock_release(&f->lock);
+    else
+      victim = f;
+  }
+
+  /* Out of the share table, nobody else can find the frame. */
+  if (victim != NULL)
+    inode = unshare(victim);
+  lock_release(&frame_lock);
+
+  if (victim == NULL)
+    return NULL;
+  victim->scanned = false;
+  inode_close(inode);
+  while (!list_empty(&victim->pages)) {
+    struct page* p = list_entry(list_front(&victim->pages), struct page, frame_elem);
+    if (!page_out(p)) {
+      lock_release(&victim->lock);
+      return NULL;
+    }
+    list_remove(&p->frame_elem);
+    p->evicted_at = (unsigned)eviction_cnt + 1;
+  }
+  eviction_cnt++;
+  return victim;
+}
+
+/* Returns true if any page of frame F was accessed, or F was
+   read through the page cache, since the last call, and clears
+   their accessed bits.  A page advised MADV_SEQUENTIAL is read
+   once, so its use does not count.  F's lock must be held. */
+static bool frame_accessed(struct frame* f) {
+  struct list_elem* e;
+  bool accessed = f->referenced;
+
+  f->referenced = false;
+  for (e = list_begin(&f->pages); e != list_end(&f->pages); e = list_next(e)) {
+    struct page* p = list_entry(e, struct page, frame_elem);
+    if (page_accessed(p) && p->advice != MADV_SEQUENTIAL)
+      accessed = true;
+  }
+  return accessed;
+}
+
+/* Returns true if every page of frame F, whose lock must be
+   held, belongs to OWNER. */
+static bool frame_owned_by(struct frame* f, struct thread* owner) {
+  struct list_elem* e;
+
+  for (e = list_begin(&f->pages); e != list_end(&f->pages); e = list_next(e))
+    if (list_entry(e, struct page, frame_elem)->owner != owner)
+      return false;
+  return true;
+}
+
+/* Removes F, which has no pages left, from the frame table,
+   frees its page of memory and releases its lock, which must be
+   held. */
+static void frame_free(struct frame* f) {
+  uintptr_t paddr = f->paddr;
+  struct inode* inode;
+
+  ASSERT(lock_held_by_current_thread(&f->lock));
+  ASSERT(list_empty(&f->pages));
+
+  lock_acquire(&frame_lock);
+  if (hand == &f->elem)
+    advance_hand();
+  if (merge_hand == &f->elem)
+    merge_hand = list_next(merge_hand);
+  list_remove(&f->elem);
+  inode = unshare(f);
+  f->paddr = 0;
+  list_push_back(&free_frames, &f->elem);
+  lock_release(&frame_lock);
+
+  lock_release(&f->lock);
+  palloc_free_frame(paddr);
+  inode_close(inode);
+}
+
+/* Takes frame F out of the share table or the merge table, if
+   it is in one.  F's lock and frame_lock must be held.  Returns
+   the inode whose reference the share table held, for the
+   caller to close once frame_lock is released, or a null
+   pointer. */
+static struct inode* unshare(struct frame* f) {
+  struct inode* inode = f->inode;
+
+  if (inode != NULL) {
+    ohash_delete(&share_table, &f->share_elem);
+    f->inode = NULL;
+  }
+  if (f->merged) {
+    ohash_delete(&merge_table, &f->merge_elem);
+    f->merged = false;
+  }
+  return inode;
+}
+
+/* Drops frame F, whose lock must be held, from the page cache
+   because its inode was written since F was read, and frees F
+   if no page uses it.  Releases F's lock. */
+static void uncache(struct frame* f) {
+  frame_unshare(f);
+  if (list_empty(&f->pages))
+    frame_free(f);
+  else
+    lock_release(&f->lock);
+}
+
+/* Moves the clock hand to the next frame.  frame_lock must be
+   held. */
+static void advance_hand(void) {
+  if (hand != list_end(&frame_table))
+    hand = list_next(hand);
+}
+
+/* Queues page-out work if the user pool runs low. */
+static void pageout_wake(void) {
+  if (pageout_low > 0 && !pageout_wanted && palloc_free_cnt(PAL_USER) < pageout_low) {
+    pageout_wanted = true;
+    work_queue(&pageout_work, WORK_HIGH);
+  }
+}
+
+/* Page-out work.  Cleans a batch of frames and then frees
+   frames until pageout_high user pages are free or nothing more
+   can be evicted.  Queued at WORK_HIGH, since processes that
+   fault meanwhile wait for evictions of their own. */
+static void pageout(void* aux UNUSED) {
+  pageout_clean();
+  while (palloc_free_cnt(PAL_USER) < pageout_high) {
+    struct frame* f = frame_evict(NULL);
+    if (f == NULL)
+      break;
+    frame_free(f);
+    reclaim_cnt++;
+  }
+  pageout_wanted = false;
+}
+
+/* Writes up to PAGEOUT_BATCH of the next PAGEOUT_SCAN frames the
+   clock will look at, those that hold a single dirty page that
+   was not used lately, to adjacent swap slots, in order of
+   process and address, so that a process's neighbouring pages
+   land in neighbouring slots.  Does nothing if swap has no free
+   run that long. */
+static void pageout_clean(void) {
+  struct frame* batch[PAGEOUT_BATCH];
+  struct list_elem* e;
+  size_t cnt = 0;
+  size_t i, n, slot;
+
+  lock_acquire(&frame_lock);
+  e = hand;
+  n = list_size(&frame_table);
+  if (n > PAGEOUT_SCAN)
+    n = PAGEOUT_SCAN;
+  for (i = 0; i < n && cnt < PAGEOUT_BATCH; i++, e = list_next(e)) {
+    struct frame* f;
+
+    if (e == list_end(&frame_table))
+      e = list_begin(&frame_table);
+    f = list_entry(e, struct frame, elem);
+    if (!lock_try_acquire(&f->lock))
+      continue;
+    if (list_size(&f->pages) == 1
+        && page_needs_clean(list_entry(list_front(&f->pages), struct page, frame_elem)))
+      batch[cnt++] = f;
+    else
+      lock_release(&f->lock);
+  }
+  lock_release(&frame_lock);
+
+  sort_batch(batch, cnt);
+  slot = cnt > 0 ? swap_alloc(cnt) : SWAP_ERROR;
+  for (i = 0; i < cnt; i++) {
+    if (slot != SWAP_ERROR) {
+      page_clean(list_entry(list_front(&batch[i]->pages), struct page, frame_elem), slot + i);
+      clean_cnt++;
+    }
+    lock_release(&batch[i]->lock);
+  }
+}
+
+/* Sorts the CNT frames in BATCH, which each hold a single page,
+   by the page's owner and then by its address. */
+static void sort_batch(struct frame** batch, size_t cnt) {
+  size_t i, j;
+
+  for (i = 1; i < cnt; i++) {
+    struct frame* f = batch[i];
+    struct page* p = list_entry(list_front(&f->pages), struct page, frame_elem);
+
+    for (j = i; j > 0; j--) {
+      struct page* q = list_entry(list_front(&batch[j - 1]->pages), struct page, frame_elem);
+
+      if (q->owner < p->owner || (q->owner == p->owner && q->upage < p->upage))
+        break;
+      batch[j] = batch[j - 1];
+    }
+    batch[j] = f;
+  }
+}
+
+/* The process that thrash_pick() found worst. */
+struct thrash_victim {
+  unsigned window; /* Thrash window whose refaults count. */
+  int cnt;         /* User processes seen. */
+  tid_t tid;       /* Worst process so far. */
+  size_t badness;  /* Its badness. */
+};
+
+/* Suspends the user process with the highest badness, counting
+   its refaults in thrash window WINDOW, if at least two user
+   processes compete for memory. */
+static void thrash_suspend(unsigned window) {
+  struct thrash_victim v;
+
+  v.window = window;
+  v.cnt = 0;
+  v.tid = TID_ERROR;
+  v.badness = 0;
+  thread_foreach(thrash_pick, &v);
+
+  /* thread_foreach() may meet a thread that is exiting, so the
+     victim is marked by its tid, in a second walk. */
+  if (v.cnt >= 2 && v.tid != TID_ERROR)
+    thread_foreach(thrash_mark, &v);
+}
+
+/* Looks at thread T for thrash_suspend(). */
+static void thrash_pick(struct thread* t, void* v_) {
+  struct thrash_victim* v = v_;
+  size_t badness;
+
+  if (t != t->process || t->pagedir == NULL || t->status == THREAD_DYING)
+    return;
+  v->cnt++;
+  badness = t->rss_pages + (t->thrash_window == v->window ? t->thrash_refaults : 0);
+  if (badness > v->badness) {
+    v->tid = t->tid;
+    v->badness = badness;
+  }
+}
+
+/* Suspends thread T's process if it is the one thrash_pick()
+   found worst. */
+static void thrash_mark(struct thread* t, void* v_) {
+  struct thrash_victim* v = v_;
+
+  if (t->tid == v->tid && t == t->process) {
+    t->thrash_until = timer_ticks() + THRASH_SUSPEND;
+    suspend_cnt++;
+  }
+}
+
+/* Returns a hash of the share table key of the frame that E is
+   embedded in. */
+static unsigned share_hash(const struct hash_elem* e, void* aux UNUSED) {
+  const struct frame* f = hash_entry(e, struct frame, share_elem);
+  return hash_ptr(f->inode) ^ hash_int(f->ofs) ^ hash_int(f->read_bytes);
+}
+
+/* Returns true if the share table key of frame A precedes that
+   of frame B. */
+static bool share_less(const struct hash_elem* a_, const struct hash_elem* b_, void* aux UNUSED) {
+  const struct frame* a = hash_entry(a_, struct frame, share_elem);
+  const struct frame* b = hash_entry(b_, struct frame, share_elem);
+
+  if (a->inode != b->inode)
+    return a->inode < b->inode;
+  if (a->ofs != b->ofs)
+    return a->ofs < b->ofs;
+  return a->read_bytes < b->read_bytes;
+}
+
+/* Queues merge work if merging is enabled and it is time for
+   another walk of the frame table. */
+static void merge_wake(void) {
+  int64_t now;
+
+  if (!frame_merge_enabled)
+    return;
+  now = timer_ticks();
+  if (now >= merge_next) {
+    merge_next = now + MERGE_INTERVAL;
+    work_queue(&merge_work, WORK_LOW);
+  }
+}
+
+/* Merge work.  Hashes the next MERGE_BATCH frames of the frame
+   table, merging the stable ones, and queues itself again unless
+   it finished a walk of the table that found no frame it had not
+   hashed before. */
+static void merge(void* aux UNUSED) {
+  bool again = true;
+  size_t i;
+
+  lock_acquire(&frame_lock);
+  for (i = 0; i < MERGE_BATCH; i++) {
+    struct frame* f;
+
+    if (merge_hand == list_end(&frame_table)) {
+      /* A walk is over. */
+      merge_hand = list_begin(&frame_table);
+      if (!merge_found || merge_hand == list_end(&frame_table)) {
+        again = false;
+        break;
+      }
+      merge_found = false;
+    }
+    f = list_entry(merge_hand, struct frame, elem);
+    merge_hand = list_next(merge_hand);
+
+    /* Our locks are taken in the other order elsewhere. */
+    if (!lock_try_acquire(&f->lock))
+      continue;
+    lock_release(&frame_lock);
+    if (merge_frame(f))
+      merge_found = true;
+    lock_acquire(&frame_lock);
+  }
+  lock_release(&frame_lock);
+
+  if (again)
+    work_queue(&merge_work, WORK_LOW);
+}
+
+/* Hashes frame F, whose lock must be held, if all of its pages
+   are anonymous and it is not in the page cache or the merge
+   table already.  If F's hash is the same as the last time,
+   write-protects its pages and enters F in the merge table, or
+   moves its pages to the frame with the same contents that is
+   there and frees F.  Releases F's lock.  Returns true if F was
+   hashed for the first time. */
+static bool merge_frame(struct frame* f) {
+  struct hash_elem* e;
+  struct frame* twin;
+  struct list_elem* pe;
+  unsigned checksum;
+  void* kpage;
+
+  if (f->inode != NULL || f->merged || list_empty(&f->pages) || !frame_anonymous(f)) {
+    lock_release(&f->lock);
+    return false;
+  }
+
+  scan_cnt++;
+  kpage = kmap(f->paddr);
+  checksum = hash_bytes(kpage, PGSIZE);
+  kunmap(kpage);
+  if (!f->scanned || f->checksum != checksum) {
+    bool first = !f->scanned;
+
+    f->scanned = true;
+    f->checksum = checksum;
+    lock_release(&f->lock);
+    return first;
+  }
+
+  /* Stable.  Freeze the contents, and hash them again, in case a
+     write slipped in before the last page was protected. */
+  for (pe = list_begin(&f->pages); pe != list_end(&f->pages); pe = list_next(pe))
+    page_write_protect(list_entry(pe, struct page, frame_elem));
+  kpage = kmap(f->paddr);
+  f->checksum = hash_bytes(kpage, PGSIZE);
+  kunmap(kpage);
+
+  lock_acquire(&frame_lock);
+  e = ohash_insert(&merge_table, &f->merge_elem);
+  if (e == NULL) {
+    f->merged = true;
+    lock_release(&frame_lock);
+    lock_release(&f->lock);
+    return false;
+  }
+
+  /* A frame in the merge table keeps its contents for as long as
+     its lock is held. */
+  twin = hash_entry(e, struct frame, merge_elem);
+  if (!lock_try_acquire(&twin->lock)) {
+    lock_release(&frame_lock);
+    lock_release(&f->lock);
+    return false;
+  }
+  lock_release(&frame_lock);
+
+  while (!list_empty(&f->pages))
+    page_remap(list_entry(list_front(&f->pages), struct page, frame_elem), twin);
+  lock_release(&twin->lock);
+  merge_cnt++;
+  frame_free(f);
+  return false;
+}
+
+/* Returns true if no page of frame F, whose lock must be held,
+   is backed by a file: each is private to its process, and goes
+   to swap when evicted dirty. */
+static bool frame_anonymous(struct frame* f) {
+  struct list_elem* e;
+
+  for (e = list_begin(&f->pages); e != list_end(&f->pages); e = list_next(e)) {
+    struct page* p = list_entry(e, struct page, frame_elem);
+    if (p->writeback || p->shared)
+      return false;
+  }
+  return true;
+}
+
+/* Returns the hash of the contents of the frame that E is
+   embedded in, as it was when the frame was entered in the merge
+   table. */
+static unsigned merge_hash(const struct hash_elem* e, void* aux UNUSED) {
+  return hash_entry(e, struct frame, merge_elem)->checksum;
+}
+
+/* Returns true if the contents of the frame that A_ is embedded
+   in precede those of the frame that B_ is embedded in.  Only
+   frames whose pages are all write-protected are compared.
+   Called with frame_lock held, so the frames are mapped with
+   kmap_atomic(), which does not sleep. */
+static bool merge_less(const struct hash_elem* a_, const struct hash_elem* b_, void* aux UNUSED) {
+  const struct frame* a = hash_entry(a_, struct frame, merge_elem);
+  const struct frame* b = hash_entry(b_, struct frame, merge_elem);
+  enum intr_level old_level = intr_disable();
+  void* akpage = kmap_atomic(a->paddr);
+  void* bkpage = kmap_atomic(b->paddr);
+  bool less = memcmp(akpage, bkpage, PGSIZE) < 0;
+
+  kunmap_atomic(bkpage);
+  kunmap_atomic(akpage);
+  intr_set_level(old_level);
+  return less;
+}
@@ -0,0 +1,64 @@
+#ifndef VM_FRAME_H
+#define VM_FRAME_H
+
+#include <hash.h>
+#include <list.h>
+#include "filesys/off_t.h"
+#include "threads/synch.h"
+
+struct inode;
+struct page;
+
+/* A frame of the user pool holding user data.
+
+   Usually one page is mapped to a frame, but read-only pages of
+   executables are shared by every process that runs the same
+   executable; such a frame is also entered in the share table
+   under the (INODE, OFS, READ_BYTES) it was read from.  The
+   share table is the page cache: it also holds clean pages of
+   mapped files, and keeps frames after their last page is
+   unmapped.
+
+   Frames of anonymous pages with the same contents may also be
+   merged into one, shared copy-on-write; the frame they share is
+   entered in the merge table (see vm/frame.c). */
+struct frame {
+  uintptr_t paddr;       /* Physical address; see kmap(). */
+  void* kaddr;           /* Where page_pin() mapped the frame, while pinned. */
+  struct list pages;     /* Pages mapped to the frame. */
+  struct lock lock;      /* Held while the frame is filled, evicted or changed. */
+  struct list_elem elem; /* Element in the frame table. */
+
+  /* Page cache. */
+  struct inode* inode;         /* Inode read from, or null if not in the share table. */
+  off_t ofs;                   /* Offset read from. */
+  size_t read_bytes;           /* Bytes read; the rest is zeros. */
+  unsigned version;            /* INODE's version when read. */
+  bool referenced;             /* Read through the cache since the clock passed? */
+  struct hash_elem share_elem; /* Element in the share table. */
+
+  /* Same-page merging. */
+  unsigned checksum;           /* Hash of the contents when last scanned. */
+  bool scanned;                /* Has CHECKSUM been taken? */
+  bool merged;                 /* In the merge table? */
+  struct hash_elem merge_elem; /* Element in the merge table. */
+};
+
+/* -merge: Merge anonymous pages with the same contents? */
+extern bool frame_merge_enabled;
+
+void frame_init(void);
+struct frame* frame_alloc(struct page*);
+struct frame* frame_try_alloc(struct page*);
+void frame_detach(struct frame*, struct page*);
+struct frame* frame_find_shared(struct page*, struct inode*, off_t ofs, size_t read_bytes);
+void frame_share(struct frame*, struct inode*, off_t ofs, size_t read_bytes, unsigned version);
+void frame_unshare(struct frame*);
+bool frame_read_cached(struct inode*, off_t page_ofs, size_t read_bytes, void* buffer,
+                       off_t ofs, off_t size);
+bool frame_reclaim(struct frame*);
+void frame_refault(struct page*);
+void frame_throttle(void);
+void frame_print_stats(void);
+
+#endif /* vm/frame.h */
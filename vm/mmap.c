@@ -0,0 +1,180 @@
+#include "vm/mmap.h"
+#include <round.h>
+#include "filesys/file.h"
+#include "threads/malloc.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "vm/page.h"
+
+/* Memory-mapped files.
+
+   mmap_map() maps a file at a page-aligned user address by adding
+   one page per page of the file to the supplemental page table,
+   so the file is read in page by page as the process touches it,
+   straight into the frame the process then uses.  The pages of a
+   mapping are written back to the file rather than to swap, and
+   only when they are dirty, both on eviction and when the
+   mapping goes away; clean pages are dropped without any I/O.
+
+   Each mapping keeps its own reopened copy of the file, so that
+   closing or removing the file does not affect it.  A forked
+   child gets mappings of its own over the same files, which it
+   reads in afresh; the parent's dirty pages are written back
+   first, so the child sees the file as it was at the fork.
+
+   A process's list of mappings is shared by its threads, and the
+   lock on its page table (see vm/page.c) protects it too. */
+
+static struct mapping* mapping_lookup(int mapid);
+static bool mapping_add_pages(struct mapping*);
+static void mapping_remove(struct mapping*);
+
+/* Maps FILE into the current process's address space at ADDR.
+   Returns a mapping identifier, or MAP_FAILED if ADDR is not a
+   non-null page-aligned user address, FILE is empty, the pages
+   would overlap ones already in use, or memory runs out. */
+int mmap_map(struct file* file, void* addr) {
+  struct thread* t = thread_current()->process;
+  struct mapping* m;
+  off_t length;
+  bool locked;
+
+  if (addr == NULL || pg_ofs(addr) != 0 || !is_user_vaddr(addr))
+    return MAP_FAILED;
+  length = file_length(file);
+  if (length == 0)
+    return MAP_FAILED;
+  if ((uintptr_t)PHYS_BASE - (uintptr_t)addr < (uintptr_t)length)
+    return MAP_FAILED;
+
+  m = malloc(sizeof *m);
+  if (m == NULL)
+    return MAP_FAILED;
+  m->file = file_reopen(file);
+  if (m->file == NULL) {
+    free(m);
+    return MAP_FAILED;
+  }
+  m->base = addr;
+  m->length = length;
+  locked = page_table_lock();
+  if (!mapping_add_pages(m)) {
+    page_table_unlock(locked);
+    free(m);
+    return MAP_FAILED;
+  }
+
+  m->mapid = t->next_mapid++;
+  list_push_back(&t->mappings, &m->elem);
+  page_table_unlock(locked);
+  return m->mapid;
+}
+
+/* Unmaps the current process's mapping MAPID, writing its dirty
+   pages back to the file.  Does nothing if there is no such
+   mapping. */
+void mmap_unmap(int mapid) {
+  bool locked = page_table_lock();
+  struct mapping* m = mapping_lookup(mapid);
+
+  if (m != NULL) {
+    list_remove(&m->elem);
+    mapping_remove(m);
+  }
+  page_table_unlock(locked);
+}
+
+/* Unmaps all of the current process's mappings.  Called when the
+   process exits. */
+void mmap_exit(void) {
+  struct list* mappings = &thread_current()->process->mappings;
+
+  while (!list_empty(mappings))
+    mapping_remove(list_entry(list_pop_front(mappings), struct mapping, elem));
+}
+
+/* Gives the current process, which is being forked from PARENT,
+   a copy of each of PARENT's mappings, under the same
+   identifiers.  PARENT's dirty mapped pages must have been
+   written back already.  Returns false if memory runs out. */
+bool mmap_fork(struct thread* parent) {
+  struct thread* t = thread_current();
+  struct list_elem* e;
+  bool success = true;
+
+  lock_acquire(&parent->pages_lock);
+  for (e = list_begin(&parent->mappings); e != list_end(&parent->mappings); e = list_next(e)) {
+    struct mapping* pm = list_entry(e, struct mapping, elem);
+    struct mapping* m = malloc(sizeof *m);
+
+    success = false;
+    if (m == NULL)
+      break;
+    m->file = file_reopen(pm->file);
+    if (m->file == NULL) {
+      free(m);
+      break;
+    }
+    m->mapid = pm->mapid;
+    m->base = pm->base;
+    m->length = pm->length;
+    if (!mapping_add_pages(m)) {
+      free(m);
+      break;
+    }
+    list_push_back(&t->mappings, &m->elem);
+    success = true;
+  }
+  t->next_mapid = parent->next_mapid;
+  lock_release(&parent->pages_lock);
+  return success;
+}
+
+/* Returns the current process's mapping MAPID, or a null pointer
+   if there is none. */
+static struct mapping* mapping_lookup(int mapid) {
+  struct list* mappings = &thread_current()->process->mappings;
+  struct list_elem* e;
+
+  for (e = list_begin(mappings); e != list_end(mappings); e = list_next(e)) {
+    struct mapping* m = list_entry(e, struct mapping, elem);
+    if (m->mapid == mapid)
+      return m;
+  }
+  return NULL;
+}
+
+/* Adds the pages of M, whose file, base and length are set, to
+   the current process's page table and sets M's page count.
+   Returns false, closing M's file and leaving no pages behind,
+   if a page overlaps one already in use or memory runs out. */
+static bool mapping_add_pages(struct mapping* m) {
+  size_t page_cnt = DIV_ROUND_UP(m->length, PGSIZE);
+  size_t i;
+
+  for (i = 0; i < page_cnt; i++) {
+    off_t ofs = i * PGSIZE;
+    size_t read_bytes = m->length - ofs < PGSIZE ? m->length - ofs : PGSIZE;
+
+    if (!page_add_mmap((uint8_t*)m->base + ofs, m->file, ofs, read_bytes)) {
+      /* Undo the pages added so far. */
+      for (; i > 0; i--)
+        page_remove((uint8_t*)m->base + (i - 1) * PGSIZE);
+      file_close(m->file);
+      return false;
+    }
+  }
+  m->page_cnt = page_cnt;
+  return true;
+}
+
+/* Removes the pages of M, which is not on any list, and frees
+   it. */
+static void mapping_remove(struct mapping* m) {
+  size_t i;
+
+  for (i = 0; i < m->page_cnt; i++)
+    page_remove((uint8_t*)m->base + i * PGSIZE);
+  file_close(m->file);
+  free(m);
+}
@@ -0,0 +1,30 @@
+#ifndef VM_MMAP_H
+#define VM_MMAP_H
+
+#include <list.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "filesys/off_t.h"
+
+struct file;
+struct thread;
+
+/* Returned by mmap_map() on failure. */
+#define MAP_FAILED (-1)
+
+/* A memory-mapped file. */
+struct mapping {
+  int mapid;             /* Mapping identifier. */
+  struct file* file;     /* Private reopened copy of the file. */
+  void* base;            /* First mapped page. */
+  off_t length;          /* Number of mapped bytes. */
+  size_t page_cnt;       /* Number of mapped pages. */
+  struct list_elem elem; /* Element in the owner's `mappings'. */
+};
+
+int mmap_map(struct file*, void* addr);
+void mmap_unmap(int mapid);
+void mmap_exit(void);
+bool mmap_fork(struct thread* parent);
+
+#endif /* vm/mmap.h */
@@ -0,0 +1,1045 @@
+#include "vm/page.h"
+#include <debug.h>
+#include <mman.h>
+#include <stdio.h>
+#include <string.h>
+#include "filesys/file.h"
+#include "filesys/inode.h"
+#include "threads/highmem.h"
+#include "threads/interrupt.h"
+#include "threads/kstat.h"
+#include "threads/palloc.h"
+#include "threads/slab.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "userprog/pagedir.h"
+#include "vm/frame.h"
+#include "vm/swap.h"
+
+/* Supplemental page table.
+
+   Each process keeps a hash table of struct page, keyed on the
+   user virtual page, next to its page directory.  load() only
+   records where each page of the executable comes from; nothing
+   is read until the process touches the page and page_fault()
+   calls page_in(), which gets a frame, fills it and maps it.  So
+   a large program starts in time proportional to the pages it
+   actually uses, not to its file size.
+
+   When frames run out, the frame table evicts a page with
+   page_out().  A page that is clean can be read back from where
+   it came from, so it is simply dropped; a dirty page goes to
+   swap, and is marked dirty again when it is read back, so that
+   it goes to swap again the next time.  The pages of memory
+   mapped files (see vm/mmap.c) are written back to their file
+   instead.  The page-out daemon in vm/frame.c may write a dirty
+   page to swap while it is still in its frame, with
+   page_clean(); the page then keeps its slot, and evicting it
+   costs nothing unless it was written again.
+
+   Pages that load() reads read-only from the executable are
+   shared between all the processes that run it: page_in() looks
+   for a frame that already holds the same bytes of the same
+   inode before it reads them (see vm/frame.c), so a program run
+   many times at once keeps a single copy of its code in memory.
+   Such pages are never dirty, so evicting them just drops
+   them.  The pages of mapped files are looked for there too,
+   and are mapped read-only and copy-on-write, so that the first
+   write to one gives it a frame of its own, or takes the frame
+   out of the page cache if no one else uses it.  Pages are read
+   from files straight from the disk, not through the buffer
+   cache, so that the data is not kept in memory twice.
+
+   fork() copies the table lazily too.  page_table_fork() makes
+   the child's pages share the parent's frames, and a writable
+   page that is shared this way is mapped read-only in both
+   processes and marked copy-on-write.  The first process to
+   write the page takes a fault, and page_cow() gives it a copy of
+   its own.  Only pages in swap are copied at the fork, because a
+   swap slot belongs to a single page.  Evicting a copy-on-write
+   frame pages out each of its pages on its own, which ends the
+   sharing.  With -merge, the frame table also makes anonymous
+   pages of any processes that hold the same bytes share a frame
+   (see vm/frame.c), copy-on-write in the same way.
+
+   A fault on a page of a file also brings in the next few pages
+   of the file, as long as there are free frames for them, so a
+   program that runs through its code or a mapped file in order
+   takes one fault per window instead of one per page.  Text that
+   other processes have in memory already costs no I/O at all.  A
+   process whose faults keep landing just past its last window
+   gets a window twice as large the next time.  A fault on a page
+   in swap likewise brings in the pages after it that sit in the
+   following swap slots, which vm/swap.c arranges for pages that
+   went out together.
+
+   Pages that start out zeroed, such as bss and the stack, map a
+   single shared page of zeros read-only until they are first
+   written, so memory the program only reads costs nothing.
+
+   The stack starts out as a single page and grows on demand:
+   page_grow_stack() adds a zeroed page for a fault just below
+   the stack pointer, as long as the stack stays within
+   page_stack_limit.  Stack pages that are never touched take no
+   memory.
+
+   The table belongs to the process, not to any one of its
+   threads, and the process's pages_lock protects it: each
+   function below that looks at or changes the current process's
+   table holds the lock throughout, so that one thread cannot
+   remove a page that another is bringing in.  The functions call
+   each other with the lock held, so they take it only if the
+   running thread does not hold it already; see
+   page_table_lock().  The frame table may look at a page from
+   another process, but only with the lock of the page's frame
+   held, which page_in() and page_destroy() also take, always
+   after pages_lock. */
+
+/* A fault at most this far below the stack pointer is taken for
+   stack growth.  PUSHA pushes 32 bytes before it writes any of
+   them. */
+#define STACK_SLACK 32
+
+/* -stack: Largest size of a process's stack, in bytes. */
+size_t page_stack_limit = 8 * 1024 * 1024;
+
+/* -fault-around: Pages brought in after a file-backed fault.
+   Sequential access doubles the window, up to FAULT_AROUND_MAX
+   pages. */
+size_t page_fault_around = 4;
+#define FAULT_AROUND_MAX 64
+
+/* -vm-stats: Print each process's paging statistics at exit? */
+bool page_stats_enabled;
+
+/* Statistics. */
+long long page_prefetch_cnt;       /* Pages brought in by fault_around() or swap_around(). */
+long long page_prefetch_hits;      /* Of those, pages used before eviction. */
+long long page_zero_maps;          /* Reads that mapped zero_page. */
+long long page_zero_copies;        /* Writes that replaced it. */
+static long long swap_cluster_cnt; /* Pages brought in by swap_around(). */
+
+/* Cache of struct page. */
+static struct kmem_cache* page_cache;
+
+/* A page of zeros, mapped read-only for every page that is read
+   before anything was written to it.  It is never freed. */
+static void* zero_page;
+
+static hash_hash_func page_hash;
+static hash_less_func page_less;
+static hash_action_func page_destroy;
+static bool page_in_locked(const void* fault_addr, bool write);
+static bool page_cow_locked(const void* fault_addr);
+static struct page* page_add(void* upage, bool writable);
+static bool page_load(struct page*, bool fault);
+static bool page_read(struct page*, void* kpage);
+static void rss_add(struct page*);
+static void rss_sub(struct page*);
+static void count_swap_out(struct thread*);
+static void count(long long* counter);
+static void fault_around(struct page*);
+static void swap_around(struct page*, size_t slot);
+static bool page_fork(struct page*, struct thread* parent);
+static struct frame* page_lock_frame(struct page*);
+static void page_release(struct page*);
+static void page_write_back(struct page*);
+
+/* Initializes the supplemental page table module. */
+void page_init(void) {
+  page_cache = kmem_cache_create("page", sizeof(struct page), __alignof__(struct page), NULL);
+  zero_page = palloc_get_page(PAL_ASSERT | PAL_ZERO);
+  kstat_counter("swap.cluster_ins", &swap_cluster_cnt);
+}
+
+/* Initializes PAGES as an empty supplemental page table.
+   Returns false if memory allocation fails. */
+bool page_table_init(struct hash* pages) { return hash_init(pages, page_hash, page_less, NULL); }
+
+/* Destroys the supplemental page table PAGES, freeing the frames
+   and swap slots of its pages.  Must be called while the owner's
+   page directory still exists. */
+void page_table_destroy(struct hash* pages) { hash_destroy(pages, page_destroy); }
+
+/* Acquires the lock on the current process's page table, unless
+   the running thread holds it already.  Returns true if it took
+   the lock, to be passed to page_table_unlock(). */
+bool page_table_lock(void) {
+  struct lock* lock = &thread_current()->process->pages_lock;
+
+  if (lock_held_by_current_thread(lock))
+    return false;
+  lock_acquire(lock);
+  return true;
+}
+
+/* Releases the lock on the current process's page table if
+   LOCKED, the value page_table_lock() returned. */
+void page_table_unlock(bool locked) {
+  if (locked)
+    lock_release(&thread_current()->process->pages_lock);
+}
+
+/* Returns the current process's page that contains UADDR, or a
+   null pointer if there is none.  Unless the caller holds the
+   page table's lock, another thread of the process may remove
+   the page at any time. */
+struct page* page_lookup(const void* uaddr) {
+  bool locked = page_table_lock();
+  struct page p;
+  struct hash_elem* e;
+
+  p.upage = pg_round_down(uaddr);
+  e = hash_find(&thread_current()->process->pages, &p.elem);
+  page_table_unlock(locked);
+  return e != NULL ? hash_entry(e, struct page, elem) : NULL;
+}
+
+/* Records that the current process's page UPAGE is to be filled
+   with READ_BYTES bytes from FILE at offset OFS followed by
+   zeros, when it is first touched.  FILE must stay open for as
+   long as the page exists.  Returns false if UPAGE is already in
+   use or memory allocation fails. */
+bool page_add_file(void* upage, struct file* file, off_t ofs, size_t read_bytes, bool writable) {
+  bool locked;
+  struct page* p;
+
+  ASSERT(read_bytes <= PGSIZE);
+
+  locked = page_table_lock();
+  p = page_add(upage, writable);
+  if (p != NULL) {
+    p->file = read_bytes > 0 ? file : NULL;
+    p->ofs = ofs;
+    p->read_bytes = read_bytes;
+    p->shared = p->file != NULL && !writable;
+  }
+  page_table_unlock(locked);
+  return p != NULL;
+}
+
+/* Records that the current process's page UPAGE is to be zeroed
+   when it is first touched.  Returns false if UPAGE is already
+   in use or memory allocation fails. */
+bool page_add_zero(void* upage, bool writable) { return page_add_file(upage, NULL, 0, 0, writable); }
+
+/* Records that the current process's page UPAGE maps READ_BYTES
+   bytes of FILE at offset OFS, followed by zeros, and that it is
+   written back to FILE when dirty.  Returns false if UPAGE is
+   already in use or memory allocation fails. */
+bool page_add_mmap(void* upage, struct file* file, off_t ofs, size_t read_bytes) {
+  bool locked;
+  struct page* p;
+
+  ASSERT(read_bytes > 0 && read_bytes <= PGSIZE);
+
+  locked = page_table_lock();
+  p = page_add(upage, true);
+  if (p != NULL) {
+    p->writeback = true;
+    p->file = file;
+    p->ofs = ofs;
+    p->read_bytes = read_bytes;
+  }
+  page_table_unlock(locked);
+  return p != NULL;
+}
+
+/* Removes the current process's page UPAGE, writing it back to
+   its file first if it is a dirty mapped page.  Does nothing if
+   there is no such page. */
+void page_remove(void* upage) {
+  bool locked = page_table_lock();
+  struct page* p = page_lookup(upage);
+
+  if (p != NULL) {
+    hash_delete(&thread_current()->process->pages, &p->elem);
+    page_release(p);
+  }
+  page_table_unlock(locked);
+}
+
+/* Brings in the current process's page that contains FAULT_ADDR
+   and maps it, along with the pages that follow it in its file
+   or in swap (see fault_around() and swap_around()).  WRITE tells whether the faulting access
+   was a write; reads of zero-filled pages map the shared zero
+   page.  Returns false if there is no such page, if it is
+   already present, or if it cannot be brought in. */
+bool page_in(const void* fault_addr, bool write) {
+  bool locked = page_table_lock();
+  bool success = page_in_locked(fault_addr, write);
+
+  page_table_unlock(locked);
+  return success;
+}
+
+/* Does the work of page_in(), with the page table's lock held. */
+static bool page_in_locked(const void* fault_addr, bool write) {
+  struct page* p = page_lookup(fault_addr);
+  struct frame* f;
+  size_t slot;
+
+  if (p == NULL || p->zero)
+    return false;
+
+  /* If the page is being evicted, wait for that to finish.  A
+     page that another thread of the process brought in meanwhile
+     is present already. */
+  f = p->frame;
+  if (f != NULL) {
+    lock_acquire(&f->lock);
+    lock_release(&f->lock);
+    if (p->frame != NULL)
+      return false;
+  }
+
+  /* Reading a page that never held anything but zeros needs no
+     frame of its own. */
+  if (!write && p->file == NULL && p->swap_slot == SWAP_ERROR) {
+    if (!pagedir_set_page(thread_current()->pagedir, p->upage, zero_page, false))
+      return false;
+    p->zero = true;
+    count(&thread_current()->process->minor_faults);
+    page_zero_maps++;
+    return true;
+  }
+
+  slot = p->swap_slot;
+  if (!page_load(p, true))
+    return false;
+  if (slot != SWAP_ERROR)
+    swap_around(p, slot);
+  else if (p->file != NULL)
+    fault_around(p);
+  return true;
+}
+
+/* Grows the current process's stack to cover FAULT_ADDR, if a
+   fault there looks like a stack access given the user stack
+   pointer ESP, and brings the new page in.  Returns false if
+   FAULT_ADDR is not a stack access or the page cannot be
+   added. */
+bool page_grow_stack(const void* fault_addr, const void* esp) {
+  void* upage = pg_round_down(fault_addr);
+  bool locked, success;
+
+  if ((const uint8_t*)fault_addr < (const uint8_t*)esp - STACK_SLACK
+      || (uintptr_t)PHYS_BASE - (uintptr_t)upage > page_stack_limit)
+    return false;
+  locked = page_table_lock();
+  success = page_add_zero(upage, true) && page_in(upage, true);
+  page_table_unlock(locked);
+  return success;
+}
+
+/* Returns true if page P, which must be in a frame whose lock is
+   held, was accessed since the last call, and clears its accessed
+   bit.  Counts the first access to a page that fault_around()
+   brought in as a page fault avoided. */
+bool page_accessed(struct page* p) {
+  uint32_t* pd = p->owner->pagedir;
+
+  if (!pagedir_is_accessed(pd, p->upage))
+    return false;
+  pagedir_set_accessed(pd, p->upage, false);
+  if (p->prefetched) {
+    p->prefetched = false;
+    page_prefetch_hits++;
+  }
+  return true;
+}
+
+/* Prints the current process's paging statistics, for
+   process_exit(). */
+void page_print_stats(void) {
+  struct thread* t = thread_current();
+
+  printf("%s: %lld minor faults, %lld major faults, %lld pages swapped in, %lld out, "
+         "%lld refaults, %zu resident (peak %zu)\n",
+         t->name, t->minor_faults, t->major_faults, t->swap_ins, t->swap_outs, t->refaults,
+         t->rss_pages, t->peak_rss_pages);
+}
+
+/* Called by the frame table, with the lock of P's frame held, to
+   evict page P from its frame.  Unmaps P, then writes it to swap
+   if it is dirty.  Returns false, leaving P mapped, if P is dirty
+   and swap is full. */
+bool page_out(struct page* p) {
+  uint32_t* pd = p->owner->pagedir;
+  struct frame* f = p->frame;
+
+  ASSERT(f != NULL);
+  ASSERT(lock_held_by_current_thread(&f->lock));
+
+  /* Unmap first, so that the owner cannot change the page while
+     it is written out. */
+  page_accessed(p);
+  p->prefetched = false;
+  pagedir_clear_page(pd, p->upage);
+  if (p->writeback)
+    page_write_back(p);
+  else if (pagedir_is_dirty(pd, p->upage)) {
+    size_t slot = p->swap_slot;
+    void* kpage = kmap(f->paddr);
+
+    /* A page that the page-out daemon cleaned keeps its slot. */
+    if (slot != SWAP_ERROR)
+      swap_write(slot, kpage);
+    else
+      slot = swap_out(kpage, p->owner->swap_next);
+    kunmap(kpage);
+    if (slot == SWAP_ERROR) {
+      pagedir_set_phys(pd, p->upage, f->paddr, p->writable && !p->cow);
+      pagedir_set_dirty(pd, p->upage, true);
+      return false;
+    }
+    p->swap_slot = slot;
+
+    /* Only a hint, so a race with another eviction is harmless. */
+    p->owner->swap_next = slot + 1;
+    count_swap_out(p->owner);
+  }
+  p->frame = NULL;
+  p->cow = false;
+  rss_sub(p);
+  return true;
+}
+
+/* Returns true if page P, which must be in a frame whose lock is
+   held, is worth writing to swap before the frame is evicted:
+   it is dirty, it would go to swap rather than to a file, and it
+   was not accessed since the clock last looked at it. */
+bool page_needs_clean(struct page* p) {
+  uint32_t* pd = p->owner->pagedir;
+
+  return !p->writeback && pagedir_is_dirty(pd, p->upage) && !pagedir_is_accessed(pd, p->upage);
+}
+
+/* Called by the page-out daemon, with the lock of P's frame
+   held, to write page P to swap slot SLOT, which it allocated
+   for P, ahead of P's eviction.  P stays mapped and keeps the
+   slot while it is in its frame, so that evicting it later costs
+   no I/O unless it is written again. */
+void page_clean(struct page* p, size_t slot) {
+  uint32_t* pd = p->owner->pagedir;
+  void* kpage;
+
+  ASSERT(p->frame != NULL);
+  ASSERT(lock_held_by_current_thread(&p->frame->lock));
+
+  /* Clear the dirty bit first: a write while the page is going
+     out sets it again, and page_out() then writes the page once
+     more. */
+  pagedir_set_dirty(pd, p->upage, false);
+  kpage = kmap(p->frame->paddr);
+  swap_write(slot, kpage);
+  kunmap(kpage);
+  if (p->swap_slot != SWAP_ERROR)
+    swap_free(p->swap_slot);
+  p->swap_slot = slot;
+  count_swap_out(p->owner);
+}
+
+/* Called by the frame table, with the lock of P's frame held, to
+   map page P read-only, and copy-on-write if it is writable, so
+   that the frame's contents stay as they are until P is
+   written. */
+void page_write_protect(struct page* p) {
+  uint32_t* pd = p->owner->pagedir;
+  bool dirty, accessed;
+
+  ASSERT(p->frame != NULL);
+  ASSERT(lock_held_by_current_thread(&p->frame->lock));
+
+  if (!p->writable || p->cow)
+    return;
+  dirty = pagedir_is_dirty(pd, p->upage);
+  accessed = pagedir_is_accessed(pd, p->upage);
+  pagedir_clear_page(pd, p->upage);
+  pagedir_set_phys(pd, p->upage, p->frame->paddr, false);
+  pagedir_set_dirty(pd, p->upage, dirty);
+  pagedir_set_accessed(pd, p->upage, accessed);
+  p->cow = true;
+}
+
+/* Called by the frame table, with the locks of P's frame and of
+   frame F held, to move write-protected page P to F, which holds
+   the same bytes.  P keeps its dirty bit, so that evicting it
+   later still writes it to swap if it has to. */
+void page_remap(struct page* p, struct frame* f) {
+  uint32_t* pd = p->owner->pagedir;
+  bool dirty, accessed;
+
+  ASSERT(p->frame != NULL && p->frame != f);
+  ASSERT(lock_held_by_current_thread(&p->frame->lock));
+  ASSERT(lock_held_by_current_thread(&f->lock));
+
+  dirty = pagedir_is_dirty(pd, p->upage);
+  accessed = pagedir_is_accessed(pd, p->upage);
+  pagedir_clear_page(pd, p->upage);
+
+  /* The page table that mapped P is still there, so mapping P
+     again needs no memory. */
+  if (!pagedir_set_phys(pd, p->upage, f->paddr, false))
+    PANIC("page_remap: mapping failed");
+  pagedir_set_dirty(pd, p->upage, dirty);
+  pagedir_set_accessed(pd, p->upage, accessed);
+  list_remove(&p->frame_elem);
+  list_push_back(&f->pages, &p->frame_elem);
+  p->frame = f;
+}
+
+/* Copies the pages of PARENT, which must be blocked in fork(),
+   into the current process's empty table.  The current process's
+   executable must already be open.  Mapped pages are left to
+   mmap_fork(), but written back first.  Returns false if memory
+   runs out. */
+bool page_table_fork(struct thread* parent) {
+  struct hash_iterator i;
+  bool success = true;
+
+  /* The other threads of PARENT's process keep running. */
+  lock_acquire(&parent->pages_lock);
+  hash_first(&i, &parent->pages);
+  while (success && hash_next(&i)) {
+    struct page* pp = hash_entry(hash_cur(&i), struct page, elem);
+
+    if (pp->writeback) {
+      struct frame* f = page_lock_frame(pp);
+      if (f != NULL) {
+        page_write_back(pp);
+        lock_release(&f->lock);
+      }
+    } else
+      success = page_fork(pp, parent);
+  }
+  lock_release(&parent->pages_lock);
+  return success;
+}
+
+/* Gives the current process a copy of its own of the
+   copy-on-write or zero page that contains FAULT_ADDR, which it
+   tried to write, and maps the page writable.  Returns false if
+   there is no such page or memory runs out. */
+bool page_cow(const void* fault_addr) {
+  bool locked = page_table_lock();
+  bool success = page_cow_locked(fault_addr);
+
+  page_table_unlock(locked);
+  return success;
+}
+
+/* Does the work of page_cow(), with the page table's lock
+   held. */
+static bool page_cow_locked(const void* fault_addr) {
+  uint32_t* pd = thread_current()->pagedir;
+  struct page* p = page_lookup(fault_addr);
+  struct frame* f;
+
+  if (p == NULL)
+    return false;
+
+  /* The first write to a zero page gets it a zeroed frame. */
+  if (p->zero) {
+    if (!p->writable)
+      return false;
+    pagedir_clear_page(pd, p->upage);
+    p->zero = false;
+    page_zero_copies++;
+    return page_load(p, true);
+  }
+
+  if (!p->cow)
+    return false;
+
+  /* If the page was evicted meanwhile, it is no longer shared, so
+     the retried access just faults it back in. */
+  f = page_lock_frame(p);
+  if (f == NULL)
+    return true;
+
+  pagedir_clear_page(pd, p->upage);
+  if (list_size(&f->pages) == 1 && (f->inode != NULL || f->merged))
+    frame_unshare(f);
+  else if (list_size(&f->pages) > 1) {
+    struct frame* copy;
+    void *dst, *src;
+
+    list_remove(&p->frame_elem);
+    copy = frame_alloc(p);
+    if (copy == NULL) {
+      list_push_back(&f->pages, &p->frame_elem);
+      pagedir_set_phys(pd, p->upage, f->paddr, false);
+      lock_release(&f->lock);
+      return false;
+    }
+    dst = kmap(copy->paddr);
+    src = kmap(f->paddr);
+    memcpy(dst, src, PGSIZE);
+    kunmap(src);
+    kunmap(dst);
+    lock_release(&f->lock);
+    p->frame = f = copy;
+  }
+  pagedir_set_phys(pd, p->upage, f->paddr, true);
+  pagedir_set_dirty(pd, p->upage, true);
+  p->cow = false;
+  lock_release(&f->lock);
+  count(&thread_current()->process->minor_faults);
+  return true;
+}
+
+/* Brings in the current process's page that contains UADDR,
+   with a copy of its own if WRITE is true, and returns the kernel
+   address that UADDR maps to, for a device to transfer to or
+   from.  The page's frame stays locked, so that it is not
+   evicted, until page_unpin().  Returns a null pointer if there
+   is no such page, if WRITE is true and the page is read-only,
+   or if it cannot be brought in.  The page table's lock must be
+   held until page_unpin(). */
+void* page_pin(const void* uaddr, bool write) {
+  struct page* p = page_lookup(uaddr);
+
+  ASSERT(lock_held_by_current_thread(&thread_current()->process->pages_lock));
+
+  if (p == NULL || (write && !p->writable))
+    return NULL;
+  for (;;) {
+    struct frame* f = page_lock_frame(p);
+
+    if (f != NULL) {
+      if (!write || !p->cow) {
+        /* The device's writes do not set the dirty bit. */
+        if (write)
+          pagedir_set_dirty(p->owner->pagedir, p->upage, true);
+        f->kaddr = kmap(f->paddr);
+        return (uint8_t*)f->kaddr + pg_ofs(uaddr);
+      }
+      lock_release(&f->lock);
+      if (!page_cow_locked(uaddr))
+        return NULL;
+    } else if (p->zero) {
+      if (!write)
+        return (uint8_t*)zero_page + pg_ofs(uaddr);
+      if (!page_cow_locked(uaddr))
+        return NULL;
+    } else if (!page_in_locked(uaddr, write))
+      return NULL;
+  }
+}
+
+/* Lets the frame of the page that contains UADDR, which
+   page_pin() returned, be evicted again. */
+void page_unpin(const void* uaddr) {
+  struct page* p = page_lookup(uaddr);
+
+  if (p != NULL && p->frame != NULL) {
+    kunmap(p->frame->kaddr);
+    p->frame->kaddr = NULL;
+    lock_release(&p->frame->lock);
+  }
+}
+
+/* Applies ADVICE, one of the MADV_* values in <mman.h>, to the
+   current process's PAGE_CNT pages starting at UPAGE.  Pages not
+   in its table are passed over. */
+void page_advise(void* upage, size_t page_cnt, int advice) {
+  bool locked = page_table_lock();
+  size_t i;
+
+  for (i = 0; i < page_cnt; i++) {
+    struct page* p = page_lookup((uint8_t*)upage + i * PGSIZE);
+    struct frame* f;
+
+    if (p == NULL)
+      continue;
+    switch (advice) {
+      case MADV_NORMAL:
+      case MADV_RANDOM:
+      case MADV_SEQUENTIAL:
+        p->advice = advice;
+        break;
+      case MADV_WILLNEED:
+        /* Like fault_around(), never evicts for the page. */
+        if (p->frame == NULL && !p->zero && (p->file != NULL || p->swap_slot != SWAP_ERROR)
+            && page_load(p, false)) {
+          p->prefetched = true;
+          page_prefetch_cnt++;
+        }
+        break;
+      case MADV_DONTNEED:
+        f = page_lock_frame(p);
+        if (f != NULL)
+          frame_reclaim(f);
+        break;
+    }
+  }
+  page_table_unlock(locked);
+}
+
+/* Adds a page at UPAGE to the current process's table and
+   returns it, or returns a null pointer if UPAGE is already in
+   use or memory allocation fails. */
+static struct page* page_add(void* upage, bool writable) {
+  struct page* p;
+
+  ASSERT(pg_ofs(upage) == 0);
+  ASSERT(is_user_vaddr(upage));
+
+  /* Shared memory (see userprog/shm.c) is mapped in the page
+     directory without being in the table. */
+  if (pagedir_is_mapped(thread_current()->pagedir, upage))
+    return NULL;
+
+  p = kmem_cache_alloc(page_cache);
+  if (p == NULL)
+    return NULL;
+  p->upage = upage;
+  p->owner = thread_current()->process;
+  p->writable = writable;
+  p->writeback = false;
+  p->shared = false;
+  p->cow = false;
+  p->prefetched = false;
+  p->zero = false;
+  p->advice = MADV_NORMAL;
+  p->frame = NULL;
+  p->evicted_at = 0;
+  p->swap_slot = SWAP_ERROR;
+  p->file = NULL;
+  p->ofs = 0;
+  p->read_bytes = 0;
+  if (hash_insert(&thread_current()->process->pages, &p->elem) != NULL) {
+    kmem_cache_free(page_cache, p);
+    return NULL;
+  }
+  return p;
+}
+
+/* Returns a hash of the page that E is embedded in. */
+static unsigned page_hash(const struct hash_elem* e, void* aux UNUSED) {
+  const struct page* p = hash_entry(e, struct page, elem);
+  return hash_ptr(p->upage);
+}
+
+/* Returns true if the page A precedes page B. */
+static bool page_less(const struct hash_elem* a, const struct hash_elem* b, void* aux UNUSED) {
+  return hash_entry(a, struct page, elem)->upage < hash_entry(b, struct page, elem)->upage;
+}
+
+/* Frees the page that E is embedded in. */
+static void page_destroy(struct hash_elem* e, void* aux UNUSED) {
+  page_release(hash_entry(e, struct page, elem));
+}
+
+/* Brings page P, which must not be in a frame, into a frame of
+   its own or into the frame in the page cache that holds its
+   data, and maps it.  FAULT is true for a page fault, which may
+   evict another page and is counted in the process's
+   statistics, and false for reading ahead.  Returns false if P
+   cannot be brought in. */
+static bool page_load(struct page* p, bool fault) {
+  struct thread* t = thread_current()->process;
+  struct frame* f = NULL;
+  uint8_t* kpage;
+  bool cached = p->shared || p->writeback;
+  bool from_swap = false;
+  bool io = false;
+
+  if (cached)
+    f = frame_find_shared(p, file_get_inode(p->file), p->ofs, p->read_bytes);
+  if (f == NULL) {
+    f = fault ? frame_alloc(p) : frame_try_alloc(p);
+    if (f == NULL)
+      return false;
+    kpage = kmap(f->paddr);
+
+    from_swap = p->swap_slot != SWAP_ERROR;
+    io = from_swap || p->file != NULL;
+    if (from_swap) {
+      swap_in(p->swap_slot, kpage);
+      p->swap_slot = SWAP_ERROR;
+      count(&t->swap_ins);
+    } else if (p->file != NULL) {
+      struct inode* inode = file_get_inode(p->file);
+
+      /* Note the version first: a write that races with the read
+         makes the frame look stale, never fresh. */
+      unsigned version = inode_get_version(inode);
+
+      if (!page_read(p, kpage)) {
+        kunmap(kpage);
+        frame_detach(f, p);
+        return false;
+      }
+      if (cached)
+        frame_share(f, inode, p->ofs, p->read_bytes, version);
+    } else
+      memset(kpage, 0, PGSIZE);
+    kunmap(kpage);
+  }
+
+  /* A mapped page is written in place only after page_cow(). */
+  if (p->writeback)
+    p->cow = true;
+  if (!pagedir_set_phys(t->pagedir, p->upage, f->paddr, p->writable && !p->cow)) {
+    frame_detach(f, p);
+    return false;
+  }
+
+  /* What came from swap is only in this frame now. */
+  if (from_swap)
+    pagedir_set_dirty(t->pagedir, p->upage, true);
+  p->frame = f;
+  rss_add(p);
+  lock_release(&f->lock);
+  if (io)
+    frame_refault(p);
+
+  if (fault) {
+    if (io)
+      count(&t->major_faults);
+    else
+      count(&t->minor_faults);
+  }
+  return true;
+}
+
+/* Reads page P's READ_BYTES bytes from its file into KPAGE, and
+   zeros the rest.  Whole sectors go straight from the disk into
+   KPAGE.  Returns false if the file is too short. */
+static bool page_read(struct page* p, void* kpage) {
+  off_t bytes_read;
+
+  if (p->ofs % BLOCK_SECTOR_SIZE == 0)
+    bytes_read = inode_read_direct(file_get_inode(p->file), kpage, PGSIZE, p->ofs);
+  else
+    bytes_read = file_read_at(p->file, kpage, p->read_bytes, p->ofs);
+  if (bytes_read < (off_t)p->read_bytes)
+    return false;
+  memset((uint8_t*)kpage + p->read_bytes, 0, PGSIZE - p->read_bytes);
+  return true;
+}
+
+/* Brings in the file-backed pages that follow page P, which the
+   current process just faulted in, without evicting anything
+   for them.  Stops at the first page that is not file-backed or
+   is already present.  Pages advised MADV_RANDOM bring in nothing
+   more, and pages advised MADV_SEQUENTIAL the largest window. */
+static void fault_around(struct page* p) {
+  struct thread* t = thread_current()->process;
+  uint8_t* upage = p->upage;
+  size_t window, i;
+
+  if (p->advice == MADV_RANDOM)
+    return;
+  if (page_fault_around == 0 && p->advice != MADV_SEQUENTIAL)
+    return;
+
+  /* A fault just past the previous window looks sequential. */
+  window = page_fault_around;
+  if (p->advice == MADV_SEQUENTIAL)
+    window = FAULT_AROUND_MAX;
+  else if (upage == t->fault_around_next) {
+    window = t->fault_around_window * 2;
+    if (window > FAULT_AROUND_MAX)
+      window = FAULT_AROUND_MAX;
+  }
+
+  for (i = 1; i <= window && is_user_vaddr(upage + i * PGSIZE); i++) {
+    struct page* q = page_lookup(upage + i * PGSIZE);
+
+    if (q == NULL || q->file == NULL || q->frame != NULL || q->swap_slot != SWAP_ERROR
+        || !page_load(q, false))
+      break;
+    q->prefetched = true;
+    page_prefetch_cnt++;
+  }
+  t->fault_around_next = upage + i * PGSIZE;
+  t->fault_around_window = window;
+}
+
+/* Brings in the pages that follow page P, which the current
+   process just faulted in from swap slot SLOT, as long as each
+   one is in the slot after the previous one's, without evicting
+   anything for them.  The reads then go to adjacent sectors.
+   The window is fault_around()'s, without the doubling. */
+static void swap_around(struct page* p, size_t slot) {
+  uint8_t* upage = p->upage;
+  size_t window, i;
+
+  if (p->advice == MADV_RANDOM)
+    return;
+  window = p->advice == MADV_SEQUENTIAL ? FAULT_AROUND_MAX : page_fault_around;
+
+  for (i = 1; i <= window && is_user_vaddr(upage + i * PGSIZE); i++) {
+    struct page* q = page_lookup(upage + i * PGSIZE);
+
+    if (q == NULL || q->frame != NULL || q->swap_slot != slot + i || !page_load(q, false))
+      break;
+    q->prefetched = true;
+    page_prefetch_cnt++;
+    swap_cluster_cnt++;
+  }
+}
+
+/* Adds a copy of PARENT's page PP to the current process's
+   table.  If PP is in a frame, the copy shares it; if PP is
+   writable, both are then mapped read-only until one of them is
+   written.  Returns false if memory runs out. */
+static bool page_fork(struct page* pp, struct thread* parent) {
+  struct thread* t = thread_current();
+  uint32_t* ppd = parent->pagedir;
+  struct page* p;
+  struct frame* f;
+
+  p = page_add(pp->upage, pp->writable);
+  if (p == NULL)
+    return false;
+  p->shared = pp->shared;
+  p->advice = pp->advice;
+  p->ofs = pp->ofs;
+  p->read_bytes = pp->read_bytes;
+
+  /* Pages other than mapped ones are only ever read from the
+     executable. */
+  p->file = pp->file != NULL ? t->executable_file : NULL;
+
+  f = page_lock_frame(pp);
+  if (f != NULL) {
+    /* A page cleaned by the page-out daemon is in a swap slot
+       that only PP can use. */
+    bool dirty = pagedir_is_dirty(ppd, pp->upage) || pp->swap_slot != SWAP_ERROR;
+
+    if (pp->writable) {
+      pagedir_clear_page(ppd, pp->upage);
+      pagedir_set_phys(ppd, pp->upage, f->paddr, false);
+      pagedir_set_dirty(ppd, pp->upage, dirty);
+      pp->cow = p->cow = true;
+    }
+    if (!pagedir_set_phys(t->pagedir, p->upage, f->paddr, false)) {
+      lock_release(&f->lock);
+      return false;
+    }
+    pagedir_set_dirty(t->pagedir, p->upage, dirty);
+    list_push_back(&f->pages, &p->frame_elem);
+    p->frame = f;
+    rss_add(p);
+    lock_release(&f->lock);
+  } else if (pp->swap_slot != SWAP_ERROR) {
+    /* PARENT's page table is locked, so nothing can swap PP in
+       meanwhile. */
+    void* kpage;
+
+    f = frame_alloc(p);
+    if (f == NULL)
+      return false;
+    kpage = kmap(f->paddr);
+    swap_read(pp->swap_slot, kpage);
+    kunmap(kpage);
+    if (!pagedir_set_phys(t->pagedir, p->upage, f->paddr, p->writable)) {
+      frame_detach(f, p);
+      return false;
+    }
+    pagedir_set_dirty(t->pagedir, p->upage, true);
+    p->frame = f;
+    rss_add(p);
+    count(&t->swap_ins);
+    lock_release(&f->lock);
+  }
+  return true;
+}
+
+/* Returns the frame holding page P with its lock held, or a null
+   pointer if P is not in a frame.  The frame table may be
+   evicting P right now. */
+static struct frame* page_lock_frame(struct page* p) {
+  for (;;) {
+    struct frame* f = p->frame;
+
+    if (f == NULL)
+      return NULL;
+    lock_acquire(&f->lock);
+    if (p->frame == f)
+      return f;
+    lock_release(&f->lock);
+  }
+}
+
+/* Frees page P, which is no longer in its owner's table, with
+   its frame or swap slot, writing it back first if it is a dirty
+   mapped page.  The frame itself is freed only if no other
+   process shares it. */
+static void page_release(struct page* p) {
+  struct frame* f = page_lock_frame(p);
+
+  /* Keep pagedir_destroy() from freeing the zero page. */
+  if (p->zero)
+    pagedir_clear_page(p->owner->pagedir, p->upage);
+
+  if (f != NULL) {
+    page_accessed(p);
+    pagedir_clear_page(p->owner->pagedir, p->upage);
+    if (p->writeback)
+      page_write_back(p);
+    p->frame = NULL;
+    rss_sub(p);
+    frame_detach(f, p);
+  }
+  if (p->swap_slot != SWAP_ERROR)
+    swap_free(p->swap_slot);
+  kmem_cache_free(page_cache, p);
+}
+
+/* Writes mapped page P, which must be in a frame whose lock is
+   held, back to its file if it is dirty.  The dirty bit is
+   cleared first, so that a write by another thread of the owner
+   while the page goes out leaves it dirty. */
+static void page_write_back(struct page* p) {
+  uint32_t* pd = p->owner->pagedir;
+
+  if (pagedir_is_dirty(pd, p->upage)) {
+    void* kpage = kmap(p->frame->paddr);
+
+    pagedir_set_dirty(pd, p->upage, false);
+    file_write_at(p->file, kpage, p->read_bytes, p->ofs);
+    kunmap(kpage);
+  }
+}
+
+/* Counts page P, which just got a frame, in its owner's resident
+   set.  The frame table changes the counts of other processes,
+   so this is a change to their statistics too. */
+static void rss_add(struct page* p) {
+  struct thread* t = p->owner;
+  enum intr_level old_level = thread_stats_begin();
+
+  if (++t->rss_pages > t->peak_rss_pages)
+    t->peak_rss_pages = t->rss_pages;
+  thread_stats_end(old_level);
+}
+
+/* Removes page P, which just lost its frame, from its owner's
+   resident set. */
+static void rss_sub(struct page* p) {
+  enum intr_level old_level = thread_stats_begin();
+
+  p->owner->rss_pages--;
+  thread_stats_end(old_level);
+}
+
+/* Counts a page of process T written to swap. */
+static void count_swap_out(struct thread* t) {
+  enum intr_level old_level = thread_stats_begin();
+
+  t->swap_outs++;
+  thread_stats_end(old_level);
+}
+
+/* Adds one to COUNTER, one of a process's paging statistics. */
+static void count(long long* counter) {
+  enum intr_level old_level = thread_stats_begin();
+
+  (*counter)++;
+  thread_stats_end(old_level);
+}
@@ -0,0 +1,86 @@
+#ifndef VM_PAGE_H
+#define VM_PAGE_H
+
+#include <hash.h>
+#include <list.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "filesys/off_t.h"
+
+struct thread;
+
+/* A page of a process's virtual address space, as recorded in
+   its supplemental page table.  Describes where the page's
+   contents come from, so that it can be brought in the first
+   time it is touched. */
+struct page {
+  void* upage;                 /* User virtual address. */
+  struct hash_elem elem;       /* Element in the owner's `pages'. */
+  struct thread* owner;        /* Process the page belongs to. */
+  bool writable;               /* May the process write the page? */
+  bool writeback;              /* Write dirty contents to FILE, not swap? */
+  bool shared;                 /* Read-only text that may share a frame? */
+  bool cow;                    /* Writable, but mapped read-only until copied? */
+  bool prefetched;             /* Brought in by fault-around, not yet used? */
+  bool zero;                   /* Mapped to the shared zero page? */
+  uint8_t advice;              /* MADV_NORMAL, MADV_RANDOM or MADV_SEQUENTIAL. */
+  struct frame* frame;         /* Frame holding the page, or null. */
+  struct list_elem frame_elem; /* Element in the frame's `pages'. */
+  unsigned evicted_at;         /* Eviction count when last evicted, or 0 (see vm/frame.c). */
+
+  /* Where the contents come from when the page is not in a
+     frame: swap slot SWAP_SLOT if it is not SWAP_ERROR,
+     otherwise READ_BYTES bytes from FILE at OFS followed by
+     zeros.  FILE is null for a page that starts out zeroed.  A
+     page in a frame may have a swap slot too, holding the copy
+     the page-out daemon wrote ahead of eviction. */
+  size_t swap_slot;  /* Swap slot, or SWAP_ERROR. */
+  struct file* file; /* File to read from, or null. */
+  off_t ofs;         /* Offset in FILE. */
+  size_t read_bytes; /* Bytes to read; the rest is zeroed. */
+};
+
+/* -stack: Largest size of a process's stack, in bytes. */
+extern size_t page_stack_limit;
+
+/* -fault-around: Pages brought in after a file-backed fault. */
+extern size_t page_fault_around;
+
+/* -vm-stats: Print each process's paging statistics at exit? */
+extern bool page_stats_enabled;
+
+/* Pages brought in by fault-around, and those of them used. */
+extern long long page_prefetch_cnt;
+extern long long page_prefetch_hits;
+
+/* Reads that mapped the zero page, and writes that replaced it. */
+extern long long page_zero_maps;
+extern long long page_zero_copies;
+
+void page_init(void);
+bool page_table_init(struct hash*);
+void page_table_destroy(struct hash*);
+bool page_table_lock(void);
+void page_table_unlock(bool locked);
+struct page* page_lookup(const void* uaddr);
+bool page_add_file(void* upage, struct file*, off_t ofs, size_t read_bytes, bool writable);
+bool page_add_zero(void* upage, bool writable);
+bool page_add_mmap(void* upage, struct file*, off_t ofs, size_t read_bytes);
+void page_remove(void* upage);
+bool page_in(const void* fault_addr, bool write);
+bool page_accessed(struct page*);
+void page_print_stats(void);
+bool page_out(struct page*);
+bool page_needs_clean(struct page*);
+void page_clean(struct page*, size_t slot);
+void page_write_protect(struct page*);
+void page_remap(struct page*, struct frame*);
+bool page_grow_stack(const void* fault_addr, const void* esp);
+bool page_table_fork(struct thread* parent);
+bool page_cow(const void* fault_addr);
+void* page_pin(const void* uaddr, bool write);
+void page_unpin(const void* uaddr);
+void page_advise(void* upage, size_t page_cnt, int advice);
+
+#endif /* vm/page.h */
@@ -0,0 +1,133 @@
+#include "vm/swap.h"
+#include <bitmap.h>
+#include <debug.h>
+#include <stdio.h>
+#include "devices/block.h"
+#include "threads/kstat.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+#include "vm/zswap.h"
+
+/* Swap partition.
+
+   The device with role BLOCK_SWAP, chosen with -swap, is divided
+   into page-size slots of SECTORS_PER_SLOT sectors, tracked with
+   a bitmap of used slots.  The lock only covers the bitmap; a
+   slot belongs to the page it was handed to, so its sectors are
+   read and written without it.  Without a swap device, every
+   swap_out() fails.
+
+   With -zswap, a page written to a slot may be kept compressed in
+   memory instead (see vm/zswap.c), and reading the slot then
+   costs no I/O.
+
+   Slots are handed out with locality in mind.  Each process
+   remembers the slot after the last one it was given, and its
+   next page-out takes the first free slot from there on, so the
+   pages it evicts one after another, which are usually adjacent
+   in its address space too, end up in adjacent slots.  A fault
+   on one of them then reads the following ones back with it
+   (see swap_around() in vm/page.c), sector after sector, instead
+   of paying a seek for each. */
+
+/* Sectors per swap slot. */
+#define SECTORS_PER_SLOT (PGSIZE / BLOCK_SECTOR_SIZE)
+
+static struct block* swap_device;
+static struct bitmap* used_slots; /* Slots in use. */
+static struct lock swap_lock;     /* Protects used_slots. */
+
+/* Statistics. */
+static long long swap_out_cnt; /* Pages written to swap. */
+static long long swap_in_cnt;  /* Pages read from swap. */
+
+/* Finds the swap device and sets up its slot bitmap. */
+void swap_init(void) {
+  lock_init(&swap_lock);
+  kstat_counter("swap.outs", &swap_out_cnt);
+  kstat_counter("swap.ins", &swap_in_cnt);
+  swap_device = block_get_role(BLOCK_SWAP);
+  if (swap_device == NULL)
+    return;
+
+  used_slots = bitmap_create(block_size(swap_device) / SECTORS_PER_SLOT);
+  if (used_slots == NULL)
+    PANIC("swap: bitmap creation failed");
+  zswap_init(bitmap_size(used_slots));
+}
+
+/* Writes the page at KPAGE to a free swap slot, the first at or
+   after HINT if there is one, and returns the slot, or returns
+   SWAP_ERROR if swap is full or missing. */
+size_t swap_out(const void* kpage, size_t hint) {
+  size_t slot = swap_alloc_near(hint, 1);
+
+  if (slot != SWAP_ERROR)
+    swap_write(slot, kpage);
+  return slot;
+}
+
+/* Allocates CNT adjacent free swap slots and returns the first,
+   or returns SWAP_ERROR if there is no such run or no swap.
+   Writing adjacent slots one after another keeps the disk
+   head moving in one direction. */
+size_t swap_alloc(size_t cnt) { return swap_alloc_near(0, cnt); }
+
+/* Like swap_alloc(), but takes the first run at or after slot
+   HINT if there is one, and looks from the start of swap only
+   if there is not. */
+size_t swap_alloc_near(size_t hint, size_t cnt) {
+  size_t slot = BITMAP_ERROR;
+
+  if (used_slots == NULL)
+    return SWAP_ERROR;
+
+  lock_acquire(&swap_lock);
+  if (hint > 0 && hint < bitmap_size(used_slots))
+    slot = bitmap_scan_and_flip(used_slots, hint, cnt, false);
+  if (slot == BITMAP_ERROR)
+    slot = bitmap_scan_and_flip(used_slots, 0, cnt, false);
+  lock_release(&swap_lock);
+  return slot != BITMAP_ERROR ? slot : SWAP_ERROR;
+}
+
+/* Writes the page at KPAGE to swap slot SLOT, which the caller
+   owns. */
+void swap_write(size_t slot, const void* kpage) {
+  swap_out_cnt++;
+  zswap_drop(slot);
+  if (zswap_store(slot, kpage))
+    return;
+  block_write_multiple(swap_device, slot * SECTORS_PER_SLOT, SECTORS_PER_SLOT, kpage);
+}
+
+/* Reads swap slot SLOT into the page at KPAGE and frees the
+   slot. */
+void swap_in(size_t slot, void* kpage) {
+  swap_read(slot, kpage);
+  swap_free(slot);
+}
+
+/* Reads swap slot SLOT into the page at KPAGE and keeps the
+   slot. */
+void swap_read(size_t slot, void* kpage) {
+  swap_in_cnt++;
+  if (zswap_load(slot, kpage))
+    return;
+  block_read_multiple(swap_device, slot * SECTORS_PER_SLOT, SECTORS_PER_SLOT, kpage);
+}
+
+/* Frees swap slot SLOT without reading it. */
+void swap_free(size_t slot) {
+  zswap_drop(slot);
+  lock_acquire(&swap_lock);
+  ASSERT(bitmap_test(used_slots, slot));
+  bitmap_reset(used_slots, slot);
+  lock_release(&swap_lock);
+}
+
+/* Prints swap statistics. */
+void swap_print_stats(void) {
+  printf("Swap: %lld pages out, %lld pages in\n", swap_out_cnt, swap_in_cnt);
+  zswap_print_stats();
+}
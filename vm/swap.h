@@ -0,0 +1,21 @@
+#ifndef VM_SWAP_H
+#define VM_SWAP_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Returned by swap_out() when there is no free slot, and stored
+   in pages whose contents are not in swap. */
+#define SWAP_ERROR SIZE_MAX
+
+void swap_init(void);
+size_t swap_out(const void* kpage, size_t hint);
+size_t swap_alloc(size_t cnt);
+size_t swap_alloc_near(size_t hint, size_t cnt);
+void swap_write(size_t slot, const void* kpage);
+void swap_in(size_t slot, void* kpage);
+void swap_read(size_t slot, void* kpage);
+void swap_free(size_t slot);
+void swap_print_stats(void);
+
+#endif /* vm/swap.h */
@@ -0,0 +1,265 @@
+#include "vm/zswap.h"
+#include <debug.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "threads/malloc.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+
+/* Compressed swap cache.
+
+   Writing a page to the swap device takes eight sectors of PIO,
+   one interrupt each, and reading it back as many again.  With
+   -zswap=KB, swap.c first offers each page it writes to this
+   tier, which compresses it and keeps it in up to KB kB of
+   kernel heap, indexed by the swap slot it was written to.  The
+   slot stays allocated on the device, so the tier needs no
+   allocator of its own, but nothing is written to it.  A page
+   goes to the device instead if it does not compress to
+   ZSWAP_MAX_LEN bytes or if the tier is full.
+
+   The compressor is a small LZ77 variant that finds matches
+   through a hash table of the last position of each 3-byte
+   string.  The output is a sequence of
+
+     - literal runs: a byte 0...127 giving the run length less
+       one, followed by that many bytes, and
+
+     - matches: a byte 128...255 whose low 7 bits give the match
+       length less MIN_MATCH, followed by the distance back less
+       one as two bytes, least significant first.
+
+   Pages that are mostly zeros or repeated patterns, which is
+   what most swapped pages are, shrink by an order of magnitude.
+
+   zswap_lock protects the entries, the byte count and the
+   compressor's static buffers. */
+
+/* Compressor parameters. */
+#define MIN_MATCH 3                    /* Shortest match encoded. */
+#define MAX_MATCH (MIN_MATCH + 127)    /* Longest match encoded. */
+#define MAX_LITERALS 128               /* Longest literal run encoded. */
+#define HASH_BITS 10                   /* Bits in a hash table index. */
+#define ZSWAP_MAX_LEN (PGSIZE * 3 / 4) /* Largest compressed page kept. */
+
+/* A compressed page. */
+struct zentry {
+  uint16_t len;    /* Bytes in DATA. */
+  uint8_t data[1]; /* Compressed contents, LEN bytes long. */
+};
+
+/* -zswap: Bytes of kernel memory for compressed pages. */
+size_t zswap_limit;
+
+static struct zentry** entries; /* Compressed page of each slot, or null. */
+static size_t slot_cnt;         /* Number of elements in entries. */
+static size_t used_bytes;       /* Memory held by entries. */
+static struct lock zswap_lock;  /* Protects everything here. */
+
+/* Compressor state.  Too big for a kernel stack. */
+static uint16_t lz_table[1 << HASH_BITS]; /* 1 + last position of each hash, or 0. */
+static uint8_t lz_buf[ZSWAP_MAX_LEN];     /* Compressed output. */
+
+/* Statistics. */
+static long long store_cnt;    /* Pages kept compressed. */
+static long long reject_cnt;   /* Pages that did not compress well. */
+static long long full_cnt;     /* Pages that did not fit. */
+static long long hit_cnt;      /* Loads served from memory. */
+static long long miss_cnt;     /* Loads left to the device. */
+static long long stored_bytes; /* Compressed size of the pages kept. */
+
+static size_t lz_compress(const uint8_t* src, uint8_t* dst, size_t max);
+static void lz_decompress(const uint8_t* src, size_t len, uint8_t* dst);
+
+/* Sets up the tier for a swap device with SLOT_CNT slots.  Does
+   nothing if -zswap was not given. */
+void zswap_init(size_t slot_cnt_) {
+  lock_init(&zswap_lock);
+  if (zswap_limit == 0 || slot_cnt_ == 0)
+    return;
+
+  entries = calloc(slot_cnt_, sizeof *entries);
+  if (entries == NULL)
+    PANIC("zswap: slot table allocation failed");
+  slot_cnt = slot_cnt_;
+}
+
+/* Compresses the page at KPAGE and keeps it as the contents of
+   swap slot SLOT, which must not hold a compressed page.
+   Returns false if the page must be written to the device
+   instead. */
+bool zswap_store(size_t slot, const void* kpage) {
+  struct zentry* e;
+  size_t len, size;
+
+  if (entries == NULL)
+    return false;
+  ASSERT(slot < slot_cnt);
+
+  lock_acquire(&zswap_lock);
+  ASSERT(entries[slot] == NULL);
+  len = lz_compress(kpage, lz_buf, sizeof lz_buf);
+  if (len == 0) {
+    reject_cnt++;
+    goto done;
+  }
+  size = offsetof(struct zentry, data) + len;
+  if (used_bytes + size > zswap_limit) {
+    full_cnt++;
+    goto done;
+  }
+  e = malloc(size);
+  if (e == NULL) {
+    full_cnt++;
+    goto done;
+  }
+  e->len = len;
+  memcpy(e->data, lz_buf, len);
+  entries[slot] = e;
+  used_bytes += size;
+  store_cnt++;
+  stored_bytes += len;
+
+done:
+  lock_release(&zswap_lock);
+  return entries[slot] != NULL;
+}
+
+/* Reads swap slot SLOT into the page at KPAGE if the slot holds
+   a compressed page, and returns true.  The compressed copy is
+   kept until zswap_drop().  Returns false if the page is on the
+   device. */
+bool zswap_load(size_t slot, void* kpage) {
+  struct zentry* e;
+
+  if (entries == NULL)
+    return false;
+  ASSERT(slot < slot_cnt);
+
+  lock_acquire(&zswap_lock);
+  e = entries[slot];
+  if (e != NULL) {
+    lz_decompress(e->data, e->len, kpage);
+    hit_cnt++;
+  } else
+    miss_cnt++;
+  lock_release(&zswap_lock);
+  return e != NULL;
+}
+
+/* Frees the compressed page of swap slot SLOT, if it has one. */
+void zswap_drop(size_t slot) {
+  struct zentry* e;
+
+  if (entries == NULL)
+    return;
+  ASSERT(slot < slot_cnt);
+
+  lock_acquire(&zswap_lock);
+  e = entries[slot];
+  if (e != NULL) {
+    entries[slot] = NULL;
+    used_bytes -= offsetof(struct zentry, data) + e->len;
+  }
+  lock_release(&zswap_lock);
+  free(e);
+}
+
+/* Prints compressed swap statistics. */
+void zswap_print_stats(void) {
+  long long ratio;
+
+  if (entries == NULL)
+    return;
+  ratio = stored_bytes > 0 ? store_cnt * PGSIZE * 100 / stored_bytes : 0;
+  printf("Zswap: %lld pages stored (%lld.%02lld:1 compression), %lld incompressible, "
+         "%lld spilled when full, %lld hits, %lld misses\n",
+         store_cnt, ratio / 100, ratio % 100, reject_cnt, full_cnt, hit_cnt, miss_cnt);
+}
+
+/* Returns the hash table index for the MIN_MATCH bytes at P. */
+static unsigned lz_hash(const uint8_t* p) {
+  uint32_t x = p[0] | (p[1] << 8) | ((uint32_t)p[2] << 16);
+  return (x * 2654435761u) >> (32 - HASH_BITS);
+}
+
+/* Appends the CNT literal bytes at SRC to DST, which holds *OUT
+   bytes of at most MAX.  Returns false if they do not fit. */
+static bool lz_literals(const uint8_t* src, size_t cnt, uint8_t* dst, size_t* out, size_t max) {
+  while (cnt > 0) {
+    size_t n = cnt < MAX_LITERALS ? cnt : MAX_LITERALS;
+
+    if (*out + 1 + n > max)
+      return false;
+    dst[(*out)++] = n - 1;
+    memcpy(dst + *out, src, n);
+    *out += n;
+    src += n;
+    cnt -= n;
+  }
+  return true;
+}
+
+/* Compresses the page at SRC into DST and returns the compressed
+   length, or returns 0 if it would take more than MAX bytes. */
+static size_t lz_compress(const uint8_t* src, uint8_t* dst, size_t max) {
+  size_t i = 0;   /* Next byte to look at. */
+  size_t lit = 0; /* First byte not yet emitted. */
+  size_t out = 0; /* Bytes in DST. */
+
+  memset(lz_table, 0, sizeof lz_table);
+  while (i + MIN_MATCH <= PGSIZE) {
+    unsigned h = lz_hash(src + i);
+    size_t cand = lz_table[h];
+
+    lz_table[h] = i + 1;
+    if (cand != 0 && !memcmp(src + cand - 1, src + i, MIN_MATCH)) {
+      size_t m = cand - 1;
+      size_t len = MIN_MATCH;
+      size_t dist = i - m - 1;
+
+      while (len < MAX_MATCH && i + len < PGSIZE && src[m + len] == src[i + len])
+        len++;
+      if (!lz_literals(src + lit, i - lit, dst, &out, max) || out + 3 > max)
+        return 0;
+      dst[out++] = 0x80 | (len - MIN_MATCH);
+      dst[out++] = dist & 0xff;
+      dst[out++] = dist >> 8;
+      i += len;
+      lit = i;
+    } else
+      i++;
+  }
+  if (!lz_literals(src + lit, PGSIZE - lit, dst, &out, max))
+    return 0;
+  return out;
+}
+
+/* Decompresses the LEN bytes at SRC, which lz_compress()
+   produced, into the page at DST. */
+static void lz_decompress(const uint8_t* src, size_t len, uint8_t* dst) {
+  const uint8_t* end = src + len;
+  size_t out = 0;
+
+  while (src < end) {
+    uint8_t c = *src++;
+
+    if (c < 0x80) {
+      size_t n = c + 1;
+
+      memcpy(dst + out, src, n);
+      src += n;
+      out += n;
+    } else {
+      size_t n = (c & 0x7f) + MIN_MATCH;
+      size_t dist = (src[0] | (src[1] << 8)) + 1;
+
+      /* The match may overlap the bytes it produces. */
+      src += 2;
+      for (; n > 0; n--, out++)
+        dst[out] = dst[out - dist];
+    }
+  }
+  ASSERT(out == PGSIZE);
+}